@@ -12,9 +12,11 @@
 # N_DEBUG    - Build debug version
 # N_PROFILE  - Incorporate profiling code
 # VC_RUNTIME - Override default runtime library for vc++ (e.g. /MD)
+# N_TSAN     - Build with ThreadSanitizer (gcc only)
 #---------------------------------------------------------------------
 N_DEBUG    = false
 N_PROFILE  = false
+N_TSAN     = false
 VC_RUNTIME = /MT
 
 #---------------------------------------------------------------------
@@ -49,6 +51,9 @@ ifeq ($(N_DEBUG),true)
 else
     N_POSTDIR = 
 endif
+ifeq ($(N_TSAN),true)
+    N_POSTDIR := $(N_POSTDIR)tsan
+endif
 
 # Now dump the directory paths
 # HACK: also add on "-D<Base Platform>" to fix header kludge
@@ -218,6 +223,7 @@ ifeq ($(N_COMPILER),__GNUC__)
   N_OPTIMIZEFLAGS = -O3 -ffast-math -fomit-frame-pointer
   N_OPTIMIZELFLAGS= 
   N_PROFILEFLAGS  = -p
+  N_TSANFLAGS     = -fsanitize=thread -g
   N_DEBUGFLAGS    = -g
   N_DEBUGLFLAGS   = 
   INC_PATH        = ../../code/nebula2/inc/
@@ -292,6 +298,10 @@ endif
 ifeq ($(N_PROFILE),true)
   BASECFLAGS   += $(N_PROFILEFLAGS)
 endif
+ifeq ($(N_TSAN),true)
+  BASECFLAGS   += $(N_TSANFLAGS)
+  LIBS         += $(N_TSANFLAGS)
+endif
 
 # C flags
 CFLAGS += $(BASECFLAGS) $(N_WARNFLAGS_C) $(INCDIR)
@@ -648,6 +648,9 @@ App::Run()
         // call the app's OnFrame() method
         this->OnFrame();
 
+        // deliver remaining async messages and update the message statistics
+        this->messageServer->OnFrame();
+
         // a requested state always overrides the returned state
         if (this->requestedState.IsValid())
         {
@@ -51,6 +51,10 @@ public:
     const nString& GetName() const;
     /// get id data type
     Type GetType() const;
+    /// get the unique index of the id
+    int GetIndex() const;
+    /// get the number of ids created so far
+    static int GetNumIds();
     /// return true if storable
     bool IsStorable() const;
     /// return true if writable
@@ -58,11 +62,15 @@ public:
 
 protected:
     /// default constructor is protected
-    _attrid() {};
+    _attrid() : index(-1) {};
 
     nString name;
     Type type;
     uchar flags;
+    int index;
+
+private:
+    static int numIds;
 };
 
 //------------------------------------------------------------------------------
@@ -72,7 +80,8 @@ inline
 _attrid::_attrid(const char* n, Type t, uchar f) :
     name(n),
     type(t),
-    flags(f)
+    flags(f),
+    index(numIds++)
 {
     // empty
 }
@@ -86,6 +95,28 @@ _attrid::GetType() const
     return this->type;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns a unique index of the id in the range 0 .. GetNumIds() - 1,
+    which can be used to index per id tables.
+*/
+inline
+int
+_attrid::GetIndex() const
+{
+    return this->index;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+_attrid::GetNumIds()
+{
+    return numIds;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -4,6 +4,9 @@
 //------------------------------------------------------------------------------
 #include "attr/_attridtyped.h"
 
+// NOTE: the counter is zero initialized before any id is constructed
+int _attrid::numIds = 0;
+
 // explicitly instantiate template classes for all possible types:
 
 template class _attridTyped<attr::VoidT>;
@@ -77,6 +77,8 @@ public:
     const nString& GetName() const;
     /// get id data type
     Type GetType() const;
+    /// get the unique index of the id, see _attrid::GetIndex()
+    int GetIndex() const;
     /// return true if storable
     bool IsStorable() const;
     /// return true if writable
@@ -199,6 +201,16 @@ AttributeID::GetType() const
     return (Type) this->attridPtr->GetType();
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+AttributeID::GetIndex() const
+{
+    return this->attridPtr->GetIndex();
+}
+
 //------------------------------------------------------------------------------
 /**
 */
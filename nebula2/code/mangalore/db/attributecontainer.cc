@@ -11,7 +11,8 @@ namespace Db
 /**
 */
 AttributeContainer::AttributeContainer() :
-    attrs(32, 64)
+    attrs(32, 64),
+    schema(AttributeSchema::GetEmpty())
 {
     // empty
 }
@@ -24,38 +25,6 @@ AttributeContainer::~AttributeContainer()
     // empty
 }
 
-//------------------------------------------------------------------------------
-/**
-    Find index of attribute. Return -1 if attribute doesn't exist in the
-    container.
-
-    FIXME: This does a slow linear search. Consider using a binary search
-    to speed up access!!!
-*/
-int
-AttributeContainer::FindAttrIndex(const Attr::AttributeID& attrId) const
-{
-    int num = this->attrs.Size();
-    for (int i = 0; i < num; i++)
-    {
-        if (this->attrs[i].GetAttributeID() == attrId)
-        {
-            return i;
-        }
-    }
-    return -1;
-}
-
-//------------------------------------------------------------------------------
-/**
-    Return true if an attribute exists.
-*/
-bool
-AttributeContainer::HasAttr(const Attr::AttributeID& id) const
-{
-    return (-1 != this->FindAttrIndex(id));
-}
-
 //------------------------------------------------------------------------------
 /**
     Set a generic attribute. If the attribute exists, its
@@ -70,6 +39,7 @@ AttributeContainer::SetAttr(const Attribute& attr)
     if (-1 == attrIndex)
     {
         this->attrs.Append(attr);
+        this->schema = this->schema->Append(attr.GetAttributeID());
     }
     else
     {
@@ -79,27 +49,6 @@ AttributeContainer::SetAttr(const Attribute& attr)
     }
 }
 
-//------------------------------------------------------------------------------
-/**
-    Get generic attribute. Throws a hard error if the
-    attribute doesn't exist.
-*/
-const Attribute&
-AttributeContainer::GetAttr(const Attr::AttributeID& attrId) const
-{
-    n_assert(attrId.IsValid());
-    int attrIndex = this->FindAttrIndex(attrId);
-    if (-1 != attrIndex)
-    {
-        return this->attrs[attrIndex];
-    }
-    else
-    {
-        n_error("Db::AttributeContainer::GetAttr(): attr '%s' not found!", attrId.GetName().Get());
-        return this->attrs[0]; // silence the compiler
-    }
-}
-
 //------------------------------------------------------------------------------
 /**
     This method provides direct read access to the attributes.
@@ -118,6 +67,7 @@ void
 AttributeContainer::Clear()
 {
     this->attrs.Clear();
+    this->schema = AttributeSchema::GetEmpty();
 }
 
 };
@@ -4,12 +4,16 @@
 /**
     @class Db::AttributeContainer
 
-    A simple container class for attributes.
+    A simple container class for attributes. The attributes are kept in
+    the order in which they have been added. Their position in the
+    attribute array is looked up through a shared AttributeSchema, so
+    accessing an attribute doesn't depend on the number of attributes.
 
     (C) 2006 Radon Labs GmbH
 */
 #include "util/narray.h"
 #include "db/attribute.h"
+#include "db/attributeschema.h"
 
 //------------------------------------------------------------------------------
 namespace Db
@@ -33,12 +37,58 @@ public:
     void Clear();
 
 private:
-    /// find index for attribute (SLOW!)
+    /// find index for attribute
     int FindAttrIndex(const Attr::AttributeID& attrId) const;
 
     nArray<Attribute> attrs;
+    AttributeSchema* schema;
 };
 
+//------------------------------------------------------------------------------
+/**
+    Find index of attribute. Return -1 if attribute doesn't exist in the
+    container.
+*/
+inline
+int
+AttributeContainer::FindAttrIndex(const Attr::AttributeID& attrId) const
+{
+    return this->schema->GetSlot(attrId);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Return true if an attribute exists.
+*/
+inline
+bool
+AttributeContainer::HasAttr(const Attr::AttributeID& id) const
+{
+    return (-1 != this->FindAttrIndex(id));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get generic attribute. Throws a hard error if the
+    attribute doesn't exist.
+*/
+inline
+const Attribute&
+AttributeContainer::GetAttr(const Attr::AttributeID& attrId) const
+{
+    n_assert(attrId.IsValid());
+    int attrIndex = this->FindAttrIndex(attrId);
+    if (-1 != attrIndex)
+    {
+        return this->attrs[attrIndex];
+    }
+    else
+    {
+        n_error("Db::AttributeContainer::GetAttr(): attr '%s' not found!", attrId.GetName().Get());
+        return this->attrs[0]; // silence the compiler
+    }
+}
+
 } // namespace Db
 //------------------------------------------------------------------------------
 #endif
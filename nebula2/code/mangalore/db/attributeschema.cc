@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+//  db/attributeschema.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "db/attributeschema.h"
+
+namespace Db
+{
+
+//------------------------------------------------------------------------------
+/**
+    NOTE: the empty schema is created on demand, since containers may
+    be constructed during static initialization.
+*/
+AttributeSchema*
+AttributeSchema::GetEmpty()
+{
+    static AttributeSchema emptySchema(0, Attr::AttributeID());
+    return &emptySchema;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+AttributeSchema::AttributeSchema(AttributeSchema* p, const Attr::AttributeID& id) :
+    parent(p),
+    attrId(id),
+    numSlots(p ? p->numSlots + 1 : 0),
+    children(0, 4),
+    slots(0, 64),
+    slotsValid(false)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+AttributeSchema::~AttributeSchema()
+{
+    int i;
+    for (i = 0; i < this->children.Size(); i++)
+    {
+        n_delete(this->children[i].schema);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the schema which has the same slots as this schema, and the
+    given attribute in an additional last slot. The attribute must not
+    be in this schema already.
+*/
+AttributeSchema*
+AttributeSchema::Append(const Attr::AttributeID& id)
+{
+    n_assert(id.IsValid());
+    int attrIndex = id.GetIndex();
+    int i;
+    for (i = 0; i < this->children.Size(); i++)
+    {
+        if (this->children[i].attrIndex == attrIndex)
+        {
+            return this->children[i].schema;
+        }
+    }
+    Child child;
+    child.attrIndex = attrIndex;
+    child.schema = n_new(AttributeSchema(this, id));
+    this->children.Append(child);
+    return child.schema;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Builds the slot table by walking up to the empty schema. The table
+    covers all attribute ids which exist when it is built, ids which are
+    created later are never in the schema.
+*/
+void
+AttributeSchema::UpdateSlots() const
+{
+    n_assert(!this->slotsValid);
+    int numIds = _attrid::GetNumIds();
+    this->slots.SetFixedSize(numIds);
+    this->slots.Fill(0, numIds, -1);
+    const AttributeSchema* schema;
+    for (schema = this; schema->parent != 0; schema = schema->parent)
+    {
+        this->slots[schema->attrId.GetIndex()] = short(schema->numSlots - 1);
+    }
+    this->slotsValid = true;
+}
+
+} // namespace Db
@@ -0,0 +1,98 @@
+#ifndef DB_ATTRIBUTESCHEMA_H
+#define DB_ATTRIBUTESCHEMA_H
+//------------------------------------------------------------------------------
+/**
+    @class Db::AttributeSchema
+
+    Describes the layout of an AttributeContainer: which attributes
+    the container holds, and at which index (slot) of its attribute
+    array. A schema maps an attribute id to its slot with a table lookup,
+    so that finding an attribute doesn't need to search the attributes.
+
+    Schemas are shared. Starting with the empty schema, adding an
+    attribute to a container moves the container to the schema which
+    has the attribute appended. These schemas are created once and
+    remembered, so all containers which have been set up with the same
+    attributes in the same order (for instance all entities of one
+    category) share the same schema. Schemas are never destroyed
+    before the application exits.
+
+    The slot table of a schema is only built when the schema is used for
+    a lookup, since most schemas are only passed through while a
+    container is set up.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "util/narray.h"
+#include "attr/attributeid.h"
+
+//------------------------------------------------------------------------------
+namespace Db
+{
+class AttributeSchema
+{
+public:
+    /// get the shared empty schema
+    static AttributeSchema* GetEmpty();
+    /// get the slot index of an attribute, -1 if not in the schema
+    int GetSlot(const Attr::AttributeID& attrId) const;
+    /// get the number of slots
+    int GetNumSlots() const;
+    /// get the schema which has an attribute appended
+    AttributeSchema* Append(const Attr::AttributeID& attrId);
+
+private:
+    /// constructor
+    AttributeSchema(AttributeSchema* parent, const Attr::AttributeID& attrId);
+    /// destructor
+    ~AttributeSchema();
+    /// build the slot table
+    void UpdateSlots() const;
+
+    /// a schema derived from this schema
+    struct Child
+    {
+        int attrIndex;
+        AttributeSchema* schema;
+    };
+
+    AttributeSchema* parent;
+    Attr::AttributeID attrId;           ///< the attribute in the last slot
+    int numSlots;
+    nArray<Child> children;
+    mutable nArray<short> slots;        ///< slot indices by attribute id index
+    mutable bool slotsValid;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+AttributeSchema::GetSlot(const Attr::AttributeID& attrId) const
+{
+    if (!this->slotsValid)
+    {
+        this->UpdateSlots();
+    }
+    int attrIndex = attrId.GetIndex();
+    if (attrIndex < this->slots.Size())
+    {
+        return this->slots[attrIndex];
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+AttributeSchema::GetNumSlots() const
+{
+    return this->numSlots;
+}
+
+} // namespace Db
+//------------------------------------------------------------------------------
+#endif
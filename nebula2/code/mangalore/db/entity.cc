@@ -107,18 +107,6 @@ Entity::Save()
     }
 }
 
-//------------------------------------------------------------------------------
-/**
-    Return true if an attribute exists on the db entity. Note that you
-    can call this method also directly with a string attribute name, since
-    Id has a constructor from string.
-*/
-bool
-Entity::HasAttr(const Attr::AttributeID& id) const
-{
-    return this->attrs.HasAttr(id);
-}
-
 //------------------------------------------------------------------------------
 /**
     Set a generic attribute on the entity. If the attribute exists, its
@@ -133,17 +121,6 @@ Entity::SetAttr(const Attribute& attr)
     this->attrs.SetAttr(attr);
 }
 
-//------------------------------------------------------------------------------
-/**
-    Get generic attribute from the entity. Throws a hard error if the
-    attribute doesn't exist.
-*/
-const Attribute&
-Entity::GetAttr(const Attr::AttributeID& attrId) const
-{
-    return this->attrs.GetAttr(attrId);
-}
-
 //------------------------------------------------------------------------------
 /**
     This method provides direct read access to the attributes.
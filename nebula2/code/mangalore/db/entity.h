@@ -79,6 +79,31 @@ Entity::GetTableName() const
     return this->tableName;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Return true if an attribute exists on the db entity. Note that you
+    can call this method also directly with a string attribute name, since
+    Id has a constructor from string.
+*/
+inline
+bool
+Entity::HasAttr(const Attr::AttributeID& id) const
+{
+    return this->attrs.HasAttr(id);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get generic attribute from the entity. Throws a hard error if the
+    attribute doesn't exist.
+*/
+inline
+const Attribute&
+Entity::GetAttr(const Attr::AttributeID& attrId) const
+{
+    return this->attrs.GetAttr(attrId);
+}
+
 };  // namespace Db
 //------------------------------------------------------------------------------
 #endif
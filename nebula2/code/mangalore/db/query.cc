@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "db/query.h"
 #include "db/server.h"
+#include "util/nfixedarray.h"
 
 namespace Db
 {
@@ -15,9 +16,14 @@ ImplementFactory(Db::Query);
 */
 Query::Query() :
     whereAttrs(32, 32),
-    updateAttrs(128, 128)
+    updateAttrs(128, 128),
+    bindAttrs(32, 32),
+    isBuiltStatement(false),
+    result(1024, 1024),
+    numResultColumns(0),
+    numResultRows(0)
 {
-    // empty
+    this->result.SetFlags(nArray<Attribute>::DoubleGrowSize);
 }
 
 //------------------------------------------------------------------------------
@@ -28,6 +34,29 @@ Query::~Query()
     // empty
 }
 
+//------------------------------------------------------------------------------
+/**
+    Appends the WHERE clause for the WHERE attributes to the SQL statement,
+    and adds the WHERE attributes to the parameter values.
+*/
+void
+Query::AppendWhereClause()
+{
+    this->sqlStatement.Append(" WHERE ");
+    for (int i = 0; i < this->whereAttrs.Size(); i++)
+    {
+        bool lastElement = (i + 1) >= this->whereAttrs.Size();
+        nString clause;
+        clause.Format("%s (%s=?) %s",
+            this->whereAttrs[i].not ? "NOT" : "",
+            this->whereAttrs[i].attr.GetName().Get(),
+            !lastElement ? "AND " : ""
+            );
+        this->sqlStatement.Append(clause);
+        this->bindAttrs.Append(this->whereAttrs[i].attr);
+    }
+}
+
 //------------------------------------------------------------------------------
 /**
     This method constructs an attribute-type-safe SELECT statement.
@@ -43,6 +72,8 @@ Query::BuildSelectStatement()
 {
     n_assert(this->tableName.IsValid());
 
+    this->bindAttrs.Clear();
+    this->isBuiltStatement = true;
     this->sqlStatement = "SELECT ";
     if (this->resultAttrs.Size() == 0)
     {
@@ -50,30 +81,13 @@ Query::BuildSelectStatement()
     }
     else
     {
-        nArray<nString> resultStrings;
-        for (int i = 0; i < this->resultAttrs.Size(); i++)
-        {
-            resultStrings.Append(this->resultAttrs[i]);
-        }
-        this->sqlStatement.Append(nString::Concatenate(resultStrings, ","));
+        this->sqlStatement.Append(nString::Concatenate(this->resultAttrs, ","));
     }
     this->sqlStatement.Append(" FROM ");
     this->sqlStatement.Append(this->tableName);
     if (this->whereAttrs.Size() > 0)
     {
-        this->sqlStatement.Append(" WHERE ");
-        for (int i = 0; i < this->whereAttrs.Size(); i++)
-        {
-            bool lastElement = (i + 1) >= this->whereAttrs.Size();
-            nString clause;
-            clause.Format("%s (%s='%s') %s",
-                this->whereAttrs[i].not ? "NOT" : "",
-                this->whereAttrs[i].attr.GetName().Get(),
-                this->whereAttrs[i].attr.AsString().Get(),
-                !lastElement ? "AND " : ""
-                );
-            this->sqlStatement.Append(clause);
-        }
+        this->AppendWhereClause();
     }
 }
 
@@ -88,6 +102,8 @@ Query::BuildUpdateStatement()
     n_assert(this->updateAttrs.Size() > 0);
     n_assert(this->whereAttrs.Size() > 0);
 
+    this->bindAttrs.Clear();
+    this->isBuiltStatement = true;
     this->sqlStatement = "UPDATE ";
     this->sqlStatement.Append(this->tableName);
     this->sqlStatement.Append(" SET ");
@@ -95,30 +111,17 @@ Query::BuildUpdateStatement()
     {
         this->sqlStatement.Append("\"");
         this->sqlStatement.Append(this->updateAttrs[i].GetName());
-        this->sqlStatement.Append("\"='");
-        this->sqlStatement.Append(this->updateAttrs[i].AsString());
         if ((i + 1) < this->updateAttrs.Size())
         {
-            this->sqlStatement.Append("', ");
+            this->sqlStatement.Append("\"=?, ");
         }
         else
         {
-            this->sqlStatement.Append("'");
+            this->sqlStatement.Append("\"=?");
         }
+        this->bindAttrs.Append(this->updateAttrs[i]);
     }
-    this->sqlStatement.Append(" WHERE ");
-    for (int i = 0; i < this->whereAttrs.Size(); i++)
-    {
-        bool lastElement = (i + 1) >= this->whereAttrs.Size();
-        nString clause;
-        clause.Format("%s (%s='%s') %s",
-            this->whereAttrs[i].not ? "NOT" : "",
-            this->whereAttrs[i].attr.GetName().Get(),
-            this->whereAttrs[i].attr.AsString().Get(),
-            !lastElement ? "AND " : ""
-            );
-        this->sqlStatement.Append(clause);
-    }
+    this->AppendWhereClause();
 }
 
 //------------------------------------------------------------------------------
@@ -131,28 +134,174 @@ Query::BuildDeleteStatement()
     n_assert(this->tableName.IsValid());
     n_assert(this->whereAttrs.Size() > 0);
 
+    this->bindAttrs.Clear();
+    this->isBuiltStatement = true;
     this->sqlStatement = "DELETE FROM ";
     this->sqlStatement.Append(this->tableName);
+    this->AppendWhereClause();
+}
 
-    this->sqlStatement.Append(" WHERE ");
-    if (this->whereAttrs.Size() == 0)
-    {
-        this->sqlStatement.Append(" *");
-    }
-    else
+//------------------------------------------------------------------------------
+/**
+    Binds an attribute value to a parameter of a prepared statement. Ints
+    and strings are bound with their native type. Floats and bools are
+    bound as text ("%f" and "true"/"false"), which is how they have always
+    been stored: the columns have TEXT affinity, so a float bound as a
+    number would be stored and compared as "1.5" instead of "1.500000",
+    and WHERE clauses wouldn't match older rows anymore. Vectors and
+    matrices are bound as BLOBs of 3, 4 or 16 floats, this is much faster
+    and more compact than a text conversion, and is lossless. An empty
+    string is bound as '' like before, other empty attributes as null.
+*/
+void
+Query::BindAttr(nSqlStatement* statement, int paramIndex, const Attribute& attr)
+{
+    n_assert(statement);
+    if (attr.IsEmpty())
     {
-        for (int i = 0; i < this->whereAttrs.Size(); i++)
+        if (Attribute::String == attr.GetType())
         {
-            bool lastElement = (i + 1) >= this->whereAttrs.Size();
-            nString clause;
-            clause.Format("%s (%s='%s') %s",
-                this->whereAttrs[i].not ? "NOT" : "",
-                this->whereAttrs[i].attr.GetName().Get(),
-                this->whereAttrs[i].attr.AsString().Get(),
-                !lastElement ? "AND " : ""
-                );
-            this->sqlStatement.Append(clause);
+            statement->BindString(paramIndex, nString());
         }
+        else
+        {
+            statement->BindNull(paramIndex);
+        }
+        return;
+    }
+    switch (attr.GetType())
+    {
+        case Attribute::Int:
+            statement->BindInt(paramIndex, attr.GetInt());
+            break;
+
+        case Attribute::Float:
+            statement->BindString(paramIndex, attr.AsString());
+            break;
+
+        case Attribute::Bool:
+            statement->BindString(paramIndex, attr.AsString());
+            break;
+
+        case Attribute::String:
+            statement->BindString(paramIndex, attr.GetString());
+            break;
+
+        case Attribute::Vector3:
+            {
+                const vector3& v = attr.GetVector3();
+                float blob[3] = { v.x, v.y, v.z };
+                statement->BindBlob(paramIndex, blob, sizeof(blob));
+            }
+            break;
+
+        case Attribute::Vector4:
+            {
+                const vector4& v = attr.GetVector4();
+                float blob[4] = { v.x, v.y, v.z, v.w };
+                statement->BindBlob(paramIndex, blob, sizeof(blob));
+            }
+            break;
+
+        case Attribute::Matrix44:
+            {
+                const matrix44& m = attr.GetMatrix44();
+                float blob[16];
+                memcpy(blob, m.m, sizeof(blob));
+                statement->BindBlob(paramIndex, blob, sizeof(blob));
+            }
+            break;
+
+        default:
+            n_error("Query::BindAttr(): invalid attribute type of '%s'!", attr.GetName().Get());
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Reads the value of a non-null column of a prepared statement's current
+    row into an attribute, the attribute id must already be set. Vectors
+    and matrices are read from BLOBs, but also from text fields written by
+    older versions or by the level exporter.
+*/
+void
+Query::ReadAttr(nSqlStatement* statement, int colIndex, Attribute& attr)
+{
+    n_assert(statement);
+    nSqlStatement::ColumnType colType = statement->GetColumnType(colIndex);
+    const void* blob = 0;
+    int blobSize = 0;
+    if (nSqlStatement::Blob == colType)
+    {
+        blob = statement->GetBlob(colIndex, blobSize);
+    }
+    switch (attr.GetType())
+    {
+        case Attribute::Int:
+            attr.SetInt(statement->GetInt(colIndex));
+            break;
+
+        case Attribute::Float:
+            attr.SetFloat(statement->GetFloat(colIndex));
+            break;
+
+        case Attribute::Bool:
+            if (nSqlStatement::Int == colType)
+            {
+                attr.SetBool(0 != statement->GetInt(colIndex));
+            }
+            else
+            {
+                attr.SetBool(statement->GetString(colIndex).AsBool());
+            }
+            break;
+
+        case Attribute::String:
+            attr.SetString(statement->GetString(colIndex));
+            break;
+
+        case Attribute::Vector3:
+            if (blobSize == 3 * sizeof(float))
+            {
+                const float* f = (const float*) blob;
+                attr.SetVector3(vector3(f[0], f[1], f[2]));
+            }
+            else
+            {
+                attr.SetVector3(statement->GetString(colIndex).AsVector3());
+            }
+            break;
+
+        case Attribute::Vector4:
+            if (blobSize == 4 * sizeof(float))
+            {
+                const float* f = (const float*) blob;
+                attr.SetVector4(vector4(f[0], f[1], f[2], f[3]));
+            }
+            else
+            {
+                attr.SetVector4(statement->GetString(colIndex).AsVector4());
+            }
+            break;
+
+        case Attribute::Matrix44:
+            if (blobSize == 16 * sizeof(float))
+            {
+                matrix44 m;
+                memcpy(m.m, blob, 16 * sizeof(float));
+                attr.SetMatrix44(m);
+            }
+            else
+            {
+                attr.SetMatrix44(statement->GetString(colIndex).AsMatrix44());
+            }
+            break;
+
+        default:
+            n_error("Query::ReadAttr(): invalid attribute type!");
+            attr.Clear();
+            break;
     }
 }
 
@@ -160,103 +309,110 @@ Query::BuildDeleteStatement()
 /**
     This executes the stored SQL query on the world.db, converts the result into
     attribute form, and stores the result in the query object.
+
+    Built statements are taken from the Db::Server's statement cache,
+    other SQL statements are compiled for this execution only. Columns
+    which are null in every row are removed from the result.
 */
 bool
 Query::Execute(bool failOnError)
 {
     n_assert(this->sqlStatement.IsValid());
-    nSqlDatabase* db = Server::Instance()->GetSqlDatabase();
+    this->result.Clear();
+    this->numResultColumns = 0;
+    this->numResultRows = 0;
 
-    // create a Nebula2 sqlQuery object
-    nSqlQuery* sqlQuery = db->CreateQuery(this->sqlStatement);
-    bool querySuccess = sqlQuery->Execute(failOnError);
+    nSqlStatement* statement = 0;
+    if (this->isBuiltStatement)
+    {
+        statement = Server::Instance()->GetStatement(this->sqlStatement, failOnError);
+    }
+    else
+    {
+        statement = Server::Instance()->GetSqlDatabase()->CreateStatement(this->sqlStatement, failOnError);
+    }
+    if (0 == statement)
+    {
+        return false;
+    }
 
-    // convert result to Mangalore attributes
-    this->result.SetSize(sqlQuery->GetColumns().Size(), sqlQuery->GetNumRows());
+    // bind parameter values
+    int paramIndex;
+    for (paramIndex = 0; paramIndex < this->bindAttrs.Size(); paramIndex++)
+    {
+        BindAttr(statement, paramIndex, this->bindAttrs[paramIndex]);
+    }
 
-    // create a reference array of attributes
-    const nArray<nString>& resColumns = sqlQuery->GetColumns();
+    // lookup attribute ids of the result columns (the column names
+    // are valid after the first step)
+    nSqlStatement::Result stepResult = statement->Step(failOnError);
+    const nArray<nString>& resColumns = statement->GetColumns();
     int colIndex;
     int numCols = resColumns.Size();
-    nFixedArray<Attribute> attrs(numCols);
+    nFixedArray<Attr::AttributeID> attrIds(numCols);
+    nFixedArray<int> validFields(numCols);
+    validFields.Clear(0);
     for (colIndex = 0; colIndex < numCols; colIndex++)
     {
-        const nString& columnTitle = resColumns[colIndex];
-        Attr::AttributeID attrId = Attr::AttributeID::FindAttributeID(columnTitle);
-        if (!attrId.IsValid())
-        {
-            n_error("Query::Execute(): Error in table \"%s\", unknown attribute ID \"%s\"\n(SQL Statement: %s)",
-                    this->tableName.Get(),
-                    columnTitle.Get(),
-                    sqlQuery->GetSqlStatement().Get());
-        }
-
-        attrs[colIndex].SetAttributeID(attrId);
+        attrIds[colIndex] = Attr::AttributeID::FindAttributeID(resColumns[colIndex]);
     }
 
-    // convert attributes and write to result array, hmm, this
-    // is not very elegant because of the null-field handling
-    // [np]: changed to only clear attribute if it cannot be set
-    int rowIndex;
-    int numRows = sqlQuery->GetNumRows();
-    for (rowIndex = 0; rowIndex < numRows; rowIndex++)
+    // convert rows to attributes, null fields become empty attributes
+    while (nSqlStatement::Row == stepResult)
     {
-        nSqlRow sqlRow = sqlQuery->GetRow(rowIndex);
-        int colIndex;
-        int numCols = resColumns.Size();
         for (colIndex = 0; colIndex < numCols; colIndex++)
         {
-            if (sqlRow.HasColumn(resColumns[colIndex]))
+            Attribute& attr = this->result.PushBack(Attribute(attrIds[colIndex]));
+            if (nSqlStatement::Null != statement->GetColumnType(colIndex))
             {
-                const nString& valueString = sqlRow.Get(resColumns[colIndex]);
-                switch (attrs[colIndex].GetType())
+                if (!attrIds[colIndex].IsValid())
                 {
-                    case Attribute::Int:
-                        attrs[colIndex].SetInt(valueString.AsInt());
-                        break;
-
-                    case Attribute::Float:
-                        attrs[colIndex].SetFloat(valueString.AsFloat());
-                        break;
-
-                    case Attribute::Bool:
-                        attrs[colIndex].SetBool(valueString.AsBool());
-                        break;
-
-                    case Attribute::Vector3:
-                        attrs[colIndex].SetVector3(valueString.AsVector3());
-                        break;
-
-                    case Attribute::Vector4:
-                        attrs[colIndex].SetVector4(valueString.AsVector4());
-                        break;
-
-                    case Attribute::String:
-                        attrs[colIndex].SetString(valueString);
-                        break;
-
-                    case Attribute::Matrix44:
-                        attrs[colIndex].SetMatrix44(valueString.AsMatrix44());
-                        break;
-
-                    default:
-                        n_error("Query::Execute(): invalid attribute type!");
-                        attrs[colIndex].Clear();
-                        break;
-
+                    n_error("Query::Execute(): Error in table \"%s\", unknown attribute ID \"%s\"\n(SQL Statement: %s)",
+                            this->tableName.Get(),
+                            resColumns[colIndex].Get(),
+                            this->sqlStatement.Get());
                 }
-
-                this->result.At(colIndex, rowIndex) = attrs[colIndex];
+                ReadAttr(statement, colIndex, attr);
+                validFields[colIndex]++;
             }
-            else
+        }
+        this->numResultRows++;
+        stepResult = statement->Step(failOnError);
+    }
+    statement->Reset();
+    if (!this->isBuiltStatement)
+    {
+        statement->Release();
+    }
+    this->numResultColumns = numCols;
+
+    // remove columns without any valid field
+    int numValidCols = 0;
+    for (colIndex = 0; colIndex < numCols; colIndex++)
+    {
+        if (validFields[colIndex] > 0)
+        {
+            numValidCols++;
+        }
+    }
+    if (numValidCols < numCols)
+    {
+        nArray<Attribute> validResult(numValidCols * this->numResultRows + 1, 1024);
+        int rowIndex;
+        for (rowIndex = 0; rowIndex < this->numResultRows; rowIndex++)
+        {
+            for (colIndex = 0; colIndex < numCols; colIndex++)
             {
-                // no column
-                this->result.At(colIndex, rowIndex).Clear();
+                if (validFields[colIndex] > 0)
+                {
+                    validResult.Append(this->result[rowIndex * numCols + colIndex]);
+                }
             }
         }
+        this->result = validResult;
+        this->numResultColumns = numValidCols;
     }
-    sqlQuery->Release();
-    return querySuccess;
+    return (nSqlStatement::Error != stepResult);
 }
 
 //------------------------------------------------------------------------------
@@ -274,7 +430,7 @@ Query::HasColumn(const Attr::AttributeID& attrId) const
         int numCols = this->GetNumColumns();
         for (colIndex = 0; colIndex < numCols; colIndex++)
         {
-            if (this->result.At(colIndex, 0).GetAttributeID() == attrId)
+            if (this->GetAttr(colIndex, 0).GetAttributeID() == attrId)
             {
                 return true;
             }
@@ -295,9 +451,10 @@ Query::HasAttr(const Attr::AttributeID& attrId, int rowIndex) const
     int numCols = this->GetNumColumns();
     for (colIndex = 0; colIndex < numCols; colIndex++)
     {
-        if (this->result.At(colIndex, rowIndex).GetAttributeID() == attrId)
+        const Attribute& attr = this->GetAttr(colIndex, rowIndex);
+        if (attr.GetAttributeID() == attrId)
         {
-            return !this->result.At(colIndex, rowIndex).IsEmpty();
+            return !attr.IsEmpty();
         }
     }
     // not found means not valid
@@ -316,9 +473,10 @@ Query::GetAttr(const Attr::AttributeID& attrId, int rowIndex) const
     int numCols = this->GetNumColumns();
     for (colIndex = 0; colIndex < numCols; colIndex++)
     {
-        if (this->result.At(colIndex, rowIndex).GetAttributeID() == attrId)
+        const Attribute& attr = this->GetAttr(colIndex, rowIndex);
+        if (attr.GetAttributeID() == attrId)
         {
-            return this->result.At(colIndex, rowIndex);
+            return attr;
         }
     }
     static Attribute invalidAttr;
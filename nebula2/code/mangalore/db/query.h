@@ -4,14 +4,22 @@
 /**
     @class Db::Query
 
-    This is a wrapper around Nebula2's nSqlQuery and provides
+    This is a wrapper around Nebula2's nSqlStatement and provides
     attribute-type-safe queries into the world database.
 
+    The Build*Statement() methods create SQL statements with parameters
+    instead of literal values, the WHERE and UPDATE attributes are bound
+    to the parameters with their native type when the query is executed.
+    Since a built statement only depends on the table and the attribute
+    ids, it is compiled once and then cached by the Db::Server. Vector
+    and matrix attributes are stored as fixed size BLOBs (see BindAttr()),
+    but may be read from text fields as well.
+
     (C) 2005 Radon Labs GmbH
 */
 #include "foundation/refcounted.h"
-#include "sql/nsqlquery.h"
-#include "util/narray2.h"
+#include "sql/nsqlstatement.h"
+#include "util/narray.h"
 #include "db/attribute.h"
 
 //------------------------------------------------------------------------------
@@ -77,7 +85,15 @@ public:
     /// return a single attribute value by attribute id
     matrix44 GetMatrix44(const Attr::Matrix44AttributeID& attrId, int rowIndex) const;
 
+    /// bind an attribute value to a parameter of a prepared statement
+    static void BindAttr(nSqlStatement* statement, int paramIndex, const Attribute& attr);
+    /// read an attribute value from a column of a prepared statement's current row
+    static void ReadAttr(nSqlStatement* statement, int colIndex, Attribute& attr);
+
 private:
+    /// append WHERE clause to the SQL statement
+    void AppendWhereClause();
+
     nString tableName;
     nArray<nString> resultAttrs;
 
@@ -89,8 +105,12 @@ private:
 
     nArray<WhereAttr> whereAttrs;
     nArray<Db::Attribute> updateAttrs;
+    nArray<Db::Attribute> bindAttrs;    // parameter values of a built statement
     nString sqlStatement;
-    nArray2<Attribute> result;
+    bool isBuiltStatement;
+    nArray<Attribute> result;           // row-major result table
+    int numResultColumns;
+    int numResultRows;
 };
 
 RegisterFactory(Query);
@@ -147,6 +167,8 @@ void
 Query::SetSqlStatement(const nString& sql)
 {
     this->sqlStatement = sql;
+    this->bindAttrs.Clear();
+    this->isBuiltStatement = false;
 }
 
 //------------------------------------------------------------------------------
@@ -166,7 +188,7 @@ inline
 int
 Query::GetNumColumns() const
 {
-    return this->result.GetWidth();
+    return this->numResultColumns;
 }
 
 //------------------------------------------------------------------------------
@@ -176,7 +198,7 @@ inline
 int
 Query::GetNumRows() const
 {
-    return this->result.GetHeight();
+    return this->numResultRows;
 }
 
 //------------------------------------------------------------------------------
@@ -188,7 +210,7 @@ inline
 bool
 Query::HasAttr(int colIndex, int rowIndex) const
 {
-    return !this->result.At(colIndex, rowIndex).IsEmpty();
+    return !this->GetAttr(colIndex, rowIndex).IsEmpty();
 }
 
 //------------------------------------------------------------------------------
@@ -200,7 +222,9 @@ inline
 const Attribute&
 Query::GetAttr(int colIndex, int rowIndex) const
 {
-    return this->result.At(colIndex, rowIndex);
+    n_assert((colIndex >= 0) && (colIndex < this->numResultColumns));
+    n_assert((rowIndex >= 0) && (rowIndex < this->numResultRows));
+    return this->result[rowIndex * this->numResultColumns + colIndex];
 }
 
 //------------------------------------------------------------------------------
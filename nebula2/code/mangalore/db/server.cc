@@ -6,6 +6,7 @@
 #include "foundation/factory.h"
 #include "db/query.h"
 #include "sql/nsqlserver.h"
+#include "sql/nsqlquery.h"
 #include "kernel/nguid.h"
 #include "db/reader.h"
 #include "db/writer.h"
@@ -26,6 +27,10 @@ Server::Server() :
 {
     n_assert(0 == Singleton);
     Singleton = this;
+
+    // the columns by which entities are looked up
+    this->entityIndexColumns.Append("GUID");
+    this->entityIndexColumns.Append("Name");
 }
 
 //------------------------------------------------------------------------------
@@ -52,6 +57,14 @@ Server::Open()
     this->refSqlDatabase = nSqlServer::Instance()->NewDatabase(this->dbFilename);
     this->isOpen = this->refSqlDatabase.isvalid();
     this->LoadGlobalAttributes();
+    if (this->isOpen)
+    {
+        int i;
+        for (i = 0; i < this->entityIndexColumns.Size(); i++)
+        {
+            this->CreateEntityIndex(this->entityIndexColumns[i]);
+        }
+    }
     return this->isOpen;
 }
 
@@ -64,6 +77,7 @@ Server::Close()
 {
     n_assert(this->IsOpen());
     this->SaveGlobalAttributes();
+    this->ClearStatements();
     this->refSqlDatabase->Release();
     n_assert(!this->refSqlDatabase.isvalid());
     this->isOpen = false;
@@ -105,6 +119,111 @@ Server::CreateQuery() const
     return Query::Create();
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns a prepared statement for the given SQL statement. Statements
+    are compiled on first use and cached until the server is closed, so
+    statements which are used repeatedly (like the statements built by
+    Db::Query and Db::Writer) should use parameters instead of literal
+    values. The returned statement is owned by the server, it must be
+    reset after use but not released.
+*/
+nSqlStatement*
+Server::GetStatement(const nString& sqlStatement, bool failOnError)
+{
+    n_assert(this->IsOpen());
+    nSqlStatement* statement = 0;
+    if (!this->statementMap.Find(sqlStatement.Get(), statement))
+    {
+        statement = this->refSqlDatabase->CreateStatement(sqlStatement, failOnError);
+        if (0 != statement)
+        {
+            this->statementMap.Add(statement->GetSqlStatement().Get(), statement);
+            this->statements.Append(statement);
+        }
+    }
+    return statement;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Releases all cached prepared statements. This happens automatically
+    when the server is closed.
+*/
+void
+Server::ClearStatements()
+{
+    int i;
+    for (i = 0; i < this->statements.Size(); i++)
+    {
+        this->statements[i]->Release();
+    }
+    this->statements.Clear();
+    this->statementMap.Clear();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add a column of the _Entities table which is used to look up entities,
+    so that it gets a database index. The index is created immediately if
+    the database is open, and when a database is opened later (for
+    instance a savegame). GUID and Name are indexed by default.
+*/
+void
+Server::AddEntityIndexColumn(const nString& columnName)
+{
+    n_assert(columnName.IsValid());
+    if (0 == this->entityIndexColumns.Find(columnName))
+    {
+        this->entityIndexColumns.Append(columnName);
+        if (this->IsOpen())
+        {
+            this->CreateEntityIndex(columnName);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create the index named _Entities_[column]_Index over a column of
+    the _Entities table, unless it already exists. Nothing happens if the
+    table or the column doesn't exist (yet), a column which is added later
+    gets its index when the database is opened again. The index is stored
+    in the database file, so this only costs time once per database.
+*/
+void
+Server::CreateEntityIndex(const nString& columnName)
+{
+    n_assert(this->IsOpen());
+    if (!this->refSqlDatabase->HasTable("_Entities"))
+    {
+        return;
+    }
+    nArray<nString> columns = this->refSqlDatabase->GetColumns("_Entities");
+    if (0 == columns.Find(columnName))
+    {
+        return;
+    }
+
+    nString indexName;
+    indexName.Format("_Entities_%s_Index", columnName.Get());
+    nString sql;
+    sql.Format("SELECT name FROM sqlite_master WHERE type='index' AND name='%s'", indexName.Get());
+    nSqlQuery* query = this->refSqlDatabase->CreateQuery(sql);
+    bool hasIndex = query->Execute(false) && (query->GetNumRows() > 0);
+    query->Release();
+    if (!hasIndex)
+    {
+        sql.Format("CREATE INDEX %s ON _Entities ( %s )", indexName.Get(), columnName.Get());
+        query = this->refSqlDatabase->CreateQuery(sql);
+        if (!query->Execute(false))
+        {
+            n_printf("Db::Server: failed to create index '%s'!\n", indexName.Get());
+        }
+        query->Release();
+    }
+}
+
 //------------------------------------------------------------------------------
 /**
     Create an universal query object.
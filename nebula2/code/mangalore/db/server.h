@@ -14,6 +14,8 @@
 #include "foundation/refcounted.h"
 #include "foundation/ptr.h"
 #include "sql/nsqldatabase.h"
+#include "sql/nsqlstatement.h"
+#include "util/nstrhashmap.h"
 #include "util/nstring.h"
 #include "util/narray.h"
 #include "db/attribute.h"
@@ -59,6 +61,12 @@ public:
     virtual nSqlDatabase* GetSqlDatabase() const;
     /// create an empty query object
     virtual Query* CreateQuery() const;
+    /// get a cached prepared statement, returns 0 if invalid and failOnError is false
+    nSqlStatement* GetStatement(const nString& sqlStatement, bool failOnError = true);
+    /// release all cached prepared statements
+    void ClearStatements();
+    /// add a column of the _Entities table which should have a database index
+    void AddEntityIndexColumn(const nString& columnName);
 
     //=== global attributes ===
 
@@ -120,12 +128,17 @@ public:
 private:
     /// load global attributes from the database
     void LoadGlobalAttributes();
+    /// create the database index for a column of the _Entities table
+    void CreateEntityIndex(const nString& columnName);
 
     static Server* Singleton;
     nString dbFilename;
     nRef<nSqlDatabase> refSqlDatabase;
     bool isOpen;
     AttributeContainer globalAttrs;
+    nStrHashMap<nSqlStatement*> statementMap;   // keys are the SQL statements
+    nArray<nSqlStatement*> statements;
+    nArray<nString> entityIndexColumns;
 };
 
 RegisterFactory(Server);
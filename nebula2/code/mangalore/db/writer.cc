@@ -5,6 +5,7 @@
 #include "db/writer.h"
 #include "db/server.h"
 #include "sql/nsqldatabase.h"
+#include "sql/nsqlstatement.h"
 
 namespace Db
 {
@@ -112,24 +113,86 @@ Writer::Close()
             sqlDatabase->CreateTable(this->tableName, columnTitles, this->primaryKeyAttrId.GetName());
         }
 
-        // insert the row, this will automatically replace colliding
-        // rows (usually GUID is set to collision)
+        // insert the rows with prepared statements, rows with the same
+        // columns share a statement, colliding rows will automatically be
+        // replaced (usually GUID is set to collision)
+        nSqlStatement* statement = 0;
         int rowIndex;
         for (rowIndex = 0; rowIndex < this->rows.Size(); rowIndex++)
         {
             const nArray<Attribute>& rowData = this->rows[rowIndex];
-            nSqlRow sqlRow;
+            if (rowData.Size() == 0)
+            {
+                continue;
+            }
+            if ((0 == statement) || !HasSameColumns(this->rows[rowIndex - 1], rowData))
+            {
+                statement = this->GetInsertStatement(rowData);
+            }
             int attrIndex;
             for (attrIndex = 0; attrIndex < rowData.Size(); attrIndex++)
             {
-                sqlRow.Set(rowData[attrIndex].GetName(), rowData[attrIndex].AsString());
+                Query::BindAttr(statement, attrIndex, rowData[attrIndex]);
             }
-            sqlDatabase->InsertRow(this->tableName, sqlRow);
+            statement->Step();
+            statement->Reset();
         }
     }
     this->isOpen = false;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns true if two rows have the same attributes in the same order.
+*/
+bool
+Writer::HasSameColumns(const nArray<Attribute>& row0, const nArray<Attribute>& row1)
+{
+    if (row0.Size() != row1.Size())
+    {
+        return false;
+    }
+    int i;
+    for (i = 0; i < row0.Size(); i++)
+    {
+        if (row0[i].GetAttributeID() != row1[i].GetAttributeID())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the prepared INSERT statement for the columns of a row from
+    the Db::Server's statement cache. The row's attributes are bound to
+    the statement's parameters in their order.
+*/
+nSqlStatement*
+Writer::GetInsertStatement(const nArray<Attribute>& row) const
+{
+    nString sql("INSERT INTO ");
+    sql.Append(this->tableName);
+    sql.Append(" ('");
+    int i;
+    for (i = 0; i < row.Size(); i++)
+    {
+        if (i > 0)
+        {
+            sql.Append("', '");
+        }
+        sql.Append(row[i].GetName());
+    }
+    sql.Append("') VALUES (?");
+    for (i = 1; i < row.Size(); i++)
+    {
+        sql.Append(", ?");
+    }
+    sql.Append(")");
+    return Server::Instance()->GetStatement(sql);
+}
+
 //------------------------------------------------------------------------------
 /**
     Begin writing a new row to the database.
@@ -5,7 +5,10 @@
     @class Db::Writer
 
     Used to batch-write data in a more abstract and efficient way than
-    Query. Updates the database layout if needed.
+    Query. Updates the database layout if needed. The rows are written
+    with prepared INSERT statements, which are cached by the Db::Server
+    per table and column set, the values are bound with their native
+    type (see Query::BindAttr()).
 
     (C) 2006 Radon Labs GmbH
 */
@@ -66,6 +69,10 @@ public:
 private:
     /// check if attribute exists in current row
     int FindAttrIndex(Attr::AttributeID id) const;
+    /// return true if two rows have the same columns
+    static bool HasSameColumns(const nArray<Attribute>& row0, const nArray<Attribute>& row1);
+    /// get the cached INSERT statement for the columns of a row
+    nSqlStatement* GetInsertStatement(const nArray<Attribute>& row) const;
 
     nString tableName;
     Attr::AttributeID primaryKeyAttrId;
@@ -8,6 +8,7 @@
 #include "mathlib/transform44.h"
 #include "foundation/factory.h"
 #include "application/app.h"
+#include "managers/entitymanager.h"
 
 namespace Game
 {
@@ -87,7 +88,16 @@ Entity::CleanupProperties()
 void
 Entity::LoadAttributesFromDatabase()
 {
+    bool hasEntityManager = Managers::EntityManager::HasInstance();
+    if (hasEntityManager)
+    {
+        Managers::EntityManager::Instance()->BeginUpdateAttrIndexes(this);
+    }
     this->dbEntity->Load();
+    if (hasEntityManager)
+    {
+        Managers::EntityManager::Instance()->EndUpdateAttrIndexes(this);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -101,7 +111,42 @@ Entity::LoadAttributesFromDatabase()
 void
 Entity::LoadAttributesFromDbReader(Db::Reader* dbReader)
 {
+    bool hasEntityManager = Managers::EntityManager::HasInstance();
+    if (hasEntityManager)
+    {
+        Managers::EntityManager::Instance()->BeginUpdateAttrIndexes(this);
+    }
     this->dbEntity->LoadFromReader(dbReader);
+    if (hasEntityManager)
+    {
+        Managers::EntityManager::Instance()->EndUpdateAttrIndexes(this);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set a generic attribute. If the attribute is indexed by the entity
+    manager (like GUID or Name), the index is updated.
+*/
+void
+Entity::SetAttr(const Db::Attribute& attr)
+{
+    if (Managers::EntityManager::HasInstance())
+    {
+        Managers::EntityManager::Instance()->UpdateAttrIndex(this, attr);
+    }
+    this->dbEntity->SetAttr(attr);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set a string attribute. If the attribute is indexed by the entity
+    manager, the index is updated.
+*/
+void
+Entity::SetString(Attr::StringAttributeID attrId, const nString& s)
+{
+    this->SetAttr(Db::Attribute(attrId, s));
 }
 
 //------------------------------------------------------------------------------
@@ -237,16 +237,6 @@ Entity::GetDispatcher() const
     return this->dispatcher;
 }
 
-//------------------------------------------------------------------------------
-/**
-*/
-inline
-void
-Entity::SetAttr(const Db::Attribute& attr)
-{
-    this->dbEntity->SetAttr(attr);
-}
-
 //------------------------------------------------------------------------------
 /**
 */
@@ -277,16 +267,6 @@ Entity::GetAttrs() const
     return this->dbEntity->GetAttrs();
 }
 
-//------------------------------------------------------------------------------
-/**
-*/
-inline
-void
-Entity::SetString(Attr::StringAttributeID attrId, const nString& s)
-{
-    this->dbEntity->SetAttr(Db::Attribute(attrId, s));
-}
-
 //------------------------------------------------------------------------------
 /**
 */
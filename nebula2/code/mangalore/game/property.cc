@@ -204,7 +204,9 @@ Property::OnRenderDebug()
 /**
     This method is inherited from the Port class. If your property acts as
     a message handler you must implement the Accepts() method to return
-    true for each message that is accepted. By default no messages are accepted.
+    true for each message that is accepted, and declare the accepted
+    message ids in SetupAcceptedMessages(). By default no messages are
+    accepted.
 */
 bool
 Property::Accepts(Message::Msg* msg)
@@ -212,6 +214,20 @@ Property::Accepts(Message::Msg* msg)
     return false;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Properties don't accept any messages by default, so unlike other
+    message ports, a property is only offered the messages it declares
+    here. If your property overrides Accepts(), it must also override
+    this method and register every message id that Accepts() may
+    return true for.
+*/
+void
+Property::SetupAcceptedMessages()
+{
+    // empty
+}
+
 //------------------------------------------------------------------------------
 /**
     This method is inherited from the Port class. If your property acts as
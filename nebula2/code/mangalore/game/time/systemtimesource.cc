@@ -7,6 +7,7 @@
 #include "physics/server.h"
 #include "vfx/server.h"
 #include "audio/server.h"
+#include "message/server.h"
 #include "graphics/server.h"
 #include "particle/nparticleserver2.h"
 
@@ -51,6 +52,7 @@ SystemTimeSource::UpdateTime(nTime fTime)
     Physics::Server::Instance()->SetTime(this->time);
     VFX::Server::Instance()->SetTime(this->time);
     Audio::Server::Instance()->SetTime(this->time);
+    Message::Server::Instance()->SetTime(this->time);
     Graphics::Server::Instance()->SetTime(this->time);
     Graphics::Server::Instance()->SetFrameTime(this->frameTime);
     nParticleServer2::Instance()->SetTime(this->time);
@@ -199,13 +199,16 @@ Server::Close()
     instead, the Windows message pump will be "pumped" in order to
     process any outstanding window system messages. The method returns
     false if the window system asks the application to quit (either because
-    the user has pressed the Close button, or hits Alt-F4).
+    the user has pressed the Close button, or hits Alt-F4). The resource
+    server is triggered as well, to finish deferred resource releases
+    of the resource loader on the main thread.
 
     @return     true as long as application should continue to run
 */
 bool
 Server::Trigger()
 {
+    nResourceServer::Instance()->Trigger();
     return nGfxServer2::Instance()->Trigger();
 }
 
@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+//  managers/entityattrindex.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "managers/entityattrindex.h"
+#include "game/entity.h"
+
+namespace Managers
+{
+
+//------------------------------------------------------------------------------
+/**
+*/
+EntityAttrIndex::EntityAttrIndex(const Attr::AttributeID& id) :
+    attrId(id),
+    bucketMap(1024),
+    freeBuckets(0, 64),
+    numEntities(0)
+{
+    n_assert(id.IsValid());
+    n_assert(Attr::String == id.GetType());
+}
+
+//------------------------------------------------------------------------------
+/**
+    NOTE: the buckets are only reachable through the bucket map, so the
+    index must be empty when it is destroyed.
+*/
+EntityAttrIndex::~EntityAttrIndex()
+{
+    n_assert(0 == this->numEntities);
+    n_assert(0 == this->bucketMap.Size());
+    int i;
+    for (i = 0; i < this->freeBuckets.Size(); i++)
+    {
+        n_delete(this->freeBuckets[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+EntityAttrIndex::Add(Game::Entity* entity)
+{
+    n_assert(entity);
+    if (entity->HasAttr(this->attrId))
+    {
+        this->Add(entity, entity->GetAttr(this->attrId).GetString());
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add an entity under the given value, this is used when the attribute
+    of the entity is about to change to this value.
+*/
+void
+EntityAttrIndex::Add(Game::Entity* entity, const nString& value)
+{
+    n_assert(entity);
+    Bucket* bucket = 0;
+    if (!this->bucketMap.Find(value.Get(), bucket))
+    {
+        if (this->freeBuckets.Size() > 0)
+        {
+            bucket = this->freeBuckets.Back();
+            this->freeBuckets.Erase(this->freeBuckets.Size() - 1);
+        }
+        else
+        {
+            bucket = n_new(Bucket);
+        }
+        bucket->value = value;
+        this->bucketMap.Add(bucket->value.Get(), bucket);
+    }
+    bucket->entities.Append(entity);
+    this->numEntities++;
+}
+
+//------------------------------------------------------------------------------
+/**
+    The bucket is searched from the back, since entities are usually
+    removed in reverse order (see EntityManager::RemoveAllEntities()).
+    Empty buckets are kept for reuse.
+*/
+void
+EntityAttrIndex::Remove(Game::Entity* entity)
+{
+    n_assert(entity);
+    if (!entity->HasAttr(this->attrId))
+    {
+        return;
+    }
+    nString value = entity->GetAttr(this->attrId).GetString();
+    Bucket* bucket = 0;
+    if (!this->bucketMap.Find(value.Get(), bucket))
+    {
+        n_error("Managers::EntityAttrIndex::Remove(): no entity with %s='%s' in index!", this->attrId.GetName().Get(), value.Get());
+        return;
+    }
+
+    int i;
+    for (i = bucket->entities.Size() - 1; i >= 0; i--)
+    {
+        if (bucket->entities[i] == entity)
+        {
+            break;
+        }
+    }
+    n_assert(i >= 0);
+    bucket->entities.Erase(i);
+    this->numEntities--;
+
+    if (0 == bucket->entities.Size())
+    {
+        this->bucketMap.Remove(bucket->value.Get(), bucket);
+        this->freeBuckets.Append(bucket);
+    }
+}
+
+} // namespace Managers
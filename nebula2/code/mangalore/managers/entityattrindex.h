@@ -0,0 +1,104 @@
+#ifndef MANAGERS_ENTITYATTRINDEX_H
+#define MANAGERS_ENTITYATTRINDEX_H
+//------------------------------------------------------------------------------
+/**
+    @class Managers::EntityAttrIndex
+
+    A hash index over a string attribute of the entities which are
+    attached to the EntityManager. The entities are grouped by their
+    attribute value, so that all entities with a given value are found
+    without looking at the other entities. Entities which don't have the
+    attribute are not in the index.
+
+    The index doesn't watch the entities, the EntityManager adds and
+    removes them, and an entity must be removed under the attribute value
+    it has been added with. The index doesn't hold references to the
+    entities.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "util/narray.h"
+#include "util/nstring.h"
+#include "util/nstrhashmap.h"
+#include "attr/attributeid.h"
+
+namespace Game
+{
+    class Entity;
+}
+
+//------------------------------------------------------------------------------
+namespace Managers
+{
+class EntityAttrIndex
+{
+public:
+    /// constructor with the indexed string attribute
+    EntityAttrIndex(const Attr::AttributeID& attrId);
+    /// destructor
+    ~EntityAttrIndex();
+    /// get the indexed attribute
+    const Attr::AttributeID& GetAttributeID() const;
+    /// add an entity under its current attribute value, if it has the attribute
+    void Add(Game::Entity* entity);
+    /// add an entity under an attribute value
+    void Add(Game::Entity* entity, const nString& value);
+    /// remove an entity under its current attribute value, if it has the attribute
+    void Remove(Game::Entity* entity);
+    /// get the entities with an attribute value, 0 if there are none
+    const nArray<Game::Entity*>* Find(const nString& value) const;
+    /// get the number of entities in the index
+    int GetNumEntities() const;
+
+private:
+    /// the entities with one attribute value
+    struct Bucket
+    {
+        nString value;
+        nArray<Game::Entity*> entities;
+    };
+
+    Attr::AttributeID attrId;
+    nStrHashMap<Bucket*> bucketMap;     ///< keys are the bucket values
+    nArray<Bucket*> freeBuckets;
+    int numEntities;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const Attr::AttributeID&
+EntityAttrIndex::GetAttributeID() const
+{
+    return this->attrId;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nArray<Game::Entity*>*
+EntityAttrIndex::Find(const nString& value) const
+{
+    Bucket* bucket = 0;
+    if (this->bucketMap.Find(value.Get(), bucket))
+    {
+        return &bucket->entities;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+EntityAttrIndex::GetNumEntities() const
+{
+    return this->numEntities;
+}
+
+} // namespace Managers
+//------------------------------------------------------------------------------
+#endif
@@ -31,11 +31,16 @@ EntityManager::EntityManager() :
     #endif
     entities(256, 256),
     entityRegistry(1024, 1024),
-    isInOnFrame(false)
+    isInOnFrame(false),
+    attrIndexes(0, 4)
 {
     n_assert(0 == Singleton);
     Singleton = this;
 
+    // the attributes by which entities are usually looked up
+    this->attrIndexes.Append(n_new(EntityAttrIndex(Attr::GUID)));
+    this->attrIndexes.Append(n_new(EntityAttrIndex(Attr::Name)));
+
     PROFILER_INIT(this->profOnBeginFrame, "profMangaEntityManagerBeginFrame");
     PROFILER_INIT(this->profOnMoveBefore, "profMangaEntityManagerMoveBefore");
     PROFILER_INIT(this->profPhysics, "profMangaEntityManagerPhysics");
@@ -52,6 +57,12 @@ EntityManager::~EntityManager()
 {
     n_assert(0 == this->entities.Size());
     n_assert(0 == this->entityRegistry.Size());
+    int i;
+    for (i = 0; i < this->attrIndexes.Size(); i++)
+    {
+        n_delete(this->attrIndexes[i]);
+    }
+    this->attrIndexes.Clear();
     n_assert(0 != Singleton);
     Singleton = 0;
 }
@@ -81,6 +92,7 @@ EntityManager::RemoveEntityFromRegistry(Game::Entity* entity)
         {
             // save removed entity in array (to make sure the entity does not get destroyed until end of frame)
             this->removedEntities.Append(entity);
+            this->RemoveEntityFromAttrIndexes(entity);
 
             // inside OnFrame, just set the ptrs to 0, so the entity is not longer triggered
             this->entityRegistry.GetElement(entity->GetUniqueId()) = 0;
@@ -93,6 +105,7 @@ EntityManager::RemoveEntityFromRegistry(Game::Entity* entity)
     else
     {
         // direct remove entity from arrays
+        this->RemoveEntityFromAttrIndexes(entity);
         this->entityRegistry.Rem(entity->GetUniqueId());
 
         nArray<Ptr<Entity> >::iterator iter = this->entities.Find(entity);
@@ -119,6 +132,7 @@ EntityManager::AddEntityToReqistry(Game::Entity* entity)
         // out side the OnFrame trigger, direct add the entity
         this->entities.Append(entity);
         this->entityRegistry.Add(entity->GetUniqueId(), entity);
+        this->AddEntityToAttrIndexes(entity);
     }
 }
 
@@ -165,6 +179,7 @@ EntityManager::UpdateRegistry()
 
                 // add to ID KeyArray
                 this->entityRegistry.Add(this->entities[entityIndex]->GetUniqueId(), this->entities[entityIndex]);
+                this->AddEntityToAttrIndexes(this->entities[entityIndex]);
 
                 // next entity
                 entityIndex ++;
@@ -188,6 +203,120 @@ EntityManager::UpdateRegistry()
 
         // add to ID KeyArray
         this->entityRegistry.Add(this->entities.Back()->GetUniqueId(), this->entities.Back());
+        this->AddEntityToAttrIndexes(this->entities.Back());
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns true if the entity is in the registry, which is the case from
+    the end of the frame in which it has been attached, until it is removed.
+    Exactly these entities are in the attribute indexes.
+*/
+bool
+EntityManager::IsEntityRegistered(Game::Entity* entity) const
+{
+    n_assert(entity);
+    Entity* registeredEntity = 0;
+    return this->entityRegistry.Find(entity->GetUniqueId(), registeredEntity) && (registeredEntity == entity);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+EntityManager::AddEntityToAttrIndexes(Game::Entity* entity)
+{
+    int i;
+    for (i = 0; i < this->attrIndexes.Size(); i++)
+    {
+        this->attrIndexes[i]->Add(entity);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+EntityManager::RemoveEntityFromAttrIndexes(Game::Entity* entity)
+{
+    int i;
+    for (i = 0; i < this->attrIndexes.Size(); i++)
+    {
+        this->attrIndexes[i]->Remove(entity);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add an in-memory index over a string attribute, so that entities can
+    be looked up by this attribute without looking at every entity (for
+    instance Attr::_Category). The entities which are already attached are
+    added to the new index. This also makes sure that the column has an
+    index in the world database, which speeds up the lookup of entities
+    which are not attached yet.
+*/
+void
+EntityManager::AddAttrIndex(const Attr::StringAttributeID& attrId)
+{
+    if (!this->HasAttrIndex(attrId))
+    {
+        EntityAttrIndex* attrIndex = n_new(EntityAttrIndex(attrId));
+        int entityIndex;
+        for (entityIndex = 0; entityIndex < this->entityRegistry.Size(); entityIndex++)
+        {
+            Entity* entity = this->entityRegistry.GetElementAt(entityIndex);
+            if (entity)
+            {
+                attrIndex->Add(entity);
+            }
+        }
+        this->attrIndexes.Append(attrIndex);
+    }
+    Db::Server::Instance()->AddEntityIndexColumn(attrId.GetName());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Game::Entity calls this method before it writes an attribute. If the
+    attribute is indexed, the entity is moved to the new value in the index.
+*/
+void
+EntityManager::UpdateAttrIndex(Game::Entity* entity, const Db::Attribute& newAttr)
+{
+    EntityAttrIndex* attrIndex = this->FindAttrIndex(newAttr.GetAttributeID());
+    if (attrIndex && this->IsEntityRegistered(entity))
+    {
+        attrIndex->Remove(entity);
+        attrIndex->Add(entity, newAttr.GetString());
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Game::Entity calls this method before it loads its attributes from
+    the database, which may change any attribute.
+*/
+void
+EntityManager::BeginUpdateAttrIndexes(Game::Entity* entity)
+{
+    if (this->IsEntityRegistered(entity))
+    {
+        this->RemoveEntityFromAttrIndexes(entity);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Game::Entity calls this method after it has loaded its attributes
+    from the database.
+*/
+void
+EntityManager::EndUpdateAttrIndexes(Game::Entity* entity)
+{
+    if (this->IsEntityRegistered(entity))
+    {
+        this->AddEntityToAttrIndexes(entity);
     }
 }
 
@@ -530,6 +659,56 @@ EntityManager::GetEntitiesByAttr(const Db::Attribute& attr, bool liveOnly, bool
     return this->GetEntitiesByAttrs(attributes, liveOnly, onlyFirstEntity, failOnDBError);
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns true if the entity is in the requested pool and has all
+    attributes with the given values.
+*/
+bool
+EntityManager::EntityMatches(Game::Entity* entity, const nArray<Db::Attribute>& attributes, bool liveOnly)
+{
+    // is in the right pool?
+    if (liveOnly && (entity->GetEntityPool() != Entity::LivePool))
+    {
+        return false;
+    }
+
+    // has all attribute?
+    int attributeIndex;
+    for (attributeIndex = 0; attributeIndex < attributes.Size(); attributeIndex++)
+    {
+        if (!entity->HasAttr(attributes[attributeIndex].GetAttributeID())
+            || (entity->GetAttr(attributes[attributeIndex].GetAttributeID()) != attributes[attributeIndex]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the index of the first attribute which is indexed, and
+    its position in the attribute array. All entities which match the
+    attributes are in the index under the attribute's value.
+*/
+EntityAttrIndex*
+EntityManager::FindAttrIndex(const nArray<Db::Attribute>& attributes, int& outAttrIndex) const
+{
+    int i;
+    for (i = 0; i < attributes.Size(); i++)
+    {
+        EntityAttrIndex* index = this->FindAttrIndex(attributes[i].GetAttributeID());
+        if (index)
+        {
+            outAttrIndex = i;
+            return index;
+        }
+    }
+    outAttrIndex = -1;
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -537,37 +716,38 @@ bool
 EntityManager::ExistsEntitiesByAttrs(const nArray<Db::Attribute>& attributes, bool liveOnly) const
 {
     // search in the active entities
-    int entityIndex;
-    int numEntities = this->GetNumEntities();
-    for (entityIndex = 0; entityIndex < numEntities; entityIndex++)
+    int attrIndex;
+    EntityAttrIndex* index = this->FindAttrIndex(attributes, attrIndex);
+    if (index)
     {
-        Entity* entity = this->GetEntityAt(entityIndex);
-        // entity exist?
-        if (entity)
+        // only look at the entities which have the value of the indexed attribute
+        const nArray<Entity*>* indexedEntities = index->Find(attributes[attrIndex].GetString());
+        if (indexedEntities)
         {
-            // is in the right pool?
-            if (!liveOnly || entity->GetEntityPool() == Entity::LivePool)
+            int i;
+            for (i = 0; i < indexedEntities->Size(); i++)
             {
-                // has all attribute?
-                int attributeIndex;
-                bool hasAllAttributes = true;
-                for (attributeIndex = 0; attributeIndex < attributes.Size(); attributeIndex++)
-                {
-                    if (!entity->HasAttr(attributes[attributeIndex].GetAttributeID())
-                        || (entity->GetAttr(attributes[attributeIndex].GetAttributeID()) != attributes[attributeIndex]))
-                    {
-                        hasAllAttributes = false;
-                        break;
-                    }
-                }
-
-                if (hasAllAttributes)
+                if (EntityMatches((*indexedEntities)[i], attributes, liveOnly))
                 {
                     return true; // found one
                 }
             }
         }
     }
+    else
+    {
+        int entityIndex;
+        int numEntities = this->GetNumEntities();
+        for (entityIndex = 0; entityIndex < numEntities; entityIndex++)
+        {
+            Entity* entity = this->GetEntityAt(entityIndex);
+            // entity exist?
+            if (entity && EntityMatches(entity, attributes, liveOnly))
+            {
+                return true; // found one
+            }
+        }
+    }
 
     // search in the db
     Ptr<Db::Query> dbQuery = Db::Server::Instance()->CreateQuery();
@@ -605,6 +785,10 @@ EntityManager::ExistsEntitiesByAttrs(const nArray<Db::Attribute>& attributes, bo
 /**
     Generic function to find entities by attributes.
 
+    If one of the attributes is indexed, only the entities with this
+    attribute value are looked at, and the entities are returned in the
+    order in which they have been added to the index.
+
     @param liveOnly         set if only live entities are requested
     @param onlyFirstEntity  set to stop search if the 1st entity was found
 
@@ -614,31 +798,19 @@ EntityManager::GetEntitiesByAttrs(const nArray<Db::Attribute>& attributes, bool
 {
     // collect active entities
     nArray<Ptr<Entity> > entities;
-    int entityIndex;
-    int numEntities = this->GetNumEntities();
-    for (entityIndex = 0; entityIndex < numEntities; entityIndex++)
+    int attrIndex;
+    EntityAttrIndex* index = this->FindAttrIndex(attributes, attrIndex);
+    if (index)
     {
-        Entity* entity = this->GetEntityAt(entityIndex);
-        // entity exist?
-        if (entity)
+        // only look at the entities which have the value of the indexed attribute
+        const nArray<Entity*>* indexedEntities = index->Find(attributes[attrIndex].GetString());
+        if (indexedEntities)
         {
-            // is in the right pool?
-            if (!liveOnly || entity->GetEntityPool() == Entity::LivePool)
+            int i;
+            for (i = 0; i < indexedEntities->Size(); i++)
             {
-                // has all attribute?
-                int attributeIndex;
-                bool hasAllAttributes = true;
-                for (attributeIndex = 0; attributeIndex < attributes.Size(); attributeIndex++)
-                {
-                    if (!entity->HasAttr(attributes[attributeIndex].GetAttributeID())
-                        || (entity->GetAttr(attributes[attributeIndex].GetAttributeID()) != attributes[attributeIndex]))
-                    {
-                        hasAllAttributes = false;
-                        break;
-                    }
-                }
-
-                if (hasAllAttributes)
+                Entity* entity = (*indexedEntities)[i];
+                if (EntityMatches(entity, attributes, liveOnly))
                 {
                     entities.Append(entity);
                     if (onlyFirstEntity)
@@ -649,6 +821,24 @@ EntityManager::GetEntitiesByAttrs(const nArray<Db::Attribute>& attributes, bool
             }
         }
     }
+    else
+    {
+        int entityIndex;
+        int numEntities = this->GetNumEntities();
+        for (entityIndex = 0; entityIndex < numEntities; entityIndex++)
+        {
+            Entity* entity = this->GetEntityAt(entityIndex);
+            // entity exist?
+            if (entity && EntityMatches(entity, attributes, liveOnly))
+            {
+                entities.Append(entity);
+                if (onlyFirstEntity)
+                {
+                    return entities;
+                }
+            }
+        }
+    }
 
     if (!liveOnly)
     {
@@ -12,6 +12,13 @@
     methods which are defined in entity manager still do the expected thing
     in your derived class.
 
+    The lookups by attribute (GetEntitiesByAttrs() and friends) use hash
+    indexes over string attributes of the attached entities, instead of
+    looking at every entity. GUID and Name are always indexed, more
+    attributes can be added with AddAttrIndex(). The indexes are kept up to
+    date when entities are attached or removed, and when an indexed
+    attribute of an attached entity is written through Game::Entity.
+
     (C) 2005 Radon Labs GmbH
 */
 #include "game/manager.h"
@@ -20,6 +27,7 @@
 #include "game/entity.h"
 #include "misc/nwatched.h"
 #include "kernel/nprofiler.h"
+#include "managers/entityattrindex.h"
 
 //------------------------------------------------------------------------------
 namespace Managers
@@ -36,6 +44,8 @@ public:
     virtual ~EntityManager();
     /// get instance pointer
     static EntityManager* Instance();
+    /// return true if the entity manager exists
+    static bool HasInstance();
 
     /// called per-frame by game server
     virtual void OnFrame();
@@ -83,6 +93,17 @@ public:
     /// get the entities for the given attribute array (liveOnly: search only the live entities)
     nArray<Ptr<Game::Entity> > GetEntitiesByAttrs(const nArray<Db::Attribute>& attributes, bool liveOnly = false, bool onlyFirstEntity = false, bool failOnDBError = true);
 
+    /// add an in-memory index over a string attribute of the attached entities (and a database index)
+    void AddAttrIndex(const Attr::StringAttributeID& attrId);
+    /// return true if an attribute is indexed
+    bool HasAttrIndex(const Attr::AttributeID& attrId) const;
+    /// update the index of an attribute, called by an entity before the attribute is written
+    void UpdateAttrIndex(Game::Entity* entity, const Db::Attribute& newAttr);
+    /// remove an entity from the attribute indexes, called by an entity before its attributes are loaded
+    void BeginUpdateAttrIndexes(Game::Entity* entity);
+    /// add an entity back to the attribute indexes, called by an entity after its attributes are loaded
+    void EndUpdateAttrIndexes(Game::Entity* entity);
+
 private:
     static EntityManager* Singleton;
 
@@ -97,6 +118,19 @@ protected:
     /// update the registry (cleanup dismissed entities, attach new entities)
     void UpdateRegistry();
 
+    /// return true if the entity is attached and not removed in this frame
+    bool IsEntityRegistered(Game::Entity* entity) const;
+    /// get the index of an attribute, 0 if the attribute is not indexed
+    EntityAttrIndex* FindAttrIndex(const Attr::AttributeID& attrId) const;
+    /// get an index which can be used to look up entities by attributes, 0 if none
+    EntityAttrIndex* FindAttrIndex(const nArray<Db::Attribute>& attributes, int& outAttrIndex) const;
+    /// return true if an entity is in the requested pool and has all attributes
+    static bool EntityMatches(Game::Entity* entity, const nArray<Db::Attribute>& attributes, bool liveOnly);
+    /// add an entity to all attribute indexes
+    void AddEntityToAttrIndexes(Game::Entity* entity);
+    /// remove an entity from all attribute indexes
+    void RemoveEntityFromAttrIndexes(Game::Entity* entity);
+
     /// create an on-demand sleeping entities
     nArray<Game::Entity*> CreateSleepingEntities(const nArray<Db::Attribute>& keyAttributes, const nArray<Ptr<Game::Entity> >& filteredEntities, bool failOnDBError = true);
 
@@ -106,6 +140,8 @@ protected:
     nArray<Ptr<Game::Entity> > newEntities;
     nArray<Ptr<Game::Entity> > removedEntities;
 
+    nArray<EntityAttrIndex*> attrIndexes;
+
     #if __NEBULA_STATS__
     nWatched statsNumEntities;
     nWatched statsNumLiveEntities;
@@ -134,6 +170,44 @@ EntityManager::Instance()
     return Singleton;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+EntityManager::HasInstance()
+{
+    return (0 != Singleton);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+EntityAttrIndex*
+EntityManager::FindAttrIndex(const Attr::AttributeID& attrId) const
+{
+    int i;
+    for (i = 0; i < this->attrIndexes.Size(); i++)
+    {
+        if (this->attrIndexes[i]->GetAttributeID() == attrId)
+        {
+            return this->attrIndexes[i];
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+EntityManager::HasAttrIndex(const Attr::AttributeID& attrId) const
+{
+    return (0 != this->FindAttrIndex(attrId));
+}
+
 } // namespace Managers
 //------------------------------------------------------------------------------
 #endif
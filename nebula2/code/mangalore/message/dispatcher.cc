@@ -14,7 +14,11 @@ ImplementFactory(Message::Dispatcher);
 */
 Dispatcher::Dispatcher() :
     portArray(8, 8),
-    handleMsgLockCount(0)
+    handleMsgLockCount(0),
+    routes(0, 8),
+    routePorts(0, 16),
+    anyMsgPorts(0, 4),
+    routesDirty(false)
 {
     // empty
 }
@@ -42,16 +46,40 @@ void
 Dispatcher::Put(Msg* msg)
 {
     n_assert(msg);
+    if (this->routesDirty && !this->IsInHandleMessage())
+    {
+        this->UpdateRoutes();
+    }
 
     // lock array
     this->BeginHandleMessage();
 
-    int num = this->portArray.Size();
-    for (int i = 0; i < num; i++)
+    if (this->routesDirty)
     {
-        if (this->portArray[i] != 0)
+        // ports have been attached or removed while handling a message
+        int num = this->portArray.Size();
+        for (int i = 0; i < num; i++)
         {
-            this->portArray[i]->Put(msg);
+            if (this->portArray[i] != 0)
+            {
+                this->portArray[i]->Put(msg);
+            }
+        }
+    }
+    else
+    {
+#ifdef _DEBUG
+        this->CheckRoutes(msg);
+#endif
+        int numPorts;
+        const int* ports = this->FindPorts(msg->GetId(), numPorts);
+        for (int i = 0; i < numPorts; i++)
+        {
+            Port* port = this->portArray[ports[i]].get_unsafe();
+            if (port != 0)
+            {
+                port->Put(msg);
+            }
         }
     }
 
@@ -68,17 +96,43 @@ Dispatcher::Put(Msg* msg)
 void
 Dispatcher::HandleMessage(Msg* msg)
 {
+    n_assert(msg);
+    if (this->routesDirty && !this->IsInHandleMessage())
+    {
+        this->UpdateRoutes();
+    }
+
     // lock array
     this->BeginHandleMessage();
 
-    int num = this->portArray.Size();
-    for (int i = 0; i < num; i++)
+    if (this->routesDirty)
     {
-        if (this->portArray[i] != 0)
+        // ports have been attached or removed while handling a message
+        int num = this->portArray.Size();
+        for (int i = 0; i < num; i++)
         {
-            if (this->portArray[i]->Accepts(msg))
+            if (this->portArray[i] != 0)
             {
-                this->portArray[i]->HandleMessage(msg);
+                if (this->portArray[i]->Accepts(msg))
+                {
+                    this->portArray[i]->HandleMessage(msg);
+                }
+            }
+        }
+    }
+    else
+    {
+#ifdef _DEBUG
+        this->CheckRoutes(msg);
+#endif
+        int numPorts;
+        const int* ports = this->FindPorts(msg->GetId(), numPorts);
+        for (int i = 0; i < numPorts; i++)
+        {
+            Port* port = this->portArray[ports[i]].get_unsafe();
+            if ((port != 0) && port->Accepts(msg))
+            {
+                port->HandleMessage(msg);
             }
         }
     }
@@ -87,6 +141,133 @@ Dispatcher::HandleMessage(Msg* msg)
     this->EndHandleMessage();
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns the index of the route of a message id, or -1 if no port
+    declared the message id.
+*/
+int
+Dispatcher::FindRoute(const Id& id) const
+{
+    int num = this->routes.Size();
+    for (int i = 0; i < num; i++)
+    {
+        if (this->routes[i].id == &id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the indices into the port array of all ports which are
+    interested in a message id, in the order of attachment. The result
+    remains valid while a message is handled.
+*/
+const int*
+Dispatcher::FindPorts(const Id& id, int& numPorts) const
+{
+    int routeIndex = this->FindRoute(id);
+    if (-1 == routeIndex)
+    {
+        numPorts = this->anyMsgPorts.Size();
+        return this->anyMsgPorts.Begin();
+    }
+    const Route& route = this->routes[routeIndex];
+    numPorts = route.numPorts;
+    return this->routePorts.Begin() + route.firstPort;
+}
+
+#ifdef _DEBUG
+//------------------------------------------------------------------------------
+/**
+    Debug check for ports which accept a message in Accepts(), but don't
+    declare its id in SetupAcceptedMessages(). Such a port would silently
+    never get the message.
+*/
+void
+Dispatcher::CheckRoutes(Msg* msg)
+{
+    n_assert(msg);
+    int num = this->portArray.Size();
+    for (int i = 0; i < num; i++)
+    {
+        Port* port = this->portArray[i].get_unsafe();
+        if ((port != 0) && !port->AcceptsAnyMessage() && !port->IsAcceptedMessage(msg->GetId()) && port->Accepts(msg))
+        {
+            n_error("Message::Dispatcher: port '%s' accepts message '%s', but doesn't declare it in SetupAcceptedMessages()!",
+                    port->GetClassName().Get(), msg->GetClassName().Get());
+        }
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+    Rebuilds the list of interested ports for every message id declared
+    by one of the ports. Must not be called while handling a message,
+    since the lists may be in use.
+*/
+void
+Dispatcher::UpdateRoutes()
+{
+    n_assert(!this->IsInHandleMessage());
+    this->routes.Clear();
+    this->routePorts.Clear();
+    this->anyMsgPorts.Clear();
+
+    // gather the declared message ids
+    int portIndex;
+    int numPorts = this->portArray.Size();
+    for (portIndex = 0; portIndex < numPorts; portIndex++)
+    {
+        Port* port = this->portArray[portIndex].get_unsafe();
+        if (port != 0)
+        {
+            if (port->AcceptsAnyMessage())
+            {
+                this->anyMsgPorts.Append(portIndex);
+            }
+            else
+            {
+                const nArray<const Id*>& ids = port->GetAcceptedMessages();
+                int idIndex;
+                for (idIndex = 0; idIndex < ids.Size(); idIndex++)
+                {
+                    if (-1 == this->FindRoute(*ids[idIndex]))
+                    {
+                        Route route;
+                        route.id = ids[idIndex];
+                        route.firstPort = 0;
+                        route.numPorts = 0;
+                        this->routes.Append(route);
+                    }
+                }
+            }
+        }
+    }
+
+    // build the port lists in attachment order
+    int routeIndex;
+    for (routeIndex = 0; routeIndex < this->routes.Size(); routeIndex++)
+    {
+        Route& route = this->routes[routeIndex];
+        route.firstPort = this->routePorts.Size();
+        for (portIndex = 0; portIndex < numPorts; portIndex++)
+        {
+            Port* port = this->portArray[portIndex].get_unsafe();
+            if ((port != 0) && port->IsAcceptedMessage(*route.id))
+            {
+                this->routePorts.Append(portIndex);
+            }
+        }
+        route.numPorts = this->routePorts.Size() - route.firstPort;
+    }
+    this->routesDirty = false;
+}
+
 //------------------------------------------------------------------------------
 /**
     Attach a new message port.
@@ -108,12 +289,14 @@ Dispatcher::AttachPort(Port* port)
         {
             // use free element
             this->portArray[i] = port;
+            this->routesDirty = true;
             return;
         }
     }
 
     // fall through: append port
     this->portArray.Append(port);
+    this->routesDirty = true;
 }
 
 //------------------------------------------------------------------------------
@@ -133,6 +316,7 @@ Dispatcher::RemovePort(Port* port)
     n_assert(iter);
     // set ptr to 0
     iter->operator =(0);
+    this->routesDirty = true;
 
     // try to cleanup
     this->CleanupEmptyPorts();
@@ -151,6 +335,7 @@ Dispatcher::CleanupEmptyPorts()
             if (this->portArray[i] == 0)
             {
                 this->portArray.Erase(i);
+                this->routesDirty = true;
             }
             else
             {
@@ -26,6 +26,13 @@
     Handlers, no messages are kept in the Dispatcher object. Thus,
     a Dispatcher always appears as an empty message Port.
 
+    The Dispatcher keeps a list of interested ports for each message id
+    which is declared by one of its ports (see Port::SetupAcceptedMessages()),
+    so only these ports are asked with Accepts(). Ports which don't declare
+    their message ids are part of every list. The lists are rebuilt on the
+    next message after a port has been attached or removed, but not while
+    a message is being handled, in this case all ports are asked.
+
     (C) 2005 RadonLabs GmbH
 */
 #include "message/port.h"
@@ -55,6 +62,16 @@ public:
 protected:
     /// cleanup empty msg ports when not in handle message trigger
     virtual void CleanupEmptyPorts();
+    /// rebuild the per message id port lists
+    void UpdateRoutes();
+    /// find the route of a message id
+    int FindRoute(const Id& id) const;
+    /// get the indices of the ports interested in a message id
+    const int* FindPorts(const Id& id, int& numPorts) const;
+#ifdef _DEBUG
+    /// check that no port which accepts a message has been left out by the routes
+    void CheckRoutes(Msg* msg);
+#endif
 
     /// begin handle message
     void BeginHandleMessage();
@@ -63,9 +80,21 @@ protected:
     /// end handle message
     void EndHandleMessage();
 private:
+    /// the ports interested in a message id
+    struct Route
+    {
+        const Id* id;
+        int firstPort;          // index into routePorts
+        int numPorts;
+    };
+
     nArray<Ptr<Port> > portArray;
     /// in the handle message trigger
     int handleMsgLockCount;
+    nArray<Route> routes;
+    nArray<int> routePorts;     // indices into portArray
+    nArray<int> anyMsgPorts;    // ports which accept any message id
+    bool routesDirty;
 };
 
 RegisterFactory(Dispatcher);
@@ -16,24 +16,52 @@
     msg->SetPosition(targetPos);
     msg->Send(entity->GetDispatcher());
 
+    Message objects are allocated from a Message::Pool owned by the message
+    class, which is set up by the DeclareMsgId and ImplementMsgId macros.
+
     (C) 2005 Radon Labs GmbH
 */
 #include "foundation/refcounted.h"
 #include "message/id.h"
+#include "message/pool.h"
 
 //------------------------------------------------------------------------------
 /**
-    Message Id macros.
+    Message Id macros. These also route the allocation of message objects
+    through the message class' pool. The class scope operator new hides the
+    global debug operator new used by n_new(), so it is declared as well.
 */
+#if defined(_DEBUG) && defined(__WIN32__)
+#define DeclareMsgPoolDebugNew \
+    void* operator new(size_t size, const char* file, int line); \
+    void operator delete(void* p, const char* file, int line);
+#define ImplementMsgPoolDebugNew(type) \
+    void* type::operator new(size_t size, const char* file, int line) { return type::Pool.Alloc(size); } \
+    void type::operator delete(void* p, const char* file, int line) { type::Pool.Free(p, sizeof(type)); }
+#else
+#define DeclareMsgPoolDebugNew
+#define ImplementMsgPoolDebugNew(type)
+#endif
+
 #define DeclareMsgId \
 public:\
     static Message::Id Id; \
+    static Message::Pool Pool; \
     virtual const Message::Id& GetId() const; \
+    virtual Message::Pool& GetPool() const; \
+    void* operator new(size_t size); \
+    void operator delete(void* p, size_t size); \
+    DeclareMsgPoolDebugNew \
 private:
 
 #define ImplementMsgId(type) \
     Message::Id type::Id; \
-    const Message::Id& type::GetId() const { return type::Id; }
+    Message::Pool type::Pool(#type, sizeof(type)); \
+    const Message::Id& type::GetId() const { return type::Id; } \
+    Message::Pool& type::GetPool() const { return type::Pool; } \
+    void* type::operator new(size_t size) { return type::Pool.Alloc(size); } \
+    void type::operator delete(void* p, size_t size) { type::Pool.Free(p, size); } \
+    ImplementMsgPoolDebugNew(type)
 
 //------------------------------------------------------------------------------
 namespace Message
@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//  message/pool.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "message/pool.h"
+
+namespace Message
+{
+Pool* Pool::First = 0;
+
+//------------------------------------------------------------------------------
+/**
+    NOTE: pools are static objects of the message classes, so the
+    constructor must not use anything which may not be initialized yet.
+*/
+Pool::Pool(const char* n, int size) :
+    next(First),
+    name(n),
+    objSize(size),
+    blockSize((size + 15) & ~15),
+    freeList(0),
+    chunkList(0),
+    numAlive(0),
+    numChunks(0),
+    numSent(0)
+{
+    n_assert(n);
+    First = this;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Releases the chunks, unless messages of this class are still alive,
+    which may happen when the pool is destroyed before another static
+    object which holds a message.
+*/
+Pool::~Pool()
+{
+    if (0 == this->numAlive)
+    {
+        while (this->chunkList)
+        {
+            void* chunk = this->chunkList;
+            this->chunkList = *(void**) chunk;
+            n_free(chunk);
+        }
+        this->freeList = 0;
+    }
+
+    // unlink from the list of pools
+    Pool** prev = &First;
+    while (*prev && (*prev != this))
+    {
+        prev = &(*prev)->next;
+    }
+    if (*prev)
+    {
+        *prev = this->next;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocates a chunk of ChunkSize objects from the heap and puts the
+    objects on the free list. The first 16 bytes of a chunk link the
+    chunks, so that they can be released by the destructor.
+*/
+void
+Pool::AllocChunk()
+{
+    n_assert(0 == this->freeList);
+    char* chunk = (char*) n_malloc(16 + ChunkSize * this->blockSize);
+    n_assert(chunk);
+    *(void**) chunk = this->chunkList;
+    this->chunkList = chunk;
+    this->numChunks++;
+
+    // link the objects in address order
+    int i;
+    char* obj = chunk + 16;
+    for (i = 0; i < ChunkSize - 1; i++)
+    {
+        *(void**) obj = obj + this->blockSize;
+        obj += this->blockSize;
+    }
+    *(void**) obj = 0;
+    this->freeList = chunk + 16;
+}
+
+} // namespace Message
@@ -0,0 +1,195 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+//------------------------------------------------------------------------------
+/**
+    @class Message::Pool
+
+    A free list allocator for the objects of one message class. Every
+    message class owns a static Pool through the DeclareMsgId and
+    ImplementMsgId macros, which also route the class' operator new and
+    operator delete through the pool. Memory of destroyed messages is kept
+    on the free list and reused by the next message of the same class,
+    instead of going through the heap for each message.
+
+    The pool also keeps the per class statistics which are shown as
+    watcher variables by the Message::Server.
+
+    Messages are only created on the main thread, so the pool is not
+    thread safe.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+//------------------------------------------------------------------------------
+namespace Message
+{
+class Pool
+{
+public:
+    /// constructor, called during static initialization
+    Pool(const char* name, int objSize);
+    /// destructor
+    ~Pool();
+    /// get the first pool in the list of all pools
+    static Pool* GetFirst();
+    /// get the next pool in the list of all pools
+    Pool* GetNext() const;
+    /// get the message class name
+    const char* GetName() const;
+    /// allocate memory for a message object
+    void* Alloc(size_t size);
+    /// free memory of a message object
+    void Free(void* ptr, size_t size);
+    /// count a sent message
+    void CountSent();
+    /// get number of sent messages, and reset the counter
+    int ResetNumSent();
+    /// get the number of messages currently alive
+    int GetNumAlive() const;
+    /// get the number of chunks allocated from the heap
+    int GetNumChunks() const;
+
+private:
+    /// number of objects per chunk
+    enum
+    {
+        ChunkSize = 32,
+    };
+    /// allocate a new chunk and put its objects on the free list
+    void AllocChunk();
+
+    static Pool* First;
+
+    Pool* next;
+    const char* name;
+    size_t objSize;
+    size_t blockSize;
+    void* freeList;
+    void* chunkList;
+    int numAlive;
+    int numChunks;
+    int numSent;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+Pool*
+Pool::GetFirst()
+{
+    return First;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+Pool*
+Pool::GetNext() const
+{
+    return this->next;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const char*
+Pool::GetName() const
+{
+    return this->name;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Takes an object from the free list. Subclasses of a message class
+    which don't declare their own message id have a different size and
+    are allocated from the heap.
+*/
+inline
+void*
+Pool::Alloc(size_t size)
+{
+    if (size != this->objSize)
+    {
+        return n_malloc(size);
+    }
+    if (0 == this->freeList)
+    {
+        this->AllocChunk();
+    }
+    void* ptr = this->freeList;
+    this->freeList = *(void**) ptr;
+    this->numAlive++;
+    return ptr;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+Pool::Free(void* ptr, size_t size)
+{
+    if (0 == ptr)
+    {
+        return;
+    }
+    if (size != this->objSize)
+    {
+        n_free(ptr);
+        return;
+    }
+    n_assert(this->numAlive > 0);
+    *(void**) ptr = this->freeList;
+    this->freeList = ptr;
+    this->numAlive--;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+Pool::CountSent()
+{
+    this->numSent++;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+Pool::ResetNumSent()
+{
+    int num = this->numSent;
+    this->numSent = 0;
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+Pool::GetNumAlive() const
+{
+    return this->numAlive;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+Pool::GetNumChunks() const
+{
+    return this->numChunks;
+}
+
+} // namespace Message
+//------------------------------------------------------------------------------
+#endif
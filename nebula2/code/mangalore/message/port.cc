@@ -3,6 +3,7 @@
 //  (C) 2005 RadonLabs GmbH
 //------------------------------------------------------------------------------
 #include "message/port.h"
+#include "message/server.h"
 
 namespace Message
 {
@@ -27,6 +28,22 @@ Port::Accepts(Msg* msg)
     return false;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Override this method in a subclass to declare the ids of all messages
+    which may be accepted by Accepts() with RegisterMessage(). Call the
+    parent class' SetupAcceptedMessages() first, unless the parent class
+    is Port itself.
+
+    The default implementation doesn't declare any message ids, instead
+    the port will be offered every message.
+*/
+void
+Port::SetupAcceptedMessages()
+{
+    this->acceptsAnyMessage = true;
+}
+
 //------------------------------------------------------------------------------
 /**
     Put a new message on the port's message queue.
@@ -45,11 +62,17 @@ Port::Put(Msg* msg)
 /**
     Handle all pending messages. This will simply call the virtual
     HandleMessage() method for each message in the msgQueue and clear the
-    message queue afterwards.
+    message queue afterwards. Asynchronous messages which are still
+    queued in the Message::Server are delivered first.
 */
 void
 Port::HandlePendingMessages()
 {
+    if (Server::HasInstance())
+    {
+        Server::Instance()->DeliverAsyncMessages();
+    }
+
     // increment ref count on me, because messages could cause removing my entity
     Ptr<Port> myself = this;
 
@@ -12,6 +12,15 @@
     Message Ports are the basis for message Dispatchers and
     message Handlers.
 
+    A port can declare the ids of the messages it may accept by overriding
+    SetupAcceptedMessages() and calling RegisterMessage() for each id.
+    A Dispatcher will then only offer messages with these ids to the
+    port. Ports which don't override SetupAcceptedMessages() are offered
+    every message. Accepts() is still asked before a message is handled,
+    so it may reject declared messages depending on the port's state.
+    If you override Accepts() in a subclass of a port which declares
+    its messages, you must override SetupAcceptedMessages() as well.
+
     (C) 2003 RadonLabs GmbH
 */
 #include "foundation/refcounted.h"
@@ -36,9 +45,31 @@ public:
     virtual void HandlePendingMessages();
     /// handle a single message
     virtual void HandleMessage(Msg* msg);
+    /// return true if the port must be offered every message
+    bool AcceptsAnyMessage();
+    /// return true if the port declared to accept a message id
+    bool IsAcceptedMessage(const Id& id);
+    /// get the declared accepted message ids
+    const nArray<const Id*>& GetAcceptedMessages();
+
+protected:
+    /// declare the accepted message ids, override in subclass
+    virtual void SetupAcceptedMessages();
+    /// declare an accepted message id, call from SetupAcceptedMessages()
+    void RegisterMessage(const Id& id);
 
 private:
+    /// call SetupAcceptedMessages() on first use
+    void ValidateAcceptedMessages();
+
+    friend class Server;
+
     nArray<Ptr<Msg> > msgQueue;
+    nArray<const Id*> acceptedMessages;
+    bool acceptedMessagesValid;
+    bool acceptsAnyMessage;
+    int asyncFirst;     ///< first message for this port in the server's async queue, or -1
+    int asyncLast;      ///< last message for this port in the server's async queue, or -1
 };
 
 //------------------------------------------------------------------------------
@@ -46,11 +77,79 @@ private:
 */
 inline
 Port::Port() :
-    msgQueue(8, 8)
+    msgQueue(8, 8),
+    acceptedMessages(0, 8),
+    acceptedMessagesValid(false),
+    acceptsAnyMessage(false),
+    asyncFirst(-1),
+    asyncLast(-1)
 {
     this->msgQueue.SetFlags(nArray<Ptr<Msg> >::DoubleGrowSize);
 }
 
+//------------------------------------------------------------------------------
+/**
+    Declare a message id which may be accepted by Accepts(). Only valid
+    from within SetupAcceptedMessages().
+*/
+inline
+void
+Port::RegisterMessage(const Id& id)
+{
+    n_assert(!this->acceptedMessagesValid);
+    if (0 == this->acceptedMessages.Find(&id))
+    {
+        this->acceptedMessages.Append(&id);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+Port::ValidateAcceptedMessages()
+{
+    if (!this->acceptedMessagesValid)
+    {
+        this->SetupAcceptedMessages();
+        this->acceptedMessagesValid = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+Port::AcceptsAnyMessage()
+{
+    this->ValidateAcceptedMessages();
+    return this->acceptsAnyMessage;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+Port::IsAcceptedMessage(const Id& id)
+{
+    this->ValidateAcceptedMessages();
+    return this->acceptsAnyMessage || (0 != this->acceptedMessages.Find(&id));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nArray<const Id*>&
+Port::GetAcceptedMessages()
+{
+    this->ValidateAcceptedMessages();
+    return this->acceptedMessages;
+}
+
 } // namespace Message
 //------------------------------------------------------------------------------
 #endif
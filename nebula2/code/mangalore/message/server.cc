@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "message/server.h"
 #include "message/port.h"
+#include "misc/nwatched.h"
 
 namespace Message
 {
@@ -18,7 +19,12 @@ Server* Server::Singleton = 0;
 Server::Server() :
     isOpen(false),
     portArray(1024, 1024),
-    broadcastLockCount(0)
+    broadcastLockCount(0),
+    asyncQueue(1024, 1024),
+    inDeliver(false),
+    time(0.0),
+    statsTime(0.0),
+    statsMaxQueueDepth(0)
 {
     n_assert(0 == Singleton);
     Singleton = this;
@@ -54,6 +60,7 @@ void
 Server::Close()
 {
     n_assert(this->isOpen);
+    this->ClearAsyncMessages();
     this->isOpen = false;
 }
 
@@ -127,7 +134,8 @@ void
 Server::SendAsync(Port* port, Msg* msg)
 {
     n_assert(port);
-    port->Put(msg);
+    msg->GetPool().CountSent();
+    this->QueueAsync(port, msg);
 }
 
 //------------------------------------------------------------------------------
@@ -139,6 +147,8 @@ Server::SendAsync(Port* port, Msg* msg)
 void
 Server::BroadcastAsync(Msg* msg)
 {
+    msg->GetPool().CountSent();
+
     // lock array
     this->BeginBroadcast();
 
@@ -147,7 +157,7 @@ Server::BroadcastAsync(Msg* msg)
     {
         if (this->portArray[i] != 0)
         {
-            this->portArray[i]->Put(msg);
+            this->QueueAsync(this->portArray[i], msg);
         }
     }
 
@@ -169,6 +179,7 @@ void
 Server::SendSync(Port* port, Msg* msg)
 {
     n_assert(port);
+    msg->GetPool().CountSent();
     if (port->Accepts(msg))
     {
         port->HandleMessage(msg);
@@ -184,6 +195,8 @@ Server::SendSync(Port* port, Msg* msg)
 void
 Server::BroadcastSync(Msg* msg)
 {
+    msg->GetPool().CountSent();
+
     // lock array
     this->BeginBroadcast();
 
@@ -204,6 +217,168 @@ Server::BroadcastSync(Msg* msg)
     this->EndBroadcast();
 }
 
+//------------------------------------------------------------------------------
+/**
+    Append a message for a port to the async queue, and chain it to the
+    previous message for the same port. The queue keeps a reference on
+    the message, and on the port while it has queued messages.
+*/
+void
+Server::QueueAsync(Port* port, Msg* msg)
+{
+    n_assert(port && msg);
+    n_assert(!this->inDeliver);
+    int index = this->asyncQueue.Size();
+    AsyncMsg asyncMsg;
+    asyncMsg.port = port;
+    asyncMsg.msg = msg;
+    asyncMsg.next = -1;
+    this->asyncQueue.Append(asyncMsg);
+    msg->AddRef();
+    if (-1 == port->asyncLast)
+    {
+        port->AddRef();
+        port->asyncFirst = index;
+    }
+    else
+    {
+        this->asyncQueue[port->asyncLast].next = index;
+    }
+    port->asyncLast = index;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Puts the queued messages on the message queues of their ports. All
+    messages for a port are delivered in one batch, when the port's first
+    message is reached in the queue. Ports only decide whether they accept
+    a message when it is delivered.
+*/
+void
+Server::DoDeliverAsyncMessages()
+{
+    n_assert(!this->inDeliver);
+    this->inDeliver = true;
+
+    int num = this->asyncQueue.Size();
+    if (num > this->statsMaxQueueDepth)
+    {
+        this->statsMaxQueueDepth = num;
+    }
+
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        // the entries of a delivered batch are cleared, because the
+        // port may be destroyed when the queue releases it
+        Port* port = this->asyncQueue[i].port;
+        if (0 != port)
+        {
+            n_assert(port->asyncFirst == i);
+            int index;
+            for (index = i; index != -1; index = this->asyncQueue[index].next)
+            {
+                Msg* msg = this->asyncQueue[index].msg;
+                this->asyncQueue[index].port = 0;
+                port->Put(msg);
+                msg->Release();
+            }
+            port->asyncFirst = -1;
+            port->asyncLast = -1;
+            port->Release();
+        }
+    }
+    this->asyncQueue.Reset();
+
+    this->inDeliver = false;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Discard all queued asynchronous messages without delivering them.
+*/
+void
+Server::ClearAsyncMessages()
+{
+    n_assert(!this->inDeliver);
+    int i;
+    for (i = 0; i < this->asyncQueue.Size(); i++)
+    {
+        // release the port with its last message, it may be destroyed
+        Port* port = this->asyncQueue[i].port;
+        if (port->asyncLast == i)
+        {
+            port->asyncFirst = -1;
+            port->asyncLast = -1;
+            port->Release();
+        }
+        this->asyncQueue[i].msg->Release();
+    }
+    this->asyncQueue.Reset();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Called once per frame by the application. Delivers the asynchronous
+    messages which haven't been picked up by a port in this frame, and
+    updates the statistics.
+*/
+void
+Server::OnFrame()
+{
+    this->DeliverAsyncMessages();
+    this->UpdateStats();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Updates the message statistics watchers once per second.
+*/
+void
+Server::UpdateStats()
+{
+    nTime elapsed = this->time - this->statsTime;
+    if ((elapsed < 1.0) && (elapsed >= 0.0))
+    {
+        return;
+    }
+    this->statsTime = this->time;
+
+    int numSent = 0;
+    int numAlive = 0;
+    int numChunks = 0;
+    Pool* pool;
+    for (pool = Pool::GetFirst(); pool != 0; pool = pool->GetNext())
+    {
+        int num = pool->ResetNumSent();
+        numSent += num;
+        numAlive += pool->GetNumAlive();
+        numChunks += pool->GetNumChunks();
+        #ifdef __NEBULA_STATS__
+        if ((num > 0) && (elapsed > 0.0))
+        {
+            nString name("mangaMsgsPerSec");
+            name.Append(pool->GetName());
+            name.ReplaceChars(":", '_');
+            nWatched watchMsgRate(name, nArg::Int);
+            watchMsgRate->SetI(int(num / elapsed));
+        }
+        #endif
+    }
+
+    #ifdef __NEBULA_STATS__
+    nWatched watchMsgRate("mangaMsgsPerSec", nArg::Int);
+    nWatched watchQueueDepth("mangaMsgAsyncQueueDepth", nArg::Int);
+    nWatched watchNumAlive("mangaMsgNumAlive", nArg::Int);
+    nWatched watchNumChunks("mangaMsgPoolChunks", nArg::Int);
+    watchMsgRate->SetI((elapsed > 0.0) ? int(numSent / elapsed) : 0);
+    watchQueueDepth->SetI(this->statsMaxQueueDepth);
+    watchNumAlive->SetI(numAlive);
+    watchNumChunks->SetI(numChunks);
+    #endif
+    this->statsMaxQueueDepth = 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
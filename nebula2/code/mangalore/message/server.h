@@ -7,9 +7,21 @@
     The server of the message subsystem is the central communication point
     where all events go through.
 
+    Asynchronous messages are not put on the target port's queue right
+    away. They are collected in a single frame wide queue, in which the
+    messages for the same port are chained together, and are delivered in
+    one batch per port when the first port handles its pending messages,
+    or at the latest at the end of the frame in OnFrame(). The order of
+    the messages sent to one port is preserved.
+
+    The server also provides per frame statistics of the message traffic
+    as watcher variables (messages per second per message class, async
+    queue depth and pool allocations).
+
     (C) 2005 RadonLabs GmbH
 */
 #include "foundation/refcounted.h"
+#include "kernel/ntypes.h"
 
 //------------------------------------------------------------------------------
 namespace Message
@@ -29,6 +41,8 @@ public:
     virtual ~Server();
     /// get instance pointer
     static Server* Instance();
+    /// return true if the instance exists
+    static bool HasInstance();
     /// open the message server
     bool Open();
     /// close the message server
@@ -37,6 +51,12 @@ public:
     void RegisterPort(Port* port);
     /// unregister a broadcast message port from the server
     void UnregisterPort(Port* port);
+    /// set the current time
+    void SetTime(nTime t);
+    /// deliver queued asynchronous messages to the ports
+    void DeliverAsyncMessages();
+    /// call once per frame, delivers remaining messages and updates the statistics
+    void OnFrame();
 
 private:
     static Server* Singleton;
@@ -61,10 +81,31 @@ private:
     bool IsInBroadcast() const;
     /// end handle message
     void EndBroadcast();
+    /// append a message to the async queue
+    void QueueAsync(Port* port, Msg* msg);
+    /// deliver the async queue in batches per port
+    void DoDeliverAsyncMessages();
+    /// discard all queued asynchronous messages
+    void ClearAsyncMessages();
+    /// update the statistics watchers
+    void UpdateStats();
+
+    /// an asynchronous message waiting for delivery
+    struct AsyncMsg
+    {
+        Port* port;
+        Msg* msg;
+        int next;   ///< index of the next message for the same port, or -1
+    };
 
     bool isOpen;
     nArray<Ptr<Port> > portArray;
     int broadcastLockCount; ///< in the handle message trigger
+    nArray<AsyncMsg> asyncQueue;
+    bool inDeliver;
+    nTime time;
+    nTime statsTime;
+    int statsMaxQueueDepth;
 };
 
 RegisterFactory(Server);
@@ -80,6 +121,42 @@ Server::Instance()
     return Singleton;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+Server::HasInstance()
+{
+    return (0 != Singleton);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+Server::SetTime(nTime t)
+{
+    this->time = t;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Delivers the queued asynchronous messages. This is called by
+    Port::HandlePendingMessages(), so it must be cheap if the queue
+    is empty.
+*/
+inline
+void
+Server::DeliverAsyncMessages()
+{
+    if ((this->asyncQueue.Size() > 0) && !this->inDeliver)
+    {
+        this->DoDeliverAsyncMessages();
+    }
+}
+
 } // namespace Message
 //------------------------------------------------------------------------------
 #endif
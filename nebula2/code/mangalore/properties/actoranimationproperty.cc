@@ -37,6 +37,18 @@ ActorAnimationProperty::Accepts(Message::Msg* msg)
     return Game::Property::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+ActorAnimationProperty::SetupAcceptedMessages()
+{
+    Game::Property::SetupAcceptedMessages();
+    this->RegisterMessage(Message::MoveDirection::Id);
+    this->RegisterMessage(Message::MoveSetVelocity::Id);
+    this->RegisterMessage(Message::MoveStop::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
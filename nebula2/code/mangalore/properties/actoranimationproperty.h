@@ -25,6 +25,8 @@ public:
     virtual void OnActivate();
     /// listen to messages that may result to animation switch
     virtual bool Accepts(Message::Msg* msg);
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
     /// handle messages that may result to animation switch
     virtual void HandleMessage(Message::Msg* msg);
 
@@ -46,6 +46,22 @@ ActorGraphicsProperty::Accepts(Message::Msg* msg)
     return GraphicsProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+ActorGraphicsProperty::SetupAcceptedMessages()
+{
+    GraphicsProperty::SetupAcceptedMessages();
+    this->RegisterMessage(Message::GfxAddAttachment::Id);
+    this->RegisterMessage(Message::GfxRemAttachment::Id);
+    this->RegisterMessage(Message::GfxSetAnimation::Id);
+    this->RegisterMessage(Message::GfxAddSkin::Id);
+    this->RegisterMessage(Message::GfxRemSkin::Id);
+    this->RegisterMessage(Message::GfxSetCharacterSet::Id);
+    this->RegisterMessage(Message::UpdateTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
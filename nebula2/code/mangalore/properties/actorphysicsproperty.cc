@@ -139,6 +139,23 @@ ActorPhysicsProperty::Accepts(Message::Msg* msg)
            AbstractPhysicsProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+ActorPhysicsProperty::SetupAcceptedMessages()
+{
+    AbstractPhysicsProperty::SetupAcceptedMessages();
+    this->RegisterMessage(MoveDirection::Id);
+    this->RegisterMessage(MoveFollow::Id);
+    this->RegisterMessage(MoveGoto::Id);
+    this->RegisterMessage(MoveStop::Id);
+    this->RegisterMessage(SetTransform::Id);
+    this->RegisterMessage(MoveTurn::Id);
+    this->RegisterMessage(MoveSetVelocity::Id);
+    this->RegisterMessage(MoveRotate::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
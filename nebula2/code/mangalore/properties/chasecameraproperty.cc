@@ -143,6 +143,18 @@ ChaseCameraProperty::Accepts(Message::Msg* msg)
            msg->CheckId(CameraDistance::Id);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+ChaseCameraProperty::SetupAcceptedMessages()
+{
+    CameraProperty::SetupAcceptedMessages();
+    this->RegisterMessage(CameraOrbit::Id);
+    this->RegisterMessage(CameraReset::Id);
+    this->RegisterMessage(CameraDistance::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
     This method handles pending messages for the property. It is called
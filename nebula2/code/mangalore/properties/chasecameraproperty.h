@@ -52,6 +52,8 @@ public:
     virtual void OnRender();
     /// return true if message is accepted by controller
     virtual bool Accepts(Message::Msg* msg);
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
     /// handle a single message
     virtual void HandleMessage(Message::Msg* msg);
 
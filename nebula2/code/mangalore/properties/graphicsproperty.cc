@@ -147,6 +147,17 @@ GraphicsProperty::Accepts(Message::Msg* msg)
     return AbstractGraphicsProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+GraphicsProperty::SetupAcceptedMessages()
+{
+    AbstractGraphicsProperty::SetupAcceptedMessages();
+    this->RegisterMessage(Message::UpdateTransform::Id);
+    this->RegisterMessage(Message::GfxSetVisible::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
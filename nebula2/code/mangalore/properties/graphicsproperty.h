@@ -47,6 +47,8 @@ public:
 
     /// return true if message is accepted
     virtual bool Accepts(Message::Msg* msg);
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
     /// handle a single message
     virtual void HandleMessage(Message::Msg* msg);
 
@@ -143,6 +143,18 @@ PathAnimProperty::Accepts(Message::Msg* msg)
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+PathAnimProperty::SetupAcceptedMessages()
+{
+    Game::Property::SetupAcceptedMessages();
+    this->RegisterMessage(AnimPlay::Id);
+    this->RegisterMessage(AnimStop::Id);
+    this->RegisterMessage(AnimRewind::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
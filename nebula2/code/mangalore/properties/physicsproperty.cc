@@ -81,6 +81,16 @@ PhysicsProperty::Accepts(Message::Msg* msg)
     return AbstractPhysicsProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+PhysicsProperty::SetupAcceptedMessages()
+{
+    AbstractPhysicsProperty::SetupAcceptedMessages();
+    this->RegisterMessage(Message::SetTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
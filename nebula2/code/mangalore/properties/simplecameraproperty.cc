@@ -55,6 +55,17 @@ SimpleCameraProperty::Accepts(Message::Msg* msg)
     return CameraProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+SimpleCameraProperty::SetupAcceptedMessages()
+{
+    CameraProperty::SetupAcceptedMessages();
+    this->RegisterMessage(Message::CameraOrbit::Id);
+    this->RegisterMessage(Message::MoveDirection::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -138,6 +138,16 @@ SimpleGraphicsProperty::Accepts(Message::Msg* msg)
     return AbstractGraphicsProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+SimpleGraphicsProperty::SetupAcceptedMessages()
+{
+    AbstractGraphicsProperty::SetupAcceptedMessages();
+    this->RegisterMessage(Message::UpdateTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -52,6 +52,17 @@ TransformableProperty::Accepts(Message::Msg* msg)
     return Game::Property::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TransformableProperty::SetupAcceptedMessages()
+{
+    Game::Property::SetupAcceptedMessages();
+    this->RegisterMessage(Message::UpdateTransform::Id);
+    this->RegisterMessage(Message::SetTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -66,6 +66,16 @@ VideoCameraProperty::Accepts(Msg* msg)
     return CameraProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+VideoCameraProperty::SetupAcceptedMessages()
+{
+    CameraProperty::SetupAcceptedMessages();
+    this->RegisterMessage(UpdateTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -42,6 +42,8 @@ public:
     virtual void SetupDefaultAttributes();
     /// return true if message is accepted by a property
     virtual bool Accepts(Message::Msg* msg);
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
     /// handle a single message
     virtual void HandleMessage(Message::Msg* msg);
 private:
@@ -59,6 +59,16 @@ VideoCameraProperty2::Accepts(Msg* msg)
     return CameraProperty::Accepts(msg);
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+void
+VideoCameraProperty2::SetupAcceptedMessages()
+{
+    CameraProperty::SetupAcceptedMessages();
+    this->RegisterMessage(UpdateTransform::Id);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
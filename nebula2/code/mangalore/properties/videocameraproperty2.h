@@ -45,6 +45,8 @@ public:
     virtual void OnRender();
     /// return true if message is accepted by a property
     virtual bool Accepts(Message::Msg* msg);
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
     /// handle a single message
     virtual void HandleMessage(Message::Msg* msg);
 
@@ -0,0 +1,363 @@
+//------------------------------------------------------------------------------
+//  tests/attributecontainertest.cc
+//
+//  Tests and benchmarks the attribute lookup of Db::AttributeContainer
+//  through shared attribute schemas. The tests compare HasAttr() and
+//  GetAttr() with a search of the attribute array for containers which
+//  have been set up with random attributes in random order, and check
+//  that GetAttrs() keeps the attributes in the order they were added.
+//
+//  The benchmark sets up containers with 61 attributes (40 floats, 20
+//  vectors and a transform) and reads 10 attributes per container per
+//  frame, once by searching the attribute array, which is how the
+//  attributes were looked up before, and once through GetAttr().
+//
+//  Command line args:
+//  -containers     number of containers (default: 10000)
+//  -frames         number of measured frames (default: 100)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "db/attributecontainer.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+#define DefineFloat4(n) DefineFloat(F##n##a); DefineFloat(F##n##b); DefineFloat(F##n##c); DefineFloat(F##n##d);
+#define DefineVector34(n) DefineVector3(V##n##a); DefineVector3(V##n##b); DefineVector3(V##n##c); DefineVector3(V##n##d);
+
+namespace Attr
+{
+    DefineFloat4(0); DefineFloat4(1); DefineFloat4(2); DefineFloat4(3); DefineFloat4(4);
+    DefineFloat4(5); DefineFloat4(6); DefineFloat4(7); DefineFloat4(8); DefineFloat4(9);
+    DefineVector34(0); DefineVector34(1); DefineVector34(2); DefineVector34(3); DefineVector34(4);
+    DefineMatrix44(Transform);
+};
+
+static const int NumFloats = 40;
+static const int NumVectors = 20;
+static const int NumAttrs = NumFloats + NumVectors + 1;
+
+//------------------------------------------------------------------------------
+/**
+    Return the attribute ids used by the test.
+*/
+static nArray<Attr::AttributeID>
+GetTestIds()
+{
+    using namespace Attr;
+    const _attridTyped<attr::FloatT>* floats[NumFloats] =
+    {
+        F0a, F0b, F0c, F0d, F1a, F1b, F1c, F1d, F2a, F2b, F2c, F2d, F3a, F3b, F3c, F3d,
+        F4a, F4b, F4c, F4d, F5a, F5b, F5c, F5d, F6a, F6b, F6c, F6d, F7a, F7b, F7c, F7d,
+        F8a, F8b, F8c, F8d, F9a, F9b, F9c, F9d
+    };
+    const _attridTyped<attr::Vector3T>* vectors[NumVectors] =
+    {
+        V0a, V0b, V0c, V0d, V1a, V1b, V1c, V1d, V2a, V2b, V2c, V2d,
+        V3a, V3b, V3c, V3d, V4a, V4b, V4c, V4d
+    };
+    nArray<Attr::AttributeID> ids;
+    int i;
+    for (i = 0; i < NumFloats; i++)
+    {
+        ids.Append(FloatAttributeID(floats[i]));
+    }
+    for (i = 0; i < NumVectors; i++)
+    {
+        ids.Append(Vector3AttributeID(vectors[i]));
+    }
+    ids.Append(Matrix44AttributeID(Transform));
+    return ids;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create an attribute of the id's type with a value derived from an
+    integer.
+*/
+static Db::Attribute
+CreateAttr(const Attr::AttributeID& id, int value)
+{
+    switch (id.GetType())
+    {
+        case _attrid::Float:
+            return Db::Attribute(Attr::FloatAttributeID(id.GetName()), float(value));
+
+        case _attrid::Vector3:
+            return Db::Attribute(Attr::Vector3AttributeID(id.GetName()), vector3(float(value), 1.0f, 2.0f));
+
+        default:
+        {
+            matrix44 m;
+            m.M41 = float(value);
+            return Db::Attribute(Attr::Matrix44AttributeID(id.GetName()), m);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Return the integer an attribute value has been derived from.
+*/
+static int
+GetAttrValue(const Db::Attribute& attr)
+{
+    switch (attr.GetType())
+    {
+        case _attrid::Float:    return int(attr.GetFloat());
+        case _attrid::Vector3:  return int(attr.GetVector3().x);
+        default:                return int(attr.GetMatrix44().M41);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Find an attribute by searching the attribute array, this is how the
+    container looked up its attributes before it had a schema.
+*/
+static int
+FindAttrIndex(const Db::AttributeContainer& container, const Attr::AttributeID& id)
+{
+    const nArray<Db::Attribute>& attrs = container.GetAttrs();
+    int num = attrs.Size();
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        if (attrs[i].GetAttributeID() == id)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compare the lookup of all test ids with a search of the attribute
+    array. Returns the number of differences.
+*/
+static int
+CheckContainer(const Db::AttributeContainer& container, const nArray<Attr::AttributeID>& ids)
+{
+    int numWrong = 0;
+    int i;
+    for (i = 0; i < ids.Size(); i++)
+    {
+        int index = FindAttrIndex(container, ids[i]);
+        if (container.HasAttr(ids[i]) != (-1 != index))
+        {
+            numWrong++;
+        }
+        else if ((-1 != index) && (&container.GetAttr(ids[i]) != &container.GetAttrs()[index]))
+        {
+            numWrong++;
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set, overwrite and clear attributes, and keep the order of
+    GetAttrs().
+*/
+static void
+TestContainer(const nArray<Attr::AttributeID>& ids)
+{
+    Db::AttributeContainer a;
+    Db::AttributeContainer b;
+    int i;
+    for (i = 0; i < 10; i++)
+    {
+        a.SetAttr(CreateAttr(ids[i], i));
+        b.SetAttr(CreateAttr(ids[9 - i], 9 - i));
+    }
+    n_test(10 == a.GetAttrs().Size());
+    n_test(10 == b.GetAttrs().Size());
+    n_test(0 == CheckContainer(a, ids));
+    n_test(0 == CheckContainer(b, ids));
+
+    // the same attributes in another order have another array order
+    int numWrong = 0;
+    for (i = 0; i < 10; i++)
+    {
+        if ((a.GetAttrs()[i].GetAttributeID() != ids[i]) || (b.GetAttrs()[i].GetAttributeID() != ids[9 - i]))
+        {
+            numWrong++;
+        }
+        if ((GetAttrValue(a.GetAttr(ids[i])) != i) || (GetAttrValue(b.GetAttr(ids[i])) != i))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+
+    // overwriting keeps the attribute in its place
+    a.SetAttr(CreateAttr(ids[3], 100));
+    n_test(10 == a.GetAttrs().Size());
+    n_test(100 == GetAttrValue(a.GetAttrs()[3]));
+    n_test(100 == GetAttrValue(a.GetAttr(ids[3])));
+
+    // a copy looks up its own attributes
+    Db::AttributeContainer c = a;
+    c.SetAttr(CreateAttr(ids[3], 200));
+    c.SetAttr(CreateAttr(ids[20], 20));
+    n_test(100 == GetAttrValue(a.GetAttr(ids[3])));
+    n_test(200 == GetAttrValue(c.GetAttr(ids[3])));
+    n_test(!a.HasAttr(ids[20]));
+    n_test(c.HasAttr(ids[20]));
+    n_test(0 == CheckContainer(a, ids));
+    n_test(0 == CheckContainer(c, ids));
+
+    // a cleared container starts over
+    a.Clear();
+    n_test(0 == a.GetAttrs().Size());
+    n_test(0 == CheckContainer(a, ids));
+    a.SetAttr(CreateAttr(ids[5], 5));
+    n_test(a.HasAttr(ids[5]));
+    n_test(!a.HasAttr(ids[0]));
+    n_test(0 == CheckContainer(a, ids));
+
+    // an id which is created after the lookup tables have been built
+    _attridTyped<attr::FloatT> lateData("LateFloat", _attrid::Float, _attrid::Read | _attrid::Write);
+    Attr::FloatAttributeID lateId(&lateData);
+    n_test(!a.HasAttr(lateId));
+    n_test(!b.HasAttr(lateId));
+    a.SetAttr(Db::Attribute(lateId, 7.0f));
+    n_test(a.HasAttr(lateId));
+    n_test(7.0f == a.GetAttr(lateId).GetFloat());
+    n_test(a.HasAttr(ids[5]));
+    n_test(!b.HasAttr(lateId));
+    n_test(2 == a.GetAttrs().Size());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set up containers with random subsets of the attributes in random
+    order, and compare the lookup with a search of the attribute array.
+*/
+static void
+TestRandom(const nArray<Attr::AttributeID>& ids)
+{
+    srand(1);
+    const int numContainers = 2000;
+    nArray<Db::AttributeContainer> containers(numContainers, 0);
+    containers.SetFixedSize(numContainers);
+    int i;
+    for (i = 0; i < numContainers * 10; i++)
+    {
+        Db::AttributeContainer& container = containers[rand() % numContainers];
+        int op = rand() % 100;
+        if (op == 0)
+        {
+            container.Clear();
+        }
+        else
+        {
+            // only use a few ids for most containers, so that schemas are shared
+            int idIndex = (op < 80) ? (rand() % 8) : (rand() % ids.Size());
+            container.SetAttr(CreateAttr(ids[idIndex], i));
+        }
+    }
+    int numWrong = 0;
+    for (i = 0; i < numContainers; i++)
+    {
+        numWrong += CheckContainer(containers[i], ids);
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numContainers = n_max(1, args.GetIntArg("-containers", 10000));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 100));
+
+    nKernelServer kernelServer;
+    nArray<Attr::AttributeID> ids = GetTestIds();
+    TestContainer(ids);
+    TestRandom(ids);
+
+    // set up the benchmark containers, all with the same attributes
+    nArray<Db::AttributeContainer> containers(numContainers, 0);
+    containers.SetFixedSize(numContainers);
+    int c;
+    for (c = 0; c < numContainers; c++)
+    {
+        int i;
+        for (i = 0; i < NumAttrs; i++)
+        {
+            containers[c].SetAttr(CreateAttr(ids[i], i));
+        }
+    }
+
+    // the read attributes, spread over the attribute array
+    Attr::Matrix44AttributeID transform(ids[60].GetName());
+    Attr::Vector3AttributeID v0(ids[40].GetName());
+    Attr::Vector3AttributeID v1(ids[50].GetName());
+    Attr::Vector3AttributeID v2(ids[59].GetName());
+    Attr::FloatAttributeID f0(ids[0].GetName());
+    Attr::FloatAttributeID f1(ids[13].GetName());
+    Attr::FloatAttributeID f2(ids[22].GetName());
+    Attr::FloatAttributeID f3(ids[31].GetName());
+    Attr::FloatAttributeID f4(ids[36].GetName());
+    Attr::FloatAttributeID f5(ids[39].GetName());
+
+    // searching the attribute array
+    float searchSum = 0.0f;
+    nTest::Timer timer;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        for (c = 0; c < numContainers; c++)
+        {
+            const Db::AttributeContainer& container = containers[c];
+            const nArray<Db::Attribute>& attrs = container.GetAttrs();
+            searchSum += attrs[FindAttrIndex(container, transform)].GetMatrix44().M41;
+            searchSum += attrs[FindAttrIndex(container, v0)].GetVector3().x;
+            searchSum += attrs[FindAttrIndex(container, v1)].GetVector3().x;
+            searchSum += attrs[FindAttrIndex(container, v2)].GetVector3().x;
+            searchSum += attrs[FindAttrIndex(container, f0)].GetFloat();
+            searchSum += attrs[FindAttrIndex(container, f1)].GetFloat();
+            searchSum += attrs[FindAttrIndex(container, f2)].GetFloat();
+            searchSum += attrs[FindAttrIndex(container, f3)].GetFloat();
+            searchSum += attrs[FindAttrIndex(container, f4)].GetFloat();
+            searchSum += (-1 != FindAttrIndex(container, f5)) ? 1.0f : 0.0f;
+        }
+    }
+    double searchTime = timer.GetTime();
+
+    // looking up through the schema
+    float lookupSum = 0.0f;
+    timer.Start();
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        for (c = 0; c < numContainers; c++)
+        {
+            const Db::AttributeContainer& container = containers[c];
+            lookupSum += container.GetAttr(transform).GetMatrix44().M41;
+            lookupSum += container.GetAttr(v0).GetVector3().x;
+            lookupSum += container.GetAttr(v1).GetVector3().x;
+            lookupSum += container.GetAttr(v2).GetVector3().x;
+            lookupSum += container.GetAttr(f0).GetFloat();
+            lookupSum += container.GetAttr(f1).GetFloat();
+            lookupSum += container.GetAttr(f2).GetFloat();
+            lookupSum += container.GetAttr(f3).GetFloat();
+            lookupSum += container.GetAttr(f4).GetFloat();
+            lookupSum += container.HasAttr(f5) ? 1.0f : 0.0f;
+        }
+    }
+    double lookupTime = timer.GetTime();
+    n_test(searchSum == lookupSum);
+
+    printf("%d containers with %d attributes, 10 reads per container:\n", numContainers, NumAttrs);
+    printf("search: %.3f ms/frame\n", searchTime * 1000.0 / numFrames);
+    printf("schema: %.3f ms/frame\n", lookupTime * 1000.0 / numFrames);
+
+    return nTest::Finish("attributecontainertest");
+}
@@ -0,0 +1,675 @@
+//------------------------------------------------------------------------------
+//  tests/dispatchertest.cc
+//
+//  Tests and benchmarks the message id routing of Message::Dispatcher.
+//  The tests check that every attached port gets exactly the messages
+//  its Accepts() accepts, for ports which declare their message ids and
+//  ports which don't, for ports attached or removed while a message is
+//  handled, and for random attach, remove and send operations against
+//  a reference which asks every port.
+//
+//  The benchmark sends 3 messages per entity and frame to entities with
+//  10 ports each, the ports of all entities are scattered in memory.
+//  One message is accepted by 3 ports, the others by 1 port. It compares
+//  the old dispatching, which asks every port with Accepts(), with the
+//  routed Dispatcher::HandleMessage().
+//
+//  Command line args:
+//  -entities   number of entities (default: 5000)
+//  -ports      number of ports per entity (default: 10)
+//  -frames     number of measured frames (default: 100)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "message/dispatcher.h"
+#include "message/server.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const int NumMsgTypes = 24;
+
+//------------------------------------------------------------------------------
+/**
+    Declare and implement a test message class.
+*/
+#define TestMsg(type) \
+class type : public Message::Msg \
+{ \
+    DeclareRtti; \
+    DeclareFactory(type); \
+    DeclareMsgId; \
+}; \
+RegisterFactory(type); \
+ImplementRtti(type, Message::Msg); \
+ImplementFactory(type); \
+ImplementMsgId(type);
+
+TestMsg(TestMsg0);
+TestMsg(TestMsg1);
+TestMsg(TestMsg2);
+TestMsg(TestMsg3);
+TestMsg(TestMsg4);
+TestMsg(TestMsg5);
+TestMsg(TestMsg6);
+TestMsg(TestMsg7);
+TestMsg(TestMsg8);
+TestMsg(TestMsg9);
+TestMsg(TestMsg10);
+TestMsg(TestMsg11);
+TestMsg(TestMsg12);
+TestMsg(TestMsg13);
+TestMsg(TestMsg14);
+TestMsg(TestMsg15);
+TestMsg(TestMsg16);
+TestMsg(TestMsg17);
+TestMsg(TestMsg18);
+TestMsg(TestMsg19);
+TestMsg(TestMsg20);
+TestMsg(TestMsg21);
+TestMsg(TestMsg22);
+TestMsg(TestMsg23);
+
+//------------------------------------------------------------------------------
+/**
+    Create a test message by message type index.
+*/
+static Message::Msg*
+CreateMsg(int type)
+{
+    n_assert((type >= 0) && (type < NumMsgTypes));
+    nString className;
+    className.Format("TestMsg%d", type);
+    return (Message::Msg*) Foundation::Factory::Instance()->Create(className);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the message id of a test message type.
+*/
+static const Message::Id&
+MsgId(int type)
+{
+    Ptr<Message::Msg> msg = CreateMsg(type);
+    return msg->GetId();
+}
+
+//------------------------------------------------------------------------------
+/**
+    A port which accepts a set of message ids, like a property does. It
+    declares the ids, unless it is created as a port which must be
+    offered every message. It may attach or remove another port at a
+    dispatcher and send another message while it handles a message.
+*/
+class TestPort : public Message::Port
+{
+    DeclareRtti;
+public:
+    /// constructor
+    TestPort(bool declare);
+    /// add an accepted message id, before the port is attached
+    void AddMessage(const Message::Id& id);
+    /// enable or disable the port, Accepts() rejects every message when disabled
+    void SetEnabled(bool b);
+    /// attach a port on the next handled message
+    void SetAttachOnHandle(Message::Dispatcher* dispatcher, Message::Port* port);
+    /// remove a port on the next handled message
+    void SetRemoveOnHandle(Message::Dispatcher* dispatcher, Message::Port* port);
+    /// send a message to the dispatcher on the next handled message
+    void SetSendOnHandle(Message::Dispatcher* dispatcher, Message::Msg* msg);
+    /// return true if the port accepts a message
+    virtual bool Accepts(Message::Msg* msg);
+    /// handle a message
+    virtual void HandleMessage(Message::Msg* msg);
+    /// get number of handled messages
+    int GetNumHandled() const;
+    /// get number of handled messages of a type
+    int GetNumHandled(const Message::Id& id) const;
+
+    static int NumAcceptsCalls;
+
+protected:
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
+
+private:
+    bool declare;
+    bool enabled;
+    nArray<const Message::Id*> ids;
+    nArray<int> numHandled;
+    Message::Dispatcher* dispatcher;
+    Ptr<Message::Port> attachPort;
+    Ptr<Message::Port> removePort;
+    Ptr<Message::Msg> sendMsg;
+};
+ImplementRtti(TestPort, Message::Port);
+int TestPort::NumAcceptsCalls = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+TestPort::TestPort(bool declare) :
+    declare(declare),
+    enabled(true),
+    dispatcher(0)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::AddMessage(const Message::Id& id)
+{
+    if (0 == this->ids.Find(&id))
+    {
+        this->ids.Append(&id);
+        this->numHandled.Append(0);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::SetEnabled(bool b)
+{
+    this->enabled = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::SetAttachOnHandle(Message::Dispatcher* dispatcher, Message::Port* port)
+{
+    this->dispatcher = dispatcher;
+    this->attachPort = port;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::SetRemoveOnHandle(Message::Dispatcher* dispatcher, Message::Port* port)
+{
+    this->dispatcher = dispatcher;
+    this->removePort = port;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::SetSendOnHandle(Message::Dispatcher* dispatcher, Message::Msg* msg)
+{
+    this->dispatcher = dispatcher;
+    this->sendMsg = msg;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::SetupAcceptedMessages()
+{
+    if (this->declare)
+    {
+        for (int i = 0; i < this->ids.Size(); i++)
+        {
+            this->RegisterMessage(*this->ids[i]);
+        }
+    }
+    else
+    {
+        Port::SetupAcceptedMessages();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+TestPort::Accepts(Message::Msg* msg)
+{
+    NumAcceptsCalls++;
+    if (this->enabled)
+    {
+        for (int i = 0; i < this->ids.Size(); i++)
+        {
+            if (msg->CheckId(*this->ids[i]))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPort::HandleMessage(Message::Msg* msg)
+{
+    for (int i = 0; i < this->ids.Size(); i++)
+    {
+        if (msg->CheckId(*this->ids[i]))
+        {
+            this->numHandled[i]++;
+        }
+    }
+    if (this->attachPort.isvalid())
+    {
+        this->dispatcher->AttachPort(this->attachPort);
+        this->attachPort = 0;
+    }
+    if (this->removePort.isvalid())
+    {
+        this->dispatcher->RemovePort(this->removePort);
+        this->removePort = 0;
+    }
+    if (this->sendMsg.isvalid())
+    {
+        Ptr<Message::Msg> sendMsg = this->sendMsg;
+        this->sendMsg = 0;
+        sendMsg->SendSync(this->dispatcher);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+TestPort::GetNumHandled() const
+{
+    int num = 0;
+    for (int i = 0; i < this->numHandled.Size(); i++)
+    {
+        num += this->numHandled[i];
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+TestPort::GetNumHandled(const Message::Id& id) const
+{
+    for (int i = 0; i < this->ids.Size(); i++)
+    {
+        if (this->ids[i] == &id)
+        {
+            return this->numHandled[i];
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Messages reach the declaring ports and the ports which don't declare
+    ids, through HandleMessage() and Put().
+*/
+static void
+TestRouting()
+{
+    Ptr<Message::Dispatcher> dispatcher = Message::Dispatcher::Create();
+    Ptr<TestPort> portAB = n_new(TestPort(true));
+    portAB->AddMessage(TestMsg0::Id);
+    portAB->AddMessage(TestMsg1::Id);
+    Ptr<TestPort> portB = n_new(TestPort(true));
+    portB->AddMessage(TestMsg1::Id);
+    Ptr<TestPort> anyPort = n_new(TestPort(false));
+    anyPort->AddMessage(TestMsg0::Id);
+    anyPort->AddMessage(TestMsg2::Id);
+    Ptr<TestPort> disabledPort = n_new(TestPort(true));
+    disabledPort->AddMessage(TestMsg2::Id);
+    disabledPort->SetEnabled(false);
+    dispatcher->AttachPort(portAB);
+    dispatcher->AttachPort(portB);
+    dispatcher->AttachPort(anyPort);
+    dispatcher->AttachPort(disabledPort);
+
+    // message 3 isn't declared by any port
+    int type;
+    for (type = 0; type < 4; type++)
+    {
+        Ptr<Message::Msg> msg = CreateMsg(type);
+        msg->SendSync(dispatcher);
+    }
+    n_test(1 == portAB->GetNumHandled(TestMsg0::Id));
+    n_test(1 == portAB->GetNumHandled(TestMsg1::Id));
+    n_test(1 == portB->GetNumHandled());
+    n_test(1 == anyPort->GetNumHandled(TestMsg0::Id));
+    n_test(1 == anyPort->GetNumHandled(TestMsg2::Id));
+    n_test(0 == disabledPort->GetNumHandled());
+
+    // queued on the ports
+    for (type = 0; type < 4; type++)
+    {
+        Ptr<Message::Msg> msg = CreateMsg(type);
+        dispatcher->Put(msg);
+    }
+    n_test(2 == portAB->GetNumHandled());
+    portAB->HandlePendingMessages();
+    portB->HandlePendingMessages();
+    anyPort->HandlePendingMessages();
+    disabledPort->HandlePendingMessages();
+    n_test(4 == portAB->GetNumHandled());
+    n_test(2 == portB->GetNumHandled());
+    n_test(4 == anyPort->GetNumHandled());
+    n_test(0 == disabledPort->GetNumHandled());
+
+    // removing and attaching
+    dispatcher->RemovePort(portAB);
+    Ptr<TestPort> portD = n_new(TestPort(true));
+    portD->AddMessage(TestMsg3::Id);
+    dispatcher->AttachPort(portD);
+    Ptr<Message::Msg> msg0 = CreateMsg(0);
+    msg0->SendSync(dispatcher);
+    Ptr<Message::Msg> msg3 = CreateMsg(3);
+    msg3->SendSync(dispatcher);
+    n_test(4 == portAB->GetNumHandled());
+    n_test(3 == anyPort->GetNumHandled(TestMsg0::Id));
+    n_test(1 == portD->GetNumHandled());
+    disabledPort->SetEnabled(true);
+    Ptr<Message::Msg> msg2 = CreateMsg(2);
+    msg2->SendSync(dispatcher);
+    n_test(1 == disabledPort->GetNumHandled());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Ports attached or removed while a message is handled.
+*/
+static void
+TestHandleLock()
+{
+    Ptr<Message::Dispatcher> dispatcher = Message::Dispatcher::Create();
+    Ptr<TestPort> first = n_new(TestPort(true));
+    first->AddMessage(TestMsg0::Id);
+    Ptr<TestPort> second = n_new(TestPort(true));
+    second->AddMessage(TestMsg0::Id);
+    Ptr<TestPort> attached = n_new(TestPort(true));
+    attached->AddMessage(TestMsg0::Id);
+    attached->AddMessage(TestMsg1::Id);
+    dispatcher->AttachPort(first);
+    dispatcher->AttachPort(second);
+
+    // the first port removes the second one and attaches another port,
+    // the removed port must not get the message any more, the attached
+    // port gets it from the next message on
+    first->SetRemoveOnHandle(dispatcher, second);
+    first->SetAttachOnHandle(dispatcher, attached);
+    Ptr<Message::Msg> msg0 = CreateMsg(0);
+    msg0->SendSync(dispatcher);
+    n_test(1 == first->GetNumHandled());
+    n_test(0 == second->GetNumHandled());
+    n_test(0 == attached->GetNumHandled());
+    msg0->SendSync(dispatcher);
+    n_test(2 == first->GetNumHandled());
+    n_test(0 == second->GetNumHandled());
+    n_test(1 == attached->GetNumHandled());
+
+    // a message sent while the ports are being changed in a handler
+    // reaches the new port as well
+    Ptr<TestPort> late = n_new(TestPort(true));
+    late->AddMessage(TestMsg1::Id);
+    first->SetAttachOnHandle(dispatcher, late);
+    first->SetSendOnHandle(dispatcher, CreateMsg(1));
+    msg0->SendSync(dispatcher);
+    n_test(1 == late->GetNumHandled());
+    n_test(1 == attached->GetNumHandled(TestMsg1::Id));
+    n_test(2 == attached->GetNumHandled(TestMsg0::Id));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Random attach, remove, enable and send operations. The expected
+    messages are counted by asking every attached port with Accepts().
+*/
+static void
+TestRandom()
+{
+    const int numPorts = 20;
+    const int numTypes = 6;
+    nRandom random(1234);
+    Ptr<Message::Dispatcher> dispatcher = Message::Dispatcher::Create();
+    nArray<Ptr<TestPort> > ports;
+    nArray<bool> attached;
+    nArray<int> expected;
+    int i;
+    for (i = 0; i < numPorts; i++)
+    {
+        TestPort* port = n_new(TestPort(0 != (i % 5)));
+        int numIds = 1 + random.Next() % 3;
+        while (numIds-- > 0)
+        {
+            port->AddMessage(MsgId(random.Next() % numTypes));
+        }
+        ports.Append(port);
+        attached.Append(false);
+        expected.Append(0);
+    }
+    int numWrong = 0;
+    int iter;
+    for (iter = 0; iter < 20000; iter++)
+    {
+        int portIndex = random.Next() % numPorts;
+        int op = random.Next() % 10;
+        if (op < 2)
+        {
+            if (!attached[portIndex])
+            {
+                dispatcher->AttachPort(ports[portIndex]);
+                attached[portIndex] = true;
+            }
+        }
+        else if (op < 3)
+        {
+            if (attached[portIndex])
+            {
+                dispatcher->RemovePort(ports[portIndex]);
+                attached[portIndex] = false;
+            }
+        }
+        else if (op < 4)
+        {
+            ports[portIndex]->SetEnabled(0 != (random.Next() & 1));
+        }
+        else
+        {
+            Ptr<Message::Msg> msg = CreateMsg(random.Next() % (numTypes + 1));
+            for (i = 0; i < numPorts; i++)
+            {
+                if (attached[i] && ports[i]->Accepts(msg))
+                {
+                    expected[i]++;
+                }
+            }
+            msg->SendSync(dispatcher);
+            for (i = 0; i < numPorts; i++)
+            {
+                if (ports[i]->GetNumHandled() != expected[i])
+                {
+                    numWrong++;
+                    expected[i] = ports[i]->GetNumHandled();
+                }
+            }
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The old Dispatcher::HandleMessage(), which asks every port.
+*/
+static void
+PollPorts(const nArray<Ptr<Message::Port> >& ports, Message::Msg* msg)
+{
+    int num = ports.Size();
+    for (int i = 0; i < num; i++)
+    {
+        if (ports[i]->Accepts(msg))
+        {
+            ports[i]->HandleMessage(msg);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numEntities = n_max(1, args.GetIntArg("-entities", 5000));
+    int numPortsPerEntity = n_max(3, args.GetIntArg("-ports", 10));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 100));
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    Ptr<Message::Server> msgServer = Message::Server::Create();
+    msgServer->Open();
+
+    TestRouting();
+    TestHandleLock();
+    TestRandom();
+
+    // create the ports of all entities in random order, so that the ports
+    // of an entity are scattered in memory, port p accepts the message
+    // types 2p and 2p+1, the first 3 ports also accept the last type
+    int numPorts = numEntities * numPortsPerEntity;
+    nRandom random(4321);
+    nArray<int> order;
+    int i;
+    for (i = 0; i < numPorts; i++)
+    {
+        order.Append(i);
+    }
+    for (i = numPorts - 1; i > 0; i--)
+    {
+        int j = random.Next() % (i + 1);
+        int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    nArray<Ptr<TestPort> > allPorts;
+    allPorts.SetFixedSize(numPorts);
+    for (i = 0; i < numPorts; i++)
+    {
+        int p = order[i] % numPortsPerEntity;
+        TestPort* port = n_new(TestPort(true));
+        port->AddMessage(MsgId((p * 2) % (NumMsgTypes - 1)));
+        port->AddMessage(MsgId((p * 2 + 1) % (NumMsgTypes - 1)));
+        if (p < 3)
+        {
+            port->AddMessage(MsgId(NumMsgTypes - 1));
+        }
+        allPorts[order[i]] = port;
+    }
+    nArray<Ptr<Message::Dispatcher> > dispatchers;
+    nArray<nArray<Ptr<Message::Port> > > entityPorts;
+    dispatchers.SetFixedSize(numEntities);
+    entityPorts.SetFixedSize(numEntities);
+    int entity;
+    for (entity = 0; entity < numEntities; entity++)
+    {
+        dispatchers[entity] = Message::Dispatcher::Create();
+        int p;
+        for (p = 0; p < numPortsPerEntity; p++)
+        {
+            Message::Port* port = allPorts[entity * numPortsPerEntity + p];
+            dispatchers[entity]->AttachPort(port);
+            entityPorts[entity].Append(port);
+        }
+    }
+
+    // like an UpdateTransform and two messages for a single property
+    Ptr<Message::Msg> msgs[3];
+    msgs[0] = CreateMsg(NumMsgTypes - 1);
+    msgs[1] = CreateMsg(3);
+    msgs[2] = CreateMsg(12);
+
+    // the number of ports of an entity which accept the messages
+    int numAccepted = 0;
+    int m;
+    for (m = 0; m < 3; m++)
+    {
+        for (i = 0; i < numPortsPerEntity; i++)
+        {
+            if (entityPorts[0][i]->Accepts(msgs[m]))
+            {
+                numAccepted++;
+            }
+        }
+    }
+
+    double times[2];
+    int numAccepts[2];
+    int mode;
+    for (mode = 0; mode < 2; mode++)
+    {
+        // the first frame builds the routes and isn't measured
+        times[mode] = 0.0;
+        int frame;
+        for (frame = 0; frame <= numFrames; frame++)
+        {
+            if (1 == frame)
+            {
+                TestPort::NumAcceptsCalls = 0;
+            }
+            nTest::Timer timer;
+            for (entity = 0; entity < numEntities; entity++)
+            {
+                for (m = 0; m < 3; m++)
+                {
+                    if (0 == mode)
+                    {
+                        PollPorts(entityPorts[entity], msgs[m]);
+                    }
+                    else
+                    {
+                        dispatchers[entity]->HandleMessage(msgs[m]);
+                    }
+                }
+            }
+            if (frame > 0)
+            {
+                times[mode] += timer.GetTime();
+            }
+        }
+        numAccepts[mode] = TestPort::NumAcceptsCalls;
+    }
+
+    // both modes handled the same messages
+    int numHandled = 0;
+    for (i = 0; i < numPorts; i++)
+    {
+        numHandled += allPorts[i]->GetNumHandled();
+    }
+    n_test(numHandled == (2 * (numFrames + 1) * numEntities * numAccepted));
+    n_test(numAccepts[0] == (numFrames * numEntities * 3 * numPortsPerEntity));
+    n_test(numAccepts[1] == (numFrames * numEntities * numAccepted));
+
+    double numMsgs = double(numFrames) * numEntities * 3;
+    printf("%d entities x %d ports, 3 messages per entity:\n", numEntities, numPortsPerEntity);
+    printf("polled: %.3f ms/frame, %.2f Accepts() calls per message\n",
+        times[0] * 1000.0 / numFrames, numAccepts[0] / numMsgs);
+    printf("routed: %.3f ms/frame, %.2f Accepts() calls per message\n",
+        times[1] * 1000.0 / numFrames, numAccepts[1] / numMsgs);
+
+    dispatchers.Clear();
+    entityPorts.Clear();
+    allPorts.Clear();
+    msgServer->Close();
+    return nTest::Finish("dispatchertest");
+}
@@ -0,0 +1,604 @@
+//------------------------------------------------------------------------------
+//  tests/entitymanagertest.cc
+//
+//  Tests and benchmarks the attribute indexes of Managers::EntityManager.
+//  The tests compare the entity lookups by GUID, Name and _Category with
+//  a scan of all attached entities, while entities are attached, removed
+//  and renamed, inside and outside of the frame, and when attributes are
+//  loaded from the world database. They also check that the world
+//  database gets indexes on the looked up columns of the _Entities table.
+//
+//  The benchmark attaches live entities and looks up entities by GUID,
+//  every 10th GUID doesn't exist. It compares a scan of the attached
+//  entities, which is how GetEntitiesByAttrs() found live entities
+//  before, with the lookups of the entity manager, and measures
+//  renaming all entities.
+//
+//  Command line args:
+//  -entities   number of entities (default: 20000)
+//  -lookups    number of lookups per frame (default: 1000)
+//  -frames     number of measured frames with the index (default: 100)
+//  -dir        directory of the test database (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "sql/nsqlserver.h"
+#include "sql/nsqldatabase.h"
+#include "sql/nsqlquery.h"
+#include "attr/attributes.h"
+#include "db/server.h"
+#include "game/server.h"
+#include "game/entity.h"
+#include "message/server.h"
+#include "physics/server.h"
+#include "managers/entitymanager.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+using namespace Game;
+using namespace Managers;
+
+//------------------------------------------------------------------------------
+/**
+    A physics server which doesn't simulate anything, so that the entity
+    manager can run frames without physics data.
+*/
+class TestPhysicsServer : public Physics::Server
+{
+public:
+    /// open the physics subsystem
+    virtual bool Open();
+    /// close the physics subsystem
+    virtual void Close();
+    /// perform simulation steps
+    virtual void Trigger();
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+TestPhysicsServer::Open()
+{
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPhysicsServer::Close()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+TestPhysicsServer::Trigger()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+    An entity which attaches, removes and renames entities at the
+    beginning of a frame, and looks them up in the same frame.
+*/
+class FrameEntity : public Entity
+{
+public:
+    /// called at the beginning of the frame
+    virtual void OnBeginFrame();
+
+    Ptr<Entity> attachEntity;
+    Ptr<Entity> removeEntity;
+    Ptr<Entity> renameEntity;
+    nString newName;
+    bool foundAttached;
+    bool foundRemoved;
+    bool foundRenamed;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+FrameEntity::OnBeginFrame()
+{
+    Entity::OnBeginFrame();
+    EntityManager* entityManager = EntityManager::Instance();
+    if (this->attachEntity.isvalid())
+    {
+        entityManager->AttachEntity(this->attachEntity);
+        this->foundAttached = entityManager->GetEntityByName(this->attachEntity->GetString(Attr::Name), true).isvalid();
+        this->attachEntity = 0;
+    }
+    if (this->removeEntity.isvalid())
+    {
+        entityManager->RemoveEntity(this->removeEntity);
+        this->foundRemoved = entityManager->GetEntityByName(this->removeEntity->GetString(Attr::Name), true).isvalid();
+        this->removeEntity = 0;
+    }
+    if (this->renameEntity.isvalid())
+    {
+        this->renameEntity->SetString(Attr::Name, this->newName);
+        this->foundRenamed = (entityManager->GetEntityByName(this->newName, true) == this->renameEntity);
+        this->renameEntity = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create an entity with GUID, Name and _Category.
+*/
+static Ptr<Entity>
+CreateEntity(const nString& guid, const nString& name, const nString& category)
+{
+    Ptr<Entity> entity = Entity::Create();
+    entity->SetString(Attr::GUID, guid);
+    entity->SetString(Attr::Name, name);
+    entity->SetString(Attr::_Category, category);
+    return entity;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Find the live entities with the given attributes by looking at all
+    attached entities, like GetEntitiesByAttrs() did before the entity
+    manager had attribute indexes.
+*/
+static nArray<Entity*>
+ScanEntities(const nArray<Db::Attribute>& attributes, bool onlyFirstEntity)
+{
+    nArray<Entity*> result;
+    EntityManager* entityManager = EntityManager::Instance();
+    int numEntities = entityManager->GetNumEntities();
+    int entityIndex;
+    for (entityIndex = 0; entityIndex < numEntities; entityIndex++)
+    {
+        Entity* entity = entityManager->GetEntityAt(entityIndex);
+        if (entity && (entity->GetEntityPool() == Entity::LivePool))
+        {
+            bool hasAllAttributes = true;
+            int i;
+            for (i = 0; i < attributes.Size(); i++)
+            {
+                if (!entity->HasAttr(attributes[i].GetAttributeID())
+                    || (entity->GetAttr(attributes[i].GetAttributeID()) != attributes[i]))
+                {
+                    hasAllAttributes = false;
+                    break;
+                }
+            }
+            if (hasAllAttributes)
+            {
+                result.Append(entity);
+                if (onlyFirstEntity)
+                {
+                    return result;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compare the live entities found by the entity manager with a scan of
+    the attached entities. The order may differ. Returns the number of
+    differences.
+*/
+static int
+CheckLookup(const nArray<Db::Attribute>& attributes)
+{
+    nArray<Ptr<Entity> > found = EntityManager::Instance()->GetEntitiesByAttrs(attributes, true);
+    nArray<Entity*> scanned = ScanEntities(attributes, false);
+    int numWrong = 0;
+    if (found.Size() != scanned.Size())
+    {
+        numWrong++;
+    }
+    int i;
+    for (i = 0; i < found.Size(); i++)
+    {
+        if ((0 == scanned.Find(found[i].get())) || (found.Find(found[i]) != &found[i]))
+        {
+            numWrong++;
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compare the lookup of a single attribute.
+*/
+static int
+CheckLookup(const Attr::StringAttributeID& attrId, const nString& value)
+{
+    nArray<Db::Attribute> attributes;
+    attributes.Append(Db::Attribute(attrId, value));
+    return CheckLookup(attributes);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the names of the indexes on the _Entities table.
+*/
+static nArray<nString>
+GetEntityIndexes()
+{
+    nArray<nString> indexes;
+    nSqlDatabase* db = Db::Server::Instance()->GetSqlDatabase();
+    nSqlQuery* query = db->CreateQuery("SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='_Entities'");
+    if (query->Execute(false))
+    {
+        int i;
+        for (i = 0; i < query->GetNumRows(); i++)
+        {
+            indexes.Append(query->GetRow(i).Get("name"));
+        }
+    }
+    query->Release();
+    return indexes;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create a world database with some entities which aren't attached.
+*/
+static void
+CreateWorldDatabase(const nString& filename)
+{
+    nFileServer2::Instance()->DeleteFile(filename);
+    nSqlDatabase* db = nSqlServer::Instance()->NewDatabase(filename);
+    n_assert(db);
+    const char* statements[] =
+    {
+        "CREATE TABLE _Entities ( _Type TEXT, _Category TEXT, GUID TEXT, Name TEXT )",
+        "INSERT INTO _Entities VALUES ( 'INSTANCE', 'DbCategory', 'db-guid-0', 'DbName0' )",
+        "INSERT INTO _Entities VALUES ( 'INSTANCE', 'DbCategory', 'db-guid-1', 'DbName1' )",
+        0
+    };
+    int i;
+    for (i = 0; statements[i]; i++)
+    {
+        nSqlQuery* query = db->CreateQuery(statements[i]);
+        query->Execute();
+        query->Release();
+    }
+    db->Release();
+}
+
+//------------------------------------------------------------------------------
+/**
+    The database gets indexes on GUID and Name when it is opened, and on
+    the columns of attributes which are indexed later.
+*/
+static void
+TestDatabaseIndexes()
+{
+    nArray<nString> indexes = GetEntityIndexes();
+    n_test(2 == indexes.Size());
+    n_test(0 != indexes.Find("_Entities_GUID_Index"));
+    n_test(0 != indexes.Find("_Entities_Name_Index"));
+
+    EntityManager::Instance()->AddAttrIndex(Attr::_Category);
+    n_test(EntityManager::Instance()->HasAttrIndex(Attr::_Category));
+    indexes = GetEntityIndexes();
+    n_test(3 == indexes.Size());
+    n_test(0 != indexes.Find("_Entities__Category_Index"));
+
+    // opening the database again doesn't create them again
+    Db::Server::Instance()->Close();
+    Db::Server::Instance()->Open();
+    n_test(3 == GetEntityIndexes().Size());
+
+    // entities which aren't attached are found in the database
+    n_test(EntityManager::Instance()->ExistsEntityByGuid("db-guid-1"));
+    n_test(EntityManager::Instance()->ExistsEntityByName("DbName0"));
+    n_test(!EntityManager::Instance()->ExistsEntityByGuid("no-guid"));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Attach, remove and rename entities, and compare the lookups with a
+    scan of the attached entities.
+*/
+static void
+TestLookups()
+{
+    EntityManager* entityManager = EntityManager::Instance();
+    const int numEntities = 300;
+    nArray<Ptr<Entity> > entities;
+    nArray<bool> attached;
+    nString guid;
+    nString name;
+    nString category;
+    int i;
+    for (i = 0; i < numEntities; i++)
+    {
+        guid.Format("guid-%d", i);
+        name.Format("Name%d", i % 40);
+        category.Format("Category%d", i % 10);
+        entities.Append(CreateEntity(guid, name, category));
+        attached.Append(false);
+    }
+
+    // an attached entity is found at once, and not after it is removed
+    entityManager->AttachEntity(entities[0]);
+    attached[0] = true;
+    n_test(entityManager->GetEntityByGuid("guid-0", true) == entities[0]);
+    n_test(entityManager->ExistsEntityByGuid("guid-0", true));
+    n_test(!entityManager->GetEntityByGuid("guid-1", true).isvalid());
+    entityManager->RemoveEntity(entities[0]);
+    attached[0] = false;
+    n_test(!entityManager->GetEntityByGuid("guid-0", true).isvalid());
+
+    // an entity without a name gets into the index when it is named
+    Ptr<Entity> unnamed = Entity::Create();
+    unnamed->SetString(Attr::GUID, "guid-unnamed");
+    entityManager->AttachEntity(unnamed);
+    n_test(!entityManager->GetEntityByName("Unnamed", true).isvalid());
+    unnamed->SetString(Attr::Name, "Unnamed");
+    n_test(entityManager->GetEntityByName("Unnamed", true) == unnamed);
+    unnamed->SetAttr(Db::Attribute(Attr::Name, nString("Renamed")));
+    n_test(!entityManager->GetEntityByName("Unnamed", true).isvalid());
+    n_test(entityManager->GetEntityByName("Renamed", true) == unnamed);
+    entityManager->RemoveEntity(unnamed);
+    unnamed->SetString(Attr::Name, "RenamedWhileRemoved");
+    n_test(!entityManager->GetEntityByName("RenamedWhileRemoved", true).isvalid());
+    entityManager->AttachEntity(unnamed);
+    n_test(entityManager->GetEntityByName("RenamedWhileRemoved", true) == unnamed);
+    entityManager->RemoveEntity(unnamed);
+
+    // random attach, remove and rename operations
+    srand(1);
+    int numWrong = 0;
+    for (i = 0; i < 5000; i++)
+    {
+        int entityIndex = rand() % numEntities;
+        Entity* entity = entities[entityIndex];
+        int op = rand() % 5;
+        if (0 == op)
+        {
+            if (attached[entityIndex])
+            {
+                entityManager->RemoveEntity(entity);
+            }
+            else
+            {
+                entityManager->AttachEntity(entity);
+            }
+            attached[entityIndex] = !attached[entityIndex];
+        }
+        else if (1 == op)
+        {
+            name.Format("Name%d", rand() % 40);
+            entity->SetString(Attr::Name, name);
+        }
+        else if (2 == op)
+        {
+            category.Format("Category%d", rand() % 10);
+            entity->SetAttr(Db::Attribute(Attr::_Category, category));
+        }
+        else if (3 == op)
+        {
+            guid.Format("guid-%d-%d", entityIndex, i);
+            entity->SetString(Attr::GUID, guid);
+        }
+        name.Format("Name%d", rand() % 40);
+        numWrong += CheckLookup(Attr::Name, name);
+        numWrong += CheckLookup(Attr::GUID, entity->GetString(Attr::GUID));
+    }
+    n_test(0 == numWrong);
+
+    // all values, and lookups by several attributes
+    numWrong = 0;
+    for (i = 0; i < 40; i++)
+    {
+        name.Format("Name%d", i);
+        category.Format("Category%d", i % 10);
+        numWrong += CheckLookup(Attr::Name, name);
+        numWrong += CheckLookup(Attr::_Category, category);
+
+        nArray<Db::Attribute> attributes;
+        attributes.Append(Db::Attribute(Attr::_Category, category));
+        attributes.Append(Db::Attribute(Attr::Name, name));
+        numWrong += CheckLookup(attributes);
+        bool exists = (ScanEntities(attributes, true).Size() > 0);
+        if (exists && !entityManager->ExistsEntitiesByAttrs(attributes, true))
+        {
+            numWrong++;
+        }
+    }
+    for (i = 0; i < numEntities; i++)
+    {
+        numWrong += CheckLookup(Attr::GUID, entities[i]->GetString(Attr::GUID));
+    }
+    n_test(0 == numWrong);
+
+    // entities are attached, removed and renamed inside the frame
+    Ptr<FrameEntity> frameEntity = n_new(FrameEntity);
+    frameEntity->SetString(Attr::GUID, "guid-frame");
+    entityManager->AttachEntity(frameEntity);
+    for (i = 0; i < numEntities; i++)
+    {
+        if (!attached[i])
+        {
+            break;
+        }
+    }
+    n_assert(i < numEntities);
+    Ptr<Entity> attachEntity = entities[i];
+    attachEntity->SetString(Attr::Name, "AttachedInFrame");
+    attached[i] = true;
+    for (i = 0; i < numEntities; i++)
+    {
+        if (attached[i] && (entities[i] != attachEntity))
+        {
+            break;
+        }
+    }
+    n_assert(i < numEntities);
+    Ptr<Entity> removeEntity = entities[i];
+    removeEntity->SetString(Attr::Name, "RemovedInFrame");
+    attached[i] = false;
+    frameEntity->attachEntity = attachEntity;
+    frameEntity->removeEntity = removeEntity;
+    frameEntity->renameEntity = frameEntity;
+    frameEntity->newName = "RenamedInFrame";
+    frameEntity->foundAttached = true;
+    frameEntity->foundRemoved = true;
+    frameEntity->foundRenamed = false;
+    entityManager->OnFrame();
+    n_test(!frameEntity->foundAttached);
+    n_test(!frameEntity->foundRemoved);
+    n_test(frameEntity->foundRenamed);
+    n_test(entityManager->GetEntityByName("AttachedInFrame", true) == attachEntity);
+    n_test(!entityManager->GetEntityByName("RemovedInFrame", true).isvalid());
+    n_test(entityManager->GetEntityByName("RenamedInFrame", true).get() == frameEntity.get());
+    entityManager->RemoveEntity(frameEntity);
+
+    // loading attributes from the database changes the name
+    Ptr<Entity> dbEntity = CreateEntity("db-guid-0", "Stale", "DbCategory");
+    entityManager->AttachEntity(dbEntity);
+    n_test(entityManager->GetEntityByName("Stale", true) == dbEntity);
+    dbEntity->LoadAttributesFromDatabase();
+    n_test(dbEntity->GetString(Attr::Name) == "DbName0");
+    n_test(!entityManager->GetEntityByName("Stale", true).isvalid());
+    n_test(entityManager->GetEntityByName("DbName0", true) == dbEntity);
+    n_test(entityManager->GetEntityByGuid("db-guid-0", true) == dbEntity);
+    entityManager->RemoveEntity(dbEntity);
+
+    entityManager->RemoveAllEntities();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numEntities = n_max(1, args.GetIntArg("-entities", 20000));
+    int numLookups = n_max(1, args.GetIntArg("-lookups", 1000));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 100));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.New("nresourceserver", "/sys/servers/resource");
+    kernelServer.New("nsqlite3server", "/sys/servers/sql");
+    nString filename = dir + "/entitymanagertest.db3";
+    CreateWorldDatabase(filename);
+
+    Ptr<Message::Server> msgServer = Message::Server::Create();
+    msgServer->Open();
+    Ptr<Db::Server> dbServer = Db::Server::Create();
+    dbServer->SetDatabaseFilename(filename);
+    dbServer->Open();
+    Ptr<Game::Server> gameServer = Game::Server::Create();
+    gameServer->Open();
+    Ptr<Physics::Server> physicsServer = n_new(TestPhysicsServer);
+    physicsServer->Open();
+    Ptr<EntityManager> entityManager = EntityManager::Create();
+
+    TestDatabaseIndexes();
+    TestLookups();
+
+    // the benchmark entities, and the GUIDs to look up
+    nString guid;
+    nString name;
+    nString category;
+    int i;
+    for (i = 0; i < numEntities; i++)
+    {
+        guid.Format("%08x-4a1b-11db-8f3c-%012d", i * 2654435761u, i);
+        name.Format("Entity%d", i);
+        category.Format("Category%d", i % 40);
+        entityManager->AttachEntity(CreateEntity(guid, name, category));
+    }
+    nArray<nString> guids;
+    for (i = 0; i < numLookups; i++)
+    {
+        if (9 == (i % 10))
+        {
+            guid.Format("ffffffff-0000-0000-0000-%012d", i);
+        }
+        else
+        {
+            guid = entityManager->GetEntityAt((i * 7919) % numEntities)->GetString(Attr::GUID);
+        }
+        guids.Append(guid);
+    }
+
+    // scanning all entities, this takes long, so only 2 frames are measured
+    const int numScanFrames = 2;
+    int numScanned = 0;
+    nTest::Timer timer;
+    int frame;
+    for (frame = 0; frame < numScanFrames; frame++)
+    {
+        for (i = 0; i < numLookups; i++)
+        {
+            nArray<Db::Attribute> attributes;
+            attributes.Append(Db::Attribute(Attr::GUID, guids[i]));
+            numScanned += ScanEntities(attributes, true).Size();
+        }
+    }
+    double scanTime = timer.GetTime() / numScanFrames;
+
+    // the entity manager
+    int numFound = 0;
+    timer.Start();
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        for (i = 0; i < numLookups; i++)
+        {
+            if (entityManager->GetEntityByGuid(guids[i], true).isvalid())
+            {
+                numFound++;
+            }
+        }
+    }
+    double lookupTime = timer.GetTime() / numFrames;
+    n_test((numScanned / numScanFrames) == (numFound / numFrames));
+    n_test((numFound / numFrames) == (numLookups - numLookups / 10));
+
+    // renaming moves the entities in the name index
+    timer.Start();
+    for (i = 0; i < numEntities; i++)
+    {
+        name.Format("Renamed%d", i);
+        entityManager->GetEntityAt(i)->SetString(Attr::Name, name);
+    }
+    double renameTime = timer.GetTime();
+    n_test(entityManager->GetEntityByName("Renamed0", true).isvalid());
+    n_test(!entityManager->GetEntityByName("Entity0", true).isvalid());
+
+    printf("%d entities, %d GUID lookups per frame:\n", numEntities, numLookups);
+    printf("scan: %.2f ms/frame\n", scanTime * 1000.0);
+    printf("index: %.3f ms/frame\n", lookupTime * 1000.0);
+    printf("renaming all entities: %.2f ms\n", renameTime * 1000.0);
+
+    entityManager->RemoveAllEntities();
+    entityManager = 0;
+    physicsServer->Close();
+    physicsServer = 0;
+    gameServer->Close();
+    gameServer = 0;
+    dbServer->Close();
+    dbServer = 0;
+    msgServer->Close();
+    msgServer = 0;
+    nFileServer2::Instance()->DeleteFile(filename);
+    return nTest::Finish("entitymanagertest");
+}
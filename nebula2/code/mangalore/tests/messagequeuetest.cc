@@ -0,0 +1,643 @@
+//------------------------------------------------------------------------------
+//  tests/messagequeuetest.cc
+//
+//  Tests and benchmarks the message pools and the frame wide async
+//  message queue of Message::Server. The tests check that message
+//  objects are recycled by their class' pool, that async messages are
+//  delivered in one batch in the order they were sent to a port, that
+//  Accepts() is asked at delivery time, and that queued messages keep
+//  their ports alive and are released when the server is closed.
+//
+//  The benchmark is a message storm: entities with 10 ports each, of
+//  which 2 accept the messages, get 3 async messages per frame, sent in
+//  scattered entity order, and handle their pending messages once per
+//  frame. It compares the old path, heap allocated messages which are
+//  put on the port queues right away, with pooled messages and the
+//  frame wide queue.
+//
+//  Command line args:
+//  -entities   number of entities (default: 10000)
+//  -frames     number of measured frames (default: 60)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "message/dispatcher.h"
+#include "message/server.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+//------------------------------------------------------------------------------
+/**
+    Implements a message id like ImplementMsgId, but allocates the
+    messages from the heap, like all messages were allocated before
+    message classes had a pool.
+*/
+#if defined(_DEBUG) && defined(__WIN32__)
+#define ImplementHeapMsgDebugNew(type) \
+    void* type::operator new(size_t size, const char* file, int line) { return n_malloc(size); } \
+    void type::operator delete(void* p, const char* file, int line) { n_free(p); }
+#else
+#define ImplementHeapMsgDebugNew(type)
+#endif
+
+#define ImplementHeapMsgId(type) \
+    Message::Id type::Id; \
+    Message::Pool type::Pool(#type, sizeof(type)); \
+    const Message::Id& type::GetId() const { return type::Id; } \
+    Message::Pool& type::GetPool() const { return type::Pool; } \
+    void* type::operator new(size_t size) { return n_malloc(size); } \
+    void type::operator delete(void* p, size_t size) { n_free(p); } \
+    ImplementHeapMsgDebugNew(type)
+
+//------------------------------------------------------------------------------
+/**
+    The storm messages, like an UpdateTransform and a message with a
+    string. The Heap variants are the same messages without a pool.
+*/
+#define StormMsgA(type) \
+class type : public Message::Msg \
+{ \
+    DeclareRtti; \
+    DeclareFactory(type); \
+    DeclareMsgId; \
+public: \
+    int seq; \
+    float values[16]; \
+}; \
+RegisterFactory(type); \
+ImplementRtti(type, Message::Msg); \
+ImplementFactory(type);
+
+#define StormMsgB(type) \
+class type : public Message::Msg \
+{ \
+    DeclareRtti; \
+    DeclareFactory(type); \
+    DeclareMsgId; \
+public: \
+    int seq; \
+    nString str; \
+}; \
+RegisterFactory(type); \
+ImplementRtti(type, Message::Msg); \
+ImplementFactory(type);
+
+StormMsgA(PooledMsgA);
+ImplementMsgId(PooledMsgA);
+StormMsgB(PooledMsgB);
+ImplementMsgId(PooledMsgB);
+StormMsgA(HeapMsgA);
+ImplementHeapMsgId(HeapMsgA);
+StormMsgB(HeapMsgB);
+ImplementHeapMsgId(HeapMsgB);
+
+//------------------------------------------------------------------------------
+/**
+    A subclass without its own message id, which is allocated from the
+    heap by its parent's pool.
+*/
+class DerivedMsgA : public PooledMsgA
+{
+public:
+    int extra;
+};
+
+//------------------------------------------------------------------------------
+/**
+    A port which accepts the storm messages and records the sequence
+    numbers of the handled messages. It may send an async message from
+    its handler.
+*/
+class StormPort : public Message::Port
+{
+    DeclareRtti;
+public:
+    /// constructor
+    StormPort();
+    /// destructor
+    virtual ~StormPort();
+    /// enable or disable the port, Accepts() rejects every message when disabled
+    void SetEnabled(bool b);
+    /// send an async message to a port on the next handled message
+    void SetSendOnHandle(Message::Port* port, Message::Msg* msg);
+    /// return true if the port accepts a message
+    virtual bool Accepts(Message::Msg* msg);
+    /// handle a message
+    virtual void HandleMessage(Message::Msg* msg);
+    /// get number of handled messages
+    int GetNumHandled() const;
+    /// get the handled sequence numbers
+    const nArray<int>& GetHandledSeqs() const;
+    /// record the handled sequence numbers
+    void SetRecordSeqs(bool b);
+
+    /// number of destroyed ports
+    static int NumDestroyed;
+
+protected:
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
+
+private:
+    bool enabled;
+    bool recordSeqs;
+    int numHandled;
+    nArray<int> handledSeqs;
+    Ptr<Message::Port> sendPort;
+    Ptr<Message::Msg> sendMsg;
+};
+ImplementRtti(StormPort, Message::Port);
+int StormPort::NumDestroyed = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+StormPort::StormPort() :
+    enabled(true),
+    recordSeqs(false),
+    numHandled(0)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+StormPort::~StormPort()
+{
+    NumDestroyed++;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+StormPort::SetEnabled(bool b)
+{
+    this->enabled = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+StormPort::SetRecordSeqs(bool b)
+{
+    this->recordSeqs = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+StormPort::SetSendOnHandle(Message::Port* port, Message::Msg* msg)
+{
+    this->sendPort = port;
+    this->sendMsg = msg;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+StormPort::SetupAcceptedMessages()
+{
+    this->RegisterMessage(PooledMsgA::Id);
+    this->RegisterMessage(PooledMsgB::Id);
+    this->RegisterMessage(HeapMsgA::Id);
+    this->RegisterMessage(HeapMsgB::Id);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+StormPort::Accepts(Message::Msg* msg)
+{
+    if (!this->enabled)
+    {
+        return false;
+    }
+    return msg->CheckId(PooledMsgA::Id) || msg->CheckId(PooledMsgB::Id) ||
+           msg->CheckId(HeapMsgA::Id) || msg->CheckId(HeapMsgB::Id);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+StormPort::HandleMessage(Message::Msg* msg)
+{
+    this->numHandled++;
+    if (this->recordSeqs)
+    {
+        if (msg->CheckId(PooledMsgA::Id))
+        {
+            this->handledSeqs.Append(((PooledMsgA*) msg)->seq);
+        }
+        else if (msg->CheckId(PooledMsgB::Id))
+        {
+            this->handledSeqs.Append(((PooledMsgB*) msg)->seq);
+        }
+    }
+    if (this->sendMsg.isvalid())
+    {
+        Ptr<Message::Msg> sendMsg = this->sendMsg;
+        this->sendMsg = 0;
+        sendMsg->SendAsync(this->sendPort);
+        this->sendPort = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+StormPort::GetNumHandled() const
+{
+    return this->numHandled;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const nArray<int>&
+StormPort::GetHandledSeqs() const
+{
+    return this->handledSeqs;
+}
+
+//------------------------------------------------------------------------------
+/**
+    A port which doesn't accept the storm messages, like most properties
+    of an entity.
+*/
+class OtherPort : public Message::Port
+{
+    DeclareRtti;
+public:
+    /// return true if the port accepts a message
+    virtual bool Accepts(Message::Msg* msg);
+
+protected:
+    /// declare the accepted message ids
+    virtual void SetupAcceptedMessages();
+};
+ImplementRtti(OtherPort, Message::Port);
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+OtherPort::Accepts(Message::Msg* msg)
+{
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+OtherPort::SetupAcceptedMessages()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+    Messages are recycled by their pool.
+*/
+static void
+TestPool()
+{
+    Message::Pool& pool = PooledMsgA::Pool;
+    int numAlive = pool.GetNumAlive();
+    nArray<Ptr<PooledMsgA> > msgs;
+    int i;
+    for (i = 0; i < 100; i++)
+    {
+        msgs.Append(PooledMsgA::Create());
+        msgs.Back()->seq = i;
+    }
+    n_test((numAlive + 100) == pool.GetNumAlive());
+    int numChunks = pool.GetNumChunks();
+    n_test(numChunks >= 4);
+
+    // all objects are distinct and don't overlap
+    int numWrong = 0;
+    for (i = 0; i < 100; i++)
+    {
+        if (msgs[i]->seq != i)
+        {
+            numWrong++;
+        }
+        int j;
+        for (j = i + 1; j < 100; j++)
+        {
+            size_t dist = (msgs[i].get() < msgs[j].get()) ? ((char*) msgs[j].get() - (char*) msgs[i].get()) : ((char*) msgs[i].get() - (char*) msgs[j].get());
+            if (dist < sizeof(PooledMsgA))
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+
+    // released objects are reused without new chunks
+    msgs.Clear();
+    n_test(numAlive == pool.GetNumAlive());
+    for (i = 0; i < 100; i++)
+    {
+        msgs.Append(PooledMsgA::Create());
+    }
+    msgs.Clear();
+    n_test(numChunks == pool.GetNumChunks());
+
+    // a subclass of another size comes from the heap
+    Ptr<DerivedMsgA> derived = n_new(DerivedMsgA);
+    derived->extra = 1;
+    n_test(numAlive == pool.GetNumAlive());
+    derived = 0;
+    n_test(numAlive == pool.GetNumAlive());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create a pooled storm message with a sequence number.
+*/
+static Message::Msg*
+CreateSeqMsg(int seq)
+{
+    if (seq & 1)
+    {
+        PooledMsgB* msg = PooledMsgB::Create();
+        msg->seq = seq;
+        return msg;
+    }
+    PooledMsgA* msg = PooledMsgA::Create();
+    msg->seq = seq;
+    return msg;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Async messages are delivered in batches, in the order they were sent
+    to a port.
+*/
+static void
+TestAsync()
+{
+    Message::Server* server = Message::Server::Instance();
+    const int numEntities = 5;
+    nArray<Ptr<Message::Dispatcher> > entities;
+    nArray<Ptr<StormPort> > ports;
+    int i;
+    for (i = 0; i < numEntities; i++)
+    {
+        Ptr<Message::Dispatcher> dispatcher = Message::Dispatcher::Create();
+        StormPort* port = n_new(StormPort);
+        port->SetRecordSeqs(true);
+        dispatcher->AttachPort(port);
+        dispatcher->AttachPort(n_new(OtherPort));
+        entities.Append(dispatcher);
+        ports.Append(port);
+    }
+
+    // nothing is delivered before a port handles its messages, entity
+    // i gets the sequence numbers i, i + numEntities, ...
+    ports[3]->SetEnabled(false);
+    for (i = 0; i < numEntities * 20; i++)
+    {
+        Ptr<Message::Msg> msg = CreateSeqMsg(i);
+        msg->SendAsync(entities[i % numEntities]);
+    }
+    for (i = 0; i < numEntities; i++)
+    {
+        n_test(0 == ports[i]->GetNumHandled());
+    }
+
+    // Accepts() is asked at delivery
+    ports[3]->SetEnabled(true);
+    ports[4]->SetEnabled(false);
+
+    // the first port delivers all messages, the others only handle them
+    int numWrong = 0;
+    for (i = 0; i < numEntities; i++)
+    {
+        ports[i]->HandlePendingMessages();
+        const nArray<int>& seqs = ports[i]->GetHandledSeqs();
+        int num = (i == 4) ? 0 : 20;
+        if (seqs.Size() != num)
+        {
+            numWrong++;
+        }
+        int j;
+        for (j = 0; j < seqs.Size(); j++)
+        {
+            if (seqs[j] != (i + j * numEntities))
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+    ports[4]->SetEnabled(true);
+
+    // a message sent from a handler is delivered with the next batch
+    Ptr<Message::Msg> msg = CreateSeqMsg(2000);
+    msg->SendAsync(entities[0]);
+    ports[1]->HandlePendingMessages();
+    ports[0]->SetSendOnHandle(entities[1], CreateSeqMsg(1000));
+    ports[0]->HandlePendingMessages();
+    n_test(ports[0]->GetHandledSeqs().Back() == 2000);
+    n_test(20 == ports[1]->GetNumHandled());
+    server->OnFrame();
+    ports[1]->HandlePendingMessages();
+    n_test(21 == ports[1]->GetNumHandled());
+    n_test(ports[1]->GetHandledSeqs().Back() == 1000);
+
+    // the queue keeps a port alive until its messages are delivered
+    int numDestroyed = StormPort::NumDestroyed;
+    Ptr<StormPort> lonePort = n_new(StormPort);
+    msg->SendAsync(lonePort);
+    msg->SendAsync(lonePort);
+    n_test(2 == lonePort->GetRefCount());
+    lonePort = 0;
+    n_test(numDestroyed == StormPort::NumDestroyed);
+    server->OnFrame();
+    n_test((numDestroyed + 1) == StormPort::NumDestroyed);
+
+    // broadcast
+    server->RegisterPort(ports[0]);
+    server->RegisterPort(ports[2]);
+    msg->BroadcastAsync();
+    server->OnFrame();
+    ports[0]->HandlePendingMessages();
+    ports[2]->HandlePendingMessages();
+    n_test(ports[0]->GetHandledSeqs().Back() == 2000);
+    n_test(ports[2]->GetHandledSeqs().Back() == 2000);
+    n_test(22 == ports[0]->GetNumHandled());
+    n_test(21 == ports[2]->GetNumHandled());
+    server->UnregisterPort(ports[0]);
+    server->UnregisterPort(ports[2]);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Send the storm messages of one frame, to the entities in scattered
+    order. The old path puts them on the port queues right away.
+*/
+template<class MSGA, class MSGB> void
+SendStorm(nArray<Ptr<Message::Dispatcher> >& entities, int frame, bool queued)
+{
+    int numEntities = entities.Size();
+    int k;
+    for (k = 0; k < 3; k++)
+    {
+        int e;
+        for (e = 0; e < numEntities; e++)
+        {
+            int index = int((e * 7919LL + k * 104729LL) % numEntities);
+            Ptr<Message::Msg> msg;
+            if (1 == k)
+            {
+                MSGB* msgB = MSGB::Create();
+                msgB->seq = frame;
+                msgB->str = "hello";
+                msg = msgB;
+            }
+            else
+            {
+                MSGA* msgA = MSGA::Create();
+                msgA->seq = frame;
+                msgA->values[0] = float(frame);
+                msg = msgA;
+            }
+            if (queued)
+            {
+                msg->SendAsync(entities[index]);
+            }
+            else
+            {
+                entities[index]->Put(msg);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numEntities = n_max(1, args.GetIntArg("-entities", 10000));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 60));
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    Ptr<Message::Server> msgServer = Message::Server::Create();
+    msgServer->Open();
+
+    TestPool();
+    TestAsync();
+
+    // the storm, 2 of the 10 ports of every entity accept the messages
+    nArray<Ptr<Message::Dispatcher> > entities;
+    nArray<Ptr<StormPort> > ports;
+    int e;
+    for (e = 0; e < numEntities; e++)
+    {
+        Ptr<Message::Dispatcher> dispatcher = Message::Dispatcher::Create();
+        int p;
+        for (p = 0; p < 10; p++)
+        {
+            if (p < 2)
+            {
+                StormPort* port = n_new(StormPort);
+                ports.Append(port);
+                dispatcher->AttachPort(port);
+            }
+            else
+            {
+                dispatcher->AttachPort(n_new(OtherPort));
+            }
+        }
+        entities.Append(dispatcher);
+    }
+
+    double times[2];
+    int numHandled[2];
+    int mode;
+    for (mode = 0; mode < 2; mode++)
+    {
+        // the first frame fills the pools and the queues and isn't measured
+        times[mode] = 0.0;
+        int frame;
+        for (frame = 0; frame <= numFrames; frame++)
+        {
+            nTest::Timer timer;
+            if (0 == mode)
+            {
+                SendStorm<HeapMsgA, HeapMsgB>(entities, frame, false);
+            }
+            else
+            {
+                SendStorm<PooledMsgA, PooledMsgB>(entities, frame, true);
+            }
+            int i;
+            for (i = 0; i < ports.Size(); i++)
+            {
+                ports[i]->HandlePendingMessages();
+            }
+            if (1 == mode)
+            {
+                msgServer->OnFrame();
+            }
+            if (frame > 0)
+            {
+                times[mode] += timer.GetTime();
+            }
+        }
+        numHandled[mode] = 0;
+        int i;
+        for (i = 0; i < ports.Size(); i++)
+        {
+            numHandled[mode] += ports[i]->GetNumHandled();
+        }
+    }
+    int numExpected = (numFrames + 1) * numEntities * 3 * 2;
+    n_test(numExpected == numHandled[0]);
+    n_test((2 * numExpected) == numHandled[1]);
+
+    // all storm messages have been released to their pools
+    n_test(0 == PooledMsgA::Pool.GetNumAlive());
+    n_test(0 == PooledMsgB::Pool.GetNumAlive());
+
+    printf("%d entities, 3 async messages per entity:\n", numEntities);
+    printf("heap messages, port queues: %.2f ms/frame\n", times[0] * 1000.0 / numFrames);
+    printf("pooled messages, frame queue: %.2f ms/frame, %d pool chunks\n",
+        times[1] * 1000.0 / numFrames, PooledMsgA::Pool.GetNumChunks() + PooledMsgB::Pool.GetNumChunks());
+
+    // closing the server releases queued messages
+    Ptr<Message::Msg> msg = CreateSeqMsg(0);
+    msg->SendAsync(entities[0]);
+    int numDestroyed = StormPort::NumDestroyed;
+    Ptr<StormPort> lonePort = n_new(StormPort);
+    msg->SendAsync(lonePort);
+    msg->SendAsync(lonePort);
+    lonePort = 0;
+    msg = 0;
+    n_test(1 == PooledMsgA::Pool.GetNumAlive());
+    msgServer->Close();
+    n_test(0 == PooledMsgA::Pool.GetNumAlive());
+    n_test((numDestroyed + 1) == StormPort::NumDestroyed);
+
+    entities.Clear();
+    ports.Clear();
+    return nTest::Finish("messagequeuetest");
+}
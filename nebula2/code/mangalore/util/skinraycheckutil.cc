@@ -9,6 +9,7 @@
 #include "managers/timemanager.h"
 #include "kernel/nfileserver2.h"
 #include "game/time/systemtimesource.h"
+#include "deformers/nskinmeshdeformer.h"
 
 namespace Util
 {
@@ -352,10 +353,9 @@ SkinRayCheckUtil::InitSkinnedMesh()
 /**
     This method performs the actual skinning on the cpu and writes the
     skinned vertices into the refSkinnedMesh. A valid and uptodate character
-    skeleton must be set through
-
-    FIXME: performance optimization: convert float joint indices to integer
-    during load time?
+    skeleton must be set through SetCharSkeleton(). The positions are
+    skinned by nSkinMeshDeformer's skinning kernel, with the skin matrices
+    of each fragment's joint palette.
 */
 void
 SkinRayCheckUtil::UpdateSkinning()
@@ -369,6 +369,9 @@ SkinRayCheckUtil::UpdateSkinning()
     float* dstVertexBase = dstMesh->LockVertices();
     int numFrags = this->skinShapeNode->GetNumFragments();
     int numGroups = srcMesh->GetNumGroups();
+    int srcWidth = srcMesh->GetVertexWidth();
+    int weightOffset = srcMesh->GetVertexComponentOffset(nMesh2::Weights);
+    int jindexOffset = srcMesh->GetVertexComponentOffset(nMesh2::JIndices);
 
     n_assert(numFrags <= numGroups);
 
@@ -381,44 +384,37 @@ SkinRayCheckUtil::UpdateSkinning()
         const nMeshGroup& srcGroup = srcMesh->Group(groupIndex);
         const nMeshGroup& dstGroup = dstMesh->Group(groupIndex);
 
-
-
-
         int numSrcVertices = srcGroup.GetNumVertices();
         int numDstVertices = dstGroup.GetNumVertices();
         n_assert(numSrcVertices == numDstVertices);
 
+        // the joint indices of the vertices index the fragment's joint palette
+        if (this->skinMatrices.Size() < paletteSize)
+        {
+            this->skinMatrices.SetFixedSize(paletteSize);
+        }
+        int paletteIndex;
+        for (paletteIndex = 0; paletteIndex < paletteSize; paletteIndex++)
+        {
+            int jointIndex = this->skinShapeNode->GetJointIndex(curFrag, paletteIndex);
+            this->skinMatrices[paletteIndex] = this->charSkeleton->GetJointAt(jointIndex).GetSkinMatrix44();
+        }
+
         float* srcVertices = srcVertexBase + srcGroup.GetFirstVertex();
         float* dstVertices = dstVertexBase + dstGroup.GetFirstVertex();
-        vector3 v;
+        if (paletteSize > 0)
+        {
+            nSkinMeshDeformer::SkinPositions(&(this->skinMatrices[0]), srcVertices, srcWidth, weightOffset, jindexOffset, dstVertices, 4, numSrcVertices);
+        }
+
+        // note, we are filling a dynamic vertex buffer which will be discarded
+        // after rendering, so we NEED to write seemingly constant data (the
+        // extrude weights) as well!
         int index;
         for (index = 0; index < numSrcVertices; index++)
         {
-            // perform weighted skinning
-            const vector3& srcVec = *((vector3*)srcVertices);
-            float* weights = &srcVertices[srcMesh->GetVertexComponentOffset(nMesh2::Weights)];
-            float* indices = &srcVertices[srcMesh->GetVertexComponentOffset(nMesh2::JIndices)];
-            v.set(0.0f, 0.0f, 0.0f);
-            for (int i = 0; i < 4; i++)
-            {
-                if (weights[i] > 0.0f)
-                {
-                    const matrix44& skinMatrix = this->charSkeleton->GetJointAt(this->skinShapeNode->GetJointIndex(curFrag, int(indices[i]))).GetSkinMatrix44();
-                    //const matrix44& skinMatrix = this->charSkeleton->GetJointAt(int(indices[i])).GetSkinMatrix44();
-                    skinMatrix.weighted_madd(srcVec, v, weights[i]);
-                }
-            }
-
-            int x = this->charSkeleton->GetNumJoints();
-            int y = srcMesh->GetNumGroups();
-
-            // write skinned vertex to vertex position, note, we are filling
-            // a dynamic vertex buffer which will be discarded after rendering, so we NEED to write
-            // seemingly constant data (the extrude weights) as well!
-            *dstVertices++ = v.x; *dstVertices++ = v.y; *dstVertices++ = v.z; *dstVertices++ = 1.0f;
-
-            // set to next source vertex
-            srcVertices += srcMesh->GetVertexWidth();
+            dstVertices[3] = 1.0f;
+            dstVertices += 4;
         }
     }
     dstMesh->UnlockVertices();
@@ -187,6 +187,7 @@ private:
     nRef<nMeshCopyResourceLoader> refResistentMeshResourceLoader;
     nRef<nMesh2> refSkinnedMesh;        // the skinned mesh, written to analyse
     nRef<nMeshCopyResourceLoader> refSkinnedMeshResourceLoader;
+    nArray<matrix44> skinMatrices;      // skin matrices of the current fragment's joint palette
 
     // for mesh-cleaning
     nMeshBuilder backupMesh;
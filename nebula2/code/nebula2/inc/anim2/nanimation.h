@@ -26,6 +26,8 @@
     normal nResource class behavior.
 
     To get a sample from a curve, call the SampleCurves() method.
+    SampleCurves() doesn't modify the animation object, so one animation
+    may be sampled from several threads at the same time.
 
     Animation file formats:
 
@@ -193,6 +195,8 @@ public:
         LoopType GetLoopType() const;
         /// convert string to loop type
         static LoopType StringToLoopType(const char* str);
+        /// convert a time stamp into 2 frame indices and an inbetween value
+        void TimeToFrame(float time, int& keyIndex0, int& keyIndex1, float& inbetween) const;
         /// convert a time stamp into 2 global key indexes and an inbetween value
         void TimeToIndex(float time, int& keyIndex0, int& keyIndex1, float& inbetween) const;
         /// return true if time is between startTime and stopTime (handles looped and clamped case correctly)
@@ -214,8 +218,8 @@ public:
     nAnimation();
     /// destructor
     virtual ~nAnimation();
-    /// sample values from curve range
-    virtual void SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* keyArray);
+    /// sample values from curve range (thread safe)
+    virtual void SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* keyArray) const;
     /// get duration of entire animation
     nTime GetDuration(int groupIndex) const;
     /// set number of groups in animation
@@ -614,7 +618,7 @@ nAnimation::Group::IsInbetween(float time, float startTime, float stopTime) cons
 */
 inline
 void
-nAnimation::Group::TimeToIndex(float time, int& keyIndex0, int& keyIndex1, float& inbetween) const
+nAnimation::Group::TimeToFrame(float time, int& keyIndex0, int& keyIndex1, float& inbetween) const
 {
     float frame  = time / this->keyTime;
     int intFrame = int(frame);
@@ -645,7 +649,18 @@ nAnimation::Group::TimeToIndex(float time, int& keyIndex0, int& keyIndex1, float
     }
     n_assert((keyIndex0 >= 0) && (keyIndex0 < this->numKeys));
     n_assert((keyIndex1 >= 0) && (keyIndex1 < this->numKeys));
+}
 
+//------------------------------------------------------------------------------
+/**
+    Like TimeToFrame(), but the returned indices are multiplied with the
+    key stride, so they can be added to a curve's first key index.
+*/
+inline
+void
+nAnimation::Group::TimeToIndex(float time, int& keyIndex0, int& keyIndex1, float& inbetween) const
+{
+    this->TimeToFrame(time, keyIndex0, keyIndex1, inbetween);
     keyIndex0 *= this->keyStride;
     keyIndex1 *= this->keyStride;
 }
@@ -30,11 +30,16 @@ public:
     virtual nAnimation* NewMemoryAnimation(const nString& rsrcName);
     /// create a new streaming animation object (never shared)
     virtual nAnimation* NewStreamingAnimation();
+    /// enable/disable key compression of memory animations (affects animations loaded afterwards)
+    void SetPackKeys(bool b);
+    /// get key compression flag
+    bool GetPackKeys() const;
 
 private:
     static nAnimationServer* Singleton;
 
     nAutoRef<nResourceServer> refResourceServer;
+    bool packKeys;
 };
 
 //------------------------------------------------------------------------------
@@ -48,5 +53,25 @@ nAnimationServer::Instance()
     return Singleton;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nAnimationServer::SetPackKeys(bool b)
+{
+    this->packKeys = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nAnimationServer::GetPackKeys() const
+{
+    return this->packKeys;
+}
+
 //------------------------------------------------------------------------------
 #endif
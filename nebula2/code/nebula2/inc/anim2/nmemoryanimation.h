@@ -10,11 +10,17 @@
     can be shared between many client objects. The disadvantage is of
     course the memory footprint.
 
+    To reduce the footprint, the keys are compressed into one
+    nPackedAnimGroup per animation group after loading, unless key
+    packing has been disabled on the animation server. The raw key
+    array is released afterwards.
+
     See the parent class nAnimation for more info.
 
     (C) 2003 RadonLabs GmbH
 */
 #include "anim2/nanimation.h"
+#include "anim2/npackedanimgroup.h"
 
 //------------------------------------------------------------------------------
 class nMemoryAnimation : public nAnimation
@@ -24,12 +30,20 @@ public:
     nMemoryAnimation();
     /// destructor
     virtual ~nMemoryAnimation();
-    /// sample value of given curve at given time
-    virtual void SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* keyArray);
+    /// sample value of given curve at given time (thread safe)
+    virtual void SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* keyArray) const;
     /// get an estimated byte size of the resource data (for memory statistics)
     virtual int GetByteSize();
-    /// gets the keyArray
+    /// nax2 files can be loaded asynchronously
+    virtual bool CanLoadAsync() const;
+    /// gets the keyArray (empty once all groups have been packed)
     nArray<vector4>& GetKeyArray();
+    /// compress the keys of all groups which are not packed yet, releases the key array
+    void PackKeys();
+    /// return true if the keys of a group are packed
+    bool IsGroupPacked(int groupIndex) const;
+    /// get the packed keys of a group
+    const nPackedAnimGroup& GetPackedGroup(int groupIndex) const;
 
 protected:
     /// load the resource (sets the valid flag)
@@ -40,8 +54,11 @@ protected:
     bool LoadNanim2(const nString& filename);
     /// load curve group from binary nax2 file
     bool LoadNax2(const nString& filename);
+    /// compute the start values of all curves, call after the keys have been loaded
+    void UpdateStartValues();
 
     nArray<vector4> keyArray;
+    nArray<nPackedAnimGroup> packedGroups;
 };
 
 //------------------------------------------------------------------------------
@@ -54,5 +71,26 @@ nMemoryAnimation::GetKeyArray()
     return this->keyArray;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nMemoryAnimation::IsGroupPacked(int groupIndex) const
+{
+    return (groupIndex < this->packedGroups.Size()) && this->packedGroups[groupIndex].IsValid();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nPackedAnimGroup&
+nMemoryAnimation::GetPackedGroup(int groupIndex) const
+{
+    n_assert(this->IsGroupPacked(groupIndex));
+    return this->packedGroups[groupIndex];
+}
+
 //------------------------------------------------------------------------------
 #endif
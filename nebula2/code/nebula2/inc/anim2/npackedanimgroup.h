@@ -0,0 +1,170 @@
+#ifndef N_PACKEDANIMGROUP_H
+#define N_PACKEDANIMGROUP_H
+//------------------------------------------------------------------------------
+/**
+    @class nPackedAnimGroup
+    @ingroup Anim2
+
+    @brief Compressed in-memory keys of one animation group.
+
+    Every curve of the group is stored in one of the following formats:
+
+    - Constant: all keys are identical, no key data at all
+    - Quat48: smallest-three quantized quaternion, 15 bits for each of
+      the 3 smallest components, plus the index and sign of the
+      largest component (6 bytes per key)
+    - Range16: the 4 components are quantized to 16 bits inside the
+      value range of the curve (8 bytes per key)
+    - Raw: uncompressed vector4 (16 bytes per key), used for step curves
+
+    Quat curves use Quat48, linear curves Range16, step curves stay
+    uncompressed. The keys of all curves are interleaved by frame, like in
+    the uncompressed key array, so that sampling a range of curves at one
+    point in time touches only 2 contiguous blocks of memory.
+
+    A group is packed by calling Begin(), SetCurve() or SetConstCurve()
+    for every curve and End(). The key data handed to SetCurve() must stay
+    valid until End() has been called.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "util/narray.h"
+#include "mathlib/vector.h"
+#include "anim2/nanimation.h"
+
+// SSE curve sampling available?
+#if !defined(__NEBULA_NO_SSE__) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define __NEBULA_ANIM_SSE__ (1)
+#endif
+
+//------------------------------------------------------------------------------
+class nPackedAnimGroup
+{
+public:
+    /// key storage formats
+    enum Format
+    {
+        Constant = 0,
+        Quat48,
+        Range16,
+        Raw,
+    };
+
+    /// constructor
+    nPackedAnimGroup();
+    /// destructor
+    ~nPackedAnimGroup();
+    /// begin packing a group of curves
+    void Begin(int numCurves, int numKeys);
+    /// set an animated curve, keys points to the curve's first key, keyStride is in vector4 elements
+    void SetCurve(int curveIndex, nAnimation::Curve::IpolType ipolType, const vector4* keys, int keyStride);
+    /// set a collapsed curve
+    void SetConstCurve(int curveIndex, const vector4& value);
+    /// encode the keys of all curves
+    void End();
+    /// return true if the group has been packed
+    bool IsValid() const;
+    /// get number of curves
+    int GetNumCurves() const;
+    /// get number of keys per curve
+    int GetNumKeys() const;
+    /// get the storage format of a curve
+    Format GetFormat(int curveIndex) const;
+    /// get size of the packed data in bytes
+    int GetByteSize() const;
+    /// decode a single key of a curve
+    void GetKey(int curveIndex, int keyIndex, vector4& dst) const;
+    /// sample a range of curves between 2 keys
+    void Sample(int keyIndex0, int keyIndex1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const;
+
+private:
+    /// per curve packing info
+    struct CurveInfo
+    {
+        int format;                 ///< Format
+        int ipolType;               ///< nAnimation::Curve::IpolType
+        int byteOffset;             ///< offset of the curve's key in a frame
+        vector4 rangeMin;           ///< constant value, or minimum of the value range
+        vector4 rangeScale;         ///< size of one quantization step
+    };
+    /// keys of a curve while packing
+    struct SourceCurve
+    {
+        const vector4* keys;
+        int keyStride;
+    };
+
+    /// get byte size of a key in the given format
+    static int GetKeySize(Format format);
+    /// encode a key
+    void EncodeKey(const CurveInfo& info, const vector4& key, uchar* dst) const;
+    /// decode a key
+    void DecodeKey(const CurveInfo& info, const uchar* src, vector4& dst) const;
+    /// sample curves, scalar version
+    void SampleScalar(const uchar* frame0, const uchar* frame1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const;
+    #ifdef __NEBULA_ANIM_SSE__
+    /// sample curves, SSE version
+    void SampleSSE(const uchar* frame0, const uchar* frame1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const;
+    #endif
+
+    nArray<CurveInfo> curves;
+    nArray<SourceCurve> sourceCurves;
+    nArray<uchar> keys;
+    int numKeys;
+    int frameSize;
+    bool isValid;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nPackedAnimGroup::IsValid() const
+{
+    return this->isValid;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nPackedAnimGroup::GetNumCurves() const
+{
+    return this->curves.Size();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nPackedAnimGroup::GetNumKeys() const
+{
+    return this->numKeys;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nPackedAnimGroup::Format
+nPackedAnimGroup::GetFormat(int curveIndex) const
+{
+    return (Format) this->curves[curveIndex].format;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nPackedAnimGroup::GetByteSize() const
+{
+    return this->keys.Size() + this->curves.Size() * sizeof(CurveInfo);
+}
+
+//------------------------------------------------------------------------------
+#endif
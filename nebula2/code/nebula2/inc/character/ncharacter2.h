@@ -7,11 +7,19 @@
 
     @brief Holds all the data necessary to animate an character in one place.
 
+    EvaluateSkeleton() only modifies the character itself, the shared
+    animation is sampled through the reentrant nAnimation::SampleCurves().
+    Different characters may be evaluated on different threads at the
+    same time if every thread passes its own worker index, the sample
+    buffers for the worker indices must have been created on the main
+    thread with SetupSampleBuffers().
+
     (C) 2003 RadonLabs GmbH
 */
 #include "kernel/nrefcounted.h"
 #include "character/ncharskeleton.h"
 #include "anim2/nanimstateinfo.h"
+#include "util/nfixedarray.h"
 
 class nVariableContext;
 class nSkinAnimator;
@@ -45,8 +53,8 @@ public:
     void SetActiveState(const nAnimStateInfo& newState);
     /// get the currently active state
     const nAnimStateInfo& GetActiveState() const;
-    /// evaluate the joint skeleton
-    void EvaluateSkeleton(float time);
+    /// evaluate the joint skeleton, workerIndex selects the sample buffers to use
+    void EvaluateSkeleton(float time, int workerIndex = 0);
     /// emit animation events between 2 times
     void EmitAnimEvents(float startTime, float stopTime);
     /// enable/disable animation
@@ -57,10 +65,14 @@ public:
     void SetLastEvaluationFrameId(uint id);
     /// get the frame id when the character was last evaluated
     uint GetLastEvaluationFrameId() const;
+    /// create sample buffers for worker indices [0, numWorkers), call from the main thread only
+    static void SetupSampleBuffers(int numWorkers);
 
 private:
     /// sample weighted values at a given time from nAnimation object
-    bool Sample(const nAnimStateInfo& info, float time, vector4* keyArray, vector4* scratchKeyArray, int keyArraySize);
+    bool Sample(const nAnimStateInfo& info, float time, vector4* keyArray, vector4* scratchKeyArray, vector4* clipValueArray, int keyArraySize);
+    /// get the maximum number of curves sampled for an animation state
+    int GetMaxNumCurves(const nAnimStateInfo& info) const;
     /// emit animation events for a given time range
     void EmitAnimEvents(const nAnimStateInfo& info, float fromTime, float toTime);
     /// begin defining blended animation events
@@ -85,9 +97,7 @@ private:
     nAnimStateInfo curStateInfo;
 
     static nArray<nAnimEventTrack> outAnimEventTracks;
-    static vector4 scratchKeyArray[MaxCurves];
-    static vector4 keyArray[MaxCurves];
-    static vector4 transitionKeyArray[MaxCurves];
+    static nFixedArray<nFixedArray<vector4> > sampleBuffers;    // per worker: key, transition key, scratch and clip value arrays
 
     bool animEnabled;
     uint lastEvaluationFrameId;
@@ -7,6 +7,9 @@
 
     @brief A joint in a character skeleton.
 
+    Joints are usually evaluated by their nCharSkeleton in one linear
+    pass, the joint names are kept in a side table in the skeleton.
+
      - 06-Feb-03   floh    fixed for Nebula2
 
     (C) 2002 RadonLabs GmbH
@@ -15,7 +18,6 @@
 #include "mathlib/vector.h"
 #include "mathlib/matrix.h"
 #include "mathlib/quaternion.h"
-#include "util/nstring.h"
 
 //------------------------------------------------------------------------------
 class nCharJoint
@@ -57,10 +59,6 @@ public:
     void SetVariationScale(const vector3& s);
     /// get variation scale
     const vector3& GetVariationScale() const;
-    /// set name
-    void SetName(const nString& name);
-    /// get name
-    const nString& GetName() const;
     /// evaluate joint
     void Evaluate();
     /// directly set the local matrix
@@ -85,6 +83,8 @@ public:
     bool IsUptodate() const;
 
 private:
+    friend class nCharSkeleton;
+
     vector3 poseTranslate;
     quaternion poseRotate;
     vector3 poseScale;
@@ -108,8 +108,6 @@ private:
     bool matrixDirty;
     bool lockMatrix;
     bool isUptodate;
-
-    nString name;
 };
 
 //------------------------------------------------------------------------------
@@ -447,26 +445,6 @@ nCharJoint::GetSkinMatrix33() const
     return this->skinMatrix33;
 }
 
-//------------------------------------------------------------------------------
-/**
-*/
-inline
-void
-nCharJoint::SetName(const nString& name)
-{
-    this->name = name;
-}
-
-//------------------------------------------------------------------------------
-/**
-*/
-inline
-const nString&
-nCharJoint::GetName() const
-{
-    return this->name;
-}
-
 //------------------------------------------------------------------------------
 /**
     Return the bind pose matrix. This matrix is already flattened into
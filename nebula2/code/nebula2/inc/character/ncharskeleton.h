@@ -7,11 +7,25 @@
 
     @brief Implements a character skeleton made of nCharJoint objects.
 
+    Evaluate() updates all joints in a single linear pass, in an order in
+    which every parent joint comes before its children (computed in
+    EndJoints()). With SSE the local matrices of 4 joints are built at
+    once from their translation, rotation and scale, then the parent
+    and skin matrix products are done with SSE row operations. The joint
+    names are kept in a separate array, so that the joint objects
+    contain only data needed for evaluation.
+
     (C) 2002 RadonLabs GmbH
 */
 
 #include "character/ncharjoint.h"
 #include "util/nfixedarray.h"
+#include "util/nstring.h"
+
+// SSE skeleton evaluation available?
+#if !defined(__NEBULA_NO_SSE__) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define __NEBULA_CHARACTER_SSE__ (1)
+#endif
 
 //------------------------------------------------------------------------------
 class nCharSkeleton
@@ -37,6 +51,8 @@ public:
     int GetNumJoints() const;
     /// get joint by index
     nCharJoint& GetJointAt(int index) const;
+    /// get joint name by index
+    const nString& GetJointName(int index) const;
     /// get joint index by name
     int GetJointIndexByName(const nString& name) const;
     /// evaluate all character joints
@@ -45,31 +61,22 @@ public:
 private:
     /// update the parent joint pointers from their indexes
     void UpdateParentJointPointers();
+    /// compute the evaluation order (parents before children)
+    void UpdateEvaluationOrder();
+    #ifdef __NEBULA_CHARACTER_SSE__
+    /// compute local matrices of up to 4 joints with SSE
+    static void ComputeLocalMatrices(nCharJoint* const* joints, int num);
+    /// compute local matrices of all dirty joints with SSE
+    void EvaluateLocalMatricesSSE();
+    /// compute world and skin matrices with SSE
+    void EvaluateWorldMatricesSSE();
+    #endif
 
     nFixedArray<nCharJoint> jointArray;
+    nFixedArray<nString> jointNames;
+    nFixedArray<int> evalOrder;
 };
 
-//------------------------------------------------------------------------------
-/**
-*/
-inline
-void
-nCharSkeleton::Evaluate()
-{
-    // first pass: clear uptodate flag
-    int i;
-    int num = this->jointArray.Size();
-    for (i = 0; i < num; i++)
-    {
-        this->jointArray[i].ClearUptodateFlag();
-    }
-    // seconds pass: evaluate joints
-    for (i = 0; i < num; i++)
-    {
-        this->jointArray[i].Evaluate();
-    }
-}
-
 //------------------------------------------------------------------------------
 /**
 */
@@ -105,6 +112,8 @@ inline
 nCharSkeleton::nCharSkeleton(const nCharSkeleton& src)
 {
     this->jointArray = src.jointArray;
+    this->jointNames = src.jointNames;
+    this->evalOrder = src.evalOrder;
     this->UpdateParentJointPointers();
 }
 
@@ -117,6 +126,8 @@ nCharSkeleton::operator=(const nCharSkeleton& src)
 {
     n_assert(&src != this);
     this->jointArray = src.jointArray;
+    this->jointNames = src.jointNames;
+    this->evalOrder = src.evalOrder;
     this->UpdateParentJointPointers();
 }
 
@@ -128,6 +139,8 @@ void
 nCharSkeleton::Clear()
 {
     this->jointArray.SetSize(0);
+    this->jointNames.SetSize(0);
+    this->evalOrder.SetSize(0);
 }
 
 //------------------------------------------------------------------------------
@@ -151,6 +164,8 @@ nCharSkeleton::BeginJoints(int num)
 {
     n_assert(num > 0);
     this->jointArray.SetSize(num);
+    this->jointNames.SetSize(num);
+    this->evalOrder.SetSize(0);
 }
 
 //------------------------------------------------------------------------------
@@ -172,8 +187,8 @@ nCharSkeleton::SetJoint(int index, int parentIndex, const vector3& poseTranslate
         newJoint.SetParentJoint(&(this->jointArray[parentIndex]));
     }
     newJoint.SetPose(poseTranslate, poseRotate, poseScale);
-    newJoint.SetName(name);
     this->jointArray[index] = newJoint;
+    this->jointNames[index] = name;
 }
 
 //------------------------------------------------------------------------------
@@ -184,7 +199,7 @@ inline
 void
 nCharSkeleton::EndJoints()
 {
-    // empty
+    this->UpdateEvaluationOrder();
 }
 
 //------------------------------------------------------------------------------
@@ -207,6 +222,16 @@ nCharSkeleton::GetJointAt(int index) const
     return this->jointArray[index];
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nString&
+nCharSkeleton::GetJointName(int index) const
+{
+    return this->jointNames[index];
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -215,9 +240,9 @@ int
 nCharSkeleton::GetJointIndexByName(const nString& name) const
 {
     int index;
-    for (index = 0; index < this->jointArray.Size(); index++)
+    for (index = 0; index < this->jointNames.Size(); index++)
     {
-        if (this->jointArray[index].GetName() == name)
+        if (this->jointNames[index] == name)
         {
             return index;
         }
@@ -13,12 +13,29 @@
     and vertex weights), set a character skeleton and a joint palette,
     and call Compute().
 
+    Compute() first copies the skin matrices of the joint palette into a
+    contiguous array, then blends the (up to 4) weighted joint matrices
+    once per vertex and transforms position, normal, tangent and binormal
+    with the blended matrix in a single pass. The vertex layout is taken
+    from the component offsets of the meshes. With SSE the matrix rows are
+    blended and applied in SSE registers. Large meshes are split into
+    ranges of VerticesPerTask vertices which are skinned on the kernel's
+    worker pool (see SetParallel()).
+
+    SkinPositions() exposes the kernel to other CPU skinning code which
+    only needs skinned positions (shadow casters, ray checks).
+
     (C) 2004 RadonLabs GmbH
 */
 #include "deformers/nmeshdeformer.h"
 #include "character/ncharskeleton.h"
 #include "character/ncharjointpalette.h"
 
+// SSE skinning available?
+#if !defined(__NEBULA_NO_SSE__) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define __NEBULA_SKINNING_SSE__ (1)
+#endif
+
 //------------------------------------------------------------------------------
 class nSkinMeshDeformer : public nMeshDeformer
 {
@@ -35,12 +52,65 @@ public:
     void SetJointPalette(nCharJointPalette* pal);
     /// get pointer to joint palette
     nCharJointPalette* GetJointPalette() const;
+    /// enable/disable skinning large meshes on the worker threads (default is enabled)
+    void SetParallel(bool b);
+    /// get parallel skinning flag
+    bool GetParallel() const;
     /// perform deformation
     virtual void Compute();
+    /// skin vertex positions, weights and joint indices are read from the source vertices
+    static void SkinPositions(const matrix44* skinMatrices, const float* src, int srcWidth, int weightOffset, int jindexOffset, float* dst, int dstWidth, int numVertices);
 
 protected:
+    enum
+    {
+        MaxCopyRanges = 5,          // Uv0..Uv3 and Color are copied unchanged
+        VerticesPerTask = 4096,     // number of vertices skinned by one worker task
+    };
+
+    /// vertex layout of a skinning pass, offsets in floats, -1 if the component doesn't exist
+    struct Layout
+    {
+        int srcWidth;
+        int dstWidth;
+        int weights;
+        int jindices;
+        int srcNormal;
+        int dstNormal;
+        int srcTangent;
+        int dstTangent;
+        int srcBinormal;
+        int dstBinormal;
+        int numCopyRanges;
+        int copySrc[MaxCopyRanges];
+        int copyDst[MaxCopyRanges];
+        int copySize[MaxCopyRanges];
+    };
+    /// a range of vertices skinned by one worker task
+    struct Job
+    {
+        const Layout* layout;
+        const matrix44* skinMatrices;
+        const float* src;
+        float* dst;
+        int numVertices;
+    };
+
+    /// skin a range of vertices
+    static void SkinVertices(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+    /// skin a range of vertices, scalar version
+    static void SkinVerticesScalar(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+    #ifdef __NEBULA_SKINNING_SSE__
+    /// skin a range of vertices, SSE version
+    static void SkinVerticesSSE(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+    #endif
+    /// worker task function
+    static void SkinVerticesTask(int taskIndex, int workerIndex, void* userData);
+
     const nCharSkeleton* skeleton;
     nCharJointPalette* jointPalette;
+    nArray<matrix44> skinMatrices;
+    bool parallel;
 };
 
 //------------------------------------------------------------------------------
@@ -85,5 +155,25 @@ nSkinMeshDeformer::GetJointPalette() const
     return this->jointPalette;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nSkinMeshDeformer::SetParallel(bool b)
+{
+    this->parallel = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nSkinMeshDeformer::GetParallel() const
+{
+    return this->parallel;
+}
+
 //------------------------------------------------------------------------------
 #endif
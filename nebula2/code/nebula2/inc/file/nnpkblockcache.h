@@ -0,0 +1,112 @@
+#ifndef N_NPKBLOCKCACHE_H
+#define N_NPKBLOCKCACHE_H
+//------------------------------------------------------------------------------
+/**
+    @class nNpkBlockCache
+    @ingroup NPKFile
+
+    @brief A cache of decoded blocks of compressed npk file entries.
+
+    Sequential reads and small seeks into a compressed npk file entry
+    touch the same block several times, the cache keeps the most recently
+    used decoded blocks around so that each block is decoded only once.
+    The cache is thread-safe. A cache miss reserves the least recently
+    used block while the cache is locked, the block is decoded without
+    holding the lock and published through the block's state. Readers
+    of a block which is still being decoded wait until it is published.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "kernel/nmutex.h"
+#include "util/narray.h"
+
+class nNpkTocEntry;
+
+//------------------------------------------------------------------------------
+class nNpkBlockCache
+{
+public:
+    /// constructor
+    nNpkBlockCache();
+    /// destructor
+    ~nNpkBlockCache();
+    /// set number of cached blocks (default is 32, which is 2 MB)
+    void SetNumBlocks(int num);
+    /// get number of cached blocks
+    int GetNumBlocks() const;
+    /// read from a block of a compressed toc entry, decodes the block on a cache miss
+    int Read(nNpkTocEntry* entry, int blockIndex, int blockOffset, void* buffer, int numBytes);
+    /// discard all cached blocks (must be called when toc entries are deleted)
+    void Clear();
+    /// get number of cache hits
+    int GetNumHits() const;
+    /// get number of cache misses
+    int GetNumMisses() const;
+
+private:
+    /// state of a cache block
+    enum BlockState
+    {
+        Empty,
+        Decoding,       // reserved by a thread which decodes the block
+        Valid,
+    };
+
+    /// a decoded block
+    struct Block
+    {
+        nNpkTocEntry* entry;
+        int blockIndex;
+        BlockState state;
+        uint lastUse;
+        int size;
+        char* data;
+    };
+
+    /// find the block of a toc entry, cache must be locked
+    Block* FindBlock(nNpkTocEntry* entry, int blockIndex);
+    /// find the least recently used block which isn't being decoded, cache must be locked
+    Block* FindLruBlock();
+    /// wait until no block is being decoded, cache must be locked
+    void WaitDecoding();
+
+    nArray<Block> blocks;
+    nMutex mutex;
+    uint useCounter;
+    int numHits;
+    int numMisses;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkBlockCache::GetNumBlocks() const
+{
+    return this->blocks.Size();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkBlockCache::GetNumHits() const
+{
+    return this->numHits;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkBlockCache::GetNumMisses() const
+{
+    return this->numMisses;
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,80 @@
+#ifndef N_NPKCODEC_H
+#define N_NPKCODEC_H
+//------------------------------------------------------------------------------
+/**
+    @class nNpkCodec
+    @ingroup NPKFile
+
+    @brief Compression of npk file entries.
+
+    Compressed npk file entries are split into blocks of BlockSize bytes
+    which are compressed independently, so that a seek into a compressed
+    entry only needs to decode the blocks which are actually read. The
+    data of a compressed entry starts with a table of (numBlocks + 1)
+    block offsets relative to the start of the entry, followed by the
+    blocks. A block whose compressed size equals its decoded size is
+    stored uncompressed.
+
+    The Lz codec is a byte oriented LZ77 variant (in the spirit of LZ4)
+    which is designed for decoding speed. A compressed block is a sequence
+    of tokens: the high nibble of a token is the literal count, the low
+    nibble the match length minus 4. A nibble value of 15 is continued
+    with bytes of 255 until a byte < 255 appears. The literals follow the
+    token, then a 16 bit little endian match offset. The last token of a
+    block only carries literals.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+//------------------------------------------------------------------------------
+class nNpkCodec
+{
+public:
+    /// compression codecs
+    enum Codec
+    {
+        Stored = 0,     ///< not compressed
+        Lz = 1,         ///< fast LZ77 codec
+        Zlib = 2,       ///< reserved for zlib, not supported by the runtime yet
+    };
+    /// size of a decoded block
+    enum
+    {
+        BlockSize = 65536,
+    };
+
+    /// get number of blocks of a compressed entry
+    static int GetNumBlocks(int length);
+    /// get max compressed size of a block (worst case)
+    static int GetMaxCompressedSize(int srcSize);
+    /// compress a block, returns compressed size, or 0 if it doesn't fit into dst
+    static int Compress(const void* src, int srcSize, void* dst, int dstCapacity);
+    /// decompress a block, returns decompressed size, or -1 if the data is corrupt
+    static int Decompress(const void* src, int srcSize, void* dst, int dstSize);
+    /// compress an entry into block table and blocks, returns false if not worth it
+    static bool CompressEntry(const void* src, int srcSize, char*& dst, int& dstSize);
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkCodec::GetNumBlocks(int length)
+{
+    return (length + BlockSize - 1) / BlockSize;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkCodec::GetMaxCompressedSize(int srcSize)
+{
+    return srcSize + (srcSize / 255) + 16;
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -7,6 +7,11 @@
 
     File access into a npk file.
 
+    Reads go through nNpkFileWrapper::ReadAt() and don't depend on a
+    shared file position, so several nNpkFile objects may read from the
+    same npk file in different threads. If the npk file is memory mapped,
+    ReadMapped() returns pointers directly into the mapping.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/nfile.h"
@@ -42,6 +47,8 @@ public:
     virtual int GetSize() const;
     /// get the last write time
     virtual nFileTime GetLastWriteTime() const;
+    /// get a pointer to the next numBytes in the memory mapped npk file and skip them
+    virtual const void* ReadMapped(int numBytes);
 
 private:
     nNpkTocEntry* tocEntry;         // associated npk toc entry object
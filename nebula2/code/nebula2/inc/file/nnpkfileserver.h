@@ -7,6 +7,11 @@
 
     Implement reading from npk files.
 
+    Two versions of the npk file format can be read: version 0 stores all
+    files uncompressed, version 2 ('NPK2' magic number) adds FIL2 blocks
+    which describe files that may be compressed (see nNpkCodec). Decoded
+    blocks of compressed files are kept in a block cache.
+
     See also @ref N2ScriptInterface_nnpkfileserver
 
     npk file format:
@@ -36,6 +41,18 @@
         char[] fileName             // name of file
     }
 
+    # version 2 only
+    block FIL2 {
+        uint32 'FIL2'               // magic number of file block
+        uint32 blockLen             // number of following bytes in block
+        uint32 fileOffset           // start of file data inside data block
+        uint32 fileLength           // decoded length of file in bytes
+        uint32 compressedLength     // length of file data in bytes
+        uint32 codec                // nNpkCodec::Codec, 0 if stored uncompressed
+        uint16 fileNameLength       // length of the following name
+        char[] fileName             // name of file
+    }
+
     block ENDOFDIR {
         uint32 'DEND'               // magic number of end of dir block
         uint32 blockLen             // number of following bytes in block (0)
@@ -52,6 +69,7 @@
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/nfileserver2.h"
+#include "file/nnpkblockcache.h"
 
 //------------------------------------------------------------------------------
 class nNpkTocEntry;
@@ -78,6 +96,12 @@ public:
     virtual void ReleaseNpkFiles(const nString& pattern);
     /// pack a directory into a new NPK file
     virtual bool Pack(const nString& rootPath, const nString& dirName, const nString& npkName, bool noTopLevelName);
+    /// set number of decoded blocks in block cache (64 KB each)
+    void SetBlockCacheSize(int numBlocks);
+    /// get number of decoded blocks in block cache
+    int GetBlockCacheSize() const;
+    /// get the block cache for compressed files
+    nNpkBlockCache* GetBlockCache();
 
 private:
     /// add one npk file to the internal list
@@ -86,7 +110,38 @@ private:
     nNpkTocEntry* FindTocEntry(const nString& absPath);
 
     nList npkFiles;         // list of nNpkFileWrapper objects
+    nNpkBlockCache blockCache;
 };
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nNpkFileServer::SetBlockCacheSize(int numBlocks)
+{
+    this->blockCache.SetNumBlocks(numBlocks);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkFileServer::GetBlockCacheSize() const
+{
+    return this->blockCache.GetNumBlocks();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nNpkBlockCache*
+nNpkFileServer::GetBlockCache()
+{
+    return &(this->blockCache);
+}
+
 //------------------------------------------------------------------------------
 #endif
@@ -7,14 +7,27 @@
 
     Wraps file operations on a npk file.
 
+    The npk file is mapped into memory when it is opened, so that
+    nNpkFile objects can read from (or directly point into) the mapping.
+    If the file can't be mapped (for instance because the address space
+    of a 32 bit process is too fragmented), reads go through positional
+    file reads (pread() or ReadFile() with an explicit offset). Both
+    ways don't touch a shared file position, so any number of threads
+    can read from the same npk file at the same time.
+
+    Compressed file entries (npk format version 2) are decoded block
+    by block, see nNpkCodec and nNpkBlockCache.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "util/nnode.h"
 #include "file/nnpktoc.h"
+#include "kernel/nmutex.h"
 
 //------------------------------------------------------------------------------
 class nFile;
 class nFileServer2;
+class nNpkBlockCache;
 class nNpkFileWrapper : public nNode
 {
 public:
@@ -34,8 +47,26 @@ public:
     nNpkToc& GetTocObject();
     /// get absolute path name of npk file
     const nString& GetAbsPath() const;
+    /// return true if the npk file is mapped into memory
+    bool IsMapped() const;
+    /// get pointer to mapped file data at an absolute file offset, 0 if not mapped
+    const void* GetMappedData(int offset) const;
+    /// thread-safe read at an absolute file offset
+    int ReadAt(void* buffer, int offset, int numBytes);
+    /// thread-safe read from a file entry, decodes compressed entries (blockCache may be 0)
+    int ReadEntry(nNpkTocEntry* entry, int pos, void* buffer, int numBytes, nNpkBlockCache* blockCache);
+    /// decode a block of a compressed file entry into a buffer of nNpkCodec::BlockSize bytes
+    int DecodeBlock(nNpkTocEntry* entry, int blockIndex, void* buffer);
+    /// read from a block of a compressed file entry without a block cache
+    int ReadBlock(nNpkTocEntry* entry, int blockIndex, int blockOffset, void* buffer, int numBytes);
+    /// get npk format version (0 or 2)
+    int GetVersion() const;
 
 private:
+    /// map the npk file into memory, or open a native handle for positional reads
+    void OpenMapping();
+    /// unmap the npk file and close native handle
+    void CloseMapping();
     /// parse table of contents
     bool ParseToc(const char* rootPath);
     /// read npk file header
@@ -46,9 +77,20 @@ private:
     nString absPath;            // absolute pathname of npk file
     nNpkToc toc;                // the table of contents of this npk file
     int dataOffset;             // start of the raw data in the npk file
+    int version;                // npk format version
     bool isOpen;
     nFile* binaryFile;          // binary file handle
     nFile* asciiFile;           // ascii file handle
+
+    const uchar* mappedData;    // the mapped npk file, or 0
+    int mappedSize;
+    #ifdef __WIN32__
+    HANDLE nativeHandle;        // for positional reads and the file mapping
+    HANDLE mappingHandle;
+    #elif defined(__LINUX__) || defined(__MACOSX__)
+    int nativeHandle;           // file descriptor for positional reads and mmap()
+    #endif
+    nMutex readMutex;           // serializes reads through binaryFile if there is no native handle
 };
 
 //------------------------------------------------------------------------------
@@ -61,5 +103,40 @@ nNpkFileWrapper::GetAbsPath() const
     return this->absPath;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkFileWrapper::GetVersion() const
+{
+    return this->version;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nNpkFileWrapper::IsMapped() const
+{
+    return (0 != this->mappedData);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const void*
+nNpkFileWrapper::GetMappedData(int offset) const
+{
+    if (this->mappedData)
+    {
+        n_assert((offset >= 0) && (offset <= this->mappedSize));
+        return this->mappedData + offset;
+    }
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 #endif
@@ -7,6 +7,10 @@
 
     Hold table of content entries for npk files.
 
+    The entries form a tree of directory and file entries. For fast
+    lookups by path, FindEntry() uses a flattened index over all entries
+    (see nNpkTocIndex) which is built once the toc is complete.
+
     (C) 2002 RadonLabs GmbH
 */
 #ifndef N_NPKTOCENTRY_H
@@ -17,6 +21,8 @@
 #include "util/nstring.h"
 #endif
 
+#include "file/nnpktocindex.h"
+
 //------------------------------------------------------------------------------
 class nNpkToc
 {
@@ -33,6 +39,10 @@ public:
     void EndDirEntry();
     /// find an entry by its absolute path name
     nNpkTocEntry* FindEntry(const char* name);
+    /// build the flattened index used by FindEntry()
+    void BuildIndex();
+    /// get the flattened index over all entries
+    const nNpkTocIndex& GetIndex() const;
     /// get the root entry
     nNpkTocEntry* GetRootEntry() const;
     /// set the filesystem path to the root entry
@@ -58,6 +68,8 @@ private:
     nNpkTocEntry* curDir;       // current directory (only valid during BeginDirEntry());
     int curStackIndex;
     nNpkTocEntry* stack[STACKSIZE];
+    int numEntries;
+    nNpkTocIndex index;
 };
 
 //------------------------------------------------------------------------------
@@ -91,7 +103,8 @@ inline
 nNpkToc::nNpkToc() :
     rootDir(0),
     curDir(0),
-    curStackIndex(0)
+    curStackIndex(0),
+    numEntries(0)
 {
     memset(this->stack, 0, sizeof(this->stack));
 }
@@ -117,6 +130,8 @@ nNpkTocEntry*
 nNpkToc::BeginDirEntry(const char* dirName)
 {
     nNpkTocEntry* entry = 0;
+    this->index.Clear();
+    this->numEntries++;
 
     if (this->curDir)
     {
@@ -147,6 +162,8 @@ nNpkTocEntry*
 nNpkToc::AddFileEntry(const char* fileName, int fileOffset, int fileLength)
 {
     n_assert(this->curDir);
+    this->index.Clear();
+    this->numEntries++;
 
     // create new toc entry and add to subdir
     return this->curDir->AddFileEntry(fileName, fileOffset, fileLength);
@@ -168,7 +185,13 @@ nNpkToc::EndDirEntry()
 
 //------------------------------------------------------------------------------
 /**
-    Find an entry by its full name.
+    Find an entry by its full name. The path is normalized (lowercase,
+    "." and ".." resolved) into a local buffer and looked up in the
+    flattened toc index, so this doesn't descend the directory tree.
+
+    Like a walk down the tree, a ".." only resolves if the path in front
+    of it exists, so "root/missing/../x" isn't found. The first component
+    must be the name of the root directory.
 */
 inline
 nNpkTocEntry*
@@ -182,40 +205,107 @@ nNpkToc::FindEntry(const char* absName)
     {
         return 0;
     }
-
-    // make a copy of the name because we need to modify it
-    nString tmpName = strippedPath;
-    tmpName.ToLower();
+    if (!this->index.IsValid())
+    {
+        this->BuildIndex();
+    }
 
     // for each path component...
-    char* curComponent = strtok((char*)tmpName.Get(), "/\\");
-    nNpkTocEntry* curEntry = this->rootDir;
-    if (0 == strcmp(curEntry->GetName(), curComponent))
+    char path[N_MAXPATH];
+    int len = 0;
+    const char* src = strippedPath;
+    while (*src)
     {
-        while (curEntry && (curComponent = strtok(0, "/\\")))
+        while (('/' == *src) || ('\\' == *src))
         {
-            // handle special directory names
-            if (strcmp(curComponent, ".") == 0)
+            src++;
+        }
+        if (0 == *src)
+        {
+            break;
+        }
+        const char* component = src;
+        while (*src && ('/' != *src) && ('\\' != *src))
+        {
+            src++;
+        }
+        int componentLen = int(src - component);
+
+        // handle special directory names
+        if ((1 == componentLen) && ('.' == component[0]))
+        {
+            // stay on current level, but the path must start at the root directory
+            if (0 == len)
+            {
+                return 0;
+            }
+        }
+        else if ((2 == componentLen) && ('.' == component[0]) && ('.' == component[1]))
+        {
+            // up to parent, the current entry must exist, and
+            // there's no parent above the root directory
+            if ((0 == len) || (0 == this->index.Find(path, len)))
             {
-                // stay on current level
+                return 0;
             }
-            else if (strcmp(curComponent, "..") == 0)
+            while ((len > 0) && ('/' != path[len - 1]))
             {
-                // up to parent
-                curEntry = curEntry->GetParent();
+                len--;
             }
-            else
+            if (0 == len)
             {
-                // normal case: one level down
-                curEntry = curEntry->FindEntry(curComponent);
+                return 0;
+            }
+            len--;
+        }
+        else
+        {
+            // normal case: one level down
+            if ((len + componentLen + 2) > int(sizeof(path)))
+            {
+                return 0;
+            }
+            if (len > 0)
+            {
+                path[len++] = '/';
+            }
+            int i;
+            for (i = 0; i < componentLen; i++)
+            {
+                char c = component[i];
+                if ((c >= 'A') && (c <= 'Z'))
+                {
+                    c += 'a' - 'A';
+                }
+                path[len++] = c;
             }
         }
-        return curEntry;
-    }
-    else
-    {
-        return 0;
     }
+    return this->index.Find(path, len);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Build the flattened index over all toc entries. This is called by
+    nNpkFileWrapper after the toc has been read, adding entries later
+    discards the index.
+*/
+inline
+void
+nNpkToc::BuildIndex()
+{
+    n_assert(this->rootDir);
+    this->index.Build(this->rootDir, this->numEntries);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nNpkTocIndex&
+nNpkToc::GetIndex() const
+{
+    return this->index;
 }
 
 //------------------------------------------------------------------------------
@@ -9,6 +9,10 @@
     in a tree of nodes. A node can be a dir node, or a file node. File nodes
     never have children, dir nodes can have children but don't have to.
 
+    File entries may be compressed (see nNpkCodec), in this case the
+    file length is the decoded length, and the compressed length is the
+    size of the entry's data in the npk file.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "util/nhashnode.h"
@@ -40,6 +44,16 @@ public:
     int GetFileOffset() const;
     /// get file length
     int GetFileLength() const;
+    /// set file offset
+    void SetFileOffset(int fileOffset);
+    /// set compression codec and compressed length of a file entry
+    void SetCompression(int codec, int compressedLength);
+    /// get compression codec (nNpkCodec::Codec)
+    int GetCodec() const;
+    /// return true if the file entry is compressed
+    bool IsCompressed() const;
+    /// get length of file data in npk file
+    int GetCompressedLength() const;
     /// get root path
     const char* GetRootPath() const;
     /// add a sub dir entry
@@ -58,6 +72,10 @@ public:
     void SetFileWrapper(nNpkFileWrapper* wrapper);
     /// get the file wrapper object which this tocEntry belongs to
     nNpkFileWrapper* GetFileWrapper() const;
+    /// set position in the toc index (see nNpkTocIndex)
+    void SetIndex(int i);
+    /// get position in the toc index
+    int GetIndex() const;
 
 private:
     nNpkFileWrapper* fileWrapper;
@@ -66,6 +84,9 @@ private:
     Type type;
     int offset;
     int length;
+    int compressedLength;
+    int codec;
+    int index;              // position in the toc index
     nHashList* entryList;   // optional hash list
 };
 
@@ -81,6 +102,9 @@ nNpkTocEntry::nNpkTocEntry(const char* rPath, nNpkTocEntry* parentEntry, const c
     type(DIR),
     offset(0),
     length(0),
+    compressedLength(0),
+    codec(0),
+    index(-1),
     entryList(0)
 {
     // empty
@@ -98,6 +122,9 @@ nNpkTocEntry::nNpkTocEntry(const char* rPath, nNpkTocEntry* parentEntry, const c
     type(FILE),
     offset(fileOffset),
     length(fileLength),
+    compressedLength(fileLength),
+    codec(0),
+    index(-1),
     entryList(0)
 {
     // empty
@@ -160,6 +187,58 @@ nNpkTocEntry::GetFileLength() const
     return this->length;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nNpkTocEntry::SetFileOffset(int fileOffset)
+{
+    this->offset = fileOffset;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nNpkTocEntry::SetCompression(int c, int compLength)
+{
+    n_assert(FILE == this->type);
+    this->codec = c;
+    this->compressedLength = compLength;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkTocEntry::GetCodec() const
+{
+    return this->codec;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nNpkTocEntry::IsCompressed() const
+{
+    return (0 != this->codec);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkTocEntry::GetCompressedLength() const
+{
+    return this->compressedLength;
+}
+
 //------------------------------------------------------------------------------
 /**
     This is the path to the NPK file which contains this toc entry,
@@ -314,5 +393,25 @@ nNpkTocEntry::GetFileWrapper() const
     return this->fileWrapper;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nNpkTocEntry::SetIndex(int i)
+{
+    this->index = i;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkTocEntry::GetIndex() const
+{
+    return this->index;
+}
+
 //------------------------------------------------------------------------------
 #endif
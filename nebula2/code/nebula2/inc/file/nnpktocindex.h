@@ -0,0 +1,154 @@
+#ifndef N_NPKTOCINDEX_H
+#define N_NPKTOCINDEX_H
+//------------------------------------------------------------------------------
+/**
+    @class nNpkTocIndex
+    @ingroup NPKFile
+
+    @brief Flattened index over all entries of a nNpkToc.
+
+    The entries are stored in an array in toc order (directories are
+    followed by their contents, depth first), so all entries below a
+    directory form the contiguous range [dirIndex + 1, GetSubtreeEnd(dirIndex)).
+    An open addressing hash table (linear probing) maps the full entry
+    path relative to the toc's root path (for instance "textures/a/b.dds",
+    where "textures" is the toc's root directory) to the array index, so
+    that a lookup doesn't descend the directory tree.
+
+    The paths themselves are not stored, a hash match is verified by
+    walking the entry's parent chain.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+class nNpkTocEntry;
+
+//------------------------------------------------------------------------------
+class nNpkTocIndex
+{
+public:
+    /// constructor
+    nNpkTocIndex();
+    /// destructor
+    ~nNpkTocIndex();
+    /// build the index from a toc tree
+    void Build(nNpkTocEntry* rootEntry, int numEntries);
+    /// discard the index
+    void Clear();
+    /// return true if the index has been built
+    bool IsValid() const;
+    /// compute the hash of a path, or continue the hash of a parent path
+    static uint HashPath(uint hash, const char* str, int len);
+    /// get the hash of an empty path
+    static uint GetEmptyHash();
+    /// find an entry by its normalized path relative to the root path
+    nNpkTocEntry* Find(const char* path, int len) const;
+    /// get number of entries
+    int GetNumEntries() const;
+    /// get entry at index
+    nNpkTocEntry* GetEntryAt(int index) const;
+    /// get end of the range of entries below an entry (index + 1 for files)
+    int GetSubtreeEnd(int index) const;
+    /// get the first entry in a directory, or 0
+    nNpkTocEntry* GetFirstChild(const nNpkTocEntry* dirEntry) const;
+    /// get the next entry in the same directory, or 0
+    nNpkTocEntry* GetNextSibling(const nNpkTocEntry* entry) const;
+
+private:
+    /// add an entry and its contents, returns the subtree end
+    int AddEntry(nNpkTocEntry* entry, uint parentHash);
+    /// check whether an entry has the given path
+    static bool MatchPath(const nNpkTocEntry* entry, const char* path, int len);
+
+    /// an entry in toc order
+    struct Entry
+    {
+        nNpkTocEntry* entry;
+        int subtreeEnd;
+    };
+    /// a hash table slot
+    struct Slot
+    {
+        uint hash;
+        nNpkTocEntry* entry;    ///< 0 if empty
+    };
+
+    Entry* entries;
+    int numEntries;
+    int maxEntries;
+    Slot* slots;
+    int capacity;           ///< always a power of 2
+};
+
+//------------------------------------------------------------------------------
+/**
+    FNV-1a hash, can be continued with the hash of a parent path.
+*/
+inline
+uint
+nNpkTocIndex::HashPath(uint hash, const char* str, int len)
+{
+    const uchar* ptr = (const uchar*) str;
+    const uchar* end = ptr + len;
+    while (ptr < end)
+    {
+        hash = (hash ^ *ptr++) * 16777619u;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+uint
+nNpkTocIndex::GetEmptyHash()
+{
+    return 2166136261u;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nNpkTocIndex::IsValid() const
+{
+    return (0 != this->slots);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkTocIndex::GetNumEntries() const
+{
+    return this->numEntries;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nNpkTocEntry*
+nNpkTocIndex::GetEntryAt(int index) const
+{
+    n_assert((index >= 0) && (index < this->numEntries));
+    return this->entries[index].entry;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nNpkTocIndex::GetSubtreeEnd(int index) const
+{
+    n_assert((index >= 0) && (index < this->numEntries));
+    return this->entries[index].subtreeEnd;
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -48,6 +48,8 @@ protected:
     virtual void OnLost();
     /// called when contained resource may be restored
     virtual void OnRestored();
+    /// plain texture files can be preloaded by the I/O thread
+    virtual bool CanPreloadFile();
 
 private:
     friend class nD3D9Server;
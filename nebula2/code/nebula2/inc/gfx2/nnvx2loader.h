@@ -143,15 +143,31 @@ nNvx2Loader::ReadVertices(void* buffer, int bufferSize)
     }
     else
     {
+        // strip vertex components, read directly from the memory
+        // mapped npk file if possible
         float* destBuf = (float*)buffer;
-        float* readBuffer = n_new_array(float, this->fileVertexWidth);
         const int readSize = int(sizeof(float)) * this->fileVertexWidth;
+        const float* srcBuf = (const float*) file->ReadMapped(readSize * this->numVertices);
+        float* readBuffer = 0;
+        if (0 == srcBuf)
+        {
+            readBuffer = n_new_array(float, this->fileVertexWidth);
+        }
         int v = 0;
         for (v = 0; v < this->numVertices; v++)
         {
-            float* vBuf = readBuffer;
-            int numRead = file->Read(vBuf, readSize);
-            n_assert(numRead == readSize);
+            const float* vBuf;
+            if (srcBuf)
+            {
+                vBuf = srcBuf;
+                srcBuf += this->fileVertexWidth;
+            }
+            else
+            {
+                vBuf = readBuffer;
+                int numRead = file->Read(readBuffer, readSize);
+                n_assert(numRead == readSize);
+            }
 
             int bitIndex;
             for (bitIndex = 0; bitIndex < nMesh2::NumVertexComponents; bitIndex++)
@@ -183,7 +199,10 @@ nNvx2Loader::ReadVertices(void* buffer, int bufferSize)
                 }
             }
         }
-        n_delete_array(readBuffer);
+        if (readBuffer)
+        {
+            n_delete_array(readBuffer);
+        }
     }
     return true;
 }
@@ -208,11 +227,18 @@ nNvx2Loader::ReadIndices(void* buffer, int bufferSize)
         // 32 bit indices, read into 16 bit buffer, and expand
         n_assert((this->numIndices * int(sizeof(uint))) == bufferSize);
 
-        // read 16 bit indices into tmp buffer
+        // read 16 bit indices from the memory mapped npk file,
+        // or into a tmp buffer
         int size16 = this->numIndices * sizeof(ushort);
-        ushort* ptr16 = (ushort*)n_malloc(size16);
-        n_assert(ptr16);
-        file->Read(ptr16, size16);
+        const ushort* ptr16 = (const ushort*) file->ReadMapped(size16);
+        ushort* buffer16 = 0;
+        if (0 == ptr16)
+        {
+            buffer16 = (ushort*)n_malloc(size16);
+            n_assert(buffer16);
+            file->Read(buffer16, size16);
+            ptr16 = buffer16;
+        }
 
         // expand to 32 bit indices
         uint* ptr32 = (uint*)buffer;
@@ -223,7 +249,10 @@ nNvx2Loader::ReadIndices(void* buffer, int bufferSize)
         }
 
         // release tmp buffer
-        n_free(ptr16);
+        if (buffer16)
+        {
+            n_free(buffer16);
+        }
     }
     return true;
 }
@@ -60,6 +60,8 @@ public:
     virtual int GetSize() const;
     /// get the last write time
     virtual nFileTime GetLastWriteTime() const;
+    /// get a pointer to the next numBytes of a memory mapped file and skip them
+    virtual const void* ReadMapped(int numBytes);
     /// writes a string to the file
     bool PutS(const nString& buffer);
     /// reads a string from the file
@@ -119,9 +119,10 @@ private:
 
     nRef<nRoot> assignDir;
 
-    int bytesRead;
-    int bytesWritten;
-    int numSeeks;
+    // statistics, updated by any thread which reads or writes files
+    volatile long bytesRead;
+    volatile long bytesWritten;
+    volatile long numSeeks;
 };
 
 //------------------------------------------------------------------------------
@@ -143,9 +144,9 @@ inline
 void
 nFileServer2::ResetStatistics()
 {
-    this->bytesRead = 0;
-    this->bytesWritten = 0;
-    this->numSeeks = 0;
+    n_interlocked_exchange(&this->bytesRead, 0);
+    n_interlocked_exchange(&this->bytesWritten, 0);
+    n_interlocked_exchange(&this->numSeeks, 0);
 }
 
 //------------------------------------------------------------------------------
@@ -156,7 +157,7 @@ inline
 void
 nFileServer2::AddBytesRead(int b)
 {
-    this->bytesRead += b;
+    n_interlocked_add(&this->bytesRead, b);
 }
 
 //------------------------------------------------------------------------------
@@ -167,7 +168,7 @@ inline
 void
 nFileServer2::AddBytesWritten(int b)
 {
-    this->bytesWritten += b;
+    n_interlocked_add(&this->bytesWritten, b);
 }
 
 //------------------------------------------------------------------------------
@@ -178,7 +179,7 @@ inline
 void
 nFileServer2::AddSeek()
 {
-    this->numSeeks++;
+    n_interlocked_increment(&this->numSeeks);
 }
 
 //------------------------------------------------------------------------------
@@ -189,7 +190,7 @@ inline
 int
 nFileServer2::GetBytesRead() const
 {
-    return this->bytesRead;
+    return n_interlocked_read(&this->bytesRead);
 }
 
 //------------------------------------------------------------------------------
@@ -200,7 +201,7 @@ inline
 int
 nFileServer2::GetBytesWritten() const
 {
-    return this->bytesWritten;
+    return n_interlocked_read(&this->bytesWritten);
 }
 
 //------------------------------------------------------------------------------
@@ -211,7 +212,7 @@ inline
 int
 nFileServer2::GetNumSeeks() const
 {
-    return this->numSeeks;
+    return n_interlocked_read(&this->numSeeks);
 }
 
 //------------------------------------------------------------------------------
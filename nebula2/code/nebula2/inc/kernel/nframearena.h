@@ -0,0 +1,155 @@
+#ifndef N_FRAMEARENA_H
+#define N_FRAMEARENA_H
+//------------------------------------------------------------------------------
+/**
+    @class nFrameArena
+    @ingroup NebulaKernelMemory
+    @brief A double buffered linear allocator for transient per-frame data.
+
+    Alloc() hands out memory from large chunks by bumping an offset, there
+    is no way to free single allocations. NextFrame() is called once per
+    frame (by nTimeServer::Trigger()) and recycles the chunks of the
+    frame before the last one, so memory allocated in a frame stays valid
+    until the end of the following frame.
+
+    Alloc() is lock-free and may be called by any thread, NextFrame()
+    must not run while other threads allocate.
+
+    nArray objects with the nArray::FrameAlloc flag allocate their
+    elements from the frame arena.
+
+    The arena is created by the kernel server.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+//------------------------------------------------------------------------------
+class nFrameArena
+{
+public:
+    /// constructor
+    nFrameArena();
+    /// destructor
+    ~nFrameArena();
+    /// return instance pointer
+    static nFrameArena* Instance();
+    /// set the size of newly allocated chunks
+    void SetChunkSize(int size);
+    /// get the chunk size
+    int GetChunkSize() const;
+    /// start a new frame, discards the allocations of the frame before the last
+    void NextFrame();
+    /// allocate memory which stays valid until the end of the next frame (16 byte aligned)
+    void* Alloc(int size);
+    /// get the number of the current frame
+    uint GetFrameId() const;
+    /// get number of allocations in the last finished frame
+    int GetNumAllocs() const;
+    /// get number of bytes allocated in the last finished frame
+    int GetNumBytes() const;
+    /// get number of bytes held in chunks
+    int GetNumChunkBytes() const;
+
+private:
+    /// a memory chunk
+    struct Chunk
+    {
+        Chunk* next;
+        char* data;             // 16 byte aligned
+        int size;
+        volatile long used;     // may grow beyond size if the chunk is full
+    };
+    /// the chunks of one frame
+    struct Frame
+    {
+        Chunk* chunks;
+        Chunk* volatile curChunk;
+        volatile long numAllocs;
+    };
+
+    /// get a chunk with at least size bytes
+    Chunk* NewChunk(int size);
+    /// release the chunks of a frame
+    void ReleaseChunks(Frame& frame);
+    /// lock chunk allocation
+    void Lock();
+    /// unlock chunk allocation
+    void Unlock();
+
+    static nFrameArena* Singleton;
+
+    Frame frames[2];
+    int curFrame;
+    uint frameId;
+    int chunkSize;
+    Chunk* freeChunks;          // recycled chunks of chunkSize bytes
+    volatile long lock;
+    int numChunkBytes;
+    int lastNumAllocs;
+    int lastNumBytes;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nFrameArena*
+nFrameArena::Instance()
+{
+    n_assert(Singleton);
+    return Singleton;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nFrameArena::GetChunkSize() const
+{
+    return this->chunkSize;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+uint
+nFrameArena::GetFrameId() const
+{
+    return this->frameId;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nFrameArena::GetNumAllocs() const
+{
+    return this->lastNumAllocs;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nFrameArena::GetNumBytes() const
+{
+    return this->lastNumBytes;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nFrameArena::GetNumChunkBytes() const
+{
+    return this->numChunkBytes;
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,237 @@
+#ifndef N_INTERLOCKED_H
+#define N_INTERLOCKED_H
+//------------------------------------------------------------------------------
+/**
+    @ingroup Threading
+
+    @brief Atomic integer operations for lightweight thread synchronization.
+
+    Win32: Interlocked*() functions
+    Linux/MacOSX: gcc __sync builtins (__atomic builtins where available)
+
+    All functions return the new value of the destination, except
+    n_interlocked_exchange() and n_interlocked_compare_exchange() which
+    return the previous value. All of them are full memory barriers,
+    n_barrier() is a memory barrier on its own.
+
+    Variables which other threads modify with these functions should be
+    read with n_interlocked_read() or n_interlocked_read_pointer() instead
+    of a plain read. It makes sure that the writes which happened before
+    the modification are visible, and race checkers like ThreadSanitizer
+    see the synchronization.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+#ifndef __NEBULA_NO_THREADS__
+#   ifdef __WIN32__
+#       ifndef _INC_WINDOWS
+#       define WIN32_LEAN_AND_MEAN
+#       include <windows.h>
+#       endif
+#   endif
+#endif
+
+//------------------------------------------------------------------------------
+/**
+    Atomically increment value, return the new value.
+*/
+inline
+long
+n_interlocked_increment(volatile long* val)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    return ++(*val);
+#elif defined(__WIN32__)
+    return InterlockedIncrement(val);
+#else
+    return __sync_add_and_fetch(val, 1);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically decrement value, return the new value.
+*/
+inline
+long
+n_interlocked_decrement(volatile long* val)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    return --(*val);
+#elif defined(__WIN32__)
+    return InterlockedDecrement(val);
+#else
+    return __sync_sub_and_fetch(val, 1);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically add to value, return the new value.
+*/
+inline
+long
+n_interlocked_add(volatile long* val, long add)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    return (*val += add);
+#elif defined(__WIN32__)
+    return InterlockedExchangeAdd(val, add) + add;
+#else
+    return __sync_add_and_fetch(val, add);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically set value, return the previous value.
+*/
+inline
+long
+n_interlocked_exchange(volatile long* val, long newVal)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    long old = *val;
+    *val = newVal;
+    return old;
+#elif defined(__WIN32__)
+    return InterlockedExchange(val, newVal);
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_exchange_n(val, newVal, __ATOMIC_SEQ_CST);
+#else
+    // __sync_lock_test_and_set() is only an acquire barrier
+    __sync_synchronize();
+    return __sync_lock_test_and_set(val, newVal);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically set value to newVal if it currently equals cmpVal. Returns
+    the previous value (the exchange happened if it equals cmpVal).
+*/
+inline
+long
+n_interlocked_compare_exchange(volatile long* val, long newVal, long cmpVal)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    long old = *val;
+    if (old == cmpVal)
+    {
+        *val = newVal;
+    }
+    return old;
+#elif defined(__WIN32__)
+    return InterlockedCompareExchange(val, newVal, cmpVal);
+#else
+    return __sync_val_compare_and_swap(val, cmpVal, newVal);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically set a pointer, return the previous pointer.
+*/
+inline
+void*
+n_interlocked_exchange_pointer(void* volatile* ptr, void* newPtr)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    void* old = *ptr;
+    *ptr = newPtr;
+    return old;
+#elif defined(__WIN32__)
+    return InterlockedExchangePointer((PVOID volatile*) ptr, newPtr);
+#elif defined(__ATOMIC_SEQ_CST)
+    return __atomic_exchange_n(ptr, newPtr, __ATOMIC_SEQ_CST);
+#else
+    __sync_synchronize();
+    return __sync_lock_test_and_set(ptr, newPtr);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Atomically set a pointer to newPtr if it currently equals cmpPtr.
+    Returns the previous pointer.
+*/
+inline
+void*
+n_interlocked_compare_exchange_pointer(void* volatile* ptr, void* newPtr, void* cmpPtr)
+{
+#if defined(__NEBULA_NO_THREADS__)
+    void* old = *ptr;
+    if (old == cmpPtr)
+    {
+        *ptr = newPtr;
+    }
+    return old;
+#elif defined(__WIN32__)
+    return InterlockedCompareExchangePointer((PVOID volatile*) ptr, newPtr, cmpPtr);
+#else
+    return __sync_val_compare_and_swap(ptr, cmpPtr, newPtr);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read value with acquire semantics: reads and writes after it can't be
+    moved before it.
+*/
+inline
+long
+n_interlocked_read(const volatile long* val)
+{
+#if defined(__NEBULA_NO_THREADS__) || defined(__WIN32__)
+    // VC++ gives volatile reads acquire semantics
+    return *val;
+#elif defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(val, __ATOMIC_ACQUIRE);
+#else
+    long result = *val;
+    __sync_synchronize();
+    return result;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read a pointer with acquire semantics, like n_interlocked_read().
+*/
+inline
+void*
+n_interlocked_read_pointer(void* const volatile* ptr)
+{
+#if defined(__NEBULA_NO_THREADS__) || defined(__WIN32__)
+    return *ptr;
+#elif defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else
+    void* result = *ptr;
+    __sync_synchronize();
+    return result;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Full memory barrier, neither the compiler nor the cpu move reads
+    or writes across it.
+*/
+inline
+void
+n_barrier()
+{
+#if defined(__NEBULA_NO_THREADS__)
+    // empty
+#elif defined(__WIN32__)
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+//------------------------------------------------------------------------------
+#endif
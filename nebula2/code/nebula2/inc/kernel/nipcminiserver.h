@@ -14,7 +14,6 @@
 
 //------------------------------------------------------------------------------
 class nIpcServer;
-class nThread;
 class nIpcMiniServer : public nNode
 {
 public:
@@ -22,8 +21,8 @@ public:
     nIpcMiniServer(nIpcServer* server);
     /// destructor
     ~nIpcMiniServer();
-    /// listen on server socket and wait for new client
-    bool Listen();
+    /// take over the socket of a client connection accepted by the server
+    void Accept(SOCKET sock);
     /// ignore the new client for any reason
     void Ignore();
     /// check for and pull incoming messages, call this frequently!
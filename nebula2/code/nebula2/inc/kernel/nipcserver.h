@@ -10,6 +10,10 @@
     waits for connection requests from nIpcClient objects. One
     nIpcServer can handle any number of nIpcClients.
 
+    The server socket is non-blocking, Poll() accepts the connection
+    requests of new clients, so the server doesn't need a listener
+    thread.
+
     (C) 2002 RadonLabs GmbH
 */
 
@@ -20,7 +24,6 @@
 #include "kernel/nipcbuffer.h"
 
 //------------------------------------------------------------------------------
-class nThread;
 class nIpcServer
 {
 public:
@@ -37,8 +40,10 @@ public:
     /// send a message to all clients
     bool SendAll(const nIpcBuffer& msg);
 
+    /// accept the connection requests of new clients, doesn't block
+    void AcceptClients();
+
     nIpcAddress selfAddr;
-    nThread* listenerThread;
     int uniqueMiniServerId;
     nThreadSafeList miniServerList;
     nThreadSafeList msgList;
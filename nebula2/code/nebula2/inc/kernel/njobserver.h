@@ -0,0 +1,329 @@
+#ifndef N_JOBSERVER_H
+#define N_JOBSERVER_H
+//------------------------------------------------------------------------------
+/**
+    @class nJobServer
+    @ingroup Threading
+    @brief Runs fine grained jobs on a set of worker threads.
+
+    A job is a function which is called with a range of indices and a
+    user data pointer. Jobs are submitted with Submit() or created by
+    ParallelFor(), which splits an index range into jobs of at least
+    grainSize indices.
+
+    Every worker thread owns a work stealing deque (Chase-Lev): the owner
+    pushes and pops jobs at the bottom without locking, idle workers
+    steal from the top of other deques. The thread which created the job
+    server (the main thread) owns a deque too, it executes jobs while it
+    waits in Wait() or ParallelFor(). Other threads submit into a shared
+    lock-free queue. Workers without work spin for a moment, then sleep
+    until new jobs are submitted.
+
+    Threads which are not job threads (worker index -1) only execute jobs
+    of the shared queue while they wait, they never steal from the deques.
+    So jobs which use the worker index (like nWorkerPool tasks) only run
+    on job threads.
+
+    Completion is tracked with nJobCounter objects: Submit() increments
+    the counter, finishing the job decrements it, Wait() executes jobs
+    until the counter is zero. A job can also be submitted to run after
+    all jobs of another counter have finished.
+
+    The server is created by the kernel server. By default it starts one
+    worker thread less than there are processors in the system the first
+    time jobs are submitted, use SetNumWorkers() to override this (at most
+    MaxWorkers). With 0 workers (or __NEBULA_NO_THREADS__ defined) jobs are
+    executed right away by the submitting thread. The workers and their
+    deques live in fixed arrays which are never shrunk, the number of
+    workers is published with an interlocked exchange, so other threads
+    may submit jobs while the main thread starts or stops the workers.
+
+    If a deque or the shared queue is full, the job is executed right
+    away by the submitting thread as well.
+
+    Long running jobs which don't belong to a frame (like resource
+    loading) are submitted with SubmitBackground(). Background jobs are
+    only picked up by idle workers, never by a thread which waits in
+    Wait() or ParallelFor(), so they can't stall the frame. Without
+    workers they are executed right away as well. Because of them, the
+    workers get a big stack (2.5 MB).
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "kernel/nthread.h"
+#include "kernel/nevent.h"
+#include "kernel/ninterlocked.h"
+#include "util/narray.h"
+
+class nJobCounter;
+
+//------------------------------------------------------------------------------
+class nJobServer
+{
+public:
+    /// job function prototype, called with the index range [begin, end)
+    typedef void (*JobFunc)(int begin, int end, void* userData);
+
+    enum
+    {
+        MaxWorkers = 63,
+    };
+
+    /// constructor
+    nJobServer();
+    /// destructor
+    ~nJobServer();
+    /// return instance pointer
+    static nJobServer* Instance();
+    /// return number of processors in the system
+    static int GetNumProcessors();
+    /// get worker index of the calling thread (0: main thread, -1: not a job thread)
+    static int GetWorkerIndex();
+    /// set number of worker threads (0 disables threading)
+    void SetNumWorkers(int num);
+    /// get number of worker threads
+    int GetNumWorkers();
+    /// submit a job for the range [begin, end), counter may be 0
+    void Submit(JobFunc func, int begin, int end, void* userData, nJobCounter* counter);
+    /// submit a long running job which is only executed by idle workers
+    void SubmitBackground(JobFunc func, int begin, int end, void* userData, nJobCounter* counter);
+    /// submit a job which runs after all jobs of dependency have finished
+    void SubmitAfter(nJobCounter* dependency, JobFunc func, int begin, int end, void* userData, nJobCounter* counter);
+    /// execute jobs until all jobs of the counter have finished
+    void Wait(nJobCounter* counter);
+    /// call func for the range [begin, end) in parallel, returns when done
+    void ParallelFor(int begin, int end, int grainSize, JobFunc func, void* userData);
+
+private:
+    friend class nJobCounter;
+
+    /// a job
+    struct Job
+    {
+        JobFunc func;
+        void* userData;
+        int begin;
+        int end;
+        nJobCounter* counter;
+    };
+
+    /// a work stealing deque, only the owner pushes and pops
+    class Deque
+    {
+    public:
+        /// constructor
+        Deque();
+        /// destructor
+        ~Deque();
+        /// push job at bottom (owner only), returns false if full
+        bool Push(const Job& job);
+        /// pop job from bottom (owner only)
+        bool Pop(Job& job);
+        /// steal job from top (any thread)
+        bool Steal(Job& job);
+
+    private:
+        enum
+        {
+            Capacity = 4096,
+        };
+        volatile long top;
+        volatile long bottom;
+        Job* jobs;
+    };
+
+    /// a bounded multi producer, multi consumer queue
+    class Queue
+    {
+    public:
+        /// constructor
+        Queue();
+        /// destructor
+        ~Queue();
+        /// add job, returns false if full
+        bool Push(const Job& job);
+        /// remove job
+        bool Pop(Job& job);
+
+    private:
+        enum
+        {
+            Capacity = 4096,
+        };
+        struct Cell
+        {
+            volatile long sequence;
+            Job job;
+        };
+        volatile long pushPos;
+        volatile long popPos;
+        Cell* cells;
+    };
+
+    /// a worker thread
+    struct Worker
+    {
+        nJobServer* server;
+        int workerIndex;
+        volatile long sleeping;
+        nEvent wakeupEvent;
+        nThread* thread;
+    };
+
+    /// the state of a ParallelFor() call
+    struct ParallelForData
+    {
+        JobFunc func;
+        void* userData;
+        int grainSize;
+        nJobCounter* counter;
+    };
+
+    /// start the default number of workers if not configured yet
+    void CheckConfigured();
+    /// start the worker threads
+    void StartWorkers(int num);
+    /// stop all worker threads
+    void StopWorkers();
+    /// add a job to a queue, or execute it if all queues are full
+    void Schedule(const Job& job);
+    /// find a job for the calling thread (own deque, shared queue, stealing)
+    bool FindJob(int workerIndex, Job& job);
+    /// execute a job and finish it
+    void Execute(const Job& job);
+    /// decrement a counter, schedule the dependent jobs if it reaches 0
+    void FinishJob(nJobCounter* counter);
+    /// wake up a sleeping worker
+    void WakeWorker();
+    /// the worker thread function
+    static int N_THREADPROC WorkerThreadFunc(nThread* thread);
+    /// the worker thread wakeup function
+    static void WorkerWakeupFunc(nThread* thread);
+    /// job function which splits a ParallelFor() range
+    static void ParallelForJob(int begin, int end, void* userData);
+
+    static nJobServer* Singleton;
+
+    bool isConfigured;
+    volatile long numWorkers;
+    Worker* workers[MaxWorkers];
+    Deque* deques[MaxWorkers + 1];      // deque 0 belongs to the main thread
+    Queue sharedQueue;
+    Queue backgroundQueue;
+    volatile long numSleeping;
+};
+
+//------------------------------------------------------------------------------
+/**
+    @class nJobCounter
+    @ingroup Threading
+    @brief Counts the unfinished jobs of a group of jobs.
+
+    See nJobServer. A counter must not be destroyed before all its
+    jobs have finished.
+*/
+class nJobCounter
+{
+public:
+    /// constructor
+    nJobCounter();
+    /// destructor
+    ~nJobCounter();
+    /// return true if all jobs have finished
+    bool IsDone() const;
+    /// get number of unfinished jobs
+    int GetCount() const;
+
+private:
+    friend class nJobServer;
+
+    /// lock the dependent job list
+    void Lock();
+    /// unlock the dependent job list
+    void Unlock();
+
+    volatile long count;
+    volatile long numFinishing;     // jobs which are finishing right now
+    volatile long lock;
+    nArray<nJobServer::Job>* dependentJobs;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nJobServer*
+nJobServer::Instance()
+{
+    n_assert(Singleton);
+    return Singleton;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nJobServer::GetNumWorkers()
+{
+    this->CheckConfigured();
+    return int(n_interlocked_read(&this->numWorkers));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nJobCounter::nJobCounter() :
+    count(0),
+    numFinishing(0),
+    lock(0),
+    dependentJobs(0)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nJobCounter::~nJobCounter()
+{
+    n_assert(0 == n_interlocked_read(&this->count));
+    if (this->dependentJobs)
+    {
+        n_assert(this->dependentJobs->Empty());
+        n_delete(this->dependentJobs);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    A counter is done when all jobs have finished, and no finishing job
+    accesses the counter anymore.
+*/
+inline
+bool
+nJobCounter::IsDone() const
+{
+    if (n_interlocked_read(&this->count) > 0)
+    {
+        return false;
+    }
+    n_barrier();
+    return (0 == n_interlocked_read(&this->numFinishing));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nJobCounter::GetCount() const
+{
+    return int(n_interlocked_read(&this->count));
+}
+
+//------------------------------------------------------------------------------
+#endif
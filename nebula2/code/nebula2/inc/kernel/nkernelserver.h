@@ -9,6 +9,10 @@
     Every Nebula2 application needs exactly one kernel server object which
     persists throughout the lifetime of the application.
 
+    Lookup() caches resolved absolute paths. A cache entry is only valid
+    as long as no object has been removed from or renamed in the object
+    hierarchy since it was written (see nRoot::GetNohGeneration()).
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/ntypes.h"
@@ -31,6 +35,10 @@
 class nTimeServer;
 class nPersistServer;
 class nHardRefServer;
+class nProfileServer;
+class nJobServer;
+class nFrameArena;
+class nWorkerPool;
 class nFileServer2;
 class nRemoteServer;
 class nEnv;
@@ -114,6 +122,14 @@ public:
     nRemoteServer* GetRemoteServer() const;
     /// get pointer to time server
     nTimeServer* GetTimeServer() const;
+    /// get pointer to profile server
+    nProfileServer* GetProfileServer() const;
+    /// get pointer to job server
+    nJobServer* GetJobServer() const;
+    /// get pointer to per-frame memory arena
+    nFrameArena* GetFrameArena() const;
+    /// get pointer to worker thread pool
+    nWorkerPool* GetWorkerPool() const;
     /// optionally call to update memory usage variables
     void Trigger();
 
@@ -129,17 +145,34 @@ private:
     /// create a new unnamed Nebula object
     nObject* NewUnnamedObject(const char* className);
 
+    enum
+    {
+        LookupCacheSize = 256,      // number of entries in the path lookup cache
+    };
+    /// an entry of the path lookup cache
+    struct LookupCacheEntry
+    {
+        nString path;
+        nRoot* object;
+        uint nohGeneration;
+    };
+
     nFileServer2*   fileServer;     // private pointer to file server
     nPersistServer* persistServer;  // private pointer to persistency server
     nTimeServer*    timeServer;     // private pointer to timeserver
     nRemoteServer*  remoteServer;   // private pointer to remoteserver
 
     nHardRefServer* hardRefServer;  // private pointer to hardrefserver
+    nProfileServer* profileServer;  // private pointer to profile server
+    nJobServer*     jobServer;      // private pointer to job server
+    nFrameArena*    frameArena;     // private pointer to per-frame memory arena
+    nWorkerPool*    workerPool;     // private pointer to worker thread pool
 
     nHashList classList;            // list of nClass objects
     nRoot* root;                    // the root object of the Nebula object hierarchy
     nRoot* cwd;                     // the current working object
     nStack<nRoot*> cwdStack;        // stack of previous cwd's
+    LookupCacheEntry lookupCache[LookupCacheSize];  // resolved absolute paths
 
     nLogHandler* defaultLogHandler; // the default log handler
     nLogHandler* curLogHandler;     // the current log handler
@@ -147,6 +180,12 @@ private:
     nEnv* varMemHighWaterSize;      // memory statistics
     nEnv* varMemTotalSize;
     nEnv* varMemTotalCount;
+    #ifdef __NEBULA_MEM_MANAGER__
+    nEnv* varMemClassBytes[nMemManagerStats::MaxSizeClasses];      // created on demand
+    nEnv* varMemCacheHitRate[nMemManagerStats::MaxThreadCaches];
+    int memCacheHits[nMemManagerStats::MaxThreadCaches];            // at the last Trigger()
+    int memCacheMisses[nMemManagerStats::MaxThreadCaches];
+    #endif
 
     nMutex mutex;                   // the kernel lock mutex
 
@@ -259,5 +298,45 @@ nKernelServer::GetTimeServer() const
     return this->timeServer;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nProfileServer*
+nKernelServer::GetProfileServer() const
+{
+    return this->profileServer;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nJobServer*
+nKernelServer::GetJobServer() const
+{
+    return this->jobServer;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nFrameArena*
+nKernelServer::GetFrameArena() const
+{
+    return this->frameArena;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nWorkerPool*
+nKernelServer::GetWorkerPool() const
+{
+    return this->workerPool;
+}
+
 //--------------------------------------------------------------------
 #endif
@@ -6,12 +6,16 @@
     @ingroup Time
     @brief nProfiler provides an easy way to measure time intervals.
 
+    A nProfiler object is a named zone of the nProfileServer. The zone's
+    time in the last frame (summed over all Start()/Stop() pairs of the
+    frame) is written to the watcher variable /sys/var/[name] in
+    milliseconds by the profile server.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/nkernelserver.h"
-#include "kernel/nref.h"
-#include "kernel/nenv.h"
 #include "kernel/ntimeserver.h"
+#include "kernel/nprofileserver.h"
 
 //------------------------------------------------------------------------------
 class nProfiler
@@ -31,22 +35,20 @@ public:
     void Start();
     /// return true if profiler has been started
     bool IsStarted() const;
-    /// stop one-shot profiling, value is written to watcher variable
+    /// stop one-shot profiling
     void Stop();
-    /// reset the accumulator
+    /// reset the accumulator (obsolete, times are accumulated per frame)
     void ResetAccum();
     /// start accumulated profiling
     void StartAccum();
     /// stop accumulated profiling
     void StopAccum();
-    /// get the measured time
+    /// get the measured time of the last frame in milliseconds
     float GetTime();
 
 private:
-    nRef<nEnv> refEnv;
-    nTime startTime;
+    int zoneIndex;
     bool isStarted;
-    nTime accumTime;
 };
 
 #if __NEBULA_STATS__
@@ -57,6 +59,7 @@ private:
 #define PROFILER_RESET(prof) prof.ResetAccum();
 #define PROFILER_STARTACCUM(prof) prof.StartAccum();
 #define PROFILER_STOPACCUM(prof)  prof.StopAccum();
+#define PROFILER_SCOPE(name) static int profZone__ = nProfileServer::Instance()->RegisterZone(name); nProfileScope profScope__(profZone__);
 #else
 #define PROFILER_DECLARE(prof)
 #define PROFILER_INIT(prof,name)
@@ -65,25 +68,20 @@ private:
 #define PROFILER_RESET(prof)
 #define PROFILER_STARTACCUM(prof)
 #define PROFILER_STOPACCUM(prof)
+#define PROFILER_SCOPE(name)
 #endif
 //------------------------------------------------------------------------------
 /**
+    Registers the zone with the profile server, objects with the same
+    name share a zone.
 */
 inline
 void
 nProfiler::Initialize(const char* name)
 {
     n_assert(name);
-    char buf[N_MAXPATH];
-    snprintf(buf, sizeof(buf), "/sys/var/%s", name);
-    this->refEnv = (nEnv*)nKernelServer::Instance()->Lookup(buf);
-    if (!this->refEnv.isvalid())
-    {
-        this->refEnv = (nEnv*)nKernelServer::Instance()->New("nenv", buf);
-    }
-    this->startTime = 0.0;
+    this->zoneIndex = nProfileServer::Instance()->RegisterZone(name);
     this->isStarted = false;
-    this->accumTime = 0.0;
 }
 
 //------------------------------------------------------------------------------
@@ -91,9 +89,8 @@ nProfiler::Initialize(const char* name)
 */
 inline
 nProfiler::nProfiler() :
-    startTime(0.0),
-    isStarted(false),
-    accumTime(0.0)
+    zoneIndex(-1),
+    isStarted(false)
 {
     // empty
 }
@@ -123,7 +120,7 @@ inline
 bool
 nProfiler::IsValid() const
 {
-    return this->refEnv.isvalid();
+    return (-1 != this->zoneIndex);
 }
 
 //------------------------------------------------------------------------------
@@ -147,8 +144,11 @@ nProfiler::Start()
     {
         this->Stop();
     }
-    this->startTime = nTimeServer::Instance()->GetTime();
-    this->isStarted = true;
+    if (this->IsValid())
+    {
+        nProfileServer::Instance()->BeginZone(this->zoneIndex);
+        this->isStarted = true;
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -160,9 +160,7 @@ nProfiler::Stop()
 {
     if (this->isStarted)
     {
-        nTime stop = nTimeServer::Instance()->GetTime();
-        nTime diff = stop - this->startTime;
-        this->refEnv->SetF(float(diff) * 1000.0f);
+        nProfileServer::Instance()->EndZone(this->zoneIndex);
         this->isStarted = false;
     }
 }
@@ -174,7 +172,7 @@ inline
 void
 nProfiler::ResetAccum()
 {
-    this->accumTime = 0.0;
+    // empty
 }
 
 //------------------------------------------------------------------------------
@@ -195,11 +193,7 @@ void
 nProfiler::StopAccum()
 {
     n_assert(this->isStarted);
-    nTime stop = nTimeServer::Instance()->GetTime();
-    nTime diff = stop - this->startTime;
-    this->accumTime += diff;
-    this->refEnv->SetF(float(this->accumTime) * 1000.0f);
-    this->isStarted = false;
+    this->Stop();
 }
 
 //------------------------------------------------------------------------------
@@ -209,7 +203,11 @@ inline
 float
 nProfiler::GetTime()
 {
-    return this->refEnv->GetF();
+    if (this->IsValid())
+    {
+        return nProfileServer::Instance()->GetZoneTime(this->zoneIndex);
+    }
+    return 0.0f;
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,431 @@
+#ifndef N_PROFILESERVER_H
+#define N_PROFILESERVER_H
+//------------------------------------------------------------------------------
+/**
+    @class nProfileServer
+    @ingroup Time
+    @brief Collects hierarchical, per-thread profiling zones.
+
+    A profiling zone is registered once by name with RegisterZone(), which
+    returns a zone index. BeginZone() and EndZone() record a CPU time stamp
+    counter value into a ring buffer which belongs to the calling thread,
+    so recording is lock-free and doesn't touch shared data. Zones may be
+    nested, and may be used by any number of threads.
+
+    NextFrame() must be called once per frame by the main thread (this is
+    done by nTimeServer::Trigger(), which the application's frame loop
+    calls once per frame). It drains the thread buffers,
+    restores the zone nesting and computes per zone and frame:
+
+    - the inclusive time (including nested zones)
+    - the exclusive time (without nested zones)
+    - the number of calls
+    - the parent zone (the zone in which it was first seen nested)
+
+    The times of a zone are summed over all threads, and are kept for the
+    last HistorySize frames. The inclusive time in milliseconds is also
+    written to a nEnv variable under /sys/var/ with the zone's name, so the
+    zones show up in the watcher window like the old nProfiler variables.
+
+    A thread's buffer is released when the thread exits (nThread calls
+    ThreadExit()). The next NextFrame() reads its remaining events and
+    frees the buffer memory, the slot is reused by the next new thread.
+
+    BeginCapture() records all zone events of the next frames and writes
+    them to a file in the Chrome trace event format, which can be opened
+    with chrome://tracing.
+
+    nProfiler objects and the PROFILER_* macros are mapped onto the
+    profile server, PROFILER_SCOPE() profiles the rest of a C++ scope.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "kernel/nref.h"
+#include "kernel/nenv.h"
+#include "util/nstring.h"
+#include "util/narray.h"
+#include "util/nstrhashmap.h"
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1400) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define N_PROFILE_RDTSC_INTRINSIC
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define N_PROFILE_RDTSC_ASM
+#else
+// high resolution system timer, implemented in nprofileserver.cc
+uint64 n_profilesystemticks();
+#endif
+
+//------------------------------------------------------------------------------
+class nProfileServer
+{
+public:
+    enum
+    {
+        MaxZones = 1024,            // max number of zones
+        MaxThreads = 64,            // max number of profiled threads
+        HistorySize = 64,           // number of frames kept per zone
+    };
+
+    /// constructor
+    nProfileServer();
+    /// destructor
+    ~nProfileServer();
+    /// return instance pointer
+    static nProfileServer* Instance();
+    /// read the time stamp counter
+    static uint64 GetTicks();
+    /// find or register a zone by name, returns the zone index
+    int RegisterZone(const char* name);
+    /// begin a zone on the calling thread
+    void BeginZone(int zoneIndex);
+    /// end a zone on the calling thread
+    void EndZone(int zoneIndex);
+    /// set the name of the calling thread for trace captures
+    void SetThreadName(const char* name);
+    /// release the buffer of the calling thread, called when a thread exits
+    static void ThreadExit();
+    /// finish the current frame, must be called by the main thread
+    void NextFrame();
+    /// capture the next numFrames frames into a Chrome trace file
+    bool BeginCapture(const char* filename, int numFrames);
+    /// return true while a capture is in progress
+    bool IsCapturing() const;
+    /// get the time stamp counter frequency
+    double GetTicksPerSecond() const;
+    /// get number of finished frames
+    int GetFrameCount() const;
+    /// get number of zones
+    int GetNumZones() const;
+    /// get the name of a zone
+    const char* GetZoneName(int zoneIndex) const;
+    /// get the parent zone index, -1 for top level zones
+    int GetZoneParent(int zoneIndex) const;
+    /// get inclusive time of a zone in the last frame in milliseconds
+    float GetZoneTime(int zoneIndex) const;
+    /// get exclusive time of a zone in the last frame in milliseconds
+    float GetZoneSelfTime(int zoneIndex) const;
+    /// get number of calls of a zone in the last frame
+    int GetZoneCount(int zoneIndex) const;
+    /// get inclusive time of a zone in an older frame (0 is the last frame)
+    float GetZoneHistory(int zoneIndex, int framesAgo) const;
+    /// get number of events dropped because a thread buffer was full
+    int GetNumDroppedEvents() const;
+
+private:
+    enum
+    {
+        BufferSize = 16384,         // events per thread buffer, power of 2
+        MaxDepth = 64,              // max zone nesting depth
+    };
+    enum EventType
+    {
+        Begin,
+        End,
+        Frame,
+    };
+    enum BufferState
+    {
+        Active,                 // owned by a thread
+        Exited,                 // the thread has exited, NextFrame() frees the events
+        Free,                   // may be reused by a new thread
+    };
+
+    /// a recorded zone event
+    struct Event
+    {
+        uint64 ticks;
+        int zoneIndex;
+        int type;
+    };
+    /// a captured event
+    struct CaptureEvent
+    {
+        uint64 ticks;
+        int zoneIndex;          // frame number for Frame events
+        short threadIndex;
+        short type;
+    };
+    /// an open zone while reading the events of a thread
+    struct StackEntry
+    {
+        int zoneIndex;
+        uint64 startTicks;
+        uint64 childTicks;
+        bool captured;
+    };
+    /// the event ring buffer of a thread
+    struct ThreadBuffer
+    {
+        volatile long state;        // BufferState
+        Event* events;
+        volatile long writePos;     // written by the thread
+        volatile long readPos;      // written by NextFrame()
+        int numDropped;
+        nString name;
+        // only used by NextFrame()
+        StackEntry stack[MaxDepth];
+        int depth;
+    };
+    /// a zone
+    struct Zone
+    {
+        nString name;
+        int parentIndex;            // -2 until the zone was seen
+        nRef<nEnv> refEnv;
+        uint64 frameTicks;
+        uint64 frameSelfTicks;
+        int frameCount;
+        float time;
+        float selfTime;
+        int count;
+        float history[HistorySize];
+    };
+
+    /// record an event for the calling thread
+    void AddEvent(int zoneIndex, int type);
+    /// get the buffer of the calling thread, registers the thread if necessary
+    ThreadBuffer* GetThreadBuffer();
+    /// update the time stamp counter frequency
+    void Calibrate(uint64 ticks);
+    /// process the new events of a thread
+    void ReadEvents(int threadIndex);
+    /// free the events of an exited thread
+    void FreeThreadBuffer(int threadIndex, uint64 ticks);
+    /// finish the frame statistics of the zones
+    void PublishZones();
+    /// add a captured event
+    void AddCaptureEvent(uint64 ticks, int zoneIndex, int threadIndex, int type);
+    /// end the capture and write the trace file
+    void EndCapture(uint64 ticks);
+    /// lock zone and thread registration
+    void Lock();
+    /// unlock zone and thread registration
+    void Unlock();
+
+    static nProfileServer* Singleton;
+
+    volatile long lock;
+    Zone* zones[MaxZones];
+    volatile long numZones;
+    nStrHashMap<int> zoneIndexMap;
+    ThreadBuffer* threads[MaxThreads];
+    volatile long numThreads;
+
+    uint64 calibStartTicks;
+    double calibStartTime;
+    double ticksPerSecond;
+    int frameCount;
+
+    bool captureRequested;
+    bool isCapturing;
+    nString captureFileName;
+    int captureFramesLeft;
+    uint64 captureStartTicks;
+    nArray<CaptureEvent> captureEvents;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nProfileServer*
+nProfileServer::Instance()
+{
+    n_assert(Singleton);
+    return Singleton;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the CPU time stamp counter where it can be read directly,
+    a high resolution system timer otherwise.
+*/
+inline
+uint64
+nProfileServer::GetTicks()
+{
+#if defined(N_PROFILE_RDTSC_INTRINSIC)
+    return __rdtsc();
+#elif defined(N_PROFILE_RDTSC_ASM)
+    uint lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (uint64(hi) << 32) | lo;
+#else
+    return n_profilesystemticks();
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nProfileServer::BeginZone(int zoneIndex)
+{
+    this->AddEvent(zoneIndex, Begin);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nProfileServer::EndZone(int zoneIndex)
+{
+    this->AddEvent(zoneIndex, End);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nProfileServer::IsCapturing() const
+{
+    return this->captureRequested || this->isCapturing;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+double
+nProfileServer::GetTicksPerSecond() const
+{
+    return this->ticksPerSecond;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nProfileServer::GetFrameCount() const
+{
+    return this->frameCount;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nProfileServer::GetNumZones() const
+{
+    return this->numZones;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const char*
+nProfileServer::GetZoneName(int zoneIndex) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    return this->zones[zoneIndex]->name.Get();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nProfileServer::GetZoneParent(int zoneIndex) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    int parentIndex = this->zones[zoneIndex]->parentIndex;
+    return (parentIndex >= 0) ? parentIndex : -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float
+nProfileServer::GetZoneTime(int zoneIndex) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    return this->zones[zoneIndex]->time;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float
+nProfileServer::GetZoneSelfTime(int zoneIndex) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    return this->zones[zoneIndex]->selfTime;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nProfileServer::GetZoneCount(int zoneIndex) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    return this->zones[zoneIndex]->count;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float
+nProfileServer::GetZoneHistory(int zoneIndex, int framesAgo) const
+{
+    n_assert((zoneIndex >= 0) && (zoneIndex < this->numZones));
+    n_assert((framesAgo >= 0) && (framesAgo < HistorySize));
+    int frame = this->frameCount - 1 - framesAgo;
+    if (frame < 0)
+    {
+        return 0.0f;
+    }
+    return this->zones[zoneIndex]->history[frame % HistorySize];
+}
+
+//------------------------------------------------------------------------------
+/**
+    @class nProfileScope
+    @ingroup Time
+    @brief Profiles a zone until the end of the C++ scope.
+*/
+class nProfileScope
+{
+public:
+    /// constructor, begins the zone
+    nProfileScope(int zoneIndex);
+    /// destructor, ends the zone
+    ~nProfileScope();
+
+private:
+    int zoneIndex;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nProfileScope::nProfileScope(int index) :
+    zoneIndex(index)
+{
+    nProfileServer::Instance()->BeginZone(this->zoneIndex);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nProfileScope::~nProfileScope()
+{
+    nProfileServer::Instance()->EndZone(this->zoneIndex);
+}
+
+//------------------------------------------------------------------------------
+#endif
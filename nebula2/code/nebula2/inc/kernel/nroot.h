@@ -31,6 +31,13 @@
 
     -Floh.
 
+    Objects with many children (resource pools, big scene trees) get a
+    name index (nRootChildIndex) when Find() is first called on them
+    with at least ChildIndexThreshold children. The index is kept in
+    sync by AddHead(), AddTail(), RemHead(), RemTail(), Remove() and
+    SetName(), so small objects still pay only for a name hash, a child
+    counter and a pointer.
+
     See also @ref N2ScriptInterface_nroot
 
     (C) 1999 RadonLabs GmbH
@@ -39,6 +46,8 @@
 #include "util/nstring.h"
 #include "util/nnode.h"
 #include "kernel/nobject.h"
+#include "kernel/nrootchildindex.h"
+#include "kernel/ninterlocked.h"
 
 //------------------------------------------------------------------------------
 class nRoot : public nObject, public nNode
@@ -70,6 +79,8 @@ public:
     void SetName(const char* str);
     /// get my name
     const char* GetName() const;
+    /// get hash of my name
+    uint GetNameHash() const;
     /// get full path name of object
     nString GetFullName() const;
     /// get relative path name to other object
@@ -101,6 +112,10 @@ public:
     nRoot* GetSucc() const;
     /// get previous sibling
     nRoot* GetPred() const;
+    /// get number of children
+    int GetNumChildren() const;
+    /// get the hierarchy generation, changes whenever a linked object is unlinked or renamed
+    static uint GetNohGeneration();
 
     /// set save mode flags
     void SetSaveModeFlags(int);
@@ -117,13 +132,28 @@ protected:
 
     /// destructor (DONT CALL DIRECTLY, USE Release() INSTEAD)
     virtual ~nRoot();
+    /// create the child name index
+    void BuildChildIndex();
+
+    enum
+    {
+        ChildIndexThreshold = 32,   // number of children at which Find() builds a child index
+    };
 
     // nAtom nameAtom;
     nString name;
+    uint nameHash;
     nRoot* parent;
     nList childList;
+    int numChildren;
+    nRootChildIndex* childIndex;
     ushort saveModeFlags;
     nMutex mutex;
+
+    /// invalidate cached hierarchy paths (see GetNohGeneration())
+    static void BumpNohGeneration();
+
+    static volatile long nohGeneration;
 };
 
 //------------------------------------------------------------------------------
@@ -133,7 +163,23 @@ inline
 void
 nRoot::SetName(const char* str)
 {
+    // re-key the parent's child index
+    nRootChildIndex* parentIndex = this->parent ? this->parent->childIndex : 0;
+    if (parentIndex)
+    {
+        parentIndex->Remove(this);
+    }
     this->name = str;
+    this->nameHash = nRootChildIndex::HashName(this->name.Get());
+    if (parentIndex)
+    {
+        parentIndex->Add(this);
+    }
+    // unlinked objects (e.g. freshly created ones) can't be in any lookup path
+    if (this->parent)
+    {
+        BumpNohGeneration();
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -146,6 +192,16 @@ nRoot::GetName() const
     return this->name.Get();
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+uint
+nRoot::GetNameHash() const
+{
+    return this->nameHash;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -196,6 +252,38 @@ nRoot::GetPred() const
     return (nRoot*)nNode::GetPred();
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nRoot::GetNumChildren() const
+{
+    return this->numChildren;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+uint
+nRoot::GetNohGeneration()
+{
+    return (uint) nohGeneration;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Objects may be renamed or released from several threads, so the
+    counter is bumped with an interlocked increment.
+*/
+inline
+void
+nRoot::BumpNohGeneration()
+{
+    n_interlocked_increment(&nohGeneration);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -205,6 +293,11 @@ nRoot::AddHead(nRoot* n)
 {
     n->parent = this;
     this->childList.AddHead(n);
+    this->numChildren++;
+    if (this->childIndex)
+    {
+        this->childIndex->Add(n);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -216,6 +309,11 @@ nRoot::AddTail(nRoot* n)
 {
     n->parent = this;
     this->childList.AddTail(n);
+    this->numChildren++;
+    if (this->childIndex)
+    {
+        this->childIndex->Add(n);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -228,7 +326,13 @@ nRoot::RemHead()
     nRoot* n = (nRoot*)this->childList.RemHead();
     if (n)
     {
+        this->numChildren--;
+        if (this->childIndex)
+        {
+            this->childIndex->Remove(n);
+        }
         n->parent = 0;
+        BumpNohGeneration();
     }
     return n;
 }
@@ -243,7 +347,13 @@ nRoot::RemTail()
     nRoot* n = (nRoot*)this->childList.RemTail();
     if (n)
     {
+        this->numChildren--;
+        if (this->childIndex)
+        {
+            this->childIndex->Remove(n);
+        }
         n->parent = 0;
+        BumpNohGeneration();
     }
     return n;
 }
@@ -255,6 +365,15 @@ inline
 void
 nRoot::Remove()
 {
+    if (this->parent)
+    {
+        this->parent->numChildren--;
+        if (this->parent->childIndex)
+        {
+            this->parent->childIndex->Remove(this);
+        }
+        BumpNohGeneration();
+    }
     nNode::Remove();
     this->parent = 0;
 }
@@ -283,6 +402,16 @@ nRoot::Find(const char* str)
         }
     }
 
+    // use the child index on objects with many children
+    if ((0 == this->childIndex) && (this->numChildren >= ChildIndexThreshold))
+    {
+        this->BuildChildIndex();
+    }
+    if (this->childIndex)
+    {
+        return this->childIndex->Find(str, nRootChildIndex::HashName(str));
+    }
+
     // find child with string compare
     nRoot* child;
     for (child = this->GetHead(); child; child = child->GetSucc())
@@ -0,0 +1,89 @@
+#ifndef N_ROOTCHILDINDEX_H
+#define N_ROOTCHILDINDEX_H
+//------------------------------------------------------------------------------
+/**
+    @class nRootChildIndex
+    @ingroup Kernel
+
+    @brief Name index over the children of a nRoot object.
+
+    An open addressing hash table (linear probing) which maps the child
+    names of a nRoot object to the child objects. nRoot creates the index
+    lazily once a Find() happens on an object with many children, and
+    keeps it in sync when children are added, removed or renamed.
+
+    Every slot stores the name hash of the child, so that probing only
+    touches the child object on a hash match.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+class nRoot;
+
+//------------------------------------------------------------------------------
+class nRootChildIndex
+{
+public:
+    /// constructor
+    nRootChildIndex();
+    /// destructor
+    ~nRootChildIndex();
+    /// compute the hash of an object name
+    static uint HashName(const char* name);
+    /// add a child object
+    void Add(nRoot* child);
+    /// remove a child object
+    void Remove(nRoot* child);
+    /// find a child object by name and name hash
+    nRoot* Find(const char* name, uint hash) const;
+    /// get number of child objects in the index
+    int GetNumEntries() const;
+
+private:
+    /// a hash table slot
+    struct Slot
+    {
+        uint hash;
+        nRoot* object;      ///< 0 if empty, Deleted if the entry has been removed
+    };
+
+    /// rehash into a table with the given capacity
+    void Rehash(int newCapacity);
+
+    Slot* slots;
+    int capacity;           ///< always a power of 2
+    int numEntries;
+    int numDeleted;
+};
+
+//------------------------------------------------------------------------------
+/**
+    FNV-1a hash of a 0-terminated string.
+*/
+inline
+uint
+nRootChildIndex::HashName(const char* name)
+{
+    n_assert(name);
+    uint hash = 2166136261u;
+    const uchar* ptr = (const uchar*) name;
+    while (*ptr)
+    {
+        hash = (hash ^ *ptr++) * 16777619u;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nRootChildIndex::GetNumEntries() const
+{
+    return this->numEntries;
+}
+
+//------------------------------------------------------------------------------
+#endif
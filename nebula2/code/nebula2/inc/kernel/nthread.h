@@ -74,7 +74,7 @@ private:
     nEvent shutdownSleepEvent;
     nEvent shutdownEvent;
     nEvent startupEvent;
-    bool stopThread;
+    volatile long stopThread;
     bool shutdownSignalReceived;
     int (N_THREADPROC *threadFunc)(nThread*);
     void (*wakeupFunc)(nThread*);
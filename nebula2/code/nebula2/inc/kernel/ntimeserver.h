@@ -38,7 +38,7 @@ public:
     virtual ~nTimeServer();
     /// get instance pointer
     static nTimeServer* Instance();
-    /// trigger time server
+    /// trigger time server, call once per frame from the main thread
     void Trigger();
     /// reset time to 0
     void ResetTime();
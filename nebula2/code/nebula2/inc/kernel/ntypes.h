@@ -21,6 +21,13 @@ typedef unsigned long  ulong;
 typedef unsigned int   uint;
 typedef unsigned short ushort;
 typedef unsigned char  uchar;
+#ifdef _MSC_VER
+typedef __int64 int64;
+typedef unsigned __int64 uint64;
+#else
+typedef long long int64;
+typedef unsigned long long uint64;
+#endif
 typedef float float2[2];
 typedef float float3[3];
 typedef float float4[4];
@@ -150,6 +157,34 @@ int n_dbgmemdumpleaks();
 void n_dbgmeminit();                // initialize memory debugging system
 nMemoryStats n_dbgmemgetstats();    // defined in ndbgalloc.cc
 
+// defined in nmemory.cc
+void* nn_malloc(size_t size, const char* file, int line);
+void* nn_calloc(size_t num, size_t size, const char* file, int line);
+void* nn_realloc(void* memblock, size_t size, const char* file, int line);
+void nn_free(void* memblock);
+
+#ifdef __NEBULA_MEM_MANAGER__
+struct nMemManagerStats
+{
+    enum
+    {
+        MaxSizeClasses = 33,        // small block size classes + large blocks
+        MaxThreadCaches = 64,
+    };
+    int totalSize;                          // current allocated size (block sizes)
+    int totalCount;                         // current number of allocations
+    int numAllocs;                          // number of allocations since startup
+    int numSizeClasses;                     // last class holds the large blocks
+    int classSize[MaxSizeClasses];          // block size of a class (0 for large blocks)
+    int classBytes[MaxSizeClasses];         // allocated bytes in a class
+    int numThreadCaches;
+    int cacheHits[MaxThreadCaches];         // allocations served by the thread's free list
+    int cacheMisses[MaxThreadCaches];       // allocations which needed a refill
+};
+void n_memgetstats(nMemManagerStats& stats);
+void n_memthreadexit();             // release the calling thread's cache
+#endif
+
 #ifdef new
 #undef new
 #endif
@@ -196,6 +231,18 @@ void n_free_dbg(void* memblock, const char* file, int line);
 #define n_free(memblock) free(memblock)
 #endif
 
+#ifdef __NEBULA_MEM_MANAGER__
+// n_malloc() and friends use the thread caching allocator in nmemory.cc
+#undef n_malloc
+#undef n_calloc
+#undef n_realloc
+#undef n_free
+#define n_malloc(size) nn_malloc(size, __FILE__, __LINE__)
+#define n_calloc(num, size) nn_calloc(num, size, __FILE__, __LINE__)
+#define n_realloc(memblock, size) nn_realloc(memblock, size, __FILE__, __LINE__)
+#define n_free(memblock) nn_free(memblock)
+#endif
+
 // define an nAttribute C++ class extension, declares
 // a function member, setter and getter method for the attribute
 // #define __ref_attr(TYPE,NAME) private: TYPE NAME; public: void Set##NAME(const TYPE& t) {this->NAME = t; }; const TYPE& Get##NAME() const { return this->NAME; };
@@ -0,0 +1,134 @@
+#ifndef N_WORKERPOOL_H
+#define N_WORKERPOOL_H
+//------------------------------------------------------------------------------
+/**
+    @class nWorkerPool
+    @ingroup Threading
+    @brief Executes data parallel tasks on the threads of the nJobServer.
+
+    Run() splits a piece of work into numTasks independent tasks and
+    calls the task function once for every task index. The tasks are
+    executed as nJobServer::ParallelFor() jobs, Run() returns after all
+    tasks have been completed. The worker index passed to the task
+    function is the job server's worker index of the executing thread,
+    it is in the range [0, GetNumThreads()) and can be used to index
+    per-thread scratch data (the main thread always has the worker
+    index 0). Run() must be called by the main thread.
+
+    The worker threads are owned by the job server, SetNumWorkers() and
+    GetNumWorkers() are forwarded to it.
+
+    Run() is not reentrant, task functions must not call Run() themselves.
+    Task functions must not wait for other jobs either, the waiting
+    thread could execute another task with the same worker index.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "kernel/njobserver.h"
+
+//------------------------------------------------------------------------------
+class nWorkerPool
+{
+public:
+    /// task function prototype
+    typedef void (*TaskFunc)(int taskIndex, int workerIndex, void* userData);
+
+    /// constructor
+    nWorkerPool();
+    /// destructor
+    ~nWorkerPool();
+    /// return instance pointer
+    static nWorkerPool* Instance();
+    /// return number of processors in the system
+    static int GetNumProcessors();
+    /// set number of background worker threads (0 disables threading)
+    void SetNumWorkers(int num);
+    /// get number of background worker threads
+    int GetNumWorkers();
+    /// get number of threads which may execute tasks (workers + calling thread)
+    int GetNumThreads();
+    /// execute numTasks tasks in parallel, returns when all tasks are done
+    void Run(int numTasks, TaskFunc func, void* userData);
+    /// return true while inside Run()
+    bool IsRunning() const;
+
+private:
+    /// the ParallelFor() job function
+    static void RunJob(int begin, int end, void* userData);
+
+    static nWorkerPool* Singleton;
+
+    bool isRunning;
+
+    // the current job
+    TaskFunc taskFunc;
+    void* taskUserData;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nWorkerPool*
+nWorkerPool::Instance()
+{
+    n_assert(Singleton);
+    return Singleton;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nWorkerPool::GetNumWorkers()
+{
+    return nJobServer::Instance()->GetNumWorkers();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nWorkerPool::GetNumThreads()
+{
+    return nJobServer::Instance()->GetNumWorkers() + 1;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nWorkerPool::IsRunning() const
+{
+    return this->isRunning;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nWorkerPool::GetNumProcessors()
+{
+    return nJobServer::GetNumProcessors();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the number of background worker threads of the job server. Must
+    not be called from inside Run().
+*/
+inline
+void
+nWorkerPool::SetNumWorkers(int num)
+{
+    n_assert(!this->isRunning);
+    nJobServer::Instance()->SetNumWorkers(num);
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -11,14 +11,27 @@
 
     -04-Dec-06  kims  Changed that particles can be emitted on a surface.
 
+    The particles are kept in an nParticle2Pool (structure of arrays) and
+    updated with an SSE kernel, 4 particles at a time. The scalar kernel
+    can be selected with nParticleServer2::SetUseSimd(false) for
+    validation, both kernels produce identical results.
+
+    Update() may be called on a worker thread (see nParticleServer2::Trigger()),
+    as long as the emitter mesh has been locked beforehand with
+    SetEmitterMeshBuffers(). Random numbers for emission come from a
+    per-emitter generator, so the results don't depend on the order in
+    which emitters are updated.
+
 
     (C) 2003 RadonLabs GmbH
 */
 #include "particle/nparticleserver2.h"
 #include "particle/nparticle2.h"
+#include "particle/nparticle2pool.h"
 #include "gfx2/nmesh2.h"
 #include "gfx2/ndynamicmesh.h"
 #include "mathlib/bbox.h"
+#include "util/nrandom.h"
 
 class nParticleServer2;
 
@@ -104,6 +117,8 @@ public:
     void SetEmitterMesh(nMesh2*);
     /// get mesh that emits
     nMesh2* GetEmitterMesh() const;
+    /// set pointers into the locked emitter mesh, Update() won't lock the mesh itself then
+    void SetEmitterMeshBuffers(float* vertices, ushort* indices);
     /// set emitter mesh group index
     void SetEmitterMeshGroupIndex(int index);
     /// get emitter mesh group index
@@ -111,6 +126,8 @@ public:
 
     /// get current particle count
     int GetParticleCount() const;
+    /// get the particle pool, only the first GetParticleCount() particles are alive
+    const nParticle2Pool& GetParticlePool() const;
 
     /// set bounding box
     void SetBoundingBox(const bbox3& b);
@@ -130,6 +147,10 @@ public:
     void SetIsSetup(bool b);
     /// return if emitter is set up
     bool IsSetup() const;
+    /// return true if the emitter has gone to sleep (invisible for too long)
+    bool IsSleeping() const;
+    /// set seed of the emitter's random number generator
+    void SetRandomSeed(uint seed);
 
     /// set pointer to parameter curves (identical for all instances of a particle system)
     void SetStaticCurvePtr(float* ptr);
@@ -176,6 +197,9 @@ protected:
     nDynamicMesh particleMesh;
     nRef<nMesh2> refEmitterMesh;
     int emitterMeshGroupIndex;
+    float* emitterVertices;
+    ushort* emitterIndices;
+    nRandom random;
     matrix44 transform;
     bbox3 box;
     nFloat4 wind;
@@ -210,7 +234,7 @@ protected:
     float particleRotationRandomize;
     float particleSizeRandomize;
 
-    nParticle2* particles;
+    nParticle2Pool particles;
     int particleCount;
     int maxParticleCount;
 
@@ -219,11 +243,20 @@ protected:
     bool isValid;
     bool isSetup;
 
+    /// update particles
+    void CalculateStep(float fdTime);
+    /// update particles one by one
+    void CalculateStepScalar(float stepTime);
+    #ifdef __NEBULA_PARTICLE_SSE__
+    /// update particles 4 at a time
+    void CalculateStepSSE(float stepTime);
+    #endif
+    /// compute the cached curve values of a range of particles
+    void SampleParticleCurves(int first, int num);
+
 private:
     /// not implemented operator to prevent '=' - assignment
     nParticle2Emitter& operator=(const nParticle2Emitter &);
-    /// update particles
-    void CalculateStep(float fdTime);
     /// render as "normal" particles
     int RenderPure(float* dstVertices, int maxVertices);
     /// render as stretched particles
@@ -308,6 +341,20 @@ nParticle2Emitter::GetEmitterMesh() const
     return this->refEmitterMesh.get();
 }
 
+//------------------------------------------------------------------------------
+/**
+    Used by the particle server to lock every emitter mesh only once before
+    updating the emitters in parallel. Set both pointers to 0 after
+    unlocking the mesh.
+*/
+inline
+void
+nParticle2Emitter::SetEmitterMeshBuffers(float* vertices, ushort* indices)
+{
+    this->emitterVertices = vertices;
+    this->emitterIndices = indices;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -359,6 +406,16 @@ nParticle2Emitter::GetParticleCount() const
     return this->particleCount;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const nParticle2Pool&
+nParticle2Emitter::GetParticlePool() const
+{
+    return this->particles;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -479,6 +536,26 @@ nParticle2Emitter::IsSetup() const
     return this->isSetup;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nParticle2Emitter::IsSleeping() const
+{
+    return this->isSleeping;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nParticle2Emitter::SetRandomSeed(uint seed)
+{
+    this->random.SetSeed(seed);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -0,0 +1,145 @@
+#ifndef N_PARTICLE2POOL_H
+#define N_PARTICLE2POOL_H
+//------------------------------------------------------------------------------
+/**
+    @class nParticle2Pool
+    @ingroup Particle
+
+    @brief Structure-of-arrays storage for the particles of one
+    nParticle2Emitter.
+
+    Every particle attribute lives in its own float stream, all streams are
+    16 byte aligned and the capacity is always a multiple of 4, so that the
+    emitter can update 4 particles at once with SSE instructions. Particles
+    are written through an nParticle2 struct with Set(), the update and
+    render code works on the raw streams. The pool doesn't track the
+    number of live particles, this is up to the owner.
+
+    The Scale, Alpha, Color and VelocityFactor streams are not part of
+    nParticle2, they cache the curve values of the particle's current age
+    for the vertex writers and are filled by the emitter.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "particle/nparticle2.h"
+
+// SSE2 particle update kernel available?
+#if !defined(__NEBULA_NO_SSE__) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define __NEBULA_PARTICLE_SSE__ (1)
+#endif
+
+//------------------------------------------------------------------------------
+class nParticle2Pool
+{
+public:
+    /// the particle attribute streams
+    enum Stream
+    {
+        PosX = 0,
+        PosY,
+        PosZ,
+        VelX,
+        VelY,
+        VelZ,
+        AccX,
+        AccY,
+        AccZ,
+        StartX,
+        StartY,
+        StartZ,
+        Rotation,
+        RotationVariation,
+        SizeVariation,
+        LifeTime,
+        OneDivMaxLifeTime,
+        UvMinX,
+        UvMinY,
+        UvMaxX,
+        UvMaxY,
+        Scale,
+        Alpha,
+        Color,
+        VelocityFactor,
+
+        NumStreams,
+    };
+
+    /// constructor
+    nParticle2Pool();
+    /// destructor
+    ~nParticle2Pool();
+    /// allocate streams for at least num particles, deletes existing particles
+    void Allocate(int num);
+    /// change capacity, keeps the first numKeep particles, returns number kept
+    int Reallocate(int num, int numKeep);
+    /// free the streams
+    void Release();
+    /// return true if streams are allocated
+    bool IsValid() const;
+    /// get number of particles which fit into the pool
+    int GetCapacity() const;
+    /// get pointer to a stream
+    float* GetStream(Stream stream) const;
+    /// write a particle (all streams except the cached curve values)
+    void Set(int index, const nParticle2& particle);
+    /// read back a particle
+    void Get(int index, nParticle2& particle) const;
+    /// copy all streams of a particle to another slot
+    void Copy(int dstIndex, int srcIndex);
+
+private:
+    float* streams[NumStreams];
+    void* memory;
+    int capacity;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nParticle2Pool::IsValid() const
+{
+    return (0 != this->memory);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nParticle2Pool::GetCapacity() const
+{
+    return this->capacity;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float*
+nParticle2Pool::GetStream(Stream stream) const
+{
+    n_assert((stream >= 0) && (stream < NumStreams));
+    return this->streams[stream];
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nParticle2Pool::Copy(int dstIndex, int srcIndex)
+{
+    n_assert((dstIndex >= 0) && (dstIndex < this->capacity));
+    n_assert((srcIndex >= 0) && (srcIndex < this->capacity));
+    int i;
+    for (i = 0; i < NumStreams; i++)
+    {
+        this->streams[i][dstIndex] = this->streams[i][srcIndex];
+    }
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -9,6 +9,12 @@
     emitters in the world. Take care when updating them, the rendering is a
     function of the emitters.
 
+    Trigger() updates the emitters on the kernel's worker pool. Emitters
+    are grouped into batches of roughly ParticlesPerBatch particles, each
+    batch is one task. Sleeping emitters are updated on the calling thread
+    since they only need to advance their timers. The emitter meshes are
+    locked once on the calling thread before the parallel update.
+
     (C) 2005 RadonLabs GmbH
 */
 #include "kernel/nroot.h"
@@ -16,9 +22,13 @@
 #include "particle/nparticle2emitter.h"
 #include "util/nfixedarray.h"
 #include "util/nringbuffer.h"
+#include "kernel/nworkerpool.h"
+#include "kernel/nprofiler.h"
+#include "misc/nwatched.h"
 
 //------------------------------------------------------------------------------
 class nParticle2Emitter;
+class nMesh2;
 
 class nParticleServer2 : public nRoot
 {
@@ -28,6 +38,8 @@ private:
         MaxParticles = 30000,       // maximum number of particles in the world
         FloatRandomCount = 32768,   // number of floats in the float random pool
         IntRandomCount = 512,       // number of ints in the int random pool
+        ParticlesPerBatch = 2048,   // number of particles per update task
+        EmitterBatchCost = 64,      // fixed cost of an emitter in particles
     };
 public:
     /// constructor
@@ -57,15 +69,54 @@ public:
     float PseudoRandomFloat(int key);
     /// pseudo random vector
     vector3 PseudoRandomVector3(int key);
+    /// enable/disable the SSE particle update kernel (default is enabled)
+    void SetUseSimd(bool b);
+    /// get SSE particle update kernel flag
+    bool GetUseSimd() const;
+    /// enable/disable updating emitters on the worker threads (default is enabled)
+    void SetParallelUpdate(bool b);
+    /// get parallel update flag
+    bool GetParallelUpdate() const;
 
 private:
+    /// a range of emitters in activeEmitters, updated by one task
+    struct UpdateBatch
+    {
+        int firstEmitter;
+        int numEmitters;
+    };
+    /// an emitter mesh locked for the update
+    struct LockedMesh
+    {
+        nMesh2* mesh;
+        float* vertices;
+        ushort* indices;
+    };
+
+    /// lock the emitter meshes of the active emitters
+    void LockEmitterMeshes();
+    /// unlock the emitter meshes
+    void UnlockEmitterMeshes();
+    /// update task function, runs on a worker thread
+    static void UpdateEmittersTask(int taskIndex, int workerIndex, void* userData);
+
     static nParticleServer2* Singleton;
 
     nArray<nParticle2Emitter*> emitters;
+    nArray<nParticle2Emitter*> activeEmitters;
+    nArray<UpdateBatch> updateBatches;
+    nArray<LockedMesh> lockedMeshes;
     nFixedArray<float> floatRandomPool;
     nFixedArray<int> intRandomPool;
     vector3 globalAccel;
     nTime time;
+    uint nextRandomSeed;
+    bool useSimd;
+    bool parallelUpdate;
+
+    PROFILER_DECLARE(profUpdate);
+    WATCHER_DECLARE(watchNumActiveEmitters);
+    WATCHER_DECLARE(watchNumUpdateBatches);
 };
 
 //------------------------------------------------------------------------------
@@ -119,6 +170,49 @@ nParticleServer2::GetGlobalAccel() const
     return this->globalAccel;
 }
 
+//------------------------------------------------------------------------------
+/**
+    The SSE kernel is only used if it has been compiled in
+    (see nparticle2pool.h), turn it off to validate against the scalar
+    kernel.
+*/
+inline
+void
+nParticleServer2::SetUseSimd(bool b)
+{
+    this->useSimd = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nParticleServer2::GetUseSimd() const
+{
+    return this->useSimd;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nParticleServer2::SetParallelUpdate(bool b)
+{
+    this->parallelUpdate = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nParticleServer2::GetParallelUpdate() const
+{
+    return this->parallelUpdate;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -30,6 +30,14 @@
     Unloading resources always happened immediately, both in sync and
     async mode.
 
+    Pending async load requests are handled in the order of their load
+    priority (SetLoadPriority(), higher values are loaded first, for
+    instance the inverse distance to the camera). Subclasses which return
+    true from CanPreloadFile() get their resource file read into memory
+    by the resource server's I/O thread before LoadResource() is called
+    in a loader job, LoadResource() then finds the file contents in
+    GetPreloadedFileData().
+
     A resource object can be in one of the following states:
 
     - <b>Unloaded:</b> The resource is not currently loaded, resource
@@ -128,6 +136,8 @@ public:
     nResource();
     /// destructor
     virtual ~nResource();
+    /// release object, destruction is deferred while a loader job works on the resource
+    virtual bool Release();
     /// subclasses must indicate to nResource whether async mode is supported
     virtual bool CanLoadAsync() const;
     /// set resource type
@@ -148,6 +158,10 @@ public:
     const char* GetResourceLoader();
     /// is a resource loading request pending?
     bool IsPending() const;
+    /// set async load priority, higher priorities are loaded first (default is 0)
+    void SetLoadPriority(float p);
+    /// get async load priority
+    float GetLoadPriority() const;
     /// issue a load request
     virtual bool Load();
     /// issue a load request from an open file, FIXME: this kinda sucks, Floh.
@@ -184,10 +198,31 @@ protected:
     virtual void OnLost();
     /// called when contained resource may be restored
     virtual void OnRestored();
+    /// subclasses return true if LoadResource() can use a preloaded resource file
+    virtual bool CanPreloadFile();
+    /// read the resource file into memory
+    bool PreloadFile();
+    /// get the resource file contents read by the I/O thread, or 0
+    const void* GetPreloadedFileData() const;
+    /// get size of the preloaded file contents
+    int GetPreloadedFileSize() const;
+    /// free the preloaded file contents
+    void FreePreloadedFile();
 
     nDynAutoRef<nResourceLoader> refResourceLoader;
 
 private:
+    /// stages of an async load request, owned by the resource server's loaderMutex
+    enum JobStage
+    {
+        NoJob,              // no request pending
+        WaitingForRead,     // queued for the I/O thread
+        Reading,            // the I/O thread reads the resource file
+        ReadCancelled,      // unloaded while the file was read
+        WaitingForLoad,     // queued for a loader job
+        Loading,            // a loader job runs LoadResource()
+    };
+
     static uint uniqueIdCounter;
 
     nAutoRef<nResourceServer> refResourceServer;
@@ -195,6 +230,13 @@ private:
     Type type;
     bool asyncEnabled;
     nNode jobNode;      // for linkage into resource server's loader job list
+    JobStage jobStage;      // owned by the loaderMutex
+    bool jobPinned;         // a background thread works on the resource, owned by the loaderMutex
+    bool releasePending;    // last reference released while pinned, owned by the loaderMutex
+    float loadPriority;
+    double jobQueueTime;
+    void* preloadedFileData;
+    int preloadedFileSize;
     nThreadVariable<State> state;
     uint uniqueId;
 };
@@ -363,15 +405,32 @@ nResource::IsLost() const
 
 //------------------------------------------------------------------------------
 /**
-    Return whether a yet-unfullfilled resource loading request is pending.
+*/
+inline
+float
+nResource::GetLoadPriority() const
+{
+    return this->loadPriority;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+const void*
+nResource::GetPreloadedFileData() const
+{
+    return this->preloadedFileData;
+}
 
-    @return     pending flag (true in async mode between Load() and IsValid() = true)
+//------------------------------------------------------------------------------
+/**
 */
 inline
-bool
-nResource::IsPending() const
+int
+nResource::GetPreloadedFileSize() const
 {
-    return this->jobNode.IsLinked();
+    return this->preloadedFileSize;
 }
 
 //------------------------------------------------------------------------------
@@ -10,11 +10,39 @@
     streams) to the application, and can unload and reload themselves
     on request.
 
+    Asynchronous load requests are handled in 2 stages. Resources which
+    can use a preloaded file (see nResource::CanPreloadFile()) are first
+    queued for the I/O thread, which reads the resource file into memory.
+    Then the resource is queued for the loader jobs, which call
+    nResource::LoadResource(). The I/O thread submits the loader jobs as
+    background jobs to the nJobServer, at most SetNumLoaderThreads() of
+    them run at the same time, each one loads resources until the queue
+    is empty. A single I/O thread keeps disk access sequential, while the
+    loader jobs decode in parallel on the job workers, so disk and CPU
+    work overlap. Both queues are ordered by the resource's load priority,
+    jobs of the same priority are handled in FIFO order.
+
+    A load request is cancelled when the resource is unloaded before its
+    job has been started. A running file read is cancelled as well, a
+    running LoadResource() call is not.
+
+    While the I/O thread or a loader job works on a resource, the job is
+    pinned. If the last reference of a pinned resource is released, the
+    resource is destroyed by the next Trigger() call on the main thread,
+    after the job has been finished. The I/O thread and the loader jobs
+    never take a resource's mutex while holding the loaderMutex,
+    nRoot::Release() takes them in the opposite order.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/nroot.h"
 #include "resource/nresource.h"
 #include "kernel/nref.h"
+#include "kernel/nmutex.h"
+#include "kernel/nevent.h"
+#include "kernel/njobserver.h"
+#include "util/narray.h"
+#include "misc/nwatched.h"
 
 //------------------------------------------------------------------------------
 class nResourceServer : public nRoot
@@ -46,6 +74,14 @@ public:
     int GetNumResources(nResource::Type rsrcType);
     /// get number of bytes of RAM occupied by resource type
     int GetResourceByteSize(nResource::Type rsrcType);
+    /// set max number of loader jobs running at the same time (default is 2)
+    void SetNumLoaderThreads(int num);
+    /// get max number of loader jobs running at the same time
+    int GetNumLoaderThreads() const;
+    /// get number of queued load requests
+    int GetNumLoaderJobs();
+    /// per-frame trigger, call once per frame from the main thread
+    void Trigger();
 
 protected:
     friend class nResource;
@@ -55,12 +91,28 @@ protected:
     void AddLoaderJob(nResource* res);
     /// remove a resource from the loader job list
     void RemLoaderJob(nResource* res);
-    /// start the loader thread
-    void StartLoaderThread();
-    /// shutdown the loader thread
-    void ShutdownLoaderThread();
-    /// the loader thread function
-    static int N_THREADPROC LoaderThreadFunc(nThread* thread);
+    /// set the load priority of a resource, re-sorts its pending job
+    void SetLoaderJobPriority(nResource* res, float priority);
+    /// insert a resource into a job list, sorted by load priority
+    void InsertLoaderJob(nList& list, nResource* res);
+    /// update the loader statistics, loaderMutex must be taken
+    void UpdateLoaderStats(nResource* finishedRes);
+    /// drop the job of a resource about to be destroyed, returns true if destruction must be deferred
+    bool DeferRelease(nResource* res);
+    /// unpin a job after a background thread is done with it, loaderMutex must be taken
+    void UnpinLoaderJob(nResource* res);
+    /// destroy resources whose release has been deferred
+    void ReleaseDeferredResources();
+    /// start the I/O thread
+    void StartLoaderThreads();
+    /// shutdown the I/O thread and wait for the loader jobs
+    void ShutdownLoaderThreads();
+    /// submit loader jobs for the waiting load requests
+    void ScheduleLoaderJobs();
+    /// the I/O thread function
+    static int N_THREADPROC IoThreadFunc(nThread* thread);
+    /// the loader job function
+    static void LoaderJobFunc(int begin, int end, void* userData);
     /// the thread wakeup function
     static void ThreadWakeupFunc(nThread* thread);
 
@@ -76,8 +128,25 @@ protected:
     nRef<nRoot> dbPool;
     nRef<nRoot> otherPool;
 
-    nThreadSafeList jobList;    // list for outstanding background loader jobs
-    nThread* loaderThread;      // background thread for handling async resource loading
+    nMutex loaderMutex;             // protects the job lists and the job stages of resources
+    nList ioJobList;                // resources waiting for the I/O thread
+    nList loadJobList;              // resources waiting for a loader job
+    nEvent ioEvent;                 // signalled when I/O jobs or loader jobs arrive
+    nThread* ioThread;              // background thread for reading resource files
+    nJobCounter loaderJobCounter;   // counts the submitted loader jobs
+    int numLoaderJobs;              // submitted loader jobs, protected by the loaderMutex
+    int numLoaderThreads;           // max number of loader jobs
+    volatile long stopLoaderThreads;  // set to 1 to stop the I/O thread and the loader jobs
+    nArray<nResource*> deferredReleases;    // released while pinned, destroyed by Trigger()
+
+    int numFinishedJobs;            // finished jobs in the current throughput interval
+    double throughputTime;          // start of the current throughput interval
+    float avgWaitTime;              // running average of the job wait time in seconds
+    float throughput;               // finished jobs per second in the last throughput interval
+
+    WATCHER_DECLARE(watchQueueDepth);
+    WATCHER_DECLARE(watchWaitTime);
+    WATCHER_DECLARE(watchThroughput);
 
     nClass* resourceClass;
 };
@@ -93,5 +162,15 @@ nResourceServer::Instance()
     return Singleton;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nResourceServer::GetNumLoaderThreads() const
+{
+    return this->numLoaderThreads;
+}
+
 //------------------------------------------------------------------------------
 #endif
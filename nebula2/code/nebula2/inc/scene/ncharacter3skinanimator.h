@@ -30,8 +30,10 @@ public:
     virtual bool LoadResources();
     /// unload resources
     virtual void UnloadResources();
-    /// called by scene node objects which wish to be animated by this object
-    virtual void Animate(nSceneNode* sceneNode, nRenderContext* renderContext);
+    /// update the animation state of a render context's character
+    virtual bool PrepareEvaluation(nRenderContext* renderContext, Evaluation& outEval);
+    /// apply the variation and evaluate a prepared character, may be called on a worker thread
+    virtual void EvaluateCharacter(const Evaluation& eval, int workerIndex) const;
 
     /// Get names of loaded Animations
     const nArray<nString>& GetNamesOfLoadedAnimations();
@@ -55,7 +57,6 @@ private:
     nArray<nArray<nCharJoint> > variationJoints;
 
     int characterVariationVarIndex;
-    int currentVariation;
 };
 
 //------------------------------------------------------------------------------
@@ -53,6 +53,8 @@ public:
     const nString& GetShader() const;
     /// get bucket index of shader
     int GetShaderIndex();
+    /// get bucket index of shader without loading resources (valid if resources are valid)
+    int GetLoadedShaderIndex() const;
     /// get pointer to shader object
     nShader2* GetShaderObject();
     /// set maya shader name
@@ -127,6 +129,19 @@ nMaterialNode::GetShaderIndex()
     return this->shaderIndex;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Returns the cached bucket index without checking the resources, so it
+    can be called by the scene server's split tasks on worker threads.
+    The resources must have been loaded before.
+*/
+inline
+int
+nMaterialNode::GetLoadedShaderIndex() const
+{
+    return this->shaderIndex;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
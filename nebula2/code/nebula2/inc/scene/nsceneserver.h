@@ -11,6 +11,25 @@
     The scene is rebuilt every frame, so some sort of culling should happen
     externally before building the scene.
 
+    Splitting, light scissor computation and sorting of the attached
+    scene are distributed over the kernel's nWorkerPool (see
+    SetParallelBuild()). The group array is partitioned into fixed size
+    chunks whose results are merged in group order, so the outcome does
+    not depend on the number of threads. Attaching render contexts and
+    loading resources still happens on the calling thread, because
+    scene nodes and animators are not thread-safe.
+
+    Characters are updated in a separate phase before rendering (see
+    UpdateCharacters()): the animation state of every character attached
+    this frame is updated on the calling thread, then the animations are
+    sampled and the skeletons evaluated on the worker pool. Skin shapes
+    rendered later in the frame find their characters uptodate.
+
+    Shapes are sorted inside their shader bucket by a 64 bit key which
+    is computed once per shape by the split pass (see ComputeSortKey())
+    and sorted with a radix sort. The depth order of a bucket is taken
+    from the sort attribute of the render path phases using it.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/nroot.h"
@@ -18,10 +37,13 @@
 #include "kernel/nautoref.h"
 #include "gfx2/nshaderparams.h"
 #include "util/nbucket.h"
+#include "util/nradixsort.h"
 #include "renderpath/nrenderpath2.h"
 #include "misc/nwatched.h"
 #include "gfx2/nmesh2.h"
 #include "kernel/nprofiler.h"
+#include "kernel/nworkerpool.h"
+#include "scene/nskinanimator.h"
 
 class nRenderContext;
 class nSceneNode;
@@ -58,6 +80,8 @@ public:
     virtual void Attach(nRenderContext* renderContext);
     /// finish the scene
     virtual void EndScene();
+    /// split, validate and sort the attached scene without rendering it
+    void BuildScene();
     /// render the scene through the default render path section
     virtual void RenderScene();
     /// present the scene
@@ -104,6 +128,10 @@ public:
     void SaveProjectionMatrix(const matrix44& m);
     /// get the projection matrix, that was saved
     const matrix44& GetSavedProjectionMatrix() const;
+    /// enable/disable multithreaded scene build
+    void SetParallelBuild(bool b);
+    /// get multithreaded scene build flag
+    bool GetParallelBuild() const;
 private:
 
     static nSceneServer* Singleton;
@@ -121,6 +149,11 @@ private:
     class LightInfo
     {
     public:
+        /// constructor, the clip planes are frame allocated
+        LightInfo();
+        /// copy constructor
+        LightInfo(const LightInfo& rhs);
+
         ushort groupIndex;                  // group index of the light source itself
         rectangle scissorRect;              // scissor rect of the light
         vector4 shadowLightMask;            // the shadow light index
@@ -129,12 +162,28 @@ private:
 
     /// split scene nodes into light and shape nodes
     void SplitNodes();
+    /// resolve reflecting shapes and cameras found by the split pass
+    void SplitSpecialGroup(ushort groupIndex);
+    /// run scene build tasks on the worker pool or serially
+    void RunBuildTasks(int numTasks, nWorkerPool::TaskFunc func);
+    /// worker task: classify one chunk of the group array
+    static void SplitNodesTask(int taskIndex, int workerIndex, void* userData);
+    /// worker task: compute scissors and clip planes for a range of lights
+    static void ComputeLightsTask(int taskIndex, int workerIndex, void* userData);
+    /// worker task: sort one shape bucket
+    static void SortNodesTask(int taskIndex, int workerIndex, void* userData);
+    /// evaluate the characters attached this frame
+    void UpdateCharacters();
+    /// worker task: evaluate one character
+    static void UpdateCharactersTask(int taskIndex, int workerIndex, void* userData);
     /// make sure scene node resources are valid
     void ValidateNodeResources();
     /// sort shape nodes for optimal rendering
     void SortNodes();
-    /// static qsort() compare function for scene nodes
-    static int __cdecl CompareNodes(const ushort* i1, const ushort* i2);
+    /// compute the sorting order of each shader bucket from the render path
+    void UpdateBucketSortingOrders();
+    /// compute the render queue sort key of a shape group
+    uint64 ComputeSortKey(const Group& group, int bucketIndex) const;
     /// static qsort() compare function for shadow light sources
     static int __cdecl CompareShadowLights(const LightInfo* i1, const LightInfo* i2);
     /// do the render path rendering
@@ -197,10 +246,36 @@ private:
         MaxHierarchyDepth = 64,
         NumBuckets = 64,
         MaxShadowLights = 4,
+        SplitChunkSize = 256,       // number of groups per split task
+        LightChunkSize = 8,         // number of lights per scissor task
+    };
+
+    /// result of the split pass for a contiguous range of the group array
+    class SplitChunk
+    {
+    public:
+        /// constructor
+        SplitChunk();
+
+        int firstGroup;
+        int numGroups;
+        nBucket<ushort,NumBuckets> shapeBucket; // shape group indices bucketed by shader
+        nBucket<uint64,NumBuckets> keyBucket;   // sort keys of the shapes in shapeBucket
+        nArray<ushort> lightArray;              // light group indices
+        nArray<ushort> shadowArray;             // shadow casting group indices
+        nArray<ushort> specialArray;            // reflecting shapes and cameras
+        nArray<ushort> invalidArray;            // groups with invalid resources
+    };
+
+    /// a character evaluated in the character update phase
+    class CharacterUpdate
+    {
+    public:
+        nSkinAnimator* animator;
+        nSkinAnimator::Evaluation eval;
     };
 
-    static vector3 viewerPos;
-    static int sortingOrder;
+    vector3 viewerPos;
 
     bool isOpen;
     bool inBeginScene;
@@ -213,6 +288,7 @@ private:
     bool guiEnabled;
     bool camerasEnabled;
     bool perfGuiEnabled;
+    bool parallelBuild;
 
     nString renderPathFilename;
     uint stackDepth;
@@ -226,6 +302,13 @@ private:
     nArray<ushort> shadowArray;
     nArray<ushort> cameraArray;
     nBucket<ushort,NumBuckets> shapeBucket;     // contains indices of shape nodes, bucketsorted by shader
+    nBucket<uint64,NumBuckets> keyBucket;       // sort keys of the shapes in shapeBucket
+    nRadixSort<ushort> bucketSorter[NumBuckets];    // per bucket sorters (keep scratch buffers)
+    nRpPhase::SortingOrder bucketSortingOrder[NumBuckets];
+    nArray<SplitChunk*> splitChunks;            // per-chunk results of the split pass
+    int numSplitChunks;                         // number of valid chunks this frame
+    nArray<CharacterUpdate> characterUpdates;   // characters evaluated this frame
+    nVariable::Handle charPointerVarHandle;     // render context variable holding an nCharacter2
 
     float renderedReflectorDistance;
     nRenderContext* renderContextPtr;
@@ -246,11 +329,25 @@ private:
     PROFILER_DECLARE(profOcclusion);
     PROFILER_DECLARE(profRenderPath);
     PROFILER_DECLARE(profRenderCameras);
+    PROFILER_DECLARE(profBuildSplit);
+    PROFILER_DECLARE(profBuildMerge);
+    PROFILER_DECLARE(profBuildLoad);
+    PROFILER_DECLARE(profBuildScissors);
+    PROFILER_DECLARE(profBuildSort);
+    PROFILER_DECLARE(profUpdateCharacters);
 
     WATCHER_DECLARE(watchNumInstanceGroups);
     WATCHER_DECLARE(watchNumInstances);
     WATCHER_DECLARE(watchNumOccluded);
     WATCHER_DECLARE(watchNumNotOccluded);
+    WATCHER_DECLARE(watchNumBuildThreads);
+    WATCHER_DECLARE(watchNumCharacters);
+    WATCHER_DECLARE(watchNumFrameAllocs);
+    WATCHER_DECLARE(watchNumFrameBytes);
+#ifdef __NEBULA_MEM_MANAGER__
+    WATCHER_DECLARE(watchNumHeapAllocs);
+    int lastNumHeapAllocs;
+#endif
 
     // "imported" from graphics server
     WATCHER_DECLARE(watchNumPrimitives);
@@ -289,6 +386,29 @@ nSceneServer::GetPerfGuiEnabled() const
     return this->perfGuiEnabled;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Enable/disable distributing the scene build (split, scissors, sort)
+    over the worker pool. When disabled, the same tasks run serially on
+    the calling thread, which is handy for validation.
+*/
+inline
+void
+nSceneServer::SetParallelBuild(bool b)
+{
+    this->parallelBuild = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nSceneServer::GetParallelBuild() const
+{
+    return this->parallelBuild;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -12,6 +12,13 @@
     scene node (which must be a nSkinShapeNode) with a pointer
     to an uptodate nCharSkeleton object.
 
+    Updating a character is split into PrepareEvaluation(), which reads
+    the render context and updates the animation state on the main
+    thread, and EvaluateCharacter(), which samples the animation and
+    evaluates the skeleton and may run on a worker thread. The scene
+    server uses this to evaluate all characters of a frame in parallel
+    before rendering, Animate() then finds the characters uptodate.
+
     See also @ref N2ScriptInterface_nskinanimator
 
     (C) 2003 RadonLabs GmbH
@@ -46,6 +53,18 @@ public:
     /// called by scene node objects which wish to be animated by this object
     virtual void Animate(nSceneNode* sceneNode, nRenderContext* renderContext);
 
+    /// a character evaluation prepared by PrepareEvaluation()
+    struct Evaluation
+    {
+        nCharacter2* character;
+        float time;
+        int variation;
+    };
+    /// update the animation state of a render context's character, returns false if it is already uptodate for this frame
+    virtual bool PrepareEvaluation(nRenderContext* renderContext, Evaluation& outEval);
+    /// evaluate a prepared character, may be called on a worker thread
+    virtual void EvaluateCharacter(const Evaluation& eval, int workerIndex) const;
+
     /// begin adding joints
     void BeginJoints(int numJoints);
     /// add a joint to the skeleton
@@ -228,12 +247,13 @@ inline
 void
 nSkinAnimator::GetJoint(int index, int& parentJointIndex, vector3& poseTranslate, quaternion& poseRotate, vector3& poseScale, nString& name)
 {
-    nCharJoint& joint = this->character.GetSkeleton().GetJointAt(index);
+    nCharSkeleton& skeleton = this->character.GetSkeleton();
+    nCharJoint& joint = skeleton.GetJointAt(index);
     parentJointIndex = joint.GetParentJointIndex();
     poseTranslate = joint.GetPoseTranslate();
     poseRotate    = joint.GetPoseRotate();
     poseScale     = joint.GetPoseScale();
-    name          = joint.GetName();
+    name          = skeleton.GetJointName(index);
 }
 
 //------------------------------------------------------------------------------
@@ -39,6 +39,7 @@ protected:
     bool charSkeletonDirty;             // only need to update skinned mesh when skeleton dirty
     nRef<nMesh2> refBindPoseMesh;       // the bind pose shadow mesh, only read by CPU
     nRef<nMesh2> refSkinnedMesh;        // the skinned shadow mesh, special extrusion layout, written and rendered
+    nArray<matrix44> skinMatrices;      // skin matrices of the skeleton's joints
 };
 
 //------------------------------------------------------------------------------
@@ -12,6 +12,7 @@
 #include "sql/nsqlrow.h"
 
 class nSqlQuery;
+class nSqlStatement;
 
 //------------------------------------------------------------------------------
 class nSqlDatabase : public nResource
@@ -63,6 +64,8 @@ public:
     virtual void DeleteRow(const nString& tableName, const nString& whereClause);
     /// create an SQL query (create, but don't execute!)
     virtual nSqlQuery* CreateQuery(const nString& sqlStatement);
+    /// create a prepared SQL statement, returns 0 if the statement is invalid and failOnError is false
+    virtual nSqlStatement* CreateStatement(const nString& sqlStatement, bool failOnError = true);
     /// begin a transaction
     virtual void BeginTransaction();
     /// end a transaction
@@ -66,6 +66,8 @@ public:
     virtual void DeleteRow(const nString& tableName, const nString& whereClause);
     /// create an SQL query (create, but don't execute!)
     virtual nSqlQuery* CreateQuery(const nString& sqlStatement);
+    /// create a prepared SQL statement, returns 0 if the statement is invalid and failOnError is false
+    virtual nSqlStatement* CreateStatement(const nString& sqlStatement, bool failOnError = true);
     /// get a pointer to the SQLite3 database handle
     sqlite3* GetDatabaseHandle() const;
     /// begin a transaction
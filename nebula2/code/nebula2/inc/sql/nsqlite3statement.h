@@ -0,0 +1,78 @@
+#ifndef N_SQLITE3STATEMENT_H
+#define N_SQLITE3STATEMENT_H
+//------------------------------------------------------------------------------
+/**
+    @class nSQLite3Statement
+
+    Wraps a prepared SQLite3 statement (sqlite3_stmt).
+
+    (C) 2006 Nebula2 Community
+*/
+#ifdef __WIN32__
+#include "sqlite/sqlite3.h"
+#else
+#include <sqlite3.h>
+#endif // __WIN32__
+
+#include "sql/nsqlstatement.h"
+#include "kernel/nref.h"
+
+class nSQLite3Database;
+
+//------------------------------------------------------------------------------
+class nSQLite3Statement : public nSqlStatement
+{
+public:
+    /// get the SQL statement
+    virtual const nString& GetSqlStatement() const;
+    /// get number of parameters
+    virtual int GetNumParameters() const;
+    /// bind a null value to a parameter
+    virtual void BindNull(int paramIndex);
+    /// bind an int value to a parameter
+    virtual void BindInt(int paramIndex, int val);
+    /// bind a float value to a parameter
+    virtual void BindFloat(int paramIndex, float val);
+    /// bind a string value to a parameter
+    virtual void BindString(int paramIndex, const nString& val);
+    /// bind binary data to a parameter, the data is copied
+    virtual void BindBlob(int paramIndex, const void* ptr, int size);
+    /// execute the statement up to the next result row
+    virtual Result Step(bool failOnError = true);
+    /// reset the statement and clear the bindings
+    virtual void Reset();
+    /// get the result column names
+    virtual const nArray<nString>& GetColumns() const;
+    /// get the storage type of a column in the current row
+    virtual ColumnType GetColumnType(int colIndex) const;
+    /// get a column of the current row as int
+    virtual int GetInt(int colIndex) const;
+    /// get a column of the current row as float
+    virtual float GetFloat(int colIndex) const;
+    /// get a column of the current row as string
+    virtual nString GetString(int colIndex) const;
+    /// get a column of the current row as binary data, valid until the next Step()
+    virtual const void* GetBlob(int colIndex, int& size) const;
+
+private:
+    friend class nSQLite3Database;
+
+    /// destructor
+    virtual ~nSQLite3Statement();
+    /// constructor
+    nSQLite3Statement(nSQLite3Database* db);
+    /// compile the SQL statement
+    bool Prepare(const nString& sql, bool failOnError);
+    /// check the result of a sqlite3_bind_*() call
+    void CheckBind(int err) const;
+    /// gather the result column names
+    void UpdateColumns();
+
+    nRef<nSQLite3Database> refDatabase;
+    nString sqlStatement;
+    nArray<nString> columns;
+    sqlite3_stmt* sqliteStmt;
+    bool isFirstStep;
+};
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,77 @@
+#ifndef N_SQLSTATEMENT_H
+#define N_SQLSTATEMENT_H
+//------------------------------------------------------------------------------
+/**
+    @class nSqlStatement
+
+    A prepared SQL statement. The statement is compiled once by
+    nSqlDatabase::CreateStatement() and may then be executed any number of
+    times with different parameter values, which avoids building and
+    parsing a new SQL string for each execution.
+
+    Parameters are marked with '?' in the SQL statement and are bound by
+    their 0-based index with the typed Bind*() methods. Step() executes
+    the statement up to the next result row, whose values can be read
+    with the typed Get*() methods by 0-based column index. Reset() makes
+    the statement ready to be executed again and clears the bindings.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/nrefcounted.h"
+#include "util/nstring.h"
+#include "util/narray.h"
+
+//------------------------------------------------------------------------------
+class nSqlStatement : public nRefCounted
+{
+public:
+    /// result of Step()
+    enum Result
+    {
+        Row,        // a result row is available
+        Done,       // the statement has finished executing
+        Error,      // the statement failed
+    };
+    /// storage type of a result column
+    enum ColumnType
+    {
+        Null,
+        Int,
+        Float,
+        String,
+        Blob,
+    };
+
+    /// get the SQL statement
+    virtual const nString& GetSqlStatement() const = 0;
+    /// get number of parameters
+    virtual int GetNumParameters() const = 0;
+    /// bind a null value to a parameter
+    virtual void BindNull(int paramIndex) = 0;
+    /// bind an int value to a parameter
+    virtual void BindInt(int paramIndex, int val) = 0;
+    /// bind a float value to a parameter
+    virtual void BindFloat(int paramIndex, float val) = 0;
+    /// bind a string value to a parameter
+    virtual void BindString(int paramIndex, const nString& val) = 0;
+    /// bind binary data to a parameter, the data is copied
+    virtual void BindBlob(int paramIndex, const void* ptr, int size) = 0;
+    /// execute the statement up to the next result row
+    virtual Result Step(bool failOnError = true) = 0;
+    /// reset the statement and clear the bindings
+    virtual void Reset() = 0;
+    /// get the result column names, the names are updated by the first Step()
+    virtual const nArray<nString>& GetColumns() const = 0;
+    /// get the storage type of a column in the current row
+    virtual ColumnType GetColumnType(int colIndex) const = 0;
+    /// get a column of the current row as int
+    virtual int GetInt(int colIndex) const = 0;
+    /// get a column of the current row as float
+    virtual float GetFloat(int colIndex) const = 0;
+    /// get a column of the current row as string
+    virtual nString GetString(int colIndex) const = 0;
+    /// get a column of the current row as binary data, valid until the next Step()
+    virtual const void* GetBlob(int colIndex, int& size) const = 0;
+};
+//------------------------------------------------------------------------------
+#endif
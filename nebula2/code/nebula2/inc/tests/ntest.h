@@ -0,0 +1,173 @@
+#ifndef N_TEST_H
+#define N_TEST_H
+//------------------------------------------------------------------------------
+/**
+    @class nTest
+    @ingroup Tests
+    @brief Check and timing helpers for the tests in src/tests.
+
+    Every test is a standalone console application (see
+    bldfiles/nebula2tests.bld). Checks are done with the n_test() macro,
+    which prints the failed expression and counts the error. main()
+    returns nTest::Finish(), which prints the number of errors and
+    returns 0 if all checks passed, 10 otherwise.
+
+    Benchmarks measure wall clock time with nTest::Timer and print
+    their results as "name: value unit" lines. Tests which take a
+    worker count sweep from 0 workers to -workers (default: number of
+    processors - 1).
+
+    To run the threaded tests under ThreadSanitizer, build the
+    nebula2tests workspace with "make N_TSAN=true" (gcc only, see
+    buildsys3/config.mak).
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+#ifdef __WIN32__
+#   ifndef _INC_WINDOWS
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#   endif
+#else
+#include <sys/time.h>
+#endif
+#include <stdio.h>
+
+#define n_test(exp) nTest::Check((exp) != 0, #exp, __FILE__, __LINE__)
+
+//------------------------------------------------------------------------------
+class nTest
+{
+public:
+    /// a wall clock timer
+    class Timer
+    {
+    public:
+        /// constructor, starts the timer
+        Timer();
+        /// restart the timer
+        void Start();
+        /// get seconds since Start()
+        double GetTime() const;
+
+    private:
+        /// get current time in seconds
+        static double GetSystemTime();
+
+        double startTime;
+    };
+
+    /// record the result of a check, use the n_test() macro
+    static void Check(bool ok, const char* exp, const char* file, int line);
+    /// get number of failed checks
+    static int GetNumErrors();
+    /// print the summary, returns the exit code of the test
+    static int Finish(const char* testName);
+
+private:
+    /// access the error counter
+    static int& ErrorCount();
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nTest::Timer::Timer()
+{
+    this->Start();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nTest::Timer::Start()
+{
+    this->startTime = GetSystemTime();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+double
+nTest::Timer::GetTime() const
+{
+    return GetSystemTime() - this->startTime;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+double
+nTest::Timer::GetSystemTime()
+{
+#ifdef __WIN32__
+    LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) / double(freq.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return double(tv.tv_sec) + double(tv.tv_usec) * 0.000001;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    There is only one test per executable, so a function local static
+    is enough.
+*/
+inline
+int&
+nTest::ErrorCount()
+{
+    static int errors = 0;
+    return errors;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nTest::Check(bool ok, const char* exp, const char* file, int line)
+{
+    if (!ok)
+    {
+        printf("FAILED: %s(%d): %s\n", file, line, exp);
+        fflush(stdout);
+        ErrorCount()++;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nTest::GetNumErrors()
+{
+    return ErrorCount();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+int
+nTest::Finish(const char* testName)
+{
+    printf("%s: %d errors\n", testName, ErrorCount());
+    return (0 == ErrorCount()) ? 0 : 10;
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -7,6 +7,12 @@
 
     Nebula mesh builder helper class. This class is useful for writing mesh exporters.
 
+    Optimize() reorders the triangles of each group for the post-transform
+    vertex cache (Tom Forsyth's linear-speed algorithm), optionally sorts
+    clusters of triangles to reduce overdraw, and finally reorders the
+    vertices into the order in which the triangles reference them.
+    SortTriangles() is stable, so the optimized order survives saving.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/ntypes.h"
@@ -293,7 +299,7 @@ public:
     int GetNumEdges() const;
     /// get edge at index
     GroupedEdge& GetEdgeAt(int index) const;
-    /// sort triangles by group id and material id
+    /// sort triangles by group id, material id and usage flags (stable)
     void SortTriangles();
     /// find the first triangle matching group id, material id and usage flags
     int GetFirstGroupTriangle(int groupId, int materialId, int usageFlags) const;
@@ -334,8 +340,10 @@ public:
     void Inflate();
     /// build edge information (only works on clean meshes, and it not allowed to change the mesh later)
     void CreateEdges();
-    /// optimize for t&l hardware vertex cache
-    void Optimize();
+    /// optimize for t&l hardware vertex cache, optionally sort triangle clusters to reduce overdraw
+    void Optimize(bool sortClusters = false);
+    /// compute average cache miss ratio and average transform to vertex ratio of a triangle range
+    void ComputeVertexCacheStats(int firstTriangle, int numTriangles, int cacheSize, float& acmr, float& atvr) const;
     /// append mesh from mesh builder object
     int Append(const nMeshBuilder& source);
     /// copy from mesh builder object
@@ -378,7 +386,7 @@ private:
     static nMeshBuilder* qsortData;
     /// a qsort() hook for generating a sorted index array
     static int __cdecl VertexSorter(const void* elm0, const void* elm1);
-    /// qsort hook for sorting triangles by their group index
+    /// qsort hook for sorting triangle indices by the group index of the triangles
     static int __cdecl TriangleGroupSorter(const void* elm0, const void* elm1);
     /// qsort hook for sorting temp edges by vertex indices
     static int __cdecl TempEdgeSorter(const void* elm0, const void* elm1);
@@ -392,6 +400,18 @@ private:
     void BuildVertexTangentsWithSplits();
     /// generate averaged vertex tangents without vertex splitting
     void BuildVertexTangentsWithoutSplits();
+    /// reorder the triangles of a range for the post-transform vertex cache
+    void OptimizeTriangleOrder(int firstTriangle, int numTriangles, nArray<int>& vertexMap);
+    /// sort clusters of a triangle range front to back to reduce overdraw
+    void SortTriangleClusters(int firstTriangle, int numTriangles);
+    /// reorder vertices into the order in which the triangles reference them
+    void OptimizeVertexOrder();
+
+    enum
+    {
+        OptimizeCacheSize = 32,     // LRU cache size of the vertex cache optimizer
+        ClusterCacheSize = 16,      // FIFO cache size used to find cluster boundaries
+    };
 
 public:
     nArray<Vertex>   vertexArray;
@@ -8,12 +8,18 @@
     An utility class which supports packing, diffing, and unpacking
     npk files.
 
+    If compression is enabled, a version 2 npk file is written, and each
+    file is compressed with nNpkCodec unless this doesn't pay off. Since
+    the compressed sizes are only known while the data block is written,
+    the file offsets in the table of contents are patched afterwards.
+
     (C) 2004 RadonLabs GmbH
 */
 #include "util/nstring.h"
 #include "file/nnpktoc.h"
 #include "kernel/nfile.h"
 #include "kernel/ndirectory.h"
+#include "util/narray.h"
 
 //------------------------------------------------------------------------------
 class nNpkBuilder
@@ -25,14 +31,22 @@ public:
         NoError = 0,
         CannotOpenSourceDirectory,
         CannotOpenNpkFile,
+        CannotReadSourceFile,
+        CannotWriteNpkFile,
     };
 
     /// constructor
     nNpkBuilder();
     /// destructor
     ~nNpkBuilder();
+    /// enable compression (writes a version 2 npk file)
+    void SetCompression(bool b);
+    /// get compression flag
+    bool GetCompression() const;
     /// pack a directory into an npk file
     bool Pack(const nString& rootPath, const nString& dirName, const nString& npkName, bool noRootName);
+    /// write a table of contents generated by the caller and its file data into an open npk file
+    bool Write(nNpkToc* toc, nFile* file);
     /// get error code
     Error GetError() const;
 
@@ -47,18 +61,53 @@ private:
     bool WriteData();
     /// recursively write data block for entries to npk file
     bool WriteEntryData(nNpkTocEntry* tocEntry);
+    /// patch file offsets and compressed lengths in the table of contents
+    void PatchToc();
     /// set error code
     void SetError(Error e);
 
+    /// a file entry of the table of contents which must be patched
+    struct TocPatch
+    {
+        int filePos;            // position of the fileOffset field in the npk file
+        int fileOffset;
+        int compressedLength;
+        int codec;
+    };
+
     nNpkToc* tocObject;
     nFile* npkFile;
     int fileOffset;
     int dataBlockStart;
     int dataBlockOffset;
     int dataSize;
+    int compressedDataSize;
+    bool compress;
+    nArray<TocPatch> tocPatches;
+    int curTocPatch;
     Error errorCode;
 };
 
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nNpkBuilder::SetCompression(bool b)
+{
+    this->compress = b;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+bool
+nNpkBuilder::GetCompression() const
+{
+    return this->compress;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -13,9 +13,23 @@
     prevent the array from pre-allocating any memory on construction
     call the nArray(0, 0) constructor.
 
+    With the FrameAlloc flag set, the elements are allocated from the
+    nFrameArena instead of the heap. Such an array is meant for transient
+    per-frame data: its elements stay valid until the end of the next
+    frame, after that Clear(), Reset() and the destructor simply forget
+    them without calling the element destructors. So FrameAlloc is only
+    meant for plain data element types, which don't own heap memory or
+    references (no nString, Ptr<> or nRef<> elements); other frame
+    allocated arrays are fine. The array remembers the frame id of its
+    allocation, so it never touches recycled frame memory. The flag
+    belongs to the array object, it is not copied by the copy constructor
+    or the assignment operator, so copying a frame allocated array into
+    a normal array keeps the data beyond the frame.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/ntypes.h"
+#include "kernel/nframearena.h"
 
 #include <algorithm> // std::sort
 
@@ -29,6 +43,7 @@ public:
     enum
     {
         DoubleGrowSize = (1<<0),    // when set, grow size doubles each turn
+        FrameAlloc = (1<<1),        // when set, elements are allocated from the nFrameArena
     };
 
     /// constructor with default parameters
@@ -114,6 +129,12 @@ public:
     int BinarySearchIndex(const TYPE& elm) const;
 
 private:
+    /// allocate memory for num elements
+    TYPE* AllocElements(int num);
+    /// free element memory
+    void FreeElements(TYPE* ptr);
+    /// return true if the elements are frame allocated and have been recycled
+    bool IsStale() const;
     /// check if index is in valid range, and grow array if necessary
     void CheckIndex(int);
     /// construct an element (call placement new)
@@ -140,6 +161,7 @@ private:
     int numElements;        // number of elements in array
     int flags;
     TYPE* elements;         // pointer to element array
+    uint frameId;           // frame of the allocation if frame allocated
 };
 
 //------------------------------------------------------------------------------
@@ -150,7 +172,8 @@ nArray<TYPE>::nArray() :
     growSize(16),
     allocSize(0),
     numElements(0),
-    flags(0)
+    flags(0),
+    frameId(0)
 {
     this->elements = 0;
 }
@@ -164,12 +187,13 @@ nArray<TYPE>::nArray(int initialSize, int grow) :
     growSize(grow),
     allocSize(initialSize),
     numElements(0),
-    flags(0)
+    flags(0),
+    frameId(0)
 {
     n_assert(initialSize >= 0);
     if (initialSize > 0)
     {
-        this->elements = (TYPE*)n_malloc(sizeof(TYPE) * this->allocSize);
+        this->elements = this->AllocElements(this->allocSize);
     }
     else
     {
@@ -186,12 +210,13 @@ nArray<TYPE>::nArray(int initialSize, int grow, const TYPE& initialValue) :
     growSize(grow),
     allocSize(initialSize),
     numElements(initialSize),
-    flags(0)
+    flags(0),
+    frameId(0)
 {
     n_assert(initialSize >= 0);
     if (initialSize > 0)
     {
-        this->elements = (TYPE*)n_malloc(sizeof(TYPE) * this->allocSize);
+        this->elements = this->AllocElements(this->allocSize);
         int i;
         for (i = 0; i < initialSize; i++)
         {
@@ -216,10 +241,10 @@ nArray<TYPE>::Copy(const nArray<TYPE>& src)
     this->growSize    = src.growSize;
     this->allocSize   = src.allocSize;
     this->numElements = src.numElements;
-    this->flags       = src.flags;
+    this->flags       = (src.flags & ~FrameAlloc) | (this->flags & FrameAlloc);
     if (this->allocSize > 0)
     {
-        this->elements = (TYPE*)n_malloc(sizeof(TYPE) * this->allocSize);
+        this->elements = this->AllocElements(this->allocSize);
         int i;
         for (i = 0; i < this->numElements; i++)
         {
@@ -237,17 +262,73 @@ nArray<TYPE>::Delete()
 {
     if (this->elements)
     {
-        for (int i = 0; i < this->numElements; i++)
+        if (!this->IsStale())
         {
-            this->Destroy(this->elements + i);
+            for (int i = 0; i < this->numElements; i++)
+            {
+                this->Destroy(this->elements + i);
+            }
+            this->FreeElements(this->elements);
         }
-        n_free(this->elements);
         this->elements = 0;
     }
     this->growSize = 0;
     this->allocSize = 0;
     this->numElements = 0;
-    this->flags = 0;
+    this->flags &= FrameAlloc;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocate uninitialized memory for num elements from the heap, or
+    from the frame arena. For frame allocated memory, the frame id is
+    recorded in the array object.
+*/
+template<class TYPE>
+TYPE*
+nArray<TYPE>::AllocElements(int num)
+{
+    if (FrameAlloc & this->flags)
+    {
+        nFrameArena* frameArena = nFrameArena::Instance();
+        this->frameId = frameArena->GetFrameId();
+        return (TYPE*) frameArena->Alloc(sizeof(TYPE) * num);
+    }
+    else
+    {
+        return (TYPE*) n_malloc(sizeof(TYPE) * num);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Frame allocated memory is recycled by the frame arena.
+*/
+template<class TYPE>
+void
+nArray<TYPE>::FreeElements(TYPE* ptr)
+{
+    if (0 == (FrameAlloc & this->flags))
+    {
+        n_free(ptr);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Frame allocated elements become invalid after the end of the frame
+    following the allocation.
+*/
+template<class TYPE>
+inline
+bool
+nArray<TYPE>::IsStale() const
+{
+    if ((FrameAlloc & this->flags) && this->elements)
+    {
+        return (nFrameArena::Instance()->GetFrameId() - this->frameId) > 1;
+    }
+    return false;
 }
 
 //------------------------------------------------------------------------------
@@ -295,8 +376,9 @@ nArray<TYPE>::nArray(const nArray<TYPE>& rhs) :
     growSize(0),
     allocSize(0),
     numElements(0),
+    flags(0),
     elements(0),
-    flags(0)
+    frameId(0)
 {
     this->Copy(rhs);
 }
@@ -317,6 +399,17 @@ template<class TYPE>
 void
 nArray<TYPE>::SetFlags(int f)
 {
+    if ((f ^ this->flags) & FrameAlloc)
+    {
+        // switching the allocator, the array must be empty
+        n_assert(0 == this->numElements);
+        if (this->elements)
+        {
+            this->FreeElements(this->elements);
+            this->elements = 0;
+            this->allocSize = 0;
+        }
+    }
     this->flags = f;
 }
 
@@ -343,7 +436,7 @@ nArray<TYPE>::Reallocate(int initialSize, int grow)
     this->numElements = 0;
     if (initialSize > 0)
     {
-        this->elements = (TYPE*)n_malloc(sizeof(TYPE) * initialSize);
+        this->elements = this->AllocElements(initialSize);
     }
     else
     {
@@ -393,7 +486,9 @@ template<class TYPE>
 void
 nArray<TYPE>::GrowTo(int newAllocSize)
 {
-    TYPE* newArray = (TYPE*)n_malloc(sizeof(TYPE) * newAllocSize);
+    // frame allocated arrays must be Reset() or Clear()ed every frame
+    n_assert(!this->IsStale());
+    TYPE* newArray = this->AllocElements(newAllocSize);
 
     if (this->elements)
     {
@@ -405,7 +500,7 @@ nArray<TYPE>::GrowTo(int newAllocSize)
         }
 
         // discard old array and update contents
-        n_free(this->elements);
+        this->FreeElements(this->elements);
     }
     this->elements  = newArray;
     this->allocSize = newAllocSize;
@@ -894,6 +989,12 @@ template<class TYPE>
 void
 nArray<TYPE>::Clear()
 {
+    if (this->IsStale())
+    {
+        // the frame arena has recycled the elements
+        this->elements = 0;
+        this->allocSize = 0;
+    }
     int i;
     for (i = 0; i < this->numElements; i++)
     {
@@ -911,6 +1012,12 @@ template<class TYPE>
 void
 nArray<TYPE>::Reset()
 {
+    if (this->IsStale())
+    {
+        // the frame arena has recycled the elements
+        this->elements = 0;
+        this->allocSize = 0;
+    }
     this->numElements = 0;
 }
 
@@ -7,6 +7,10 @@
 
     @brief A doubly linked list of named nodes with fast hashtable based search.
 
+    The hash table (see nHashTable and nStrHashMap) grows with the list,
+    the optional hash size given to the constructor is the expected
+    number of nodes.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/ntypes.h"
@@ -120,7 +124,7 @@ nHashList::RemHead()
     nHashNode* n = (nHashNode*)nList::RemHead();
     if (n)
     {
-        n->str_node.Remove();
+        this->h_table.Remove(&(n->str_node));
         n->SetHashTable(0);
     }
     return n;
@@ -136,7 +140,7 @@ nHashList::RemTail()
     nHashNode* n = (nHashNode*)nList::RemTail();
     if (n)
     {
-        n->str_node.Remove();
+        this->h_table.Remove(&(n->str_node));
         n->SetHashTable(0);
     }
     return n;
@@ -100,9 +100,12 @@ inline
 void
 nHashNode::Remove()
 {
-    this->str_node.Remove();
+    if (this->h_table)
+    {
+        this->h_table->Remove(&(this->str_node));
+        this->h_table = 0;
+    }
     nNode::Remove();
-    this->h_table = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -125,7 +128,7 @@ nHashNode::SetName(const char* name)
     if (this->IsLinked())
     {
         n_assert(this->h_table);
-        this->str_node.Remove();
+        this->h_table->Remove(&(this->str_node));
         this->str_node.SetName(name);
         this->h_table->Add(&(this->str_node));
     }
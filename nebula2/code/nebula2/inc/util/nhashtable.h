@@ -7,10 +7,17 @@
 
     @brief Implements a simple string hash table.
 
+    Maps the names of nStrNode objects to the nodes. This used to be
+    a fixed number of nStrList buckets, it's now an adapter around the
+    growing nStrHashMap, the constructor's size is only a hint for the
+    expected number of entries. Nodes must be removed with Remove()
+    before they are renamed or destroyed.
+
     (C) 2002 RadonLabs GmbH
 */
 #include "kernel/ntypes.h"
 #include "util/nstrlist.h"
+#include "util/nstrhashmap.h"
 
 //------------------------------------------------------------------------------
 class nHashTable
@@ -22,22 +29,23 @@ public:
     ~nHashTable();
     /// add an entry to the hash table
     void Add(nStrNode* n);
+    /// remove an entry from the hash table
+    void Remove(nStrNode* n);
     /// search hash table for entry
     nStrNode* Find(const char* str) const;
 
 private:
-    int htable_size;
-    nStrList* htable;
+    nStrHashMap<nStrNode*> map;
 };
 
 //------------------------------------------------------------------------------
 /**
 */
 inline
-nHashTable::nHashTable(int size)
+nHashTable::nHashTable(int size) :
+    map(size)
 {
-    this->htable_size = size;
-    this->htable = n_new_array(nStrList, size);
+    // empty
 }
 
 //------------------------------------------------------------------------------
@@ -45,11 +53,13 @@ nHashTable::nHashTable(int size)
 */
 inline nHashTable::~nHashTable()
 {
-    n_delete_array(this->htable);
+    // empty
 }
 
 //------------------------------------------------------------------------------
 /**
+    The old hash table function, not used by nHashTable anymore, but
+    other code relies on its exact values.
 */
 static
 inline
@@ -72,8 +82,20 @@ inline
 void
 nHashTable::Add(nStrNode* n)
 {
-    int h_index = hash(n->GetName(), this->htable_size);
-    this->htable[h_index].AddHead(n);
+    n_assert(n && n->GetName());
+    this->map.Add(n->GetName(), n);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+void
+nHashTable::Remove(nStrNode* n)
+{
+    n_assert(n && n->GetName());
+    bool removed = this->map.Remove(n->GetName(), n);
+    n_assert(removed);
 }
 
 //------------------------------------------------------------------------------
@@ -83,8 +105,9 @@ inline
 nStrNode*
 nHashTable::Find(const char* str) const
 {
-    int h_index = hash(str, this->htable_size);
-    return this->htable[h_index].Find(str);
+    nStrNode* n = 0;
+    this->map.Find(str, n);
+    return n;
 }
 
 //------------------------------------------------------------------------------
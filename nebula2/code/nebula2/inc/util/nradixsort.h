@@ -0,0 +1,142 @@
+#ifndef N_RADIXSORT_H
+#define N_RADIXSORT_H
+//------------------------------------------------------------------------------
+/**
+    @class nRadixSort
+    @ingroup NebulaDataTypes
+
+    @brief A stable LSD radix sort for 64 bit keys with an attached value.
+
+    Sorts a flat key array ascending in 8 passes of 8 bits each and applies
+    the same permutation to a value array (usually indices into some
+    other array). Passes in which all keys share the same digit are
+    skipped, so keys which only use a few bits are cheap to sort.
+    The object keeps its scratch buffers between calls, so keep one
+    object per thread around instead of creating one per sort.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+#include "util/narray.h"
+#include <string.h>
+
+//------------------------------------------------------------------------------
+template<class TYPE> class nRadixSort
+{
+public:
+    /// constructor
+    nRadixSort();
+    /// sort keys ascending and reorder values along with them
+    void Sort(uint64* keys, TYPE* values, int num);
+
+private:
+    enum
+    {
+        NumPasses = 8,
+        NumDigits = 256,
+    };
+
+    nArray<uint64> tmpKeys;
+    nArray<TYPE> tmpValues;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+nRadixSort<TYPE>::nRadixSort() :
+    tmpKeys(0, 0),
+    tmpValues(0, 0)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sort num keys ascending, values are permuted the same way. The sort
+    is stable, equal keys keep their relative order.
+*/
+template<class TYPE>
+void
+nRadixSort<TYPE>::Sort(uint64* keys, TYPE* values, int num)
+{
+    if (num < 2)
+    {
+        return;
+    }
+    if (this->tmpKeys.Size() < num)
+    {
+        this->tmpKeys.SetFixedSize(num);
+        this->tmpValues.SetFixedSize(num);
+    }
+
+    // build the histograms for all passes in one sweep
+    uint counts[NumPasses][NumDigits];
+    memset(counts, 0, sizeof(counts));
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        uint64 key = keys[i];
+        int pass;
+        for (pass = 0; pass < NumPasses; pass++)
+        {
+            counts[pass][(key >> (pass * 8)) & 0xff]++;
+        }
+    }
+
+    uint64* srcKeys = keys;
+    TYPE* srcValues = values;
+    uint64* dstKeys = &(this->tmpKeys[0]);
+    TYPE* dstValues = &(this->tmpValues[0]);
+    int pass;
+    for (pass = 0; pass < NumPasses; pass++)
+    {
+        uint* count = counts[pass];
+        int shift = pass * 8;
+
+        // skip the pass if all keys have the same digit
+        if (count[(srcKeys[0] >> shift) & 0xff] == uint(num))
+        {
+            continue;
+        }
+
+        // convert counts to offsets
+        uint offsets[NumDigits];
+        uint sum = 0;
+        int digit;
+        for (digit = 0; digit < NumDigits; digit++)
+        {
+            offsets[digit] = sum;
+            sum += count[digit];
+        }
+
+        // scatter
+        for (i = 0; i < num; i++)
+        {
+            uint dst = offsets[(srcKeys[i] >> shift) & 0xff]++;
+            dstKeys[dst] = srcKeys[i];
+            dstValues[dst] = srcValues[i];
+        }
+
+        // swap buffers
+        uint64* swapKeys = srcKeys;
+        srcKeys = dstKeys;
+        dstKeys = swapKeys;
+        TYPE* swapValues = srcValues;
+        srcValues = dstValues;
+        dstValues = swapValues;
+    }
+
+    // copy back if the result ended up in the scratch buffers
+    if (srcKeys != keys)
+    {
+        memcpy(keys, srcKeys, num * sizeof(uint64));
+        for (i = 0; i < num; i++)
+        {
+            values[i] = srcValues[i];
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+#endif
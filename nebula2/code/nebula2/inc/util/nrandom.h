@@ -0,0 +1,112 @@
+#ifndef N_RANDOM_H
+#define N_RANDOM_H
+//------------------------------------------------------------------------------
+/**
+    @class nRandom
+    @ingroup Util
+
+    @brief A small pseudo random number generator with its own state.
+
+    Unlike n_rand(), which goes through the C runtime's global rand()
+    state, every nRandom object produces its own reproducible sequence
+    (a 32 bit xorshift generator). Use it where results must not depend
+    on the order in which objects are updated, for instance when updating
+    objects on several threads.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+//------------------------------------------------------------------------------
+class nRandom
+{
+public:
+    /// constructor
+    nRandom();
+    /// constructor with seed
+    nRandom(uint seed);
+    /// set seed, restarts the sequence
+    void SetSeed(uint seed);
+    /// return next random integer
+    uint Next();
+    /// return random number between 0.0 and 1.0 (both included, like n_rand())
+    float Rand();
+    /// return random number between min and max
+    float Rand(float min, float max);
+
+private:
+    uint state;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nRandom::nRandom()
+{
+    this->SetSeed(0);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+nRandom::nRandom(uint seed)
+{
+    this->SetSeed(seed);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Xorshift generators must not have a state of 0, the seed is scrambled
+    so that neighbouring seeds don't produce similar sequences.
+*/
+inline
+void
+nRandom::SetSeed(uint seed)
+{
+    this->state = (seed * 2654435761u) ^ 0x9e3779b9;
+    if (0 == this->state)
+    {
+        this->state = 0x9e3779b9;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+uint
+nRandom::Next()
+{
+    uint x = this->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    this->state = x;
+    return x;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float
+nRandom::Rand()
+{
+    // use the upper 24 bits, they fit exactly into a float's mantissa
+    return float(this->Next() >> 8) * (1.0f / 16777215.0f);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+inline
+float
+nRandom::Rand(float min, float max)
+{
+    return min + this->Rand() * (max - min);
+}
+
+//------------------------------------------------------------------------------
+#endif
@@ -0,0 +1,395 @@
+#ifndef N_STRHASHMAP_H
+#define N_STRHASHMAP_H
+//------------------------------------------------------------------------------
+/**
+    @class nStrHashMap
+    @ingroup NebulaDataTypes
+
+    @brief An open addressing hash map from strings to values.
+
+    The map uses linear probing in a power of 2 sized table which doubles
+    when it gets 3/4 full. Every slot caches the hash of its key (FNV-1a),
+    so probing only compares strings on a hash match. Removing an entry
+    moves the following entries of the probe sequence back (backward
+    shift deletion), so no tombstones accumulate.
+
+    The keys are NOT copied, a key string must remain valid and unchanged
+    as long as its entry is in the map (for instance, the key can be
+    the name of the value object).
+
+    Several values can be added under the same key, in this case Find()
+    returns the most recently added value, like the old chained
+    nHashTable did.
+
+    (C) 2006 Nebula2 Community
+*/
+#include "kernel/ntypes.h"
+
+//------------------------------------------------------------------------------
+template<class TYPE>
+class nStrHashMap
+{
+public:
+    /// constructor
+    nStrHashMap();
+    /// constructor with expected number of entries
+    nStrHashMap(int numEntries);
+    /// destructor
+    ~nStrHashMap();
+    /// compute the hash of a string
+    static uint Hash(const char* str);
+    /// add a value under a key (the key string is not copied!)
+    void Add(const char* key, const TYPE& value);
+    /// find the most recently added value for a key, returns false if not found
+    bool Find(const char* key, TYPE& outValue) const;
+    /// return true if the key exists
+    bool Contains(const char* key) const;
+    /// remove the most recently added value for a key, returns false if not found
+    bool Remove(const char* key);
+    /// remove a specific key/value pair, returns false if not found
+    bool Remove(const char* key, const TYPE& value);
+    /// remove all entries
+    void Clear();
+    /// get number of entries
+    int Size() const;
+    /// get number of slots
+    int Capacity() const;
+
+private:
+    /// disabled copy constructor
+    nStrHashMap(const nStrHashMap& rhs);
+    /// disabled assignment operator
+    void operator=(const nStrHashMap& rhs);
+    /// allocate an empty table
+    void Alloc(int newCapacity);
+    /// move all entries into a larger table
+    void Grow();
+    /// find the slot of a key/value pair, -1 if not found
+    int FindSlot(uint hash, const char* key, const TYPE* value) const;
+    /// remove the entry at a slot index
+    void RemoveSlot(int slotIndex);
+
+    /// a table slot
+    struct Slot
+    {
+        uint hash;
+        const char* key;    ///< 0 if empty
+        TYPE value;
+    };
+
+    Slot* slots;
+    int capacity;           ///< always a power of 2
+    int numEntries;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+nStrHashMap<TYPE>::nStrHashMap() :
+    slots(0),
+    capacity(0),
+    numEntries(0)
+{
+    this->Alloc(16);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Pre-size the table so that the expected number of entries fits
+    without growing.
+*/
+template<class TYPE>
+nStrHashMap<TYPE>::nStrHashMap(int num) :
+    slots(0),
+    capacity(0),
+    numEntries(0)
+{
+    int newCapacity = 16;
+    while ((num * 4) > (newCapacity * 3))
+    {
+        newCapacity *= 2;
+    }
+    this->Alloc(newCapacity);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+nStrHashMap<TYPE>::~nStrHashMap()
+{
+    n_delete_array(this->slots);
+}
+
+//------------------------------------------------------------------------------
+/**
+    FNV-1a hash of a 0-terminated string.
+*/
+template<class TYPE>
+inline
+uint
+nStrHashMap<TYPE>::Hash(const char* str)
+{
+    n_assert(str);
+    uint hash = 2166136261u;
+    const uchar* ptr = (const uchar*) str;
+    while (*ptr)
+    {
+        hash = (hash ^ *ptr++) * 16777619u;
+    }
+    return hash;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+void
+nStrHashMap<TYPE>::Alloc(int newCapacity)
+{
+    n_assert(0 == (newCapacity & (newCapacity - 1)));
+    this->slots = n_new_array(Slot, newCapacity);
+    this->capacity = newCapacity;
+    this->numEntries = 0;
+    int i;
+    for (i = 0; i < newCapacity; i++)
+    {
+        this->slots[i].hash = 0;
+        this->slots[i].key = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Double the table size. The old table is traversed starting behind
+    an empty slot, so that entries with the same key are encountered
+    (and appended to the new table) in their probe order, which keeps
+    the most recently added value in front.
+*/
+template<class TYPE>
+void
+nStrHashMap<TYPE>::Grow()
+{
+    Slot* oldSlots = this->slots;
+    int oldCapacity = this->capacity;
+    int oldNumEntries = this->numEntries;
+    this->Alloc(oldCapacity * 2);
+
+    int start = 0;
+    while (oldSlots[start].key)
+    {
+        start++;
+    }
+    uint mask = this->capacity - 1;
+    int i;
+    for (i = 1; i <= oldCapacity; i++)
+    {
+        const Slot& oldSlot = oldSlots[(start + i) & (oldCapacity - 1)];
+        if (oldSlot.key)
+        {
+            uint slotIndex = oldSlot.hash & mask;
+            while (this->slots[slotIndex].key)
+            {
+                slotIndex = (slotIndex + 1) & mask;
+            }
+            this->slots[slotIndex] = oldSlot;
+        }
+    }
+    this->numEntries = oldNumEntries;
+    n_delete_array(oldSlots);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add a value. If the key already exists, the new value takes the
+    place of the first existing one, and the existing values move one
+    step further along the probe sequence.
+*/
+template<class TYPE>
+void
+nStrHashMap<TYPE>::Add(const char* key, const TYPE& value)
+{
+    n_assert(key);
+    if (((this->numEntries + 1) * 4) > (this->capacity * 3))
+    {
+        this->Grow();
+    }
+
+    Slot entry;
+    entry.hash = Hash(key);
+    entry.key = key;
+    entry.value = value;
+
+    uint mask = this->capacity - 1;
+    uint slotIndex = entry.hash & mask;
+    while (this->slots[slotIndex].key)
+    {
+        Slot& slot = this->slots[slotIndex];
+        if ((slot.hash == entry.hash) && (0 == strcmp(slot.key, entry.key)))
+        {
+            Slot tmp = slot;
+            slot = entry;
+            entry = tmp;
+        }
+        slotIndex = (slotIndex + 1) & mask;
+    }
+    this->slots[slotIndex] = entry;
+    this->numEntries++;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Find the slot of a key, and of a specific value if value is not 0.
+*/
+template<class TYPE>
+int
+nStrHashMap<TYPE>::FindSlot(uint hash, const char* key, const TYPE* value) const
+{
+    uint mask = this->capacity - 1;
+    uint slotIndex = hash & mask;
+    while (this->slots[slotIndex].key)
+    {
+        const Slot& slot = this->slots[slotIndex];
+        if ((slot.hash == hash) &&
+            (0 == strcmp(slot.key, key)) &&
+            ((0 == value) || (slot.value == *value)))
+        {
+            return slotIndex;
+        }
+        slotIndex = (slotIndex + 1) & mask;
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+bool
+nStrHashMap<TYPE>::Find(const char* key, TYPE& outValue) const
+{
+    n_assert(key);
+    int slotIndex = this->FindSlot(Hash(key), key, 0);
+    if (-1 != slotIndex)
+    {
+        outValue = this->slots[slotIndex].value;
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+bool
+nStrHashMap<TYPE>::Contains(const char* key) const
+{
+    n_assert(key);
+    return (-1 != this->FindSlot(Hash(key), key, 0));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Backward shift deletion: move entries behind the removed slot back
+    into the gap unless that would move them in front of their home
+    slot.
+*/
+template<class TYPE>
+void
+nStrHashMap<TYPE>::RemoveSlot(int slotIndex)
+{
+    uint mask = this->capacity - 1;
+    uint gap = slotIndex;
+    uint cur = (gap + 1) & mask;
+    while (this->slots[cur].key)
+    {
+        uint home = this->slots[cur].hash & mask;
+        // distance from home to cur, and from the gap to cur
+        if (((cur - home) & mask) >= ((cur - gap) & mask))
+        {
+            this->slots[gap] = this->slots[cur];
+            gap = cur;
+        }
+        cur = (cur + 1) & mask;
+    }
+    this->slots[gap].hash = 0;
+    this->slots[gap].key = 0;
+    this->numEntries--;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+bool
+nStrHashMap<TYPE>::Remove(const char* key)
+{
+    n_assert(key);
+    int slotIndex = this->FindSlot(Hash(key), key, 0);
+    if (-1 != slotIndex)
+    {
+        this->RemoveSlot(slotIndex);
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+bool
+nStrHashMap<TYPE>::Remove(const char* key, const TYPE& value)
+{
+    n_assert(key);
+    int slotIndex = this->FindSlot(Hash(key), key, &value);
+    if (-1 != slotIndex)
+    {
+        this->RemoveSlot(slotIndex);
+        return true;
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+void
+nStrHashMap<TYPE>::Clear()
+{
+    int i;
+    for (i = 0; i < this->capacity; i++)
+    {
+        this->slots[i].hash = 0;
+        this->slots[i].key = 0;
+    }
+    this->numEntries = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+inline
+int
+nStrHashMap<TYPE>::Size() const
+{
+    return this->numEntries;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+template<class TYPE>
+inline
+int
+nStrHashMap<TYPE>::Capacity() const
+{
+    return this->capacity;
+}
+
+//------------------------------------------------------------------------------
+#endif
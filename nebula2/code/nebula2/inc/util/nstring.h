@@ -1115,7 +1115,7 @@ nString::TrimRight(const char* charSet) const
     int charSetLen = strlen(charSet);
     int thisIndex = this->Length() - 1;
     bool stopped = false;
-    while (!stopped && (thisIndex < this->Length()))
+    while (!stopped && (thisIndex >= 0))
     {
         int charSetIndex;
         bool match = false;
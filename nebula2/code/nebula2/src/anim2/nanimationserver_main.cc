@@ -13,7 +13,8 @@ nAnimationServer* nAnimationServer::Singleton = 0;
 /**
 */
 nAnimationServer::nAnimationServer() :
-    refResourceServer("/sys/servers/resource")
+    refResourceServer("/sys/servers/resource"),
+    packKeys(true)
 {
     n_assert(0 == Singleton);
     Singleton = this;
@@ -3,6 +3,7 @@
 //  (C) 2003 RadonLabs GmbH
 //------------------------------------------------------------------------------
 #include "anim2/ncombinedanimation.h"
+#include "anim2/nanimationserver.h"
 #include "kernel/nfileserver2.h"
 #include "kernel/nfile.h"
 #include "mathlib/quaternion.h"
@@ -72,6 +73,9 @@ nCombinedAnimation::AddAnim(nMemoryAnimation* animation)
 
 //------------------------------------------------------------------------------
 /**
+    Groups with packed keys are copied as they are, the raw keys of
+    unpacked groups are appended to the key array and packed at the end
+    (if key packing is enabled on the animation server).
 */
 void
 nCombinedAnimation::EndAnims()
@@ -88,6 +92,7 @@ nCombinedAnimation::EndAnims()
 
     this->SetNumGroups(numGroups);
     this->keyArray.SetFixedSize(numKeys);
+    this->packedGroups.SetFixedSize(numGroups);
 
     // copy all data
     int currentGroup = 0;
@@ -127,6 +132,12 @@ nCombinedAnimation::EndAnims()
                 dstCurve.SetIsAnimated(srcCurve.IsAnimated());
             };
 
+            // copy packed keys
+            if (this->animPtrs[i]->IsGroupPacked(k))
+            {
+                this->packedGroups[currentGroup] = this->animPtrs[i]->GetPackedGroup(k);
+            }
+
             currentGroup++;
         };
         // copy keys
@@ -136,6 +147,11 @@ nCombinedAnimation::EndAnims()
             currentKey++;
         };
     };
+    if (nAnimationServer::Instance()->GetPackKeys())
+    {
+        this->PackKeys();
+    }
+    this->UpdateStartValues();
 
     // lets print some stats
     int numg = this->GetNumGroups();
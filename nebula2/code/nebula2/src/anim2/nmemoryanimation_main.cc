@@ -3,6 +3,7 @@
 //  (C) 2003 RadonLabs GmbH
 //------------------------------------------------------------------------------
 #include "anim2/nmemoryanimation.h"
+#include "anim2/nanimationserver.h"
 #include "kernel/nfileserver2.h"
 #include "kernel/nfile.h"
 #include "mathlib/quaternion.h"
@@ -13,7 +14,8 @@ nNebulaClass(nMemoryAnimation, "nanimation");
 /**
 */
 nMemoryAnimation::nMemoryAnimation() :
-    keyArray(0, 0)
+    keyArray(0, 0),
+    packedGroups(0, 0)
 {
     // empty
 }
@@ -29,6 +31,18 @@ nMemoryAnimation::~nMemoryAnimation()
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+    Binary nax2 files can be loaded by the resource server's loader jobs.
+    The nanim2 parser uses strtok(), which is not thread safe on all
+    platforms, so nanim2 files are always loaded synchronously.
+*/
+bool
+nMemoryAnimation::CanLoadAsync() const
+{
+    return ((nMemoryAnimation*)this)->GetFilename().CheckExtension("nax2");
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -49,6 +63,11 @@ nMemoryAnimation::LoadResource()
     }
     if (success)
     {
+        if (nAnimationServer::Instance()->GetPackKeys())
+        {
+            this->PackKeys();
+        }
+        this->UpdateStartValues();
         this->SetState(Valid);
     }
     return success;
@@ -64,6 +83,7 @@ nMemoryAnimation::UnloadResource()
     {
         nAnimation::UnloadResource();
         this->keyArray.Clear();
+        this->packedGroups.Clear();
         this->SetState(Unloaded);
     }
 }
@@ -95,7 +115,7 @@ nMemoryAnimation::LoadNanim2(const nString& filename)
     int keyIndex   = 0;
     Group* curGroup = 0;
     Curve* curCurve = 0;
-    static vector4 vec4;
+    vector4 vec4;
     while (file->GetS(line, sizeof(line)))
     {
         // get keyword
@@ -278,7 +298,23 @@ nMemoryAnimation::LoadNax2(const nString& filename)
         group.SetLoopType((Group::LoopType) loopType);
     }
 
-    // read curves
+    // read curves, the curve block is accessed directly in the
+    // memory mapped npk file if possible
+    const int curveSize = 7 * sizeof(int);
+    int totalNumCurves = 0;
+    for (groupIndex = 0; groupIndex < numGroups; groupIndex++)
+    {
+        totalNumCurves += this->GetGroupAt(groupIndex).GetNumCurves();
+    }
+    int curveBlockSize = totalNumCurves * curveSize;
+    const int* curveData = (const int*) file->ReadMapped(curveBlockSize);
+    int* curveBuffer = 0;
+    if ((0 == curveData) && (curveBlockSize > 0))
+    {
+        curveBuffer = (int*) n_malloc(curveBlockSize);
+        file->Read(curveBuffer, curveBlockSize);
+        curveData = curveBuffer;
+    }
     for (groupIndex = 0; groupIndex < numGroups; groupIndex++)
     {
         Group& group = this->GetGroupAt(groupIndex);
@@ -286,14 +322,13 @@ nMemoryAnimation::LoadNax2(const nString& filename)
         int curveIndex;
         for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
         {
-            static vector4 collapsedKey;
-            int ipolType = file->GetInt();
-            int firstKeyIndex = file->GetInt();
-            int isAnim = file->GetInt();
-            collapsedKey.x = file->GetFloat();
-            collapsedKey.y = file->GetFloat();
-            collapsedKey.z = file->GetFloat();
-            collapsedKey.w = file->GetFloat();
+            vector4 collapsedKey;
+            int ipolType = curveData[0];
+            int firstKeyIndex = curveData[1];
+            int isAnim = curveData[2];
+            const float* constValue = (const float*) &(curveData[3]);
+            collapsedKey.set(constValue[0], constValue[1], constValue[2], constValue[3]);
+            curveData += 7;
 
             Curve& curve = group.GetCurveAt(curveIndex);
             curve.SetIpolType((Curve::IpolType) ipolType);
@@ -302,6 +337,10 @@ nMemoryAnimation::LoadNax2(const nString& filename)
             curve.SetFirstKeyIndex(firstKeyIndex);
         }
     }
+    if (curveBuffer)
+    {
+        n_free(curveBuffer);
+    }
 
     // read keys
     if (numKeys > 0)
@@ -320,7 +359,10 @@ nMemoryAnimation::LoadNax2(const nString& filename)
 /**
     Samples the current values for a number of curves in the given
     animation group. The sampled values will be written to a client provided
-    vector4 array.
+    vector4 array. The animation object itself is only read and all
+    temporary values live on the stack, so any number of threads may
+    sample the same animation at the same time. The curve start values
+    are computed once at load time by UpdateStartValues().
 
     @param  time                a point in time
     @param  groupIndex          index of animation group to sample from
@@ -336,34 +378,35 @@ nMemoryAnimation::LoadNax2(const nString& filename)
                             linear interpolation!!
 */
 void
-nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* dstKeyArray)
+nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex, int numCurves, vector4* dstKeyArray) const
 {
-    // convert the time into 2 global key indexes and an inbetween value
     const Group& group = this->GetGroupAt(groupIndex);
-    int startKey = group.GetStartKey();
-    double frameTime = startKey * group.GetKeyTime();
+    if (this->IsGroupPacked(groupIndex))
+    {
+        int frame[2];
+        float inbetween;
+        group.TimeToFrame(time, frame[0], frame[1], inbetween);
+        this->packedGroups[groupIndex].Sample(frame[0], frame[1], inbetween, firstCurveIndex, numCurves, dstKeyArray);
+        return;
+    }
+
+    // convert the time into 2 global key indexes and an inbetween value
     int keyIndex[2];
-    int startKeyIndex[2];
-    float startInbetween;
     float inbetween;
-    ///calculation for start values of the curves (time 0)
-    group.TimeToIndex(0.0f, startKeyIndex[0], startKeyIndex[1], startInbetween);
     group.TimeToIndex(time, keyIndex[0], keyIndex[1], inbetween);
 
     int i;
-    static quaternion q0;
-    static quaternion q1;
-    static quaternion q;
-    int animCount = 0;
+    quaternion q0;
+    quaternion q1;
+    quaternion q;
     for (i = 0; i < numCurves; i++)
     {
-       Curve& curve = group.GetCurveAt(i + firstCurveIndex);
+       const Curve& curve = group.GetCurveAt(i + firstCurveIndex);
 
        if (curve.GetFirstKeyIndex() == -1)
        {
            // a collapsed curve
            dstKeyArray[i] = curve.GetConstValue();
-           curve.SetStartValue(curve.GetConstValue());
        }
        else
        {
@@ -373,9 +416,6 @@ nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex,
                {
                    int index0 = curve.GetFirstKeyIndex() + keyIndex[0];
                    dstKeyArray[i] = this->keyArray[index0];
-
-                   index0 = curve.GetFirstKeyIndex();
-                   curve.SetStartValue(this->keyArray[index0]);
                }
                break;
 
@@ -388,14 +428,6 @@ nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex,
                    q1.set(this->keyArray[index1].x, this->keyArray[index1].y, this->keyArray[index1].z, this->keyArray[index1].w);
                    q.slerp(q0, q1, inbetween);
                    dstKeyArray[i].set(q.x, q.y, q.z, q.w);
-
-                   index0 = curveFirstKeyIndex + startKeyIndex[0];
-                   index1 = curveFirstKeyIndex + startKeyIndex[1];
-                   q0.set(this->keyArray[index0].x, this->keyArray[index0].y, this->keyArray[index0].z, this->keyArray[index0].w);
-                   q1.set(this->keyArray[index1].x, this->keyArray[index1].y, this->keyArray[index1].z, this->keyArray[index1].w);
-                   q.slerp(q0, q1, startInbetween);
-                   vector4 val(q.x, q.y, q.z, q.w);
-                   curve.SetStartValue(val);
                }
                break;
 
@@ -407,12 +439,6 @@ nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex,
                    const vector4& v0 = this->keyArray[index0];
                    const vector4& v1 = this->keyArray[index1];
                    dstKeyArray[i] = v0 + ((v1 - v0) * inbetween);
-
-                   index0 = curveFirstKeyIndex + startKeyIndex[0];
-                   index1 = curveFirstKeyIndex + startKeyIndex[1];
-                   vector4& v2 = this->keyArray[index0];
-                   vector4& v3 = this->keyArray[index1];
-                   curve.SetStartValue(v2 + ((v3 - v2) * startInbetween));
                }
                break;
 
@@ -424,11 +450,114 @@ nMemoryAnimation::SampleCurves(float time, int groupIndex, int firstCurveIndex,
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+    Sample all curves at time 0 and store the results as the curves' start
+    values. This is done once after loading instead of in every
+    SampleCurves() call, so that sampling never writes to the (shared)
+    animation object.
+*/
+void
+nMemoryAnimation::UpdateStartValues()
+{
+    nArray<vector4> values(0, 0);
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < this->GetNumGroups(); groupIndex++)
+    {
+        const Group& group = this->GetGroupAt(groupIndex);
+        int numCurves = group.GetNumCurves();
+        if (0 == numCurves)
+        {
+            continue;
+        }
+        if (values.Size() < numCurves)
+        {
+            values.SetFixedSize(numCurves);
+        }
+        if (group.GetNumKeys() > 0)
+        {
+            this->SampleCurves(0.0f, groupIndex, 0, numCurves, &(values[0]));
+        }
+        int curveIndex;
+        for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+        {
+            Curve& curve = group.GetCurveAt(curveIndex);
+            if (group.GetNumKeys() > 0)
+            {
+                curve.SetStartValue(values[curveIndex]);
+            }
+            else
+            {
+                curve.SetStartValue(curve.GetConstValue());
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compress the keys of all groups which haven't been packed yet into
+    nPackedAnimGroup objects. Collapsed curves become constant curves.
+    Afterwards all groups are packed and the raw key array is released,
+    SampleCurves() then reads from the packed groups.
+*/
+void
+nMemoryAnimation::PackKeys()
+{
+    int numGroups = this->GetNumGroups();
+    if (this->packedGroups.Size() != numGroups)
+    {
+        n_assert(0 == this->packedGroups.Size());
+        this->packedGroups.SetFixedSize(numGroups);
+    }
+
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < numGroups; groupIndex++)
+    {
+        nPackedAnimGroup& packedGroup = this->packedGroups[groupIndex];
+        if (packedGroup.IsValid())
+        {
+            continue;
+        }
+
+        const Group& group = this->GetGroupAt(groupIndex);
+        int numCurves = group.GetNumCurves();
+        int numKeys = group.GetNumKeys();
+        int keyStride = group.GetKeyStride();
+        packedGroup.Begin(numCurves, numKeys);
+        int curveIndex;
+        for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+        {
+            const Curve& curve = group.GetCurveAt(curveIndex);
+            int firstKeyIndex = curve.GetFirstKeyIndex();
+            if ((-1 == firstKeyIndex) || (0 == numKeys))
+            {
+                packedGroup.SetConstCurve(curveIndex, curve.GetConstValue());
+            }
+            else
+            {
+                n_assert((firstKeyIndex + (numKeys - 1) * keyStride) < this->keyArray.Size());
+                packedGroup.SetCurve(curveIndex, curve.GetIpolType(), &(this->keyArray[firstKeyIndex]), keyStride);
+            }
+        }
+        packedGroup.End();
+    }
+
+    // release the raw keys
+    this->keyArray.SetFixedSize(0);
+}
+
 //------------------------------------------------------------------------------
 /**
 */
 int
 nMemoryAnimation::GetByteSize()
 {
-    return this->keyArray.Size() * sizeof(vector4);
+    int size = this->keyArray.Size() * sizeof(vector4);
+    int i;
+    for (i = 0; i < this->packedGroups.Size(); i++)
+    {
+        size += this->packedGroups[i].GetByteSize();
+    }
+    return size;
 }
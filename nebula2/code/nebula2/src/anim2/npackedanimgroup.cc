@@ -0,0 +1,577 @@
+//------------------------------------------------------------------------------
+//  npackedanimgroup.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "anim2/npackedanimgroup.h"
+#include <string.h>
+#ifdef __NEBULA_ANIM_SSE__
+#include <xmmintrin.h>
+#endif
+
+/// curves whose keys don't differ by more than this are stored as constants
+static const float ConstTolerance = 0.00001f;
+/// sqrt(2), the 3 smallest quaternion components are inside [-1/sqrt(2), 1/sqrt(2)]
+static const float Sqrt2 = 1.41421356f;
+
+//------------------------------------------------------------------------------
+/**
+*/
+nPackedAnimGroup::nPackedAnimGroup() :
+    curves(0, 0),
+    sourceCurves(0, 0),
+    keys(0, 0),
+    numKeys(0),
+    frameSize(0),
+    isValid(false)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nPackedAnimGroup::~nPackedAnimGroup()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nPackedAnimGroup::GetKeySize(Format format)
+{
+    switch (format)
+    {
+        case Constant:  return 0;
+        case Quat48:    return 3 * sizeof(ushort);
+        case Range16:   return 4 * sizeof(ushort);
+        default:        return sizeof(float4);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Begin packing a group. All curves of the group must then be defined
+    with SetCurve() or SetConstCurve() before calling End().
+*/
+void
+nPackedAnimGroup::Begin(int numCurves, int numKeys)
+{
+    n_assert(numCurves >= 0);
+    n_assert(numKeys >= 0);
+    this->curves.SetFixedSize(numCurves);
+    this->sourceCurves.SetFixedSize(numCurves);
+    this->keys.SetFixedSize(0);
+    this->numKeys = numKeys;
+    this->frameSize = 0;
+    this->isValid = false;
+
+    int curveIndex;
+    for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+    {
+        this->SetConstCurve(curveIndex, vector4(0.0f, 0.0f, 0.0f, 0.0f));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Define an animated curve. The storage format is chosen from the
+    interpolation type and the value range of the keys.
+*/
+void
+nPackedAnimGroup::SetCurve(int curveIndex, nAnimation::Curve::IpolType ipolType, const vector4* keys, int keyStride)
+{
+    n_assert(!this->isValid);
+    n_assert(keys);
+    if (0 == this->numKeys)
+    {
+        this->SetConstCurve(curveIndex, keys[0]);
+        return;
+    }
+
+    // find the value range
+    vector4 minVec = keys[0];
+    vector4 maxVec = keys[0];
+    int keyIndex;
+    for (keyIndex = 1; keyIndex < this->numKeys; keyIndex++)
+    {
+        const vector4& key = keys[keyIndex * keyStride];
+        minVec.minimum(key);
+        maxVec.maximum(key);
+    }
+    vector4 range = maxVec - minVec;
+    if ((range.x <= ConstTolerance) && (range.y <= ConstTolerance) &&
+        (range.z <= ConstTolerance) && (range.w <= ConstTolerance))
+    {
+        this->SetConstCurve(curveIndex, keys[0]);
+        return;
+    }
+
+    CurveInfo& info = this->curves[curveIndex];
+    info.ipolType = ipolType;
+    info.byteOffset = 0;
+    info.rangeMin.set(0.0f, 0.0f, 0.0f, 0.0f);
+    info.rangeScale.set(0.0f, 0.0f, 0.0f, 0.0f);
+    switch (ipolType)
+    {
+        case nAnimation::Curve::Quat:
+            info.format = Quat48;
+            break;
+
+        case nAnimation::Curve::Linear:
+            info.format = Range16;
+            info.rangeMin = minVec;
+            info.rangeScale = range * (1.0f / 65535.0f);
+            break;
+
+        default:
+            info.format = Raw;
+            break;
+    }
+    this->sourceCurves[curveIndex].keys = keys;
+    this->sourceCurves[curveIndex].keyStride = keyStride;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nPackedAnimGroup::SetConstCurve(int curveIndex, const vector4& value)
+{
+    n_assert(!this->isValid);
+    CurveInfo& info = this->curves[curveIndex];
+    info.format = Constant;
+    info.ipolType = nAnimation::Curve::None;
+    info.byteOffset = 0;
+    info.rangeMin = value;
+    info.rangeScale.set(0.0f, 0.0f, 0.0f, 0.0f);
+    this->sourceCurves[curveIndex].keys = 0;
+    this->sourceCurves[curveIndex].keyStride = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Lay out the frames and encode all keys. The source keys are no longer
+    referenced afterwards.
+*/
+void
+nPackedAnimGroup::End()
+{
+    n_assert(!this->isValid);
+    int numCurves = this->curves.Size();
+    int curveIndex;
+    this->frameSize = 0;
+    for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+    {
+        CurveInfo& info = this->curves[curveIndex];
+        info.byteOffset = this->frameSize;
+        this->frameSize += GetKeySize((Format) info.format);
+    }
+
+    this->keys.SetFixedSize(this->numKeys * this->frameSize);
+    if (this->frameSize > 0)
+    {
+        for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+        {
+            const CurveInfo& info = this->curves[curveIndex];
+            const SourceCurve& src = this->sourceCurves[curveIndex];
+            if (Constant != info.format)
+            {
+                int keyIndex;
+                for (keyIndex = 0; keyIndex < this->numKeys; keyIndex++)
+                {
+                    uchar* dst = &(this->keys[keyIndex * this->frameSize + info.byteOffset]);
+                    this->EncodeKey(info, src.keys[keyIndex * src.keyStride], dst);
+                }
+            }
+        }
+    }
+    this->sourceCurves.SetFixedSize(0);
+    this->isValid = true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nPackedAnimGroup::EncodeKey(const CurveInfo& info, const vector4& key, uchar* dst) const
+{
+    switch (info.format)
+    {
+        case Quat48:
+        {
+            // normalize and find the largest component
+            float q[4] = { key.x, key.y, key.z, key.w };
+            float len = n_sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+            if (len > 0.0f)
+            {
+                float oneDivLen = 1.0f / len;
+                q[0] *= oneDivLen; q[1] *= oneDivLen; q[2] *= oneDivLen; q[3] *= oneDivLen;
+            }
+            else
+            {
+                q[0] = 0.0f; q[1] = 0.0f; q[2] = 0.0f; q[3] = 1.0f;
+            }
+            int largest = 0;
+            int i;
+            for (i = 1; i < 4; i++)
+            {
+                if (n_abs(q[i]) > n_abs(q[largest]))
+                {
+                    largest = i;
+                }
+            }
+
+            // store the 3 smallest components with 15 bits each, the
+            // index of the largest one in bit 15 of the first 2 words and
+            // its sign in bit 15 of the last word (the sign is kept so that
+            // the original hemisphere survives for blending)
+            ushort words[3];
+            int w = 0;
+            for (i = 0; i < 4; i++)
+            {
+                if (i != largest)
+                {
+                    int v = int((q[i] * Sqrt2 * 0.5f + 0.5f) * 32767.0f + 0.5f);
+                    words[w++] = ushort(n_iclamp(v, 0, 32767));
+                }
+            }
+            words[0] |= ushort((largest & 1) << 15);
+            words[1] |= ushort((largest >> 1) << 15);
+            if (q[largest] < 0.0f)
+            {
+                words[2] |= 0x8000;
+            }
+            memcpy(dst, words, sizeof(words));
+        }
+        break;
+
+        case Range16:
+        {
+            const float src[4] = { key.x, key.y, key.z, key.w };
+            const float min[4] = { info.rangeMin.x, info.rangeMin.y, info.rangeMin.z, info.rangeMin.w };
+            const float scale[4] = { info.rangeScale.x, info.rangeScale.y, info.rangeScale.z, info.rangeScale.w };
+            ushort words[4];
+            int i;
+            for (i = 0; i < 4; i++)
+            {
+                int v = 0;
+                if (scale[i] > 0.0f)
+                {
+                    v = int((src[i] - min[i]) / scale[i] + 0.5f);
+                }
+                words[i] = ushort(n_iclamp(v, 0, 65535));
+            }
+            memcpy(dst, words, sizeof(words));
+        }
+        break;
+
+        case Raw:
+        {
+            const float src[4] = { key.x, key.y, key.z, key.w };
+            memcpy(dst, src, sizeof(src));
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nPackedAnimGroup::DecodeKey(const CurveInfo& info, const uchar* src, vector4& dst) const
+{
+    switch (info.format)
+    {
+        case Quat48:
+        {
+            ushort words[3];
+            memcpy(words, src, sizeof(words));
+            int largest = (words[0] >> 15) | ((words[1] >> 15) << 1);
+            float q[4];
+            float sum = 0.0f;
+            int w = 0;
+            int i;
+            for (i = 0; i < 4; i++)
+            {
+                if (i != largest)
+                {
+                    float c = (float(words[w++] & 0x7fff) * (1.0f / 32767.0f) - 0.5f) * Sqrt2;
+                    q[i] = c;
+                    sum += c * c;
+                }
+            }
+            q[largest] = n_sqrt(n_max(0.0f, 1.0f - sum));
+            if (words[2] & 0x8000)
+            {
+                q[largest] = -q[largest];
+            }
+            dst.set(q[0], q[1], q[2], q[3]);
+        }
+        break;
+
+        case Range16:
+        {
+            ushort words[4];
+            memcpy(words, src, sizeof(words));
+            dst.set(info.rangeMin.x + float(words[0]) * info.rangeScale.x,
+                    info.rangeMin.y + float(words[1]) * info.rangeScale.y,
+                    info.rangeMin.z + float(words[2]) * info.rangeScale.z,
+                    info.rangeMin.w + float(words[3]) * info.rangeScale.w);
+        }
+        break;
+
+        case Raw:
+        {
+            float f[4];
+            memcpy(f, src, sizeof(f));
+            dst.set(f[0], f[1], f[2], f[3]);
+        }
+        break;
+
+        default:
+            dst = info.rangeMin;
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Decode a single key, mainly for tools which need to measure the
+    compression error.
+*/
+void
+nPackedAnimGroup::GetKey(int curveIndex, int keyIndex, vector4& dst) const
+{
+    n_assert(this->isValid);
+    n_assert((keyIndex >= 0) && (keyIndex < this->numKeys));
+    const CurveInfo& info = this->curves[curveIndex];
+    const uchar* src = 0;
+    if (Constant != info.format)
+    {
+        src = &(this->keys[keyIndex * this->frameSize + info.byteOffset]);
+    }
+    this->DecodeKey(info, src, dst);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the blend weights of the 2 keys of a curve. Quaternions must
+    already have been moved into the same hemisphere, cosTheta is their
+    (positive) dot product. Matches the weights of quaternion::slerp().
+*/
+static inline
+void
+ComputeWeights(int ipolType, float cosTheta, float l, float& scale0, float& scale1)
+{
+    switch (ipolType)
+    {
+        case nAnimation::Curve::Quat:
+            if ((1.0f - cosTheta) < 0.05f)
+            {
+                // quaternions are close, use linear interpolation
+                scale0 = 1.0f - l;
+                scale1 = l;
+            }
+            else
+            {
+                float theta = n_acos(cosTheta);
+                float sinTheta = n_sin(theta);
+                scale0 = n_sin(theta * (1.0f - l)) / sinTheta;
+                scale1 = n_sin(theta * l) / sinTheta;
+            }
+            break;
+
+        case nAnimation::Curve::Linear:
+            scale0 = 1.0f - l;
+            scale1 = l;
+            break;
+
+        default:
+            // constant and step curves only use the first key
+            scale0 = 1.0f;
+            scale1 = 0.0f;
+            break;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample numCurves curves between 2 keys. Quat curves are slerped along
+    the shortest path (like quaternion::slerp()), linear curves are lerped,
+    step and constant curves return the first key.
+*/
+void
+nPackedAnimGroup::Sample(int keyIndex0, int keyIndex1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const
+{
+    n_assert(this->isValid);
+    n_assert(dst);
+    n_assert((firstCurveIndex >= 0) && ((firstCurveIndex + numCurves) <= this->curves.Size()));
+    const uchar* frame0 = 0;
+    const uchar* frame1 = 0;
+    if (this->frameSize > 0)
+    {
+        n_assert((keyIndex0 >= 0) && (keyIndex0 < this->numKeys));
+        n_assert((keyIndex1 >= 0) && (keyIndex1 < this->numKeys));
+        frame0 = &(this->keys[keyIndex0 * this->frameSize]);
+        frame1 = &(this->keys[keyIndex1 * this->frameSize]);
+    }
+    #ifdef __NEBULA_ANIM_SSE__
+    this->SampleSSE(frame0, frame1, inbetween, firstCurveIndex, numCurves, dst);
+    #else
+    this->SampleScalar(frame0, frame1, inbetween, firstCurveIndex, numCurves, dst);
+    #endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Scalar reference implementation of the curve sampler. The SSE version
+    must produce exactly the same results.
+*/
+void
+nPackedAnimGroup::SampleScalar(const uchar* frame0, const uchar* frame1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const
+{
+    int i;
+    for (i = 0; i < numCurves; i++)
+    {
+        const CurveInfo& info = this->curves[firstCurveIndex + i];
+        vector4 k0;
+        vector4 k1;
+        if (Constant == info.format)
+        {
+            k0 = info.rangeMin;
+            k1 = k0;
+        }
+        else
+        {
+            this->DecodeKey(info, frame0 + info.byteOffset, k0);
+            this->DecodeKey(info, frame1 + info.byteOffset, k1);
+        }
+
+        float cosTheta = k0.x * k1.x + k0.y * k1.y + k0.z * k1.z + k0.w * k1.w;
+        if ((nAnimation::Curve::Quat == info.ipolType) && (cosTheta < 0.0f))
+        {
+            // flip start quaternion
+            k0.set(-k0.x, -k0.y, -k0.z, -k0.w);
+            cosTheta = -cosTheta;
+        }
+        float scale0, scale1;
+        ComputeWeights(info.ipolType, cosTheta, inbetween, scale0, scale1);
+        dst[i].set(scale0 * k0.x + scale1 * k1.x,
+                   scale0 * k0.y + scale1 * k1.y,
+                   scale0 * k0.z + scale1 * k1.z,
+                   scale0 * k0.w + scale1 * k1.w);
+    }
+}
+
+#ifdef __NEBULA_ANIM_SSE__
+//------------------------------------------------------------------------------
+/**
+    SSE version of the curve sampler, processes 4 curves at a time.
+    The keys are decoded into a small staging buffer and transposed so
+    that each register holds one component of 4 curves, the dot products,
+    hemisphere flips and the final blend are done 4 wide. Only the
+    acos/sin for quaternions which are far apart stays scalar.
+*/
+void
+nPackedAnimGroup::SampleSSE(const uchar* frame0, const uchar* frame1, float inbetween, int firstCurveIndex, int numCurves, vector4* dst) const
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    float keys0[4][4];
+    float keys1[4][4];
+    int ipolTypes[4];
+    float quatMask[4];
+    float cosTheta[4];
+    float scale0[4];
+    float scale1[4];
+    float result[4][4];
+
+    int i;
+    for (i = 0; i < numCurves; i += 4)
+    {
+        int numLanes = n_min(4, numCurves - i);
+
+        // decode keys of up to 4 curves, unused lanes are constant 0
+        int lane;
+        for (lane = 0; lane < 4; lane++)
+        {
+            vector4 k0(0.0f, 0.0f, 0.0f, 0.0f);
+            vector4 k1(0.0f, 0.0f, 0.0f, 0.0f);
+            ipolTypes[lane] = nAnimation::Curve::None;
+            if (lane < numLanes)
+            {
+                const CurveInfo& info = this->curves[firstCurveIndex + i + lane];
+                ipolTypes[lane] = info.ipolType;
+                if (Constant == info.format)
+                {
+                    k0 = info.rangeMin;
+                    k1 = k0;
+                }
+                else
+                {
+                    this->DecodeKey(info, frame0 + info.byteOffset, k0);
+                    this->DecodeKey(info, frame1 + info.byteOffset, k1);
+                }
+            }
+            keys0[lane][0] = k0.x; keys0[lane][1] = k0.y; keys0[lane][2] = k0.z; keys0[lane][3] = k0.w;
+            keys1[lane][0] = k1.x; keys1[lane][1] = k1.y; keys1[lane][2] = k1.z; keys1[lane][3] = k1.w;
+            // all bits set for quaternion lanes
+            int bits = (nAnimation::Curve::Quat == ipolTypes[lane]) ? -1 : 0;
+            memcpy(&quatMask[lane], &bits, sizeof(float));
+        }
+
+        // transpose to x, y, z, w of 4 curves
+        __m128 x0 = _mm_loadu_ps(keys0[0]);
+        __m128 y0 = _mm_loadu_ps(keys0[1]);
+        __m128 z0 = _mm_loadu_ps(keys0[2]);
+        __m128 w0 = _mm_loadu_ps(keys0[3]);
+        _MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+        __m128 x1 = _mm_loadu_ps(keys1[0]);
+        __m128 y1 = _mm_loadu_ps(keys1[1]);
+        __m128 z1 = _mm_loadu_ps(keys1[2]);
+        __m128 w1 = _mm_loadu_ps(keys1[3]);
+        _MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+
+        // dot products, flip start quaternions of quat lanes with a negative dot
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_mul_ps(z0, z1)), _mm_mul_ps(w0, w1));
+        __m128 flip = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(dot, zero), _mm_loadu_ps(quatMask)), signMask);
+        x0 = _mm_xor_ps(x0, flip);
+        y0 = _mm_xor_ps(y0, flip);
+        z0 = _mm_xor_ps(z0, flip);
+        w0 = _mm_xor_ps(w0, flip);
+        _mm_storeu_ps(cosTheta, _mm_xor_ps(dot, flip));
+
+        // blend weights
+        for (lane = 0; lane < 4; lane++)
+        {
+            ComputeWeights(ipolTypes[lane], cosTheta[lane], inbetween, scale0[lane], scale1[lane]);
+        }
+        __m128 s0 = _mm_loadu_ps(scale0);
+        __m128 s1 = _mm_loadu_ps(scale1);
+        __m128 x = _mm_add_ps(_mm_mul_ps(s0, x0), _mm_mul_ps(s1, x1));
+        __m128 y = _mm_add_ps(_mm_mul_ps(s0, y0), _mm_mul_ps(s1, y1));
+        __m128 z = _mm_add_ps(_mm_mul_ps(s0, z0), _mm_mul_ps(s1, z1));
+        __m128 w = _mm_add_ps(_mm_mul_ps(s0, w0), _mm_mul_ps(s1, w1));
+
+        // transpose back and write the valid lanes
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(result[0], x);
+        _mm_storeu_ps(result[1], y);
+        _mm_storeu_ps(result[2], z);
+        _mm_storeu_ps(result[3], w);
+        for (lane = 0; lane < numLanes; lane++)
+        {
+            dst[i + lane].set(result[lane][0], result[lane][1], result[lane][2], result[lane][3]);
+        }
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -416,6 +416,7 @@ nApplication::DoFrame()
         this->SetQuitRequested(true);
     }
     kernelServer->Trigger();
+    this->refResourceServer->Trigger();
     nInputServer::Instance()->Trigger(this->time);
     nGuiServer::Instance()->Trigger();
     nVideoServer::Instance()->Trigger();
@@ -8,9 +8,7 @@
 #include "variable/nvariablecontext.h"
 
 nArray<nAnimEventTrack> nCharacter2::outAnimEventTracks;
-vector4 nCharacter2::scratchKeyArray[MaxCurves];
-vector4 nCharacter2::keyArray[MaxCurves];
-vector4 nCharacter2::transitionKeyArray[MaxCurves];
+nFixedArray<nFixedArray<vector4> > nCharacter2::sampleBuffers;
 
 //------------------------------------------------------------------------------
 /**
@@ -93,9 +91,48 @@ nCharacter2::SetActiveState(const nAnimStateInfo& newState)
 
 //------------------------------------------------------------------------------
 /**
+    Create the sample buffers for the given number of worker indices.
+    The buffers grow on demand to the number of curves of the sampled
+    animations. Must not be called while characters are being evaluated.
 */
 void
-nCharacter2::EvaluateSkeleton(float time)
+nCharacter2::SetupSampleBuffers(int numWorkers)
+{
+    n_assert(numWorkers > 0);
+    if (nCharacter2::sampleBuffers.Size() < numWorkers)
+    {
+        nCharacter2::sampleBuffers.SetSize(numWorkers);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the highest number of curves of the animation groups used
+    by the clips of an animation state.
+*/
+int
+nCharacter2::GetMaxNumCurves(const nAnimStateInfo& info) const
+{
+    int maxNumCurves = 0;
+    int clipIndex;
+    int numClips = info.GetNumClips();
+    for (clipIndex = 0; clipIndex < numClips; clipIndex++)
+    {
+        const nAnimation::Group& group = this->animation->GetGroupAt(info.GetClipAt(clipIndex).GetAnimGroupIndex());
+        maxNumCurves = n_max(maxNumCurves, group.GetNumCurves());
+    }
+    return maxNumCurves;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample the animation state and evaluate the character skeleton.
+    The sample buffers are selected by workerIndex, so different
+    characters may be evaluated on different threads at the same time.
+    Worker index 0 belongs to the main thread.
+*/
+void
+nCharacter2::EvaluateSkeleton(float time, int workerIndex)
 {
     if (this->IsAnimEnabled() && this->curStateInfo.IsValid())
     {
@@ -112,67 +149,94 @@ nCharacter2::EvaluateSkeleton(float time)
             this->curStateInfo.SetStateStarted(time);
         }
 
+        // the state needs to be sampled if it contains a clip other than the base clip
+        bool sampleState = false;
         int numClips = this->curStateInfo.GetNumClips();
         int clipIndex;
-        for (clipIndex  = 0; clipIndex < numClips; clipIndex++)
+        for (clipIndex = 0; clipIndex < numClips; clipIndex++)
         {
             if (this->curStateInfo.GetClipAt(clipIndex).GetClipName() != "baseClip")
             {
-                int index = this->curStateInfo.GetClipAt(clipIndex).GetAnimGroupIndex();
-                const nAnimation::Group& group = this->animation->GetGroupAt(0);
+                sampleState = true;
+                break;
+            }
+        }
 
-                float fadeInTime = this->curStateInfo.GetFadeInTime();
-                float lerp = 1.0f;
-                bool transition = false;
-                if ((fadeInTime > 0.0f) && (curRelTime < fadeInTime) && this->prevStateInfo.IsValid())
+        if (sampleState)
+        {
+            // get the sample buffers of this worker
+            if (0 == nCharacter2::sampleBuffers.Size())
+            {
+                n_assert(0 == workerIndex);
+                nCharacter2::SetupSampleBuffers(1);
+            }
+            int numJoints = this->charSkeleton.GetNumJoints();
+            int numCurves = n_max(numJoints * 3, this->GetMaxNumCurves(this->curStateInfo));
+            if (this->prevStateInfo.IsValid())
+            {
+                numCurves = n_max(numCurves, this->GetMaxNumCurves(this->prevStateInfo));
+            }
+            n_assert(numCurves <= MaxCurves);
+            nFixedArray<vector4>& sampleBuffer = nCharacter2::sampleBuffers[workerIndex];
+            if (sampleBuffer.Size() < 4 * numCurves)
+            {
+                sampleBuffer.SetSize(4 * numCurves);
+            }
+            vector4* keyArray = &(sampleBuffer[0]);
+            vector4* transitionKeyArray = keyArray + numCurves;
+            vector4* scratchKeyArray = transitionKeyArray + numCurves;
+            vector4* clipValueArray = scratchKeyArray + numCurves;
+
+            float fadeInTime = this->curStateInfo.GetFadeInTime();
+            float lerp = 1.0f;
+            bool transition = false;
+            if ((fadeInTime > 0.0f) && (curRelTime < fadeInTime) && this->prevStateInfo.IsValid())
+            {
+                // state transition is necessary, compute a lerp value
+                // and sample the previous animation state
+                float prevRelTime = time - this->prevStateInfo.GetStateStarted();
+                float sampleTime = prevRelTime + this->prevStateInfo.GetStateOffset();
+                if (this->Sample(this->prevStateInfo, sampleTime, transitionKeyArray, scratchKeyArray, clipValueArray, numCurves))
                 {
-                    // state transition is necessary, compute a lerp value
-                    // and sample the previous animation state
-                    float prevRelTime = time - this->prevStateInfo.GetStateStarted();
-                    float sampleTime = prevRelTime + this->prevStateInfo.GetStateOffset();
-                    if (this->Sample(this->prevStateInfo, sampleTime, nCharacter2::transitionKeyArray, nCharacter2::scratchKeyArray, nCharacter2::MaxCurves))
+                    transition = true;
+                    lerp = curRelTime / fadeInTime;
+                }
+            }
+
+            // get samples from current animation state
+            float sampleTime = curRelTime + this->curStateInfo.GetStateOffset();
+            if (this->Sample(this->curStateInfo, sampleTime, keyArray, scratchKeyArray, clipValueArray, numCurves))
+            {
+                // transfer the sampled animation values into the character skeleton
+                int jointIndex;
+                const vector4* keyPtr = keyArray;
+                const vector4* prevKeyPtr = transitionKeyArray;
+
+                vector3 translate, prevTranslate;
+                quaternion rotate, prevRotate;
+                vector3 scale, prevScale;
+                for (jointIndex = 0; jointIndex < numJoints; jointIndex++)
+                {
+                    // read sampled translation, rotation and scale
+                    translate.set(keyPtr->x, keyPtr->y, keyPtr->z);          keyPtr++;
+                    rotate.set(keyPtr->x, keyPtr->y, keyPtr->z, keyPtr->w);  keyPtr++;
+                    scale.set(keyPtr->x, keyPtr->y, keyPtr->z);              keyPtr++;
+
+                    if (transition)
                     {
-                         transition = true;
-                         lerp = curRelTime / fadeInTime;
+                        prevTranslate.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z);              prevKeyPtr++;
+                        prevRotate.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z, prevKeyPtr->w);  prevKeyPtr++;
+                        prevScale.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z);                  prevKeyPtr++;
+                        translate.lerp(prevTranslate, lerp);
+                        rotate.slerp(prevRotate, rotate, lerp);
+                        scale.lerp(prevScale, lerp);
                     }
-                }
 
-               // get samples from current animation state
-               float sampleTime = curRelTime + this->curStateInfo.GetStateOffset();
-               if (this->Sample(this->curStateInfo, sampleTime, nCharacter2::keyArray, nCharacter2::scratchKeyArray, nCharacter2::MaxCurves))
-               {
-                     // transfer the sampled animation values into the character skeleton
-                     int numJoints = this->charSkeleton.GetNumJoints();
-                     int jointIndex;
-                     const vector4* keyPtr = keyArray;
-                     const vector4* prevKeyPtr = transitionKeyArray;
-
-                     vector3 translate, prevTranslate;
-                     quaternion rotate, prevRotate;
-                     vector3 scale, prevScale;
-                     for (jointIndex = 0; jointIndex < numJoints; jointIndex++)
-                     {
-                          // read sampled translation, rotation and scale
-                          translate.set(keyPtr->x, keyPtr->y, keyPtr->z);          keyPtr++;
-                          rotate.set(keyPtr->x, keyPtr->y, keyPtr->z, keyPtr->w);  keyPtr++;
-                          scale.set(keyPtr->x, keyPtr->y, keyPtr->z);              keyPtr++;
-
-                          if (transition)
-                          {
-                               prevTranslate.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z);              prevKeyPtr++;
-                               prevRotate.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z, prevKeyPtr->w);  prevKeyPtr++;
-                               prevScale.set(prevKeyPtr->x, prevKeyPtr->y, prevKeyPtr->z);                  prevKeyPtr++;
-                               translate.lerp(prevTranslate, lerp);
-                               rotate.slerp(prevRotate, rotate, lerp);
-                               scale.lerp(prevScale, lerp);
-                           }
-
-                           nCharJoint& joint = this->charSkeleton.GetJointAt(jointIndex);
-                           joint.SetTranslate(translate);
-                           joint.SetRotate(rotate);
-                           joint.SetScale(scale);
-                      }
-                 }
+                    nCharJoint& joint = this->charSkeleton.GetJointAt(jointIndex);
+                    joint.SetTranslate(translate);
+                    joint.SetRotate(rotate);
+                    joint.SetScale(scale);
+                }
             }
         }
     }
@@ -205,22 +269,24 @@ nCharacter2::EmitAnimEvents(float fromTime, float toTime)
     @param  time            the time at which to sample
     @param  keyArray        pointer to a float4 array which will be filled with
                             the sampled values (one per curve)
+    @param  scratchKeyArray float4 array for the samples of a single clip
+    @param  clipValueArray  float4 array which holds the last sampled value of
+                            every animated curve while blending the clips
     @param  keyArraySize    number of elements in the key array, must be identical
                             to the number of curves in any animation clip
     @return                 true, if the returned keys are valid (false if all
                             clip weights are zero)
 */
 bool
-nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArray, vector4* scratchKeyArray, int keyArraySize)
+nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArray, vector4* scratchKeyArray, vector4* clipValueArray, int keyArraySize)
 {
     n_assert(keyArray);
     n_assert(keyArraySize >= stateInfo.GetClipAt(0).GetNumCurves());
     n_assert(this->animation.isvalid());
 
-    // some static helper objects
-    static quaternion quatCurrent;
-    static quaternion quatAccum;
-    static quaternion quatSlerp;
+    quaternion quatCurrent;
+    quaternion quatAccum;
+    quaternion quatSlerp;
 
     // for each clip...
     float weightAccum = 0.0f;
@@ -245,7 +311,7 @@ nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArr
             const vector4& curSampleKey = scratchKeyArray[curveIndex];
 
             // perform weighted blending
-            nAnimation::Curve& animCurve = this->animation->GetGroupAt(animGroupIndex).GetCurveAt(curveIndex);
+            const nAnimation::Curve& animCurve = group.GetCurveAt(curveIndex);
             if (animCurve.IsAnimated() && clipWeight > 0.0f)
             {
                 // FIXME: (for cases with more than two clips) maybe all weights of animated curves
@@ -258,7 +324,7 @@ nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArr
                 {
                     nAnimClip& clip = stateInfo.GetClipAt(i);
                     int animGroupIndex = clip.GetAnimGroupIndex();
-                    nAnimation::Curve& prevClipCurve = this->animation->GetGroupAt(animGroupIndex).GetCurveAt(curveIndex);
+                    const nAnimation::Curve& prevClipCurve = this->animation->GetGroupAt(animGroupIndex).GetCurveAt(curveIndex);
                     if (prevClipCurve.IsAnimated())
                     {
                         animFlag = true;
@@ -293,8 +359,6 @@ nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArr
                         curMixedKey += curSampleKey * clipWeight;
                    }
                 }
-
-                animCurve.SetCurAnimClipValue(curSampleKey);
              }
              else // curve is not animated
              {
@@ -309,12 +373,12 @@ nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArr
                  {
                      nAnimClip& clip = stateInfo.GetClipAt(i);
                      int animGroupIndex = clip.GetAnimGroupIndex();
-                     nAnimation::Curve& prevClipCurve = this->animation->GetGroupAt(animGroupIndex).GetCurveAt(curveIndex);
+                     const nAnimation::Curve& prevClipCurve = this->animation->GetGroupAt(animGroupIndex).GetCurveAt(curveIndex);
                      if (prevClipCurve.IsAnimated())
                      {
                          // start value from prev animated curve taken
                          animFlag = true;
-                         startVal = prevClipCurve.GetCurAnimClipValue();
+                         startVal = clipValueArray[curveIndex];
                      }
                  }
 
@@ -346,6 +410,12 @@ nCharacter2::Sample(const nAnimStateInfo& stateInfo, float time, vector4* keyArr
                      }
                  }
              }
+
+             // remember the sampled value of animated curves for the following clips
+             if (animCurve.IsAnimated())
+             {
+                 clipValueArray[curveIndex] = curSampleKey;
+             }
         }
         weightAccum += clipWeight;
     }
@@ -0,0 +1,350 @@
+//------------------------------------------------------------------------------
+//  ncharskeleton.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "character/ncharskeleton.h"
+#ifdef __NEBULA_CHARACTER_SSE__
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+/**
+    Compute an evaluation order in which every joint comes after its
+    parent. The joints are sorted by their depth in the hierarchy, joints
+    of the same depth keep their index order, so a skeleton which is
+    already sorted keeps its order.
+*/
+void
+nCharSkeleton::UpdateEvaluationOrder()
+{
+    int num = this->jointArray.Size();
+    this->evalOrder.SetSize(num);
+    if (0 == num)
+    {
+        return;
+    }
+
+    nFixedArray<int> depth(num);
+    int maxDepth = 0;
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        int d = 0;
+        int parentIndex = this->jointArray[i].GetParentJointIndex();
+        while (-1 != parentIndex)
+        {
+            d++;
+            n_assert2(d < num, "nCharSkeleton: cyclic joint hierarchy!");
+            parentIndex = this->jointArray[parentIndex].GetParentJointIndex();
+        }
+        depth[i] = d;
+        maxDepth = n_max(maxDepth, d);
+    }
+
+    int orderIndex = 0;
+    int d;
+    for (d = 0; d <= maxDepth; d++)
+    {
+        for (i = 0; i < num; i++)
+        {
+            if (depth[i] == d)
+            {
+                this->evalOrder[orderIndex++] = i;
+            }
+        }
+    }
+    n_assert(orderIndex == num);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Evaluate all joints in one linear pass. Parents are always evaluated
+    before their children, so no joint has to recurse into its parent.
+*/
+void
+nCharSkeleton::Evaluate()
+{
+    int num = this->jointArray.Size();
+    if (this->evalOrder.Size() != num)
+    {
+        this->UpdateEvaluationOrder();
+    }
+
+#ifdef __NEBULA_CHARACTER_SSE__
+    this->EvaluateLocalMatricesSSE();
+    this->EvaluateWorldMatricesSSE();
+#else
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        this->jointArray[i].ClearUptodateFlag();
+    }
+    for (i = 0; i < num; i++)
+    {
+        this->jointArray[this->evalOrder[i]].Evaluate();
+    }
+#endif
+}
+
+#ifdef __NEBULA_CHARACTER_SSE__
+//------------------------------------------------------------------------------
+/**
+    Compute the local matrices of up to 4 joints at once from their
+    translation, rotation and scale. The joints' rotation, scale and
+    translation are loaded into SSE registers component by component
+    (one joint per lane), so the quaternion normalization and the
+    quaternion to matrix conversion run for 4 joints at the same time.
+    Produces the same matrices as nCharJoint::Evaluate().
+*/
+void
+nCharSkeleton::ComputeLocalMatrices(nCharJoint* const* joints, int num)
+{
+    n_assert((num > 0) && (num <= 4));
+    float qx[4], qy[4], qz[4], qw[4];
+    float sx[4], sy[4], sz[4];
+    int lane;
+    for (lane = 0; lane < 4; lane++)
+    {
+        if (lane < num)
+        {
+            const nCharJoint* joint = joints[lane];
+            qx[lane] = joint->rotate.x;
+            qy[lane] = joint->rotate.y;
+            qz[lane] = joint->rotate.z;
+            qw[lane] = joint->rotate.w;
+            sx[lane] = joint->scale.x * joint->variationScale.x;
+            sy[lane] = joint->scale.y * joint->variationScale.y;
+            sz[lane] = joint->scale.z * joint->variationScale.z;
+        }
+        else
+        {
+            qx[lane] = 0.0f; qy[lane] = 0.0f; qz[lane] = 0.0f; qw[lane] = 1.0f;
+            sx[lane] = 1.0f; sy[lane] = 1.0f; sz[lane] = 1.0f;
+        }
+    }
+
+    // normalize the rotations, zero quaternions become the identity
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 x = _mm_loadu_ps(qx);
+    __m128 y = _mm_loadu_ps(qy);
+    __m128 z = _mm_loadu_ps(qz);
+    __m128 w = _mm_loadu_ps(qw);
+    __m128 n = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), _mm_mul_ps(w, w));
+    __m128 valid = _mm_cmpgt_ps(n, zero);
+    __m128 oneDivLen = _mm_div_ps(one, _mm_sqrt_ps(n));
+    x = _mm_and_ps(valid, _mm_mul_ps(x, oneDivLen));
+    y = _mm_and_ps(valid, _mm_mul_ps(y, oneDivLen));
+    z = _mm_and_ps(valid, _mm_mul_ps(z, oneDivLen));
+    w = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(w, oneDivLen)), _mm_andnot_ps(valid, one));
+    _mm_storeu_ps(qx, x);
+    _mm_storeu_ps(qy, y);
+    _mm_storeu_ps(qz, z);
+    _mm_storeu_ps(qw, w);
+
+    // rotation matrices, same terms as matrix44(const quaternion&)
+    __m128 x2 = _mm_add_ps(x, x);
+    __m128 y2 = _mm_add_ps(y, y);
+    __m128 z2 = _mm_add_ps(z, z);
+    __m128 xx = _mm_mul_ps(x, x2);
+    __m128 xy = _mm_mul_ps(x, y2);
+    __m128 xz = _mm_mul_ps(x, z2);
+    __m128 yy = _mm_mul_ps(y, y2);
+    __m128 yz = _mm_mul_ps(y, z2);
+    __m128 zz = _mm_mul_ps(z, z2);
+    __m128 wx = _mm_mul_ps(w, x2);
+    __m128 wy = _mm_mul_ps(w, y2);
+    __m128 wz = _mm_mul_ps(w, z2);
+    __m128 m00 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+    __m128 m01 = _mm_add_ps(xy, wz);
+    __m128 m02 = _mm_sub_ps(xz, wy);
+    __m128 m10 = _mm_sub_ps(xy, wz);
+    __m128 m11 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+    __m128 m12 = _mm_add_ps(yz, wx);
+    __m128 m20 = _mm_add_ps(xz, wy);
+    __m128 m21 = _mm_sub_ps(yz, wx);
+    __m128 m22 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+    // the scaled local matrix has its rows scaled by scale * variationScale
+    __m128 scaleX = _mm_loadu_ps(sx);
+    __m128 scaleY = _mm_loadu_ps(sy);
+    __m128 scaleZ = _mm_loadu_ps(sz);
+    __m128 s00 = _mm_mul_ps(scaleX, m00);
+    __m128 s01 = _mm_mul_ps(scaleX, m01);
+    __m128 s02 = _mm_mul_ps(scaleX, m02);
+    __m128 s10 = _mm_mul_ps(scaleY, m10);
+    __m128 s11 = _mm_mul_ps(scaleY, m11);
+    __m128 s12 = _mm_mul_ps(scaleY, m12);
+    __m128 s20 = _mm_mul_ps(scaleZ, m20);
+    __m128 s21 = _mm_mul_ps(scaleZ, m21);
+    __m128 s22 = _mm_mul_ps(scaleZ, m22);
+
+    // transpose back into one row per joint
+    __m128 row0 = m00, row1 = m01, row2 = m02, row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 unscaledRows0[4] = { row0, row1, row2, row3 };
+    row0 = m10; row1 = m11; row2 = m12; row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 unscaledRows1[4] = { row0, row1, row2, row3 };
+    row0 = m20; row1 = m21; row2 = m22; row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 unscaledRows2[4] = { row0, row1, row2, row3 };
+    row0 = s00; row1 = s01; row2 = s02; row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 scaledRows0[4] = { row0, row1, row2, row3 };
+    row0 = s10; row1 = s11; row2 = s12; row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 scaledRows1[4] = { row0, row1, row2, row3 };
+    row0 = s20; row1 = s21; row2 = s22; row3 = zero;
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    __m128 scaledRows2[4] = { row0, row1, row2, row3 };
+
+    for (lane = 0; lane < num; lane++)
+    {
+        nCharJoint* joint = joints[lane];
+        joint->rotate.set(qx[lane], qy[lane], qz[lane], qw[lane]);
+        __m128 translate = _mm_set_ps(1.0f, joint->translate.z, joint->translate.y, joint->translate.x);
+
+        float* unscaled = &(joint->localUnscaledMatrix.M11);
+        _mm_storeu_ps(unscaled + 0, unscaledRows0[lane]);
+        _mm_storeu_ps(unscaled + 4, unscaledRows1[lane]);
+        _mm_storeu_ps(unscaled + 8, unscaledRows2[lane]);
+        _mm_storeu_ps(unscaled + 12, translate);
+
+        float* scaled = &(joint->localScaledMatrix.M11);
+        _mm_storeu_ps(scaled + 0, scaledRows0[lane]);
+        _mm_storeu_ps(scaled + 4, scaledRows1[lane]);
+        _mm_storeu_ps(scaled + 8, scaledRows2[lane]);
+        _mm_storeu_ps(scaled + 12, translate);
+
+        joint->matrixDirty = false;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Update the local matrices of all joints whose translation, rotation
+    or scale has changed, in groups of 4 joints.
+*/
+void
+nCharSkeleton::EvaluateLocalMatricesSSE()
+{
+    nCharJoint* dirtyJoints[4];
+    int numDirty = 0;
+    int num = this->jointArray.Size();
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        nCharJoint& joint = this->jointArray[i];
+        if (joint.matrixDirty)
+        {
+            dirtyJoints[numDirty++] = &joint;
+            if (4 == numDirty)
+            {
+                ComputeLocalMatrices(dirtyJoints, numDirty);
+                numDirty = 0;
+            }
+        }
+    }
+    if (numDirty > 0)
+    {
+        ComputeLocalMatrices(dirtyJoints, numDirty);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Multiply the local matrices with the parent's matrices and compute the
+    skin matrices in evaluation order. Every matrix row is one SSE
+    register, the operations are done in the same order as
+    matrix44::mult_simple() and operator*, so the results match
+    nCharJoint::Evaluate().
+*/
+void
+nCharSkeleton::EvaluateWorldMatricesSSE()
+{
+    const __m128 maskXYZ = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    const __m128 unitW = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+    int num = this->evalOrder.Size();
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        nCharJoint& joint = this->jointArray[this->evalOrder[i]];
+        float* worldScaled = &(joint.worldScaledMatrix.M11);
+        if (!joint.lockMatrix)
+        {
+            const float* localUnscaled = &(joint.localUnscaledMatrix.M11);
+            const float* localScaled = &(joint.localScaledMatrix.M11);
+            float* worldUnscaled = &(joint.worldUnscaledMatrix.M11);
+            const nCharJoint* parent = joint.parentJoint;
+            if (parent)
+            {
+                // joint translation is affected by parent scale while the actual axis are not
+                float psx = parent->scale.x * parent->variationScale.x;
+                float psy = parent->scale.y * parent->variationScale.y;
+                float psz = parent->scale.z * parent->variationScale.z;
+
+                const float* parentMatrix = &(parent->worldUnscaledMatrix.M11);
+                __m128 p0 = _mm_loadu_ps(parentMatrix + 0);
+                __m128 p1 = _mm_loadu_ps(parentMatrix + 4);
+                __m128 p2 = _mm_loadu_ps(parentMatrix + 8);
+                __m128 p3 = _mm_loadu_ps(parentMatrix + 12);
+
+                int row;
+                for (row = 0; row < 3; row++)
+                {
+                    const float* u = localUnscaled + row * 4;
+                    __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(u[0]), p0), _mm_mul_ps(_mm_set1_ps(u[1]), p1)), _mm_mul_ps(_mm_set1_ps(u[2]), p2));
+                    _mm_storeu_ps(worldUnscaled + row * 4, _mm_and_ps(r, maskXYZ));
+                    const float* s = localScaled + row * 4;
+                    r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s[0]), p0), _mm_mul_ps(_mm_set1_ps(s[1]), p1)), _mm_mul_ps(_mm_set1_ps(s[2]), p2));
+                    _mm_storeu_ps(worldScaled + row * 4, _mm_and_ps(r, maskXYZ));
+                }
+
+                const float* ut = localUnscaled + 12;
+                __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ut[0] * psx), p0),
+                                                            _mm_mul_ps(_mm_set1_ps(ut[1] * psy), p1)),
+                                                 _mm_mul_ps(_mm_set1_ps(ut[2] * psz), p2)), p3);
+                _mm_storeu_ps(worldUnscaled + 12, _mm_or_ps(_mm_and_ps(r, maskXYZ), unitW));
+                const float* st = localScaled + 12;
+                r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(st[0] * psx), p0),
+                                                     _mm_mul_ps(_mm_set1_ps(st[1] * psy), p1)),
+                                          _mm_mul_ps(_mm_set1_ps(st[2] * psz), p2)), p3);
+                _mm_storeu_ps(worldScaled + 12, _mm_or_ps(_mm_and_ps(r, maskXYZ), unitW));
+            }
+            else
+            {
+                joint.worldUnscaledMatrix = joint.localUnscaledMatrix;
+                joint.worldScaledMatrix = joint.localScaledMatrix;
+            }
+        }
+
+        // skin matrix = inverse pose matrix * world matrix
+        __m128 w0 = _mm_loadu_ps(worldScaled + 0);
+        __m128 w1 = _mm_loadu_ps(worldScaled + 4);
+        __m128 w2 = _mm_loadu_ps(worldScaled + 8);
+        __m128 w3 = _mm_loadu_ps(worldScaled + 12);
+        const float* invPose = &(joint.invPoseMatrix.M11);
+        float* skin = &(joint.skinMatrix44.M11);
+        int row;
+        for (row = 0; row < 4; row++)
+        {
+            const float* a = invPose + row * 4;
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), w0),
+                                                        _mm_mul_ps(_mm_set1_ps(a[1]), w1)),
+                                             _mm_mul_ps(_mm_set1_ps(a[2]), w2)),
+                                  _mm_mul_ps(_mm_set1_ps(a[3]), w3));
+            _mm_storeu_ps(skin + row * 4, r);
+        }
+        const matrix44& m = joint.skinMatrix44;
+        joint.skinMatrix33.set(m.M11, m.M12, m.M13,
+                               m.M21, m.M22, m.M23,
+                               m.M31, m.M32, m.M33);
+        joint.isUptodate = true;
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -3,13 +3,19 @@
 //  (C) 2004 RadonLabs GmbH
 //------------------------------------------------------------------------------
 #include "deformers/nskinmeshdeformer.h"
+#include "kernel/nworkerpool.h"
+#ifdef __NEBULA_SKINNING_SSE__
+#include <xmmintrin.h>
+#endif
 
 //------------------------------------------------------------------------------
 /**
 */
 nSkinMeshDeformer::nSkinMeshDeformer() :
     skeleton(0),
-    jointPalette(0)
+    jointPalette(0),
+    skinMatrices(0, 0),
+    parallel(true)
 {
     // empty
 }
@@ -37,119 +43,325 @@ nSkinMeshDeformer::Compute()
     nMesh2* srcMesh = this->refInputMesh;
     nMesh2* dstMesh = this->refOutputMesh;
     int numVertices = srcMesh->GetNumVertices();
-    n_assert(srcMesh->HasAllVertexComponents(nMesh2::Weights | nMesh2::JIndices));
+    n_assert(srcMesh->HasAllVertexComponents(nMesh2::Coord | nMesh2::Weights | nMesh2::JIndices));
     n_assert(dstMesh->HasAllVertexComponents(srcMesh->GetVertexComponents() & ~(nMesh2::Weights | nMesh2::JIndices)));
     n_assert(dstMesh->GetNumVertices() == numVertices);
     n_assert(srcMesh->GetVertexWidth() == (dstMesh->GetVertexWidth() + 8));
+    n_assert((this->startVertex + this->numVertices) <= numVertices);
 
-    int srcCompMask  = srcMesh->GetVertexComponents();
-    int weightOffset = srcMesh->GetVertexComponentOffset(nMesh2::Weights);
-    int jindexOffset = srcMesh->GetVertexComponentOffset(nMesh2::JIndices);
-    float* srcPtr = srcMesh->LockVertices() + this->startVertex * srcMesh->GetVertexWidth();
-    float* dstPtr = dstMesh->LockVertices() + this->startVertex * dstMesh->GetVertexWidth();
-    int jointIndex[4];
-    int vertexIndex;
-    for (vertexIndex = 0; vertexIndex < this->numVertices; vertexIndex++)
+    // gather the skin matrices of the joint palette
+    int numPaletteJoints = this->jointPalette->GetNumJoints();
+    if (this->skinMatrices.Size() != numPaletteJoints)
     {
-        int i;
-
-        // get joint indices and weights
-        float* weights = &srcPtr[weightOffset];
-        float* indices = &srcPtr[jindexOffset];
+        this->skinMatrices.SetFixedSize(numPaletteJoints);
+    }
+    int paletteIndex;
+    for (paletteIndex = 0; paletteIndex < numPaletteJoints; paletteIndex++)
+    {
+        const nCharJoint& joint = this->skeleton->GetJointAt(this->jointPalette->GetJointIndexAt(paletteIndex));
+        this->skinMatrices[paletteIndex] = joint.GetSkinMatrix44();
+    }
 
-        // get absolute joint indices
-        for (i = 0; i < 4; i++)
+    // setup the vertex layout
+    int srcCompMask = srcMesh->GetVertexComponents();
+    Layout layout;
+    layout.srcWidth = srcMesh->GetVertexWidth();
+    layout.dstWidth = dstMesh->GetVertexWidth();
+    layout.weights = srcMesh->GetVertexComponentOffset(nMesh2::Weights);
+    layout.jindices = srcMesh->GetVertexComponentOffset(nMesh2::JIndices);
+    layout.srcNormal = layout.dstNormal = -1;
+    layout.srcTangent = layout.dstTangent = -1;
+    layout.srcBinormal = layout.dstBinormal = -1;
+    if (srcCompMask & nMesh2::Normal)
+    {
+        layout.srcNormal = srcMesh->GetVertexComponentOffset(nMesh2::Normal);
+        layout.dstNormal = dstMesh->GetVertexComponentOffset(nMesh2::Normal);
+    }
+    if (srcCompMask & nMesh2::Tangent)
+    {
+        layout.srcTangent = srcMesh->GetVertexComponentOffset(nMesh2::Tangent);
+        layout.dstTangent = dstMesh->GetVertexComponentOffset(nMesh2::Tangent);
+    }
+    if (srcCompMask & nMesh2::Binormal)
+    {
+        layout.srcBinormal = srcMesh->GetVertexComponentOffset(nMesh2::Binormal);
+        layout.dstBinormal = dstMesh->GetVertexComponentOffset(nMesh2::Binormal);
+    }
+    static const nMesh2::VertexComponent copyComponents[MaxCopyRanges] =
+    {
+        nMesh2::Uv0, nMesh2::Uv1, nMesh2::Uv2, nMesh2::Uv3, nMesh2::Color
+    };
+    static const int copySizes[MaxCopyRanges] = { 2, 2, 2, 2, 4 };
+    layout.numCopyRanges = 0;
+    int i;
+    for (i = 0; i < MaxCopyRanges; i++)
+    {
+        if (srcCompMask & copyComponents[i])
         {
-            jointIndex[i] = this->jointPalette->GetJointIndexAt(int(indices[i]));
+            layout.copySrc[layout.numCopyRanges] = srcMesh->GetVertexComponentOffset(copyComponents[i]);
+            layout.copyDst[layout.numCopyRanges] = dstMesh->GetVertexComponentOffset(copyComponents[i]);
+            layout.copySize[layout.numCopyRanges] = copySizes[i];
+            layout.numCopyRanges++;
         }
+    }
+
+    const float* srcPtr = srcMesh->LockVertices() + this->startVertex * layout.srcWidth;
+    float* dstPtr = dstMesh->LockVertices() + this->startVertex * layout.dstWidth;
+    const matrix44* matrices = numPaletteJoints > 0 ? &(this->skinMatrices[0]) : 0;
+    if (this->parallel && (this->numVertices > VerticesPerTask) && !nWorkerPool::Instance()->IsRunning())
+    {
+        // skin ranges of vertices on the worker threads
+        Job job;
+        job.layout = &layout;
+        job.skinMatrices = matrices;
+        job.src = srcPtr;
+        job.dst = dstPtr;
+        job.numVertices = this->numVertices;
+        int numTasks = (this->numVertices + VerticesPerTask - 1) / VerticesPerTask;
+        nWorkerPool::Instance()->Run(numTasks, SkinVerticesTask, &job);
+    }
+    else
+    {
+        SkinVertices(layout, matrices, srcPtr, dstPtr, this->numVertices);
+    }
+    dstMesh->UnlockVertices();
+    srcMesh->UnlockVertices();
+}
 
-        vector3* srcVec = (vector3*)srcPtr;
-        vector3* dstVec = (vector3*)dstPtr;
-        dstVec->set(0.0f, 0.0f, 0.0f);
+//------------------------------------------------------------------------------
+/**
+    Skin the positions of numVertices source vertices. The skin matrices
+    are indexed by the joint indices of the vertices. Only the first 3
+    floats of every destination vertex are written.
+*/
+void
+nSkinMeshDeformer::SkinPositions(const matrix44* skinMatrices, const float* src, int srcWidth, int weightOffset, int jindexOffset, float* dst, int dstWidth, int numVertices)
+{
+    n_assert(skinMatrices && src && dst);
+    n_assert(dstWidth >= 3);
+    Layout layout;
+    layout.srcWidth = srcWidth;
+    layout.dstWidth = dstWidth;
+    layout.weights = weightOffset;
+    layout.jindices = jindexOffset;
+    layout.srcNormal = layout.dstNormal = -1;
+    layout.srcTangent = layout.dstTangent = -1;
+    layout.srcBinormal = layout.dstBinormal = -1;
+    layout.numCopyRanges = 0;
+    SkinVertices(layout, skinMatrices, src, dst, numVertices);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Skin one range of vertices of a job, runs on a worker thread.
+*/
+void
+nSkinMeshDeformer::SkinVerticesTask(int taskIndex, int /*workerIndex*/, void* userData)
+{
+    const Job* job = (const Job*)userData;
+    int firstVertex = taskIndex * VerticesPerTask;
+    int numVertices = n_min(int(VerticesPerTask), job->numVertices - firstVertex);
+    SkinVertices(*job->layout,
+                 job->skinMatrices,
+                 job->src + firstVertex * job->layout->srcWidth,
+                 job->dst + firstVertex * job->layout->dstWidth,
+                 numVertices);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSkinMeshDeformer::SkinVertices(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+#ifdef __NEBULA_SKINNING_SSE__
+    SkinVerticesSSE(layout, skinMatrices, src, dst, numVertices);
+#else
+    SkinVerticesScalar(layout, skinMatrices, src, dst, numVertices);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Transform a direction with the upper 3x3 part of a blended matrix.
+*/
+static inline
+void
+TransformDirection(const float* m, const float* v, float* d)
+{
+    d[0] = v[0] * m[0] + v[1] * m[3] + v[2] * m[6];
+    d[1] = v[0] * m[1] + v[1] * m[4] + v[2] * m[7];
+    d[2] = v[0] * m[2] + v[1] * m[5] + v[2] * m[8];
+}
+
+//------------------------------------------------------------------------------
+/**
+    Skin vertices, scalar version. The weighted joint matrices are blended
+    into one 4x3 matrix per vertex, which is then applied to the position
+    and the direction components.
+*/
+void
+nSkinMeshDeformer::SkinVerticesScalar(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+    float m[12];
+    int vertexIndex;
+    for (vertexIndex = 0; vertexIndex < numVertices; vertexIndex++)
+    {
+        // blend the weighted joint matrices
+        const float* weights = src + layout.weights;
+        const float* indices = src + layout.jindices;
+        int i;
+        for (i = 0; i < 12; i++)
+        {
+            m[i] = 0.0f;
+        }
         for (i = 0; i < 4; i++)
         {
-            const matrix44& m = this->skeleton->GetJointAt(jointIndex[i]).GetSkinMatrix44();
-            if (weights[i] > 0.0f)
+            float w = weights[i];
+            if (w > 0.0f)
             {
-                *dstVec += (m * (*srcVec)) * weights[i];
+                const matrix44& jm = skinMatrices[int(indices[i])];
+                m[0] += w * jm.M11; m[1]  += w * jm.M12; m[2]  += w * jm.M13;
+                m[3] += w * jm.M21; m[4]  += w * jm.M22; m[5]  += w * jm.M23;
+                m[6] += w * jm.M31; m[7]  += w * jm.M32; m[8]  += w * jm.M33;
+                m[9] += w * jm.M41; m[10] += w * jm.M42; m[11] += w * jm.M43;
             }
         }
-        srcPtr += 3;
-        dstPtr += 3;
 
-        if (srcCompMask & nMesh2::Normal)
+        // position
+        float x = src[0];
+        float y = src[1];
+        float z = src[2];
+        dst[0] = x * m[0] + y * m[3] + z * m[6] + m[9];
+        dst[1] = x * m[1] + y * m[4] + z * m[7] + m[10];
+        dst[2] = x * m[2] + y * m[5] + z * m[8] + m[11];
+
+        // directions
+        if (-1 != layout.srcNormal)
         {
-            srcVec = (vector3*)srcPtr;
-            dstVec = (vector3*)dstPtr;
-            dstVec->set(0.0f, 0.0f, 0.0f);
-            for (i = 0; i < 4; i++)
-            {
-                const matrix33& m = this->skeleton->GetJointAt(jointIndex[i]).GetSkinMatrix33();
-                if (weights[i] > 0.0f)
-                {
-                    *dstVec += (m * (*srcVec)) * weights[i];
-                }
-            }
-            srcPtr += 3;
-            dstPtr += 3;
+            TransformDirection(m, src + layout.srcNormal, dst + layout.dstNormal);
         }
-        if (srcCompMask & nMesh2::Uv0)
+        if (-1 != layout.srcTangent)
         {
-            *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++;
+            TransformDirection(m, src + layout.srcTangent, dst + layout.dstTangent);
         }
-        if (srcCompMask & nMesh2::Uv1)
+        if (-1 != layout.srcBinormal)
         {
-            *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++;
+            TransformDirection(m, src + layout.srcBinormal, dst + layout.dstBinormal);
         }
-        if (srcCompMask & nMesh2::Uv2)
+
+        // unskinned components
+        for (i = 0; i < layout.numCopyRanges; i++)
+        {
+            const float* from = src + layout.copySrc[i];
+            float* to = dst + layout.copyDst[i];
+            int j;
+            for (j = 0; j < layout.copySize[i]; j++)
+            {
+                to[j] = from[j];
+            }
+        }
+
+        src += layout.srcWidth;
+        dst += layout.dstWidth;
+    }
+}
+
+#ifdef __NEBULA_SKINNING_SSE__
+//------------------------------------------------------------------------------
+/**
+    Store the x, y and z component of a SSE register.
+*/
+static inline
+void
+StoreXYZ(float* dst, __m128 v)
+{
+    _mm_storel_pi((__m64*)dst, v);
+    _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Transform a direction with the rows of a blended matrix.
+*/
+static inline
+__m128
+TransformDirectionSSE(const float* v, __m128 r0, __m128 r1, __m128 r2)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[0]), r0),
+                                 _mm_mul_ps(_mm_set1_ps(v[1]), r1)),
+                      _mm_mul_ps(_mm_set1_ps(v[2]), r2));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Skin vertices, SSE version. Every row of the blended matrix lives in
+    one SSE register, a transformed vector is the sum of the rows scaled
+    by the vector components.
+*/
+void
+nSkinMeshDeformer::SkinVerticesSSE(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+    int vertexIndex;
+    for (vertexIndex = 0; vertexIndex < numVertices; vertexIndex++)
+    {
+        // blend the weighted joint matrices
+        const float* weights = src + layout.weights;
+        const float* indices = src + layout.jindices;
+        __m128 r0 = _mm_setzero_ps();
+        __m128 r1 = _mm_setzero_ps();
+        __m128 r2 = _mm_setzero_ps();
+        __m128 r3 = _mm_setzero_ps();
+        int i;
+        for (i = 0; i < 4; i++)
         {
-            *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++;
+            float w = weights[i];
+            if (w > 0.0f)
+            {
+                const float* jm = &(skinMatrices[int(indices[i])].M11);
+                __m128 weight = _mm_set1_ps(w);
+                r0 = _mm_add_ps(r0, _mm_mul_ps(weight, _mm_loadu_ps(jm)));
+                r1 = _mm_add_ps(r1, _mm_mul_ps(weight, _mm_loadu_ps(jm + 4)));
+                r2 = _mm_add_ps(r2, _mm_mul_ps(weight, _mm_loadu_ps(jm + 8)));
+                r3 = _mm_add_ps(r3, _mm_mul_ps(weight, _mm_loadu_ps(jm + 12)));
+            }
         }
-        if (srcCompMask & nMesh2::Uv3)
+
+        // position
+        StoreXYZ(dst, _mm_add_ps(TransformDirectionSSE(src, r0, r1, r2), r3));
+
+        // directions
+        if (-1 != layout.srcNormal)
         {
-            *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++;
+            StoreXYZ(dst + layout.dstNormal, TransformDirectionSSE(src + layout.srcNormal, r0, r1, r2));
         }
-        if (srcCompMask & nMesh2::Color)
+        if (-1 != layout.srcTangent)
         {
-            *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++; *dstPtr++ = *srcPtr++;
-
+            StoreXYZ(dst + layout.dstTangent, TransformDirectionSSE(src + layout.srcTangent, r0, r1, r2));
         }
-        if (srcCompMask & nMesh2::Tangent)
+        if (-1 != layout.srcBinormal)
         {
-            srcVec = (vector3*)srcPtr;
-            dstVec = (vector3*)dstPtr;
-            dstVec->set(0.0f, 0.0f, 0.0f);
-            for (i = 0; i < 4; i++)
-            {
-                const matrix33& m = this->skeleton->GetJointAt(jointIndex[i]).GetSkinMatrix33();
-                if (weights[i] > 0.0f)
-                {
-                    *dstVec += (m * (*srcVec)) * weights[i];
-                }
-            }
-            srcPtr += 3;
-            dstPtr += 3;
+            StoreXYZ(dst + layout.dstBinormal, TransformDirectionSSE(src + layout.srcBinormal, r0, r1, r2));
         }
-        if (srcCompMask & nMesh2::Binormal)
+
+        // unskinned components
+        for (i = 0; i < layout.numCopyRanges; i++)
         {
-            srcVec = (vector3*)srcPtr;
-            dstVec = (vector3*)dstPtr;
-            dstVec->set(0.0f, 0.0f, 0.0f);
-            for (i = 0; i < 4; i++)
+            const float* from = src + layout.copySrc[i];
+            float* to = dst + layout.copyDst[i];
+            int j;
+            for (j = 0; j < layout.copySize[i]; j++)
             {
-                const matrix33& m = this->skeleton->GetJointAt(jointIndex[i]).GetSkinMatrix33();
-                if (weights[i] > 0.0f)
-                {
-                    *dstVec += (m * (*srcVec)) * weights[i];
-                }
+                to[j] = from[j];
             }
-            srcPtr += 3;
-            dstPtr += 3;
         }
 
-        // skip source weights and joint indices
-        srcPtr += 8;
+        src += layout.srcWidth;
+        dst += layout.dstWidth;
     }
-    dstMesh->UnlockVertices();
-    srcMesh->UnlockVertices();
 }
+#endif
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,226 @@
+//------------------------------------------------------------------------------
+//  nnpkblockcache.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "file/nnpkblockcache.h"
+#include "file/nnpkcodec.h"
+#include "file/nnpktocentry.h"
+#include "file/nnpkfilewrapper.h"
+#include "mathlib/nmath.h"
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkBlockCache::nNpkBlockCache() :
+    blocks(32, 32),
+    useCounter(0),
+    numHits(0),
+    numMisses(0)
+{
+    this->SetNumBlocks(32);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkBlockCache::~nNpkBlockCache()
+{
+    this->SetNumBlocks(0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Wait until no block is being decoded by another thread. The cache must
+    be locked, it is unlocked while waiting.
+*/
+void
+nNpkBlockCache::WaitDecoding()
+{
+    int i;
+    for (i = 0; i < this->blocks.Size(); i++)
+    {
+        if (Decoding == this->blocks[i].state)
+        {
+            this->mutex.Unlock();
+            n_sleep(0.0);
+            this->mutex.Lock();
+            i = -1;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the number of cached blocks, this discards the current contents
+    of the cache.
+*/
+void
+nNpkBlockCache::SetNumBlocks(int num)
+{
+    n_assert(num >= 0);
+    this->mutex.Lock();
+    this->WaitDecoding();
+    int i;
+    for (i = 0; i < this->blocks.Size(); i++)
+    {
+        n_delete_array(this->blocks[i].data);
+    }
+    this->blocks.Clear();
+    for (i = 0; i < num; i++)
+    {
+        Block block;
+        block.entry = 0;
+        block.blockIndex = 0;
+        block.state = Empty;
+        block.lastUse = 0;
+        block.size = 0;
+        block.data = n_new_array(char, nNpkCodec::BlockSize);
+        this->blocks.Append(block);
+    }
+    this->mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Discard all cached blocks. Blocks which are being decoded are
+    detached from their toc entry, and discarded when the decode is done.
+*/
+void
+nNpkBlockCache::Clear()
+{
+    this->mutex.Lock();
+    int i;
+    for (i = 0; i < this->blocks.Size(); i++)
+    {
+        Block& block = this->blocks[i];
+        block.entry = 0;
+        block.lastUse = 0;
+        if (Valid == block.state)
+        {
+            block.state = Empty;
+        }
+    }
+    this->mutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkBlockCache::Block*
+nNpkBlockCache::FindBlock(nNpkTocEntry* entry, int blockIndex)
+{
+    int i;
+    for (i = 0; i < this->blocks.Size(); i++)
+    {
+        Block& cur = this->blocks[i];
+        if ((cur.entry == entry) && (cur.blockIndex == blockIndex))
+        {
+            return &cur;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkBlockCache::Block*
+nNpkBlockCache::FindLruBlock()
+{
+    Block* lruBlock = 0;
+    int i;
+    for (i = 0; i < this->blocks.Size(); i++)
+    {
+        Block& cur = this->blocks[i];
+        if ((Decoding != cur.state) && ((0 == lruBlock) || (cur.lastUse < lruBlock->lastUse)))
+        {
+            lruBlock = &cur;
+        }
+    }
+    return lruBlock;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Copy data from a decoded block of a compressed toc entry. If the
+    block isn't in the cache, the least recently used block is reserved
+    and the block is decoded into it without holding the lock. If the
+    block is being decoded by another thread, wait until it's published.
+
+    @param  entry           a compressed file toc entry
+    @param  blockIndex      index of block in entry
+    @param  blockOffset     start offset in decoded block
+    @param  buffer          destination buffer
+    @param  numBytes        number of bytes to copy
+    @return                 number of bytes copied
+*/
+int
+nNpkBlockCache::Read(nNpkTocEntry* entry, int blockIndex, int blockOffset, void* buffer, int numBytes)
+{
+    n_assert(entry && entry->IsCompressed());
+    n_assert(buffer);
+
+    this->mutex.Lock();
+
+    // wait while another thread decodes the block
+    Block* block = this->FindBlock(entry, blockIndex);
+    while (block && (Decoding == block->state))
+    {
+        this->mutex.Unlock();
+        n_sleep(0.0);
+        this->mutex.Lock();
+        block = this->FindBlock(entry, blockIndex);
+    }
+
+    int bytesRead = 0;
+    if (block)
+    {
+        this->numHits++;
+        block->lastUse = ++this->useCounter;
+        if (blockOffset < block->size)
+        {
+            bytesRead = n_min(numBytes, block->size - blockOffset);
+            memcpy(buffer, block->data + blockOffset, bytesRead);
+        }
+        this->mutex.Unlock();
+        return bytesRead;
+    }
+
+    // without a free cache block, decode directly
+    this->numMisses++;
+    block = this->FindLruBlock();
+    if (0 == block)
+    {
+        this->mutex.Unlock();
+        return entry->GetFileWrapper()->ReadBlock(entry, blockIndex, blockOffset, buffer, numBytes);
+    }
+
+    // reserve the block and decode it without holding the lock
+    block->entry = entry;
+    block->blockIndex = blockIndex;
+    block->state = Decoding;
+    block->lastUse = ++this->useCounter;
+    this->mutex.Unlock();
+
+    int size = entry->GetFileWrapper()->DecodeBlock(entry, blockIndex, block->data);
+    if (blockOffset < size)
+    {
+        bytesRead = n_min(numBytes, size - blockOffset);
+        memcpy(buffer, block->data + blockOffset, bytesRead);
+    }
+
+    // publish the block, unless it has failed or has been cleared meanwhile
+    this->mutex.Lock();
+    block->size = size;
+    if ((size >= 0) && (block->entry == entry))
+    {
+        block->state = Valid;
+    }
+    else
+    {
+        block->entry = 0;
+        block->state = Empty;
+    }
+    this->mutex.Unlock();
+    return bytesRead;
+}
@@ -0,0 +1,353 @@
+//------------------------------------------------------------------------------
+//  nnpkcodec.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "file/nnpkcodec.h"
+#include "mathlib/nmath.h"
+#include <string.h>
+
+// the last bytes of a block are always literals
+static const int LastLiterals = 5;
+// no match may start within the last bytes of a block
+static const int MatchFindLimit = 12;
+static const int MinMatch = 4;
+static const int MaxOffset = 65535;
+static const int HashLog = 12;
+
+//------------------------------------------------------------------------------
+/**
+*/
+static inline
+uint
+Read32(const uchar* ptr)
+{
+    uint val;
+    memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static inline
+uint
+Hash32(uint val)
+{
+    return (val * 2654435761u) >> (32 - HashLog);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write a length which doesn't fit into a token nibble.
+*/
+static inline
+uchar*
+WriteLength(uchar* op, int len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uchar) len;
+    return op;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write literals and an optional match as one token. Returns 0 if the
+    output doesn't fit into the destination buffer.
+*/
+static
+uchar*
+WriteSequence(uchar* op, uchar* opEnd, const uchar* literals, int numLiterals, int offset, int matchLen)
+{
+    // worst case size of the sequence
+    if ((op + 1 + numLiterals + (numLiterals / 255) + 1 + 2 + (matchLen / 255) + 1) > opEnd)
+    {
+        return 0;
+    }
+
+    uchar* token = op++;
+    uchar tokenVal = 0;
+    if (numLiterals >= 15)
+    {
+        tokenVal = 15 << 4;
+        op = WriteLength(op, numLiterals - 15);
+    }
+    else
+    {
+        tokenVal = (uchar) (numLiterals << 4);
+    }
+    memcpy(op, literals, numLiterals);
+    op += numLiterals;
+
+    if (matchLen > 0)
+    {
+        *op++ = (uchar) (offset & 0xff);
+        *op++ = (uchar) (offset >> 8);
+        int len = matchLen - MinMatch;
+        if (len >= 15)
+        {
+            tokenVal |= 15;
+            op = WriteLength(op, len - 15);
+        }
+        else
+        {
+            tokenVal |= (uchar) len;
+        }
+    }
+    *token = tokenVal;
+    return op;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compress a block with a greedy match finder (one hash table probe
+    per position).
+
+    @param  src             source data
+    @param  srcSize         source size in bytes
+    @param  dst             destination buffer
+    @param  dstCapacity     size of destination buffer
+    @return                 compressed size, or 0 if the destination is too small
+*/
+int
+nNpkCodec::Compress(const void* src, int srcSize, void* dst, int dstCapacity)
+{
+    n_assert(src && dst);
+    const uchar* srcStart = (const uchar*) src;
+    const uchar* srcEnd = srcStart + srcSize;
+    const uchar* ip = srcStart;
+    const uchar* anchor = srcStart;
+    uchar* op = (uchar*) dst;
+    uchar* opEnd = op + dstCapacity;
+
+    if (srcSize > MatchFindLimit)
+    {
+        const uchar* matchLimit = srcEnd - LastLiterals;
+        const uchar* findLimit = srcEnd - MatchFindLimit;
+        int hashTable[1 << HashLog];
+        memset(hashTable, 0, sizeof(hashTable));
+        while (ip < findLimit)
+        {
+            uint seq = Read32(ip);
+            uint h = Hash32(seq);
+            const uchar* ref = srcStart + hashTable[h];
+            hashTable[h] = int(ip - srcStart);
+            int offset = int(ip - ref);
+            if ((offset > 0) && (offset <= MaxOffset) && (Read32(ref) == seq))
+            {
+                int matchLen = MinMatch;
+                while (((ip + matchLen) < matchLimit) && (ref[matchLen] == ip[matchLen]))
+                {
+                    matchLen++;
+                }
+                op = WriteSequence(op, opEnd, anchor, int(ip - anchor), offset, matchLen);
+                if (0 == op)
+                {
+                    return 0;
+                }
+                ip += matchLen;
+                anchor = ip;
+            }
+            else
+            {
+                ip++;
+            }
+        }
+    }
+
+    // the remaining literals
+    op = WriteSequence(op, opEnd, anchor, int(srcEnd - anchor), 0, 0);
+    if (0 == op)
+    {
+        return 0;
+    }
+    return int(op - (uchar*) dst);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Decompress a block. All reads and writes are bounds checked, so
+    corrupt data can't overrun the buffers.
+
+    @param  src         compressed data
+    @param  srcSize     compressed size in bytes
+    @param  dst         destination buffer
+    @param  dstSize     decoded size of the block
+    @return             number of decoded bytes, or -1 on corrupt data
+*/
+int
+nNpkCodec::Decompress(const void* src, int srcSize, void* dst, int dstSize)
+{
+    n_assert(src && dst);
+    const uchar* ip = (const uchar*) src;
+    const uchar* ipEnd = ip + srcSize;
+    uchar* op = (uchar*) dst;
+    uchar* opStart = op;
+    uchar* opEnd = op + dstSize;
+
+    while (ip < ipEnd)
+    {
+        uint token = *ip++;
+
+        // literals
+        int numLiterals = token >> 4;
+        if (15 == numLiterals)
+        {
+            uint b;
+            do
+            {
+                if (ip >= ipEnd)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                numLiterals += b;
+            }
+            while (255 == b);
+        }
+        if (((ipEnd - ip) < numLiterals) || ((opEnd - op) < numLiterals))
+        {
+            return -1;
+        }
+        memcpy(op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // the last sequence has no match
+        if (ip >= ipEnd)
+        {
+            break;
+        }
+
+        // match
+        if ((ipEnd - ip) < 2)
+        {
+            return -1;
+        }
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ((0 == offset) || (offset > (op - opStart)))
+        {
+            return -1;
+        }
+        int matchLen = token & 15;
+        if (15 == matchLen)
+        {
+            uint b;
+            do
+            {
+                if (ip >= ipEnd)
+                {
+                    return -1;
+                }
+                b = *ip++;
+                matchLen += b;
+            }
+            while (255 == b);
+        }
+        matchLen += MinMatch;
+        if ((opEnd - op) < matchLen)
+        {
+            return -1;
+        }
+
+        // an overlapping match repeats a pattern, copy it bytewise
+        const uchar* ref = op - offset;
+        if (offset >= matchLen)
+        {
+            memcpy(op, ref, matchLen);
+            op += matchLen;
+        }
+        else
+        {
+            uchar* matchEnd = op + matchLen;
+            while (op < matchEnd)
+            {
+                *op++ = *ref++;
+            }
+        }
+    }
+    return int(op - opStart);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compress an entire npk file entry into the block table and blocks.
+    Returns false if compression saves less than 1/16 of the entry, in
+    this case the entry should be stored uncompressed. On success, dst
+    is allocated with n_new_array() and must be freed by the caller.
+
+    @param  src         entry data
+    @param  srcSize     entry size in bytes
+    @param  dst         [out] compressed entry data
+    @param  dstSize     [out] compressed entry size
+    @return             true if the entry has been compressed
+*/
+bool
+nNpkCodec::CompressEntry(const void* src, int srcSize, char*& dst, int& dstSize)
+{
+    n_assert(src);
+    dst = 0;
+    dstSize = 0;
+    if (srcSize <= 0)
+    {
+        return false;
+    }
+
+    int numBlocks = GetNumBlocks(srcSize);
+    int tableSize = (numBlocks + 1) * sizeof(int);
+    int maxSize = srcSize - (srcSize / 16);
+    if (tableSize >= maxSize)
+    {
+        return false;
+    }
+
+    char* buffer = n_new_array(char, maxSize);
+    char* blockBuffer = n_new_array(char, GetMaxCompressedSize(BlockSize));
+    int* blockOffsets = n_new_array(int, numBlocks + 1);
+    int pos = tableSize;
+    bool success = true;
+    int blockIndex;
+    for (blockIndex = 0; success && (blockIndex < numBlocks); blockIndex++)
+    {
+        const char* block = (const char*) src + blockIndex * BlockSize;
+        int blockSize = n_min(BlockSize, srcSize - blockIndex * BlockSize);
+        int compressedSize = Compress(block, blockSize, blockBuffer, GetMaxCompressedSize(BlockSize));
+
+        // store the block raw if it doesn't compress
+        const char* blockData = blockBuffer;
+        if ((0 == compressedSize) || (compressedSize >= blockSize))
+        {
+            blockData = block;
+            compressedSize = blockSize;
+        }
+        if ((pos + compressedSize) > maxSize)
+        {
+            success = false;
+        }
+        else
+        {
+            blockOffsets[blockIndex] = pos;
+            memcpy(buffer + pos, blockData, compressedSize);
+            pos += compressedSize;
+        }
+    }
+    blockOffsets[numBlocks] = pos;
+    memcpy(buffer, blockOffsets, tableSize);
+
+    n_delete_array(blockOffsets);
+    n_delete_array(blockBuffer);
+    if (success)
+    {
+        dst = buffer;
+        dstSize = pos;
+    }
+    else
+    {
+        n_delete_array(buffer);
+    }
+    return success;
+}
@@ -5,6 +5,7 @@
 #include "file/nnpkdirectory.h"
 #include "file/nnpkfileserver.h"
 #include "file/nnpktocentry.h"
+#include "file/nnpkfilewrapper.h"
 
 //------------------------------------------------------------------------------
 /**
@@ -196,7 +197,8 @@ nNpkDirectory::SetToFirstNpkEntry()
     n_assert(this->isNpkDir);
     n_assert(this->tocEntry);
 
-    this->curSearchEntry = this->tocEntry->GetFirstEntry();
+    const nNpkTocIndex& index = this->tocEntry->GetFileWrapper()->GetTocObject().GetIndex();
+    this->curSearchEntry = index.GetFirstChild(this->tocEntry);
     return (0 != this->curSearchEntry);
 }
 
@@ -210,7 +212,8 @@ nNpkDirectory::SetToNextNpkEntry()
     n_assert(this->tocEntry);
     n_assert(this->curSearchEntry);
 
-    this->curSearchEntry = this->tocEntry->GetNextEntry(this->curSearchEntry);
+    const nNpkTocIndex& index = this->tocEntry->GetFileWrapper()->GetTocObject().GetIndex();
+    this->curSearchEntry = index.GetNextSibling(this->curSearchEntry);
     return (0 != this->curSearchEntry);
 }
 
@@ -126,40 +126,44 @@ nNpkFile::Read(void* buffer, int numBytes)
     n_assert(this->IsOpen());
     n_assert(this->tocEntry);
 
-    // read access goes through a npk file:
-    //  - get the actual file handle from the toc entry (binary or ascii)
-    //  - clamp numBytes if necessary (if read would go past end of file)
-    //  - adjust the current file offset
-    //  - do the read operation
-    //  - store new file pos
+    // read access goes through a npk file, this doesn't touch the
+    // file position of the npk file, compressed entries are decoded
+    // through the file server's block cache
     nNpkFileWrapper* fileWrapper = this->tocEntry->GetFileWrapper();
     n_assert(fileWrapper);
-    nFile* file;
-    if (this->isAsciiAccess)
-    {
-        file = fileWrapper->GetAsciiFile();
-    }
-    else
+    n_assert(this->filePos <= this->tocEntry->GetFileLength());
+    nNpkBlockCache* blockCache = ((nNpkFileServer*)nFileServer2::Instance())->GetBlockCache();
+    int bytesRead = fileWrapper->ReadEntry(this->tocEntry, this->filePos, buffer, numBytes, blockCache);
+    this->filePos += bytesRead;
+    return bytesRead;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Return a pointer to the next numBytes in the memory mapped npk file,
+    and advance the file position. Returns 0 if this is a conventional
+    file, the npk file is not mapped, the entry is compressed, or if less
+    than numBytes remain.
+*/
+const void*
+nNpkFile::ReadMapped(int numBytes)
+{
+    n_assert(this->IsOpen());
+    if (!this->isNpkFile)
     {
-        file = fileWrapper->GetBinaryFile();
+        return nFile::ReadMapped(numBytes);
     }
-    n_assert(file);
-
-    // clamp numBytes if read would go past end of file
-    int fileLength = tocEntry->GetFileLength();
-    n_assert(this->filePos <= fileLength);
+    n_assert(this->tocEntry);
 
-    int endPos = this->filePos + numBytes;
-    if (endPos >= fileLength)
+    nNpkFileWrapper* fileWrapper = this->tocEntry->GetFileWrapper();
+    n_assert(fileWrapper);
+    if (!fileWrapper->IsMapped() || this->tocEntry->IsCompressed() || ((this->filePos + numBytes) > this->tocEntry->GetFileLength()))
     {
-        numBytes = fileLength - this->filePos;
+        return 0;
     }
-
-    // adjust the file position and read bytes
-    file->Seek(tocEntry->GetFileOffset() + this->filePos, START);
-    int bytesRead = file->Read(buffer, numBytes);
-    this->filePos += bytesRead;
-    return bytesRead;
+    const void* ptr = fileWrapper->GetMappedData(this->tocEntry->GetFileOffset() + this->filePos);
+    this->filePos += numBytes;
+    return ptr;
 }
 
 //------------------------------------------------------------------------------
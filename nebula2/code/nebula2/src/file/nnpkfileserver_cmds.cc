@@ -5,6 +5,8 @@
 #include "file/nnpkfileserver.h"
 
 static void n_parsedirectory(void* slf, nCmd* cmd);
+static void n_setblockcachesize(void* slf, nCmd* cmd);
+static void n_getblockcachesize(void* slf, nCmd* cmd);
 
 //------------------------------------------------------------------------------
 /**
@@ -25,6 +27,8 @@ n_initcmds(nClass* cl)
 {
     cl->BeginCmds();
     cl->AddCmd("i_parsedirectory_ss", 'PRSD', n_parsedirectory);
+    cl->AddCmd("v_setblockcachesize_i", 'SBCS', n_setblockcachesize);
+    cl->AddCmd("i_getblockcachesize_v", 'GBCS', n_getblockcachesize);
     cl->EndCmds();
 }
 
@@ -53,3 +57,47 @@ n_parsedirectory(void* slf, nCmd* cmd)
     cmd->Out()->SetI(self->ParseDirectory(s0, s1));
 }
 
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    setblockcachesize
+
+    @input
+    i(NumBlocks)
+
+    @output
+    v
+
+    @info
+    Set the number of decoded 64 KB blocks of compressed npk file
+    entries which are cached (default is 32).
+*/
+static
+void
+n_setblockcachesize(void* slf, nCmd* cmd)
+{
+    nNpkFileServer* self = (nNpkFileServer*) slf;
+    self->SetBlockCacheSize(cmd->In()->GetI());
+}
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    getblockcachesize
+
+    @input
+    v
+
+    @output
+    i(NumBlocks)
+
+    @info
+    Get the number of cached decoded blocks of compressed npk file entries.
+*/
+static
+void
+n_getblockcachesize(void* slf, nCmd* cmd)
+{
+    nNpkFileServer* self = (nNpkFileServer*) slf;
+    cmd->Out()->SetI(self->GetBlockCacheSize());
+}
@@ -26,6 +26,7 @@ nNpkFileServer::nNpkFileServer()
 nNpkFileServer::~nNpkFileServer()
 {
     // delete npk file wrappers
+    this->blockCache.Clear();
     nNpkFileWrapper* cur;
     while ((cur = (nNpkFileWrapper*) this->npkFiles.RemHead()))
     {
@@ -131,6 +132,7 @@ nNpkFileServer::AddNpkFile(const nString& rootPath, const nString& absFilename)
     n_assert(!absFilename.IsEmpty());
 
     // first check if file wrapper already exists, and delete it
+    this->blockCache.Clear();
     nNpkFileWrapper* curFileWrapper = (nNpkFileWrapper*) this->npkFiles.GetHead();
     while (curFileWrapper)
     {
@@ -211,6 +213,7 @@ nNpkFileServer::Pack(const nString& rootPath, const nString& dirName, const nStr
 void
 nNpkFileServer::ReleaseNpkFiles(const nString& pattern)
 {
+    this->blockCache.Clear();
     nNpkFileWrapper* cur = 0;
     nNpkFileWrapper* next = 0;
     if ((cur = (nNpkFileWrapper*) this->npkFiles.GetHead()))
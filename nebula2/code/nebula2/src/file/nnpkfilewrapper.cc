@@ -5,6 +5,17 @@
 #include "file/nnpkfilewrapper.h"
 #include "kernel/nfileserver2.h"
 #include "kernel/nfile.h"
+#include "file/nnpkcodec.h"
+#include "file/nnpkblockcache.h"
+#include "mathlib/nmath.h"
+
+#if defined(__LINUX__) || defined(__MACOSX__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 //------------------------------------------------------------------------------
 /**
@@ -12,10 +23,18 @@
 nNpkFileWrapper::nNpkFileWrapper() :
     isOpen(false),
     dataOffset(0),
+    version(0),
     binaryFile(0),
-    asciiFile(0)
+    asciiFile(0),
+    mappedData(0),
+    mappedSize(0)
 {
-
+    #ifdef __WIN32__
+    this->nativeHandle = INVALID_HANDLE_VALUE;
+    this->mappingHandle = 0;
+    #elif defined(__LINUX__) || defined(__MACOSX__)
+    this->nativeHandle = -1;
+    #endif
 }
 
 //------------------------------------------------------------------------------
@@ -88,6 +107,7 @@ nNpkFileWrapper::Open(nFileServer2* fs, const char* rootPath, const char* absFil
         return 0;
     }
 
+    this->OpenMapping();
     this->isOpen = true;
     return true;
 }
@@ -103,6 +123,7 @@ nNpkFileWrapper::Close()
     n_assert(this->binaryFile && this->binaryFile->IsOpen());
     n_assert(this->asciiFile && this->asciiFile->IsOpen());
 
+    this->CloseMapping();
     this->binaryFile->Close();
     this->asciiFile->Close();
     this->binaryFile->Release();
@@ -155,7 +176,15 @@ bool
 nNpkFileWrapper::ReadHeader(nFile* file)
 {
     int magic = file->GetInt();
-    if (magic != 'NPK0')
+    if ('NPK0' == magic)
+    {
+        this->version = 0;
+    }
+    else if ('NPK2' == magic)
+    {
+        this->version = 2;
+    }
+    else
     {
         return false;
     }
@@ -227,6 +256,22 @@ nNpkFileWrapper::ReadTocEntries(nFile* file)
 
 //            n_printf("=> file '%s'\n", nameBuf);
         }
+        else if (('FIL2' == fourcc) && (2 == this->version))
+        {
+            // a file which may be compressed
+            int fileOffset = file->GetInt();
+            int fileLength = file->GetInt();
+            int compressedLength = file->GetInt();
+            int codec = file->GetInt();
+            short fileNameLen = file->GetShort();
+            file->Read(nameBuf, fileNameLen);
+            nameBuf[fileNameLen] = 0;
+
+            fileOffset += this->dataOffset;
+            nNpkTocEntry* newEntry = this->toc.AddFileEntry(nameBuf, fileOffset, fileLength);
+            newEntry->SetCompression(codec, compressedLength);
+            newEntry->SetFileWrapper(this);
+        }
         else
         {
             // end of toc
@@ -260,8 +305,348 @@ nNpkFileWrapper::ParseToc(const char* rootPath)
         n_printf("Error parsing table of contents in npk file '%s'\n", this->absPath.Get());
         return false;
     }
+    if (0 == this->toc.GetRootEntry())
+    {
+        n_printf("Empty table of contents in npk file '%s'\n", this->absPath.Get());
+        return false;
+    }
+
+    // build the lookup index over all entries
+    this->toc.BuildIndex();
     return true;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Map the npk file into memory. If this fails, at least keep a native
+    file handle open for positional reads. If that fails as well, reads
+    are serialized through the binary file object.
+*/
+void
+nNpkFileWrapper::OpenMapping()
+{
+    n_assert(0 == this->mappedData);
+    this->mappedSize = this->binaryFile->GetSize();
+
+#ifdef __WIN32__
+    this->nativeHandle = CreateFile(this->absPath.Get(),    // filename
+                                    GENERIC_READ,           // access mode
+                                    FILE_SHARE_READ,        // share mode
+                                    0,                      // security flags
+                                    OPEN_EXISTING,          // what to do if file doesn't exist
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+                                    0);                     // template file
+    if (INVALID_HANDLE_VALUE == this->nativeHandle)
+    {
+        n_printf("nNpkFileWrapper: could not open native handle for '%s'!\n", this->absPath.Get());
+        return;
+    }
+    if (this->mappedSize > 0)
+    {
+        this->mappingHandle = CreateFileMapping(this->nativeHandle, 0, PAGE_READONLY, 0, 0, 0);
+        if (this->mappingHandle)
+        {
+            this->mappedData = (const uchar*) MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+            if (0 == this->mappedData)
+            {
+                CloseHandle(this->mappingHandle);
+                this->mappingHandle = 0;
+            }
+        }
+    }
+#elif defined(__LINUX__) || defined(__MACOSX__)
+    this->nativeHandle = open(this->absPath.Get(), O_RDONLY);
+    if (-1 == this->nativeHandle)
+    {
+        n_printf("nNpkFileWrapper: could not open native handle for '%s'!\n", this->absPath.Get());
+        return;
+    }
+    if (this->mappedSize > 0)
+    {
+        void* ptr = mmap(0, this->mappedSize, PROT_READ, MAP_SHARED, this->nativeHandle, 0);
+        if (MAP_FAILED != ptr)
+        {
+            this->mappedData = (const uchar*) ptr;
+        }
+    }
+#endif
+
+    if (0 == this->mappedData)
+    {
+        n_printf("nNpkFileWrapper: could not map '%s', using positional reads\n", this->absPath.Get());
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nNpkFileWrapper::CloseMapping()
+{
+#ifdef __WIN32__
+    if (this->mappedData)
+    {
+        UnmapViewOfFile(this->mappedData);
+    }
+    if (this->mappingHandle)
+    {
+        CloseHandle(this->mappingHandle);
+        this->mappingHandle = 0;
+    }
+    if (INVALID_HANDLE_VALUE != this->nativeHandle)
+    {
+        CloseHandle(this->nativeHandle);
+        this->nativeHandle = INVALID_HANDLE_VALUE;
+    }
+#elif defined(__LINUX__) || defined(__MACOSX__)
+    if (this->mappedData)
+    {
+        munmap((void*) this->mappedData, this->mappedSize);
+    }
+    if (-1 != this->nativeHandle)
+    {
+        close(this->nativeHandle);
+        this->nativeHandle = -1;
+    }
+#endif
+    this->mappedData = 0;
+    this->mappedSize = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read bytes at an absolute offset in the npk file. This doesn't use
+    a shared file position and may be called from several threads at
+    the same time.
 
+    @param  buffer      destination buffer
+    @param  offset      absolute offset in npk file
+    @param  numBytes    number of bytes to read
+    @return             number of bytes read
+*/
+int
+nNpkFileWrapper::ReadAt(void* buffer, int offset, int numBytes)
+{
+    n_assert(this->isOpen);
+    n_assert(buffer);
+    n_assert(offset >= 0);
+    n_assert(numBytes >= 0);
 
+    if (this->mappedData)
+    {
+        // clamp against file size
+        if (offset >= this->mappedSize)
+        {
+            return 0;
+        }
+        if (offset + numBytes > this->mappedSize)
+        {
+            numBytes = this->mappedSize - offset;
+        }
+        memcpy(buffer, this->mappedData + offset, numBytes);
+        return numBytes;
+    }
+
+#ifdef __WIN32__
+    if (INVALID_HANDLE_VALUE != this->nativeHandle)
+    {
+        OVERLAPPED overlapped = { 0 };
+        overlapped.Offset = (DWORD) offset;
+        DWORD bytesRead = 0;
+        if (!ReadFile(this->nativeHandle, buffer, numBytes, &bytesRead, &overlapped))
+        {
+            return 0;
+        }
+        return (int) bytesRead;
+    }
+#elif defined(__LINUX__) || defined(__MACOSX__)
+    if (-1 != this->nativeHandle)
+    {
+        // pread() may return less than requested, loop until done
+        int bytesRead = 0;
+        while (bytesRead < numBytes)
+        {
+            ssize_t res = pread(this->nativeHandle, (char*) buffer + bytesRead, numBytes - bytesRead, offset + bytesRead);
+            if (res <= 0)
+            {
+                break;
+            }
+            bytesRead += (int) res;
+        }
+        return bytesRead;
+    }
+#endif
+
+    // no native handle, serialize seek and read on the binary file
+    this->readMutex.Lock();
+    this->binaryFile->Seek(offset, nFile::START);
+    int bytesRead = this->binaryFile->Read(buffer, numBytes);
+    this->readMutex.Unlock();
+    return bytesRead;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read from a file entry. Uncompressed entries are read directly,
+    compressed entries are decoded block by block, through the block
+    cache if one is provided.
+
+    @param  entry       a file toc entry of this npk file
+    @param  pos         start position in (decoded) file entry
+    @param  buffer      destination buffer
+    @param  numBytes    number of bytes to read
+    @param  blockCache  optional block cache, may be 0
+    @return             number of bytes read
+*/
+int
+nNpkFileWrapper::ReadEntry(nNpkTocEntry* entry, int pos, void* buffer, int numBytes, nNpkBlockCache* blockCache)
+{
+    n_assert(entry && (nNpkTocEntry::FILE == entry->GetType()));
+    n_assert(entry->GetFileWrapper() == this);
+    n_assert(pos >= 0);
+
+    // clamp numBytes if read would go past end of file
+    int fileLength = entry->GetFileLength();
+    if (pos >= fileLength)
+    {
+        return 0;
+    }
+    if ((pos + numBytes) > fileLength)
+    {
+        numBytes = fileLength - pos;
+    }
+
+    if (!entry->IsCompressed())
+    {
+        return this->ReadAt(buffer, entry->GetFileOffset() + pos, numBytes);
+    }
+
+    // decode the touched blocks, whole blocks are decoded directly
+    // into the destination buffer, partial blocks go through the cache
+    char* dst = (char*) buffer;
+    int bytesRead = 0;
+    while (bytesRead < numBytes)
+    {
+        int curPos = pos + bytesRead;
+        int blockIndex = curPos / nNpkCodec::BlockSize;
+        int blockOffset = curPos % nNpkCodec::BlockSize;
+        int num = n_min(numBytes - bytesRead, nNpkCodec::BlockSize - blockOffset);
+        int res;
+        int blockSize = n_min(int(nNpkCodec::BlockSize), fileLength - blockIndex * nNpkCodec::BlockSize);
+        if (blockCache && ((blockOffset > 0) || (num < blockSize)))
+        {
+            res = blockCache->Read(entry, blockIndex, blockOffset, dst + bytesRead, num);
+        }
+        else
+        {
+            res = this->ReadBlock(entry, blockIndex, blockOffset, dst + bytesRead, num);
+        }
+        if (res <= 0)
+        {
+            break;
+        }
+        bytesRead += res;
+    }
+    return bytesRead;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Decode one block of a compressed file entry. The block data is
+    accessed directly in the mapped npk file if possible.
+
+    @param  entry       a compressed file toc entry of this npk file
+    @param  blockIndex  index of block
+    @param  buffer      destination buffer of at least nNpkCodec::BlockSize bytes
+    @return             decoded size of block, or -1 on error
+*/
+int
+nNpkFileWrapper::DecodeBlock(nNpkTocEntry* entry, int blockIndex, void* buffer)
+{
+    n_assert(entry && entry->IsCompressed());
+    n_assert(buffer);
+    if (nNpkCodec::Lz != entry->GetCodec())
+    {
+        n_printf("nNpkFileWrapper: unsupported codec %d in '%s'!\n", entry->GetCodec(), this->absPath.Get());
+        return -1;
+    }
+    int numBlocks = nNpkCodec::GetNumBlocks(entry->GetFileLength());
+    n_assert((blockIndex >= 0) && (blockIndex < numBlocks));
+
+    // read start and end of block from the block table
+    int entryOffset = entry->GetFileOffset();
+    int blockRange[2];
+    if (this->ReadAt(blockRange, entryOffset + blockIndex * sizeof(int), sizeof(blockRange)) != sizeof(blockRange))
+    {
+        return -1;
+    }
+    // the compressed blocks follow the block table of numBlocks + 1 offsets
+    int tableSize = (numBlocks + 1) * sizeof(int);
+    int srcSize = blockRange[1] - blockRange[0];
+    int dstSize = n_min(int(nNpkCodec::BlockSize), entry->GetFileLength() - blockIndex * nNpkCodec::BlockSize);
+    if ((blockRange[0] < tableSize) || (srcSize <= 0) || (srcSize > dstSize) || (blockRange[1] > entry->GetCompressedLength()))
+    {
+        n_printf("nNpkFileWrapper: corrupt block table in '%s'!\n", this->absPath.Get());
+        return -1;
+    }
+
+    // a block which didn't compress is stored raw
+    if (srcSize == dstSize)
+    {
+        if (this->ReadAt(buffer, entryOffset + blockRange[0], dstSize) != dstSize)
+        {
+            return -1;
+        }
+        return dstSize;
+    }
+
+    // decode from the mapped file, or read the compressed block first
+    const void* src = this->GetMappedData(entryOffset + blockRange[0]);
+    void* srcBuffer = 0;
+    if (0 == src)
+    {
+        srcBuffer = n_malloc(srcSize);
+        if (this->ReadAt(srcBuffer, entryOffset + blockRange[0], srcSize) != srcSize)
+        {
+            n_free(srcBuffer);
+            return -1;
+        }
+        src = srcBuffer;
+    }
+    int res = nNpkCodec::Decompress(src, srcSize, buffer, dstSize);
+    if (srcBuffer)
+    {
+        n_free(srcBuffer);
+    }
+    if (res != dstSize)
+    {
+        n_printf("nNpkFileWrapper: corrupt block %d in '%s'!\n", blockIndex, this->absPath.Get());
+        return -1;
+    }
+    return res;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read from a block of a compressed file entry without a block cache.
+    Whole blocks are decoded directly into the destination buffer.
+*/
+int
+nNpkFileWrapper::ReadBlock(nNpkTocEntry* entry, int blockIndex, int blockOffset, void* buffer, int numBytes)
+{
+    int blockSize = n_min(int(nNpkCodec::BlockSize), entry->GetFileLength() - blockIndex * nNpkCodec::BlockSize);
+    if ((0 == blockOffset) && (numBytes >= blockSize))
+    {
+        return n_max(this->DecodeBlock(entry, blockIndex, buffer), 0);
+    }
+    char* blockBuffer = n_new_array(char, nNpkCodec::BlockSize);
+    int bytesRead = 0;
+    int res = this->DecodeBlock(entry, blockIndex, blockBuffer);
+    if (res > blockOffset)
+    {
+        bytesRead = n_min(numBytes, res - blockOffset);
+        memcpy(buffer, blockBuffer + blockOffset, bytesRead);
+    }
+    n_delete_array(blockBuffer);
+    return bytesRead;
+}
@@ -0,0 +1,231 @@
+//------------------------------------------------------------------------------
+//  nnpktocindex.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "file/nnpktocindex.h"
+#include "file/nnpktocentry.h"
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkTocIndex::nNpkTocIndex() :
+    entries(0),
+    numEntries(0),
+    maxEntries(0),
+    slots(0),
+    capacity(0)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkTocIndex::~nNpkTocIndex()
+{
+    this->Clear();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nNpkTocIndex::Clear()
+{
+    if (this->entries)
+    {
+        n_delete_array(this->entries);
+        this->entries = 0;
+    }
+    if (this->slots)
+    {
+        n_delete_array(this->slots);
+        this->slots = 0;
+    }
+    this->numEntries = 0;
+    this->maxEntries = 0;
+    this->capacity = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Build the index. The hash table is kept at most half full, so that
+    probe sequences stay short.
+
+    @param  rootEntry   root directory entry of the toc
+    @param  num         number of entries in the toc, including the root entry
+*/
+void
+nNpkTocIndex::Build(nNpkTocEntry* rootEntry, int num)
+{
+    n_assert(rootEntry);
+    n_assert(num > 0);
+    this->Clear();
+
+    this->entries = n_new_array(Entry, num);
+    this->maxEntries = num;
+    this->capacity = 16;
+    while (this->capacity < (num * 2))
+    {
+        this->capacity *= 2;
+    }
+    this->slots = n_new_array(Slot, this->capacity);
+    int i;
+    for (i = 0; i < this->capacity; i++)
+    {
+        this->slots[i].hash = 0;
+        this->slots[i].entry = 0;
+    }
+    this->AddEntry(rootEntry, GetEmptyHash());
+    n_assert(this->numEntries == num);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add an entry to the hash table, then recursively add the contents
+    of directory entries behind it.
+*/
+int
+nNpkTocIndex::AddEntry(nNpkTocEntry* entry, uint parentHash)
+{
+    n_assert(this->numEntries < this->maxEntries);
+    int index = this->numEntries++;
+    entry->SetIndex(index);
+    this->entries[index].entry = entry;
+
+    uint hash = parentHash;
+    if (entry->GetParent())
+    {
+        hash = HashPath(hash, "/", 1);
+    }
+    const char* name = entry->GetName();
+    hash = HashPath(hash, name, strlen(name));
+
+    uint mask = this->capacity - 1;
+    uint slotIndex = hash & mask;
+    while (this->slots[slotIndex].entry)
+    {
+        slotIndex = (slotIndex + 1) & mask;
+    }
+    this->slots[slotIndex].hash = hash;
+    this->slots[slotIndex].entry = entry;
+
+    if (nNpkTocEntry::DIR == entry->GetType())
+    {
+        nNpkTocEntry* curEntry;
+        for (curEntry = entry->GetFirstEntry(); curEntry; curEntry = entry->GetNextEntry(curEntry))
+        {
+            this->AddEntry(curEntry, hash);
+        }
+    }
+    this->entries[index].subtreeEnd = this->numEntries;
+    return this->numEntries;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compare the path of an entry with a path by walking up the entry's
+    parent chain and matching the names against the path from the end.
+*/
+bool
+nNpkTocIndex::MatchPath(const nNpkTocEntry* entry, const char* path, int len)
+{
+    const char* end = path + len;
+    const nNpkTocEntry* curEntry = entry;
+    while (curEntry)
+    {
+        const char* name = curEntry->GetName();
+        int nameLen = strlen(name);
+        const char* start = end - nameLen;
+        if ((start < path) || (0 != strncmp(start, name, nameLen)))
+        {
+            return false;
+        }
+        curEntry = curEntry->GetParent();
+        if (curEntry)
+        {
+            if ((start == path) || ('/' != start[-1]))
+            {
+                return false;
+            }
+            end = start - 1;
+        }
+        else
+        {
+            return (start == path);
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Find an entry by its path relative to the toc's root path. The path
+    must be normalized: no "." or ".." components, '/' as separator, no
+    leading, trailing or double separators, and lowercase.
+
+    @param  path    normalized path, doesn't need to be 0-terminated
+    @param  len     length of path
+    @return         the toc entry, or 0 if not found
+*/
+nNpkTocEntry*
+nNpkTocIndex::Find(const char* path, int len) const
+{
+    n_assert(path);
+    if (0 == this->slots)
+    {
+        return 0;
+    }
+    uint hash = HashPath(GetEmptyHash(), path, len);
+    uint mask = this->capacity - 1;
+    uint slotIndex = hash & mask;
+    while (this->slots[slotIndex].entry)
+    {
+        const Slot& slot = this->slots[slotIndex];
+        if ((slot.hash == hash) && MatchPath(slot.entry, path, len))
+        {
+            return slot.entry;
+        }
+        slotIndex = (slotIndex + 1) & mask;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nNpkTocEntry*
+nNpkTocIndex::GetFirstChild(const nNpkTocEntry* dirEntry) const
+{
+    n_assert(dirEntry);
+    int index = dirEntry->GetIndex();
+    n_assert(this->GetEntryAt(index) == dirEntry);
+    if ((index + 1) < this->entries[index].subtreeEnd)
+    {
+        return this->entries[index + 1].entry;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    The next sibling of an entry is the first entry behind its subtree,
+    unless this is already outside of the parent directory's subtree.
+*/
+nNpkTocEntry*
+nNpkTocIndex::GetNextSibling(const nNpkTocEntry* entry) const
+{
+    n_assert(entry);
+    int index = entry->GetIndex();
+    n_assert(this->GetEntryAt(index) == entry);
+    const nNpkTocEntry* parent = entry->GetParent();
+    if (parent)
+    {
+        int next = this->entries[index].subtreeEnd;
+        if (next < this->entries[parent->GetIndex()].subtreeEnd)
+        {
+            return this->entries[next].entry;
+        }
+    }
+    return 0;
+}
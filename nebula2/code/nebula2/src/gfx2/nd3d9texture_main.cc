@@ -43,6 +43,22 @@ nD3D9Texture::CanLoadAsync() const
     return true;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Plain texture files can be read by the resource server's I/O thread
+    before LoadResource() is called.
+*/
+bool
+nD3D9Texture::CanPreloadFile()
+{
+    if (this->IsRenderTarget() ||
+        (this->GetUsage() & (CreateFromRawCompoundFile | CreateFromDDSCompoundFile | CreateEmpty)))
+    {
+        return false;
+    }
+    return !this->GetFilename().CheckExtension("ogg");
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -454,22 +470,15 @@ nD3D9Texture::LoadD3DXFile(bool genMipMaps)
     IDirect3DDevice9* d3d9Dev = this->refGfxServer->d3d9Device;
     n_assert(d3d9Dev);
 
-    // read file into temp memory buffer
-    nFile* file = nFileServer2::Instance()->NewFileObject();
-    if (!file->Open(this->GetFilename(), "rb"))
+    // read file into temp memory buffer, unless the resource server's
+    // I/O thread has already done this
+    if ((0 == this->GetPreloadedFileData()) && !this->PreloadFile())
     {
-        n_error("nD3D9Texture::LoadD3DXFile(): Failed to open texture file '%s'!", nFileServer2::Instance()->ManglePath(this->GetFilename()).Get());
-        file->Release();
+        n_error("nD3D9Texture::LoadD3DXFile(): Failed to read texture file '%s'!", nFileServer2::Instance()->ManglePath(this->GetFilename()).Get());
         return false;
     }
-
-    int fileSize = file->GetSize();
-    n_assert(fileSize > 0);
-    void* fileBuffer = n_malloc(fileSize);
-    int bytesRead = file->Read(fileBuffer, fileSize);
-    n_assert(bytesRead == fileSize);
-    file->Close();
-    file->Release();
+    const void* fileBuffer = this->GetPreloadedFileData();
+    int fileSize = this->GetPreloadedFileSize();
 
     // check whether this is a 2d texture or a cube texture
     D3DXIMAGE_INFO imgInfo = { 0 };
@@ -477,8 +486,7 @@ nD3D9Texture::LoadD3DXFile(bool genMipMaps)
     if (FAILED(hr))
     {
         n_error("nD3D9Texture::LoadD3DXFile(): Failed to obtain image info for file '%s'!", this->GetFilename().Get());
-        n_free(fileBuffer);
-        fileBuffer = 0;
+        this->FreePreloadedFile();
         return false;
     }
 
@@ -527,8 +535,7 @@ nD3D9Texture::LoadD3DXFile(bool genMipMaps)
         if (FAILED(hr))
         {
             n_error("nD3D9Texture::LoadD3DXFile(): Failed to load 2D texture '%s'!", this->GetFilename().Get());
-            n_free(fileBuffer);
-            fileBuffer = 0;
+            this->FreePreloadedFile();
             return false;
         }
         this->SetType(TEXTURE_2D);
@@ -556,8 +563,7 @@ nD3D9Texture::LoadD3DXFile(bool genMipMaps)
         if (FAILED(hr))
         {
             n_error("nD3D9Texture::LoadD3DXFile(): Failed to load cube texture '%s'!", this->GetFilename().Get());
-            n_free(fileBuffer);
-            fileBuffer = 0;
+            this->FreePreloadedFile();
             return false;
         }
         this->SetType(TEXTURE_CUBE);
@@ -568,15 +574,13 @@ nD3D9Texture::LoadD3DXFile(bool genMipMaps)
     {
         // unsupported texture type
         n_error("nD3D9Texture::LoadD3DXFile(): Unsupported texture type (cube texture?) in file '%s'!", this->GetFilename().Get());
-        n_free(fileBuffer);
-        fileBuffer = 0;
+        this->FreePreloadedFile();
         return false;
     }
     this->baseTexture->PreLoad();
 
     // free file buffer
-    n_free(fileBuffer);
-    fileBuffer = 0;
+    this->FreePreloadedFile();
 
     // query texture attributes
     this->QueryD3DTextureAttributes();
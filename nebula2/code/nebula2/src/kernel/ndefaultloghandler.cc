@@ -23,11 +23,16 @@ nDefaultLogHandler::~nDefaultLogHandler()
 
 //------------------------------------------------------------------------------
 /**
+    The argument list is printed and put into the line buffer, so
+    vprintf() gets a copy, it may consume the list.
 */
 void
 nDefaultLogHandler::Print(const char* msg, va_list argList)
 {
-    vprintf(msg, argList);
+    va_list argListCopy;
+    va_copy(argListCopy, argList);
+    vprintf(msg, argListCopy);
+    va_end(argListCopy);
     this->PutLineBuffer(msg, argList);
 }
 
@@ -37,7 +42,10 @@ nDefaultLogHandler::Print(const char* msg, va_list argList)
 void
 nDefaultLogHandler::Message(const char* msg, va_list argList)
 {
-    vprintf(msg, argList);
+    va_list argListCopy;
+    va_copy(argListCopy, argList);
+    vprintf(msg, argListCopy);
+    va_end(argListCopy);
     this->PutLineBuffer(msg, argList);
 }
 
@@ -47,7 +55,10 @@ nDefaultLogHandler::Message(const char* msg, va_list argList)
 void
 nDefaultLogHandler::Error(const char* msg, va_list argList)
 {
-    vprintf(msg, argList);
+    va_list argListCopy;
+    va_copy(argListCopy, argList);
+    vprintf(msg, argListCopy);
+    va_end(argListCopy);
     this->PutLineBuffer(msg, argList);
     fflush(stdout);
 }
@@ -61,7 +72,10 @@ nDefaultLogHandler::Error(const char* msg, va_list argList)
 void
 nDefaultLogHandler::OutputDebug(const char* msg, va_list argList)
 {
-    vprintf(msg, argList);
+    va_list argListCopy;
+    va_copy(argListCopy, argList);
+    vprintf(msg, argListCopy);
+    va_end(argListCopy);
     this->PutLineBuffer(msg, argList);
     fflush(stdout);
 }
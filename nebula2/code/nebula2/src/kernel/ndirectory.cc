@@ -67,6 +67,7 @@ nDirectory::Open(const nString& dirName)
     return retval;
 #else
     // FIXME LINUX NOT IMPLEMENTED YET
+    this->path.Clear();
     return false;
 #endif
 }
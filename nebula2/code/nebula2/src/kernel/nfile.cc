@@ -386,6 +386,24 @@ nFile::GetLastWriteTime() const
 #endif
 }
 
+//------------------------------------------------------------------------------
+/**
+    Return a pointer to the next numBytes of the file and advance the
+    file position, if the file contents are mapped into memory. This
+    lets loaders consume file data without copying it into a buffer
+    first. The pointer remains valid until the file server is shut
+    down. Conventional files are not mapped, so the default
+    implementation returns 0, and the caller must use Read() instead.
+
+    @param  numBytes    number of bytes to access
+    @return             pointer to file data, or 0 if not mapped
+*/
+const void*
+nFile::ReadMapped(int /*numBytes*/)
+{
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
     writes a string to the file
@@ -493,7 +493,7 @@ nFileServer2::InitTempAssign()
     }
     nString path(tmpDir);
     path.Append("/");
-    this->SetAssign("user", path);
+    this->SetAssign("temp", path);
 #else
 #error "IMPLEMENT ME!"
 #endif
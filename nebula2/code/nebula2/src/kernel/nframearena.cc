@@ -0,0 +1,226 @@
+//------------------------------------------------------------------------------
+//  nframearena.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nframearena.h"
+#include "kernel/ninterlocked.h"
+#include "mathlib/nmath.h"
+
+nFrameArena* nFrameArena::Singleton = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+nFrameArena::nFrameArena() :
+    curFrame(0),
+    frameId(0),
+    chunkSize(256 * 1024),
+    freeChunks(0),
+    lock(0),
+    numChunkBytes(0),
+    lastNumAllocs(0),
+    lastNumBytes(0)
+{
+    n_assert(0 == Singleton);
+    Singleton = this;
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        this->frames[i].chunks = 0;
+        this->frames[i].curChunk = 0;
+        this->frames[i].numAllocs = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nFrameArena::~nFrameArena()
+{
+    this->ReleaseChunks(this->frames[0]);
+    this->ReleaseChunks(this->frames[1]);
+    while (this->freeChunks)
+    {
+        Chunk* chunk = this->freeChunks;
+        this->freeChunks = chunk->next;
+        n_free(chunk);
+    }
+    n_assert(Singleton);
+    Singleton = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the size of new chunks. Allocations larger than half the chunk
+    size get an individual chunk.
+*/
+void
+nFrameArena::SetChunkSize(int size)
+{
+    n_assert(size >= 1024);
+    this->chunkSize = size;
+    while (this->freeChunks)
+    {
+        Chunk* chunk = this->freeChunks;
+        this->freeChunks = chunk->next;
+        this->numChunkBytes -= chunk->size;
+        n_free(chunk);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nFrameArena::Lock()
+{
+    while (0 != n_interlocked_exchange(&this->lock, 1))
+    {
+        n_sleep(0.0);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nFrameArena::Unlock()
+{
+    n_interlocked_exchange(&this->lock, 0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get a recycled chunk, or allocate a new one. Must be called with the
+    lock held.
+*/
+nFrameArena::Chunk*
+nFrameArena::NewChunk(int size)
+{
+    Chunk* chunk;
+    if ((size <= this->chunkSize) && this->freeChunks)
+    {
+        chunk = this->freeChunks;
+        this->freeChunks = chunk->next;
+    }
+    else
+    {
+        int allocSize = n_max(size, this->chunkSize);
+        chunk = (Chunk*) n_malloc(sizeof(Chunk) + allocSize + 15);
+        if (0 == chunk)
+        {
+            n_error("nFrameArena: Out Of Memory!\n");
+        }
+        chunk->data = (char*) ((size_t(chunk + 1) + 15) & ~size_t(15));
+        chunk->size = allocSize;
+        this->numChunkBytes += allocSize;
+    }
+    chunk->next = 0;
+    chunk->used = 0;
+    return chunk;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Move the chunks of a frame to the free list, individual chunks of
+    large allocations are freed.
+*/
+void
+nFrameArena::ReleaseChunks(Frame& frame)
+{
+    while (frame.chunks)
+    {
+        Chunk* chunk = frame.chunks;
+        frame.chunks = chunk->next;
+        if (chunk->size == this->chunkSize)
+        {
+            chunk->next = this->freeChunks;
+            this->freeChunks = chunk;
+        }
+        else
+        {
+            this->numChunkBytes -= chunk->size;
+            n_free(chunk);
+        }
+    }
+    frame.curChunk = 0;
+    frame.numAllocs = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocate memory in the current frame. Threads allocate concurrently
+    by atomically bumping the offset of the current chunk, only getting a
+    new chunk is locked.
+*/
+void*
+nFrameArena::Alloc(int size)
+{
+    n_assert(size >= 0);
+    size = (size + 15) & ~15;
+    Frame& frame = this->frames[this->curFrame];
+    n_interlocked_increment(&frame.numAllocs);
+
+    if (size > (this->chunkSize / 2))
+    {
+        // large allocations get their own chunk, and leave the current one alone
+        this->Lock();
+        Chunk* chunk = this->NewChunk(size);
+        chunk->used = size;
+        chunk->next = frame.chunks;
+        frame.chunks = chunk;
+        this->Unlock();
+        return chunk->data;
+    }
+
+    for (;;)
+    {
+        Chunk* chunk = (Chunk*) n_interlocked_read_pointer((void* const volatile*) &frame.curChunk);
+        if (chunk)
+        {
+            long offset = n_interlocked_add(&chunk->used, size) - size;
+            if ((offset + size) <= chunk->size)
+            {
+                return chunk->data + offset;
+            }
+        }
+
+        // the chunk is full, start a new one unless another thread
+        // has already done so
+        this->Lock();
+        if (frame.curChunk == chunk)
+        {
+            Chunk* newChunk = this->NewChunk(size);
+            newChunk->next = frame.chunks;
+            frame.chunks = newChunk;
+            n_interlocked_exchange_pointer((void* volatile*) &frame.curChunk, newChunk);
+        }
+        this->Unlock();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Start a new frame. The memory allocated in the frame before the last
+    one is recycled. Must not be called while other threads allocate.
+*/
+void
+nFrameArena::NextFrame()
+{
+    Frame& lastFrame = this->frames[this->curFrame];
+    this->lastNumAllocs = lastFrame.numAllocs;
+    this->lastNumBytes = 0;
+    Chunk* chunk;
+    for (chunk = lastFrame.chunks; chunk; chunk = chunk->next)
+    {
+        this->lastNumBytes += n_min(int(chunk->used), chunk->size);
+    }
+
+    this->curFrame ^= 1;
+    this->frameId++;
+    this->ReleaseChunks(this->frames[this->curFrame]);
+}
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
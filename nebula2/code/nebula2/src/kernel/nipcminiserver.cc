@@ -3,8 +3,8 @@
 //  (C) 2003 RadonLabs GmbH
 //------------------------------------------------------------------------------
 #include "kernel/nipcserver.h"
+#include "util/nmsgnode.h"
 #include "kernel/nipcminiserver.h"
-#include "kernel/nthread.h"
 
 //------------------------------------------------------------------------------
 /**
@@ -51,51 +51,36 @@ nIpcMiniServer::CloseRcvrSocket()
 
 //------------------------------------------------------------------------------
 /**
-    Waits for a client to connect and accepts the connection.
+    Take over the socket of a client connection which has been accepted
+    by the nIpcServer.
 */
-bool nIpcMiniServer::Listen()
+void
+nIpcMiniServer::Accept(SOCKET sock)
 {
-    bool retval = false;
-
-    // wait for a client...
-    if (listen(this->ipcServer->sock, 5) != -1)
-    {
-        this->rcvrSocket = accept(this->ipcServer->sock, 0, 0);
-        if (INVALID_SOCKET != this->rcvrSocket)
-        {
-            n_printf("client %d: connection accepted, socket %d.\n", this->clientId, this->rcvrSocket);
-
-            // put the socket into nonblocking mode
-            #if defined(__WIN32__)
-                u_long trueAsUlong = 1;
-                ioctlsocket(this->rcvrSocket, FIONBIO, &trueAsUlong);
-            #elif defined(__LINUX__) || defined(__MACOSX__)
-                int flags;
-                flags = fcntl(this->rcvrSocket, F_GETFL);
-                flags |= O_NONBLOCK;
-                fcntl(this->rcvrSocket, F_SETFL, flags);
-            #endif
-            retval = true;
-
-            // set the connection status to false, this will only be set to true
-            // when the actual handshake with the client has happened
-            //this->isConnected = false;
-        }
-        else
-        {
-            n_printf("nIpcMiniServer::Listen(): accept() failed!");
-        }
-    }
-    else
-    {
-        n_printf("nIpcMiniServer::Listen(): listen() failed!");
-    }
-    return retval;
+    n_assert(INVALID_SOCKET == this->rcvrSocket);
+    n_assert(INVALID_SOCKET != sock);
+    this->rcvrSocket = sock;
+    n_printf("client %d: connection accepted, socket %d.\n", this->clientId, this->rcvrSocket);
+
+    // put the socket into nonblocking mode
+    #if defined(__WIN32__)
+        u_long trueAsUlong = 1;
+        ioctlsocket(this->rcvrSocket, FIONBIO, &trueAsUlong);
+    #elif defined(__LINUX__) || defined(__MACOSX__)
+        int flags;
+        flags = fcntl(this->rcvrSocket, F_GETFL);
+        flags |= O_NONBLOCK;
+        fcntl(this->rcvrSocket, F_SETFL, flags);
+    #endif
+
+    // set the connection status to false, this will only be set to true
+    // when the actual handshake with the client has happened
+    //this->isConnected = false;
 }
 
 //------------------------------------------------------------------------------
 /**
-    This method should be called after Listen() if the connection should
+    This method should be called after Accept() if the connection should
     be ignored for any reason.
 */
 void
@@ -177,7 +162,7 @@ nIpcMiniServer::Poll()
                 // if not a system message, add to user message list
                 if (!systemMessage)
                 {
-                    // an user message, add to msg list of thread
+                    // an user message, add to msg list of the server
                     nMsgNode* msgNode = n_new(nMsgNode((void*)curString, strlen(curString) + 1));
                     msgNode->SetPtr((void*) this->clientId);
                     this->ipcServer->msgList.Lock();
@@ -2,83 +2,10 @@
 //  nipcserver.cc
 //  (C) 2003 RadonLabs GmbH
 //------------------------------------------------------------------------------
-#include "kernel/nthread.h"
 #include "kernel/nipcserver.h"
+#include "util/nmsgnode.h"
 #include "kernel/nipcminiserver.h"
 
-//------------------------------------------------------------------------------
-/**
-    The listener thread. Simply creates one nIpcMiniServer object
-    for each client which connects.
-*/
-static
-int
-N_THREADPROC
-ListenerThreadFunc(nThread *thread)
-{
-    // tell thread object that we have started
-    thread->ThreadStarted();
-
-    // get pointer to ipc server object
-    nIpcServer *ipcServer = (nIpcServer *) thread->LockUserData();
-    thread->UnlockUserData();
-
-    do
-    {
-        // this loop waits for a new client to connect, for each
-        // new client, an nIpcMiniServer object is created
-        n_printf("nIpcServer: listening on port %d...\n", ipcServer->selfAddr.GetPortNum());
-        nIpcMiniServer* ipcMiniServer = n_new(nIpcMiniServer(ipcServer));
-        if (ipcMiniServer->Listen())
-        {
-            // Some sort of connection has been established. This
-            // could also come from the Wakeup function of
-            // nIpcMiniServer if it wants to shutdown the thread.
-            // If this is the case, the ThreadStopRequested flag
-            // should be set in the thread object.
-            if (thread->ThreadStopRequested())
-            {
-                ipcMiniServer->Ignore();
-                n_printf("nIpcServer: woke up for shutting down.\n");
-            }
-            else
-            {
-                n_printf("nIpcServer: a client has connected.\n");
-            }
-        }
-        n_sleep(0); // call the sheduler to be multitask friendly
-    } while (!thread->ThreadStopRequested());
-
-    n_printf("nIpcServer: shutting down listener thread.\n");
-    thread->ThreadHarakiri();
-    return 0;
-}
-
-//------------------------------------------------------------------------------
-/**
-    The wakeup func for the thread object.
-    This creates a dummy connection to the current ipcMiniServer object
-    in the listener thread in order to wakeup the thread because it is
-    going to shut down.
-*/
-static
-void
-ListenerWakeupFunc(nThread* t)
-{
-    sockaddr_in myAddr;
-    memset(&myAddr, 0, sizeof(myAddr));
-    nIpcServer* ipcServer = (nIpcServer*) t->LockUserData();
-    t->UnlockUserData();
-    myAddr.sin_family = AF_INET;
-    myAddr.sin_port   = ipcServer->selfAddr.GetAddrStruct().sin_port;
-    myAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
-    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
-    n_assert(INVALID_SOCKET != sock);
-    connect(sock, (struct sockaddr *) &myAddr, sizeof(myAddr));
-    shutdown(sock, 2);
-    closesocket(sock);
-}
-
 //------------------------------------------------------------------------------
 /**
     NOTE: the host name of the ipc address object MUST be set to "any",
@@ -101,13 +28,21 @@ nIpcServer::nIpcServer(nIpcAddress& addr) :
     res = bind(this->sock, (const sockaddr*) &(addr.GetAddrStruct()), sizeof(addr.GetAddrStruct()));
     n_assert(SOCKET_ERROR != res);
 
-    // start the listener thread
-    this->listenerThread = n_new(nThread(ListenerThreadFunc,
-                                         nThread::Normal,
-                                         0,
-                                         ListenerWakeupFunc,
-                                         &(this->msgList),
-                                         (void*) this));
+    // listen for clients, connection requests are accepted by Poll()
+    res = listen(this->sock, 5);
+    n_assert(SOCKET_ERROR != res);
+    n_printf("nIpcServer: listening on port %d...\n", this->selfAddr.GetPortNum());
+
+    // put the socket into nonblocking mode, so that accept() doesn't block
+    #if defined(__WIN32__)
+        u_long trueAsUlong = 1;
+        ioctlsocket(this->sock, FIONBIO, &trueAsUlong);
+    #elif defined(__LINUX__) || defined(__MACOSX__)
+        int flags;
+        flags = fcntl(this->sock, F_GETFL);
+        flags |= O_NONBLOCK;
+        fcntl(this->sock, F_SETFL, flags);
+    #endif
 }
 
 //------------------------------------------------------------------------------
@@ -116,12 +51,6 @@ nIpcServer::nIpcServer(nIpcAddress& addr) :
 */
 nIpcServer::~nIpcServer()
 {
-    // delete the thread before the mini servers, because inside
-    // the thread there is a living nIpcMiniServer object waiting
-    // for connections
-    n_delete(this->listenerThread);
-    this->listenerThread = 0;
-
     // kill existing mini servers
     nIpcMiniServer* ipcMiniServer;
     this->miniServerList.Lock();
@@ -151,13 +80,34 @@ nIpcServer::~nIpcServer()
 
 //------------------------------------------------------------------------------
 /**
-    Poll the mini servers for new messages.
+    Accept the connection requests of new clients, one nIpcMiniServer
+    object is created for each client. The server socket is non-blocking,
+    so this returns right away if no client is waiting.
+*/
+void
+nIpcServer::AcceptClients()
+{
+    SOCKET rcvrSocket;
+    while (INVALID_SOCKET != (rcvrSocket = accept(this->sock, 0, 0)))
+    {
+        nIpcMiniServer* ipcMiniServer = n_new(nIpcMiniServer(this));
+        ipcMiniServer->Accept(rcvrSocket);
+        n_printf("nIpcServer: a client has connected.\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Accept new clients and poll the mini servers for new messages.
 
     @return true if there are any to process
 */
 bool
 nIpcServer::Poll()
 {
+    // accept new clients
+    this->AcceptClients();
+
     // poll all our miniservers...
     this->miniServerList.Lock();
     nIpcMiniServer* cur = (nIpcMiniServer*) this->miniServerList.GetHead();
@@ -196,13 +146,15 @@ bool
 nIpcServer::GetMsg(nIpcBuffer& msg, int& fromClientId)
 {
     // check if any messages came in...
-    nMsgNode* msgNode = (nMsgNode*)this->listenerThread->GetMsg();
+    this->msgList.Lock();
+    nMsgNode* msgNode = (nMsgNode*)this->msgList.RemHead();
+    this->msgList.Unlock();
     if (msgNode)
     {
         // copy contents of message to the nIpcBuffer object
         msg.Set((const char*) msgNode->GetMsgPtr(), msgNode->GetMsgSize());
         fromClientId = (int) msgNode->GetPtr();
-        this->listenerThread->ReplyMsg(msgNode);
+        n_delete(msgNode);
         return true;
     }
     else
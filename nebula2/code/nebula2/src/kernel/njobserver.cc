@@ -0,0 +1,811 @@
+//------------------------------------------------------------------------------
+//  njobserver.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/njobserver.h"
+#include "kernel/nprofileserver.h"
+#include "mathlib/nmath.h"
+
+#if !defined(__WIN32__) && !defined(__XBxX__)
+#include <unistd.h>
+#endif
+
+// thread local variables
+#if defined(__NEBULA_NO_THREADS__)
+#define N_THREADLOCAL
+#elif defined(__WIN32__)
+#define N_THREADLOCAL __declspec(thread)
+#else
+#define N_THREADLOCAL __thread
+#endif
+
+// the worker index of the current thread (0 is the main thread, -1 any other thread)
+static N_THREADLOCAL int CurWorkerIndex = -1;
+// where the current thread starts looking for jobs to steal
+static N_THREADLOCAL int CurStealIndex = 0;
+
+// number of unsuccessful job searches before a worker goes to sleep
+static const int MaxIdleSpins = 32;
+
+nJobServer* nJobServer::Singleton = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+nJobServer::Deque::Deque() :
+    top(0),
+    bottom(0)
+{
+    this->jobs = n_new_array(Job, Capacity);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nJobServer::Deque::~Deque()
+{
+    n_delete_array(this->jobs);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Push a job at the bottom. Only the owner thread may call this. The
+    indices grow forever, differences are computed unsigned so that they
+    survive the wrap around.
+*/
+bool
+nJobServer::Deque::Push(const Job& job)
+{
+    long b = this->bottom;
+    long t = n_interlocked_read(&this->top);
+    if (long(ulong(b) - ulong(t)) >= Capacity)
+    {
+        return false;
+    }
+    this->jobs[ulong(b) & (Capacity - 1)] = job;
+    // publish the job, this is a full barrier
+    n_interlocked_exchange(&this->bottom, long(ulong(b) + 1));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Pop a job from the bottom. Only the owner thread may call this. If
+    only one job is left, owner and thieves race for it on top.
+*/
+bool
+nJobServer::Deque::Pop(Job& job)
+{
+    long b = long(ulong(this->bottom) - 1);
+    n_interlocked_exchange(&this->bottom, b);
+    long t = n_interlocked_read(&this->top);
+    long size = long(ulong(b) - ulong(t));
+    if (size < 0)
+    {
+        // empty
+        n_interlocked_exchange(&this->bottom, t);
+        return false;
+    }
+    job = this->jobs[ulong(b) & (Capacity - 1)];
+    if (size > 0)
+    {
+        return true;
+    }
+
+    // the last job, compete with the thieves
+    bool won = (t == n_interlocked_compare_exchange(&this->top, long(ulong(t) + 1), t));
+    n_interlocked_exchange(&this->bottom, long(ulong(t) + 1));
+    return won;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Steal a job from the top. May be called by any thread.
+*/
+bool
+nJobServer::Deque::Steal(Job& job)
+{
+    long t = n_interlocked_read(&this->top);
+    n_barrier();
+    long b = n_interlocked_read(&this->bottom);
+    if (long(ulong(b) - ulong(t)) <= 0)
+    {
+        return false;
+    }
+    job = this->jobs[ulong(t) & (Capacity - 1)];
+    return (t == n_interlocked_compare_exchange(&this->top, long(ulong(t) + 1), t));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Every cell has a sequence number which tells producers and consumers
+    whether the cell is free for the current push or pop position.
+*/
+nJobServer::Queue::Queue() :
+    pushPos(0),
+    popPos(0)
+{
+    this->cells = n_new_array(Cell, Capacity);
+    int i;
+    for (i = 0; i < Capacity; i++)
+    {
+        this->cells[i].sequence = i;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nJobServer::Queue::~Queue()
+{
+    n_delete_array(this->cells);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+nJobServer::Queue::Push(const Job& job)
+{
+    long pos = n_interlocked_read(&this->pushPos);
+    Cell* cell;
+    for (;;)
+    {
+        cell = &(this->cells[ulong(pos) & (Capacity - 1)]);
+        long diff = long(ulong(n_interlocked_read(&cell->sequence)) - ulong(pos));
+        if (0 == diff)
+        {
+            long prev = n_interlocked_compare_exchange(&this->pushPos, long(ulong(pos) + 1), pos);
+            if (prev == pos)
+            {
+                break;
+            }
+            pos = prev;
+        }
+        else if (diff < 0)
+        {
+            // full
+            return false;
+        }
+        else
+        {
+            pos = n_interlocked_read(&this->pushPos);
+        }
+    }
+    cell->job = job;
+    n_interlocked_exchange(&cell->sequence, long(ulong(pos) + 1));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+nJobServer::Queue::Pop(Job& job)
+{
+    long pos = n_interlocked_read(&this->popPos);
+    Cell* cell;
+    for (;;)
+    {
+        cell = &(this->cells[ulong(pos) & (Capacity - 1)]);
+        long diff = long(ulong(n_interlocked_read(&cell->sequence)) - (ulong(pos) + 1));
+        if (0 == diff)
+        {
+            long prev = n_interlocked_compare_exchange(&this->popPos, long(ulong(pos) + 1), pos);
+            if (prev == pos)
+            {
+                break;
+            }
+            pos = prev;
+        }
+        else if (diff < 0)
+        {
+            // empty
+            return false;
+        }
+        else
+        {
+            pos = n_interlocked_read(&this->popPos);
+        }
+    }
+    job = cell->job;
+    n_interlocked_exchange(&cell->sequence, long(ulong(pos) + Capacity));
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nJobCounter::Lock()
+{
+    while (0 != n_interlocked_exchange(&this->lock, 1))
+    {
+        // spin
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nJobCounter::Unlock()
+{
+    n_interlocked_exchange(&this->lock, 0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The thread which creates the job server becomes the main thread
+    (worker index 0).
+*/
+nJobServer::nJobServer() :
+    isConfigured(false),
+    numWorkers(0),
+    numSleeping(0)
+{
+    n_assert(0 == Singleton);
+    Singleton = this;
+    CurWorkerIndex = 0;
+    memset(this->workers, 0, sizeof(this->workers));
+    memset(this->deques, 0, sizeof(this->deques));
+    this->deques[0] = n_new(Deque);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nJobServer::~nJobServer()
+{
+    this->StopWorkers();
+    int i;
+    for (i = 0; i < MaxWorkers; i++)
+    {
+        if (this->workers[i])
+        {
+            n_delete(this->workers[i]);
+            this->workers[i] = 0;
+        }
+    }
+    for (i = 0; i <= MaxWorkers; i++)
+    {
+        if (this->deques[i])
+        {
+            n_delete(this->deques[i]);
+            this->deques[i] = 0;
+        }
+    }
+    n_assert(Singleton);
+    Singleton = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the number of processors in the system.
+*/
+int
+nJobServer::GetNumProcessors()
+{
+#if defined(__WIN32__)
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    return n_max(1, int(sysInfo.dwNumberOfProcessors));
+#elif defined(__LINUX__) || defined(__MACOSX__)
+    return n_max(1, int(sysconf(_SC_NPROCESSORS_ONLN)));
+#else
+    return 1;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nJobServer::GetWorkerIndex()
+{
+    return CurWorkerIndex;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the number of worker threads. Existing workers will be shut down
+    first. Must be called by the main thread while no jobs are running.
+    The number is clamped to MaxWorkers.
+*/
+void
+nJobServer::SetNumWorkers(int num)
+{
+    n_assert(0 == CurWorkerIndex);
+    n_assert(num >= 0);
+    this->StopWorkers();
+    this->StartWorkers(n_min(num, int(MaxWorkers)));
+    this->isConfigured = true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    If the number of workers has not been set explicitely, start one
+    worker less than there are processors (the main thread executes
+    jobs while it waits). Only the main thread configures the server,
+    until then jobs of other threads are executed right away.
+*/
+void
+nJobServer::CheckConfigured()
+{
+    if ((0 == CurWorkerIndex) && !this->isConfigured)
+    {
+        this->SetNumWorkers(GetNumProcessors() - 1);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Start the worker threads. Worker and deque objects are created on
+    demand and kept until the job server is destroyed, so that other
+    threads which still see the previous number of workers never touch
+    freed memory. The new number of workers is published before the
+    threads are started.
+*/
+void
+nJobServer::StartWorkers(int num)
+{
+#ifndef __NEBULA_NO_THREADS__
+    n_assert(0 == this->numWorkers);
+    n_assert((num >= 0) && (num <= MaxWorkers));
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        if (0 == this->deques[i + 1])
+        {
+            this->deques[i + 1] = n_new(Deque);
+        }
+        if (0 == this->workers[i])
+        {
+            Worker* worker = n_new(Worker);
+            worker->server = this;
+            worker->workerIndex = i + 1;
+            worker->thread = 0;
+            this->workers[i] = worker;
+        }
+        this->workers[i]->sleeping = 0;
+    }
+    n_interlocked_exchange(&this->numWorkers, num);
+    for (i = 0; i < num; i++)
+    {
+        Worker* worker = this->workers[i];
+        // background jobs like resource loading need a big stack (2.5 MB)
+        worker->thread = n_new(nThread(WorkerThreadFunc, nThread::Normal, 2500000, WorkerWakeupFunc, 0, worker));
+    }
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Stop the worker threads, then execute the jobs left in their deques,
+    in the shared queue and in the background queue on the calling thread. The number of workers
+    is set to 0 first, so that new jobs are executed right away.
+*/
+void
+nJobServer::StopWorkers()
+{
+    int num = int(n_interlocked_exchange(&this->numWorkers, 0));
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        Worker* worker = this->workers[i];
+        n_delete(worker->thread);
+        worker->thread = 0;
+        n_interlocked_exchange(&worker->sleeping, 0);
+    }
+    n_interlocked_exchange(&this->numSleeping, 0);
+
+    Job job;
+    for (i = 0; i <= num; i++)
+    {
+        while (this->deques[i]->Steal(job))
+        {
+            this->Execute(job);
+        }
+    }
+    while (this->sharedQueue.Pop(job))
+    {
+        this->Execute(job);
+    }
+    while (this->backgroundQueue.Pop(job))
+    {
+        this->Execute(job);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Called by nThread's destructor to wake up a sleeping worker, so that
+    it notices the stop request.
+*/
+void
+nJobServer::WorkerWakeupFunc(nThread* thread)
+{
+    Worker* worker = (Worker*) thread->LockUserData();
+    thread->UnlockUserData();
+    worker->wakeupEvent.Signal();
+}
+
+//------------------------------------------------------------------------------
+/**
+    The worker thread function. Executes jobs as long as there are any,
+    background jobs only if there is nothing else to do, then goes to
+    sleep until WakeWorker() is called.
+
+    The sleeping flag is set before the last look for jobs, and
+    WakeWorker() is called after a job has been queued, so a job can't be
+    queued unnoticed while a worker falls asleep.
+*/
+int
+N_THREADPROC
+nJobServer::WorkerThreadFunc(nThread* thread)
+{
+    // tell thread object that we have started
+    thread->ThreadStarted();
+
+    Worker* worker = (Worker*) thread->LockUserData();
+    thread->UnlockUserData();
+    nJobServer* self = worker->server;
+    CurWorkerIndex = worker->workerIndex;
+    CurStealIndex = worker->workerIndex;
+
+    char threadName[32];
+    snprintf(threadName, sizeof(threadName), "Job Worker %d", worker->workerIndex);
+    nProfileServer::Instance()->SetThreadName(threadName);
+
+    int idleSpins = 0;
+    Job job;
+    while (!thread->ThreadStopRequested())
+    {
+        if (self->FindJob(worker->workerIndex, job) || self->backgroundQueue.Pop(job))
+        {
+            self->Execute(job);
+            idleSpins = 0;
+        }
+        else if (++idleSpins < MaxIdleSpins)
+        {
+            // spin
+        }
+        else
+        {
+            idleSpins = 0;
+            n_interlocked_exchange(&worker->sleeping, 1);
+            n_interlocked_increment(&self->numSleeping);
+            if (self->FindJob(worker->workerIndex, job) || self->backgroundQueue.Pop(job))
+            {
+                if (1 == n_interlocked_compare_exchange(&worker->sleeping, 0, 1))
+                {
+                    n_interlocked_decrement(&self->numSleeping);
+                }
+                self->Execute(job);
+            }
+            else
+            {
+                worker->wakeupEvent.Wait();
+                if (1 == n_interlocked_compare_exchange(&worker->sleeping, 0, 1))
+                {
+                    n_interlocked_decrement(&self->numSleeping);
+                }
+            }
+        }
+    }
+
+    // tell thread object that we are done
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nJobServer::WakeWorker()
+{
+    if (n_interlocked_read(&this->numSleeping) > 0)
+    {
+        int num = int(n_interlocked_read(&this->numWorkers));
+        int i;
+        for (i = 0; i < num; i++)
+        {
+            Worker* worker = this->workers[i];
+            if (1 == n_interlocked_compare_exchange(&worker->sleeping, 0, 1))
+            {
+                n_interlocked_decrement(&this->numSleeping);
+                worker->wakeupEvent.Signal();
+                return;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Queue a job: job threads push into their own deque, other threads
+    into the shared queue. Without workers, or if the queue is full, the
+    job is executed right away.
+*/
+void
+nJobServer::Schedule(const Job& job)
+{
+    this->CheckConfigured();
+    if (n_interlocked_read(&this->numWorkers) > 0)
+    {
+        int workerIndex = CurWorkerIndex;
+        if ((workerIndex >= 0) && this->deques[workerIndex]->Push(job))
+        {
+            this->WakeWorker();
+            return;
+        }
+        if ((workerIndex < 0) && this->sharedQueue.Push(job))
+        {
+            this->WakeWorker();
+            return;
+        }
+    }
+    this->Execute(job);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Look for a job in the own deque first, then in the shared queue, then
+    try to steal one from the other deques. Threads which are not job
+    threads (workerIndex -1) only look into the shared queue.
+*/
+bool
+nJobServer::FindJob(int workerIndex, Job& job)
+{
+    if (workerIndex < 0)
+    {
+        return this->sharedQueue.Pop(job);
+    }
+    if (this->deques[workerIndex]->Pop(job))
+    {
+        return true;
+    }
+    if (this->sharedQueue.Pop(job))
+    {
+        return true;
+    }
+    int numDeques = int(n_interlocked_read(&this->numWorkers)) + 1;
+    int i;
+    for (i = 0; i < numDeques; i++)
+    {
+        int victim = (CurStealIndex + i) % numDeques;
+        if ((victim != workerIndex) && this->deques[victim]->Steal(job))
+        {
+            // next time, start with the same victim
+            CurStealIndex = victim;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nJobServer::Execute(const Job& job)
+{
+    job.func(job.begin, job.end, job.userData);
+    if (job.counter)
+    {
+        this->FinishJob(job.counter);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Decrement the job counter. The last job schedules the jobs which
+    wait for the counter. While numFinishing is non-zero, IsDone()
+    returns false, so that a waiting thread doesn't destroy the counter
+    while it is still in use here.
+*/
+void
+nJobServer::FinishJob(nJobCounter* counter)
+{
+    nArray<Job>* dependentJobs = 0;
+    n_interlocked_increment(&counter->numFinishing);
+    if (0 == n_interlocked_decrement(&counter->count))
+    {
+        counter->Lock();
+        dependentJobs = counter->dependentJobs;
+        counter->dependentJobs = 0;
+        counter->Unlock();
+    }
+    n_interlocked_decrement(&counter->numFinishing);
+
+    // from here on, the counter may be gone
+    if (dependentJobs)
+    {
+        int i;
+        for (i = 0; i < dependentJobs->Size(); i++)
+        {
+            this->Schedule((*dependentJobs)[i]);
+        }
+        n_delete(dependentJobs);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Submit a job. The job function is called with the index range
+    [begin, end) and the user data pointer. If a counter is given, it is
+    incremented now and decremented when the job has finished.
+*/
+void
+nJobServer::Submit(JobFunc func, int begin, int end, void* userData, nJobCounter* counter)
+{
+    n_assert(func);
+    Job job;
+    job.func = func;
+    job.userData = userData;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+    if (counter)
+    {
+        n_interlocked_increment(&counter->count);
+    }
+    this->Schedule(job);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Submit a long running job which doesn't belong to the current frame.
+    It goes into the background queue, which is only served by workers
+    which have nothing else to do. Without workers, or if the queue is
+    full, the job is executed right away by the calling thread.
+*/
+void
+nJobServer::SubmitBackground(JobFunc func, int begin, int end, void* userData, nJobCounter* counter)
+{
+    n_assert(func);
+    Job job;
+    job.func = func;
+    job.userData = userData;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+    if (counter)
+    {
+        n_interlocked_increment(&counter->count);
+    }
+    this->CheckConfigured();
+    if ((n_interlocked_read(&this->numWorkers) > 0) && this->backgroundQueue.Push(job))
+    {
+        this->WakeWorker();
+        return;
+    }
+    this->Execute(job);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Submit a job which is queued when all jobs of the dependency counter
+    have finished (right away if the dependency is already done). The
+    dependency counter must stay valid until this method returns.
+*/
+void
+nJobServer::SubmitAfter(nJobCounter* dependency, JobFunc func, int begin, int end, void* userData, nJobCounter* counter)
+{
+    n_assert(dependency);
+    n_assert(func);
+    n_assert(dependency != counter);
+    Job job;
+    job.func = func;
+    job.userData = userData;
+    job.begin = begin;
+    job.end = end;
+    job.counter = counter;
+    if (counter)
+    {
+        n_interlocked_increment(&counter->count);
+    }
+
+    bool waiting = false;
+    dependency->Lock();
+    if (n_interlocked_read(&dependency->count) > 0)
+    {
+        if (0 == dependency->dependentJobs)
+        {
+            dependency->dependentJobs = n_new(nArray<Job>(4, 4));
+        }
+        dependency->dependentJobs->Append(job);
+        waiting = true;
+    }
+    dependency->Unlock();
+
+    if (!waiting)
+    {
+        this->Schedule(job);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Execute jobs until all jobs of the counter have finished. Any thread
+    may wait, job threads take jobs from their own deque first. Other
+    threads only execute jobs from the shared queue (see FindJob()).
+*/
+void
+nJobServer::Wait(nJobCounter* counter)
+{
+    n_assert(counter);
+    int workerIndex = CurWorkerIndex;
+    int idleSpins = 0;
+    Job job;
+    while (!counter->IsDone())
+    {
+        if (this->FindJob(workerIndex, job))
+        {
+            this->Execute(job);
+            idleSpins = 0;
+        }
+        else if (++idleSpins >= MaxIdleSpins)
+        {
+            // the remaining jobs are running on other threads
+            n_sleep(0.0);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Split the range in halves until it is no larger than the grain size,
+    the upper halves are queued as new jobs (which split further when
+    they get stolen).
+*/
+void
+nJobServer::ParallelForJob(int begin, int end, void* userData)
+{
+    ParallelForData* data = (ParallelForData*) userData;
+    while ((end - begin) > data->grainSize)
+    {
+        int mid = begin + (end - begin) / 2;
+        Singleton->Submit(ParallelForJob, mid, end, data, data->counter);
+        end = mid;
+    }
+    data->func(begin, end, data->userData);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Call func for the range [begin, end) in parallel. The range is split
+    into jobs of at least grainSize indices (a job may also get a smaller
+    range at the end of the range). The calling thread executes jobs
+    until all jobs are done. May be called from inside a job.
+*/
+void
+nJobServer::ParallelFor(int begin, int end, int grainSize, JobFunc func, void* userData)
+{
+    n_assert(func);
+    if (end <= begin)
+    {
+        return;
+    }
+    this->CheckConfigured();
+    grainSize = n_max(1, grainSize);
+    if ((0 == n_interlocked_read(&this->numWorkers)) || ((end - begin) <= grainSize))
+    {
+        func(begin, end, userData);
+        return;
+    }
+
+    nJobCounter counter;
+    ParallelForData data;
+    data.func = func;
+    data.userData = userData;
+    data.grainSize = grainSize;
+    data.counter = &counter;
+    ParallelForJob(begin, end, &data);
+    this->Wait(&counter);
+}
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
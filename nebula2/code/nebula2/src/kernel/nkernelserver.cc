@@ -10,6 +10,10 @@
 #include "kernel/npersistserver.h"
 #include "kernel/ntimeserver.h"
 #include "kernel/nhardrefserver.h"
+#include "kernel/nprofileserver.h"
+#include "kernel/njobserver.h"
+#include "kernel/nframearena.h"
+#include "kernel/nworkerpool.h"
 #include "kernel/nfileserver2.h"
 #include "kernel/nremoteserver.h"
 #include "kernel/ndefaultloghandler.h"
@@ -92,6 +96,21 @@ nKernelServer::Lookup(const char* path)
     this->Lock();
     nRoot* cur = 0;
 
+    // absolute paths may be in the lookup cache
+    LookupCacheEntry* cacheEntry = 0;
+    if (this->IsAbsolutePath(path))
+    {
+        cacheEntry = &(this->lookupCache[nRootChildIndex::HashName(path) % LookupCacheSize]);
+        if (cacheEntry->object &&
+            (cacheEntry->nohGeneration == nRoot::GetNohGeneration()) &&
+            (cacheEntry->path == path))
+        {
+            cur = cacheEntry->object;
+            this->Unlock();
+            return cur;
+        }
+    }
+
     char* nextPathComponent;
     char strBuf[N_MAXPATH];
 
@@ -117,6 +136,14 @@ nKernelServer::Lookup(const char* path)
         cur = cur->Find(nextPathComponent);
     }
 
+    // only found objects are cached
+    if (cacheEntry && cur)
+    {
+        cacheEntry->path = path;
+        cacheEntry->object = cur;
+        cacheEntry->nohGeneration = nRoot::GetNohGeneration();
+    }
+
     this->Unlock();
     return cur;
 }
@@ -248,6 +275,10 @@ nKernelServer::nKernelServer() :
     timeServer(0),
     remoteServer(0),
     hardRefServer(0),
+    profileServer(0),
+    jobServer(0),
+    frameArena(0),
+    workerPool(0),
     root(0),
     cwd(0),
     classList(64),
@@ -258,6 +289,19 @@ nKernelServer::nKernelServer() :
     n_assert(0 == Singleton);
     Singleton = this;
 
+    int i;
+    for (i = 0; i < LookupCacheSize; i++)
+    {
+        this->lookupCache[i].object = 0;
+        this->lookupCache[i].nohGeneration = 0;
+    }
+#ifdef __NEBULA_MEM_MANAGER__
+    memset(this->varMemClassBytes, 0, sizeof(this->varMemClassBytes));
+    memset(this->varMemCacheHitRate, 0, sizeof(this->varMemCacheHitRate));
+    memset(this->memCacheHits, 0, sizeof(this->memCacheHits));
+    memset(this->memCacheMisses, 0, sizeof(this->memCacheMisses));
+#endif
+
     // initialize the debug memory system
 #ifdef __WIN32__
     n_dbgmeminit();
@@ -274,10 +318,24 @@ nKernelServer::nKernelServer() :
     // initialize the kernel package classes
     this->AddPackage(nkernel);
 
+    // create profile server first, so that all objects can register zones
+    this->profileServer = n_new(nProfileServer);
+    n_assert(this->profileServer);
+
     // create hard ref server
     this->hardRefServer = n_new(nHardRefServer);
     n_assert(this->hardRefServer);
 
+    // create job server and worker thread pool (threads are started on first use)
+    this->jobServer = n_new(nJobServer);
+    n_assert(this->jobServer);
+    this->workerPool = n_new(nWorkerPool);
+    n_assert(this->workerPool);
+
+    // create per-frame memory arena
+    this->frameArena = n_new(nFrameArena);
+    n_assert(this->frameArena);
+
     // create root object
     this->root = (nRoot*)this->NewUnnamedObject("nroot");
     n_assert(this->root);
@@ -312,6 +370,12 @@ nKernelServer::~nKernelServer()
     this->Lock();
     this->SetLogHandler(0);
 
+    // shut down worker threads
+    n_delete(this->workerPool);
+    this->workerPool = 0;
+    n_delete(this->jobServer);
+    this->jobServer = 0;
+
     // kill time and file server
     if (this->timeServer)
     {
@@ -383,6 +447,14 @@ nKernelServer::~nKernelServer()
     n_delete(this->hardRefServer);
     this->hardRefServer = 0;
 
+    // kill the frame arena after all objects which may own frame allocated arrays
+    n_delete(this->frameArena);
+    this->frameArena = 0;
+
+    // kill the profile server
+    n_delete(this->profileServer);
+    this->profileServer = 0;
+
     // delete default log handler
     n_delete(this->defaultLogHandler);
     this->defaultLogHandler = 0;
@@ -854,7 +926,55 @@ nKernelServer::PopCwd()
 void nKernelServer::Trigger()
 {
     // get memory statistics...
-#ifdef __WIN32__
+#if defined(__NEBULA_MEM_MANAGER__)
+    nMemManagerStats memStats;
+    n_memgetstats(memStats);
+    if (memStats.totalSize > this->varMemHighWaterSize->GetI())
+    {
+        this->varMemHighWaterSize->SetI(memStats.totalSize);
+    }
+    this->varMemTotalSize->SetI(memStats.totalSize);
+    this->varMemTotalCount->SetI(memStats.totalCount);
+
+    // allocated bytes per size class
+    char varName[N_MAXPATH];
+    int i;
+    for (i = 0; i < memStats.numSizeClasses; i++)
+    {
+        if (0 == this->varMemClassBytes[i])
+        {
+            if (memStats.classSize[i] > 0)
+            {
+                snprintf(varName, sizeof(varName), "/sys/var/mem_class%d_bytes", memStats.classSize[i]);
+            }
+            else
+            {
+                snprintf(varName, sizeof(varName), "/sys/var/mem_classlarge_bytes");
+            }
+            this->varMemClassBytes[i] = (nEnv*) this->New("nenv", varName);
+        }
+        this->varMemClassBytes[i]->SetI(memStats.classBytes[i]);
+    }
+
+    // cache hit rate of every thread since the last Trigger()
+    for (i = 0; i < memStats.numThreadCaches; i++)
+    {
+        if (0 == this->varMemCacheHitRate[i])
+        {
+            snprintf(varName, sizeof(varName), "/sys/var/mem_cache%d_hitrate", i);
+            this->varMemCacheHitRate[i] = (nEnv*) this->New("nenv", varName);
+            this->varMemCacheHitRate[i]->SetF(0.0f);
+        }
+        int hits = memStats.cacheHits[i] - this->memCacheHits[i];
+        int misses = memStats.cacheMisses[i] - this->memCacheMisses[i];
+        if ((hits + misses) > 0)
+        {
+            this->varMemCacheHitRate[i]->SetF(float(hits) / float(hits + misses));
+        }
+        this->memCacheHits[i] = memStats.cacheHits[i];
+        this->memCacheMisses[i] = memStats.cacheMisses[i];
+    }
+#elif defined(__WIN32__)
     nMemoryStats memStats = n_dbgmemgetstats();
     this->varMemHighWaterSize->SetI(memStats.highWaterSize);
     this->varMemTotalSize->SetI(memStats.totalSize);
@@ -3,8 +3,31 @@
     @class nMemManager
     @ingroup NebulaKernelMemory
 
-    Nebula memory management class. Optimizes memory allocations and tracks
-    memory leaks and corruptions.
+    Nebula memory management class, a thread caching small block allocator.
+
+    Small blocks (up to 8 KB) are rounded up to one of 32 size classes:
+    16 byte steps up to 128 bytes, then 4 classes per power of 2. They
+    are carved from 64 KB spans, which are aligned to their size, so the
+    span header (owner thread cache and size class) of a block is found
+    by masking its address. Larger blocks get an individual span.
+
+    Every thread has its own cache with a free list per size class, so
+    allocating and freeing the blocks of the own spans doesn't need any
+    locking. A block which is freed by another thread is pushed onto a
+    lock-free list of the owner cache, the owner takes the whole list
+    when its own free list runs empty. A thread's cache is released
+    by n_memthreadexit() (which is called by nThread::ThreadHarakiri())
+    and adopted by the next new thread, the memory of the spans is never
+    returned to the system. On POSIX systems, the caches of threads which
+    haven't been created by nThread are released by a thread specific
+    data destructor when the thread exits.
+
+    If all thread caches are in use, a thread falls back to a shared
+    cache, which is protected by a spin lock.
+
+    In debug builds every block gets a header with the source location
+    and magic cookies in front of and behind the block, which are checked
+    when the block is freed.
 
     (C) 1999 RadonLabs GmbH
 */
@@ -12,401 +35,658 @@
 
 #if defined(__NEBULA_MEM_MANAGER__) || defined(DOXYGEN)
 
-#include "kernel/nmutex.h"
-#include "util/nlist.h"
-#include "util/nnode.h"
-#include "kernel/nkernelserver.h"
+#include "kernel/ninterlocked.h"
+
+#if defined(__WIN32__) && !defined(_INC_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#if !defined(__WIN32__) && !defined(__NEBULA_NO_THREADS__)
+#include <pthread.h>
+#endif
 
 #undef n_malloc
 #undef n_calloc
+#undef n_realloc
 #undef n_free
 
-struct nChunkHeader
+// thread local variables
+#if defined(__NEBULA_NO_THREADS__)
+#define N_THREADLOCAL
+#elif defined(__WIN32__)
+#define N_THREADLOCAL __declspec(thread)
+#else
+#define N_THREADLOCAL __thread
+#endif
+
+enum
 {
-    nNode nd;           // muss im ersten Element bleiben!
-    int bnum;           // Block-Anzahl
-    int bsize;          // Block-Groesse
+    N_SPAN_SIZE = 64 * 1024,                // size and alignment of a span
+    N_SPAN_HEADER_SIZE = 64,                // blocks start behind the header
+    N_MAX_SMALL_SIZE = 8192,                // largest small block size
+    N_NUM_SMALL_CLASSES = 32,
+    N_LARGE_CLASS = N_NUM_SMALL_CLASSES,    // size class of large blocks
+    N_NUM_SIZECLASSES = N_NUM_SMALL_CLASSES + 1,
+    N_MAX_THREADCACHES = nMemManagerStats::MaxThreadCaches,
+    N_DEBUG_HEADER_SIZE = 32,               // keeps blocks 16 byte aligned
+    N_PREFIX_MAGIC_COOKIE  = 0xDEADBEEF,
+    N_POSTFIX_MAGIC_COOKIE = 0xFEEBDAED,
 };
 
-struct nBlockHeader
+// the block sizes of the size classes
+static const int nMemClassSize[N_NUM_SMALL_CLASSES] =
 {
-    enum
-    {
-        N_SRCNAME_LEN = 16,
-    };
-    struct nBlockHeader *next;
-    int size;
-    char src_name[N_SRCNAME_LEN];
-    int  src_line;
-    int magic;
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+    5120, 6144, 7168, 8192,
 };
 
-struct nBlockPostfix
+struct nMemThreadCache;
+
+/// a free block
+struct nMemBlock
 {
-    int magic;
+    nMemBlock* next;
 };
 
-class nMemManager
+/// the header at the start of a span
+struct nMemSpan
 {
-public:
-    enum
-    {
-        N_MINBLOCK = 4,     ///< minimal block size is 2^4
-        N_MAXBLOCK = 10,    ///< maximum block size is 2^10
-        N_NUMBLOCKSIZES = (1+(N_MAXBLOCK - N_MINBLOCK)),
-        N_PREFIX_MAGIC_COOKIE  = 0xDEADBEEF,
-        N_POSTFIX_MAGIC_COOKIE = 0xFEEBDAED,
-    };
-
-    nMutex mutex;
-    nList chunks;
-    nBlockHeader *blocks[N_NUMBLOCKSIZES];
-    int b_size[N_NUMBLOCKSIZES];
-    int b_num[N_NUMBLOCKSIZES];
-
-    /// constructor
-    nMemManager();
-    /// destructor
-    ~nMemManager();
-    /// Get new chunk of memory
-    nBlockHeader *NewChunk(int, int);
-    /// Release a chunk of memory
-    void FreeChunk(nChunkHeader *);
-    /// Allocate memory
-    void *Malloc(int, const char *, int);
-    /// Reallocate memory
-    void *Realloc(void *, int, const char *, int);
-    /// Free memory
-    void Free(void *);
+    nMemThreadCache* owner;     // 0 for large blocks
+    int sizeClass;
+    int size;                   // allocated size of the span
 };
 
-static nMemManager mem;
+/// the per-thread cache
+struct nMemThreadCache
+{
+    volatile long inUse;                        // 1 while a thread owns the cache
+    nMemBlock* freeList[N_NUM_SMALL_CLASSES];   // owner only
+    void* volatile remoteFreeList[N_NUM_SMALL_CLASSES];  // blocks freed by other threads
+    char* spanPos[N_NUM_SMALL_CLASSES];         // unused part of the current span
+    char* spanEnd[N_NUM_SMALL_CLASSES];
+
+    // statistics, only written by the thread which owns the cache
+    int hits;
+    int misses;
+    int numAllocs;                      // allocs by this thread, including large blocks
+    int numBlocks;                      // allocs minus frees by this thread
+    int classBytes[N_NUM_SIZECLASSES];  // allocated minus freed bytes by this thread
+};
 
-int n_memallocated = 0;
-int n_memused      = 0;
-int n_memnumalloc  = 0;
+/// the debug header in front of a block
+struct nMemDebugHeader
+{
+    const char* file;
+    int line;
+    int size;
+    int magic;
+};
+
+// all static data is zero initialized, so the allocator works before
+// any constructor has been called
+static nMemThreadCache nMemCaches[N_MAX_THREADCACHES];
+static nMemThreadCache nMemSharedCache;     // for threads which didn't get an own cache
+static volatile long nMemSharedLock = 0;
+static uchar nMemSizeClassTable[(N_MAX_SMALL_SIZE / 16) + 1];
+static volatile long nMemInitialized = 0;
+static N_THREADLOCAL nMemThreadCache* nMemCurCache = 0;
 
 //------------------------------------------------------------------------------
 /**
-    Creates the memory chunks.
+    Compute the size class of a small block size.
 */
-nMemManager::nMemManager()
+static
+int
+nMemComputeSizeClass(int size)
 {
-    int i;
-    for (i=0; i<(int)N_NUMBLOCKSIZES; i++)
+    if (size <= 128)
+    {
+        return (size > 0) ? ((size - 1) >> 4) : 0;
+    }
+    int bits = 7;
+    while (((size - 1) >> (bits + 1)) > 0)
     {
-        b_size[i] = (1<<(i+N_MINBLOCK));
-        b_num[i]  = (16*1024) / b_size[i];
-        blocks[i] = this->NewChunk(b_size[i],b_num[i]);
-        if (NULL == blocks[i]) n_error("Out Of Memory!");
+        bits++;
     }
+    return 8 + ((bits - 7) * 4) + (((size - 1) >> (bits - 2)) & 3);
 }
 
 //------------------------------------------------------------------------------
 /**
-    Frees all memory chunks. Detects memory leaks.
-
-    @todo memlog is disabled, since it clutters the working directory
+    Fill the lookup table from 16 byte size steps to size classes. May
+    run more than once if several threads start at the same time, which
+    doesn't harm.
 */
-nMemManager::~nMemManager()
+static
+void
+nMemInitialize()
 {
-//    FILE *fp = NULL;
-
-    nChunkHeader *ch;
-    while ((ch = (nChunkHeader *) this->chunks.GetHead())) {
-        char *b = ((char *)ch) + sizeof(nChunkHeader);
+    int i;
+    for (i = 0; i <= (N_MAX_SMALL_SIZE / 16); i++)
+    {
+        int sizeClass = nMemComputeSizeClass(i * 16);
+        n_assert(nMemClassSize[sizeClass] >= (i * 16));
+        nMemSizeClassTable[i] = (uchar) sizeClass;
+    }
+    n_interlocked_exchange(&nMemInitialized, 1);
+}
 
-/*
-    FIXME: memlog disabled temporally, since it clutters the working directory
+#if !defined(__WIN32__) && !defined(__NEBULA_NO_THREADS__)
+static pthread_key_t nMemThreadKey;
+static volatile long nMemThreadKeyState = 0;    // 0: none, 1: being created, 2: created
 
-        int i;
-        for (i=0; i<ch->bnum; i++,b+=ch->bsize) {
-            nBlockHeader *bh = (nBlockHeader *)b;
-            if (bh->size != 0) {
-                // Erster MemLeak? Dann Logfile erzeugen.
-                if (!fp) {
-                    fp = fopen("n_memlog.txt","w");
-                    if (fp) {
-                        time_t ltime;
-                        struct tm *t;
-                        time(&ltime);
-                        t = localtime(&ltime);
-                        fprintf(fp,"Nebula Memory Log\n=================\n%s\n\n",asctime(t));
-                    }
-                }
-                if (fp) {
-                    fprintf(fp,"*** MEM LEAK DETECTED! ***\n");
-                    fprintf(fp,"size = %d\n",bh->size);
-                    fprintf(fp,"src  = %s\n",bh->src_name);
-                    fprintf(fp,"line = %d\n",bh->src_line);
-                }
-            }
-        }
+//------------------------------------------------------------------------------
+/**
+    Called by the system when a thread exits which still owns a cache.
 */
-        this->FreeChunk(ch);
-    }
-/*
-    if (fp) {
-        fprintf(fp,"---\nEOF\n");
-        fclose(fp);
+static
+void
+nMemThreadKeyDestructor(void* ptr)
+{
+    nMemThreadCache* cache = (nMemThreadCache*) ptr;
+    if (cache == nMemCurCache)
+    {
+        nMemCurCache = 0;
     }
-*/
+    n_interlocked_exchange(&cache->inUse, 0);
 }
 
 //------------------------------------------------------------------------------
 /**
-    Allocate a new chunk and return pointer to first block in chunk.
-
-    @param bsize block size
-    @param bnum number of blocks in chunk
+    Make sure the cache of the calling thread is released when the thread
+    exits, even if the thread doesn't call n_memthreadexit().
 */
-nBlockHeader *nMemManager::NewChunk(int bsize, int bnum)
-{
-    int block_size = bsize + sizeof(nBlockHeader) + sizeof(nBlockPostfix);
-    int chunk_size = sizeof(nChunkHeader) + (block_size*bnum);
-    char *c = (char *) malloc(chunk_size);
-    if (c) {
-        n_memallocated += chunk_size;
-
-        // initialize chunk header
-        nChunkHeader *ch = (nChunkHeader *) c;
-        ch->nd.nNode::nNode();      // manually construct node.
-        ch->bnum  = bnum;
-        ch->bsize = block_size;
-        this->chunks.AddTail((nNode *)ch);
-
-        // initialize the blocks
-        char *f = c + sizeof(nChunkHeader); // first Block
-        char *p = c + chunk_size;           // last Block + 1
-        char *next = NULL;
-        while (p > f) {
-            p -= block_size;
-            nBlockHeader *bh = (nBlockHeader *)p;
-            bh->next = (nBlockHeader *) next;
-            bh->size = 0;
-            strcpy(bh->src_name,"<new>");
-            bh->src_line = 0;
-            bh->magic = N_PREFIX_MAGIC_COOKIE;
-            next = p;
+static
+void
+nMemRegisterThreadCache(nMemThreadCache* cache)
+{
+    if (2 != nMemThreadKeyState)
+    {
+        if (0 == n_interlocked_compare_exchange(&nMemThreadKeyState, 1, 0))
+        {
+            pthread_key_create(&nMemThreadKey, nMemThreadKeyDestructor);
+            n_interlocked_exchange(&nMemThreadKeyState, 2);
+        }
+        while (2 != nMemThreadKeyState)
+        {
+            // another thread creates the key
         }
-        return (nBlockHeader *) f;
     }
-    return NULL;
+    pthread_setspecific(nMemThreadKey, cache);
 }
+#endif
 
 //------------------------------------------------------------------------------
 /**
-    Releases the given chunk back to the memory pool.
-
-    @param ch pointer to chunk to release
+    Get the size class of a small block size.
 */
-void nMemManager::FreeChunk(nChunkHeader *ch)
+static
+inline
+int
+nMemGetSizeClass(int size)
 {
-    n_memallocated -= sizeof(nChunkHeader) + (ch->bsize*ch->bnum);
-    ch->nd.Remove();
-    ch->nd.nNode::~nNode();
-    free((void *)ch);
+    return nMemSizeClassTable[(size + 15) >> 4];
 }
 
 //------------------------------------------------------------------------------
 /**
-    Custom Malloc. Uses given source file and line to report memory leaks.
-
-    @param size amount of memory to allocate
-    @param src_name name of source file
-    @param src_line line number within source file
+    Get the cache of the calling thread. A thread without a cache adopts
+    a released cache or takes an unused one. If all caches are in use,
+    the thread uses the shared cache, which must be locked with
+    nMemLockCache().
 */
-void *nMemManager::Malloc(int size, const char *src_name, int src_line)
-{
-    mutex.Lock();
-    char *p = NULL;
-
-    // ensure source name fits
-    int len = strlen(src_name)+1;
-    int off = len - nBlockHeader::N_SRCNAME_LEN;
-    if (off < 0) off = 0;
-
-    if (size > (1<<N_MAXBLOCK)) {
-        // memory wanted is bigger than max block size, so create a new individual chunk.
-        p = (char *) this->NewChunk(size,1);
-        if (p) {
-            nBlockHeader *bh  = (nBlockHeader *) p;
-            nBlockPostfix *bp = (nBlockPostfix *) (p + size + sizeof(nBlockHeader));
-            bh->next = (nBlockHeader *) -1L;    // flag for n_free()/Free()
-            bh->size = size;
-            strcpy(bh->src_name,&(src_name[off]));
-            bh->src_line = src_line;
-            bh->magic = N_PREFIX_MAGIC_COOKIE;
-            bp->magic = N_POSTFIX_MAGIC_COOKIE;
-            p += sizeof(nBlockHeader);
-            n_memused += size;
-            n_memnumalloc++;
+static
+inline
+nMemThreadCache*
+nMemGetThreadCache()
+{
+    nMemThreadCache* cache = nMemCurCache;
+    if (0 == cache)
+    {
+        if (0 == nMemInitialized)
+        {
+            nMemInitialize();
         }
-    } else {
-        // find suitable block size
         int i;
-        for (i=0; i<(int)(N_NUMBLOCKSIZES-1); i++) {
-            int mask = ~(b_size[i]-1);
-            if ((size & mask) == 0) {
+        for (i = 0; i < N_MAX_THREADCACHES; i++)
+        {
+            if (0 == n_interlocked_compare_exchange(&nMemCaches[i].inUse, 1, 0))
+            {
+                cache = &(nMemCaches[i]);
                 break;
             }
         }
-        p = (char *) blocks[i];
-        if (p) {
-            nBlockHeader  *bh = (nBlockHeader *)  p;
-            nBlockPostfix *bp = (nBlockPostfix *) (p + size + sizeof(nBlockHeader));
-            blocks[i] = bh->next;
-            if (NULL == blocks[i]) {
-                // need a new chunk
-                blocks[i] = this->NewChunk(b_size[i],b_num[i]);
-                if (NULL == blocks[i]) n_error("Out Of Memory!\n");
-            }
-            bh->next  = (nBlockHeader *) i;
-            bh->size  = size;
-            strcpy(bh->src_name,&(src_name[off]));
-            bh->src_line = src_line;
-            bh->magic = N_PREFIX_MAGIC_COOKIE;
-            bp->magic = N_POSTFIX_MAGIC_COOKIE;
-            p += sizeof(nBlockHeader);
-            n_memused += size;
-            n_memnumalloc++;
+        if (0 == cache)
+        {
+            cache = &nMemSharedCache;
+        }
+        #if !defined(__WIN32__) && !defined(__NEBULA_NO_THREADS__)
+        else
+        {
+            nMemRegisterThreadCache(cache);
         }
+        #endif
+        nMemCurCache = cache;
     }
-    mutex.Unlock();
-    return p;
+    return cache;
 }
 
-
 //------------------------------------------------------------------------------
 /**
-    Custom simplistic Realloc which just uses malloc & memcpy rather than
-    actually trying to 'grow' the memory in place.
-
-    @param oldp pointer to memory which should be grown/shrunk
-    @param size amount of memory to reallocate
-    @param src_name name of source file
-    @param src_line line number within source file
+    Lock the cache if it is the shared cache. Own caches are only used by
+    their thread and need no locking.
 */
-void *nMemManager::Realloc(void *oldp, int size, const char *src_name, int src_line)
+static
+inline
+void
+nMemLockCache(nMemThreadCache* cache)
 {
-    if (oldp == NULL)
+    if (&nMemSharedCache == cache)
     {
-        return this->Malloc(size, src_name, src_line);
+        while (0 != n_interlocked_exchange(&nMemSharedLock, 1))
+        {
+            // spin
+        }
     }
+}
 
-    if (size == 0)
+//------------------------------------------------------------------------------
+/**
+*/
+static
+inline
+void
+nMemUnlockCache(nMemThreadCache* cache)
+{
+    if (&nMemSharedCache == cache)
     {
-        this->Free(oldp);
+        n_interlocked_exchange(&nMemSharedLock, 0);
     }
+}
 
-    char *oldpc = (char *) oldp;
-    nBlockHeader  *bh = (nBlockHeader *) (oldpc - sizeof(nBlockHeader));
+//------------------------------------------------------------------------------
+/**
+    Allocate a span aligned to N_SPAN_SIZE. On Win32, VirtualAlloc()
+    returns memory aligned to the 64 KB allocation granularity.
+*/
+static
+nMemSpan*
+nMemAllocSpan(int size)
+{
+#if defined(__WIN32__)
+    void* ptr = VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* ptr = 0;
+    if (0 != posix_memalign(&ptr, N_SPAN_SIZE, size))
+    {
+        ptr = 0;
+    }
+#endif
+    if (0 == ptr)
+    {
+        n_error("nMemManager: Out Of Memory!\n");
+    }
+    nMemSpan* span = (nMemSpan*) ptr;
+    span->size = size;
+    return span;
+}
 
-    int old_size = bh->size;
+//------------------------------------------------------------------------------
+/**
+*/
+static
+void
+nMemFreeSpan(nMemSpan* span)
+{
+#if defined(__WIN32__)
+    VirtualFree(span, 0, MEM_RELEASE);
+#else
+    free(span);
+#endif
+}
 
-    void *p = this->Malloc(size, src_name, src_line);
+//------------------------------------------------------------------------------
+/**
+    Get the span of a block.
+*/
+static
+inline
+nMemSpan*
+nMemGetSpan(void* ptr)
+{
+    return (nMemSpan*) (size_t(ptr) & ~size_t(N_SPAN_SIZE - 1));
+}
 
-    if (p != NULL)
+//------------------------------------------------------------------------------
+/**
+    Get a block when the cache's free list of a size class is empty:
+    take the blocks other threads have freed, or carve a new block
+    from the current span.
+*/
+static
+nMemBlock*
+nMemRefill(nMemThreadCache* cache, int sizeClass)
+{
+    nMemBlock* block = (nMemBlock*) n_interlocked_exchange_pointer(&cache->remoteFreeList[sizeClass], 0);
+    if (block)
     {
-        memcpy(p, oldp, (size > old_size) ? old_size : size);
-        this->Free(oldp);
+        cache->freeList[sizeClass] = block->next;
+        return block;
     }
 
-    return p;
+    int blockSize = nMemClassSize[sizeClass];
+    if ((cache->spanPos[sizeClass] + blockSize) > cache->spanEnd[sizeClass])
+    {
+        nMemSpan* span = nMemAllocSpan(N_SPAN_SIZE);
+        span->owner = cache;
+        span->sizeClass = sizeClass;
+        cache->spanPos[sizeClass] = ((char*) span) + N_SPAN_HEADER_SIZE;
+        cache->spanEnd[sizeClass] = ((char*) span) + N_SPAN_SIZE;
+    }
+    block = (nMemBlock*) cache->spanPos[sizeClass];
+    cache->spanPos[sizeClass] += blockSize;
+    return block;
 }
 
-
 //------------------------------------------------------------------------------
 /**
-    Frees a previously allocated block of memory.
-
-    @param p pointer to allocated memory.
+    Allocate a block of at least size bytes, without debug header.
 */
-void nMemManager::Free(void *p)
+static
+char*
+nMemAllocBlock(nMemThreadCache* cache, int size)
 {
-    mutex.Lock();
+    char* ptr;
+    if (size <= N_MAX_SMALL_SIZE)
+    {
+        int sizeClass = nMemGetSizeClass(size);
+        nMemBlock* block = cache->freeList[sizeClass];
+        if (block)
+        {
+            cache->freeList[sizeClass] = block->next;
+            cache->hits++;
+        }
+        else
+        {
+            block = nMemRefill(cache, sizeClass);
+            cache->misses++;
+        }
+        cache->classBytes[sizeClass] += nMemClassSize[sizeClass];
+        ptr = (char*) block;
+    }
+    else
+    {
+        nMemSpan* span = nMemAllocSpan(N_SPAN_HEADER_SIZE + size);
+        span->owner = 0;
+        span->sizeClass = N_LARGE_CLASS;
+        cache->classBytes[N_LARGE_CLASS] += span->size;
+        ptr = ((char*) span) + N_SPAN_HEADER_SIZE;
+    }
+    cache->numAllocs++;
+    cache->numBlocks++;
+    return ptr;
+}
 
-    char *pc = (char *) p;
-    nBlockHeader  *bh = (nBlockHeader *) (pc - sizeof(nBlockHeader));
-    nBlockPostfix *bp;
+//------------------------------------------------------------------------------
+/**
+    Free a block which has been allocated by nMemAllocBlock().
+*/
+static
+void
+nMemFreeBlock(nMemThreadCache* cache, char* ptr)
+{
+    nMemSpan* span = nMemGetSpan(ptr);
+    int sizeClass = span->sizeClass;
+    cache->numBlocks--;
+    if (N_LARGE_CLASS == sizeClass)
+    {
+        cache->classBytes[N_LARGE_CLASS] -= span->size;
+        nMemFreeSpan(span);
+        return;
+    }
 
-    // is the block corrupt?
-    if (bh->magic != (int)N_PREFIX_MAGIC_COOKIE)
+    cache->classBytes[sizeClass] -= nMemClassSize[sizeClass];
+    nMemBlock* block = (nMemBlock*) ptr;
+    nMemThreadCache* owner = span->owner;
+    if (owner == cache)
     {
-        n_error("Free(): START OF MEM BLOCK CORRUPTED: src=%s, line=%d\n", bh->src_name, bh->src_line);
+        block->next = cache->freeList[sizeClass];
+        cache->freeList[sizeClass] = block;
     }
-    bp = (nBlockPostfix *) (pc + bh->size);
-    if (bp->magic != (int)N_POSTFIX_MAGIC_COOKIE) {
-        n_error("Free(): END OF MEM BLOCK CORRUPTED: src=%s, line=%d\n", bh->src_name, bh->src_line);
+    else
+    {
+        // push onto the owner's remote free list, the head is only read
+        // by the compare exchange, the owner takes the list at any time
+        void* volatile* list = &(owner->remoteFreeList[sizeClass]);
+        void* head = 0;
+        void* prevHead;
+        for (;;)
+        {
+            block->next = (nMemBlock*) head;
+            prevHead = n_interlocked_compare_exchange_pointer(list, block, head);
+            if (prevHead == head)
+            {
+                break;
+            }
+            head = prevHead;
+        }
     }
+}
 
-    // update memory stats
-    n_memused -= bh->size;
-    n_memnumalloc--;
-
-    strcpy(bh->src_name,"<freed>");
-    bh->src_line = 0;
-
-    if (((int)bh->next) == -1L) {
-        // block was allocated as individual chunk
-        nChunkHeader *ch = (nChunkHeader *) (((char *)bh) - sizeof(nChunkHeader));
-        bh->size = 0;
-        this->FreeChunk(ch);
-    } else {
-        int i = (int) bh->next;
-        nBlockHeader *next = blocks[i];
-        blocks[i] = bh;
-        bh->next = next;
-        bh->size = 0;
+//------------------------------------------------------------------------------
+/**
+    Get the usable size of a block allocated by nMemAllocBlock().
+*/
+static
+int
+nMemGetBlockSize(char* ptr)
+{
+    nMemSpan* span = nMemGetSpan(ptr);
+    if (N_LARGE_CLASS == span->sizeClass)
+    {
+        return span->size - N_SPAN_HEADER_SIZE;
     }
-    mutex.Unlock();
+    return nMemClassSize[span->sizeClass];
 }
 
 //------------------------------------------------------------------------------
 /**
-    @ingroup NebulaKernelMemory
+    Custom Malloc. In debug builds, the given source file and line are
+    stored in the block header for error reports.
 
-    Uses the memory manager.
+    @param size amount of memory to allocate
+    @param src_name name of source file
+    @param src_line line number within source file
 */
-void *nn_malloc(size_t size, const char *file, int line)
+void*
+nn_malloc(size_t size, const char* src_name, int src_line)
 {
-    return mem.Malloc(size,file,line);
+    nMemThreadCache* cache = nMemGetThreadCache();
+#ifdef _DEBUG
+    nMemLockCache(cache);
+    char* ptr = nMemAllocBlock(cache, int(size) + N_DEBUG_HEADER_SIZE + sizeof(int));
+    nMemUnlockCache(cache);
+    nMemDebugHeader* header = (nMemDebugHeader*) ptr;
+    header->file = src_name;
+    header->line = src_line;
+    header->size = int(size);
+    header->magic = N_PREFIX_MAGIC_COOKIE;
+    ptr += N_DEBUG_HEADER_SIZE;
+    int postfixMagic = N_POSTFIX_MAGIC_COOKIE;
+    memcpy(ptr + size, &postfixMagic, sizeof(int));
+    return ptr;
+#else
+    nMemLockCache(cache);
+    char* ptr = nMemAllocBlock(cache, int(size));
+    nMemUnlockCache(cache);
+    return ptr;
+#endif
 }
 
 //------------------------------------------------------------------------------
 /**
-    @ingroup NebulaKernelMemory
+    Frees a previously allocated block of memory.
 
-    Uses the memory manager.
+    @param p pointer to allocated memory.
 */
-void n_free(void *p)
+void
+nn_free(void* p)
 {
-    mem.Free(p);
+    if (0 == p)
+    {
+        return;
+    }
+    char* ptr = (char*) p;
+#ifdef _DEBUG
+    ptr -= N_DEBUG_HEADER_SIZE;
+    nMemDebugHeader* header = (nMemDebugHeader*) ptr;
+    if (header->magic != (int) N_PREFIX_MAGIC_COOKIE)
+    {
+        n_error("nn_free(): START OF MEM BLOCK CORRUPTED: src=%s, line=%d\n", header->file, header->line);
+    }
+    int postfixMagic;
+    memcpy(&postfixMagic, ptr + N_DEBUG_HEADER_SIZE + header->size, sizeof(int));
+    if (postfixMagic != (int) N_POSTFIX_MAGIC_COOKIE)
+    {
+        n_error("nn_free(): END OF MEM BLOCK CORRUPTED: src=%s, line=%d\n", header->file, header->line);
+    }
+    header->magic = 0;
+#endif
+    nMemThreadCache* cache = nMemGetThreadCache();
+    nMemLockCache(cache);
+    nMemFreeBlock(cache, ptr);
+    nMemUnlockCache(cache);
 }
 
 //------------------------------------------------------------------------------
 /**
-    @ingroup NebulaKernelMemory
+    Custom calloc. Fails if num * size overflows.
+*/
+void*
+nn_calloc(size_t num, size_t size, const char* src_name, int src_line)
+{
+    if ((size > 0) && (num > (size_t(-1) / size)))
+    {
+        n_error("nn_calloc(): size overflow (%u * %u): src=%s, line=%d\n", uint(num), uint(size), src_name, src_line);
+    }
+    size_t allSize = num * size;
+    void* p = nn_malloc(allSize, src_name, src_line);
+    memset(p, 0, allSize);
+    return p;
+}
 
-    Uses the memory manager.
+//------------------------------------------------------------------------------
+/**
+    Custom Realloc. Returns the same block if it is large enough and
+    doesn't waste a size class, otherwise moves the contents to a new
+    block.
+
+    @param oldp pointer to memory which should be grown/shrunk
+    @param size amount of memory to reallocate
+    @param src_name name of source file
+    @param src_line line number within source file
 */
-void *nn_calloc(size_t num, size_t size, const char *file, int line)
+void*
+nn_realloc(void* oldp, size_t size, const char* src_name, int src_line)
 {
-    size_t all_size = num*size;
-    void *p = mem.Malloc(all_size,file,line);
-    if (p) memset(p,0,sizeof(all_size));
+    if (0 == oldp)
+    {
+        return nn_malloc(size, src_name, src_line);
+    }
+    if (0 == size)
+    {
+        nn_free(oldp);
+        return 0;
+    }
+
+#ifdef _DEBUG
+    int oldSize = ((nMemDebugHeader*) (((char*) oldp) - N_DEBUG_HEADER_SIZE))->size;
+#else
+    int oldSize = nMemGetBlockSize((char*) oldp);
+    if ((int(size) <= N_MAX_SMALL_SIZE) && (oldSize <= N_MAX_SMALL_SIZE) &&
+        (nMemGetSizeClass(int(size)) == nMemGetSizeClass(oldSize)))
+    {
+        return oldp;
+    }
+#endif
+    void* p = nn_malloc(size, src_name, src_line);
+    memcpy(p, oldp, (int(size) < oldSize) ? int(size) : oldSize);
+    nn_free(oldp);
     return p;
 }
 
 //------------------------------------------------------------------------------
 /**
-    @ingroup NebulaKernelMemory
+    Release the cache of the calling thread, the next new thread will
+    adopt it. The thread must not allocate memory afterwards.
+*/
+void
+n_memthreadexit()
+{
+    nMemThreadCache* cache = nMemCurCache;
+    if (cache)
+    {
+        nMemCurCache = 0;
+        if (&nMemSharedCache != cache)
+        {
+            #if !defined(__WIN32__) && !defined(__NEBULA_NO_THREADS__)
+            pthread_setspecific(nMemThreadKey, 0);
+            #endif
+            n_interlocked_exchange(&cache->inUse, 0);
+        }
+    }
+}
 
-    Uses the memory manager.
+//------------------------------------------------------------------------------
+/**
+    Collect the statistics of all thread caches. The statistics of other
+    threads are read without synchronization, so they may be slightly
+    out of date. The shared cache only counts into the totals.
 */
-void *nn_realloc(void *p, size_t size, const char *file, int line)
+void
+n_memgetstats(nMemManagerStats& stats)
 {
-    return mem.Realloc(p, size, file, line);
+    memset(&stats, 0, sizeof(stats));
+    stats.numSizeClasses = N_NUM_SIZECLASSES;
+    int i;
+    for (i = 0; i < N_NUM_SMALL_CLASSES; i++)
+    {
+        stats.classSize[i] = nMemClassSize[i];
+    }
+    for (i = 0; i < N_MAX_THREADCACHES; i++)
+    {
+        const nMemThreadCache& cache = nMemCaches[i];
+        if ((0 == cache.inUse) && (0 == (cache.hits + cache.misses)))
+        {
+            // never used
+            continue;
+        }
+        stats.numThreadCaches = i + 1;
+        stats.cacheHits[i] = cache.hits;
+        stats.cacheMisses[i] = cache.misses;
+        stats.totalCount += cache.numBlocks;
+        stats.numAllocs += cache.numAllocs;
+        int classIndex;
+        for (classIndex = 0; classIndex < N_NUM_SIZECLASSES; classIndex++)
+        {
+            stats.classBytes[classIndex] += cache.classBytes[classIndex];
+            stats.totalSize += cache.classBytes[classIndex];
+        }
+    }
+    stats.totalCount += nMemSharedCache.numBlocks;
+    stats.numAllocs += nMemSharedCache.numAllocs;
+    for (i = 0; i < N_NUM_SIZECLASSES; i++)
+    {
+        stats.classBytes[i] += nMemSharedCache.classBytes[i];
+        stats.totalSize += nMemSharedCache.classBytes[i];
+    }
 }
 //-------------------------------------------------------------------
 #elif __WIN32__
@@ -446,6 +726,7 @@ void nn_free(void* p)
 */
 void* nn_calloc(size_t num, size_t size, const char*, int)
 {
+    n_assert((0 == size) || (num <= (size_t(-1) / size)));
     HGLOBAL ptr = GlobalAlloc(GMEM_ZEROINIT, size*num);
     n_assert(ptr);
     return ptr;
@@ -479,7 +760,7 @@ void *nn_malloc(size_t size, const char *, int)
 /**
     Uses standard memory management.
 */
-void n_free(void *p)
+void nn_free(void *p)
 {
     free(p);
 }
@@ -0,0 +1,682 @@
+//------------------------------------------------------------------------------
+//  nprofileserver.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nprofileserver.h"
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/ninterlocked.h"
+#include "mathlib/nmath.h"
+
+#if defined(__WIN32__) && !defined(__XBxX__)
+#   ifndef _INC_WINDOWS
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#   endif
+#elif !defined(__XBxX__)
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+// thread local variables
+#if defined(__NEBULA_NO_THREADS__)
+#define N_THREADLOCAL
+#elif defined(__WIN32__)
+#define N_THREADLOCAL __declspec(thread)
+#else
+#define N_THREADLOCAL __thread
+#endif
+
+// the event buffer of the current thread
+static N_THREADLOCAL void* CurThreadBuffer = 0;
+
+nProfileServer* nProfileServer::Singleton = 0;
+
+//------------------------------------------------------------------------------
+/**
+    Read the system timer in seconds.
+*/
+static
+double
+GetSystemTime()
+{
+#if defined(__WIN32__)
+    LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) / double(freq.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return double(tv.tv_sec) + (double(tv.tv_usec) * 0.000001);
+#endif
+}
+
+#if !defined(N_PROFILE_RDTSC_INTRINSIC) && !defined(N_PROFILE_RDTSC_ASM)
+//------------------------------------------------------------------------------
+/**
+    Used by nProfileServer::GetTicks() where the time stamp counter can't
+    be read directly. The ticks are microseconds.
+*/
+uint64
+n_profilesystemticks()
+{
+    return uint64(GetSystemTime() * 1000000.0);
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+*/
+nProfileServer::nProfileServer() :
+    lock(0),
+    numZones(0),
+    zoneIndexMap(256),
+    numThreads(0),
+    calibStartTicks(0),
+    calibStartTime(0.0),
+    ticksPerSecond(1.0),
+    frameCount(0),
+    captureRequested(false),
+    isCapturing(false),
+    captureFramesLeft(0),
+    captureStartTicks(0),
+    captureEvents(0, 4096)
+{
+    n_assert(0 == Singleton);
+    Singleton = this;
+    memset(this->zones, 0, sizeof(this->zones));
+    memset(this->threads, 0, sizeof(this->threads));
+    this->captureEvents.SetFlags(nArray<CaptureEvent>::DoubleGrowSize);
+
+    // get a first estimate of the time stamp counter frequency,
+    // NextFrame() refines it over a longer period
+    this->calibStartTicks = GetTicks();
+    this->calibStartTime = GetSystemTime();
+    double time;
+    do
+    {
+        time = GetSystemTime();
+    }
+    while ((time - this->calibStartTime) < 0.005);
+    this->Calibrate(GetTicks());
+
+    // the creating thread is the main thread
+    this->SetThreadName("Main");
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nProfileServer::~nProfileServer()
+{
+    int i;
+    for (i = 0; i < this->numThreads; i++)
+    {
+        if (this->threads[i]->events)
+        {
+            n_delete_array(this->threads[i]->events);
+        }
+        n_delete(this->threads[i]);
+    }
+    for (i = 0; i < this->numZones; i++)
+    {
+        n_delete(this->zones[i]);
+    }
+    CurThreadBuffer = 0;
+    n_assert(Singleton);
+    Singleton = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nProfileServer::Lock()
+{
+    while (0 != n_interlocked_exchange(&this->lock, 1))
+    {
+        n_sleep(0.0);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nProfileServer::Unlock()
+{
+    n_interlocked_exchange(&this->lock, 0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Registering the same name twice returns the same zone index, so
+    zones may be registered by several objects or threads.
+*/
+int
+nProfileServer::RegisterZone(const char* name)
+{
+    n_assert(name);
+    this->Lock();
+    int zoneIndex;
+    if (!this->zoneIndexMap.Find(name, zoneIndex))
+    {
+        if (this->numZones < MaxZones)
+        {
+            Zone* zone = n_new(Zone);
+            zone->name = name;
+            zone->parentIndex = -2;
+            zone->frameTicks = 0;
+            zone->frameSelfTicks = 0;
+            zone->frameCount = 0;
+            zone->time = 0.0f;
+            zone->selfTime = 0.0f;
+            zone->count = 0;
+            memset(zone->history, 0, sizeof(zone->history));
+
+            zoneIndex = this->numZones;
+            this->zones[zoneIndex] = zone;
+            this->zoneIndexMap.Add(zone->name.Get(), zoneIndex);
+            n_interlocked_exchange(&this->numZones, zoneIndex + 1);
+        }
+        else
+        {
+            n_printf("nProfileServer: too many zones, '%s' is not profiled!\n", name);
+            zoneIndex = -1;
+        }
+    }
+    this->Unlock();
+    return zoneIndex;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the event buffer of the calling thread. A new thread reuses the
+    buffer slot of an exited thread if possible. Returns 0 if there are
+    too many threads.
+*/
+nProfileServer::ThreadBuffer*
+nProfileServer::GetThreadBuffer()
+{
+    ThreadBuffer* buffer = (ThreadBuffer*) CurThreadBuffer;
+    if (0 == buffer)
+    {
+        this->Lock();
+        int threadIndex;
+        for (threadIndex = 0; threadIndex < this->numThreads; threadIndex++)
+        {
+            if (Free == n_interlocked_read(&this->threads[threadIndex]->state))
+            {
+                buffer = this->threads[threadIndex];
+                break;
+            }
+        }
+        if ((0 == buffer) && (this->numThreads < MaxThreads))
+        {
+            buffer = n_new(ThreadBuffer);
+            buffer->state = Free;
+            buffer->events = 0;
+            buffer->numDropped = 0;
+            this->threads[threadIndex] = buffer;
+            n_interlocked_exchange(&this->numThreads, threadIndex + 1);
+        }
+        if (buffer)
+        {
+            buffer->events = n_new_array(Event, BufferSize);
+            buffer->writePos = 0;
+            buffer->readPos = 0;
+            buffer->name.Format("Thread %d", threadIndex);
+            buffer->depth = 0;
+            n_interlocked_exchange(&buffer->state, Active);
+            CurThreadBuffer = buffer;
+        }
+        this->Unlock();
+    }
+    return buffer;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Called by a thread before it exits. The thread must not record events
+    afterwards. The buffer memory is freed by the next NextFrame(), after
+    the remaining events have been read.
+*/
+void
+nProfileServer::ThreadExit()
+{
+    ThreadBuffer* buffer = (ThreadBuffer*) CurThreadBuffer;
+    if (buffer && Singleton)
+    {
+        CurThreadBuffer = 0;
+        n_interlocked_exchange(&buffer->state, Exited);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Free the events of an exited thread and make the slot available to
+    new threads. Zones which are still open are discarded (and closed in
+    a running capture).
+*/
+void
+nProfileServer::FreeThreadBuffer(int threadIndex, uint64 ticks)
+{
+    ThreadBuffer* buffer = this->threads[threadIndex];
+    n_assert(Exited == buffer->state);
+    int i;
+    for (i = buffer->depth - 1; i >= 0; i--)
+    {
+        if (buffer->stack[i].captured)
+        {
+            this->AddCaptureEvent(ticks, buffer->stack[i].zoneIndex, threadIndex, End);
+        }
+    }
+    buffer->depth = 0;
+
+    this->Lock();
+    n_delete_array(buffer->events);
+    buffer->events = 0;
+    n_interlocked_exchange(&buffer->state, Free);
+    this->Unlock();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Record an event into the ring buffer of the calling thread. If the
+    buffer is full (NextFrame() has not been called for a long time), the
+    event is dropped.
+*/
+void
+nProfileServer::AddEvent(int zoneIndex, int type)
+{
+    if (-1 == zoneIndex)
+    {
+        return;
+    }
+    ThreadBuffer* buffer = this->GetThreadBuffer();
+    if (0 == buffer)
+    {
+        return;
+    }
+    long pos = buffer->writePos;
+    if ((pos - n_interlocked_read(&buffer->readPos)) >= BufferSize)
+    {
+        buffer->numDropped++;
+        return;
+    }
+    Event& event = buffer->events[pos & (BufferSize - 1)];
+    event.ticks = GetTicks();
+    event.zoneIndex = zoneIndex;
+    event.type = type;
+
+    // publish the event to NextFrame()
+    n_interlocked_exchange(&buffer->writePos, pos + 1);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The thread name shows up in trace captures.
+*/
+void
+nProfileServer::SetThreadName(const char* name)
+{
+    n_assert(name);
+    ThreadBuffer* buffer = this->GetThreadBuffer();
+    if (buffer)
+    {
+        this->Lock();
+        buffer->name = name;
+        this->Unlock();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nProfileServer::GetNumDroppedEvents() const
+{
+    int numDropped = 0;
+    int i;
+    for (i = 0; i < this->numThreads; i++)
+    {
+        numDropped += this->threads[i]->numDropped;
+    }
+    return numDropped;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Measure the time stamp counter frequency against the system timer,
+    over the whole time since the profile server has been created.
+*/
+void
+nProfileServer::Calibrate(uint64 ticks)
+{
+    double elapsed = GetSystemTime() - this->calibStartTime;
+    if ((elapsed > 0.0) && (ticks > this->calibStartTicks))
+    {
+        this->ticksPerSecond = double(ticks - this->calibStartTicks) / elapsed;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Process the events recorded by a thread since the last call. A zone
+    is accounted to the frame in which it ends. If an end event doesn't
+    match the innermost open zone (a begin or end has been dropped), the
+    zones opened inside the matching zone are discarded, unmatched end
+    events are ignored.
+*/
+void
+nProfileServer::ReadEvents(int threadIndex)
+{
+    ThreadBuffer* buffer = this->threads[threadIndex];
+    long writePos = n_interlocked_read(&buffer->writePos);
+
+    long pos;
+    for (pos = buffer->readPos; pos != writePos; pos++)
+    {
+        const Event& event = buffer->events[pos & (BufferSize - 1)];
+        Zone* zone = this->zones[event.zoneIndex];
+        if (Begin == event.type)
+        {
+            if (buffer->depth < MaxDepth)
+            {
+                if (-2 == zone->parentIndex)
+                {
+                    zone->parentIndex = (buffer->depth > 0) ? buffer->stack[buffer->depth - 1].zoneIndex : -1;
+                }
+                StackEntry& entry = buffer->stack[buffer->depth++];
+                entry.zoneIndex = event.zoneIndex;
+                entry.startTicks = event.ticks;
+                entry.childTicks = 0;
+                entry.captured = this->isCapturing;
+                if (entry.captured)
+                {
+                    this->AddCaptureEvent(event.ticks, event.zoneIndex, threadIndex, Begin);
+                }
+            }
+        }
+        else
+        {
+            int depth = buffer->depth;
+            while ((--depth >= 0) && (buffer->stack[depth].zoneIndex != event.zoneIndex));
+            if (depth >= 0)
+            {
+                // close the discarded zones in the capture
+                int i;
+                for (i = buffer->depth - 1; i >= depth; i--)
+                {
+                    if (buffer->stack[i].captured)
+                    {
+                        this->AddCaptureEvent(event.ticks, buffer->stack[i].zoneIndex, threadIndex, End);
+                    }
+                }
+                const StackEntry& entry = buffer->stack[depth];
+                uint64 ticks = event.ticks - entry.startTicks;
+                zone->frameTicks += ticks;
+                zone->frameSelfTicks += ticks - n_min(ticks, entry.childTicks);
+                zone->frameCount++;
+                if (depth > 0)
+                {
+                    buffer->stack[depth - 1].childTicks += ticks;
+                }
+                buffer->depth = depth;
+            }
+        }
+    }
+
+    n_interlocked_exchange(&buffer->readPos, writePos);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Convert the accumulated ticks of the zones into the frame statistics,
+    and update the watcher variables.
+*/
+void
+nProfileServer::PublishZones()
+{
+    double msPerTick = 1000.0 / this->ticksPerSecond;
+    int numZones = n_interlocked_read(&this->numZones);
+    int historyIndex = this->frameCount % HistorySize;
+    int i;
+    for (i = 0; i < numZones; i++)
+    {
+        Zone* zone = this->zones[i];
+        zone->time = float(double(zone->frameTicks) * msPerTick);
+        zone->selfTime = float(double(zone->frameSelfTicks) * msPerTick);
+        zone->count = zone->frameCount;
+        zone->history[historyIndex] = zone->time;
+        zone->frameTicks = 0;
+        zone->frameSelfTicks = 0;
+        zone->frameCount = 0;
+
+        if ((zone->count > 0) && !zone->refEnv.isvalid())
+        {
+            char buf[N_MAXPATH];
+            snprintf(buf, sizeof(buf), "/sys/var/%s", zone->name.Get());
+            nKernelServer* kernelServer = nKernelServer::Instance();
+            zone->refEnv = (nEnv*) kernelServer->Lookup(buf);
+            if (!zone->refEnv.isvalid())
+            {
+                zone->refEnv = (nEnv*) kernelServer->New("nenv", buf);
+            }
+        }
+        if (zone->refEnv.isvalid())
+        {
+            zone->refEnv->SetF(zone->time);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Finish a frame: collect the events of all threads, free the buffers
+    of exited threads, compute the zone statistics and handle a requested
+    capture.
+*/
+void
+nProfileServer::NextFrame()
+{
+    uint64 ticks = GetTicks();
+    this->Calibrate(ticks);
+
+    int numThreads = n_interlocked_read(&this->numThreads);
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        long state = n_interlocked_read(&this->threads[i]->state);
+        if (Free != state)
+        {
+            this->ReadEvents(i);
+            if (Exited == state)
+            {
+                this->FreeThreadBuffer(i, ticks);
+            }
+        }
+    }
+    this->PublishZones();
+
+    if (this->isCapturing)
+    {
+        if (--this->captureFramesLeft > 0)
+        {
+            this->AddCaptureEvent(ticks, this->frameCount + 1, 0, Frame);
+        }
+        else
+        {
+            this->EndCapture(ticks);
+        }
+    }
+    else if (this->captureRequested)
+    {
+        this->captureRequested = false;
+        this->isCapturing = true;
+        this->captureStartTicks = ticks;
+        this->captureEvents.Reset();
+        this->AddCaptureEvent(ticks, this->frameCount + 1, 0, Frame);
+    }
+    this->frameCount++;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Start a capture with the next frame. The trace file is written after
+    numFrames frames, the capture is ignored if another capture is in
+    progress.
+
+    @param  filename    path of the trace file (.json)
+    @param  numFrames   number of frames to capture
+    @return             false if a capture is already in progress
+*/
+bool
+nProfileServer::BeginCapture(const char* filename, int numFrames)
+{
+    n_assert(filename);
+    n_assert(numFrames > 0);
+    if (this->IsCapturing())
+    {
+        return false;
+    }
+    this->captureFileName = filename;
+    this->captureFramesLeft = numFrames;
+    this->captureRequested = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nProfileServer::AddCaptureEvent(uint64 ticks, int zoneIndex, int threadIndex, int type)
+{
+    CaptureEvent event;
+    event.ticks = ticks;
+    event.zoneIndex = zoneIndex;
+    event.threadIndex = short(threadIndex);
+    event.type = short(type);
+    this->captureEvents.Append(event);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Append a string to a JSON file as a quoted and escaped JSON string.
+*/
+static
+void
+WriteJsonString(nFile* file, const char* str)
+{
+    char buf[N_MAXPATH];
+    int len = 0;
+    buf[len++] = '"';
+    const char* ptr;
+    for (ptr = str; *ptr && (len < (N_MAXPATH - 8)); ptr++)
+    {
+        uchar c = (uchar) *ptr;
+        if (('"' == c) || ('\\' == c))
+        {
+            buf[len++] = '\\';
+            buf[len++] = c;
+        }
+        else if (c < 0x20)
+        {
+            len += snprintf(buf + len, 7, "\\u%04x", c);
+        }
+        else
+        {
+            buf[len++] = c;
+        }
+    }
+    buf[len++] = '"';
+    file->Write(buf, len);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Close the zones which are still open, and write the captured events
+    as Chrome trace event JSON. Times are written in microseconds relative
+    to the start of the capture, the thread index is the trace thread id.
+*/
+void
+nProfileServer::EndCapture(uint64 ticks)
+{
+    this->isCapturing = false;
+    int threadIndex;
+    for (threadIndex = 0; threadIndex < this->numThreads; threadIndex++)
+    {
+        ThreadBuffer* buffer = this->threads[threadIndex];
+        int i;
+        for (i = buffer->depth - 1; i >= 0; i--)
+        {
+            if (buffer->stack[i].captured)
+            {
+                this->AddCaptureEvent(ticks, buffer->stack[i].zoneIndex, threadIndex, End);
+                buffer->stack[i].captured = false;
+            }
+        }
+    }
+
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    n_assert(file);
+    if (!file->Open(this->captureFileName, "w"))
+    {
+        n_printf("nProfileServer: could not open trace file '%s'!\n", this->captureFileName.Get());
+        file->Release();
+        this->captureEvents.Reset();
+        return;
+    }
+
+    // every record but the first is preceded by a separator
+    char buf[N_MAXPATH];
+    int len;
+    const char* separator = "\n";
+    file->PutS("{\"traceEvents\":[");
+    for (threadIndex = 0; threadIndex < this->numThreads; threadIndex++)
+    {
+        len = snprintf(buf, sizeof(buf), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                       separator, threadIndex);
+        file->Write(buf, len);
+        WriteJsonString(file, this->threads[threadIndex]->name.Get());
+        file->PutS("}}");
+        separator = ",\n";
+    }
+
+    double usPerTick = 1000000.0 / this->ticksPerSecond;
+    int numEvents = this->captureEvents.Size();
+    int i;
+    for (i = 0; i < numEvents; i++)
+    {
+        const CaptureEvent& event = this->captureEvents[i];
+        double ts = double(int64(event.ticks - this->captureStartTicks)) * usPerTick;
+        if (Frame == event.type)
+        {
+            len = snprintf(buf, sizeof(buf), "%s{\"name\":\"Frame %d\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                           separator, event.zoneIndex, ts);
+            file->Write(buf, len);
+        }
+        else
+        {
+            len = snprintf(buf, sizeof(buf), "%s{\"name\":", separator);
+            file->Write(buf, len);
+            WriteJsonString(file, this->zones[event.zoneIndex]->name.Get());
+            len = snprintf(buf, sizeof(buf), ",\"cat\":\"nebula\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                           (Begin == event.type) ? "B" : "E", ts, event.threadIndex);
+            file->Write(buf, len);
+        }
+    }
+    file->PutS("\n],\n\"displayTimeUnit\":\"ms\"}\n");
+    file->Close();
+    file->Release();
+
+    n_printf("nProfileServer: wrote %d events to '%s'\n", numEvents, this->captureFileName.Get());
+    this->captureEvents.Reset();
+}
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -10,6 +10,8 @@
 
 nNebulaScriptClass(nRoot, "nobject");
 
+volatile long nRoot::nohGeneration = 0;
+
 //------------------------------------------------------------------------------
 /**
      - 08-Oct-98   floh    created
@@ -18,7 +20,10 @@ nNebulaScriptClass(nRoot, "nobject");
      - 02-May-00   floh    + parse file name
 */
 nRoot::nRoot() :
+    nameHash(nRootChildIndex::HashName("")),
     parent(0),
+    numChildren(0),
+    childIndex(0),
     saveModeFlags(0)
 {
     // empty
@@ -49,6 +54,29 @@ nRoot::~nRoot()
     {
         this->Remove();
     }
+
+    if (this->childIndex)
+    {
+        n_delete(this->childIndex);
+        this->childIndex = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create the child name index, called by Find() once the object has
+    enough children.
+*/
+void
+nRoot::BuildChildIndex()
+{
+    n_assert(0 == this->childIndex);
+    this->childIndex = n_new(nRootChildIndex);
+    nRoot* child;
+    for (child = this->GetHead(); child; child = child->GetSucc())
+    {
+        this->childIndex->Add(child);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,144 @@
+//------------------------------------------------------------------------------
+//  nrootchildindex.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nrootchildindex.h"
+#include "kernel/nroot.h"
+
+// marks a slot whose entry has been removed
+static nRoot* const Deleted = (nRoot*) 1;
+
+//------------------------------------------------------------------------------
+/**
+*/
+nRootChildIndex::nRootChildIndex() :
+    slots(0),
+    capacity(0),
+    numEntries(0),
+    numDeleted(0)
+{
+    this->Rehash(64);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nRootChildIndex::~nRootChildIndex()
+{
+    n_delete_array(this->slots);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Move all entries into a new table, this also gets rid of the deleted
+    slots.
+*/
+void
+nRootChildIndex::Rehash(int newCapacity)
+{
+    Slot* oldSlots = this->slots;
+    int oldCapacity = this->capacity;
+
+    this->slots = n_new_array(Slot, newCapacity);
+    this->capacity = newCapacity;
+    this->numEntries = 0;
+    this->numDeleted = 0;
+    int i;
+    for (i = 0; i < newCapacity; i++)
+    {
+        this->slots[i].hash = 0;
+        this->slots[i].object = 0;
+    }
+    for (i = 0; i < oldCapacity; i++)
+    {
+        nRoot* object = oldSlots[i].object;
+        if (object && (object != Deleted))
+        {
+            this->Add(object);
+        }
+    }
+    if (oldSlots)
+    {
+        n_delete_array(oldSlots);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The table is kept at most half full (including deleted slots), so that
+    probe sequences stay short.
+*/
+void
+nRootChildIndex::Add(nRoot* child)
+{
+    n_assert(child);
+    if ((this->numEntries + this->numDeleted + 1) * 2 > this->capacity)
+    {
+        int newCapacity = this->capacity;
+        while ((this->numEntries + 1) * 2 > newCapacity / 2)
+        {
+            newCapacity *= 2;
+        }
+        this->Rehash(newCapacity);
+    }
+
+    uint hash = child->GetNameHash();
+    int mask = this->capacity - 1;
+    int i = hash & mask;
+    while (this->slots[i].object && (this->slots[i].object != Deleted))
+    {
+        i = (i + 1) & mask;
+    }
+    if (this->slots[i].object == Deleted)
+    {
+        this->numDeleted--;
+    }
+    this->slots[i].hash = hash;
+    this->slots[i].object = child;
+    this->numEntries++;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nRootChildIndex::Remove(nRoot* child)
+{
+    n_assert(child);
+    uint hash = child->GetNameHash();
+    int mask = this->capacity - 1;
+    int i = hash & mask;
+    while (this->slots[i].object)
+    {
+        if (this->slots[i].object == child)
+        {
+            this->slots[i].object = Deleted;
+            this->numEntries--;
+            this->numDeleted++;
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    n_error("nRootChildIndex::Remove(): object '%s' not in index!", child->GetName());
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nRoot*
+nRootChildIndex::Find(const char* name, uint hash) const
+{
+    n_assert(name);
+    int mask = this->capacity - 1;
+    int i = hash & mask;
+    while (this->slots[i].object)
+    {
+        const Slot& slot = this->slots[i];
+        if ((slot.hash == hash) && (slot.object != Deleted) && (0 == strcmp(slot.object->GetName(), name)))
+        {
+            return slot.object;
+        }
+        i = (i + 1) & mask;
+    }
+    return 0;
+}
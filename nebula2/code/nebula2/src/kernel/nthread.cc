@@ -4,6 +4,8 @@
 //------------------------------------------------------------------------------
 #include "kernel/ntypes.h"
 #include "kernel/nthread.h"
+#include "kernel/nprofileserver.h"
+#include "kernel/ninterlocked.h"
 
 //------------------------------------------------------------------------------
 /**
@@ -39,7 +41,7 @@ nThread::nThread(int (N_THREADPROC* _thread_func)(nThread*),
     this->threadFunc = _thread_func;
     this->wakeupFunc = _wakeup_func;
     this->userData   = _user_data;
-    this->stopThread = false;
+    this->stopThread = 0;
     this->shutdownSignalReceived = false;
 
     // launch thread
@@ -124,7 +126,7 @@ nThread::~nThread()
     // ask thread func to stop, if a wakeup func is defined
     // call it, so that the thread can be signaled to wake up
     // in order to know that it should terminate
-    this->stopThread = true;
+    n_interlocked_exchange(&this->stopThread, 1);
     if (this->wakeupFunc)
     {
         this->wakeupFunc(this);
@@ -175,6 +177,12 @@ nThread::ThreadHarakiri()
     // synchronize with destructor
     this->shutdownEvent.Wait();
     this->shutdownSignalReceived = true;
+    // release the thread's profiling buffer
+    nProfileServer::ThreadExit();
+#   ifdef __NEBULA_MEM_MANAGER__
+    // hand the thread's memory cache over to the next thread
+    n_memthreadexit();
+#   endif
 #   ifdef __WIN32__
 //    _endthreadex(0);
 #   else
@@ -205,7 +213,7 @@ bool
 nThread::ThreadStopRequested()
 {
 #ifndef __NEBULA_NO_THREADS__
-    return this->stopThread;
+    return (0 != n_interlocked_read(&this->stopThread));
 #else
     return true;
 #endif
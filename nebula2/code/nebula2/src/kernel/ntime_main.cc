@@ -4,6 +4,8 @@
 //------------------------------------------------------------------------------
 #include "kernel/ntimeserver.h"
 #include "kernel/nkernelserver.h"
+#include "kernel/nprofileserver.h"
+#include "kernel/nframearena.h"
 
 #if defined(__LINUX__) || defined(__MACOSX__)
 #define N_MICROSEC_INT    (1000000)
@@ -238,10 +240,16 @@ nTimeServer::GetWaitDeltaT()
 
 //------------------------------------------------------------------------------
 /**
+    Must be called once per frame by the application's frame loop on the
+    main thread. Also finishes the profiling zones of the last frame, and
+    recycles the frame allocated memory of the frame before the last.
 */
 void
 nTimeServer::Trigger()
 {
+    nProfileServer::Instance()->NextFrame();
+    nFrameArena::Instance()->NextFrame();
+
     if (this->lock_delta_t > 0.0)
     {
         if (!this->stopped)
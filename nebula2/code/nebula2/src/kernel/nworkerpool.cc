@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+//  nworkerpool.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nworkerpool.h"
+
+nWorkerPool* nWorkerPool::Singleton = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+nWorkerPool::nWorkerPool() :
+    isRunning(false),
+    taskFunc(0),
+    taskUserData(0)
+{
+    n_assert(0 == Singleton);
+    Singleton = this;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nWorkerPool::~nWorkerPool()
+{
+    n_assert(!this->isRunning);
+    n_assert(Singleton);
+    Singleton = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Every job executes a single task, so that the tasks are balanced by
+    work stealing.
+*/
+void
+nWorkerPool::RunJob(int begin, int end, void* userData)
+{
+    nWorkerPool* self = (nWorkerPool*) userData;
+    int workerIndex = nJobServer::GetWorkerIndex();
+    int taskIndex;
+    for (taskIndex = begin; taskIndex < end; taskIndex++)
+    {
+        self->taskFunc(taskIndex, workerIndex, self->taskUserData);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Execute numTasks tasks on the worker threads and the calling thread.
+    Returns when all tasks have been executed.
+*/
+void
+nWorkerPool::Run(int numTasks, TaskFunc func, void* userData)
+{
+    n_assert(func);
+    n_assert2(!this->isRunning, "nWorkerPool::Run() is not reentrant!");
+    n_assert2(0 == nJobServer::GetWorkerIndex(), "nWorkerPool::Run() must be called by the main thread!");
+    if (numTasks <= 0)
+    {
+        return;
+    }
+    this->isRunning = true;
+    this->taskFunc = func;
+    this->taskUserData = userData;
+
+    nJobServer::Instance()->ParallelFor(0, numTasks, 1, RunJob, this);
+
+    this->taskFunc = 0;
+    this->taskUserData = 0;
+    this->isRunning = false;
+}
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
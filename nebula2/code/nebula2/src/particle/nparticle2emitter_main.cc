@@ -12,6 +12,8 @@
 nParticle2Emitter::nParticle2Emitter() :
     pStaticCurves(0),
     emitterMeshGroupIndex(0),
+    emitterVertices(0),
+    emitterIndices(0),
     lastEmissionVertex(0),
     startTime(-1.0),
     lastEmission(0),
@@ -38,7 +40,6 @@ nParticle2Emitter::nParticle2Emitter() :
     particleVelocityRandomize(0.0f),
     particleRotationRandomize(0.0f),
     particleSizeRandomize(0.0f),
-    particles(0),
     particleCount(0),
     maxParticleCount(0),
     remainingTime(0.0),
@@ -66,7 +67,7 @@ nParticle2Emitter::AllocateParticles()
 {
     n_assert(this->maxParticleCount > 0);
     this->DeleteParticles();
-    this->particles = n_new_array(nParticle2, this->maxParticleCount);
+    this->particles.Allocate(this->maxParticleCount);
     this->particleCount = 0;
 }
 
@@ -77,85 +78,13 @@ nParticle2Emitter::AllocateParticles()
 void
 nParticle2Emitter::DeleteParticles()
 {
-    if (this->particles)
+    if (this->particles.IsValid())
     {
-        n_delete_array(this->particles);
-        this->particles = 0;
+        this->particles.Release();
         this->particleCount = 0;
     }
 }
 
-//------------------------------------------------------------------------------
-/**
-    Updates the existing particles.
-*/
-void
-nParticle2Emitter::CalculateStep(float stepTime)
-{
-    n_assert(stepTime >= 0.0f);
-    n_assert(0 != this->particles);
-    n_assert(0 != this->pStaticCurves);
-
-    // nothing to do?
-    if (0 == this->particleCount)
-    {
-        return;
-    }
-
-    vector3 windVector = vector3(this->wind.x, this->wind.y, this->wind.z) * wind.w;
-    vector3 acc, freeAcc, boundMin, boundMax;
-    this->box.begin_extend();
-
-    nParticle2* particleSource = this->particles;
-    nParticle2* particle = this->particles;
-    int particleIndex;
-    for (particleIndex = 0; particleIndex < this->particleCount; particleIndex++)
-    {
-        // FIXME: hmm, this removes dead particles from the array,
-        // the copy operation sucks though...
-        if (particle != particleSource)
-        {
-            *particle = *particleSource;
-        }
-
-        // update times
-        particle->lifeTime += stepTime;
-        float relParticleAge = particle->lifeTime * particle->oneDivMaxLifeTime;
-        if ((relParticleAge >= 0.0f) && (relParticleAge < 1.0f))
-        {
-            // get pointer to anim curves
-            int curveIndex = int(relParticleAge * float(ParticleTimeDetail));
-            curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
-            float* curCurves = &this->pStaticCurves[curveIndex * CurveTypeCount];
-
-            // compute acceleration vector
-            acc = windVector * curCurves[ParticleAirResistance];
-            acc.y += this->gravity;
-            acc *= curCurves[ParticleMass];
-
-            // update particle
-            particle->acc = acc;
-            particle->position += particle->velocity * (stepTime * curCurves[ParticleVelocityFactor]);
-            particle->velocity += acc * stepTime;
-            particle->rotation += curCurves[ParticleRotationVelocity] * particle->rotationVariation * stepTime;
-
-            // update boundary values
-            this->box.extend(particle->position);
-
-            // advance to next particle
-            particle++;
-        }
-        else
-        {
-            // particle's lifetime is over
-            // don't advance particle pointer
-            this->particleCount--;
-            particleIndex--;
-        }
-        particleSource++;
-    }
-}
-
 //------------------------------------------------------------------------------
 /**
     Checks if the particle system should go to sleep because it is
@@ -275,9 +204,15 @@ nParticle2Emitter::Update(float curTime)
                 int curveIndex = int(relAge * ParticleTimeDetail);
                 curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
                 float* curCurves = &this->pStaticCurves[curveIndex * CurveTypeCount];
-                float* vertices = this->refEmitterMesh->LockVertices();
+                float* vertices = this->emitterVertices;
+                ushort* indices = this->emitterIndices;
+                bool lockMesh = (0 == vertices);
+                if (lockMesh)
+                {
+                    vertices = this->refEmitterMesh->LockVertices();
+                    indices = this->refEmitterMesh->LockIndices();
+                }
                 int vertexWidth = this->refEmitterMesh->GetVertexWidth();
-                ushort* indices = this->refEmitterMesh->LockIndices();
                 const nMeshGroup& meshGroup = this->refEmitterMesh->Group(this->emitterMeshGroupIndex);
                 int firstIndex  = meshGroup.GetFirstIndex();
                 int numIndices = meshGroup.GetNumIndices();
@@ -304,18 +239,17 @@ nParticle2Emitter::Update(float curTime)
                         if (this->particleCount < this->maxParticleCount)
                         {
                             // emit a new particle
-                            nParticle2* newParticle = &this->particles[this->particleCount];
-                            this->particleCount++;
+                            nParticle2 newParticle;
 
                             if (this->emitOnSurface)
                             {
-                                int faceIndex = int(n_rand(0.0f, numIndices / 3 - TINY));
+                                int faceIndex = int(this->random.Rand(0.0f, numIndices / 3 - TINY));
                                 n_assert(faceIndex * 3 + 2 < numIndices);
 
                                 // combine 2 triangles into a parallelogram
                                 // get 2 randomized lerp value
-                                float lerp0 = n_rand();
-                                float lerp1 = n_rand();
+                                float lerp0 = this->random.Rand();
+                                float lerp1 = this->random.Rand();
                                 if (lerp1 + lerp0 > 1)
                                 {
                                     // the position is in the other side of the parallelogram
@@ -347,7 +281,7 @@ nParticle2Emitter::Update(float curTime)
                             else
                             {
                                 // get emission position
-                                int indexIndex = firstIndex + int(n_rand(0.0f, float(numIndices - 1)));
+                                int indexIndex = firstIndex + int(this->random.Rand(0.0f, float(numIndices - 1)));
                                 float* vertexPtr = &(vertices[indices[indexIndex] * vertexWidth]);
                                 emissionPos.set(vertexPtr[0], vertexPtr[1], vertexPtr[2]);
                                 emissionPos = this->transform * emissionPos;
@@ -365,45 +299,52 @@ nParticle2Emitter::Update(float curTime)
                             float spreadMin = curCurves[ParticleSpreadMin];
                             float spreadMax = curCurves[ParticleSpreadMax];
                             spreadMin = n_min(spreadMin, spreadMax);
-                            float spread = n_lerp(spreadMin, spreadMax, n_rand());
-                            float rotRandom = n_rand() * 360.0f;
+                            float spread = n_lerp(spreadMin, spreadMax, this->random.Rand());
+                            float rotRandom = this->random.Rand() * 360.0f;
                             emissionNormal.rotate(ortho1, n_deg2rad(spread));
                             emissionNormal.rotate(normBackup, n_deg2rad(rotRandom));
 
-                            float velocityVariation = 1.0f - n_rand(0.0f, this->particleVelocityRandomize);
+                            float velocityVariation = 1.0f - this->random.Rand(0.0f, this->particleVelocityRandomize);
                             float startVelocity = curCurves[ParticleStartVelocity] * velocityVariation;
 
                             // apply texture tiling
                             // uvmax and uvmin are arranged a bit strange, because they need to be flipped
                             // horizontally and be rotated
                             float vStep = 1.0f / float(this->tileTexture);
-                            int tileNr = int(n_rand(0.0f, float(this->tileTexture)));
-
-                            newParticle->uvmin.set(1.0f, vStep * float(tileNr));
-                            newParticle->uvmax.set(0.0f, newParticle->uvmin.y + vStep);
-                            newParticle->lifeTime = particleEmissionLifeTime;
-                            newParticle->oneDivMaxLifeTime = oneDivLifeTime;
-                            newParticle->position = emissionPos;
-                            newParticle->rotation = n_lerp(this->startRotationMin, this->startRotationMax, n_rand());
-                            newParticle->rotationVariation = 1.0f - n_rand() * this->particleRotationRandomize;
-                            if (this->randomRotDir && (n_rand() < 0.5f))
+                            int tileNr = int(this->random.Rand(0.0f, float(this->tileTexture)));
+
+                            newParticle.uvmin.set(1.0f, vStep * float(tileNr));
+                            newParticle.uvmax.set(0.0f, newParticle.uvmin.y + vStep);
+                            newParticle.lifeTime = particleEmissionLifeTime;
+                            newParticle.oneDivMaxLifeTime = oneDivLifeTime;
+                            newParticle.position = emissionPos;
+                            newParticle.rotation = n_lerp(this->startRotationMin, this->startRotationMax, this->random.Rand());
+                            newParticle.rotationVariation = 1.0f - this->random.Rand() * this->particleRotationRandomize;
+                            if (this->randomRotDir && (this->random.Rand() < 0.5f))
                             {
-                                newParticle->rotationVariation = -newParticle->rotationVariation;
+                                newParticle.rotationVariation = -newParticle.rotationVariation;
                             }
-                            newParticle->velocity = emissionNormal * startVelocity;
-                            newParticle->startPos = newParticle->position;
-                            newParticle->sizeVariation = 1.0f - n_rand() * this->particleSizeRandomize;
+                            newParticle.velocity = emissionNormal * startVelocity;
+                            newParticle.startPos = newParticle.position;
+                            newParticle.sizeVariation = 1.0f - this->random.Rand() * this->particleSizeRandomize;
 
                             // add velocity*lifetime
                             // FIXME FLOH: why this??
-                            newParticle->position += newParticle->velocity * newParticle->lifeTime;
+                            newParticle.position += newParticle.velocity * newParticle.lifeTime;
+
+                            this->particles.Set(this->particleCount, newParticle);
+                            this->SampleParticleCurves(this->particleCount, 1);
+                            this->particleCount++;
                         }
                         timeToDo -= emitTimeStep;
                     }
                 }
                 this->remainingTime = timeToDo;
-                this->refEmitterMesh->UnlockVertices();
-                this->refEmitterMesh->UnlockIndices();
+                if (lockMesh)
+                {
+                    this->refEmitterMesh->UnlockVertices();
+                    this->refEmitterMesh->UnlockIndices();
+                }
             }
         }
         else
@@ -428,24 +369,32 @@ nParticle2Emitter::Update(float curTime)
 */
 int nParticle2Emitter::RenderPure(float* dstVertices,int maxVertices)
 {
-    int curIndex  = 0;
     int curVertex = 0;
     tParticleVertex myVertex;
 
-    nParticle2* particle = this->particles;
+    const float* posX = this->particles.GetStream(nParticle2Pool::PosX);
+    const float* posY = this->particles.GetStream(nParticle2Pool::PosY);
+    const float* posZ = this->particles.GetStream(nParticle2Pool::PosZ);
+    const float* rotation = this->particles.GetStream(nParticle2Pool::Rotation);
+    const float* uvMinX = this->particles.GetStream(nParticle2Pool::UvMinX);
+    const float* uvMinY = this->particles.GetStream(nParticle2Pool::UvMinY);
+    const float* uvMaxX = this->particles.GetStream(nParticle2Pool::UvMaxX);
+    const float* uvMaxY = this->particles.GetStream(nParticle2Pool::UvMaxY);
+    const float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    const float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    const float* color = this->particles.GetStream(nParticle2Pool::Color);
+
     int particlePitch = 1;
+    int particleOffset = 0;
     if (this->renderOldestFirst)
     {
         // reverse iterating order
         particlePitch = -1;
-        particle = &this->particles[particleCount -1];
+        particleOffset = particleCount -1;
     };
 
     tParticleVertex*    destPtr = (tParticleVertex*)dstVertices;
 
-    int curveIndex;
-    float* curCurves;
-
     const matrix44& viewer = nGfxServer2::Instance()->GetTransform(nGfxServer2::InvView);
     myVertex.vel = viewer.x_component();
 
@@ -453,34 +402,32 @@ int nParticle2Emitter::RenderPure(float* dstVertices,int maxVertices)
     for (p = 0; p < particleCount ; p++)
     {
         // life-time-check is not needed, it is assured that the relative age is >=0 and <1
-        curveIndex = (int)((particle->lifeTime * particle->oneDivMaxLifeTime) * (float)ParticleTimeDetail);
-        curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
-        curCurves = &this->pStaticCurves[curveIndex*CurveTypeCount];
-
-        myVertex.pos = particle->position;
-        myVertex.scale = curCurves[ParticleScale]*particle->sizeVariation;
-        myVertex.color = curCurves[StaticRGBCurve];
-
-        myVertex.u = particle->uvmax.x;
-        myVertex.v = particle->uvmin.y;
-        myVertex.rotation = particle->rotation+PI/4.0f + PI/2.0f;
-        myVertex.alpha = curCurves[ParticleAlpha];
+        // curve values have been sampled by CalculateStep()
+        int i = particleOffset;
+        myVertex.pos.set(posX[i], posY[i], posZ[i]);
+        myVertex.scale = scale[i];
+        myVertex.color = color[i];
+
+        myVertex.u = uvMaxX[i];
+        myVertex.v = uvMinY[i];
+        myVertex.rotation = rotation[i]+PI/4.0f + PI/2.0f;
+        myVertex.alpha = alpha[i];
         destPtr[0] = myVertex;
         destPtr[3] = myVertex;
 
-        myVertex.u = particle->uvmax.x;
-        myVertex.v = particle->uvmax.y;
+        myVertex.u = uvMaxX[i];
+        myVertex.v = uvMaxY[i];
         myVertex.rotation += PI/2.0;
         destPtr[1] = myVertex;
 
-        myVertex.u = particle->uvmin.x;
-        myVertex.v = particle->uvmax.y;
+        myVertex.u = uvMinX[i];
+        myVertex.v = uvMaxY[i];
         myVertex.rotation += PI/2.0;
         destPtr[2] = myVertex;
         destPtr[4] = myVertex;
 
-        myVertex.u = particle->uvmin.x;
-        myVertex.v = particle->uvmin.y;
+        myVertex.u = uvMinX[i];
+        myVertex.v = uvMinY[i];
         myVertex.rotation += PI/2.0;
         destPtr[5] = myVertex;
 
@@ -495,7 +442,7 @@ int nParticle2Emitter::RenderPure(float* dstVertices,int maxVertices)
             curVertex = 0;
         }
 
-        particle += particlePitch;
+        particleOffset += particlePitch;
     }
 
     return curVertex;
@@ -512,6 +459,28 @@ int nParticle2Emitter::RenderStretched(float* dstVertices,int maxVertices)
     int curVertex = 0;
     tParticleVertex myVertex;
 
+    const float* posX = this->particles.GetStream(nParticle2Pool::PosX);
+    const float* posY = this->particles.GetStream(nParticle2Pool::PosY);
+    const float* posZ = this->particles.GetStream(nParticle2Pool::PosZ);
+    const float* velX = this->particles.GetStream(nParticle2Pool::VelX);
+    const float* velY = this->particles.GetStream(nParticle2Pool::VelY);
+    const float* velZ = this->particles.GetStream(nParticle2Pool::VelZ);
+    const float* accX = this->particles.GetStream(nParticle2Pool::AccX);
+    const float* accY = this->particles.GetStream(nParticle2Pool::AccY);
+    const float* accZ = this->particles.GetStream(nParticle2Pool::AccZ);
+    const float* startX = this->particles.GetStream(nParticle2Pool::StartX);
+    const float* startY = this->particles.GetStream(nParticle2Pool::StartY);
+    const float* startZ = this->particles.GetStream(nParticle2Pool::StartZ);
+    const float* lifeTime = this->particles.GetStream(nParticle2Pool::LifeTime);
+    const float* uvMinX = this->particles.GetStream(nParticle2Pool::UvMinX);
+    const float* uvMinY = this->particles.GetStream(nParticle2Pool::UvMinY);
+    const float* uvMaxX = this->particles.GetStream(nParticle2Pool::UvMaxX);
+    const float* uvMaxY = this->particles.GetStream(nParticle2Pool::UvMaxY);
+    const float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    const float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    const float* color = this->particles.GetStream(nParticle2Pool::Color);
+    const float* velocityFactor = this->particles.GetStream(nParticle2Pool::VelocityFactor);
+
     int particlePitch = 1;
     int particleOffset = 0;
     if (this->renderOldestFirst)
@@ -527,54 +496,56 @@ int nParticle2Emitter::RenderStretched(float* dstVertices,int maxVertices)
     tParticleVertex*    destPtr = (tParticleVertex*)dstVertices;
 
     // ok, let's stretch
-    vector3 stretchPos;
+    vector3 position, stretchPos;
     int p;
     for (p = 0; p < particleCount ; p++)
     {
-        nParticle2* particle = &particles[particleOffset];
-        float relParticleAge = particle->lifeTime * particle->oneDivMaxLifeTime;
-        int curveIndex = (int)(relParticleAge * (float)ParticleTimeDetail);
-        curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
-        float* curCurves = &this->pStaticCurves[curveIndex*CurveTypeCount];
-
         // life-time-check is not needed, it is assured that the relative age is >=0 and <1
+        int i = particleOffset;
+        position.set(posX[i], posY[i], posZ[i]);
 
         float stretchTime = this->particleStretch;
-        if (stretchTime>particle->lifeTime) stretchTime = particle->lifeTime;
-        stretchPos = particle->position - (particle->velocity-particle->acc*(stretchTime*0.5f)) * (stretchTime*curCurves[ParticleVelocityFactor]);
-        if (this->stretchToStart) stretchPos = particle->startPos;
-
-        float alpha = curCurves[ParticleAlpha] + viewFadeOut;
+        if (stretchTime>lifeTime[i]) stretchTime = lifeTime[i];
+        if (this->stretchToStart)
+        {
+            stretchPos.set(startX[i], startY[i], startZ[i]);
+        }
+        else
+        {
+            vector3 velocity(velX[i], velY[i], velZ[i]);
+            vector3 acc(accX[i], accY[i], accZ[i]);
+            stretchPos = position - (velocity-acc*(stretchTime*0.5f)) * (stretchTime*velocityFactor[i]);
+        }
 
-        myVertex.pos = particle->position;
-        myVertex.scale = curCurves[ParticleScale]*particle->sizeVariation;
-        myVertex.color = curCurves[StaticRGBCurve];
-        myVertex.vel = particle->position - stretchPos;
+        myVertex.pos = position;
+        myVertex.scale = scale[i];
+        myVertex.color = color[i];
+        myVertex.vel = position - stretchPos;
 
-        myVertex.u = particle->uvmax.x;
-        myVertex.v = particle->uvmin.y;
+        myVertex.u = uvMaxX[i];
+        myVertex.v = uvMinY[i];
         myVertex.rotation = PI/4.0;
-        myVertex.alpha = alpha;
+        myVertex.alpha = alpha[i] + viewFadeOut;
         destPtr[0] = myVertex;
         destPtr[3] = myVertex;
 
-        myVertex.u = particle->uvmax.x;
-        myVertex.v = particle->uvmax.y;
+        myVertex.u = uvMaxX[i];
+        myVertex.v = uvMaxY[i];
         myVertex.rotation += PI/2.0;
         myVertex.pos = stretchPos;
         destPtr[1] = myVertex;
 
 
-        myVertex.u = particle->uvmin.x;
-        myVertex.v = particle->uvmax.y;
+        myVertex.u = uvMinX[i];
+        myVertex.v = uvMaxY[i];
         myVertex.rotation += PI/2.0;
         destPtr[2] = myVertex;
         destPtr[4] = myVertex;
 
-        myVertex.u = particle->uvmin.x;
-        myVertex.v = particle->uvmin.y;
+        myVertex.u = uvMinX[i];
+        myVertex.v = uvMinY[i];
         myVertex.rotation += PI/2.0f;
-        myVertex.pos = particle->position;
+        myVertex.pos = position;
         destPtr[5] = myVertex;
 
         curVertex += 6;
@@ -603,6 +574,25 @@ int nParticle2Emitter::RenderStretchedSmooth(float* dstVertices,int maxVertices)
     int curVertex = 0;
     tParticleVertex myVertex;
 
+    const float* posX = this->particles.GetStream(nParticle2Pool::PosX);
+    const float* posY = this->particles.GetStream(nParticle2Pool::PosY);
+    const float* posZ = this->particles.GetStream(nParticle2Pool::PosZ);
+    const float* velX = this->particles.GetStream(nParticle2Pool::VelX);
+    const float* velY = this->particles.GetStream(nParticle2Pool::VelY);
+    const float* velZ = this->particles.GetStream(nParticle2Pool::VelZ);
+    const float* accX = this->particles.GetStream(nParticle2Pool::AccX);
+    const float* accY = this->particles.GetStream(nParticle2Pool::AccY);
+    const float* accZ = this->particles.GetStream(nParticle2Pool::AccZ);
+    const float* lifeTime = this->particles.GetStream(nParticle2Pool::LifeTime);
+    const float* uvMinX = this->particles.GetStream(nParticle2Pool::UvMinX);
+    const float* uvMinY = this->particles.GetStream(nParticle2Pool::UvMinY);
+    const float* uvMaxX = this->particles.GetStream(nParticle2Pool::UvMaxX);
+    const float* uvMaxY = this->particles.GetStream(nParticle2Pool::UvMaxY);
+    const float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    const float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    const float* color = this->particles.GetStream(nParticle2Pool::Color);
+    const float* velocityFactor = this->particles.GetStream(nParticle2Pool::VelocityFactor);
+
     int particlePitch = 1;
     int particleOffset = 0;
     if (this->renderOldestFirst)
@@ -615,7 +605,6 @@ int nParticle2Emitter::RenderStretchedSmooth(float* dstVertices,int maxVertices)
     float oneDivStretchDetail = 1.0f / (float)this->stretchDetail;
 
     // ok, let's stretch
-    vector3 stretchPos;
     vector3 velPitch;
     vector3 velPitchHalf;
 
@@ -628,53 +617,48 @@ int nParticle2Emitter::RenderStretchedSmooth(float* dstVertices,int maxVertices)
     int p;
     for (p = 0; p < this->particleCount ; p++)
     {
-        nParticle2* particle = &particles[particleOffset];
-        float relParticleAge = particle->lifeTime * particle->oneDivMaxLifeTime;
-        int curveIndex = (int)(relParticleAge * (float)ParticleTimeDetail);
-        curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
-        float* curCurves = &this->pStaticCurves[curveIndex*CurveTypeCount];
+        int i = particleOffset;
 
         // calculate stretch steps
         float stretchTime = this->particleStretch;
-        if (stretchTime>particle->lifeTime) stretchTime = particle->lifeTime;
+        if (stretchTime>lifeTime[i]) stretchTime = lifeTime[i];
         float stretchStep = -(stretchTime * oneDivStretchDetail);
-        velPitch = particle->acc * stretchStep;
+        velPitch.set(accX[i] * stretchStep, accY[i] * stretchStep, accZ[i] * stretchStep);
         velPitchHalf = velPitch * 0.5f;
-        float stretchStepVel = stretchStep * curCurves[ParticleVelocityFactor];
+        float stretchStepVel = stretchStep * velocityFactor[i];
 
-        float scale = curCurves[ParticleScale]*particle->sizeVariation;
-        float vPitch = (particle->uvmax.y - particle->uvmin.y) * oneDivStretchDetail;
+        float vPitch = (uvMaxY[i] - uvMinY[i]) * oneDivStretchDetail;
 
-        myVertex.color = curCurves[StaticRGBCurve];
-        myVertex.v = particle->uvmin.y;
-        myVertex.pos = particle->position;
-        myVertex.vel = particle->velocity;
+        myVertex.color = color[i];
+        myVertex.v = uvMinY[i];
+        myVertex.pos.set(posX[i], posY[i], posZ[i]);
+        myVertex.vel.set(velX[i], velY[i], velZ[i]);
 
-        myVertex.alpha = curCurves[ParticleAlpha] + viewFadeOut;
-        myVertex.scale = scale;
+        myVertex.alpha = alpha[i] + viewFadeOut;
+        myVertex.scale = scale[i];
 
         int d;
         for (d = 0; d < this->stretchDetail; d++)
         {
             // life-time-check is not needed, it is assured that the relative age is >=0 and <1
-            myVertex.u = particle->uvmin.x;
+            myVertex.u = uvMinX[i];
             myVertex.rotation = 3.0f*PI/2.0f;
             destPtr[0] = myVertex;
             destPtr[3] = myVertex;
 
             myVertex.rotation = PI/2.0f;
-            myVertex.u = particle->uvmax.x;
+            myVertex.u = uvMaxX[i];
             destPtr[5] = myVertex;
 
             myVertex.rotation = 3.0f*PI/2.0f;
-            myVertex.u = particle->uvmin.x;
+            myVertex.u = uvMinX[i];
             myVertex.v += vPitch;
             myVertex.pos += (myVertex.vel + velPitchHalf) * stretchStepVel;
             myVertex.vel += velPitch;
             destPtr[1] = myVertex;
 
             myVertex.rotation = PI/2.0f;
-            myVertex.u = particle->uvmax.x;
+            myVertex.u = uvMaxX[i];
             destPtr[2] = myVertex;
             destPtr[4] = myVertex;
 
@@ -709,7 +693,7 @@ void nParticle2Emitter::Render(float curTime)
         this->isSleeping = false;
         // reallocate particles
         this->AllocateParticles();
-        n_assert(0 != this->particles);
+        n_assert(this->particles.IsValid());
 
         this->frameWasRendered = true;
         this->Update(curTime - 0.001f);    // trigger with a little difference, so that the emitter will reset
@@ -771,7 +755,7 @@ nParticle2Emitter::Initialize()
     this->maxParticleCount = n_max(1, this->maxParticleCount);
     // allocate array
     this->AllocateParticles();
-    n_assert(0 != this->particles);
+    n_assert(this->particles.IsValid());
     // reset particles
     this->particleCount = 0;
 
@@ -788,7 +772,7 @@ nParticle2Emitter::NotifyCurvesChanged()
 {
     n_assert(0 != this->pStaticCurves);
 
-    if (this->particles != 0)
+    if (this->particles.IsValid())
     {
         // we need to rearrange the particlearray, because the curves have changed
 
@@ -805,23 +789,12 @@ nParticle2Emitter::NotifyCurvesChanged()
         newMaxParticleCount = n_max(1, newMaxParticleCount);
         if (newMaxParticleCount > this->maxParticleCount || newMaxParticleCount < this->maxParticleCount / 2)
         {
-            // allocate array
-            nParticle2* newPtr = n_new_array(nParticle2, newMaxParticleCount);
-            n_assert(0 != newPtr);
-
-            int partsToCopy = this->particleCount;
-            if (partsToCopy > newMaxParticleCount)
-                partsToCopy = newMaxParticleCount;
-
-            memcpy(newPtr, this->particles, partsToCopy * sizeof(nParticle2));
-
-            // delete old array
-            n_delete_array(this->particles);
-
-            // set new values
-            this->particleCount = partsToCopy;
-            this->particles = newPtr;
+            // reallocate pool, keep as many particles as possible
+            this->particleCount = this->particles.Reallocate(newMaxParticleCount, n_min(this->particleCount, newMaxParticleCount));
             this->maxParticleCount = newMaxParticleCount;
         }
+
+        // the cached curve values are outdated now
+        this->SampleParticleCurves(0, this->particleCount);
     }
 }
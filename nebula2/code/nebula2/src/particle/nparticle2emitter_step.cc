@@ -0,0 +1,351 @@
+//------------------------------------------------------------------------------
+//  nparticle2emitter_step.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "particle/nparticle2emitter.h"
+#include "particle/nparticleserver2.h"
+
+#ifdef __NEBULA_PARTICLE_SSE__
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+/**
+    Updates the existing particles and removes dead ones. Uses the SSE
+    kernel if it is available and enabled on the particle server, the
+    scalar kernel otherwise. Both produce identical results.
+*/
+void
+nParticle2Emitter::CalculateStep(float stepTime)
+{
+    n_assert(stepTime >= 0.0f);
+    n_assert(this->particles.IsValid());
+    n_assert(0 != this->pStaticCurves);
+
+    // nothing to do?
+    if (0 == this->particleCount)
+    {
+        return;
+    }
+
+#ifdef __NEBULA_PARTICLE_SSE__
+    if (nParticleServer2::Instance()->GetUseSimd())
+    {
+        this->CalculateStepSSE(stepTime);
+        return;
+    }
+#endif
+    this->CalculateStepScalar(stepTime);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The scalar update kernel, particles are processed one by one and dead
+    particles are removed on the fly.
+*/
+void
+nParticle2Emitter::CalculateStepScalar(float stepTime)
+{
+    const float windX = this->wind.x * this->wind.w;
+    const float windY = this->wind.y * this->wind.w;
+    const float windZ = this->wind.z * this->wind.w;
+
+    float* posX = this->particles.GetStream(nParticle2Pool::PosX);
+    float* posY = this->particles.GetStream(nParticle2Pool::PosY);
+    float* posZ = this->particles.GetStream(nParticle2Pool::PosZ);
+    float* velX = this->particles.GetStream(nParticle2Pool::VelX);
+    float* velY = this->particles.GetStream(nParticle2Pool::VelY);
+    float* velZ = this->particles.GetStream(nParticle2Pool::VelZ);
+    float* accX = this->particles.GetStream(nParticle2Pool::AccX);
+    float* accY = this->particles.GetStream(nParticle2Pool::AccY);
+    float* accZ = this->particles.GetStream(nParticle2Pool::AccZ);
+    float* rotation = this->particles.GetStream(nParticle2Pool::Rotation);
+    float* rotationVariation = this->particles.GetStream(nParticle2Pool::RotationVariation);
+    float* sizeVariation = this->particles.GetStream(nParticle2Pool::SizeVariation);
+    float* lifeTime = this->particles.GetStream(nParticle2Pool::LifeTime);
+    float* oneDivMaxLifeTime = this->particles.GetStream(nParticle2Pool::OneDivMaxLifeTime);
+    float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    float* color = this->particles.GetStream(nParticle2Pool::Color);
+    float* velocityFactor = this->particles.GetStream(nParticle2Pool::VelocityFactor);
+
+    this->box.begin_extend();
+
+    int dst = 0;
+    int src;
+    for (src = 0; src < this->particleCount; src++)
+    {
+        // update times
+        float curLifeTime = lifeTime[src] + stepTime;
+        float relParticleAge = curLifeTime * oneDivMaxLifeTime[src];
+        if ((relParticleAge >= 0.0f) && (relParticleAge < 1.0f))
+        {
+            // move particle over dead ones
+            if (dst != src)
+            {
+                this->particles.Copy(dst, src);
+            }
+
+            // get pointer to anim curves
+            int curveIndex = int(relParticleAge * float(ParticleTimeDetail));
+            curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
+            const float* curCurves = &this->pStaticCurves[curveIndex * CurveTypeCount];
+
+            // compute acceleration vector
+            float ax = windX * curCurves[ParticleAirResistance];
+            float ay = windY * curCurves[ParticleAirResistance] + this->gravity;
+            float az = windZ * curCurves[ParticleAirResistance];
+            ax *= curCurves[ParticleMass];
+            ay *= curCurves[ParticleMass];
+            az *= curCurves[ParticleMass];
+
+            // update particle
+            float velStep = stepTime * curCurves[ParticleVelocityFactor];
+            lifeTime[dst] = curLifeTime;
+            accX[dst] = ax;
+            accY[dst] = ay;
+            accZ[dst] = az;
+            posX[dst] += velX[dst] * velStep;
+            posY[dst] += velY[dst] * velStep;
+            posZ[dst] += velZ[dst] * velStep;
+            velX[dst] += ax * stepTime;
+            velY[dst] += ay * stepTime;
+            velZ[dst] += az * stepTime;
+            rotation[dst] += curCurves[ParticleRotationVelocity] * rotationVariation[dst] * stepTime;
+
+            // cache curve values for the vertex writers
+            scale[dst] = curCurves[ParticleScale] * sizeVariation[dst];
+            alpha[dst] = curCurves[ParticleAlpha];
+            color[dst] = curCurves[StaticRGBCurve];
+            velocityFactor[dst] = curCurves[ParticleVelocityFactor];
+
+            // update boundary values
+            this->box.extend(posX[dst], posY[dst], posZ[dst]);
+            dst++;
+        }
+    }
+    this->particleCount = dst;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the cached curve values of a range of particles from their
+    current age. Used for newly emitted particles and after the curves
+    have changed.
+*/
+void
+nParticle2Emitter::SampleParticleCurves(int first, int num)
+{
+    n_assert(0 != this->pStaticCurves);
+    const float* sizeVariation = this->particles.GetStream(nParticle2Pool::SizeVariation);
+    const float* lifeTime = this->particles.GetStream(nParticle2Pool::LifeTime);
+    const float* oneDivMaxLifeTime = this->particles.GetStream(nParticle2Pool::OneDivMaxLifeTime);
+    float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    float* color = this->particles.GetStream(nParticle2Pool::Color);
+    float* velocityFactor = this->particles.GetStream(nParticle2Pool::VelocityFactor);
+
+    int i;
+    for (i = first; i < first + num; i++)
+    {
+        int curveIndex = int((lifeTime[i] * oneDivMaxLifeTime[i]) * float(ParticleTimeDetail));
+        curveIndex = n_iclamp(curveIndex, 0, ParticleTimeDetail - 1);
+        const float* curCurves = &this->pStaticCurves[curveIndex * CurveTypeCount];
+        scale[i] = curCurves[ParticleScale] * sizeVariation[i];
+        alpha[i] = curCurves[ParticleAlpha];
+        color[i] = curCurves[StaticRGBCurve];
+        velocityFactor[i] = curCurves[ParticleVelocityFactor];
+    }
+}
+
+#ifdef __NEBULA_PARTICLE_SSE__
+//------------------------------------------------------------------------------
+/**
+    The SSE update kernel. Updates 4 particles at once in place (the pool
+    capacity is a multiple of 4, lanes behind the last particle are masked
+    out), and compacts the pool in a second pass only if particles have
+    died. The curve values of 4 particles are fetched with 3 unaligned
+    loads per particle and transposed into one register per curve.
+*/
+void
+nParticle2Emitter::CalculateStepSSE(float stepTime)
+{
+    // the curve transposes below depend on the curve layout
+    n_assert((ParticleRotationVelocity == 3) && (ParticleScale == 4) && (ParticleAlpha == 7));
+    n_assert((ParticleAirResistance == 8) && (StaticRGBCurve == 9) && (ParticleVelocityFactor == 10) && (ParticleMass == 11));
+
+    // number of set bits in a 4 bit mask
+    static const int numBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+    float* posX = this->particles.GetStream(nParticle2Pool::PosX);
+    float* posY = this->particles.GetStream(nParticle2Pool::PosY);
+    float* posZ = this->particles.GetStream(nParticle2Pool::PosZ);
+    float* velX = this->particles.GetStream(nParticle2Pool::VelX);
+    float* velY = this->particles.GetStream(nParticle2Pool::VelY);
+    float* velZ = this->particles.GetStream(nParticle2Pool::VelZ);
+    float* accX = this->particles.GetStream(nParticle2Pool::AccX);
+    float* accY = this->particles.GetStream(nParticle2Pool::AccY);
+    float* accZ = this->particles.GetStream(nParticle2Pool::AccZ);
+    float* rotation = this->particles.GetStream(nParticle2Pool::Rotation);
+    float* rotationVariation = this->particles.GetStream(nParticle2Pool::RotationVariation);
+    float* sizeVariation = this->particles.GetStream(nParticle2Pool::SizeVariation);
+    float* lifeTime = this->particles.GetStream(nParticle2Pool::LifeTime);
+    float* oneDivMaxLifeTime = this->particles.GetStream(nParticle2Pool::OneDivMaxLifeTime);
+    float* scale = this->particles.GetStream(nParticle2Pool::Scale);
+    float* alpha = this->particles.GetStream(nParticle2Pool::Alpha);
+    float* color = this->particles.GetStream(nParticle2Pool::Color);
+    float* velocityFactor = this->particles.GetStream(nParticle2Pool::VelocityFactor);
+    const float* curves = this->pStaticCurves;
+
+    const __m128 step4 = _mm_set1_ps(stepTime);
+    const __m128 windX4 = _mm_set1_ps(this->wind.x * this->wind.w);
+    const __m128 windY4 = _mm_set1_ps(this->wind.y * this->wind.w);
+    const __m128 windZ4 = _mm_set1_ps(this->wind.z * this->wind.w);
+    const __m128 gravity4 = _mm_set1_ps(this->gravity);
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 one4 = _mm_set1_ps(1.0f);
+    const __m128 timeDetail4 = _mm_set1_ps(float(ParticleTimeDetail));
+    const __m128 maxCurveIndex4 = _mm_set1_ps(float(ParticleTimeDetail - 1));
+    const __m128 boxBig4 = _mm_set1_ps(1000000.0f);
+    const __m128 boxSmall4 = _mm_set1_ps(-1000000.0f);
+    __m128 minX4 = boxBig4, minY4 = boxBig4, minZ4 = boxBig4;
+    __m128 maxX4 = boxSmall4, maxY4 = boxSmall4, maxZ4 = boxSmall4;
+
+    int numAlive = 0;
+    int i;
+    for (i = 0; i < this->particleCount; i += 4)
+    {
+        // update times, find live particles
+        __m128 lifeTime4 = _mm_add_ps(_mm_load_ps(lifeTime + i), step4);
+        _mm_store_ps(lifeTime + i, lifeTime4);
+        __m128 relAge4 = _mm_mul_ps(lifeTime4, _mm_load_ps(oneDivMaxLifeTime + i));
+        __m128 alive4 = _mm_and_ps(_mm_cmpge_ps(relAge4, zero4), _mm_cmplt_ps(relAge4, one4));
+        int numValid = n_min(4, this->particleCount - i);
+        int aliveMask = _mm_movemask_ps(alive4) & ((1 << numValid) - 1);
+        numAlive += numBits[aliveMask];
+
+        // fetch and transpose anim curves
+        __m128 curveIndex4 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(relAge4, timeDetail4), zero4), maxCurveIndex4);
+        int curveIndex[4];
+        _mm_storeu_si128((__m128i*) curveIndex, _mm_cvttps_epi32(curveIndex4));
+        const float* c0 = curves + curveIndex[0] * CurveTypeCount;
+        const float* c1 = curves + curveIndex[1] * CurveTypeCount;
+        const float* c2 = curves + curveIndex[2] * CurveTypeCount;
+        const float* c3 = curves + curveIndex[3] * CurveTypeCount;
+        __m128 emissionFreq4 = _mm_loadu_ps(c0);
+        __m128 lifeTimeCurve4 = _mm_loadu_ps(c1);
+        __m128 startVelocity4 = _mm_loadu_ps(c2);
+        __m128 rotationVelocity4 = _mm_loadu_ps(c3);
+        _MM_TRANSPOSE4_PS(emissionFreq4, lifeTimeCurve4, startVelocity4, rotationVelocity4);
+        __m128 scale4 = _mm_loadu_ps(c0 + 4);
+        __m128 spreadMin4 = _mm_loadu_ps(c1 + 4);
+        __m128 spreadMax4 = _mm_loadu_ps(c2 + 4);
+        __m128 alpha4 = _mm_loadu_ps(c3 + 4);
+        _MM_TRANSPOSE4_PS(scale4, spreadMin4, spreadMax4, alpha4);
+        __m128 airResistance4 = _mm_loadu_ps(c0 + 8);
+        __m128 color4 = _mm_loadu_ps(c1 + 8);
+        __m128 velocityFactor4 = _mm_loadu_ps(c2 + 8);
+        __m128 mass4 = _mm_loadu_ps(c3 + 8);
+        _MM_TRANSPOSE4_PS(airResistance4, color4, velocityFactor4, mass4);
+
+        // compute acceleration vector
+        __m128 ax4 = _mm_mul_ps(_mm_mul_ps(windX4, airResistance4), mass4);
+        __m128 ay4 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(windY4, airResistance4), gravity4), mass4);
+        __m128 az4 = _mm_mul_ps(_mm_mul_ps(windZ4, airResistance4), mass4);
+        _mm_store_ps(accX + i, ax4);
+        _mm_store_ps(accY + i, ay4);
+        _mm_store_ps(accZ + i, az4);
+
+        // integrate position with the old velocity, then the velocity
+        __m128 velStep4 = _mm_mul_ps(step4, velocityFactor4);
+        __m128 vx4 = _mm_load_ps(velX + i);
+        __m128 vy4 = _mm_load_ps(velY + i);
+        __m128 vz4 = _mm_load_ps(velZ + i);
+        __m128 px4 = _mm_add_ps(_mm_load_ps(posX + i), _mm_mul_ps(vx4, velStep4));
+        __m128 py4 = _mm_add_ps(_mm_load_ps(posY + i), _mm_mul_ps(vy4, velStep4));
+        __m128 pz4 = _mm_add_ps(_mm_load_ps(posZ + i), _mm_mul_ps(vz4, velStep4));
+        _mm_store_ps(posX + i, px4);
+        _mm_store_ps(posY + i, py4);
+        _mm_store_ps(posZ + i, pz4);
+        _mm_store_ps(velX + i, _mm_add_ps(vx4, _mm_mul_ps(ax4, step4)));
+        _mm_store_ps(velY + i, _mm_add_ps(vy4, _mm_mul_ps(ay4, step4)));
+        _mm_store_ps(velZ + i, _mm_add_ps(vz4, _mm_mul_ps(az4, step4)));
+        __m128 rotStep4 = _mm_mul_ps(_mm_mul_ps(rotationVelocity4, _mm_load_ps(rotationVariation + i)), step4);
+        _mm_store_ps(rotation + i, _mm_add_ps(_mm_load_ps(rotation + i), rotStep4));
+
+        // cache curve values for the vertex writers
+        _mm_store_ps(scale + i, _mm_mul_ps(scale4, _mm_load_ps(sizeVariation + i)));
+        _mm_store_ps(alpha + i, alpha4);
+        _mm_store_ps(color + i, color4);
+        _mm_store_ps(velocityFactor + i, velocityFactor4);
+
+        // update boundary values with live particles only
+        if (aliveMask != 0)
+        {
+            static const int laneMasks[16][4] =
+            {
+                {  0,  0,  0,  0 }, { -1,  0,  0,  0 }, {  0, -1,  0,  0 }, { -1, -1,  0,  0 },
+                {  0,  0, -1,  0 }, { -1,  0, -1,  0 }, {  0, -1, -1,  0 }, { -1, -1, -1,  0 },
+                {  0,  0,  0, -1 }, { -1,  0,  0, -1 }, {  0, -1,  0, -1 }, { -1, -1,  0, -1 },
+                {  0,  0, -1, -1 }, { -1,  0, -1, -1 }, {  0, -1, -1, -1 }, { -1, -1, -1, -1 },
+            };
+            __m128 mask4 = _mm_loadu_ps((const float*) laneMasks[aliveMask]);
+            minX4 = _mm_min_ps(minX4, _mm_or_ps(_mm_and_ps(mask4, px4), _mm_andnot_ps(mask4, boxBig4)));
+            minY4 = _mm_min_ps(minY4, _mm_or_ps(_mm_and_ps(mask4, py4), _mm_andnot_ps(mask4, boxBig4)));
+            minZ4 = _mm_min_ps(minZ4, _mm_or_ps(_mm_and_ps(mask4, pz4), _mm_andnot_ps(mask4, boxBig4)));
+            maxX4 = _mm_max_ps(maxX4, _mm_or_ps(_mm_and_ps(mask4, px4), _mm_andnot_ps(mask4, boxSmall4)));
+            maxY4 = _mm_max_ps(maxY4, _mm_or_ps(_mm_and_ps(mask4, py4), _mm_andnot_ps(mask4, boxSmall4)));
+            maxZ4 = _mm_max_ps(maxZ4, _mm_or_ps(_mm_and_ps(mask4, pz4), _mm_andnot_ps(mask4, boxSmall4)));
+        }
+    }
+
+    // reduce the bounding box lanes
+    this->box.begin_extend();
+    if (numAlive > 0)
+    {
+        float boxLanes[6][4];
+        _mm_storeu_ps(boxLanes[0], minX4);
+        _mm_storeu_ps(boxLanes[1], minY4);
+        _mm_storeu_ps(boxLanes[2], minZ4);
+        _mm_storeu_ps(boxLanes[3], maxX4);
+        _mm_storeu_ps(boxLanes[4], maxY4);
+        _mm_storeu_ps(boxLanes[5], maxZ4);
+        float boxValues[6];
+        int c;
+        for (c = 0; c < 6; c++)
+        {
+            float* lanes = boxLanes[c];
+            boxValues[c] = (c < 3) ? n_min(n_min(lanes[0], lanes[1]), n_min(lanes[2], lanes[3])) :
+                                     n_max(n_max(lanes[0], lanes[1]), n_max(lanes[2], lanes[3]));
+        }
+        this->box.extend(boxValues[0], boxValues[1], boxValues[2]);
+        this->box.extend(boxValues[3], boxValues[4], boxValues[5]);
+    }
+
+    // remove dead particles, keeping the order of the live ones
+    if (numAlive < this->particleCount)
+    {
+        int dst = 0;
+        int src;
+        for (src = 0; src < this->particleCount; src++)
+        {
+            float relParticleAge = lifeTime[src] * oneDivMaxLifeTime[src];
+            if ((relParticleAge >= 0.0f) && (relParticleAge < 1.0f))
+            {
+                if (dst != src)
+                {
+                    this->particles.Copy(dst, src);
+                }
+                dst++;
+            }
+        }
+        n_assert(dst == numAlive);
+        this->particleCount = dst;
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//  nparticle2pool.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "particle/nparticle2pool.h"
+#include <string.h>
+
+//------------------------------------------------------------------------------
+/**
+*/
+nParticle2Pool::nParticle2Pool() :
+    memory(0),
+    capacity(0)
+{
+    memset(this->streams, 0, sizeof(this->streams));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nParticle2Pool::~nParticle2Pool()
+{
+    this->Release();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocate all streams in one block. The capacity is rounded up to a
+    multiple of 4 and every stream starts on a 16 byte boundary. The
+    streams are cleared, so that SIMD code may safely read the unused
+    slots at the end of the last group of 4.
+*/
+void
+nParticle2Pool::Allocate(int num)
+{
+    n_assert(num > 0);
+    this->Release();
+
+    this->capacity = (num + 3) & ~3;
+    this->memory = n_malloc(NumStreams * this->capacity * sizeof(float) + 15);
+    n_assert(0 != this->memory);
+    memset(this->memory, 0, NumStreams * this->capacity * sizeof(float) + 15);
+    float* ptr = (float*) ((size_t(this->memory) + 15) & ~size_t(15));
+    int i;
+    for (i = 0; i < NumStreams; i++)
+    {
+        this->streams[i] = ptr;
+        ptr += this->capacity;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Change the capacity of the pool and keep the first numKeep particles.
+    If the new capacity is smaller than numKeep, only the particles which
+    fit are kept. Returns the number of kept particles.
+*/
+int
+nParticle2Pool::Reallocate(int num, int numKeep)
+{
+    n_assert(num > 0);
+    n_assert(numKeep >= 0);
+    if (!this->IsValid())
+    {
+        this->Allocate(num);
+        return 0;
+    }
+
+    void* oldMemory = this->memory;
+    float* oldStreams[NumStreams];
+    memcpy(oldStreams, this->streams, sizeof(oldStreams));
+    numKeep = n_min(numKeep, n_min(num, this->capacity));
+
+    this->memory = 0;
+    this->Allocate(num);
+    int i;
+    for (i = 0; i < NumStreams; i++)
+    {
+        memcpy(this->streams[i], oldStreams[i], numKeep * sizeof(float));
+    }
+    n_free(oldMemory);
+    return numKeep;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2Pool::Release()
+{
+    if (this->memory)
+    {
+        n_free(this->memory);
+        this->memory = 0;
+    }
+    memset(this->streams, 0, sizeof(this->streams));
+    this->capacity = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2Pool::Set(int index, const nParticle2& particle)
+{
+    n_assert((index >= 0) && (index < this->capacity));
+    this->streams[PosX][index] = particle.position.x;
+    this->streams[PosY][index] = particle.position.y;
+    this->streams[PosZ][index] = particle.position.z;
+    this->streams[VelX][index] = particle.velocity.x;
+    this->streams[VelY][index] = particle.velocity.y;
+    this->streams[VelZ][index] = particle.velocity.z;
+    this->streams[AccX][index] = particle.acc.x;
+    this->streams[AccY][index] = particle.acc.y;
+    this->streams[AccZ][index] = particle.acc.z;
+    this->streams[StartX][index] = particle.startPos.x;
+    this->streams[StartY][index] = particle.startPos.y;
+    this->streams[StartZ][index] = particle.startPos.z;
+    this->streams[Rotation][index] = particle.rotation;
+    this->streams[RotationVariation][index] = particle.rotationVariation;
+    this->streams[SizeVariation][index] = particle.sizeVariation;
+    this->streams[LifeTime][index] = particle.lifeTime;
+    this->streams[OneDivMaxLifeTime][index] = particle.oneDivMaxLifeTime;
+    this->streams[UvMinX][index] = particle.uvmin.x;
+    this->streams[UvMinY][index] = particle.uvmin.y;
+    this->streams[UvMaxX][index] = particle.uvmax.x;
+    this->streams[UvMaxY][index] = particle.uvmax.y;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2Pool::Get(int index, nParticle2& particle) const
+{
+    n_assert((index >= 0) && (index < this->capacity));
+    particle.position.set(this->streams[PosX][index], this->streams[PosY][index], this->streams[PosZ][index]);
+    particle.velocity.set(this->streams[VelX][index], this->streams[VelY][index], this->streams[VelZ][index]);
+    particle.acc.set(this->streams[AccX][index], this->streams[AccY][index], this->streams[AccZ][index]);
+    particle.startPos.set(this->streams[StartX][index], this->streams[StartY][index], this->streams[StartZ][index]);
+    particle.rotation = this->streams[Rotation][index];
+    particle.rotationVariation = this->streams[RotationVariation][index];
+    particle.sizeVariation = this->streams[SizeVariation][index];
+    particle.lifeTime = this->streams[LifeTime][index];
+    particle.oneDivMaxLifeTime = this->streams[OneDivMaxLifeTime][index];
+    particle.uvmin.set(this->streams[UvMinX][index], this->streams[UvMinY][index]);
+    particle.uvmax.set(this->streams[UvMaxX][index], this->streams[UvMaxY][index]);
+}
+
+//------------------------------------------------------------------------------
+//  EOF
+//------------------------------------------------------------------------------
@@ -4,6 +4,11 @@
 //------------------------------------------------------------------------------
 #include "particle/nparticleserver2.h"
 
+static void n_setusesimd(void* slf, nCmd* cmd);
+static void n_getusesimd(void* slf, nCmd* cmd);
+static void n_setparallelupdate(void* slf, nCmd* cmd);
+static void n_getparallelupdate(void* slf, nCmd* cmd);
+
 //------------------------------------------------------------------------------
 /**
     @scriptclass
@@ -22,5 +27,82 @@ void
 n_initcmds(nClass* cl)
 {
     cl->BeginCmds();
+    cl->AddCmd("v_setusesimd_b",          'SSMD', n_setusesimd);
+    cl->AddCmd("b_getusesimd_v",          'GSMD', n_getusesimd);
+    cl->AddCmd("v_setparallelupdate_b",   'SPUP', n_setparallelupdate);
+    cl->AddCmd("b_getparallelupdate_v",   'GPUP', n_getparallelupdate);
     cl->EndCmds();
 }
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    setusesimd
+    @input
+    b(UseSimd)
+    @output
+    v
+    @info
+    Enable/disable the SSE particle update kernel. Disable it to validate
+    against the scalar kernel.
+*/
+static void
+n_setusesimd(void* slf, nCmd* cmd)
+{
+    nParticleServer2* self = (nParticleServer2*) slf;
+    self->SetUseSimd(cmd->In()->GetB());
+}
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    getusesimd
+    @input
+    v
+    @output
+    b(UseSimd)
+    @info
+    Get the SSE particle update kernel flag.
+*/
+static void
+n_getusesimd(void* slf, nCmd* cmd)
+{
+    nParticleServer2* self = (nParticleServer2*) slf;
+    cmd->Out()->SetB(self->GetUseSimd());
+}
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    setparallelupdate
+    @input
+    b(ParallelUpdate)
+    @output
+    v
+    @info
+    Enable/disable updating the particle emitters on the worker threads.
+*/
+static void
+n_setparallelupdate(void* slf, nCmd* cmd)
+{
+    nParticleServer2* self = (nParticleServer2*) slf;
+    self->SetParallelUpdate(cmd->In()->GetB());
+}
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    getparallelupdate
+    @input
+    v
+    @output
+    b(ParallelUpdate)
+    @info
+    Get the parallel emitter update flag.
+*/
+static void
+n_getparallelupdate(void* slf, nCmd* cmd)
+{
+    nParticleServer2* self = (nParticleServer2*) slf;
+    cmd->Out()->SetB(self->GetParallelUpdate());
+}
@@ -17,11 +17,18 @@ nParticleServer2::nParticleServer2() :
     floatRandomPool(FloatRandomCount),
     intRandomPool(IntRandomCount),
     globalAccel(0.0f, -1.0f, 0.0f),
-    time(0.0)
+    time(0.0),
+    nextRandomSeed(0),
+    useSimd(true),
+    parallelUpdate(true)
 {
     n_assert(0 == Singleton);
     Singleton = this;
 
+    PROFILER_INIT(profUpdate, "profParticleUpdate");
+    WATCHER_INIT(watchNumActiveEmitters, "watchParticleNumActiveEmitters", nArg::Int);
+    WATCHER_INIT(watchNumUpdateBatches, "watchParticleNumUpdateBatches", nArg::Int);
+
     srand((unsigned int) ::time(NULL));
 
     // fill the random number pools
@@ -62,6 +69,7 @@ nParticle2Emitter*
 nParticleServer2::NewParticleEmitter()
 {
     nParticle2Emitter* particleEmitter = n_new(nParticle2Emitter);
+    particleEmitter->SetRandomSeed(++this->nextRandomSeed);
     this->emitters.PushBack(particleEmitter);
     n_printf("nParticleServer2: particle emitter created!\n");
     return particleEmitter;
@@ -69,16 +77,147 @@ nParticleServer2::NewParticleEmitter()
 
 //------------------------------------------------------------------------------
 /**
+    Update all particle emitters. Emitters which are awake are collected
+    into batches and updated in parallel, the batches are built in emitter
+    order so the result doesn't depend on the number of threads.
 */
 void nParticleServer2::Trigger()
 {
+    PROFILER_START(this->profUpdate);
     this->time = nTimeServer::Instance()->GetTime();
-    
+    float curTime = float(this->time);
+
+    // sleeping emitters only advance their timers, don't bother the workers
+    this->activeEmitters.Reset();
+    this->updateBatches.Reset();
+    UpdateBatch batch;
+    batch.firstEmitter = 0;
+    batch.numEmitters = 0;
+    int batchCost = 0;
     int num = this->emitters.Size();
-    for (int i = 0; i < num; i++)
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        nParticle2Emitter* emitter = this->emitters[i];
+        if (!emitter->IsSetup())
+        {
+            continue;
+        }
+        if (emitter->IsSleeping())
+        {
+            emitter->Update(curTime);
+            continue;
+        }
+
+        this->activeEmitters.Append(emitter);
+        batch.numEmitters++;
+        batchCost += emitter->GetParticleCount() + EmitterBatchCost;
+        if (batchCost >= ParticlesPerBatch)
+        {
+            this->updateBatches.Append(batch);
+            batch.firstEmitter = this->activeEmitters.Size();
+            batch.numEmitters = 0;
+            batchCost = 0;
+        }
+    }
+    if (batch.numEmitters > 0)
+    {
+        this->updateBatches.Append(batch);
+    }
+
+    if (this->updateBatches.Size() > 0)
+    {
+        this->LockEmitterMeshes();
+        if (this->parallelUpdate)
+        {
+            nWorkerPool::Instance()->Run(this->updateBatches.Size(), UpdateEmittersTask, this);
+        }
+        else
+        {
+            for (i = 0; i < this->updateBatches.Size(); i++)
+            {
+                UpdateEmittersTask(i, 0, this);
+            }
+        }
+        this->UnlockEmitterMeshes();
+    }
+
+    WATCHER_SET_INT(watchNumActiveEmitters, this->activeEmitters.Size());
+    WATCHER_SET_INT(watchNumUpdateBatches, this->updateBatches.Size());
+    PROFILER_STOP(this->profUpdate);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Update one batch of emitters. Runs on a worker thread, emitters are
+    independent of each other so no synchronization is necessary.
+*/
+void
+nParticleServer2::UpdateEmittersTask(int taskIndex, int /*workerIndex*/, void* userData)
+{
+    nParticleServer2* self = (nParticleServer2*) userData;
+    const UpdateBatch& batch = self->updateBatches[taskIndex];
+    float curTime = float(self->time);
+    int i;
+    for (i = batch.firstEmitter; i < batch.firstEmitter + batch.numEmitters; i++)
+    {
+        self->activeEmitters[i]->Update(curTime);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Lock the emitter meshes of all active emitters, so that emitters can
+    emit particles from worker threads. Emitters often share a mesh, every
+    mesh is locked only once.
+*/
+void
+nParticleServer2::LockEmitterMeshes()
+{
+    this->lockedMeshes.Reset();
+    int i;
+    for (i = 0; i < this->activeEmitters.Size(); i++)
+    {
+        nParticle2Emitter* emitter = this->activeEmitters[i];
+        nMesh2* mesh = emitter->GetEmitterMesh();
+        int meshIndex;
+        for (meshIndex = 0; meshIndex < this->lockedMeshes.Size(); meshIndex++)
+        {
+            if (this->lockedMeshes[meshIndex].mesh == mesh)
+            {
+                break;
+            }
+        }
+        if (meshIndex == this->lockedMeshes.Size())
+        {
+            LockedMesh lockedMesh;
+            lockedMesh.mesh = mesh;
+            lockedMesh.vertices = mesh->LockVertices();
+            lockedMesh.indices = mesh->LockIndices();
+            this->lockedMeshes.Append(lockedMesh);
+        }
+        const LockedMesh& lockedMesh = this->lockedMeshes[meshIndex];
+        emitter->SetEmitterMeshBuffers(lockedMesh.vertices, lockedMesh.indices);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticleServer2::UnlockEmitterMeshes()
+{
+    int i;
+    for (i = 0; i < this->activeEmitters.Size(); i++)
+    {
+        this->activeEmitters[i]->SetEmitterMeshBuffers(0, 0);
+    }
+    for (i = 0; i < this->lockedMeshes.Size(); i++)
     {
-        this->emitters[i]->Update(float(this->time));
+        this->lockedMeshes[i].mesh->UnlockVertices();
+        this->lockedMeshes[i].mesh->UnlockIndices();
     }
+    this->lockedMeshes.Reset();
 }
 
 //------------------------------------------------------------------------------
@@ -6,6 +6,8 @@
 #include "resource/nresource.h"
 #include "resource/nresourceserver.h"
 #include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
 
 nNebulaClass(nResource, "nroot");
 
@@ -18,8 +20,15 @@ nResource::nResource() :
     refResourceServer("/sys/servers/resource"),
     type(InvalidResourceType),
     asyncEnabled(false),
-    state(Unloaded),
-    jobNode(this)
+    jobNode(this),
+    jobStage(NoJob),
+    jobPinned(false),
+    releasePending(false),
+    loadPriority(0.0f),
+    jobQueueTime(0.0),
+    preloadedFileData(0),
+    preloadedFileSize(0),
+    state(Unloaded)
 {
     this->uniqueId = ++uniqueIdCounter;
 }
@@ -37,6 +46,106 @@ nResource::~nResource()
     {
         this->refResourceServer->RemLoaderJob(this);
     }
+    this->FreePreloadedFile();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Release the object. If this is the last reference and a background
+    thread of the resource server is working on the resource, the
+    destruction is deferred to nResourceServer::Trigger().
+*/
+bool
+nResource::Release()
+{
+    if ((1 == this->GetRefCount()) && this->refResourceServer.isvalid())
+    {
+        if (this->refResourceServer->DeferRelease(this))
+        {
+            return false;
+        }
+    }
+    return nRoot::Release();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the priority of async load requests. A pending request is moved
+    in the resource server's job queue.
+*/
+void
+nResource::SetLoadPriority(float p)
+{
+    if (this->refResourceServer.isvalid())
+    {
+        this->refResourceServer->SetLoaderJobPriority(this, p);
+    }
+    else
+    {
+        this->loadPriority = p;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Subclasses return true here if their LoadResource() method can use
+    the file contents returned by GetPreloadedFileData() instead of
+    reading the resource file itself. Default is false.
+*/
+bool
+nResource::CanPreloadFile()
+{
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read the resource file into memory. This is the I/O stage of an
+    async load request and runs on the resource server's I/O thread. If
+    the file can't be read, no data is preloaded, and LoadResource()
+    will handle the error. Subclasses may also call this method from
+    LoadResource() if no preloaded data is available.
+*/
+bool
+nResource::PreloadFile()
+{
+    n_assert(0 == this->preloadedFileData);
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    bool success = false;
+    if (file->Open(this->filename, "rb"))
+    {
+        int fileSize = file->GetSize();
+        if (fileSize > 0)
+        {
+            this->preloadedFileData = n_malloc(fileSize);
+            if (file->Read(this->preloadedFileData, fileSize) == fileSize)
+            {
+                this->preloadedFileSize = fileSize;
+                success = true;
+            }
+            else
+            {
+                this->FreePreloadedFile();
+            }
+        }
+        file->Close();
+    }
+    file->Release();
+    return success;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nResource::FreePreloadedFile()
+{
+    if (this->preloadedFileData)
+    {
+        n_free(this->preloadedFileData);
+        this->preloadedFileData = 0;
+    }
+    this->preloadedFileSize = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -63,6 +172,23 @@ nResource::GetResourceLoader()
     return this->refResourceLoader.getname();
 }
 
+//------------------------------------------------------------------------------
+/**
+    Return whether a yet-unfullfilled resource loading request is pending.
+    The job stage is owned by the resource server's loaderMutex.
+
+    @return     pending flag (true in async mode between Load() and IsValid() = true)
+*/
+bool
+nResource::IsPending() const
+{
+    nResourceServer* resourceServer = nResourceServer::Instance();
+    resourceServer->loaderMutex.Lock();
+    bool pending = (NoJob != this->jobStage) && (ReadCancelled != this->jobStage);
+    resourceServer->loaderMutex.Unlock();
+    return pending;
+}
+
 //------------------------------------------------------------------------------
 /**
     Subclasses must override this method to indicate to the nResource class
@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "resource/nresourceserver.h"
 #include "resource/nresource.h"
+#include "kernel/ntimeserver.h"
 
 nNebulaClass(nResourceServer, "nroot");
 nResourceServer* nResourceServer::Singleton = 0;
@@ -13,7 +14,14 @@ nResourceServer* nResourceServer::Singleton = 0;
 */
 nResourceServer::nResourceServer() :
     uniqueId(0),
-    loaderThread(0)
+    ioThread(0),
+    numLoaderJobs(0),
+    numLoaderThreads(2),
+    stopLoaderThreads(0),
+    numFinishedJobs(0),
+    throughputTime(0.0),
+    avgWaitTime(0.0f),
+    throughput(0.0f)
 {
     n_assert(0 == Singleton);
     Singleton = this;
@@ -32,8 +40,12 @@ nResourceServer::nResourceServer() :
     this->resourceClass = kernelServer->FindClass("nresource");
     n_assert(this->resourceClass);
 
+    WATCHER_INIT(watchQueueDepth, "watchResourceQueueDepth", nArg::Int);
+    WATCHER_INIT(watchWaitTime, "watchResourceWaitTime", nArg::Float);
+    WATCHER_INIT(watchThroughput, "watchResourceThroughput", nArg::Float);
+
     #ifndef __NEBULA_NO_THREADS__
-    this->StartLoaderThread();
+    this->StartLoaderThreads();
     #endif
 }
 
@@ -46,8 +58,23 @@ nResourceServer::~nResourceServer()
     Singleton = 0;
 
     #ifndef __NEBULA_NO_THREADS__
-    this->ShutdownLoaderThread();
+    this->ShutdownLoaderThreads();
     #endif
+
+    // drop the remaining load requests
+    this->loaderMutex.Lock();
+    nNode* jobNode;
+    while ((jobNode = this->ioJobList.RemHead()) || (jobNode = this->loadJobList.RemHead()))
+    {
+        nResource* res = (nResource*) jobNode->GetPtr();
+        res->jobStage = nResource::NoJob;
+        res->FreePreloadedFile();
+    }
+    this->loaderMutex.Unlock();
+
+    // destroy resources released while their job was running
+    this->ReleaseDeferredResources();
+
     this->UnloadResources(nResource::AllResourceTypes);
 }
 
@@ -302,64 +329,86 @@ nResourceServer::OnRestored(int rsrcTypeMask)
 
 //------------------------------------------------------------------------------
 /**
-    Wakeup the loader thread. This will simply signal the jobList.
+    Wakeup the I/O thread, this simply signals the job event. The thread
+    checks the stop flag when it wakes up.
 */
 void
 nResourceServer::ThreadWakeupFunc(nThread* thread)
 {
     nResourceServer* self = (nResourceServer*) thread->LockUserData();
     thread->UnlockUserData();
-    self->jobList.SignalEvent();
+    self->ioEvent.Signal();
 }
 
 //------------------------------------------------------------------------------
 /**
-    The background loader thread func. This will sit on the jobList until
-    it is signaled (when new jobs arrive), and for each job in the job
-    list, it will invoke the LoadResource() method of the resource object
-    and remove the resource object from the job list.
+    The background I/O thread func. It waits until I/O jobs arrive, reads
+    the resource file of the job with the highest priority into memory,
+    and moves the job over to the loader job list. If the resource has
+    been unloaded while its file was read, the file data is thrown away.
+    Before each read, loader jobs are submitted for the waiting load
+    requests.
+
+    The job is pinned while the loaderMutex is held, this keeps the
+    resource alive after the loaderMutex has been released. The
+    resource's mutex is only taken after that.
 */
 int
 N_THREADPROC
-nResourceServer::LoaderThreadFunc(nThread* thread)
+nResourceServer::IoThreadFunc(nThread* thread)
 {
     // tell thread object that we have started
     thread->ThreadStarted();
 
-    // get pointer to thread server object
+    // get pointer to resource server object
     nResourceServer* self = (nResourceServer*) thread->LockUserData();
     thread->UnlockUserData();
 
-    // sit on the jobList signal until new jobs arrive
     do
     {
-        // do nothing until job list becomes signalled
-        self->jobList.WaitEvent();
+        // do nothing until new jobs arrive
+        self->ioEvent.Wait();
 
-        // does our boss want us to shut down?
-        if (!thread->ThreadStopRequested())
+        // get all pending jobs
+        while (0 == n_interlocked_read(&self->stopLoaderThreads))
         {
-            // get all pending jobs
-            while (self->jobList.GetHead())
+            self->ScheduleLoaderJobs();
+
+            self->loaderMutex.Lock();
+            nNode* jobNode = self->ioJobList.RemHead();
+            if (0 == jobNode)
             {
-                // keep the job object from joblist
-                self->jobList.Lock();
-                nNode* jobNode = self->jobList.RemHead();
-                nResource* res = (nResource*) jobNode->GetPtr();
+                self->loaderMutex.Unlock();
+                break;
+            }
 
-                // take the resource's mutex and lock the resource,
-                // this prevents the resource to be deleted
-                res->LockMutex();
-                self->jobList.Unlock();
+            // pin the job, this prevents the resource to be deleted
+            nResource* res = (nResource*) jobNode->GetPtr();
+            res->jobStage = nResource::Reading;
+            res->jobPinned = true;
+            self->loaderMutex.Unlock();
 
-                res->LoadResource();
-                res->UnlockMutex();
+            res->LockMutex();
+            res->PreloadFile();
+            res->UnlockMutex();
 
-                // proceed to next job
+            // hand the job over to the loader jobs
+            self->loaderMutex.Lock();
+            if (nResource::ReadCancelled == res->jobStage)
+            {
+                res->jobStage = nResource::NoJob;
+                res->FreePreloadedFile();
             }
+            else
+            {
+                res->jobStage = nResource::WaitingForLoad;
+                self->InsertLoaderJob(self->loadJobList, res);
+            }
+            self->UnpinLoaderJob(res);
+            self->loaderMutex.Unlock();
         }
     }
-    while (!thread->ThreadStopRequested());
+    while (!thread->ThreadStopRequested() && (0 == n_interlocked_read(&self->stopLoaderThreads)));
 
     // tell thread object that we are done
     thread->ThreadHarakiri();
@@ -368,39 +417,159 @@ nResourceServer::LoaderThreadFunc(nThread* thread)
 
 //------------------------------------------------------------------------------
 /**
-    Start the loader thread.
+    Submit background jobs for the waiting load requests, so that at most
+    numLoaderThreads loader jobs are running. Only called by the I/O
+    thread: without job workers, the loader jobs run right away on the
+    I/O thread instead of stalling the main thread.
+*/
+void
+nResourceServer::ScheduleLoaderJobs()
+{
+    this->loaderMutex.Lock();
+    int numNewJobs = 0;
+    nNode* node;
+    for (node = this->loadJobList.GetHead();
+         node && ((this->numLoaderJobs + numNewJobs) < this->numLoaderThreads);
+         node = node->GetSucc())
+    {
+        numNewJobs++;
+    }
+    this->numLoaderJobs += numNewJobs;
+    this->loaderMutex.Unlock();
+
+    int i;
+    for (i = 0; i < numNewJobs; i++)
+    {
+        nJobServer::Instance()->SubmitBackground(LoaderJobFunc, 0, 1, this, &this->loaderJobCounter);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The loader job function. Takes the load request with the highest
+    priority and invokes the LoadResource() method of the resource object,
+    until no more requests are waiting. The job only ends while the
+    loaderMutex is held and the list is empty, so a request which is
+    queued while all loader jobs are running is never left behind. Jobs
+    are pinned like in IoThreadFunc().
+*/
+void
+nResourceServer::LoaderJobFunc(int /*begin*/, int /*end*/, void* userData)
+{
+    nResourceServer* self = (nResourceServer*) userData;
+    for (;;)
+    {
+        self->loaderMutex.Lock();
+        nNode* jobNode = n_interlocked_read(&self->stopLoaderThreads) ? 0 : self->loadJobList.RemHead();
+        if (0 == jobNode)
+        {
+            self->numLoaderJobs--;
+            self->loaderMutex.Unlock();
+            return;
+        }
+
+        // pin the job, this prevents the resource to be deleted
+        nResource* res = (nResource*) jobNode->GetPtr();
+        res->jobStage = nResource::Loading;
+        res->jobPinned = true;
+        self->loaderMutex.Unlock();
+
+        res->LockMutex();
+        res->LoadResource();
+        res->FreePreloadedFile();
+        res->UnlockMutex();
+
+        self->loaderMutex.Lock();
+        res->jobStage = nResource::NoJob;
+        self->UpdateLoaderStats(res);
+        self->UnpinLoaderJob(res);
+        self->loaderMutex.Unlock();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Start the I/O thread. Jobs which are still queued are picked up.
+*/
+void
+nResourceServer::StartLoaderThreads()
+{
+    n_assert(0 == this->ioThread);
+    n_interlocked_exchange(&this->stopLoaderThreads, 0);
+
+    // without job workers, the I/O thread runs the loader jobs itself,
+    // so give it sufficient stack size (2.5 MB)
+    this->ioThread = n_new(nThread(IoThreadFunc, nThread::Normal, 2500000, ThreadWakeupFunc, 0, this));
+    this->ioEvent.Signal();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Shutdown the I/O thread, then wait until the running loader jobs
+    have finished their current resource. Queued jobs stay in the job
+    lists.
 */
 void
-nResourceServer::StartLoaderThread()
+nResourceServer::ShutdownLoaderThreads()
 {
-    n_assert(0 == this->loaderThread);
+    n_assert(this->ioThread);
+    n_interlocked_exchange(&this->stopLoaderThreads, 1);
+
+    n_delete(this->ioThread);
+    this->ioThread = 0;
 
-    // give the thread sufficient stack size (2.5 MB) and a below
-    // normal priority (the purpose of the thread is to guarantee
-    // a smooth framerate despite dynamic resource loading after all)
-    this->loaderThread = n_new(nThread(LoaderThreadFunc, nThread::Normal, 2500000, ThreadWakeupFunc, 0, this));
+    // if the job server is already gone, it has executed all jobs
+    if (!this->loaderJobCounter.IsDone())
+    {
+        nJobServer::Instance()->Wait(&this->loaderJobCounter);
+    }
+    n_assert(0 == this->numLoaderJobs);
 }
 
 //------------------------------------------------------------------------------
 /**
-    Shutdown the loader thread.
+    Set the max number of loader jobs which run at the same time. Takes
+    effect when the I/O thread submits the next loader jobs.
 */
 void
-nResourceServer::ShutdownLoaderThread()
+nResourceServer::SetNumLoaderThreads(int num)
 {
-    n_assert(this->loaderThread);
-    n_delete(this->loaderThread);
-    this->loaderThread = 0;
-
-    // clear the job list
-    this->jobList.Lock();
-    while (this->jobList.RemHead());
-    this->jobList.Unlock();
+    n_assert(num > 0);
+    this->loaderMutex.Lock();
+    this->numLoaderThreads = num;
+    this->loaderMutex.Unlock();
+    this->ioEvent.Signal();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Insert a resource into a job list. The list is sorted by descending
+    load priority, a new job goes behind all jobs of the same priority.
+    The loaderMutex must be taken.
+*/
+void
+nResourceServer::InsertLoaderJob(nList& list, nResource* res)
+{
+    n_assert(res);
+    n_assert(!res->jobNode.IsLinked());
+    nNode* node;
+    for (node = list.GetTail(); node; node = node->GetPred())
+    {
+        nResource* cur = (nResource*) node->GetPtr();
+        if (cur->loadPriority >= res->loadPriority)
+        {
+            res->jobNode.InsertAfter(node);
+            return;
+        }
+    }
+    list.AddHead(&(res->jobNode));
 }
 
 //------------------------------------------------------------------------------
 /**
-    Add a resource to the job list for asynchronous loading.
+    Add a resource to the job lists for asynchronous loading. Resources
+    which can use a preloaded file go through the I/O thread first, for
+    the others the I/O thread only submits a loader job.
 */
 void
 nResourceServer::AddLoaderJob(nResource* res)
@@ -408,26 +577,223 @@ nResourceServer::AddLoaderJob(nResource* res)
     n_assert(res);
     n_assert(!res->IsPending());
     n_assert(!res->IsLoaded());
-    this->jobList.Lock();
-    this->jobList.AddTail(&(res->jobNode));
-    this->jobList.Unlock();
-    this->jobList.SignalEvent();
+    this->loaderMutex.Lock();
+    res->jobQueueTime = nTimeServer::Instance()->GetTime();
+    if (nResource::ReadCancelled == res->jobStage)
+    {
+        // the I/O thread is still reading the file, simply revive the job
+        res->jobStage = nResource::Reading;
+        this->loaderMutex.Unlock();
+        return;
+    }
+    if (res->CanPreloadFile())
+    {
+        res->jobStage = nResource::WaitingForRead;
+        this->InsertLoaderJob(this->ioJobList, res);
+        this->loaderMutex.Unlock();
+        this->ioEvent.Signal();
+    }
+    else
+    {
+        res->jobStage = nResource::WaitingForLoad;
+        this->InsertLoaderJob(this->loadJobList, res);
+        this->loaderMutex.Unlock();
+        this->ioEvent.Signal();
+    }
 }
 
 //------------------------------------------------------------------------------
 /**
-    Remove a resource from the job list for asynchronous loading.
+    Remove a resource from the job lists for asynchronous loading. If
+    its file is being read, the read result will be thrown away. A
+    running LoadResource() can't be cancelled.
 */
 void
 nResourceServer::RemLoaderJob(nResource* res)
 {
     n_assert(res);
-    this->jobList.Lock();
-    if (res->IsPending())
+    this->loaderMutex.Lock();
+    switch (res->jobStage)
+    {
+        case nResource::WaitingForRead:
+        case nResource::WaitingForLoad:
+            res->jobNode.Remove();
+            res->jobStage = nResource::NoJob;
+            res->FreePreloadedFile();
+            break;
+
+        case nResource::Reading:
+            res->jobStage = nResource::ReadCancelled;
+            break;
+
+        default:
+            break;
+    }
+    this->loaderMutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Set the load priority of a resource. If the resource is waiting in
+    a job list, it is moved to its new position.
+*/
+void
+nResourceServer::SetLoaderJobPriority(nResource* res, float priority)
+{
+    n_assert(res);
+    this->loaderMutex.Lock();
+    res->loadPriority = priority;
+    if (nResource::WaitingForRead == res->jobStage)
+    {
+        res->jobNode.Remove();
+        this->InsertLoaderJob(this->ioJobList, res);
+    }
+    else if (nResource::WaitingForLoad == res->jobStage)
     {
         res->jobNode.Remove();
+        this->InsertLoaderJob(this->loadJobList, res);
+    }
+    this->loaderMutex.Unlock();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the number of load requests waiting in the job lists.
+*/
+int
+nResourceServer::GetNumLoaderJobs()
+{
+    this->loaderMutex.Lock();
+    int num = 0;
+    nNode* node;
+    for (node = this->ioJobList.GetHead(); node; node = node->GetSucc())
+    {
+        num++;
+    }
+    for (node = this->loadJobList.GetHead(); node; node = node->GetSucc())
+    {
+        num++;
     }
-    this->jobList.Unlock();
+    this->loaderMutex.Unlock();
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Update the queue depth, wait time and throughput watchers after a
+    job has been finished. The wait time is the time from AddLoaderJob()
+    until the resource is loaded, averaged over the last jobs. The
+    throughput is measured in jobs per second over intervals of at
+    least 1 second. The loaderMutex must be taken. The watchers are
+    updated by Trigger() on the main thread.
+*/
+void
+nResourceServer::UpdateLoaderStats(nResource* finishedRes)
+{
+    n_assert(finishedRes);
+    double now = nTimeServer::Instance()->GetTime();
+    float waitTime = float(now - finishedRes->jobQueueTime);
+    if (0.0 == this->throughputTime)
+    {
+        // first finished job
+        this->avgWaitTime = waitTime;
+        this->throughputTime = finishedRes->jobQueueTime;
+    }
+    else
+    {
+        this->avgWaitTime = 0.9f * this->avgWaitTime + 0.1f * waitTime;
+    }
+    this->numFinishedJobs++;
+    if ((now - this->throughputTime) >= 1.0)
+    {
+        this->throughput = float(this->numFinishedJobs / (now - this->throughputTime));
+        this->numFinishedJobs = 0;
+        this->throughputTime = now;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Called by nResource::Release() before the last reference of a
+    resource is released. The pending job of the resource is dropped
+    while the loaderMutex is held, so no background thread can pick it
+    up anymore. If a background thread has already pinned the job,
+    the release is deferred until the job is unpinned, and the method
+    returns true.
+*/
+bool
+nResourceServer::DeferRelease(nResource* res)
+{
+    n_assert(res);
+    this->loaderMutex.Lock();
+    this->RemLoaderJob(res);
+    bool deferred = res->jobPinned;
+    if (deferred)
+    {
+        res->releasePending = true;
+    }
+    this->loaderMutex.Unlock();
+    return deferred;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Unpin a job after a background thread is done with the resource. If
+    the resource has been released in the meantime, it is handed over to
+    the main thread for destruction. The loaderMutex must be taken.
+*/
+void
+nResourceServer::UnpinLoaderJob(nResource* res)
+{
+    n_assert(res);
+    n_assert(res->jobPinned);
+    res->jobPinned = false;
+    if (res->releasePending)
+    {
+        res->releasePending = false;
+        this->deferredReleases.Append(res);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Release the resources whose destruction has been deferred because
+    a background thread was working on them.
+*/
+void
+nResourceServer::ReleaseDeferredResources()
+{
+    this->loaderMutex.Lock();
+    nArray<nResource*> releases = this->deferredReleases;
+    this->deferredReleases.Reset();
+    this->loaderMutex.Unlock();
+
+    int i;
+    for (i = 0; i < releases.Size(); i++)
+    {
+        releases[i]->Release();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Per-frame trigger, must be called from the main thread. Destroys
+    resources whose release has been deferred and updates the loader
+    watcher variables.
+*/
+void
+nResourceServer::Trigger()
+{
+    this->ReleaseDeferredResources();
+
+    this->loaderMutex.Lock();
+    float waitTime = this->avgWaitTime;
+    float jobsPerSecond = this->throughput;
+    this->loaderMutex.Unlock();
+
+    WATCHER_SET_FLOAT(watchThroughput, jobsPerSecond);
+    WATCHER_SET_FLOAT(watchWaitTime, waitTime);
+    WATCHER_SET_INT(watchQueueDepth, this->GetNumLoaderJobs());
 }
 
 //------------------------------------------------------------------------------
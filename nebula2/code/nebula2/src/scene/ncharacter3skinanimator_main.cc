@@ -19,8 +19,7 @@ nNebulaClass(nCharacter3SkinAnimator, "nskinanimator");
 //------------------------------------------------------------------------------
 /**
 */
-nCharacter3SkinAnimator::nCharacter3SkinAnimator() :
-    currentVariation(-1)
+nCharacter3SkinAnimator::nCharacter3SkinAnimator()
 {
 }
 
@@ -33,121 +32,57 @@ nCharacter3SkinAnimator::~nCharacter3SkinAnimator()
 
 //------------------------------------------------------------------------------
 /**
+    Update the animation state like nSkinAnimator, and record the
+    variation selected in the character set.
 */
-void
-nCharacter3SkinAnimator::Animate(nSceneNode* sceneNode, nRenderContext* renderContext)
+bool
+nCharacter3SkinAnimator::PrepareEvaluation(nRenderContext* renderContext, Evaluation& outEval)
 {
-    n_assert(sceneNode);
-    n_assert(renderContext);
-    n_assert(nVariable::InvalidHandle != this->channelVarHandle);
-
-    const nVariable& charVar = renderContext->GetLocalVar(this->characterVarIndex);
-    nCharacter2* curCharacter = (nCharacter2*)charVar.GetObj();
-    n_assert(curCharacter);
-
-    const nVariable& varCharacterSet = renderContext->GetLocalVar(this->characterSetIndex);
-    nCharacter3Set* characterSet = (nCharacter3Set*)varCharacterSet.GetObj();
-    n_assert(characterSet);
-
-    this->currentVariation = characterSet->GetCurrentVariationIndex();
-
-    // check if I am already uptodate for this frame
-    uint curFrameId = renderContext->GetFrameId();
-    if (curCharacter->GetLastEvaluationFrameId() != curFrameId)
+    if (nSkinAnimator::PrepareEvaluation(renderContext, outEval))
     {
-        curCharacter->SetLastEvaluationFrameId(curFrameId);
-
-        // get the sample time from the render context
-        nVariable* var = renderContext->GetVariable(this->channelVarHandle);
-        n_assert2(0 != var, "nCharacter3SkinAnimator::Animate(): TimeChannel Variable in RenderContext.\n");
-        const float curTime = var->GetFloat();
-
-        // get the time offset from the render context
-        var = renderContext->GetVariable(this->channelOffsetVarHandle);
-        const float curOffset = 0 != var ? var->GetFloat() : 0.0f;
-
-        // get character 2 set from render context and check if animation state needs to be updated
-        if (characterSet->IsDirty())
-        {
-            nAnimStateInfo newState;
-            int numClips = characterSet->GetNumClips();
-            int i;
-
-            float weightSum = 0.0f;
-            for (i = 0; i < numClips; i++)
-            {
-                weightSum += characterSet->GetClipWeightAt(i);
-            }
-
-            // add clips
-            if (weightSum > 0.0f)
-            {
-                newState.SetStateStarted(curTime);
-                newState.SetFadeInTime(characterSet->GetFadeInTime());
-                newState.BeginClips(numClips);
-                for (i = 0; i < numClips; i++)
-                {
-                    int index = this->GetClipIndexByName(characterSet->GetClipNameAt(i));
-                    if (-1 == index)
-                    {
-                        nRoot* parent = this->GetParent();
-                        n_assert(parent);
-                        n_error("nCharacter3SkinAnimator::Animate(): Requested clip \"%s\" does not exist on resource \"%s\".\n", characterSet->GetClipNameAt(i).Get(), parent->GetName());
-                    }
-                    newState.SetClip(i, this->GetClipAt(index), characterSet->GetClipWeightAt(i) / weightSum);
-                }
-                newState.EndClips();
-            }
-
-            curCharacter->SetActiveState(newState);
-            characterSet->SetDirty(false);
-        }
-
-        // evaluate the current state of the character skeleton
-        curCharacter->EvaluateSkeleton(curTime);
-
-        // now apply the variation on the skeleton
-        nCharSkeleton& skeleton = curCharacter->GetSkeleton();
-        if (this->currentVariation != -1)
-        {
-            const nArray<nCharJoint>& varJoints = this->variationJoints[this->currentVariation];
-            n_assert(varJoints.Size() == skeleton.GetNumJoints());
-            int jointIndex;
-            for (jointIndex = 0; jointIndex < varJoints.Size(); jointIndex++)
-            {
-                const vector3& varScale = varJoints[jointIndex].GetScale();
-                skeleton.GetJointAt(jointIndex).SetVariationScale(varScale);
-            }
-            skeleton.Evaluate();
-        }
-        else
-        {
-            // no variation applied, reset variation scale to one
-            int jointIndex;
-            static const vector3 noScale(1.0f, 1.0f, 1.0f);
-            for (jointIndex = 0; jointIndex < skeleton.GetNumJoints(); jointIndex++)
-            {
-                skeleton.GetJointAt(jointIndex).SetVariationScale(noScale);
-            }
-            skeleton.Evaluate();
-        }
+        const nVariable& varCharacterSet = renderContext->GetLocalVar(this->characterSetIndex);
+        nCharacter3Set* characterSet = (nCharacter3Set*)varCharacterSet.GetObj();
+        n_assert(characterSet);
+        outEval.variation = characterSet->GetCurrentVariationIndex();
+        return true;
     }
+    return false;
+}
 
-    // update the source node with the new char skeleton state
-    if (sceneNode->IsA(this->skinShapeNodeClass))
-    {
-        nSkinShapeNode* skinShapeNode = (nSkinShapeNode*) sceneNode;
-        skinShapeNode->SetCharSkeleton(&curCharacter->GetSkeleton());
-    }
-    else if (sceneNode->IsA(this->shadowSkinShapeNodeClass))
+//------------------------------------------------------------------------------
+/**
+    Apply the variation on the skeleton and evaluate the character. The
+    variation scale is set before the skeleton is evaluated, so the
+    skeleton needs to be evaluated only once.
+*/
+void
+nCharacter3SkinAnimator::EvaluateCharacter(const Evaluation& eval, int workerIndex) const
+{
+    n_assert(eval.character);
+    nCharSkeleton& skeleton = eval.character->GetSkeleton();
+    int jointIndex;
+    if (eval.variation != -1)
     {
-        nShadowSkinShapeNode* shadowSkinShapeNode = (nShadowSkinShapeNode*) sceneNode;
-        shadowSkinShapeNode->SetCharSkeleton(&curCharacter->GetSkeleton());
+        const nArray<nCharJoint>& varJoints = this->variationJoints[eval.variation];
+        n_assert(varJoints.Size() == skeleton.GetNumJoints());
+        for (jointIndex = 0; jointIndex < varJoints.Size(); jointIndex++)
+        {
+            const vector3& varScale = varJoints[jointIndex].GetScale();
+            skeleton.GetJointAt(jointIndex).SetVariationScale(varScale);
+        }
     }
     else
     {
-        n_error("nSkinAnimator::Animate(): invalid scene node class\n");
+        // no variation applied, reset variation scale to one
+        const vector3 noScale(1.0f, 1.0f, 1.0f);
+        for (jointIndex = 0; jointIndex < skeleton.GetNumJoints(); jointIndex++)
+        {
+            skeleton.GetJointAt(jointIndex).SetVariationScale(noScale);
+        }
     }
+
+    // evaluate the current state of the character skeleton
+    eval.character->EvaluateSkeleton(eval.time, workerIndex);
 }
 
 //------------------------------------------------------------------------------
@@ -14,6 +14,8 @@ static void n_setocclusionquery(void* slf, nCmd* cmd);
 static void n_getocclusionquery(void* slf, nCmd* cmd);
 static void n_setclipplanefencing(void* slf, nCmd* cmd);
 static void n_getclipplanefencing(void* slf, nCmd* cmd);
+static void n_setparallelbuild(void* slf, nCmd* cmd);
+static void n_getparallelbuild(void* slf, nCmd* cmd);
 
 //------------------------------------------------------------------------------
 /**
@@ -44,6 +46,8 @@ n_initcmds(nClass* cl)
     cl->AddCmd("b_getocclusionquery_v",      'GOCQ', n_getocclusionquery);
     cl->AddCmd("v_setclipplanefencing_b",    'SCPF', n_setclipplanefencing);
     cl->AddCmd("b_getclipplanefencing_v",    'GCPF', n_getclipplanefencing);
+    cl->AddCmd("v_setparallelbuild_b",       'SPBL', n_setparallelbuild);
+    cl->AddCmd("b_getparallelbuild_v",       'GPBL', n_getparallelbuild);
     cl->EndCmds();
 }
 
@@ -229,3 +233,39 @@ n_getclipplanefencing(void* slf, nCmd* cmd)
     nSceneServer* self = (nSceneServer*) slf;
     cmd->Out()->SetB(self->GetClipPlaneFencing());
 }
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    setparallelbuild
+    @input
+    b(ParallelBuild)
+    @output
+    v
+    @info
+    Enable/disable distributing the scene build over the worker threads.
+*/
+static void
+n_setparallelbuild(void* slf, nCmd* cmd)
+{
+    nSceneServer* self = (nSceneServer*) slf;
+    self->SetParallelBuild(cmd->In()->GetB());
+}
+
+//------------------------------------------------------------------------------
+/**
+    @cmd
+    getparallelbuild
+    @input
+    v
+    @output
+    b(ParallelBuild)
+    @info
+    Get the parallel scene build flag.
+*/
+static void
+n_getparallelbuild(void* slf, nCmd* cmd)
+{
+    nSceneServer* self = (nSceneServer*) slf;
+    cmd->Out()->SetB(self->GetParallelBuild());
+}
@@ -61,9 +61,9 @@ nSceneServer::ComputeLightScissor(LightInfo& lightInfo)
     }
     else if (nLight::Directional == lightType)
     {
-        // directional lights cover the whole screen
-        static const rectangle fullScreenRect(vector2::zero, vector2(1.0f, 1.0f));
-        lightInfo.scissorRect = fullScreenRect;
+        // directional lights cover the whole screen (no static here,
+        // this may run on several worker threads)
+        lightInfo.scissorRect.set(vector2::zero, vector2(1.0f, 1.0f));
     }
     else
     {
@@ -104,6 +104,25 @@ nSceneServer::ComputeLightClipPlanes(LightInfo& lightInfo)
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+    Computes scissor rectangles and clip planes for LightChunkSize lights.
+    Runs on a worker thread.
+*/
+void
+nSceneServer::ComputeLightsTask(int taskIndex, int /*workerIndex*/, void* userData)
+{
+    nSceneServer* self = (nSceneServer*) userData;
+    int lightIndex = taskIndex * LightChunkSize;
+    int endIndex = n_min(lightIndex + int(LightChunkSize), self->lightArray.Size());
+    for (; lightIndex < endIndex; lightIndex++)
+    {
+        LightInfo& lightInfo = self->lightArray[lightIndex];
+        self->ComputeLightScissor(lightInfo);
+        self->ComputeLightClipPlanes(lightInfo);
+    }
+}
+
 //------------------------------------------------------------------------------
 /**
     Iterates through the light groups and computes the scissor rectangle
@@ -113,15 +132,12 @@ void
 nSceneServer::ComputeLightScissorsAndClipPlanes()
 {
     PROFILER_START(this->profComputeScissors);
+    PROFILER_START(this->profBuildScissors);
     // update lights
-    int lightIndex;
     int numLights = this->lightArray.Size();
-    for (lightIndex = 0; lightIndex < numLights; lightIndex++)
-    {
-        LightInfo& lightInfo = this->lightArray[lightIndex];
-        this->ComputeLightScissor(lightInfo);
-        this->ComputeLightClipPlanes(lightInfo);
-    }
+    int numTasks = (numLights + LightChunkSize - 1) / LightChunkSize;
+    this->RunBuildTasks(numTasks, ComputeLightsTask);
+    PROFILER_STOP(this->profBuildScissors);
     PROFILER_STOP(this->profComputeScissors);
 }
 
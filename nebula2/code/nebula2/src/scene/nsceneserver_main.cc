@@ -11,6 +11,7 @@
 #include "gfx2/nshader2.h"
 #include "gfx2/nocclusionquery.h"
 #include "kernel/nfileserver2.h"
+#include "kernel/nframearena.h"
 #include "shadow2/nshadowserver2.h"
 #include "resource/nresourceserver.h"
 #include "mathlib/bbox.h"
@@ -19,11 +20,10 @@
 #include "scene/nabstractcameranode.h"
 #include "util/npriorityarray.h"
 #include "scene/nshapenode.h"
+#include "variable/nvariableserver.h"
 
 nNebulaScriptClass(nSceneServer, "nroot");
 nSceneServer* nSceneServer::Singleton = 0;
-vector3 nSceneServer::viewerPos;
-int nSceneServer::sortingOrder = nRpPhase::BackToFront;
 
 //------------------------------------------------------------------------------
 /**
@@ -37,12 +37,18 @@ nSceneServer::nSceneServer() :
     renderDebug(false),
     stackDepth(0),
     shapeBucket(0, 1024),
+    keyBucket(0, 1024),
     occlusionQuery(0),
     occlusionQueryEnabled(true),
     clipPlaneFencing(true),
     guiEnabled(true),
     camerasEnabled(true),
-    perfGuiEnabled(false)
+    perfGuiEnabled(false),
+    parallelBuild(true),
+    splitChunks(0, 16),
+    numSplitChunks(0),
+    characterUpdates(0, 64),
+    charPointerVarHandle(nVariable::InvalidHandle)
 {
     n_assert(0 == Singleton);
     Singleton = this;
@@ -57,11 +63,25 @@ nSceneServer::nSceneServer() :
     PROFILER_INIT(profOcclusion, "profSceneOcclusion");
     PROFILER_INIT(profRenderPath, "profSceneRenderPath");
     PROFILER_INIT(profRenderCameras, "profSceneRenderCameras");
+    PROFILER_INIT(profBuildSplit, "profSceneBuildSplit");
+    PROFILER_INIT(profBuildMerge, "profSceneBuildMerge");
+    PROFILER_INIT(profBuildLoad, "profSceneBuildLoad");
+    PROFILER_INIT(profBuildScissors, "profSceneBuildScissors");
+    PROFILER_INIT(profBuildSort, "profSceneBuildSort");
+    PROFILER_INIT(profUpdateCharacters, "profSceneUpdateCharacters");
 
     WATCHER_INIT(watchNumInstanceGroups, "watchSceneNumInstanceGroups", nArg::Int);
     WATCHER_INIT(watchNumInstances, "watchSceneNumInstances", nArg::Int);
     WATCHER_INIT(watchNumOccluded, "watchSceneNumOccluded", nArg::Int);
     WATCHER_INIT(watchNumNotOccluded, "watchSceneNumNotOccluded", nArg::Int);
+    WATCHER_INIT(watchNumBuildThreads, "watchSceneNumBuildThreads", nArg::Int);
+    WATCHER_INIT(watchNumCharacters, "watchSceneNumCharacters", nArg::Int);
+    WATCHER_INIT(watchNumFrameAllocs, "watchSceneFrameAllocs", nArg::Int);
+    WATCHER_INIT(watchNumFrameBytes, "watchSceneFrameBytes", nArg::Int);
+#ifdef __NEBULA_MEM_MANAGER__
+    WATCHER_INIT(watchNumHeapAllocs, "watchSceneHeapAllocs", nArg::Int);
+    this->lastNumHeapAllocs = 0;
+#endif
     WATCHER_INIT(watchNumPrimitives, "watchGfxNumPrimitives", nArg::Int);
     WATCHER_INIT(watchFPS, "watchGfxFPS", nArg::Float);
     WATCHER_INIT(watchNumDrawCalls, "watchGfxDrawCalls", nArg::Int);
@@ -75,6 +95,12 @@ nSceneServer::nSceneServer() :
     this->groupStack.SetSize(MaxHierarchyDepth);
     this->groupStack.Clear(0);
 
+    int bucketIndex;
+    for (bucketIndex = 0; bucketIndex < NumBuckets; bucketIndex++)
+    {
+        this->bucketSortingOrder[bucketIndex] = nRpPhase::None;
+    }
+
     // dummy far far away value^^
     this->renderedReflectorDistance = 99999999.9f;
 
@@ -94,6 +120,12 @@ nSceneServer::nSceneServer() :
 nSceneServer::~nSceneServer()
 {
     n_assert(!this->inBeginScene);
+    int i;
+    for (i = 0; i < this->splitChunks.Size(); i++)
+    {
+        n_delete(this->splitChunks[i]);
+    }
+    this->splitChunks.Clear();
     n_assert(Singleton);
     Singleton = 0;
 }
@@ -126,6 +158,7 @@ nSceneServer::Open()
         // initialize the render path object
         bool renderPathOpened = this->renderPath.Open();
         n_assert(renderPathOpened);
+        this->UpdateBucketSortingOrders();
 
         // unload the XML doc
         this->renderPath.CloseXml();
@@ -133,6 +166,9 @@ nSceneServer::Open()
         // create an occlusion query object
         this->occlusionQuery = gfxServer->NewOcclusionQuery();
 
+        // the variable under which skin animators store their characters
+        this->charPointerVarHandle = nVariableServer::Instance()->GetVariableHandleByName("charPointer");
+
         this->isOpen = true;
     }
     else
@@ -177,6 +213,17 @@ nSceneServer::BeginScene(const matrix44& invView)
     PROFILER_START(this->profFrame);
     PROFILER_START(this->profAttach);
 
+    // the frame allocations of the last frame
+    nFrameArena* frameArena = nFrameArena::Instance();
+    WATCHER_SET_INT(watchNumFrameAllocs, frameArena->GetNumAllocs());
+    WATCHER_SET_INT(watchNumFrameBytes, frameArena->GetNumBytes());
+#if defined(__NEBULA_MEM_MANAGER__) && defined(__NEBULA_STATS__)
+    nMemManagerStats memStats;
+    n_memgetstats(memStats);
+    WATCHER_SET_INT(watchNumHeapAllocs, memStats.numAllocs - this->lastNumHeapAllocs);
+    this->lastNumHeapAllocs = memStats.numAllocs;
+#endif
+
     this->stackDepth = 0;
     this->groupStack.Clear(0);
     this->groupArray.Reset();
@@ -293,16 +340,15 @@ nSceneServer::EndGroup()
 
 //------------------------------------------------------------------------------
 /**
-    Render the actual scene. This method should be implemented by
-    subclasses of nSceneServer. The frame will not be visible until
-    PresentScene() is called. Additional render calls to the gfx server
-    can be invoked between RenderScene() and PresentScene().
+    Build the attached scene for rendering: split it into shapes and
+    lights, load resources, update characters, compute the light
+    scissors and sort the shapes. Called by RenderScene(), tools which
+    don't render (like the scene benchmark) may call it on its own
+    between EndScene() and PresentScene().
 */
 void
-nSceneServer::RenderScene()
+nSceneServer::BuildScene()
 {
-    nGfxServer2* gfxServer = nGfxServer2::Instance();
-
     // split nodes into shapes and lights
     this->SplitNodes();
 
@@ -310,11 +356,30 @@ nSceneServer::RenderScene()
     // because the reflection/refraction camera stuff depends on it
     this->ValidateNodeResources();
 
+    // sample animations and evaluate character skeletons
+    this->UpdateCharacters();
+
     // compute light scissor rectangles and clip planes
     this->ComputeLightScissorsAndClipPlanes();
 
     // sort shape nodes for optimal rendering
     this->SortNodes();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Render the actual scene. This method should be implemented by
+    subclasses of nSceneServer. The frame will not be visible until
+    PresentScene() is called. Additional render calls to the gfx server
+    can be invoked between RenderScene() and PresentScene().
+*/
+void
+nSceneServer::RenderScene()
+{
+    nGfxServer2* gfxServer = nGfxServer2::Instance();
+
+    // build the scene
+    this->BuildScene();
 
     // render camera nodes in scene
     if (this->camerasEnabled)
@@ -373,133 +438,408 @@ nSceneServer::PresentScene()
 
 //------------------------------------------------------------------------------
 /**
-    Split the collected scene nodes into light and shape nodes. Fills
-    the lightArray[] and shapeArray[] members. This method is available
-    as a convenience method for subclasses.
+*/
+nSceneServer::SplitChunk::SplitChunk() :
+    firstGroup(0),
+    numGroups(0),
+    shapeBucket(0, 64),
+    keyBucket(0, 64),
+    lightArray(0, 16),
+    shadowArray(0, 64),
+    specialArray(0, 16),
+    invalidArray(0, 16)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+    The light array is rebuilt every frame, so the clip planes are
+    allocated from the frame arena instead of the heap.
+*/
+nSceneServer::LightInfo::LightInfo() :
+    groupIndex(0)
+{
+    this->clipPlanes.SetFlags(nArray<plane>::FrameAlloc);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Keeps the clip planes frame allocated when the light array grows.
+*/
+nSceneServer::LightInfo::LightInfo(const LightInfo& rhs) :
+    groupIndex(rhs.groupIndex),
+    scissorRect(rhs.scissorRect),
+    shadowLightMask(rhs.shadowLightMask)
+{
+    this->clipPlanes.SetFlags(nArray<plane>::FrameAlloc);
+    this->clipPlanes = rhs.clipPlanes;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Run a scene build pass. The task functions get the scene server as
+    user data. If parallel build is disabled, the tasks are executed
+    serially in task order on the calling thread.
 */
 void
-nSceneServer::SplitNodes()
+nSceneServer::RunBuildTasks(int numTasks, nWorkerPool::TaskFunc func)
 {
-    PROFILER_START(this->profSplitNodes);
+    if (this->parallelBuild)
+    {
+        nWorkerPool::Instance()->Run(numTasks, func, this);
+    }
+    else
+    {
+        int i;
+        for (i = 0; i < numTasks; i++)
+        {
+            func(i, 0, this);
+        }
+    }
+}
 
-    // reset complex rendered reflector
-    this->renderContextPtr = 0;
-    this->renderedReflectorDistance = 999999.9f;
+//------------------------------------------------------------------------------
+/**
+    Classify the groups of one split chunk into shapes, lights, shadow
+    casters, and groups which need serial treatment (reflecting shapes
+    and cameras). Also records groups with invalid resources, these
+    will be loaded by ValidateNodeResources() on the calling thread.
+    Runs on a worker thread, must not modify shared state or load
+    resources! The resources of visible shapes have been loaded by
+    SplitNodes() before, so the shader index can be read directly.
+*/
+void
+nSceneServer::SplitNodesTask(int taskIndex, int /*workerIndex*/, void* userData)
+{
+    nSceneServer* self = (nSceneServer*) userData;
+    SplitChunk* chunk = self->splitChunks[taskIndex];
 
-    // clear arrays which are filled by this method
-    this->shapeBucket.Clear();
-    this->lightArray.Clear();
-    this->shadowLightArray.Clear();
-    this->shadowArray.Reset();
-    this->cameraArray.Reset();
+    int b;
+    for (b = 0; b < NumBuckets; b++)
+    {
+        chunk->shapeBucket[b].Reset();
+        chunk->keyBucket[b].Reset();
+    }
+    chunk->lightArray.Reset();
+    chunk->shadowArray.Reset();
+    chunk->specialArray.Reset();
+    chunk->invalidArray.Reset();
 
-    ushort i;
-    ushort num = this->groupArray.Size();
-    for (i = 0; i < num; i++)
+    int i;
+    int end = chunk->firstGroup + chunk->numGroups;
+    for (i = chunk->firstGroup; i < end; i++)
     {
-        Group& group = this->groupArray[i];
+        const Group& group = self->groupArray[i];
         n_assert(group.sceneNode);
+        bool isSpecial = false;
 
         if (group.sceneNode->HasGeometry())
         {
             if (group.renderContext->GetFlag(nRenderContext::ShapeVisible))
             {
                 nMaterialNode* shapeNode = (nMaterialNode*)group.sceneNode;
-
-                // if this is a reflecting shape, parse for render priority
-                if (this->IsAReflectingShape(shapeNode))
+                if (self->IsAReflectingShape(shapeNode))
                 {
-                    // check if this one is the new (or old) node to be rendered complex
-                    if (this->ParsePriority(group))
-                    {
-                        this->cameraArray.Reset();
-                        group.renderContext->GetShaderOverrides().SetArg(nShaderState::RenderComplexity, 1);
-                    }
-                    else
-                    {
-                        // reset complex flag (we think this one is not the one to be rendered complex)
-                        group.renderContext->GetShaderOverrides().SetArg(nShaderState::RenderComplexity, 0);
-                    }
+                    isSpecial = true;
                 }
-
-                int shaderIndex = shapeNode->GetShaderIndex();
+                int shaderIndex = shapeNode->GetLoadedShaderIndex();
                 if (shaderIndex > -1)
                 {
-                    this->shapeBucket[shaderIndex].Append(i);
+                    chunk->shapeBucket[shaderIndex].Append(ushort(i));
+                    chunk->keyBucket[shaderIndex].Append(self->ComputeSortKey(group, shaderIndex));
                 }
             }
         }
         if (group.sceneNode->HasLight())
         {
             n_assert(group.sceneNode->IsA("nlightnode"));
-            group.renderContext->SetSceneLightIndex(this->lightArray.Size());
-            LightInfo lightInfo;
-            lightInfo.groupIndex = i;
-            this->lightArray.Append(lightInfo);
+            chunk->lightArray.Append(ushort(i));
         }
         if (group.sceneNode->HasShadow())
         {
             if (group.renderContext->GetFlag(nRenderContext::ShadowVisible))
             {
-                this->shadowArray.Append(i);
+                chunk->shadowArray.Append(ushort(i));
             }
         }
-
         if (group.sceneNode->HasCamera())
         {
-            nAbstractCameraNode* newCamera = (nAbstractCameraNode*) group.sceneNode;
+            isSpecial = true;
+        }
+        if (isSpecial)
+        {
+            chunk->specialArray.Append(ushort(i));
+        }
+        if (!group.sceneNode->AreResourcesValid())
+        {
+            chunk->invalidArray.Append(ushort(i));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Handles the order dependent part of splitting a group: picking the
+    reflecting shape which is rendered complex, and collecting the
+    cameras belonging to it. Called serially in group order.
+*/
+void
+nSceneServer::SplitSpecialGroup(ushort i)
+{
+    Group& group = this->groupArray[i];
 
-            // do the following stuff only if this camera is a child of the nearest seanode
-            const nRenderContext* renderCandidate = (nRenderContext*) group.renderContext;
+    if (group.sceneNode->HasGeometry() && group.renderContext->GetFlag(nRenderContext::ShapeVisible))
+    {
+        nMaterialNode* shapeNode = (nMaterialNode*)group.sceneNode;
 
-            // check if one reflecting camera has priority to be rendered
-            if (this->renderContextPtr != 0)
+        // if this is a reflecting shape, parse for render priority
+        if (this->IsAReflectingShape(shapeNode))
+        {
+            // check if this one is the new (or old) node to be rendered complex
+            if (this->ParsePriority(group))
+            {
+                this->cameraArray.Reset();
+                group.renderContext->GetShaderOverrides().SetArg(nShaderState::RenderComplexity, 1);
+            }
+            else
             {
+                // reset complex flag (we think this one is not the one to be rendered complex)
+                group.renderContext->GetShaderOverrides().SetArg(nShaderState::RenderComplexity, 0);
+            }
+        }
+    }
+
+    if (group.sceneNode->HasCamera())
+    {
+        nAbstractCameraNode* newCamera = (nAbstractCameraNode*) group.sceneNode;
 
-                // if this is the chosen one to be rendered
-                if (renderCandidate == this->renderContextPtr)
+        // do the following stuff only if this camera is a child of the nearest seanode
+        const nRenderContext* renderCandidate = (nRenderContext*) group.renderContext;
+
+        // check if one reflecting camera has priority to be rendered
+        if (this->renderContextPtr != 0)
+        {
+
+            // if this is the chosen one to be rendered
+            if (renderCandidate == this->renderContextPtr)
+            {
+                // HACK!!!: at the moment the cameras are only used for water, and all use
+                // the same render target (because this is defined in the section, not by the
+                // camera. Therefor it is useless to render more than one camera per section.
+                // If later other cameras are used this must be fixed. A way must be found
+                // to decide if 2 cameras are the same, or creating different rendertarget results.
+
+                // check if we already have a camera using the same renderpath section
+                int c;
+                bool uniqueCamera = true;
+                for (c = 0; c < this->cameraArray.Size(); c++)
                 {
-                    // HACK!!!: at the moment the cameras are only used for water, and all use
-                    // the same render target (because this is defined in the section, not by the
-                    // camera. Therefor it is useless to render more than one camera per section.
-                    // If later other cameras are used this must be fixed. A way must be found
-                    // to decide if 2 cameras are the same, or creating different rendertarget results.
-
-                    // check if we already have a camera using the same renderpath section
-                    int c;
-                    bool uniqueCamera = true;
-                    for (c = 0; c < this->cameraArray.Size(); c++)
+                    Group& group = this->groupArray[this->cameraArray[c]];
+                    nAbstractCameraNode* existingCamera = (nAbstractCameraNode*)group.sceneNode;
+                    if (existingCamera->GetRenderPathSection() == newCamera->GetRenderPathSection())
                     {
-                        Group& group = this->groupArray[this->cameraArray[c]];
-                        nAbstractCameraNode* existingCamera = (nAbstractCameraNode*)group.sceneNode;
-                        if (existingCamera->GetRenderPathSection() == newCamera->GetRenderPathSection())
-                        {
-                            uniqueCamera = false;
-                            break;
-                        }
+                        uniqueCamera = false;
+                        break;
                     }
+                }
+
+                if (uniqueCamera)
+                {
+                    this->cameraArray.Append(i);
+                }
+            }
+        }
+    }
+}
 
-                    if (uniqueCamera)
+//------------------------------------------------------------------------------
+/**
+    Split the collected scene nodes into light and shape nodes. Fills
+    the lightArray[] and shapeArray[] members. This method is available
+    as a convenience method for subclasses.
+
+    The group array is classified in chunks by SplitNodesTask(), then the
+    chunk results are merged in chunk order, so the resulting arrays are
+    identical to a serial split.
+*/
+void
+nSceneServer::SplitNodes()
+{
+    PROFILER_START(this->profSplitNodes);
+
+    // reset complex rendered reflector
+    this->renderContextPtr = 0;
+    this->renderedReflectorDistance = 999999.9f;
+
+    // clear arrays which are filled by this method
+    this->shapeBucket.Clear();
+    this->keyBucket.Clear();
+    this->lightArray.Clear();
+    this->shadowLightArray.Clear();
+    this->shadowArray.Reset();
+    this->cameraArray.Reset();
+
+    // the viewer position is needed for the sort keys
+    this->viewerPos = nGfxServer2::Instance()->GetTransform(nGfxServer2::InvView).pos_component();
+
+    // the split tasks must not load resources, so load the resources
+    // of visible shapes here, like the serial split did
+    int numGroups = this->groupArray.Size();
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < numGroups; groupIndex++)
+    {
+        const Group& group = this->groupArray[groupIndex];
+        if (group.sceneNode->HasGeometry() &&
+            group.renderContext->GetFlag(nRenderContext::ShapeVisible) &&
+            !group.sceneNode->AreResourcesValid())
+        {
+            group.sceneNode->LoadResources();
+        }
+    }
+
+    // partition the group array into chunks
+    this->numSplitChunks = (numGroups + SplitChunkSize - 1) / SplitChunkSize;
+    while (this->splitChunks.Size() < this->numSplitChunks)
+    {
+        this->splitChunks.Append(n_new(SplitChunk));
+    }
+    int chunkIndex;
+    for (chunkIndex = 0; chunkIndex < this->numSplitChunks; chunkIndex++)
+    {
+        SplitChunk* chunk = this->splitChunks[chunkIndex];
+        chunk->firstGroup = chunkIndex * SplitChunkSize;
+        chunk->numGroups = n_min(int(SplitChunkSize), numGroups - chunk->firstGroup);
+    }
+
+    // classify chunks in parallel
+    PROFILER_START(this->profBuildSplit);
+    this->RunBuildTasks(this->numSplitChunks, SplitNodesTask);
+    PROFILER_STOP(this->profBuildSplit);
+    WATCHER_SET_INT(watchNumBuildThreads, this->parallelBuild ? nWorkerPool::Instance()->GetNumThreads() : 1);
+
+    // merge chunk results in group order
+    PROFILER_START(this->profBuildMerge);
+    for (chunkIndex = 0; chunkIndex < this->numSplitChunks; chunkIndex++)
+    {
+        SplitChunk* chunk = this->splitChunks[chunkIndex];
+        int i;
+        for (i = 0; i < NumBuckets; i++)
+        {
+            if (chunk->shapeBucket[i].Size() > 0)
+            {
+                this->shapeBucket[i].AppendArray(chunk->shapeBucket[i]);
+                this->keyBucket[i].AppendArray(chunk->keyBucket[i]);
+            }
+        }
+        for (i = 0; i < chunk->lightArray.Size(); i++)
+        {
+            ushort groupIndex = chunk->lightArray[i];
+            this->groupArray[groupIndex].renderContext->SetSceneLightIndex(this->lightArray.Size());
+            LightInfo lightInfo;
+            lightInfo.groupIndex = groupIndex;
+            this->lightArray.Append(lightInfo);
+        }
+        this->shadowArray.AppendArray(chunk->shadowArray);
+        for (i = 0; i < chunk->specialArray.Size(); i++)
+        {
+            this->SplitSpecialGroup(chunk->specialArray[i]);
+        }
+    }
+    PROFILER_STOP(this->profBuildMerge);
+    PROFILER_STOP(this->profSplitNodes);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Evaluate the characters of all render contexts attached this frame.
+    The skin animators update the animation states on the calling thread,
+    then the animations are sampled and the skeletons are evaluated on
+    the worker pool, one task per character. Characters which have already
+    been evaluated this frame (for instance by an attachment node during
+    Attach()) are skipped by nSkinAnimator::PrepareEvaluation(), so are
+    render contexts which are attached more than once.
+
+    Characters whose animator has no valid resources are left to
+    nSkinAnimator::Animate() at render time.
+*/
+void
+nSceneServer::UpdateCharacters()
+{
+    PROFILER_START(this->profUpdateCharacters);
+    this->characterUpdates.Reset();
+
+    // the groups of a render context are contiguous in the group array
+    nRenderContext* prevRenderContext = 0;
+    int groupIndex;
+    int numGroups = this->groupArray.Size();
+    for (groupIndex = 0; groupIndex < numGroups; groupIndex++)
+    {
+        nRenderContext* renderContext = this->groupArray[groupIndex].renderContext;
+        if (renderContext == prevRenderContext)
+        {
+            continue;
+        }
+        prevRenderContext = renderContext;
+
+        // one character per skin animator in the render context's hierarchy
+        int varIndex;
+        int numVars = renderContext->localVarArray.Size();
+        for (varIndex = 0; varIndex < numVars; varIndex++)
+        {
+            const nVariable& var = renderContext->localVarArray[varIndex];
+            if (var.GetHandle() == this->charPointerVarHandle)
+            {
+                nCharacter2* character = (nCharacter2*)var.GetObj();
+                nSkinAnimator* animator = character ? character->GetSkinAnimator() : 0;
+                if (animator && animator->AreResourcesValid())
+                {
+                    CharacterUpdate update;
+                    update.animator = animator;
+                    if (animator->PrepareEvaluation(renderContext, update.eval))
                     {
-                        this->cameraArray.Append(i);
+                        this->characterUpdates.Append(update);
                     }
                 }
             }
         }
     }
-    PROFILER_STOP(this->profSplitNodes);
+
+    int numCharacters = this->characterUpdates.Size();
+    if (numCharacters > 0)
+    {
+        nCharacter2::SetupSampleBuffers(this->parallelBuild ? nWorkerPool::Instance()->GetNumThreads() : 1);
+        this->RunBuildTasks(numCharacters, UpdateCharactersTask);
+    }
+    WATCHER_SET_INT(watchNumCharacters, numCharacters);
+    PROFILER_STOP(this->profUpdateCharacters);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample the animation and evaluate the skeleton of one character.
+    Runs on a worker thread, touches only the character.
+*/
+void
+nSceneServer::UpdateCharactersTask(int taskIndex, int workerIndex, void* userData)
+{
+    nSceneServer* self = (nSceneServer*)userData;
+    const CharacterUpdate& update = self->characterUpdates[taskIndex];
+    update.animator->EvaluateCharacter(update.eval, workerIndex);
 }
 
 //------------------------------------------------------------------------------
 /**
     This makes sure that all attached shape and light nodes have
     loaded their resources. This method is available
-    as a convenience method for subclasses.
+    as a convenience method for subclasses. Only looks at the groups
+    which have been found invalid by SplitNodes().
 */
 void
 nSceneServer::ValidateNodeResources()
 {
     PROFILER_START(this->profValidateResources);
+    PROFILER_START(this->profBuildLoad);
 
     // need to evaluate camera nodes first, because they create
     // textures used by other nodes
@@ -514,67 +854,123 @@ nSceneServer::ValidateNodeResources()
         }
     }
 
-    // then evaluate the rest
-    num = this->groupArray.Size();
-    for (i = 0; i < num; i++)
+    // then evaluate the rest, several groups may share a scene node,
+    // so check again before loading
+    int chunkIndex;
+    for (chunkIndex = 0; chunkIndex < this->numSplitChunks; chunkIndex++)
     {
-        const Group& group = this->groupArray[i];
-        if (!group.sceneNode->AreResourcesValid())
+        const nArray<ushort>& invalidArray = this->splitChunks[chunkIndex]->invalidArray;
+        int j;
+        for (j = 0; j < invalidArray.Size(); j++)
         {
-            group.sceneNode->LoadResources();
+            const Group& group = this->groupArray[invalidArray[j]];
+            if (!group.sceneNode->AreResourcesValid())
+            {
+                group.sceneNode->LoadResources();
+            }
         }
     }
+    PROFILER_STOP(this->profBuildLoad);
     PROFILER_STOP(this->profValidateResources);
 }
 
 //------------------------------------------------------------------------------
 /**
-    The scene node sorting compare function. The goal is to sort the attached
-    shape nodes for optimal rendering performance.
+    Find out in which depth order the shapes of each shader bucket should
+    be rendered. This is defined by the sort attribute of the render path
+    phases. If a bucket is used by phases with different sorting orders,
+    BackToFront wins, because that is needed for correct alpha blending.
 */
-int
-__cdecl
-nSceneServer::CompareNodes(const ushort* i1, const ushort* i2)
+void
+nSceneServer::UpdateBucketSortingOrders()
 {
-    nSceneServer* sceneServer = nSceneServer::Singleton;
-    const nSceneServer::Group& g1 = sceneServer->groupArray[*i1];
-    const nSceneServer::Group& g2 = sceneServer->groupArray[*i2];
-
-    // by render priority
-    int cmp = g1.sceneNode->GetRenderPri() - g2.sceneNode->GetRenderPri();
-    if (cmp != 0)
+    int bucketIndex;
+    for (bucketIndex = 0; bucketIndex < NumBuckets; bucketIndex++)
     {
-        return cmp;
+        this->bucketSortingOrder[bucketIndex] = nRpPhase::None;
     }
-
-    // by identical scene node
-    cmp = int(g1.sceneNode) - int(g2.sceneNode);
-    if (cmp == 0)
+    const nArray<nRpSection>& sections = this->renderPath.GetSections();
+    int sectionIndex;
+    for (sectionIndex = 0; sectionIndex < sections.Size(); sectionIndex++)
     {
-        return cmp;
+        const nArray<nRpPass>& passes = sections[sectionIndex].GetPasses();
+        int passIndex;
+        for (passIndex = 0; passIndex < passes.Size(); passIndex++)
+        {
+            const nArray<nRpPhase>& phases = passes[passIndex].GetPhases();
+            int phaseIndex;
+            for (phaseIndex = 0; phaseIndex < phases.Size(); phaseIndex++)
+            {
+                nRpPhase::SortingOrder order = phases[phaseIndex].GetSortingOrder();
+                const nArray<nRpSequence>& seqs = phases[phaseIndex].GetSequences();
+                int seqIndex;
+                for (seqIndex = 0; seqIndex < seqs.Size(); seqIndex++)
+                {
+                    bucketIndex = seqs[seqIndex].GetShaderBucketIndex();
+                    if ((bucketIndex >= 0) && (bucketIndex < NumBuckets))
+                    {
+                        nRpPhase::SortingOrder& curOrder = this->bucketSortingOrder[bucketIndex];
+                        if ((nRpPhase::None == curOrder) || (nRpPhase::BackToFront == order))
+                        {
+                            curOrder = order;
+                        }
+                    }
+                }
+            }
+        }
     }
+}
 
-    // distance to viewer (closest first)
-    static vector3 dist1;
-    static vector3 dist2;
-    dist1.set(viewerPos.x - g1.modelTransform.M41, viewerPos.y - g1.modelTransform.M42, viewerPos.z - g1.modelTransform.M43);
-    dist2.set(viewerPos.x - g2.modelTransform.M41, viewerPos.y - g2.modelTransform.M42, viewerPos.z - g2.modelTransform.M43);
-    float diff = dist1.lensquared() - dist2.lensquared();
+//------------------------------------------------------------------------------
+/**
+    Compute the 64 bit sort key of a shape group. Shapes are already
+    bucketed by shader (which selects the render path sequence), inside a
+    bucket the key orders by:
+
+    - bits 56..63: render priority (biased by 128)
+    - FrontToBack and None buckets: bits 32..55 shape node id (keeps
+      instances of the same mesh/material together), bits 0..31 viewer
+      distance (0 for None)
+    - BackToFront buckets: bits 24..55 inverted viewer distance, bits
+      0..23 shape node id
+
+    The distance is the squared viewer distance as float, the bit pattern
+    of a positive float sorts like an unsigned integer. Called from
+    worker threads.
+*/
+uint64
+nSceneServer::ComputeSortKey(const Group& group, int bucketIndex) const
+{
+    int pri = n_iclamp(group.sceneNode->GetRenderPri() + 128, 0, 255);
+    uint nodeId = (uint(size_t(group.sceneNode)) >> 4) & 0x00ffffff;
+    uint64 key = uint64(pri) << 56;
 
-    if (sortingOrder == nRpPhase::FrontToBack)
+    nRpPhase::SortingOrder order = this->bucketSortingOrder[bucketIndex];
+    if (nRpPhase::None == order)
     {
-        // (closest first)
-        if (diff < 0.001f)      return -1;
-        if (diff > 0.001f)      return 1;
+        key |= uint64(nodeId) << 32;
     }
-    else if (sortingOrder == nRpPhase::BackToFront)
+    else
     {
-        if (diff > 0.001f)      return -1;
-        if (diff < 0.001f)      return 1;
+        vector3 dist(this->viewerPos.x - group.modelTransform.M41,
+                     this->viewerPos.y - group.modelTransform.M42,
+                     this->viewerPos.z - group.modelTransform.M43);
+        union
+        {
+            float f;
+            uint u;
+        } depth;
+        depth.f = dist.lensquared();
+        if (nRpPhase::FrontToBack == order)
+        {
+            key |= (uint64(nodeId) << 32) | uint64(depth.u);
+        }
+        else
+        {
+            key |= (uint64(~depth.u) << 24) | uint64(nodeId);
+        }
     }
-
-    // nodes are identical
-    return 0;
+    return key;
 }
 
 //------------------------------------------------------------------------------
@@ -589,6 +985,7 @@ nSceneServer::CompareShadowLights(const LightInfo* i1, const LightInfo* i2)
     nSceneServer* sceneServer = nSceneServer::Singleton;
     const nSceneServer::Group& g1 = sceneServer->groupArray[i1->groupIndex];
     const nSceneServer::Group& g2 = sceneServer->groupArray[i2->groupIndex];
+    const vector3& viewerPos = sceneServer->viewerPos;
 
     // compute intensity
     static vector3 dist1;
@@ -608,6 +1005,24 @@ nSceneServer::CompareShadowLights(const LightInfo* i1, const LightInfo* i2)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Sorts a single shape bucket by the keys computed in the split pass.
+    Runs on a worker thread.
+*/
+void
+nSceneServer::SortNodesTask(int taskIndex, int /*workerIndex*/, void* userData)
+{
+    nSceneServer* self = (nSceneServer*) userData;
+    nArray<ushort>& indices = self->shapeBucket[taskIndex];
+    nArray<uint64>& keys = self->keyBucket[taskIndex];
+    n_assert(indices.Size() == keys.Size());
+    if (indices.Size() > 1)
+    {
+        self->bucketSorter[taskIndex].Sort(keys.Begin(), indices.Begin(), indices.Size());
+    }
+}
+
 //------------------------------------------------------------------------------
 /**
     Sort the indices in the shape array for optimal rendering.
@@ -617,21 +1032,10 @@ nSceneServer::SortNodes()
 {
     PROFILER_START(this->profSortNodes);
 
-    // initialize the static viewer pos vector
-    viewerPos = nGfxServer2::Instance()->GetTransform(nGfxServer2::InvView).pos_component();
-
-    // for each bucket: call the sorter hook
-    int i;
-    int num = this->shapeBucket.Size();
-    for (i = 0; i < num; i++)
-    {
-        int numIndices = this->shapeBucket[i].Size();
-        if (numIndices > 0)
-        {
-            ushort* indexPtr = (ushort*)this->shapeBucket[i].Begin();
-            qsort(indexPtr, numIndices, sizeof(ushort), (int(__cdecl*)(const void*, const void*))CompareNodes);
-        }
-    }
+    // sort the buckets in parallel, one task per bucket
+    PROFILER_START(this->profBuildSort);
+    this->RunBuildTasks(this->shapeBucket.Size(), SortNodesTask);
+    PROFILER_STOP(this->profBuildSort);
 
     // sort shadow casting light sources
     int numShadowLights = this->shadowLightArray.Size();
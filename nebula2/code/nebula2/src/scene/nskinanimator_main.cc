@@ -149,12 +149,18 @@ nSkinAnimator::RenderContextCreated(nRenderContext* renderContext)
 
 //------------------------------------------------------------------------------
 /**
-    - 15-Jan-04     floh    AreResourcesValid()/LoadResource() moved to scene server
+    Update the animation enabled flag and the animation state of the
+    character which belongs to a render context. Returns false if the
+    character has already been evaluated for the render context's frame,
+    otherwise marks the character as evaluated and fills outEval for
+    EvaluateCharacter().
+
+    Must be called on the main thread, since it reads the render context
+    variables and the character set.
 */
-void
-nSkinAnimator::Animate(nSceneNode* sceneNode, nRenderContext* renderContext)
+bool
+nSkinAnimator::PrepareEvaluation(nRenderContext* renderContext, Evaluation& outEval)
 {
-    n_assert(sceneNode);
     n_assert(renderContext);
     n_assert(nVariable::InvalidHandle != this->channelVarHandle);
 
@@ -167,59 +173,95 @@ nSkinAnimator::Animate(nSceneNode* sceneNode, nRenderContext* renderContext)
 
     // check if I am already uptodate for this frame
     uint curFrameId = renderContext->GetFrameId();
-    if (curCharacter->GetLastEvaluationFrameId() != curFrameId)
+    if (curCharacter->GetLastEvaluationFrameId() == curFrameId)
     {
-        curCharacter->SetLastEvaluationFrameId(curFrameId);
+        return false;
+    }
+    curCharacter->SetLastEvaluationFrameId(curFrameId);
 
-        // get the sample time from the render context
-        nVariable* var = renderContext->GetVariable(this->channelVarHandle);
-        n_assert2(0 != var, "nSkinAnimator::Animate: TimeChannel Variable in RenderContext.\n");
-        float curTime = var->GetFloat();
+    // get the sample time from the render context
+    nVariable* var = renderContext->GetVariable(this->channelVarHandle);
+    n_assert2(0 != var, "nSkinAnimator::Animate: TimeChannel Variable in RenderContext.\n");
+    float curTime = var->GetFloat();
 
-        // get the time offset from the render context
-        var = renderContext->GetVariable(this->channelOffsetVarHandle);
-        float curOffset = 0 != var ? var->GetFloat() : 0.0f;
+    const nVariable& character2SetVar = renderContext->GetLocalVar(this->characterSetIndex);
+    nCharacter2Set* characterSet = (nCharacter2Set*)character2SetVar.GetObj();
+    n_assert(characterSet);
 
-        const nVariable& character2SetVar = renderContext->GetLocalVar(this->characterSetIndex);
-        nCharacter2Set* characterSet = (nCharacter2Set*)character2SetVar.GetObj();
-        n_assert(characterSet);
+    // get character 2 set from render context and check if animation state needs to be updated
+    if (characterSet->IsDirty())
+    {
+        nAnimStateInfo newState;
+        int numClips = characterSet->GetNumClips();
 
-        // get character 2 set from render context and check if animation state needs to be updated
-        if (characterSet->IsDirty())
+        float weightSum = 0.0f;
+        for (int i = 0; i < numClips; i++)
         {
-            nAnimStateInfo newState;
-            int numClips = characterSet->GetNumClips();
+            weightSum += characterSet->GetClipWeightAt(i);
+        }
 
-            float weightSum = 0.0f;
+        // add clips
+        if (weightSum > 0)
+        {
+            newState.SetStateStarted(curTime);
+            newState.SetFadeInTime(characterSet->GetFadeInTime());
+            newState.BeginClips(numClips);
             for (int i = 0; i < numClips; i++)
             {
-                weightSum += characterSet->GetClipWeightAt(i);
-            }
-
-            // add clips
-            if (weightSum > 0)
-            {
-                newState.SetStateStarted(curTime);
-                newState.SetFadeInTime(characterSet->GetFadeInTime());
-                newState.BeginClips(numClips);
-                for (int i = 0; i < numClips; i++)
+                int index = this->GetClipIndexByName(characterSet->GetClipNameAt(i));
+                if (-1 == index)
                 {
-                    int index = this->GetClipIndexByName(characterSet->GetClipNameAt(i));
-                    if (-1 == index)
-                    {
-                        n_error("nSkinAnimator::Animate(): Requested clip \"%s\" does not exist.\n", characterSet->GetClipNameAt(i).Get());
-                    }
-                    newState.SetClip(i, this->GetClipAt(index), characterSet->GetClipWeightAt(i) / weightSum);
+                    n_error("nSkinAnimator::Animate(): Requested clip \"%s\" does not exist on \"%s\".\n", characterSet->GetClipNameAt(i).Get(), this->GetFullName().Get());
                 }
-                newState.EndClips();
+                newState.SetClip(i, this->GetClipAt(index), characterSet->GetClipWeightAt(i) / weightSum);
             }
-
-            curCharacter->SetActiveState(newState);
-            characterSet->SetDirty(false);
+            newState.EndClips();
         }
 
-        // evaluate the current state of the character skeleton
-        curCharacter->EvaluateSkeleton(curTime);
+        curCharacter->SetActiveState(newState);
+        characterSet->SetDirty(false);
+    }
+
+    outEval.character = curCharacter;
+    outEval.time = curTime;
+    outEval.variation = -1;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Evaluate the current state of a character prepared by
+    PrepareEvaluation(). Only touches the character itself, so different
+    characters may be evaluated on different threads at the same time,
+    each with its own worker index.
+*/
+void
+nSkinAnimator::EvaluateCharacter(const Evaluation& eval, int workerIndex) const
+{
+    n_assert(eval.character);
+    eval.character->EvaluateSkeleton(eval.time, workerIndex);
+}
+
+//------------------------------------------------------------------------------
+/**
+    - 15-Jan-04     floh    AreResourcesValid()/LoadResource() moved to scene server
+*/
+void
+nSkinAnimator::Animate(nSceneNode* sceneNode, nRenderContext* renderContext)
+{
+    n_assert(sceneNode);
+    n_assert(renderContext);
+
+    const nVariable& characterVar = renderContext->GetLocalVar(this->characterVarIndex);
+    nCharacter2* curCharacter = (nCharacter2*)characterVar.GetObj();
+    n_assert(curCharacter);
+
+    // evaluate the character, unless this already happened in the
+    // scene server's character update phase or in another pass
+    Evaluation eval;
+    if (this->PrepareEvaluation(renderContext, eval))
+    {
+        this->EvaluateCharacter(eval, 0);
     }
 
     // update the source node with the new char skeleton state
@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "shadow2/nskinnedshadowcaster2.h"
 #include "shadow2/nshadowserver2.h"
+#include "deformers/nskinmeshdeformer.h"
 
 nNebulaClass(nSkinnedShadowCaster2, "nshadowcaster2");
 
@@ -12,7 +13,8 @@ nNebulaClass(nSkinnedShadowCaster2, "nshadowcaster2");
 */
 nSkinnedShadowCaster2::nSkinnedShadowCaster2() :
     charSkeleton(0),
-    charSkeletonDirty(false)
+    charSkeletonDirty(false),
+    skinMatrices(0, 0)
 {
     // empty
 }
@@ -242,10 +244,8 @@ nSkinnedShadowCaster2::RenderShadowVolume()
 /**
     This method performs the actual skinning on the CPU and writes the
     skinned vertices into the refSkinnedMesh. A valid and uptodate character
-    skeleton must be set through
-
-    FIXME: performance optimization: convert float joint indices to integer
-    during load time?
+    skeleton must be set through SetCharSkeleton(). The positions are
+    skinned by nSkinMeshDeformer's skinning kernel.
 */
 void
 nSkinnedShadowCaster2::UpdateSkinning()
@@ -261,35 +261,38 @@ nSkinnedShadowCaster2::UpdateSkinning()
     n_assert((2 * numSrcVertices) == numDstVertices);
     n_assert(srcMesh->GetVertexWidth() == 11); // COORD(3) + WEIGHTS(4) + JINDICES(4) = 11 floats
 
+    // the joint indices of the shadow mesh index the skeleton directly
+    int numJoints = this->charSkeleton->GetNumJoints();
+    if (this->skinMatrices.Size() != numJoints)
+    {
+        this->skinMatrices.SetFixedSize(numJoints);
+    }
+    int jointIndex;
+    for (jointIndex = 0; jointIndex < numJoints; jointIndex++)
+    {
+        this->skinMatrices[jointIndex] = this->charSkeleton->GetJointAt(jointIndex).GetSkinMatrix44();
+    }
+
+    // skin into the unextruded vertex positions
     float* srcVertices = srcMesh->LockVertices() + srcGroup.GetFirstVertex();
     float* dstVertices = dstMesh->LockVertices() + dstGroup.GetFirstVertex();
-    vector3 v;
+    if (numJoints > 0)
+    {
+        nSkinMeshDeformer::SkinPositions(&(this->skinMatrices[0]), srcVertices, 11, 3, 7, dstVertices, 8, numSrcVertices);
+    }
+
+    // copy to the extruded vertex positions, note, we are filling a dynamic
+    // vertex buffer which will be discarded after rendering, so we NEED to
+    // write seemingly constant data (the extrude weights) as well!
     int index;
     for (index = 0; index < numSrcVertices; index++)
     {
-        // perform weighted skinning
-        const vector3& srcVec = *((vector3*)srcVertices);
-        float* weights = &srcVertices[3];
-        float* indices = &srcVertices[7];
-        v.set(0.0f, 0.0f, 0.0f);
-        int i;
-        for (i = 0; i < 4; i++)
-        {
-            if (weights[i] > 0.0f)
-            {
-                const matrix44& skinMatrix = this->charSkeleton->GetJointAt(int(indices[i])).GetSkinMatrix44();
-                skinMatrix.weighted_madd(srcVec, v, weights[i]);
-            }
-        }
-
-        // write skinned vertex to unextruded and extruded vertex position, note, we are filling
-        // a dynamic vertex buffer which will be discarded after rendering, so we NEED to write
-        // seemingly constant data (the extrude weights) as well!
-        *dstVertices++ = v.x; *dstVertices++ = v.y; *dstVertices++ = v.z; *dstVertices++ = 0.0f;
-        *dstVertices++ = v.x; *dstVertices++ = v.y; *dstVertices++ = v.z; *dstVertices++ = 1.0f;
-
-        // set to next src vertex
-        srcVertices += 11;
+        dstVertices[3] = 0.0f;
+        dstVertices[4] = dstVertices[0];
+        dstVertices[5] = dstVertices[1];
+        dstVertices[6] = dstVertices[2];
+        dstVertices[7] = 1.0f;
+        dstVertices += 8;
     }
     dstMesh->UnlockVertices();
     srcMesh->UnlockVertices();
@@ -228,6 +228,16 @@ nSqlDatabase::CreateQuery(const nString& sqlStatement)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+*/
+nSqlStatement*
+nSqlDatabase::CreateStatement(const nString& sqlStatement, bool failOnError)
+{
+    // empty, override in subclass
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -5,6 +5,7 @@
 #include "sql/nsqlite3database.h"
 #include "kernel/nfileserver2.h"
 #include "sql/nsqlite3query.h"
+#include "sql/nsqlite3statement.h"
 
 nNebulaClass(nSQLite3Database, "nsqldatabase");
 
@@ -99,6 +100,26 @@ nSQLite3Database::CreateQuery(const nString& sqlStatement)
     return query;
 }
 
+//------------------------------------------------------------------------------
+/**
+    This method creates a new prepared SQL statement. The statement is
+    compiled once and can then be executed many times with different
+    parameter values. If the statement can't be compiled, the method
+    fails hard, or returns 0 if failOnError is false.
+*/
+nSqlStatement*
+nSQLite3Database::CreateStatement(const nString& sqlStatement, bool failOnError)
+{
+    n_assert(this->IsLoaded());
+    nSQLite3Statement* statement = new nSQLite3Statement(this);
+    if (!statement->Prepare(sqlStatement, failOnError))
+    {
+        statement->Release();
+        return 0;
+    }
+    return statement;
+}
+
 //------------------------------------------------------------------------------
 /**
     This method checks if a table of the given name exists in the
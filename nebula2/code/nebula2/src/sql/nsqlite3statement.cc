@@ -0,0 +1,281 @@
+//------------------------------------------------------------------------------
+//  sql/nsqlite3statement.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "sql/nsqlite3statement.h"
+#include "sql/nsqlite3database.h"
+#include "sql/nsqlite3query.h"
+
+//------------------------------------------------------------------------------
+/**
+*/
+nSQLite3Statement::nSQLite3Statement(nSQLite3Database* db) :
+    refDatabase(db),
+    columns(32, 32),
+    sqliteStmt(0),
+    isFirstStep(true)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nSQLite3Statement::~nSQLite3Statement()
+{
+    if (0 != this->sqliteStmt)
+    {
+        sqlite3_finalize(this->sqliteStmt);
+        this->sqliteStmt = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compiles the SQL statement and gathers the result column names.
+    Returns false if the statement could not be compiled (for instance
+    because it refers to a table which doesn't exist).
+*/
+bool
+nSQLite3Statement::Prepare(const nString& sql, bool failOnError)
+{
+    n_assert(0 == this->sqliteStmt);
+    this->sqlStatement = sql;
+    int err = sqlite3_prepare_v2(this->refDatabase->GetDatabaseHandle(),
+                                 this->sqlStatement.Get(),
+                                 this->sqlStatement.Length(),
+                                 &this->sqliteStmt,
+                                 0);
+    if (SQLITE_OK != err)
+    {
+        if (failOnError)
+        {
+            n_error("nSQLite3Statement::Prepare(): sqlite3_prepare_v2() failed with '%s'\n(SQL Statement: %s)",
+                sqlite3_errmsg(this->refDatabase->GetDatabaseHandle()),
+                this->sqlStatement.Get());
+        }
+        return false;
+    }
+    this->UpdateColumns();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Gathers the result column names. SQLite3 recompiles a statement in
+    sqlite3_step() when the database schema has changed, so this is done
+    again after the first step of each execution.
+*/
+void
+nSQLite3Statement::UpdateColumns()
+{
+    this->columns.Clear();
+    int colIndex;
+    int numCols = sqlite3_column_count(this->sqliteStmt);
+    for (colIndex = 0; colIndex < numCols; colIndex++)
+    {
+        this->columns.Append(sqlite3_column_name(this->sqliteStmt, colIndex));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::CheckBind(int err) const
+{
+    if (SQLITE_OK != err)
+    {
+        n_error("nSQLite3Statement: sqlite3_bind() failed with '%s'\n(SQL Statement: %s)",
+            sqlite3_errmsg(this->refDatabase->GetDatabaseHandle()),
+            this->sqlStatement.Get());
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const nString&
+nSQLite3Statement::GetSqlStatement() const
+{
+    return this->sqlStatement;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nSQLite3Statement::GetNumParameters() const
+{
+    n_assert(this->sqliteStmt);
+    return sqlite3_bind_parameter_count(this->sqliteStmt);
+}
+
+//------------------------------------------------------------------------------
+/**
+    NOTE: SQLite3 counts parameters from 1, nSqlStatement from 0.
+*/
+void
+nSQLite3Statement::BindNull(int paramIndex)
+{
+    n_assert(this->sqliteStmt);
+    this->CheckBind(sqlite3_bind_null(this->sqliteStmt, paramIndex + 1));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::BindInt(int paramIndex, int val)
+{
+    n_assert(this->sqliteStmt);
+    this->CheckBind(sqlite3_bind_int(this->sqliteStmt, paramIndex + 1, val));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::BindFloat(int paramIndex, float val)
+{
+    n_assert(this->sqliteStmt);
+    this->CheckBind(sqlite3_bind_double(this->sqliteStmt, paramIndex + 1, double(val)));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::BindString(int paramIndex, const nString& val)
+{
+    n_assert(this->sqliteStmt);
+    this->CheckBind(sqlite3_bind_text(this->sqliteStmt, paramIndex + 1, val.Get(), val.Length(), SQLITE_TRANSIENT));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::BindBlob(int paramIndex, const void* ptr, int size)
+{
+    n_assert(this->sqliteStmt);
+    n_assert(ptr && (size >= 0));
+    this->CheckBind(sqlite3_bind_blob(this->sqliteStmt, paramIndex + 1, ptr, size, SQLITE_TRANSIENT));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Executes the statement until the next result row is available, or
+    until the statement has finished.
+*/
+nSqlStatement::Result
+nSQLite3Statement::Step(bool failOnError)
+{
+    n_assert(this->sqliteStmt);
+    int err = sqlite3_step(this->sqliteStmt);
+    if (this->isFirstStep)
+    {
+        this->UpdateColumns();
+        this->isFirstStep = false;
+    }
+    if (SQLITE_ROW == err)
+    {
+        return Row;
+    }
+    else if (SQLITE_DONE == err)
+    {
+        #ifdef __NEBULA_STATS__
+        // count the db accesses per frame
+        nSQLite3Query::dbAccessCount++;
+        #endif
+        return Done;
+    }
+    if (failOnError)
+    {
+        n_error("nSQLite3Statement::Step(): sqlite3_step() failed with '%s'\n(SQL Statement: %s)",
+            sqlite3_errmsg(this->refDatabase->GetDatabaseHandle()),
+            this->sqlStatement.Get());
+    }
+    return Error;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSQLite3Statement::Reset()
+{
+    n_assert(this->sqliteStmt);
+    sqlite3_reset(this->sqliteStmt);
+    sqlite3_clear_bindings(this->sqliteStmt);
+    this->isFirstStep = true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const nArray<nString>&
+nSQLite3Statement::GetColumns() const
+{
+    return this->columns;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nSqlStatement::ColumnType
+nSQLite3Statement::GetColumnType(int colIndex) const
+{
+    n_assert(this->sqliteStmt);
+    switch (sqlite3_column_type(this->sqliteStmt, colIndex))
+    {
+        case SQLITE_INTEGER:    return Int;
+        case SQLITE_FLOAT:      return Float;
+        case SQLITE_TEXT:       return String;
+        case SQLITE_BLOB:       return Blob;
+        default:                return Null;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nSQLite3Statement::GetInt(int colIndex) const
+{
+    n_assert(this->sqliteStmt);
+    return sqlite3_column_int(this->sqliteStmt, colIndex);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+float
+nSQLite3Statement::GetFloat(int colIndex) const
+{
+    n_assert(this->sqliteStmt);
+    return float(sqlite3_column_double(this->sqliteStmt, colIndex));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nString
+nSQLite3Statement::GetString(int colIndex) const
+{
+    n_assert(this->sqliteStmt);
+    const char* text = (const char*) sqlite3_column_text(this->sqliteStmt, colIndex);
+    return nString(text ? text : "");
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const void*
+nSQLite3Statement::GetBlob(int colIndex, int& size) const
+{
+    n_assert(this->sqliteStmt);
+    const void* ptr = sqlite3_column_blob(this->sqliteStmt, colIndex);
+    size = sqlite3_column_bytes(this->sqliteStmt, colIndex);
+    return ptr;
+}
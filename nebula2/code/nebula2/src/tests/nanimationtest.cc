@@ -0,0 +1,302 @@
+//------------------------------------------------------------------------------
+//  nanimationtest.cc
+//
+//  Stress test for nMemoryAnimation::SampleCurves(). One animation with
+//  step, linear, quaternion and collapsed curves is sampled serially,
+//  then the same samples are taken from -threads threads at once, every
+//  thread starting at a different time. All results must be bit identical
+//  to the serial ones and the start values of the curves must not change.
+//  This runs with the raw keys and with packed keys.
+//
+//  Command line args:
+//  -threads    number of sampling threads (default: 16)
+//  -repeat     number of passes over all sample times per thread (default: 20)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "anim2/nmemoryanimation.h"
+#include "kernel/nkernelserver.h"
+#include "kernel/nthread.h"
+#include "kernel/ninterlocked.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int NumJoints = 30;
+static const int NumCurves = NumJoints * 3 + 2;
+static const int NumKeys = 100;
+static const int NumSamples = 997;
+static const float KeyTime = 1.0f / 25.0f;
+
+static volatile long StartFlag = 0;
+
+//------------------------------------------------------------------------------
+/**
+    Fills the animation with synthetic keys, like a character animation
+    with NumJoints joints (translation, rotation, scale), one step curve
+    and one collapsed curve per group.
+*/
+class nTestAnimation : public nMemoryAnimation
+{
+public:
+    /// create the groups and keys, optionally pack them
+    void Setup(bool packKeys);
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nTestAnimation::Setup(bool packKeys)
+{
+    nRandom random(4711);
+    this->SetNumGroups(2);
+    this->keyArray.SetFixedSize(2 * NumCurves * NumKeys);
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < 2; groupIndex++)
+    {
+        int startKey = groupIndex * NumCurves * NumKeys;
+        Group& group = this->GetGroupAt(groupIndex);
+        group.SetNumCurves(NumCurves);
+        group.SetStartKey(0);
+        group.SetNumKeys(NumKeys);
+        group.SetKeyStride(NumCurves);
+        group.SetKeyTime(KeyTime);
+        group.SetFadeInFrames(0.0f);
+        group.SetLoopType((0 == groupIndex) ? Group::Repeat : Group::Clamp);
+
+        int curveIndex;
+        for (curveIndex = 0; curveIndex < NumCurves; curveIndex++)
+        {
+            Curve& curve = group.GetCurveAt(curveIndex);
+            curve.SetConstValue(vector4(1.0f, 2.0f, 3.0f, 4.0f));
+            if (curveIndex == NumCurves - 1)
+            {
+                // a collapsed curve
+                curve.SetIpolType(Curve::Linear);
+                curve.SetFirstKeyIndex(-1);
+                curve.SetIsAnimated(0);
+                continue;
+            }
+            Curve::IpolType ipolType = Curve::Linear;
+            if (curveIndex == NumCurves - 2)
+            {
+                ipolType = Curve::Step;
+            }
+            else if (1 == (curveIndex % 3))
+            {
+                ipolType = Curve::Quat;
+            }
+            curve.SetIpolType(ipolType);
+            curve.SetFirstKeyIndex(startKey + curveIndex);
+            curve.SetIsAnimated(1);
+
+            int key;
+            for (key = 0; key < NumKeys; key++)
+            {
+                vector4& value = this->keyArray[startKey + key * NumCurves + curveIndex];
+                if (Curve::Quat == ipolType)
+                {
+                    quaternion q;
+                    q.set_rotate_axis_angle(vector3(0.0f, 1.0f, 0.0f), random.Rand(-N_PI, N_PI));
+                    value.set(q.x, q.y, q.z, q.w);
+                }
+                else
+                {
+                    value.set(random.Rand(-1.0f, 1.0f), random.Rand(-1.0f, 1.0f), random.Rand(-1.0f, 1.0f), 1.0f);
+                }
+            }
+        }
+    }
+    if (packKeys)
+    {
+        this->PackKeys();
+    }
+    this->UpdateStartValues();
+}
+
+/// the work of one sampling thread
+struct SampleJob
+{
+    const nAnimation* anim;
+    const vector4* reference;
+    int firstSample;
+    int numRepeats;
+    volatile long numWrong;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The time of a sample, covers the animation twice and some negative
+    times.
+*/
+static float
+SampleTime(int sample)
+{
+    return (float(sample) / float(NumSamples)) * (2.5f * NumKeys * KeyTime) - (0.5f * NumKeys * KeyTime);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample all curves of both groups at all sample times into dst.
+*/
+static void
+SampleAll(const nAnimation* anim, vector4* dst)
+{
+    int sample;
+    for (sample = 0; sample < NumSamples; sample++)
+    {
+        int groupIndex;
+        for (groupIndex = 0; groupIndex < 2; groupIndex++)
+        {
+            anim->SampleCurves(SampleTime(sample), groupIndex, 0, NumCurves, dst + (sample * 2 + groupIndex) * NumCurves);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample the animation numRepeats times, starting at a different sample
+    in every thread, and count the results which differ from the serial
+    results.
+*/
+static int
+N_THREADPROC
+SampleThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    SampleJob* job = (SampleJob*) thread->LockUserData();
+    thread->UnlockUserData();
+
+    // start all threads at once
+    while (0 == n_interlocked_read(&StartFlag))
+    {
+        n_sleep(0.0);
+    }
+
+    vector4 keys[NumCurves];
+    int repeat;
+    for (repeat = 0; repeat < job->numRepeats; repeat++)
+    {
+        int i;
+        for (i = 0; i < NumSamples; i++)
+        {
+            int sample = (job->firstSample + i) % NumSamples;
+            int groupIndex;
+            for (groupIndex = 0; groupIndex < 2; groupIndex++)
+            {
+                job->anim->SampleCurves(SampleTime(sample), groupIndex, 0, NumCurves, keys);
+                const vector4* ref = job->reference + (sample * 2 + groupIndex) * NumCurves;
+                if (0 != memcmp(keys, ref, sizeof(keys)))
+                {
+                    n_interlocked_increment(&job->numWrong);
+                }
+            }
+        }
+    }
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestAnimation(bool packKeys, int numThreads, int numRepeats)
+{
+    nTestAnimation* anim = n_new(nTestAnimation);
+    anim->Setup(packKeys);
+    n_test(packKeys == anim->IsGroupPacked(0));
+
+    // the serial results and start values
+    int numKeys = NumSamples * 2 * NumCurves;
+    vector4* reference = n_new_array(vector4, numKeys);
+    vector4* serial = n_new_array(vector4, numKeys);
+    vector4 startValues[2][NumCurves];
+    int groupIndex;
+    int curveIndex;
+    for (groupIndex = 0; groupIndex < 2; groupIndex++)
+    {
+        for (curveIndex = 0; curveIndex < NumCurves; curveIndex++)
+        {
+            startValues[groupIndex][curveIndex] = anim->GetGroupAt(groupIndex).GetCurveAt(curveIndex).GetStartValue();
+        }
+    }
+    nTest::Timer timer;
+    SampleAll(anim, reference);
+    double serialTime = timer.GetTime();
+    SampleAll(anim, serial);
+    n_test(0 == memcmp(reference, serial, numKeys * sizeof(vector4)));
+
+    // the start values are the values at time 0
+    vector4 keys[NumCurves];
+    anim->SampleCurves(0.0f, 0, 0, NumCurves, keys);
+    n_test(0 == memcmp(keys, startValues[0], sizeof(keys)));
+
+    // sample from all threads at once
+    nArray<SampleJob> jobs;
+    nArray<nThread*> threads;
+    jobs.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    StartFlag = 0;
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].anim = anim;
+        jobs[i].reference = reference;
+        jobs[i].firstSample = (i * NumSamples) / numThreads;
+        jobs[i].numRepeats = numRepeats;
+        jobs[i].numWrong = 0;
+        threads[i] = n_new(nThread(SampleThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+    }
+    timer.Start();
+    n_interlocked_exchange(&StartFlag, 1);
+    int numWrong = 0;
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(threads[i]);
+        numWrong += n_interlocked_read(&jobs[i].numWrong);
+    }
+    double threadTime = timer.GetTime();
+    n_test(0 == numWrong);
+
+    // nothing may have changed the start values
+    int numChanged = 0;
+    for (groupIndex = 0; groupIndex < 2; groupIndex++)
+    {
+        for (curveIndex = 0; curveIndex < NumCurves; curveIndex++)
+        {
+            vector4 startValue = anim->GetGroupAt(groupIndex).GetCurveAt(curveIndex).GetStartValue();
+            if (0 != memcmp(&startValue, &startValues[groupIndex][curveIndex], sizeof(vector4)))
+            {
+                numChanged++;
+            }
+        }
+    }
+    n_test(0 == numChanged);
+
+    double numSampled = double(NumSamples * 2 * NumCurves);
+    printf("%s keys: serial %.2f M curves/s, %d threads %.2f M curves/s\n",
+           packKeys ? "packed" : "raw", (numSampled / serialTime) / 1000000.0,
+           numThreads, ((numSampled * numThreads * numRepeats) / threadTime) / 1000000.0);
+
+    n_delete_array(serial);
+    n_delete_array(reference);
+    n_delete(anim);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numThreads = n_max(1, args.GetIntArg("-threads", 16));
+    int numRepeats = n_max(1, args.GetIntArg("-repeat", 20));
+
+    nKernelServer kernelServer;
+    TestAnimation(false, numThreads, numRepeats);
+    TestAnimation(true, numThreads, numRepeats);
+    return nTest::Finish("nanimationtest");
+}
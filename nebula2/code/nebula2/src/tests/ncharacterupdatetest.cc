@@ -0,0 +1,496 @@
+//------------------------------------------------------------------------------
+//  ncharacterupdatetest.cc
+//
+//  Tests and benchmarks the character update phase of nSceneServer.
+//  A synthetic skin animation with 3 clips is written to temp: and loaded
+//  by an nSkinAnimator, every render context of the animator gets its own
+//  character. Each frame the characters are prepared on the calling
+//  thread with nSkinAnimator::PrepareEvaluation() and evaluated with
+//  nSkinAnimator::EvaluateCharacter(), like nSceneServer::UpdateCharacters()
+//  does: once serially and once on the worker pool with one task per
+//  character. The animation states change while the test runs, with and
+//  without fade-in. The joints and the joint palettes of two skin
+//  fragments must be bit identical to the serial update, with 0, 1 and
+//  -workers worker threads. Then the update is timed for 1, 10, 100, ...
+//  up to -characters characters, serially and for every worker count.
+//
+//  Command line args:
+//  -characters number of characters of the benchmark (default: 500)
+//  -joints     number of joints per character (default: 60)
+//  -frames     number of measured frames (default: 100)
+//  -workers    highest worker count (default: number of processors - 1)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nworkerpool.h"
+#include "scene/nskinanimator.h"
+#include "scene/nrendercontext.h"
+#include "character/ncharacter2.h"
+#include "character/ncharacter2set.h"
+#include "character/ncharjointpalette.h"
+#include "variable/nvariableserver.h"
+#include "tools/nanimbuilder.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const char* AnimFileName = "temp:ncharacterupdatetest.nax2";
+static const int NumClips = 3;
+static const char* ClipNames[NumClips] = { "walk", "run", "wave" };
+static const int NumKeys = 50;
+static const float KeyTime = 1.0f / 25.0f;
+static const float FrameTime = 1.0f / 30.0f;
+static const int NumTestCharacters = 50;
+static const int NumTestFrames = 60;
+
+/// a character of the update phase, like nSceneServer::CharacterUpdate
+struct CharacterUpdate
+{
+    nSkinAnimator* animator;
+    nSkinAnimator::Evaluation eval;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Write a skin animation with one group per clip. Translations and
+    rotations are animated, except the translations of every 4th joint,
+    the scales are constant, so that the builder collapses these curves.
+*/
+static void
+WriteAnimation(int numJoints)
+{
+    nRandom random(4711);
+    nAnimBuilder animBuilder;
+    int clipIndex;
+    for (clipIndex = 0; clipIndex < NumClips; clipIndex++)
+    {
+        nAnimBuilder::Group group;
+        group.SetLoopType((2 == clipIndex) ? nAnimBuilder::Group::CLAMP : nAnimBuilder::Group::REPEAT);
+        group.SetKeyTime(KeyTime);
+        group.SetNumKeys(NumKeys);
+        int jointIndex;
+        for (jointIndex = 0; jointIndex < numJoints; jointIndex++)
+        {
+            nAnimBuilder::Curve transCurve(NumKeys, nAnimBuilder::Key(vector4(0.0f, 1.0f, 0.0f, 0.0f)));
+            transCurve.SetIpolType(nAnimBuilder::Curve::LINEAR);
+            nAnimBuilder::Curve rotCurve(NumKeys, nAnimBuilder::Key(vector4(0.0f, 0.0f, 0.0f, 1.0f)));
+            rotCurve.SetIpolType(nAnimBuilder::Curve::QUAT);
+            nAnimBuilder::Curve scaleCurve(NumKeys, nAnimBuilder::Key(vector4(1.0f, 1.0f, 1.0f, 0.0f)));
+            scaleCurve.SetIpolType(nAnimBuilder::Curve::LINEAR);
+            int key;
+            for (key = 0; key < NumKeys; key++)
+            {
+                if (0 != (jointIndex % 4))
+                {
+                    vector3 t(random.Rand(-1.0f, 1.0f), random.Rand(0.5f, 1.5f), random.Rand(-1.0f, 1.0f));
+                    transCurve.SetKey(key, nAnimBuilder::Key(vector4(t.x, t.y, t.z, 0.0f)));
+                }
+                quaternion q;
+                q.set_rotate_axis_angle(vector3(random.Rand(-1.0f, 1.0f), 1.0f, random.Rand(-1.0f, 1.0f)), random.Rand(-N_PI, N_PI));
+                rotCurve.SetKey(key, nAnimBuilder::Key(vector4(q.x, q.y, q.z, q.w)));
+            }
+            group.AddCurve(transCurve);
+            group.AddCurve(rotCurve);
+            group.AddCurve(scaleCurve);
+        }
+        animBuilder.AddGroup(group);
+    }
+    animBuilder.Optimize();
+    animBuilder.FixKeyOffsets();
+    bool saved = animBuilder.Save(nFileServer2::Instance(), AnimFileName);
+    n_assert(saved);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create the skin animator with numJoints joints, every joint is
+    attached to one of the joints before it.
+*/
+static nSkinAnimator*
+CreateAnimator(int numJoints)
+{
+    nRandom random(1234);
+    nSkinAnimator* animator = (nSkinAnimator*) nKernelServer::Instance()->New("nskinanimator", "/usr/scene/animator");
+    animator->SetChannel("time");
+    animator->SetAnim(AnimFileName);
+    animator->BeginJoints(numJoints);
+    int jointIndex;
+    for (jointIndex = 0; jointIndex < numJoints; jointIndex++)
+    {
+        int parentJointIndex = (0 == jointIndex) ? -1 : int(random.Next() % jointIndex);
+        quaternion rotate;
+        rotate.set_rotate_axis_angle(vector3(0.0f, 0.0f, 1.0f), random.Rand(-1.0f, 1.0f));
+        animator->SetJoint(jointIndex, parentJointIndex, vector3(0.0f, 1.0f, 0.0f), rotate, vector3(1.0f, 1.0f, 1.0f), "joint");
+    }
+    animator->EndJoints();
+    animator->BeginClips(NumClips);
+    int clipIndex;
+    for (clipIndex = 0; clipIndex < NumClips; clipIndex++)
+    {
+        animator->SetClip(clipIndex, clipIndex, ClipNames[clipIndex]);
+    }
+    animator->EndClips();
+    animator->LoadResources();
+    n_assert(animator->AreResourcesValid());
+    return animator;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static nCharacter2*
+GetCharacter(nRenderContext& renderContext)
+{
+    nVariable::Handle handle = nVariableServer::Instance()->GetVariableHandleByName("charPointer");
+    return (nCharacter2*) renderContext.FindLocalVar(handle)->GetObj();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static nCharacter2Set*
+GetCharacterSet(nRenderContext& renderContext)
+{
+    nVariable::Handle handle = nVariableServer::Instance()->GetVariableHandleByName("charSetPointer");
+    return (nCharacter2Set*) renderContext.FindLocalVar(handle)->GetObj();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+CreateContexts(nSkinAnimator* animator, nArray<nRenderContext>& contexts, int num)
+{
+    nVariable::Handle timeHandle = nVariableServer::Instance()->GetVariableHandleByName("time");
+    contexts.SetFixedSize(num);
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        contexts[i].AddVariable(nVariable(timeHandle, 0.0f));
+        animator->RenderContextCreated(&contexts[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+DestroyContexts(nSkinAnimator* animator, nArray<nRenderContext>& contexts)
+{
+    int i;
+    for (i = 0; i < contexts.Size(); i++)
+    {
+        animator->RenderContextDestroyed(&contexts[i]);
+    }
+    contexts.Clear();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Change the animation states of the characters, every character on
+    different frames: one clip without fade-in, a blend of two clips with
+    a fade-in over several frames, a blend of all clips.
+*/
+static void
+ChangeStates(nArray<nRenderContext>& contexts, int frame)
+{
+    int i;
+    for (i = 0; i < contexts.Size(); i++)
+    {
+        nCharacter2Set* characterSet = GetCharacterSet(contexts[i]);
+        int phase = (frame + 3 * i) % 24;
+        if (0 == phase)
+        {
+            characterSet->ClearClips();
+            characterSet->AddClip(ClipNames[i % NumClips], 1.0f);
+            characterSet->SetFadeInTime(0.0f);
+        }
+        else if (8 == phase)
+        {
+            characterSet->ClearClips();
+            characterSet->AddClip(ClipNames[0], 0.5f);
+            characterSet->AddClip(ClipNames[1], 0.5f);
+            characterSet->SetFadeInTime(0.1f * float(1 + (i % 4)));
+        }
+        else if (16 == phase)
+        {
+            characterSet->ClearClips();
+            characterSet->AddClip(ClipNames[1], 0.3f);
+            characterSet->AddClip(ClipNames[2], 1.0f);
+            characterSet->AddClip(ClipNames[0], 0.2f);
+            characterSet->SetFadeInTime(0.25f);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Prepare the characters of all render contexts for a frame on the
+    calling thread, every character has its own time offset.
+*/
+static void
+PrepareFrame(nSkinAnimator* animator, nArray<nRenderContext>& contexts, uint frameId, nArray<CharacterUpdate>& updates)
+{
+    nVariable::Handle timeHandle = nVariableServer::Instance()->GetVariableHandleByName("time");
+    updates.Reset();
+    int i;
+    for (i = 0; i < contexts.Size(); i++)
+    {
+        contexts[i].SetFrameId(frameId);
+        contexts[i].GetVariable(timeHandle)->SetFloat(float(frameId) * FrameTime + 0.37f * float(i));
+        CharacterUpdate update;
+        update.animator = animator;
+        if (animator->PrepareEvaluation(&contexts[i], update.eval))
+        {
+            updates.Append(update);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+UpdateCharactersTask(int taskIndex, int workerIndex, void* userData)
+{
+    const nArray<CharacterUpdate>& updates = *(const nArray<CharacterUpdate>*) userData;
+    updates[taskIndex].animator->EvaluateCharacter(updates[taskIndex].eval, workerIndex);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+EvaluateSerial(const nArray<CharacterUpdate>& updates)
+{
+    int i;
+    for (i = 0; i < updates.Size(); i++)
+    {
+        updates[i].animator->EvaluateCharacter(updates[i].eval, 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+EvaluateParallel(nArray<CharacterUpdate>& updates)
+{
+    if (updates.Size() > 0)
+    {
+        nCharacter2::SetupSampleBuffers(nWorkerPool::Instance()->GetNumThreads());
+        nWorkerPool::Instance()->Run(updates.Size(), UpdateCharactersTask, &updates);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Two skin fragments, one with every other joint, one with the joints
+    in reverse order.
+*/
+static void
+SetupPalettes(nFixedArray<nCharJointPalette>& palettes, int numJoints)
+{
+    palettes.SetSize(2);
+    palettes[0].BeginJoints((numJoints + 1) / 2);
+    int i;
+    for (i = 0; i < (numJoints + 1) / 2; i++)
+    {
+        palettes[0].SetJointIndex(i, 2 * i);
+    }
+    palettes[0].EndJoints();
+    palettes[1].BeginJoints(numJoints);
+    for (i = 0; i < numJoints; i++)
+    {
+        palettes[1].SetJointIndex(i, numJoints - 1 - i);
+    }
+    palettes[1].EndJoints();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compare the joints and the skin matrices of the joint palettes of two
+    characters bit by bit.
+*/
+static bool
+IsIdentical(nCharacter2* c0, nCharacter2* c1, const nFixedArray<nCharJointPalette>& palettes)
+{
+    const nCharSkeleton& s0 = c0->GetSkeleton();
+    const nCharSkeleton& s1 = c1->GetSkeleton();
+    if (s0.GetNumJoints() != s1.GetNumJoints())
+    {
+        return false;
+    }
+    int i;
+    for (i = 0; i < s0.GetNumJoints(); i++)
+    {
+        const nCharJoint& j0 = s0.GetJointAt(i);
+        const nCharJoint& j1 = s1.GetJointAt(i);
+        if ((0 != memcmp(&j0.GetMatrix(), &j1.GetMatrix(), sizeof(matrix44))) ||
+            (0 != memcmp(&j0.GetLocalMatrix(), &j1.GetLocalMatrix(), sizeof(matrix44))))
+        {
+            return false;
+        }
+    }
+    int paletteIndex;
+    for (paletteIndex = 0; paletteIndex < palettes.Size(); paletteIndex++)
+    {
+        const nCharJointPalette& palette = palettes[paletteIndex];
+        for (i = 0; i < palette.GetNumJoints(); i++)
+        {
+            const nCharJoint& j0 = s0.GetJointAt(palette.GetJointIndexAt(i));
+            const nCharJoint& j1 = s1.GetJointAt(palette.GetJointIndexAt(i));
+            if ((0 != memcmp(&j0.GetSkinMatrix44(), &j1.GetSkinMatrix44(), sizeof(matrix44))) ||
+                (0 != memcmp(&j0.GetSkinMatrix33(), &j1.GetSkinMatrix33(), sizeof(matrix33))))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Update two identical sets of characters, one serially and one on the
+    worker pool with numWorkers worker threads, and compare them after
+    every frame.
+*/
+static void
+TestParallelUpdate(nSkinAnimator* animator, int numWorkers)
+{
+    nWorkerPool::Instance()->SetNumWorkers(numWorkers);
+    nFixedArray<nCharJointPalette> palettes;
+    SetupPalettes(palettes, animator->GetNumJoints());
+    nArray<nRenderContext> serialContexts;
+    nArray<nRenderContext> parallelContexts;
+    CreateContexts(animator, serialContexts, NumTestCharacters);
+    CreateContexts(animator, parallelContexts, NumTestCharacters);
+    nArray<CharacterUpdate> serialUpdates;
+    nArray<CharacterUpdate> parallelUpdates;
+
+    int numWrongFrames = 0;
+    int numSkipped = 0;
+    int frame;
+    for (frame = 0; frame < NumTestFrames; frame++)
+    {
+        uint frameId = uint(frame + 1);
+        ChangeStates(serialContexts, frame);
+        ChangeStates(parallelContexts, frame);
+        PrepareFrame(animator, serialContexts, frameId, serialUpdates);
+        PrepareFrame(animator, parallelContexts, frameId, parallelUpdates);
+        EvaluateSerial(serialUpdates);
+        EvaluateParallel(parallelUpdates);
+
+        // a character which has been evaluated this frame is skipped
+        CharacterUpdate update;
+        if (!animator->PrepareEvaluation(&parallelContexts[frame % NumTestCharacters], update.eval))
+        {
+            numSkipped++;
+        }
+
+        bool identical = (NumTestCharacters == serialUpdates.Size()) && (NumTestCharacters == parallelUpdates.Size());
+        int i;
+        for (i = 0; identical && (i < NumTestCharacters); i++)
+        {
+            identical = IsIdentical(GetCharacter(serialContexts[i]), GetCharacter(parallelContexts[i]), palettes);
+        }
+        if (!identical)
+        {
+            numWrongFrames++;
+        }
+    }
+    n_test(0 == numWrongFrames);
+    n_test(NumTestFrames == numSkipped);
+
+    DestroyContexts(animator, parallelContexts);
+    DestroyContexts(animator, serialContexts);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the average update time per frame in milliseconds.
+*/
+static double
+RunBenchmark(nSkinAnimator* animator, int numCharacters, int numFrames, bool parallel)
+{
+    nArray<nRenderContext> contexts;
+    CreateContexts(animator, contexts, numCharacters);
+    nArray<CharacterUpdate> updates;
+    nTest::Timer timer;
+    double time = 0.0;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        ChangeStates(contexts, frame);
+        timer.Start();
+        PrepareFrame(animator, contexts, uint(frame + 1), updates);
+        if (parallel)
+        {
+            EvaluateParallel(updates);
+        }
+        else
+        {
+            EvaluateSerial(updates);
+        }
+        time += timer.GetTime();
+    }
+    DestroyContexts(animator, contexts);
+    return time * 1000.0 / numFrames;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numCharacters = n_max(1, args.GetIntArg("-characters", 500));
+    int numJoints = n_max(1, args.GetIntArg("-joints", 60));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 100));
+    int maxWorkers = args.GetIntArg("-workers", nWorkerPool::GetNumProcessors() - 1);
+    maxWorkers = n_max(0, n_min(maxWorkers, int(nJobServer::MaxWorkers)));
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.New("nresourceserver", "/sys/servers/resource");
+    kernelServer.New("nvariableserver", "/sys/servers/variable");
+    kernelServer.New("nanimationserver", "/sys/servers/anim");
+
+    WriteAnimation(numJoints);
+    nSkinAnimator* animator = CreateAnimator(numJoints);
+
+    TestParallelUpdate(animator, 0);
+    TestParallelUpdate(animator, 1);
+    TestParallelUpdate(animator, maxWorkers);
+
+    // 1, 10, 100, ... characters up to -characters
+    int num = 1;
+    for (;;)
+    {
+        double serialTime = RunBenchmark(animator, num, numFrames, false);
+        printf("%d characters x %d joints: serial %.3f ms/frame\n", num, numJoints, serialTime);
+        int numWorkers;
+        for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+        {
+            nWorkerPool::Instance()->SetNumWorkers(numWorkers);
+            double parallelTime = RunBenchmark(animator, num, numFrames, true);
+            printf("    workers %d: %.3f ms/frame, speedup %.2f\n",
+                   numWorkers, parallelTime, (parallelTime > 0.0) ? serialTime / parallelTime : 0.0);
+        }
+        if (num >= numCharacters)
+        {
+            break;
+        }
+        num = n_min(10 * num, numCharacters);
+    }
+
+    animator->Release();
+    nFileServer2::Instance()->DeleteFile(AnimFileName);
+    return nTest::Finish("ncharacterupdatetest");
+}
@@ -0,0 +1,459 @@
+//------------------------------------------------------------------------------
+//  nframearenatest.cc
+//
+//  Stress test and benchmark for nFrameArena and frame allocated nArrays.
+//  Allocations must be 16 byte aligned and keep their contents until the
+//  end of the next frame, the chunks must be recycled. -threads threads
+//  allocate concurrently for -frames frames, no two allocations may
+//  overlap. Frame allocated arrays must survive one frame, be forgotten
+//  by Reset() when they are stale, and copies must go to the heap.
+//
+//  The benchmark runs the per-frame work of the scene server's light
+//  array (6 clip planes per light, like LightInfo) and temporary query
+//  result arrays for -frames frames, with heap and with frame allocated
+//  arrays. With __NEBULA_MEM_MANAGER__ the heap allocations per frame
+//  are reported.
+//
+//  Command line args:
+//  -threads    number of allocating threads (default: 4)
+//  -frames     number of frames (default: 200)
+//  -lights     number of lights per frame of the benchmark (default: 64)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nframearena.h"
+#include "kernel/nthread.h"
+#include "kernel/ninterlocked.h"
+#include "mathlib/plane.h"
+#include "util/narray.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int NumAllocsPerFrame = 2000;
+static const int NumQueries = 20;
+
+//------------------------------------------------------------------------------
+/**
+    An allocation of a thread.
+*/
+struct Allocation
+{
+    uchar* ptr;
+    int size;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The state of an allocating thread.
+*/
+struct AllocJob
+{
+    uchar id;
+    nArray<Allocation>* allocs;
+    volatile long* startFlag;
+};
+
+//------------------------------------------------------------------------------
+/**
+    A light like nSceneServer::LightInfo, the clip planes are frame
+    allocated if UseFrameAlloc is set.
+*/
+class LightInfo
+{
+public:
+    /// constructor
+    LightInfo();
+    /// copy constructor
+    LightInfo(const LightInfo& rhs);
+
+    static bool UseFrameAlloc;
+    int groupIndex;
+    nArray<plane> clipPlanes;
+};
+
+bool LightInfo::UseFrameAlloc = false;
+
+//------------------------------------------------------------------------------
+/**
+*/
+LightInfo::LightInfo() :
+    groupIndex(0)
+{
+    if (UseFrameAlloc)
+    {
+        this->clipPlanes.SetFlags(nArray<plane>::FrameAlloc);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+LightInfo::LightInfo(const LightInfo& rhs) :
+    groupIndex(rhs.groupIndex)
+{
+    if (UseFrameAlloc)
+    {
+        this->clipPlanes.SetFlags(nArray<plane>::FrameAlloc);
+    }
+    this->clipPlanes = rhs.clipPlanes;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check that a block is 16 byte aligned and filled with value.
+*/
+static bool
+CheckBlock(const uchar* ptr, int size, uchar value)
+{
+    if (0 != (size_t(ptr) & 15))
+    {
+        return false;
+    }
+    int i;
+    for (i = 0; i < size; i++)
+    {
+        if (value != ptr[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocations keep their contents until the end of the next frame,
+    large allocations get individual chunks, and the chunks of the frame
+    before the last are reused.
+*/
+static void
+TestArena()
+{
+    nFrameArena* arena = nFrameArena::Instance();
+    arena->NextFrame();
+    uint frameId = arena->GetFrameId();
+    int numWrong = 0;
+    uchar* ptrs[2][100];
+    int frame;
+    for (frame = 0; frame < 10; frame++)
+    {
+        uchar value = uchar(frame + 1);
+        int i;
+        for (i = 0; i < 100; i++)
+        {
+            // every 10th allocation is larger than a chunk
+            int size = (0 == (i % 10)) ? (arena->GetChunkSize() + 16) : (1 + i * 37);
+            ptrs[frame & 1][i] = (uchar*) arena->Alloc(size);
+            memset(ptrs[frame & 1][i], value, (0 == (i % 10)) ? 64 : size);
+        }
+        arena->NextFrame();
+
+        // the allocations of the finished frame are still valid
+        for (i = 0; i < 100; i++)
+        {
+            if (!CheckBlock(ptrs[frame & 1][i], (0 == (i % 10)) ? 64 : (1 + i * 37), value))
+            {
+                numWrong++;
+            }
+        }
+        n_test(100 == arena->GetNumAllocs());
+        n_test(arena->GetNumBytes() >= 10 * arena->GetChunkSize());
+    }
+    n_test(0 == numWrong);
+    n_test(frameId + 10 == arena->GetFrameId());
+
+    // the small allocations fit into one chunk per frame, which is recycled
+    int chunkBytes = arena->GetNumChunkBytes();
+    for (frame = 0; frame < 10; frame++)
+    {
+        int i;
+        for (i = 0; i < 100; i++)
+        {
+            arena->Alloc(1 + i * 37);
+        }
+        arena->NextFrame();
+    }
+    n_test(arena->GetNumChunkBytes() <= chunkBytes);
+    n_test(arena->GetNumChunkBytes() <= 3 * arena->GetChunkSize());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocate blocks of random size and fill them with the thread id.
+*/
+static int
+N_THREADPROC
+AllocThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    AllocJob* job = (AllocJob*) thread->LockUserData();
+    thread->UnlockUserData();
+
+    // start all threads at once
+    while (0 == n_interlocked_read(job->startFlag))
+    {
+        n_sleep(0.0);
+    }
+
+    nFrameArena* arena = nFrameArena::Instance();
+    int i;
+    for (i = 0; i < NumAllocsPerFrame; i++)
+    {
+        Allocation alloc;
+        alloc.size = 1 + ((i * 7919 + job->id * 31) % 3000);
+        alloc.ptr = (uchar*) arena->Alloc(alloc.size);
+        memset(alloc.ptr, job->id, alloc.size);
+        job->allocs->Append(alloc);
+    }
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Allocate from numThreads threads at once for numFrames frames. After
+    the threads have finished, every allocation must still hold the id
+    of its thread.
+*/
+static void
+TestThreads(int numThreads, int numFrames)
+{
+    nFrameArena* arena = nFrameArena::Instance();
+    nArray<nArray<Allocation> > allocs;
+    nArray<AllocJob> jobs;
+    nArray<nThread*> threads;
+    allocs.SetFixedSize(numThreads);
+    jobs.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    int numWrong = 0;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        volatile long startFlag = 0;
+        int i;
+        for (i = 0; i < numThreads; i++)
+        {
+            allocs[i].Reset();
+            jobs[i].id = uchar(i + 1);
+            jobs[i].allocs = &allocs[i];
+            jobs[i].startFlag = &startFlag;
+            threads[i] = n_new(nThread(AllocThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+        }
+        n_interlocked_exchange(&startFlag, 1);
+        for (i = 0; i < numThreads; i++)
+        {
+            n_delete(threads[i]);
+        }
+        for (i = 0; i < numThreads; i++)
+        {
+            int j;
+            for (j = 0; j < allocs[i].Size(); j++)
+            {
+                if (!CheckBlock(allocs[i][j].ptr, allocs[i][j].size, jobs[i].id))
+                {
+                    numWrong++;
+                }
+            }
+        }
+        arena->NextFrame();
+        n_test(numThreads * NumAllocsPerFrame == arena->GetNumAllocs());
+    }
+    n_test(0 == numWrong);
+    printf("%d threads: %d allocs, %d bytes per frame, %d bytes in chunks\n",
+           numThreads, arena->GetNumAllocs(), arena->GetNumBytes(), arena->GetNumChunkBytes());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Frame allocated arrays grow, survive the next frame, are forgotten
+    when they are stale, and are copied to the heap.
+*/
+static void
+TestFrameArrays()
+{
+    nFrameArena* arena = nFrameArena::Instance();
+    nArray<int> array(0, 4);
+    array.SetFlags(nArray<int>::FrameAlloc);
+    int i;
+    for (i = 0; i < 100; i++)
+    {
+        array.Append(i);
+    }
+    arena->NextFrame();
+    int numWrong = 0;
+    for (i = 0; i < 100; i++)
+    {
+        if (i != array[i])
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+
+    // a heap copy keeps the data when the frame memory is recycled
+    nArray<int> copy;
+    copy = array;
+    n_test(0 == (copy.GetFlags() & nArray<int>::FrameAlloc));
+    n_test(0 != (array.GetFlags() & nArray<int>::FrameAlloc));
+    nArray<int> copy2(array);
+    n_test(0 == (copy2.GetFlags() & nArray<int>::FrameAlloc));
+
+    // overwrite the recycled chunks, then reuse the stale array
+    arena->NextFrame();
+    for (i = 0; i < 1000; i++)
+    {
+        memset(arena->Alloc(64), 0xff, 64);
+    }
+    array.Reset();
+    n_test(0 == array.Size());
+    array.Append(5);
+    n_test(5 == array[0]);
+    n_test(100 == copy.Size() && 99 == copy[99]);
+    n_test(100 == copy2.Size() && 99 == copy2[99]);
+
+    // a stale array can be destroyed
+    nArray<int>* stale = n_new(nArray<int>);
+    stale->SetFlags(nArray<int>::FrameAlloc);
+    stale->Append(1);
+    arena->NextFrame();
+    arena->NextFrame();
+    n_delete(stale);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the number of heap allocations since startup, if known.
+*/
+static int
+GetNumHeapAllocs()
+{
+#ifdef __NEBULA_MEM_MANAGER__
+    nMemManagerStats stats;
+    n_memgetstats(stats);
+    return stats.numAllocs;
+#else
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+    Rebuild a light array with clip planes and run temporary queries for
+    numFrames frames. Returns the time per frame, the heap allocations
+    of the last frame are written to numHeapAllocs.
+*/
+static double
+RunFrames(bool frameAlloc, int numLights, int numFrames, int& numHeapAllocs)
+{
+    nFrameArena* arena = nFrameArena::Instance();
+    LightInfo::UseFrameAlloc = frameAlloc;
+    nArray<LightInfo> lightArray(0, 16);
+    lightArray.SetFlags(nArray<LightInfo>::DoubleGrowSize);
+    int numWrong = 0;
+    int lastHeapAllocs = GetNumHeapAllocs();
+    nTest::Timer timer;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        arena->NextFrame();
+        int curHeapAllocs = GetNumHeapAllocs();
+        numHeapAllocs = curHeapAllocs - lastHeapAllocs;
+        lastHeapAllocs = curHeapAllocs;
+
+        lightArray.Clear();
+        int i;
+        for (i = 0; i < numLights; i++)
+        {
+            LightInfo lightInfo;
+            lightInfo.groupIndex = i;
+            lightArray.Append(lightInfo);
+        }
+        for (i = 0; i < numLights; i++)
+        {
+            nArray<plane>& clipPlanes = lightArray[i].clipPlanes;
+            clipPlanes.Reset();
+            int k;
+            for (k = 0; k < 6; k++)
+            {
+                clipPlanes.Append(plane(float(i), float(k), 0.0f, 0.0f));
+            }
+        }
+
+        // the temporary and result arrays of entity queries
+        int query;
+        for (query = 0; query < NumQueries; query++)
+        {
+            nArray<int> tmp(0, 16);
+            nArray<int> result(0, 16);
+            if (frameAlloc)
+            {
+                tmp.SetFlags(nArray<int>::FrameAlloc);
+                result.SetFlags(nArray<int>::FrameAlloc);
+            }
+            int k;
+            for (k = 0; k < 10; k++)
+            {
+                tmp.Append(k);
+            }
+            for (k = 0; k < tmp.Size(); k++)
+            {
+                result.Append(tmp[k] * 2);
+            }
+            if (18 != result[9])
+            {
+                numWrong++;
+            }
+        }
+
+        for (i = 0; i < numLights; i++)
+        {
+            const nArray<plane>& clipPlanes = lightArray[i].clipPlanes;
+            int k;
+            for (k = 0; k < 6; k++)
+            {
+                if ((float(i) != clipPlanes[k].a) || (float(k) != clipPlanes[k].b))
+                {
+                    numWrong++;
+                }
+            }
+        }
+    }
+    double time = timer.GetTime() / numFrames;
+    n_test(0 == numWrong);
+    LightInfo::UseFrameAlloc = false;
+    return time;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numThreads = n_max(1, args.GetIntArg("-threads", 4));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 200));
+    int numLights = n_max(1, args.GetIntArg("-lights", 64));
+
+    // the kernel server owns the frame arena
+    nKernelServer kernelServer;
+    TestArena();
+    TestThreads(numThreads, numFrames);
+    TestFrameArrays();
+
+    int heapAllocs = 0;
+    int frameAllocs = 0;
+    double heapTime = RunFrames(false, numLights, numFrames, heapAllocs);
+    int heapArenaAllocs = nFrameArena::Instance()->GetNumAllocs();
+    double frameTime = RunFrames(true, numLights, numFrames, frameAllocs);
+    int frameArenaAllocs = nFrameArena::Instance()->GetNumAllocs();
+    printf("heap arrays:  %.1f us/frame, %d heap allocs, %d arena allocs per frame\n",
+           heapTime * 1.0e6, heapAllocs, heapArenaAllocs);
+    printf("frame arrays: %.1f us/frame, %d heap allocs, %d arena allocs per frame\n",
+           frameTime * 1.0e6, frameAllocs, frameArenaAllocs);
+    #ifdef __NEBULA_MEM_MANAGER__
+    n_test(frameAllocs < heapAllocs);
+    #endif
+    return nTest::Finish("nframearenatest");
+}
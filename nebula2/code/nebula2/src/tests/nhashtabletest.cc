@@ -0,0 +1,434 @@
+//------------------------------------------------------------------------------
+//  nhashtabletest.cc
+//
+//  Tests and benchmarks the string hash containers. nStrHashMap runs
+//  random adds (with duplicate keys), removes and finds against a simple
+//  reference model, nHashList is checked with renamed, removed and
+//  duplicate nodes.
+//
+//  The benchmark compares nHashTable against the chained hash table it
+//  replaced (a fixed number of nStrList buckets and the additive hash()),
+//  both with a size of 16 like nHashList uses by default. It measures
+//  adds, finds, misses and add+remove for tables of 16 to 65536 keys
+//  with 8 and 32 characters. The chained table only runs a part of the
+//  operations on large tables, because its lookups get very slow.
+//
+//  Command line args:
+//  -ops        number of measured operations per test (default: 200000)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "util/nstrhashmap.h"
+#include "util/nhashtable.h"
+#include "util/nhashlist.h"
+#include "util/nstrlist.h"
+#include "util/nfixedarray.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int TableSize = 16;
+static const int KeyStride = 7919;
+
+static nRandom Random(1234);
+
+//------------------------------------------------------------------------------
+/**
+    The chained hash table nHashTable used before nStrHashMap.
+*/
+class nChainedHashTable
+{
+public:
+    /// constructor
+    nChainedHashTable(int size);
+    /// destructor
+    ~nChainedHashTable();
+    /// add an entry to the hash table
+    void Add(nStrNode* n);
+    /// remove an entry from the hash table
+    void Remove(nStrNode* n);
+    /// search hash table for entry
+    nStrNode* Find(const char* str) const;
+
+private:
+    int htable_size;
+    nStrList* htable;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+nChainedHashTable::nChainedHashTable(int size)
+{
+    this->htable_size = size;
+    this->htable = n_new_array(nStrList, size);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nChainedHashTable::~nChainedHashTable()
+{
+    n_delete_array(this->htable);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nChainedHashTable::Add(nStrNode* n)
+{
+    int h_index = hash(n->GetName(), this->htable_size);
+    this->htable[h_index].AddHead(n);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Nodes were unlinked directly from their bucket.
+*/
+void
+nChainedHashTable::Remove(nStrNode* n)
+{
+    n->Remove();
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+nStrNode*
+nChainedHashTable::Find(const char* str) const
+{
+    int h_index = hash(str, this->htable_size);
+    return this->htable[h_index].Find(str);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create num unique keys of keyLen characters, the first keys start at
+    index first. Keys of different first indices don't collide.
+*/
+static void
+CreateKeys(nArray<nStrNode>& keys, int first, int num, int keyLen)
+{
+    keys.SetFixedSize(num);
+    char buf[64];
+    n_assert(keyLen >= 6 && keyLen < int(sizeof(buf)));
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        // random letters, then the index in base 26
+        int j;
+        for (j = 0; j < keyLen - 5; j++)
+        {
+            buf[j] = 'a' + Random.Next() % 26;
+        }
+        int index = first + i;
+        for (j = keyLen - 1; j >= keyLen - 5; j--)
+        {
+            buf[j] = 'a' + index % 26;
+            index /= 26;
+        }
+        buf[keyLen] = 0;
+        keys[i].SetName(buf);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Random operations on nStrHashMap against a reference model, which
+    keeps all key/value pairs in insertion order.
+*/
+static void
+TestRandom()
+{
+    const int numKeys = 300;
+    nArray<nStrNode> keys;
+    CreateKeys(keys, 0, numKeys, 8);
+    nStrHashMap<int> map;
+    nArray<int> refKeys;
+    nArray<int> refValues;
+    int numWrong = 0;
+    int iter;
+    for (iter = 0; iter < 200000; iter++)
+    {
+        int keyIndex = Random.Next() % numKeys;
+        const char* key = keys[keyIndex].GetName();
+
+        // the most recently added value of the key in the model
+        int refIndex = -1;
+        int i;
+        for (i = refKeys.Size() - 1; i >= 0; i--)
+        {
+            if (refKeys[i] == keyIndex)
+            {
+                refIndex = i;
+                break;
+            }
+        }
+
+        int op = Random.Next() % 10;
+        if (op < 4)
+        {
+            map.Add(key, iter);
+            refKeys.Append(keyIndex);
+            refValues.Append(iter);
+        }
+        else if (op < 6)
+        {
+            if (map.Remove(key) != (-1 != refIndex))
+            {
+                numWrong++;
+            }
+            if (-1 != refIndex)
+            {
+                refKeys.Erase(refIndex);
+                refValues.Erase(refIndex);
+            }
+        }
+        else if (op < 7)
+        {
+            // remove a random value of the key, which may not exist
+            int value = (-1 != refIndex) ? refValues[Random.Next() % refValues.Size()] : iter;
+            int valueIndex = -1;
+            for (i = 0; i < refKeys.Size(); i++)
+            {
+                if ((refKeys[i] == keyIndex) && (refValues[i] == value))
+                {
+                    valueIndex = i;
+                }
+            }
+            if (map.Remove(key, value) != (-1 != valueIndex))
+            {
+                numWrong++;
+            }
+            if (-1 != valueIndex)
+            {
+                refKeys.Erase(valueIndex);
+                refValues.Erase(valueIndex);
+            }
+        }
+        else
+        {
+            int value = -1;
+            bool found = map.Find(key, value);
+            if ((found != (-1 != refIndex)) || (found && (value != refValues[refIndex])) ||
+                (found != map.Contains(key)))
+            {
+                numWrong++;
+            }
+        }
+        if (map.Size() != refKeys.Size())
+        {
+            numWrong++;
+        }
+
+        // start over from time to time, so that the table grows again
+        if (0 == (iter % 50000))
+        {
+            map.Clear();
+            refKeys.Clear();
+            refValues.Clear();
+        }
+    }
+    n_test(0 == numWrong);
+    n_test((map.Size() * 4) <= (map.Capacity() * 3));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check nHashList with duplicate names, renamed and removed nodes.
+*/
+static void
+TestHashList()
+{
+    nHashList list;
+    nHashNode a("a");
+    nHashNode b("b");
+    nHashNode b2("b");
+    nHashNode c("c");
+    list.AddTail(&a);
+    list.AddTail(&b);
+    list.AddTail(&c);
+    n_test(&a == list.Find("a"));
+    n_test(&b == list.Find("b"));
+    n_test(0 == list.Find("d"));
+
+    // the most recently added node of a name is found
+    list.AddTail(&b2);
+    n_test(&b2 == list.Find("b"));
+    b2.Remove();
+    n_test(&b == list.Find("b"));
+
+    // renaming
+    c.SetName("d");
+    n_test(0 == list.Find("c"));
+    n_test(&c == list.Find("d"));
+
+    // removing
+    n_test(&a == list.RemHead());
+    n_test(0 == list.Find("a"));
+    n_test(&c == list.RemTail());
+    n_test(0 == list.Find("d"));
+    b.Remove();
+    n_test(0 == list.Find("b"));
+    n_test(list.IsEmpty());
+
+    // many nodes
+    nArray<nStrNode> keys;
+    CreateKeys(keys, 0, 5000, 12);
+    nFixedArray<nHashNode> nodes(keys.Size());
+    int i;
+    for (i = 0; i < keys.Size(); i++)
+    {
+        nodes[i].SetName(keys[i].GetName());
+        list.AddTail(&nodes[i]);
+    }
+    int numWrong = 0;
+    for (i = 0; i < keys.Size(); i++)
+    {
+        if (&nodes[i] != list.Find(keys[i].GetName()))
+        {
+            numWrong++;
+        }
+        if (0 == (i % 2))
+        {
+            nodes[i].Remove();
+        }
+    }
+    for (i = 0; i < keys.Size(); i++)
+    {
+        if (list.Find(keys[i].GetName()) != ((0 == (i % 2)) ? 0 : &nodes[i]))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+    while (list.RemHead())
+    {
+        // empty
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Time add, find, miss and add+remove of a table type, in ns per
+    operation.
+*/
+template<class TABLE> void
+TimeTable(nArray<nStrNode>& keys, nArray<nStrNode>& missKeys, int numOps, double* times)
+{
+    int num = keys.Size();
+    int numRepeats = n_max(1, numOps / num);
+    int numFound = 0;
+    int repeat;
+    int i;
+    nTest::Timer timer;
+
+    // add, this includes the construction of the table
+    double time = 0.0;
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        timer.Start();
+        TABLE* table = n_new(TABLE(TableSize));
+        for (i = 0; i < num; i++)
+        {
+            table->Add(&keys[i]);
+        }
+        time += timer.GetTime();
+        for (i = 0; i < num; i++)
+        {
+            table->Remove(&keys[i]);
+        }
+        n_delete(table);
+    }
+    times[0] = (time * 1.0e9) / (double(num) * numRepeats);
+
+    TABLE table(TableSize);
+    for (i = 0; i < num; i++)
+    {
+        table.Add(&keys[i]);
+    }
+    // the keys are visited with a stride, so that a part of the operations
+    // doesn't only see the oldest nodes at the end of the chains
+    int k = 0;
+    timer.Start();
+    for (i = 0; i < numOps; i++)
+    {
+        if (table.Find(keys[k].GetName()))
+        {
+            numFound++;
+        }
+        k = (k + KeyStride) % num;
+    }
+    times[1] = (timer.GetTime() * 1.0e9) / numOps;
+    timer.Start();
+    for (i = 0; i < numOps; i++)
+    {
+        if (table.Find(missKeys[k].GetName()))
+        {
+            numFound++;
+        }
+        k = (k + KeyStride) % num;
+    }
+    times[2] = (timer.GetTime() * 1.0e9) / numOps;
+    n_test(numOps == numFound);
+
+    // add and remove a key while the table is full
+    timer.Start();
+    for (i = 0; i < numOps; i++)
+    {
+        nStrNode& key = missKeys[i % num];
+        table.Add(&key);
+        table.Remove(&key);
+    }
+    times[3] = (timer.GetTime() * 1.0e9) / numOps;
+    for (i = 0; i < num; i++)
+    {
+        table.Remove(&keys[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numOps = n_max(1, args.GetIntArg("-ops", 200000));
+
+    TestRandom();
+    TestHashList();
+
+    static const char* opNames[] = { "add", "find", "miss", "add+remove" };
+    static const int sizes[] = { 16, 256, 4096, 65536 };
+    static const int keyLens[] = { 8, 32 };
+    int keyLenIndex;
+    for (keyLenIndex = 0; keyLenIndex < 2; keyLenIndex++)
+    {
+        int sizeIndex;
+        for (sizeIndex = 0; sizeIndex < 4; sizeIndex++)
+        {
+            int num = sizes[sizeIndex];
+            nArray<nStrNode> keys;
+            nArray<nStrNode> missKeys;
+            CreateKeys(keys, 0, num, keyLens[keyLenIndex]);
+            CreateKeys(missKeys, num, num, keyLens[keyLenIndex]);
+
+            // the chained table walks chains of num / TableSize nodes
+            double oldTimes[4];
+            double newTimes[4];
+            int numOldOps = numOps / n_max(1, num / (TableSize * 4));
+            TimeTable<nChainedHashTable>(keys, missKeys, numOldOps, oldTimes);
+            TimeTable<nHashTable>(keys, missKeys, numOps, newTimes);
+            printf("%5d keys, %2d chars:", num, keyLens[keyLenIndex]);
+            int op;
+            for (op = 0; op < 4; op++)
+            {
+                printf(" %s %.0f -> %.0f ns", opNames[op], oldTimes[op], newTimes[op]);
+                printf((op < 3) ? "," : "\n");
+            }
+        }
+    }
+    return nTest::Finish("nhashtabletest");
+}
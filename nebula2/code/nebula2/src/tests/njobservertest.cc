@@ -0,0 +1,373 @@
+//------------------------------------------------------------------------------
+//  njobservertest.cc
+//
+//  Unit tests and scaling benchmark for nJobServer and nWorkerPool.
+//  The checks run for every worker count from 0 to -workers, then the
+//  benchmark measures empty jobs per second and a ParallelFor() over
+//  10M floats for every worker count.
+//
+//  Command line args:
+//  -workers    highest worker count (default: number of processors - 1)
+//  -repeat     repetitions of the checks per worker count (default: 50)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/njobserver.h"
+#include "kernel/nworkerpool.h"
+#include "kernel/nprofileserver.h"
+#include "kernel/ninterlocked.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int NumFloats = 10000000;
+
+static volatile long Hits = 0;
+static volatile long Stage = 0;
+static volatile long StageErrors = 0;
+static volatile long* IndexHits = 0;
+static float* Floats = 0;
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+CountJob(int begin, int end, void* /*userData*/)
+{
+    n_interlocked_add(&Hits, end - begin);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+IndexJob(int begin, int end, void* /*userData*/)
+{
+    int i;
+    for (i = begin; i < end; i++)
+    {
+        n_interlocked_increment(&IndexHits[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+EmptyJob(int /*begin*/, int /*end*/, void* /*userData*/)
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+FloatJob(int begin, int end, void* /*userData*/)
+{
+    int i;
+    for (i = begin; i < end; i++)
+    {
+        Floats[i] = Floats[i] * 2.0f + 1.0f;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+StageOneJob(int /*begin*/, int /*end*/, void* /*userData*/)
+{
+    n_interlocked_increment(&Stage);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Runs after all StageOneJob() jobs, so it must see all of them.
+*/
+static void
+StageTwoJob(int /*begin*/, int /*end*/, void* /*userData*/)
+{
+    if (Stage != 100)
+    {
+        n_interlocked_increment(&StageErrors);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+NestedJob(int /*begin*/, int /*end*/, void* /*userData*/)
+{
+    nJobServer::Instance()->ParallelFor(0, 1000, 10, CountJob, 0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Background jobs must never be executed by the main thread while it
+    waits, unless there are no workers.
+*/
+static void
+BackgroundJob(int /*begin*/, int /*end*/, void* /*userData*/)
+{
+    if ((0 == nJobServer::GetWorkerIndex()) && (nJobServer::Instance()->GetNumWorkers() > 0))
+    {
+        n_interlocked_increment(&StageErrors);
+    }
+    n_interlocked_increment(&Hits);
+}
+
+//------------------------------------------------------------------------------
+/**
+    The worker index of a worker pool task must index per-thread data.
+*/
+static void
+PoolTask(int taskIndex, int workerIndex, void* userData)
+{
+    if ((workerIndex < 0) || (workerIndex >= nWorkerPool::Instance()->GetNumThreads()))
+    {
+        n_interlocked_increment(&StageErrors);
+    }
+    n_interlocked_increment(&((volatile long*)userData)[taskIndex]);
+}
+
+//------------------------------------------------------------------------------
+/**
+    A thread which is not a job thread submits jobs and waits for them,
+    while the main thread runs worker pool tasks.
+*/
+static int
+N_THREADPROC
+ForeignThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    volatile long* foreignHits = (volatile long*) thread->LockUserData();
+    thread->UnlockUserData();
+    while (!thread->ThreadStopRequested())
+    {
+        nJobCounter counter;
+        int i;
+        for (i = 0; i < 16; i++)
+        {
+            nJobServer::Instance()->Submit(EmptyJob, 0, 1, 0, &counter);
+        }
+        nJobServer::Instance()->Wait(&counter);
+        n_interlocked_increment(foreignHits);
+    }
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestCounters(nJobServer* jobServer)
+{
+    Hits = 0;
+    nJobCounter counter;
+    int i;
+    for (i = 0; i < 1000; i++)
+    {
+        jobServer->Submit(CountJob, 0, 3, 0, &counter);
+    }
+    jobServer->Wait(&counter);
+    n_test(counter.IsDone());
+    n_test(3000 == Hits);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestDependencies(nJobServer* jobServer)
+{
+    Stage = 0;
+    StageErrors = 0;
+    nJobCounter first;
+    nJobCounter second;
+    int i;
+    for (i = 0; i < 100; i++)
+    {
+        jobServer->Submit(StageOneJob, 0, 1, 0, &first);
+    }
+    for (i = 0; i < 10; i++)
+    {
+        jobServer->SubmitAfter(&first, StageTwoJob, 0, 1, 0, &second);
+    }
+    jobServer->Wait(&second);
+    jobServer->Wait(&first);
+    n_test(0 == StageErrors);
+    n_test(100 == Stage);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestParallelFor(nJobServer* jobServer)
+{
+    const int num = 100003;
+    IndexHits = n_new_array(long, num);
+    memset((void*)IndexHits, 0, num * sizeof(long));
+    jobServer->ParallelFor(0, num, 7, IndexJob, 0);
+    int i;
+    int wrongHits = 0;
+    for (i = 0; i < num; i++)
+    {
+        if (1 != IndexHits[i])
+        {
+            wrongHits++;
+        }
+    }
+    n_test(0 == wrongHits);
+    n_delete_array((long*)IndexHits);
+    IndexHits = 0;
+
+    Hits = 0;
+    nJobCounter counter;
+    for (i = 0; i < 50; i++)
+    {
+        jobServer->Submit(NestedJob, 0, 1, 0, &counter);
+    }
+    jobServer->Wait(&counter);
+    n_test(50000 == Hits);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestBackground(nJobServer* jobServer)
+{
+    Hits = 0;
+    StageErrors = 0;
+    nJobCounter counter;
+    int i;
+    for (i = 0; i < 20; i++)
+    {
+        jobServer->SubmitBackground(BackgroundJob, 0, 1, 0, &counter);
+    }
+    jobServer->Wait(&counter);
+    n_test(20 == Hits);
+    n_test(0 == StageErrors);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestWorkerPool(nWorkerPool* workerPool)
+{
+    const int numTasks = 333;
+    long taskHits[numTasks];
+    memset(taskHits, 0, sizeof(taskHits));
+    StageErrors = 0;
+    workerPool->Run(numTasks, PoolTask, taskHits);
+    int i;
+    int wrongHits = 0;
+    for (i = 0; i < numTasks; i++)
+    {
+        if (1 != taskHits[i])
+        {
+            wrongHits++;
+        }
+    }
+    n_test(0 == wrongHits);
+    n_test(0 == StageErrors);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+RunBenchmark(nJobServer* jobServer)
+{
+    int i;
+    for (i = 0; i < NumFloats; i++)
+    {
+        Floats[i] = 1.0f;
+    }
+    nTest::Timer timer;
+    jobServer->ParallelFor(0, NumFloats, 16384, FloatJob, 0);
+    double pforTime = timer.GetTime();
+    int wrongFloats = 0;
+    for (i = 0; i < NumFloats; i++)
+    {
+        if (Floats[i] != 3.0f)
+        {
+            wrongFloats++;
+        }
+    }
+    n_test(0 == wrongFloats);
+
+    const int numJobs = 1000000;
+    nJobCounter counter;
+    timer.Start();
+    for (i = 0; i < numJobs; i++)
+    {
+        jobServer->Submit(EmptyJob, 0, 1, 0, &counter);
+        if ((i & 1023) == 1023)
+        {
+            jobServer->Wait(&counter);
+        }
+    }
+    jobServer->Wait(&counter);
+    double jobTime = timer.GetTime();
+
+    printf("workers %d: parallel for 10M floats: %.2f ms, empty jobs: %.2f M/s\n",
+           jobServer->GetNumWorkers(), pforTime * 1000.0, (numJobs / jobTime) / 1000000.0);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int maxWorkers = args.GetIntArg("-workers", nJobServer::GetNumProcessors() - 1);
+    int numRepeats = args.GetIntArg("-repeat", 50);
+    maxWorkers = n_max(0, n_min(maxWorkers, int(nJobServer::MaxWorkers)));
+
+    nProfileServer* profileServer = n_new(nProfileServer);
+    nJobServer* jobServer = n_new(nJobServer);
+    nWorkerPool* workerPool = n_new(nWorkerPool);
+    Floats = n_new_array(float, NumFloats);
+
+    int numWorkers;
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        jobServer->SetNumWorkers(numWorkers);
+        int repeat;
+        for (repeat = 0; repeat < numRepeats; repeat++)
+        {
+            TestCounters(jobServer);
+            TestDependencies(jobServer);
+            TestParallelFor(jobServer);
+            TestBackground(jobServer);
+            TestWorkerPool(workerPool);
+        }
+
+        // worker pool tasks while another thread submits and waits
+        volatile long foreignHits = 0;
+        nThread* foreignThread = n_new(nThread(ForeignThreadFunc, nThread::Normal, 0, 0, 0, (void*)&foreignHits));
+        for (repeat = 0; (repeat < numRepeats) || (0 == n_interlocked_read(&foreignHits)); repeat++)
+        {
+            TestWorkerPool(workerPool);
+        }
+        n_delete(foreignThread);
+        n_test(n_interlocked_read(&foreignHits) > 0);
+    }
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        jobServer->SetNumWorkers(numWorkers);
+        RunBenchmark(jobServer);
+    }
+
+    n_delete_array(Floats);
+    n_delete(workerPool);
+    n_delete(jobServer);
+    n_delete(profileServer);
+    return nTest::Finish("njobservertest");
+}
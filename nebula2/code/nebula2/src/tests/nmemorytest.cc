@@ -0,0 +1,574 @@
+//------------------------------------------------------------------------------
+//  nmemorytest.cc
+//
+//  Stress test and benchmark for the memory allocator. With
+//  __NEBULA_MEM_MANAGER__ the thread caches are checked: 200 short-lived
+//  threads one after another must recycle one cache (nThreads and, on
+//  POSIX, threads which haven't been created by nThread), and 100 threads
+//  at once must fall back to the shared cache when all caches are in use.
+//  calloc and realloc are checked in every build.
+//
+//  The benchmark runs a malloc/free mix of 8 byte to 32 KB blocks from
+//  -threads threads, each thread keeps a window of live blocks and hands
+//  every 8th block to the next thread, which frees it. Every block is
+//  tagged at both ends, the tags are checked when the block is freed.
+//  The mix runs with the system malloc and with nn_malloc(), the cache
+//  hit rate of the thread caches is reported with __NEBULA_MEM_MANAGER__.
+//
+//  Command line args:
+//  -threads    number of benchmark threads (default: 8)
+//  -ops        number of malloc/free pairs per thread (default: 1000000)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/ntypes.h"
+#include "kernel/nthread.h"
+#include "kernel/ninterlocked.h"
+#include "util/narray.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+#if defined(__NEBULA_MEM_MANAGER__) && !defined(__WIN32__) && !defined(__NEBULA_NO_THREADS__)
+#include <pthread.h>
+#define N_TEST_PTHREADS
+#endif
+
+static const int NumLiveBlocks = 1024;
+static const int MailboxSize = 256;
+static const int MaxBlockSize = 32 * 1024;
+
+//------------------------------------------------------------------------------
+/**
+    Blocks handed from one benchmark thread to the next. Only the sending
+    thread writes writePos, only the receiving thread writes readPos.
+*/
+struct Mailbox
+{
+    void* volatile slots[MailboxSize];
+    volatile long writePos;
+    volatile long readPos;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The state of a benchmark thread.
+*/
+struct AllocJob
+{
+    bool useNebula;             // nn_malloc() instead of malloc()
+    int numOps;
+    uint seed;
+    volatile long* startFlag;
+    Mailbox* inbox;             // blocks to free
+    Mailbox* outbox;            // blocks for the next thread
+    volatile long numWrong;     // corrupted blocks
+};
+
+//------------------------------------------------------------------------------
+/**
+    The state of a thread of the cache tests.
+*/
+struct CacheJob
+{
+    volatile long* releaseFlag;     // 0: the thread keeps running
+    volatile long* numReady;
+    void* block;                    // allocated by the thread, freed by the main thread
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void*
+Alloc(bool useNebula, int size)
+{
+    return useNebula ? nn_malloc(size, __FILE__, __LINE__) : malloc(size);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+Free(bool useNebula, void* ptr)
+{
+    if (useNebula)
+    {
+        nn_free(ptr);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write the size of a block to its first and last 4 bytes.
+*/
+static void
+TagBlock(void* ptr, int size)
+{
+    memcpy(ptr, &size, sizeof(int));
+    memcpy(((char*) ptr) + size - sizeof(int), &size, sizeof(int));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check the tags of a block and free it, returns false if the block has
+    been overwritten.
+*/
+static bool
+CheckAndFree(bool useNebula, void* ptr)
+{
+    int size;
+    int endSize;
+    memcpy(&size, ptr, sizeof(int));
+    bool ok = (size >= int(sizeof(int))) && (size <= MaxBlockSize);
+    if (ok)
+    {
+        memcpy(&endSize, ((char*) ptr) + size - sizeof(int), sizeof(int));
+        ok = (endSize == size);
+    }
+    Free(useNebula, ptr);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+/**
+    A random block size from 8 bytes to 32 KB, small blocks are much more
+    common than large blocks.
+*/
+static int
+RandomBlockSize(nRandom& random)
+{
+    int range = 8 << (random.Next() % 12);
+    return n_min(8 + int(random.Next() % range), MaxBlockSize);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Free the blocks another thread has handed over.
+*/
+static void
+EmptyInbox(AllocJob* job)
+{
+    Mailbox* inbox = job->inbox;
+    long writePos = n_interlocked_read(&inbox->writePos);
+    long readPos = inbox->readPos;
+    while (readPos < writePos)
+    {
+        if (!CheckAndFree(job->useNebula, inbox->slots[readPos % MailboxSize]))
+        {
+            n_interlocked_increment(&job->numWrong);
+        }
+        readPos++;
+    }
+    n_interlocked_exchange(&inbox->readPos, readPos);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Replace random blocks of the live window numOps times, hand every 8th
+    block to the next thread instead of freeing it.
+*/
+static int
+N_THREADPROC
+AllocThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    AllocJob* job = (AllocJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    nRandom random(job->seed);
+    void* blocks[NumLiveBlocks];
+    memset(blocks, 0, sizeof(blocks));
+
+    // start all threads at once
+    while (0 == n_interlocked_read(job->startFlag))
+    {
+        n_sleep(0.0);
+    }
+
+    int i;
+    for (i = 0; i < job->numOps; i++)
+    {
+        int index = random.Next() % NumLiveBlocks;
+        void* ptr = blocks[index];
+        if (ptr)
+        {
+            Mailbox* outbox = job->outbox;
+            long writePos = outbox->writePos;
+            if ((0 == (i % 8)) && ((writePos - n_interlocked_read(&outbox->readPos)) < MailboxSize))
+            {
+                outbox->slots[writePos % MailboxSize] = ptr;
+                n_interlocked_exchange(&outbox->writePos, writePos + 1);
+            }
+            else if (!CheckAndFree(job->useNebula, ptr))
+            {
+                n_interlocked_increment(&job->numWrong);
+            }
+        }
+        int size = RandomBlockSize(random);
+        blocks[index] = Alloc(job->useNebula, size);
+        TagBlock(blocks[index], size);
+        if (0 == (i % 64))
+        {
+            EmptyInbox(job);
+        }
+    }
+    for (i = 0; i < NumLiveBlocks; i++)
+    {
+        if (blocks[i] && !CheckAndFree(job->useNebula, blocks[i]))
+        {
+            n_interlocked_increment(&job->numWrong);
+        }
+    }
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Run the malloc/free mix from numThreads threads, returns the wall
+    time.
+*/
+static double
+RunAllocPass(bool useNebula, int numThreads, int numOps)
+{
+    volatile long startFlag = 0;
+    nArray<AllocJob> jobs;
+    nArray<Mailbox*> mailboxes;
+    nArray<nThread*> threads;
+    jobs.SetFixedSize(numThreads);
+    mailboxes.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        mailboxes[i] = n_new(Mailbox);
+        memset(mailboxes[i], 0, sizeof(Mailbox));
+    }
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].useNebula = useNebula;
+        jobs[i].numOps = numOps;
+        jobs[i].seed = 1234 + i;
+        jobs[i].startFlag = &startFlag;
+        jobs[i].inbox = mailboxes[i];
+        jobs[i].outbox = mailboxes[(i + 1) % numThreads];
+        jobs[i].numWrong = 0;
+        threads[i] = n_new(nThread(AllocThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+    }
+    nTest::Timer timer;
+    n_interlocked_exchange(&startFlag, 1);
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(threads[i]);
+    }
+    double time = timer.GetTime();
+
+    // free the blocks which were handed over after the receiver finished
+    int numWrong = 0;
+    for (i = 0; i < numThreads; i++)
+    {
+        EmptyInbox(&jobs[i]);
+        numWrong += jobs[i].numWrong;
+    }
+    n_test(0 == numWrong);
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(mailboxes[i]);
+    }
+    return time;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check calloc and realloc, for nn_calloc() and nn_realloc() and for
+    the n_calloc() and n_realloc() macros.
+*/
+static void
+TestCallocRealloc()
+{
+    int numWrong = 0;
+    int i;
+
+    // reused blocks must be cleared
+    char* ptr = (char*) nn_malloc(100, __FILE__, __LINE__);
+    memset(ptr, 0xff, 100);
+    nn_free(ptr);
+    ptr = (char*) nn_calloc(10, 10, __FILE__, __LINE__);
+    for (i = 0; i < 100; i++)
+    {
+        if (0 != ptr[i])
+        {
+            numWrong++;
+        }
+    }
+    nn_free(ptr);
+    ptr = (char*) n_calloc(10, 10);
+    for (i = 0; i < 100; i++)
+    {
+        if (0 != ptr[i])
+        {
+            numWrong++;
+        }
+    }
+    n_free(ptr);
+    n_test(0 == numWrong);
+
+    // grow through all size classes into large blocks and shrink again,
+    // the contents must be kept
+    uchar* data = (uchar*) nn_realloc(0, 1, __FILE__, __LINE__);
+    data[0] = 0;
+    int size = 1;
+    while (size < 3 * MaxBlockSize)
+    {
+        int newSize = size + 1 + size / 3;
+        data = (uchar*) nn_realloc(data, newSize, __FILE__, __LINE__);
+        for (i = size; i < newSize; i++)
+        {
+            data[i] = uchar(i);
+        }
+        size = newSize;
+    }
+    while (size > 1)
+    {
+        size = size / 2;
+        data = (uchar*) n_realloc(data, size);
+        for (i = 0; i < size; i++)
+        {
+            if (uchar(i) != data[i])
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+    n_test(0 == nn_realloc(data, 0, __FILE__, __LINE__));
+}
+
+#ifdef __NEBULA_MEM_MANAGER__
+//------------------------------------------------------------------------------
+/**
+    Allocate and free a few blocks of all size classes, keep one block
+    for the main thread, and wait until the release flag is set.
+*/
+static void
+RunCacheJob(CacheJob* job)
+{
+    void* blocks[50];
+    int repeat;
+    for (repeat = 0; repeat < 20; repeat++)
+    {
+        int i;
+        for (i = 0; i < 50; i++)
+        {
+            blocks[i] = nn_malloc(16 + i * 173, __FILE__, __LINE__);
+            TagBlock(blocks[i], 16 + i * 173);
+        }
+        for (i = 0; i < 50; i++)
+        {
+            nn_free(blocks[i]);
+        }
+    }
+    job->block = nn_malloc(100, __FILE__, __LINE__);
+    TagBlock(job->block, 100);
+    n_interlocked_increment(job->numReady);
+    while (0 == n_interlocked_read(job->releaseFlag))
+    {
+        n_sleep(0.001);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static int
+N_THREADPROC
+CacheThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    CacheJob* job = (CacheJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    RunCacheJob(job);
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+#ifdef N_TEST_PTHREADS
+//------------------------------------------------------------------------------
+/**
+    A thread which doesn't release its cache with n_memthreadexit().
+*/
+static void*
+ForeignThreadFunc(void* arg)
+{
+    RunCacheJob((CacheJob*) arg);
+    return 0;
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+    Run numThreads threads at once, or one after another if sequential
+    is true. Foreign threads are created without nThread, they can only
+    run one after another. Returns the highest number of thread caches in use, the
+    blocks the threads kept are freed by the main thread.
+*/
+static int
+RunCacheThreads(int numThreads, bool sequential, bool foreign)
+{
+    volatile long releaseFlag = sequential ? 1 : 0;
+    volatile long numReady = 0;
+    nArray<CacheJob> jobs;
+    nArray<nThread*> threads;
+    jobs.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    nMemManagerStats stats;
+    int maxCaches = 0;
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].releaseFlag = &releaseFlag;
+        jobs[i].numReady = &numReady;
+        jobs[i].block = 0;
+        #ifdef N_TEST_PTHREADS
+        if (foreign)
+        {
+            pthread_t thread;
+            n_assert(sequential);
+            n_assert(0 == pthread_create(&thread, 0, ForeignThreadFunc, &jobs[i]));
+            pthread_join(thread, 0);
+            threads[i] = 0;
+        }
+        else
+        #endif
+        {
+            threads[i] = n_new(nThread(CacheThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+            if (sequential)
+            {
+                n_delete(threads[i]);
+                threads[i] = 0;
+            }
+        }
+        if (sequential)
+        {
+            n_memgetstats(stats);
+            maxCaches = n_max(maxCaches, stats.numThreadCaches);
+        }
+    }
+    if (!sequential)
+    {
+        while (n_interlocked_read(&numReady) < numThreads)
+        {
+            n_sleep(0.001);
+        }
+        n_memgetstats(stats);
+        maxCaches = stats.numThreadCaches;
+        n_interlocked_exchange(&releaseFlag, 1);
+        for (i = 0; i < numThreads; i++)
+        {
+            n_delete(threads[i]);
+        }
+    }
+    int numWrong = 0;
+    for (i = 0; i < numThreads; i++)
+    {
+        if (!CheckAndFree(true, jobs[i].block))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+    return maxCaches;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Short-lived threads must recycle the caches, more threads than caches
+    must work with the shared cache, and all blocks must be freed
+    afterwards.
+*/
+static void
+TestThreadCaches()
+{
+    nMemManagerStats stats;
+    n_memgetstats(stats);
+    int numCachesBefore = stats.numThreadCaches;
+    int numBlocksBefore = stats.totalCount;
+
+    int maxCaches = RunCacheThreads(200, true, false);
+    n_test(maxCaches <= numCachesBefore + 1);
+    #ifdef N_TEST_PTHREADS
+    maxCaches = RunCacheThreads(200, true, true);
+    n_test(maxCaches <= numCachesBefore + 1);
+    #endif
+    printf("caches after 200 sequential threads: %d\n", maxCaches);
+
+    maxCaches = RunCacheThreads(100, false, false);
+    n_test(nMemManagerStats::MaxThreadCaches == maxCaches);
+    n_memgetstats(stats);
+    n_test(numBlocksBefore == stats.totalCount);
+    printf("caches with 100 threads: %d, blocks %d -> %d\n", maxCaches, numBlocksBefore, stats.totalCount);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the sum of the cache hits and misses of all thread caches.
+*/
+static void
+GetCacheHits(int& hits, int& misses)
+{
+    nMemManagerStats stats;
+    n_memgetstats(stats);
+    hits = 0;
+    misses = 0;
+    int i;
+    for (i = 0; i < stats.numThreadCaches; i++)
+    {
+        hits += stats.cacheHits[i];
+        misses += stats.cacheMisses[i];
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numThreads = n_max(1, args.GetIntArg("-threads", 8));
+    int numOps = n_max(1, args.GetIntArg("-ops", 1000000));
+
+    TestCallocRealloc();
+    #ifdef __NEBULA_MEM_MANAGER__
+    TestThreadCaches();
+    nMemManagerStats stats;
+    n_memgetstats(stats);
+    int numBlocksBefore = stats.totalCount;
+    int hitsBefore;
+    int missesBefore;
+    GetCacheHits(hitsBefore, missesBefore);
+    #endif
+
+    double mops = double(numThreads) * numOps * 1.0e-6;
+    double systemTime = RunAllocPass(false, numThreads, numOps);
+    double nebulaTime = RunAllocPass(true, numThreads, numOps);
+    printf("%d threads, %d ops: malloc %.2f Mops/s, nn_malloc %.2f Mops/s, speedup %.2f\n",
+           numThreads, numOps, mops / systemTime, mops / nebulaTime,
+           (nebulaTime > 0.0) ? systemTime / nebulaTime : 0.0);
+
+    #ifdef __NEBULA_MEM_MANAGER__
+    n_memgetstats(stats);
+    n_test(numBlocksBefore == stats.totalCount);
+    int hits;
+    int misses;
+    GetCacheHits(hits, misses);
+    hits -= hitsBefore;
+    misses -= missesBefore;
+    printf("cache hit rate %.1f%%, %d thread caches\n",
+           (hits + misses > 0) ? (100.0 * hits) / (hits + misses) : 0.0, stats.numThreadCaches);
+    #endif
+    return nTest::Finish("nmemorytest");
+}
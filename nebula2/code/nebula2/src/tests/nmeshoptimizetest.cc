@@ -0,0 +1,691 @@
+//------------------------------------------------------------------------------
+//  nmeshoptimizetest.cc
+//
+//  Tests and benchmarks nMeshBuilder::Optimize(). The test mesh has 5
+//  groups: 2 height field grids, a decal group which uses the vertices of
+//  the first grid, a fan with a triangle which shares only the fan's
+//  center, and a box with hard edges. It contains degenerate triangles
+//  and unreferenced vertices. The triangles are added in row order and in
+//  random order, then the mesh is optimized with and without cluster
+//  sorting. The tests check that every group keeps its triangle range and
+//  its triangles (up to the vertex remap, with the same winding), that
+//  the rebuilt edges reference triangles of their group which contain
+//  them, that the edges are the same as before, that the FIFO cache miss
+//  ratio of no group increases, and that SortTriangles() keeps the
+//  optimized order. The faces of the box don't share vertices, so they
+//  are separate clusters, which cluster sorting must reorder.
+//
+//  The benchmark optimizes a -size x -size grid in random triangle order
+//  and prints the cache miss ratios of the input, of a row order grid
+//  and of the optimized mesh.
+//
+//  Command line args:
+//  -size       grid size of the benchmark (default: 200)
+//  -repeat     number of measured Optimize() calls (default: 5)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "tools/nmeshbuilder.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+//------------------------------------------------------------------------------
+/**
+    An edge by original vertex and triangle indices, which don't change
+    when the mesh is optimized.
+*/
+struct EdgeKey
+{
+    int groupId;
+    int vertex[2];
+    int face[2];
+
+    /// less operator for nArray::Sort()
+    bool operator<(const EdgeKey& rhs) const
+    {
+        if (this->groupId != rhs.groupId)   return this->groupId < rhs.groupId;
+        if (this->vertex[0] != rhs.vertex[0]) return this->vertex[0] < rhs.vertex[0];
+        if (this->vertex[1] != rhs.vertex[1]) return this->vertex[1] < rhs.vertex[1];
+        if (this->face[0] != rhs.face[0])   return this->face[0] < rhs.face[0];
+        return this->face[1] < rhs.face[1];
+    }
+    /// equality operator
+    bool operator==(const EdgeKey& rhs) const
+    {
+        return (this->groupId == rhs.groupId) &&
+               (this->vertex[0] == rhs.vertex[0]) && (this->vertex[1] == rhs.vertex[1]) &&
+               (this->face[0] == rhs.face[0]) && (this->face[1] == rhs.face[1]);
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+    Add a vertex, uv layer 1 holds the original vertex index.
+*/
+static int
+AddVertex(nMeshBuilder& mesh, const vector3& coord)
+{
+    int index = mesh.GetNumVertices();
+    nMeshBuilder::Vertex vertex;
+    vertex.SetCoord(coord);
+    vertex.SetUv(1, vector2(float(index), 0.0f));
+    mesh.AddVertex(vertex);
+    return index;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add the vertices of a size x size quad height field grid, returns the
+    index of the first vertex.
+*/
+static int
+AddGridVertices(nMeshBuilder& mesh, int size, float height)
+{
+    int firstVertex = mesh.GetNumVertices();
+    int x, y;
+    for (y = 0; y <= size; y++)
+    {
+        for (x = 0; x <= size; x++)
+        {
+            AddVertex(mesh, vector3(float(x), height * sinf(x * 0.3f) * cosf(y * 0.2f), float(y)));
+        }
+    }
+    return firstVertex;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static nMeshBuilder::Triangle
+MakeTriangle(int i0, int i1, int i2, int groupId, int materialId, int usageFlags)
+{
+    nMeshBuilder::Triangle tri;
+    tri.SetVertexIndices(i0, i1, i2);
+    tri.SetGroupId(groupId);
+    tri.SetMaterialId(materialId);
+    tri.SetUsageFlags(usageFlags);
+    return tri;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add the 2 triangles of every quad from (x0, y0) to (x1, y1) of a grid.
+*/
+static void
+AddGridTriangles(nArray<nMeshBuilder::Triangle>& tris, int firstVertex, int size,
+                 int x0, int y0, int x1, int y1, int groupId, int materialId)
+{
+    int x, y;
+    for (y = y0; y < y1; y++)
+    {
+        for (x = x0; x < x1; x++)
+        {
+            int i00 = firstVertex + y * (size + 1) + x;
+            int i10 = i00 + 1;
+            int i01 = i00 + size + 1;
+            int i11 = i01 + 1;
+            tris.Append(MakeTriangle(i00, i01, i10, groupId, materialId, nMesh2::WriteOnce));
+            tris.Append(MakeTriangle(i10, i01, i11, groupId, materialId, nMesh2::WriteOnce));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add a box with hard edges around the origin, every face is a grid of
+    4 x 4 quads with its own vertices.
+*/
+static void
+AddBox(nMeshBuilder& mesh, nArray<nMeshBuilder::Triangle>& tris, const vector3& extents, int groupId, int materialId)
+{
+    static const vector3 axes[3] = { vector3(1.0f, 0.0f, 0.0f), vector3(0.0f, 1.0f, 0.0f), vector3(0.0f, 0.0f, 1.0f) };
+    const int size = 4;
+    int face;
+    for (face = 0; face < 6; face++)
+    {
+        float sign = (face < 3) ? 1.0f : -1.0f;
+        const vector3& n = axes[face % 3];
+        const vector3& u = axes[(face + 1) % 3];
+        const vector3& v = axes[(face + 2) % 3];
+        vector3 center(n.x * extents.x, n.y * extents.y, n.z * extents.z);
+        vector3 du(u.x * extents.x, u.y * extents.y, u.z * extents.z);
+        vector3 dv(v.x * extents.x, v.y * extents.y, v.z * extents.z);
+        int firstVertex = mesh.GetNumVertices();
+        int x, y;
+        for (y = 0; y <= size; y++)
+        {
+            for (x = 0; x <= size; x++)
+            {
+                float s = 2.0f * x / size - 1.0f;
+                float t = 2.0f * y / size - 1.0f;
+                AddVertex(mesh, center * sign + du * s + dv * t);
+            }
+        }
+        AddGridTriangles(tris, firstVertex, size, 0, 0, size, size, groupId, materialId);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Add triangles to the mesh, in random order if shuffle is true. The x
+    component of the triangle normal holds the original triangle index.
+*/
+static void
+AddTriangles(nMeshBuilder& mesh, nArray<nMeshBuilder::Triangle>& tris, bool shuffle, nRandom& random)
+{
+    int i;
+    if (shuffle)
+    {
+        for (i = tris.Size() - 1; i > 0; i--)
+        {
+            int j = random.Next() % (i + 1);
+            nMeshBuilder::Triangle tmp = tris[i];
+            tris[i] = tris[j];
+            tris[j] = tmp;
+        }
+    }
+    for (i = 0; i < tris.Size(); i++)
+    {
+        tris[i].SetNormal(vector3(float(mesh.GetNumTriangles()), 0.0f, 0.0f));
+        mesh.AddTriangle(tris[i]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Build the test mesh.
+*/
+static void
+SetupMesh(nMeshBuilder& mesh, int size, bool shuffle, nRandom& random)
+{
+    nArray<nMeshBuilder::Triangle> tris;
+    int gridA = AddGridVertices(mesh, size, 1.0f);
+
+    // unreferenced vertices
+    AddVertex(mesh, vector3(-1.0f, 0.0f, 0.0f));
+    AddVertex(mesh, vector3(-2.0f, 0.0f, 0.0f));
+    int gridB = AddGridVertices(mesh, size, 3.0f);
+
+    // a fan, and a triangle which shares only the center with the fan
+    int center = AddVertex(mesh, vector3(0.0f, 5.0f, 0.0f));
+    int rim[11];
+    int i;
+    for (i = 0; i < 11; i++)
+    {
+        float a = N_PI * 2.0f * i / 11.0f;
+        rim[i] = AddVertex(mesh, vector3(cosf(a), 5.0f, sinf(a)));
+    }
+
+    AddGridTriangles(tris, gridA, size, 0, 0, size, size, 0, 0);
+    AddGridTriangles(tris, gridB, size, 0, 0, size, size, 1, 1);
+    AddGridTriangles(tris, gridA, size, size / 3, size / 3, 2 * size / 3, 2 * size / 3, 2, 0);
+    for (i = 0; i < 8; i++)
+    {
+        tris.Append(MakeTriangle(center, rim[i + 1], rim[i], 3, 2, nMesh2::ReadOnly));
+    }
+    tris.Append(MakeTriangle(center, rim[10], rim[9], 3, 2, nMesh2::ReadOnly));
+    AddBox(mesh, tris, vector3(2.0f, 1.0f, 0.5f), 4, 3);
+
+    // degenerate triangles between vertices which don't share an edge
+    int row = size + 1;
+    tris.Append(MakeTriangle(gridA, gridA, gridA + 2 * row + 2, 0, 0, nMesh2::WriteOnce));
+    tris.Append(MakeTriangle(gridA + row + 3, gridA + 5 * row + 5, gridA + 5 * row + 5, 0, 0, nMesh2::WriteOnce));
+    tris.Append(MakeTriangle(gridB + row + 1, gridB + 2 * row + 4, gridB + row + 1, 1, 1, nMesh2::WriteOnce));
+
+    AddTriangles(mesh, tris, shuffle, random);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static int
+GetVertexId(const nMeshBuilder& mesh, int vertexIndex)
+{
+    return int(mesh.GetVertexAt(vertexIndex).GetUv(1).x);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static int
+GetTriangleId(const nMeshBuilder& mesh, int triIndex)
+{
+    return int(mesh.GetTriangleAt(triIndex).GetNormal().x);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static int
+CountDegenerateTriangles(const nMeshBuilder& mesh)
+{
+    int num = 0;
+    int i;
+    for (i = 0; i < mesh.GetNumTriangles(); i++)
+    {
+        int i0, i1, i2;
+        mesh.GetTriangleAt(i).GetVertexIndices(i0, i1, i2);
+        if ((i0 == i1) || (i1 == i2) || (i2 == i0))
+        {
+            num++;
+        }
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check that the vertices are a permutation of the original vertices.
+    Returns the number of differences.
+*/
+static int
+CheckVertices(const nMeshBuilder& src, const nMeshBuilder& mesh)
+{
+    if (src.GetNumVertices() != mesh.GetNumVertices())
+    {
+        return 1;
+    }
+    int numWrong = 0;
+    nArray<bool> seen(0, 0);
+    seen.SetFixedSize(src.GetNumVertices());
+    seen.Fill(0, seen.Size(), false);
+    int i;
+    for (i = 0; i < mesh.GetNumVertices(); i++)
+    {
+        int id = GetVertexId(mesh, i);
+        if ((id < 0) || (id >= src.GetNumVertices()) || seen[id] ||
+            !mesh.GetVertexAt(i).GetCoord().isequal(src.GetVertexAt(id).GetCoord(), 0.0f))
+        {
+            numWrong++;
+            continue;
+        }
+        seen[id] = true;
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check that every group of the mesh contains the triangles of the same
+    group of the source mesh, with the same vertices in the same order.
+    Returns the number of differences.
+*/
+static int
+CheckTriangles(const nMeshBuilder& src, const nMeshBuilder& mesh, const nArray<nMeshBuilder::Group>& groupMap)
+{
+    if (src.GetNumTriangles() != mesh.GetNumTriangles())
+    {
+        return 1;
+    }
+    int numWrong = 0;
+    nArray<bool> seen(0, 0);
+    seen.SetFixedSize(src.GetNumTriangles());
+    seen.Fill(0, seen.Size(), false);
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < groupMap.Size(); groupIndex++)
+    {
+        const nMeshBuilder::Group& group = groupMap[groupIndex];
+        int triIndex;
+        for (triIndex = group.GetFirstTriangle(); triIndex < (group.GetFirstTriangle() + group.GetNumTriangles()); triIndex++)
+        {
+            int id = GetTriangleId(mesh, triIndex);
+            if ((id < 0) || (id >= src.GetNumTriangles()) || seen[id])
+            {
+                numWrong++;
+                continue;
+            }
+            seen[id] = true;
+            const nMeshBuilder::Triangle& srcTri = src.GetTriangleAt(id);
+            if ((srcTri.GetGroupId() != group.GetId()) ||
+                (srcTri.GetMaterialId() != group.GetMaterialId()) ||
+                (srcTri.GetUsageFlags() != group.GetUsageFlags()))
+            {
+                numWrong++;
+                continue;
+            }
+            int s[3], d[3];
+            srcTri.GetVertexIndices(s[0], s[1], s[2]);
+            mesh.GetTriangleAt(triIndex).GetVertexIndices(d[0], d[1], d[2]);
+            int i;
+            for (i = 0; i < 3; i++)
+            {
+                if (GetVertexId(mesh, d[i]) != s[i])
+                {
+                    numWrong++;
+                    break;
+                }
+            }
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Return true if the triangle has the directed edge from v0 to v1.
+*/
+static bool
+HasDirectedEdge(const nMeshBuilder::Triangle& tri, int v0, int v1)
+{
+    int v[3];
+    tri.GetVertexIndices(v[0], v[1], v[2]);
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        if ((v[i] == v0) && (v[(i + 1) % 3] == v1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check the edges built by CreateEdges(). An edge's faces must belong to
+    its group, the first face must contain the edge in the edge's direction,
+    the second one in the opposite direction. Every triangle must be
+    referenced by 3 edge sides, and GetGroupEdgeRange() must return the
+    edges of a group. Returns the number of differences.
+*/
+static int
+CheckEdges(const nMeshBuilder& mesh, const nArray<nMeshBuilder::Group>& groupMap)
+{
+    int numWrong = 0;
+    int numTriangles = mesh.GetNumTriangles();
+    nArray<int> numTriEdges(0, 0);
+    numTriEdges.SetFixedSize(numTriangles);
+    numTriEdges.Fill(0, numTriangles, 0);
+    int lastGroupId = -1;
+    int edgeIndex;
+    for (edgeIndex = 0; edgeIndex < mesh.GetNumEdges(); edgeIndex++)
+    {
+        const nMeshBuilder::GroupedEdge& edge = mesh.GetEdgeAt(edgeIndex);
+        if (edge.GroupID < lastGroupId)
+        {
+            numWrong++;
+        }
+        lastGroupId = edge.GroupID;
+        int i;
+        for (i = 0; i < 2; i++)
+        {
+            int face = edge.fIndex[i];
+            if ((1 == i) && (nMesh2::InvalidIndex == face))
+            {
+                continue;
+            }
+            if (face >= numTriangles)
+            {
+                numWrong++;
+                continue;
+            }
+            const nMeshBuilder::Triangle& tri = mesh.GetTriangleAt(face);
+            if ((tri.GetGroupId() != edge.GroupID) ||
+                !HasDirectedEdge(tri, edge.vIndex[i], edge.vIndex[1 - i]))
+            {
+                numWrong++;
+            }
+            numTriEdges[face]++;
+        }
+    }
+    int triIndex;
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        if (3 != numTriEdges[triIndex])
+        {
+            numWrong++;
+        }
+    }
+
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < groupMap.Size(); groupIndex++)
+    {
+        int groupId = groupMap[groupIndex].GetId();
+        int minEdgeIndex, maxEdgeIndex;
+        if (!mesh.GetGroupEdgeRange(groupId, minEdgeIndex, maxEdgeIndex))
+        {
+            numWrong++;
+            continue;
+        }
+        for (edgeIndex = 0; edgeIndex < mesh.GetNumEdges(); edgeIndex++)
+        {
+            bool inRange = (edgeIndex >= minEdgeIndex) && (edgeIndex <= maxEdgeIndex);
+            if (inRange != (mesh.GetEdgeAt(edgeIndex).GroupID == groupId))
+            {
+                numWrong++;
+            }
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the sorted edges of a mesh by original vertex and triangle indices.
+*/
+static void
+GetEdgeKeys(const nMeshBuilder& mesh, nArray<EdgeKey>& keys)
+{
+    int edgeIndex;
+    for (edgeIndex = 0; edgeIndex < mesh.GetNumEdges(); edgeIndex++)
+    {
+        const nMeshBuilder::GroupedEdge& edge = mesh.GetEdgeAt(edgeIndex);
+        EdgeKey key;
+        key.groupId = edge.GroupID;
+        key.vertex[0] = GetVertexId(mesh, edge.vIndex[0]);
+        key.vertex[1] = GetVertexId(mesh, edge.vIndex[1]);
+        key.face[0] = GetTriangleId(mesh, edge.fIndex[0]);
+        key.face[1] = (nMesh2::InvalidIndex == edge.fIndex[1]) ? -1 : GetTriangleId(mesh, edge.fIndex[1]);
+        if (key.vertex[0] > key.vertex[1])
+        {
+            int tmp = key.vertex[0];
+            key.vertex[0] = key.vertex[1];
+            key.vertex[1] = tmp;
+        }
+        if (key.face[0] > key.face[1])
+        {
+            int tmp = key.face[0];
+            key.face[0] = key.face[1];
+            key.face[1] = tmp;
+        }
+        keys.Append(key);
+    }
+    keys.Sort();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Optimize a copy of the source mesh with edges, and check it against
+    the source mesh.
+*/
+static void
+TestOptimize(const nMeshBuilder& src, bool sortClusters)
+{
+    nMeshBuilder ref;
+    ref.Copy(src);
+    ref.CreateEdges();
+    nArray<nMeshBuilder::Group> refGroups;
+    ref.BuildGroupMap(refGroups);
+
+    nMeshBuilder mesh;
+    mesh.Copy(src);
+    mesh.CreateEdges();
+    mesh.Optimize(sortClusters);
+
+    // group ranges
+    nArray<nMeshBuilder::Group> groups;
+    mesh.BuildGroupMap(groups);
+    n_test(groups.Size() == refGroups.Size());
+    int numWrong = 0;
+    int groupIndex;
+    for (groupIndex = 0; (groupIndex < groups.Size()) && (groupIndex < refGroups.Size()); groupIndex++)
+    {
+        const nMeshBuilder::Group& group = groups[groupIndex];
+        const nMeshBuilder::Group& refGroup = refGroups[groupIndex];
+        if ((group.GetId() != refGroup.GetId()) ||
+            (group.GetMaterialId() != refGroup.GetMaterialId()) ||
+            (group.GetUsageFlags() != refGroup.GetUsageFlags()) ||
+            (group.GetFirstTriangle() != refGroup.GetFirstTriangle()) ||
+            (group.GetNumTriangles() != refGroup.GetNumTriangles()))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+
+    // vertices and triangles up to the vertex remap
+    n_test(0 == CheckVertices(src, mesh));
+    n_test(0 == CheckTriangles(src, mesh, groups));
+    n_test(CountDegenerateTriangles(src) == CountDegenerateTriangles(mesh));
+
+    // edges
+    n_test(mesh.GetNumEdges() > 0);
+    n_test(0 == CheckEdges(ref, refGroups));
+    n_test(0 == CheckEdges(mesh, groups));
+    nArray<EdgeKey> refKeys;
+    nArray<EdgeKey> keys;
+    GetEdgeKeys(ref, refKeys);
+    GetEdgeKeys(mesh, keys);
+    n_test(refKeys == keys);
+
+    // the cache miss ratio of no group gets worse
+    numWrong = 0;
+    for (groupIndex = 0; groupIndex < groups.Size(); groupIndex++)
+    {
+        const nMeshBuilder::Group& group = groups[groupIndex];
+        int cacheSize;
+        for (cacheSize = 8; cacheSize <= 32; cacheSize *= 2)
+        {
+            float refAcmr, refAtvr, acmr, atvr;
+            ref.ComputeVertexCacheStats(group.GetFirstTriangle(), group.GetNumTriangles(), cacheSize, refAcmr, refAtvr);
+            mesh.ComputeVertexCacheStats(group.GetFirstTriangle(), group.GetNumTriangles(), cacheSize, acmr, atvr);
+            if (acmr > refAcmr)
+            {
+                printf("group %d, cache size %d: acmr %.3f -> %.3f\n", group.GetId(), cacheSize, refAcmr, acmr);
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+
+    // SortTriangles() keeps the optimized order
+    nMeshBuilder sorted;
+    sorted.Copy(mesh);
+    sorted.SortTriangles();
+    numWrong = 0;
+    int triIndex;
+    for (triIndex = 0; triIndex < mesh.GetNumTriangles(); triIndex++)
+    {
+        if (GetTriangleId(sorted, triIndex) != GetTriangleId(mesh, triIndex))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check that cluster sorting reorders the faces of the box (group 4),
+    without changing its cache miss ratio.
+*/
+static void
+TestClusterSort(const nMeshBuilder& src)
+{
+    nMeshBuilder mesh;
+    nMeshBuilder sorted;
+    mesh.Copy(src);
+    sorted.Copy(src);
+    mesh.Optimize(false);
+    sorted.Optimize(true);
+    nArray<nMeshBuilder::Group> groups;
+    mesh.BuildGroupMap(groups);
+    const nMeshBuilder::Group& box = groups.Back();
+    n_test(4 == box.GetId());
+
+    int numMoved = 0;
+    int triIndex;
+    for (triIndex = box.GetFirstTriangle(); triIndex < (box.GetFirstTriangle() + box.GetNumTriangles()); triIndex++)
+    {
+        if (GetTriangleId(mesh, triIndex) != GetTriangleId(sorted, triIndex))
+        {
+            numMoved++;
+        }
+    }
+    n_test(numMoved > 0);
+    float acmr, atvr, sortedAcmr, sortedAtvr;
+    mesh.ComputeVertexCacheStats(box.GetFirstTriangle(), box.GetNumTriangles(), 16, acmr, atvr);
+    sorted.ComputeVertexCacheStats(box.GetFirstTriangle(), box.GetNumTriangles(), 16, sortedAcmr, sortedAtvr);
+    n_test(acmr == sortedAcmr);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Print the cache miss ratios of a mesh with a single group.
+*/
+static void
+PrintCacheStats(const char* name, const nMeshBuilder& mesh)
+{
+    float acmr16, atvr16, acmr32, atvr32;
+    mesh.ComputeVertexCacheStats(0, mesh.GetNumTriangles(), 16, acmr16, atvr16);
+    mesh.ComputeVertexCacheStats(0, mesh.GetNumTriangles(), 32, acmr32, atvr32);
+    printf("%s: acmr %.3f, atvr %.3f (fifo 16), acmr %.3f, atvr %.3f (fifo 32)\n",
+           name, acmr16, atvr16, acmr32, atvr32);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int size = n_max(2, args.GetIntArg("-size", 200));
+    int numRepeats = n_max(1, args.GetIntArg("-repeat", 5));
+
+    // row order and random order input
+    nRandom random(1234);
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        nMeshBuilder src;
+        SetupMesh(src, 30, (1 == i), random);
+        n_test(3 == CountDegenerateTriangles(src));
+        TestOptimize(src, false);
+        TestOptimize(src, true);
+        TestClusterSort(src);
+    }
+
+    // benchmark
+    nMeshBuilder rowOrder;
+    nArray<nMeshBuilder::Triangle> tris;
+    int firstVertex = AddGridVertices(rowOrder, size, 1.0f);
+    AddGridTriangles(tris, firstVertex, size, 0, 0, size, size, 0, 0);
+    AddTriangles(rowOrder, tris, false, random);
+    nMeshBuilder shuffled;
+    shuffled.Copy(rowOrder);
+    shuffled.triangleArray.Clear();
+    AddTriangles(shuffled, tris, true, random);
+    printf("%d triangles, %d vertices\n", shuffled.GetNumTriangles(), shuffled.GetNumVertices());
+    PrintCacheStats("random order", shuffled);
+    PrintCacheStats("row order", rowOrder);
+
+    for (i = 0; i < 2; i++)
+    {
+        bool sortClusters = (1 == i);
+        nMeshBuilder mesh;
+        double time = 0.0;
+        int repeat;
+        for (repeat = 0; repeat < numRepeats; repeat++)
+        {
+            mesh.Copy(shuffled);
+            nTest::Timer timer;
+            mesh.Optimize(sortClusters);
+            time += timer.GetTime();
+        }
+        printf("Optimize(%s): %.1f ms\n", sortClusters ? "true" : "false", time * 1000.0 / numRepeats);
+        PrintCacheStats(sortClusters ? "optimized, sorted clusters" : "optimized", mesh);
+    }
+    return nTest::Finish("nmeshoptimizetest");
+}
@@ -0,0 +1,269 @@
+//------------------------------------------------------------------------------
+//  nnohtest.cc
+//
+//  Tests and benchmarks name lookups in the Nebula object hierarchy.
+//  -objects nRoot objects are created under /res/test, then nRoot::Find()
+//  (which uses the child index) and nKernelServer::Lookup() (which uses
+//  the child index and the path cache) are compared against a linear
+//  walk over the children. Removing, renaming, releasing and recreating
+//  objects must not leave stale entries in the child index or in the
+//  path cache.
+//
+//  Command line args:
+//  -objects    number of objects under /res/test (default: 100000)
+//  -repeat     number of measured passes (default: 5)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nroot.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int NumHotPaths = 64;
+static const int NumLinearChecks = 500;
+
+//------------------------------------------------------------------------------
+/**
+    Find a child by comparing the names of all children, like nRoot::Find()
+    did before the child index.
+*/
+static nRoot*
+FindLinear(nRoot* parent, const char* name)
+{
+    nRoot* child;
+    for (child = parent->GetHead(); child; child = child->GetSucc())
+    {
+        if (0 == strcmp(child->GetName(), name))
+        {
+            return child;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Resolve an absolute path component by component with FindLinear().
+*/
+static nRoot*
+LookupLinear(nRoot* root, const char* path)
+{
+    char buf[N_MAXPATH];
+    n_strncpy2(buf, path, sizeof(buf));
+    nRoot* cur = root;
+    char* str = buf;
+    char* component;
+    while ((component = strtok(str, "/")) && cur)
+    {
+        str = 0;
+        cur = FindLinear(cur, component);
+    }
+    return cur;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static nString
+ObjectName(int i)
+{
+    nString name;
+    name.Format("obj%d", i);
+    return name;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Remove, rename, release and recreate objects and check that Find(),
+    Lookup() and the linear walk agree afterwards.
+*/
+static void
+TestInvalidation(nKernelServer& kernelServer, nRoot* parent, nArray<nRoot*>& objects)
+{
+    int numObjects = objects.Size();
+    int step = n_max(1, numObjects / NumLinearChecks);
+    nRoot* obj = objects[5];
+
+    // rename a cached object
+    n_test(obj == kernelServer.Lookup("/res/test/obj5"));
+    obj->SetName("renamed5");
+    n_test(0 == kernelServer.Lookup("/res/test/obj5"));
+    n_test(0 == parent->Find("obj5"));
+    n_test(obj == kernelServer.Lookup("/res/test/renamed5"));
+    n_test(obj == parent->Find("renamed5"));
+    obj->SetName("obj5");
+    n_test(obj == kernelServer.Lookup("/res/test/obj5"));
+    n_test(0 == kernelServer.Lookup("/res/test/renamed5"));
+
+    // unlink a cached object and link it back
+    obj = objects[7];
+    n_test(obj == kernelServer.Lookup("/res/test/obj7"));
+    obj->Remove();
+    n_test(0 == kernelServer.Lookup("/res/test/obj7"));
+    n_test(0 == parent->Find("obj7"));
+    parent->AddTail(obj);
+    n_test(obj == kernelServer.Lookup("/res/test/obj7"));
+    n_test(obj == parent->Find("obj7"));
+
+    // release every third object and recreate some of them
+    int i;
+    for (i = 0; i < numObjects; i += 3)
+    {
+        nString path("/res/test/");
+        path.Append(ObjectName(i));
+        n_test(objects[i] == kernelServer.Lookup(path.Get()));
+        objects[i]->Release();
+        n_test(0 == kernelServer.Lookup(path.Get()));
+        objects[i] = 0;
+        if (0 == (i % 2))
+        {
+            objects[i] = kernelServer.New("nroot", path.Get());
+        }
+    }
+    int numWrong = 0;
+    for (i = 0; i < numObjects; i++)
+    {
+        nString name = ObjectName(i);
+        nString path("/res/test/");
+        path.Append(name);
+        if ((objects[i] != parent->Find(name.Get())) ||
+            (objects[i] != kernelServer.Lookup(path.Get())) ||
+            ((0 == (i % step)) && (objects[i] != FindLinear(parent, name.Get()))))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+    n_test(numObjects - ((numObjects + 2) / 3) + ((numObjects + 5) / 6) == parent->GetNumChildren());
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numObjects = n_max(NumHotPaths, args.GetIntArg("-objects", 100000));
+    int numRepeats = n_max(1, args.GetIntArg("-repeat", 5));
+
+    nKernelServer kernelServer;
+    nRoot* root = kernelServer.Lookup("/");
+    nArray<nString> names;
+    nArray<nString> paths;
+    nArray<nRoot*> objects;
+    names.SetFixedSize(numObjects);
+    paths.SetFixedSize(numObjects);
+    objects.SetFixedSize(numObjects);
+    int i;
+    for (i = 0; i < numObjects; i++)
+    {
+        names[i] = ObjectName(i);
+        paths[i] = "/res/test/";
+        paths[i].Append(names[i]);
+    }
+
+    // New() looks up the parent of every object
+    nTest::Timer timer;
+    for (i = 0; i < numObjects; i++)
+    {
+        objects[i] = kernelServer.New("nroot", paths[i].Get());
+    }
+    double newTime = timer.GetTime();
+    nRoot* parent = kernelServer.Lookup("/res/test");
+    n_test(parent && (numObjects == parent->GetNumChildren()));
+
+    // all lookups must find the same objects, the linear walk is O(n) per
+    // lookup, so it only checks and measures every step'th name
+    int step = n_max(1, numObjects / NumLinearChecks);
+    int numLinear = numObjects / step;
+    int numWrong = 0;
+    for (i = 0; i < numObjects; i++)
+    {
+        if ((objects[i] != parent->Find(names[i].Get())) ||
+            (objects[i] != kernelServer.Lookup(paths[i].Get())))
+        {
+            numWrong++;
+        }
+        else if ((0 == (i % step)) &&
+                 ((objects[i] != FindLinear(parent, names[i].Get())) ||
+                  (objects[i] != LookupLinear(root, paths[i].Get()))))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+    n_test(0 == parent->Find("missing"));
+    n_test(0 == kernelServer.Lookup("/res/test/missing"));
+    n_test(parent == objects[0]->Find(".."));
+
+    int repeat;
+    timer.Start();
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        for (i = 0; i < numObjects; i++)
+        {
+            parent->Find(names[i].Get());
+        }
+    }
+    double findTime = timer.GetTime() / (double(numObjects) * numRepeats);
+    timer.Start();
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        for (i = 0; i < numLinear; i++)
+        {
+            FindLinear(parent, names[i * step].Get());
+        }
+    }
+    double findLinearTime = timer.GetTime() / (double(numLinear) * numRepeats);
+
+    // full paths, mostly missing the path cache
+    timer.Start();
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        for (i = 0; i < numObjects; i++)
+        {
+            kernelServer.Lookup(paths[i].Get());
+        }
+    }
+    double lookupTime = timer.GetTime() / (double(numObjects) * numRepeats);
+    timer.Start();
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        for (i = 0; i < numLinear; i++)
+        {
+            LookupLinear(root, paths[i * step].Get());
+        }
+    }
+    double lookupLinearTime = timer.GetTime() / (double(numLinear) * numRepeats);
+
+    // a few hot paths which stay in the path cache
+    int numHotLookups = numObjects * numRepeats;
+    timer.Start();
+    for (i = 0; i < numHotLookups; i++)
+    {
+        kernelServer.Lookup(paths[i % NumHotPaths].Get());
+    }
+    double hotLookupTime = timer.GetTime() / double(numHotLookups);
+
+    printf("%d objects: New %.3f us\n", numObjects, (newTime * 1000000.0) / numObjects);
+    printf("Find: index %.3f us, linear %.3f us, speedup %.1f\n",
+           findTime * 1000000.0, findLinearTime * 1000000.0,
+           (findTime > 0.0) ? findLinearTime / findTime : 0.0);
+    printf("Lookup: %.3f us, cached %.3f us, linear %.3f us, speedup %.1f\n",
+           lookupTime * 1000000.0, hotLookupTime * 1000000.0, lookupLinearTime * 1000000.0,
+           (lookupTime > 0.0) ? lookupLinearTime / lookupTime : 0.0);
+
+    TestInvalidation(kernelServer, parent, objects);
+
+    for (i = 0; i < numObjects; i++)
+    {
+        if (objects[i])
+        {
+            objects[i]->Release();
+        }
+    }
+    n_test(0 == parent->GetNumChildren());
+    return nTest::Finish("nnohtest");
+}
@@ -0,0 +1,531 @@
+//------------------------------------------------------------------------------
+//  nnpkcompressiontest.cc
+//
+//  Tests and benchmarks compressed npk files. -files entries of three
+//  types (text, vertex data and random bytes) with about -megabytes of
+//  data are written into an uncompressed version 0 npk file. nNpkBuilder
+//  packs the mounted entries into a compressed version 2 npk file. The
+//  compression ratio of every type is reported.
+//
+//  Both npk files are read from -threads threads at once with random
+//  seeks and partial reads, with a block cache of 2 blocks (fewer blocks
+//  than threads) and with the default block cache. Every byte must
+//  match. Then both npk files are read from 1 to -threads threads
+//  (doubling the thread count), whole entries and random 4 KB reads.
+//
+//  Command line args:
+//  -files      number of entries (default: 600)
+//  -megabytes  total size of the entries (default: 64)
+//  -reads      number of random reads per thread and pass (default: 4000)
+//  -threads    highest number of reading threads (default: 8)
+//  -dir        existing directory for the npk files (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/nthread.h"
+#include "kernel/ninterlocked.h"
+#include "file/nnpkfileserver.h"
+#include "file/nnpkfilewrapper.h"
+#include "file/nnpkcodec.h"
+#include "tools/nnpkbuilder.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const char* RootDirName = "nnpkcompressiontest";
+static const int SmallReadSize = 4096;
+static const int NumTypes = 3;
+static const char* TypeExtensions[NumTypes] = { "txt", "nvx", "rnd" };
+
+//------------------------------------------------------------------------------
+/**
+    An entry of the test npk files with its content.
+*/
+struct TestEntry
+{
+    nString filename;       // the file name for nNpkFile::Open()
+    int type;               // index into TypeExtensions
+    int length;
+    uchar* data;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The ways the entries are read.
+*/
+enum ReadMode
+{
+    RandomReads,            // random seeks and partial reads
+    WholeEntries,           // every entry once from start to end
+    SmallReads,             // random SmallReadSize reads
+};
+
+//------------------------------------------------------------------------------
+/**
+    Shared state of all reading threads.
+*/
+struct ReadPass
+{
+    ReadMode mode;
+    const nArray<TestEntry>* entries;
+    int numReads;
+    volatile long nextEntry;
+    volatile long numWrong;
+    volatile long bytesRead;
+    volatile long startFlag;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Per thread state.
+*/
+struct ReadJob
+{
+    ReadPass* pass;
+    uchar* buffer;
+    int seed;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Fill an entry with data of its type: text compresses well, vertex
+    data compresses a little, random bytes don't compress at all.
+*/
+static void
+GenerateEntry(TestEntry& entry, nRandom& random)
+{
+    static const char* words[] = { "setposition", "settexture", "new", "sel", "..", "nshapenode",
+                                   "ntransformnode", "setshader", "shaders:default.fx", "0.000000" };
+    int numWords = sizeof(words) / sizeof(words[0]);
+    uchar* data = entry.data;
+    int pos = 0;
+    if (0 == entry.type)
+    {
+        while (pos < entry.length)
+        {
+            const char* word = words[random.Next() % numWords];
+            while (*word && (pos < entry.length))
+            {
+                data[pos++] = *word++;
+            }
+            if (pos < entry.length)
+            {
+                data[pos++] = (0 == random.Next() % 6) ? '\n' : ' ';
+            }
+        }
+    }
+    else if (1 == entry.type)
+    {
+        // a grid of positions, normals and uvs
+        int vertex = 0;
+        while (pos < entry.length)
+        {
+            float v[8];
+            v[0] = float(vertex % 64) * 0.25f;
+            v[1] = float(random.Next() % 16) * 0.125f;
+            v[2] = float(vertex / 64) * 0.25f;
+            v[3] = 0.0f;
+            v[4] = 1.0f;
+            v[5] = 0.0f;
+            v[6] = float(vertex % 64) / 64.0f;
+            v[7] = float(vertex / 64) / 64.0f;
+            int num = n_min(int(sizeof(v)), entry.length - pos);
+            memcpy(data + pos, v, num);
+            pos += num;
+            vertex++;
+        }
+    }
+    else
+    {
+        for (pos = 0; pos < entry.length; pos++)
+        {
+            data[pos] = uchar(random.Next() >> 7);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write a version 0 npk file with one root directory which contains
+    all entries, see nNpkFileServer for the format.
+*/
+static bool
+WriteNpk(const nString& filename, const nArray<TestEntry>& entries)
+{
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (!file->Open(filename, "wb"))
+    {
+        file->Release();
+        return false;
+    }
+    file->PutInt('NPK0');
+    file->PutInt(4);
+    file->PutInt(0);
+
+    int rootNameLen = strlen(RootDirName);
+    file->PutInt('DIR_');
+    file->PutInt(sizeof(short) + rootNameLen);
+    file->PutShort(short(rootNameLen));
+    file->Write(RootDirName, rootNameLen);
+    int i;
+    int offset = 0;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        nString name = entries[i].filename.ExtractFileName();
+        file->PutInt('FILE');
+        file->PutInt(2 * sizeof(int) + sizeof(short) + name.Length());
+        file->PutInt(offset);
+        file->PutInt(entries[i].length);
+        file->PutShort(short(name.Length()));
+        file->Write(name.Get(), name.Length());
+        offset += entries[i].length;
+    }
+    file->PutInt('DEND');
+    file->PutInt(0);
+
+    int dataOffset = file->Tell();
+    file->PutInt('DATA');
+    file->PutInt(offset);
+    bool success = true;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        if (entries[i].length != file->Write(entries[i].data, entries[i].length))
+        {
+            success = false;
+        }
+    }
+    file->Seek(2 * sizeof(int), nFile::START);
+    file->PutInt(dataOffset);
+    file->Close();
+    file->Release();
+    return success;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Pack the entries of the mounted npk file into a compressed npk file
+    with nNpkBuilder, the builder reads its source files through the
+    file server.
+*/
+static bool
+WriteCompressedNpk(const nString& filename, const nString& rootPath, const nArray<TestEntry>& entries)
+{
+    nNpkToc toc;
+    toc.SetRootPath(rootPath.Get());
+    toc.BeginDirEntry(RootDirName);
+    int i;
+    int offset = 0;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        toc.AddFileEntry(entries[i].filename.ExtractFileName().Get(), offset, entries[i].length);
+        offset += entries[i].length;
+    }
+    toc.EndDirEntry();
+
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (!file->Open(filename, "wb"))
+    {
+        file->Release();
+        return false;
+    }
+    nNpkBuilder builder;
+    builder.SetCompression(true);
+    bool success = builder.Write(&toc, file);
+    file->Close();
+    file->Release();
+    return success;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Print the compression ratio of every entry type of a compressed npk
+    file and check that random entries weren't compressed.
+*/
+static void
+PrintCompressionStats(const nString& filename, const nString& rootPath, const nArray<TestEntry>& entries)
+{
+    nFileServer2* fileServer = nFileServer2::Instance();
+    nNpkFileWrapper wrapper;
+    n_test(wrapper.Open(fileServer, rootPath.Get(), fileServer->ManglePath(filename).Get()));
+    n_test(2 == wrapper.GetVersion());
+    double length[NumTypes] = { 0.0 };
+    double compressedLength[NumTypes] = { 0.0 };
+    int numCompressed[NumTypes] = { 0 };
+    int numEntries[NumTypes] = { 0 };
+    int numMissing = 0;
+    int i;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        nString absPath = fileServer->ManglePath(entries[i].filename);
+        nNpkTocEntry* tocEntry = wrapper.GetTocObject().FindEntry(absPath.Get());
+        if (0 == tocEntry)
+        {
+            numMissing++;
+            continue;
+        }
+        int type = entries[i].type;
+        numEntries[type]++;
+        length[type] += tocEntry->GetFileLength();
+        if (tocEntry->IsCompressed())
+        {
+            numCompressed[type]++;
+            compressedLength[type] += tocEntry->GetCompressedLength();
+        }
+        else
+        {
+            compressedLength[type] += tocEntry->GetFileLength();
+        }
+    }
+    n_test(0 == numMissing);
+    n_test(0 == numCompressed[2]);
+    n_test(numEntries[0] == numCompressed[0]);
+    for (i = 0; i < NumTypes; i++)
+    {
+        printf("%s: %d entries, %d compressed, %.1f MB -> %.1f MB (%.1f%%)\n",
+               TypeExtensions[i], numEntries[i], numCompressed[i],
+               length[i] / (1024.0 * 1024.0), compressedLength[i] / (1024.0 * 1024.0),
+               (length[i] > 0.0) ? (100.0 * compressedLength[i] / length[i]) : 100.0);
+    }
+    wrapper.Close();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read a range of an entry and compare it with the content of the entry.
+*/
+static bool
+ReadRange(nFile* file, const TestEntry& entry, int pos, int num, uchar* buffer)
+{
+    if (!file->Seek(pos, nFile::START))
+    {
+        return false;
+    }
+    int expected = n_min(num, entry.length - pos);
+    return (expected == file->Read(buffer, num)) &&
+           (0 == memcmp(buffer, entry.data + pos, expected)) &&
+           (file->Tell() == (pos + expected));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read the entries in the mode of the pass.
+*/
+static int
+N_THREADPROC
+ReadThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    ReadJob* job = (ReadJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    ReadPass* pass = job->pass;
+    const nArray<TestEntry>& entries = *pass->entries;
+    nRandom random(job->seed);
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+
+    // start all threads at once
+    while (0 == n_interlocked_read(&pass->startFlag))
+    {
+        n_sleep(0.0);
+    }
+
+    int numWrong = 0;
+    int bytesRead = 0;
+    if (WholeEntries == pass->mode)
+    {
+        int index;
+        while ((index = n_interlocked_increment(&pass->nextEntry) - 1) < entries.Size())
+        {
+            const TestEntry& entry = entries[index];
+            if (!file->Open(entry.filename, "rb") || !ReadRange(file, entry, 0, entry.length, job->buffer))
+            {
+                numWrong++;
+            }
+            if (file->IsOpen())
+            {
+                file->Close();
+            }
+            bytesRead += entry.length;
+        }
+    }
+    else
+    {
+        int i;
+        for (i = 0; i < pass->numReads; i++)
+        {
+            const TestEntry& entry = entries[random.Next() % entries.Size()];
+            int pos = random.Next() % (entry.length + 1);
+            int num = (SmallReads == pass->mode) ? SmallReadSize : (random.Next() % (entry.length + 1));
+            if (!file->Open(entry.filename, "rb") || !ReadRange(file, entry, pos, num, job->buffer))
+            {
+                numWrong++;
+            }
+            if (file->IsOpen())
+            {
+                file->Close();
+            }
+            bytesRead += n_min(num, entry.length - pos);
+        }
+    }
+    n_interlocked_add(&pass->numWrong, numWrong);
+    n_interlocked_add(&pass->bytesRead, bytesRead);
+    file->Release();
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Run a pass from numThreads threads, returns the wall time.
+*/
+static double
+RunPass(ReadPass& pass, int numThreads, int maxLength)
+{
+    pass.nextEntry = 0;
+    pass.numWrong = 0;
+    pass.bytesRead = 0;
+    pass.startFlag = 0;
+    nArray<ReadJob> jobs;
+    nArray<nThread*> threads;
+    jobs.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].pass = &pass;
+        jobs[i].buffer = n_new_array(uchar, maxLength + 1);
+        jobs[i].seed = 1234 + i;
+        threads[i] = n_new(nThread(ReadThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+    }
+    nTest::Timer timer;
+    n_interlocked_exchange(&pass.startFlag, 1);
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(threads[i]);
+    }
+    double time = timer.GetTime();
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete_array(jobs[i].buffer);
+    }
+    return time;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Mount a npk file, stress it with random reads and return the
+    throughput of whole entry and small reads per thread count.
+*/
+static void
+TestNpk(const nString& filename, nArray<TestEntry>& entries, int numReads, int maxThreads, int maxLength,
+        nArray<double>& wholeRates, nArray<double>& smallRates)
+{
+    nNpkFileServer* fileServer = (nNpkFileServer*) nFileServer2::Instance();
+    n_test(fileServer->ParseNpkFile(filename));
+    int defaultCacheSize = fileServer->GetBlockCacheSize();
+
+    ReadPass pass;
+    pass.entries = &entries;
+    pass.numReads = numReads;
+    pass.mode = RandomReads;
+
+    // a block cache with fewer blocks than threads, and the default one
+    fileServer->SetBlockCacheSize(2);
+    RunPass(pass, maxThreads, maxLength);
+    n_test(0 == pass.numWrong);
+    fileServer->SetBlockCacheSize(defaultCacheSize);
+    RunPass(pass, maxThreads, maxLength);
+    n_test(0 == pass.numWrong);
+
+    wholeRates.Clear();
+    smallRates.Clear();
+    int numThreads = 1;
+    while (numThreads <= maxThreads)
+    {
+        pass.mode = WholeEntries;
+        double time = RunPass(pass, numThreads, maxLength);
+        n_test(0 == pass.numWrong);
+        wholeRates.Append((time > 0.0) ? (pass.bytesRead / (1024.0 * 1024.0)) / time : 0.0);
+        pass.mode = SmallReads;
+        time = RunPass(pass, numThreads, maxLength);
+        n_test(0 == pass.numWrong);
+        smallRates.Append((time > 0.0) ? (pass.bytesRead / (1024.0 * 1024.0)) / time : 0.0);
+        numThreads = (numThreads == maxThreads) ? maxThreads + 1 : n_min(numThreads * 2, maxThreads);
+    }
+    fileServer->ReleaseNpkFiles(fileServer->ManglePath(filename));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numFiles = n_max(NumTypes, args.GetIntArg("-files", 600));
+    int megabytes = n_max(1, n_min(args.GetIntArg("-megabytes", 64), 1000));
+    int numReads = n_max(1, args.GetIntArg("-reads", 4000));
+    int maxThreads = n_max(1, args.GetIntArg("-threads", 8));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.ReplaceFileServer("nnpkfileserver");
+    nNpkFileServer* fileServer = (nNpkFileServer*) nFileServer2::Instance();
+
+    // entries between 1 byte and twice the average size
+    nRandom random(1234);
+    int averageLength = int((double(megabytes) * 1024.0 * 1024.0) / numFiles);
+    int maxLength = n_max(1, 2 * averageLength);
+    nArray<TestEntry> entries;
+    entries.SetFixedSize(numFiles);
+    int i;
+    for (i = 0; i < numFiles; i++)
+    {
+        TestEntry& entry = entries[i];
+        entry.type = i % NumTypes;
+        entry.filename.Format("%s/%s/file%d.%s", dir.Get(), RootDirName, i, TypeExtensions[entry.type]);
+        entry.length = 1 + random.Next() % maxLength;
+        entry.data = n_new_array(uchar, entry.length);
+        GenerateEntry(entry, random);
+    }
+
+    // the uncompressed npk file, then pack its entries compressed
+    nString npkFilename;
+    nString compressedFilename;
+    npkFilename.Format("%s/%s.npk", dir.Get(), RootDirName);
+    compressedFilename.Format("%s/%s_lz.npk", dir.Get(), RootDirName);
+    nString rootPath = fileServer->ManglePath(npkFilename.ExtractDirName());
+    n_test(WriteNpk(npkFilename, entries));
+    n_test(fileServer->ParseNpkFile(npkFilename));
+    n_test(WriteCompressedNpk(compressedFilename, rootPath, entries));
+    fileServer->ReleaseNpkFiles(fileServer->ManglePath(npkFilename));
+    PrintCompressionStats(compressedFilename, rootPath, entries);
+
+    nArray<double> wholeRates[2];
+    nArray<double> smallRates[2];
+    TestNpk(npkFilename, entries, numReads, maxThreads, maxLength, wholeRates[0], smallRates[0]);
+    TestNpk(compressedFilename, entries, numReads, maxThreads, maxLength, wholeRates[1], smallRates[1]);
+    int numThreads = 1;
+    for (i = 0; i < wholeRates[0].Size(); i++)
+    {
+        printf("threads %d: whole entries %.0f MB/s, lz %.0f MB/s; %d byte reads %.0f MB/s, lz %.0f MB/s\n",
+               numThreads, wholeRates[0][i], wholeRates[1][i], SmallReadSize, smallRates[0][i], smallRates[1][i]);
+        numThreads = (numThreads == maxThreads) ? maxThreads + 1 : n_min(numThreads * 2, maxThreads);
+    }
+    nNpkBlockCache* blockCache = fileServer->GetBlockCache();
+    printf("block cache: %d blocks, %d hits, %d misses\n",
+           blockCache->GetNumBlocks(), blockCache->GetNumHits(), blockCache->GetNumMisses());
+
+    for (i = 0; i < numFiles; i++)
+    {
+        n_delete_array(entries[i].data);
+    }
+    fileServer->DeleteFile(npkFilename);
+    fileServer->DeleteFile(compressedFilename);
+    return nTest::Finish("nnpkcompressiontest");
+}
@@ -0,0 +1,434 @@
+//------------------------------------------------------------------------------
+//  nnpkreadtest.cc
+//
+//  Stress test and benchmark for reading npk files from several threads.
+//  A npk file with -files entries and about -megabytes of data is written
+//  to -dir and mounted with nNpkFileServer. All entries are read with
+//  random seeks and partial reads from -threads threads at once, every
+//  byte must match. Then every entry is read from 1 to -threads threads
+//  (doubling the thread count) in three ways:
+//
+//  - shared: seek and read on one shared nFile under a lock, like the
+//    npk reads worked before the npk file was mapped
+//  - read: nNpkFile::Read(), positional reads from the mapping
+//  - mapped: nNpkFile::ReadMapped(), no copy at all
+//
+//  Every pass checksums all bytes it reads. The npk file usually stays
+//  in the file system cache after it has been written, so this measures
+//  the read path and not the disk.
+//
+//  Command line args:
+//  -files      number of entries (default: 2000)
+//  -megabytes  total size of the entries, at most 2000 (default: 512)
+//  -threads    highest number of reading threads (default: 8)
+//  -dir        existing directory for the npk file (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/nthread.h"
+#include "kernel/nmutex.h"
+#include "kernel/ninterlocked.h"
+#include "file/nnpkfileserver.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const char* RootDirName = "nnpkreadtest";
+static const int NumSeeksPerEntry = 8;
+
+//------------------------------------------------------------------------------
+/**
+    An entry of the test npk file.
+*/
+struct TestEntry
+{
+    nString filename;       // the file name for nNpkFile::Open()
+    int fileOffset;         // absolute offset of the data in the npk file
+    int fileLength;
+    uint checksum;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The ways an entry is read.
+*/
+enum ReadMode
+{
+    RandomSeeks,
+    SharedFile,
+    NpkRead,
+    NpkReadMapped,
+};
+
+//------------------------------------------------------------------------------
+/**
+    Shared state of all reading threads.
+*/
+struct ReadPass
+{
+    ReadMode mode;
+    const nArray<TestEntry>* entries;
+    nFile* sharedFile;
+    nMutex sharedFileMutex;
+    volatile long nextEntry;
+    volatile long numWrong;
+    volatile long numMapped;
+    volatile long startFlag;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Per thread state.
+*/
+struct ReadJob
+{
+    ReadPass* pass;
+    uchar* buffer;
+    int seed;
+};
+
+//------------------------------------------------------------------------------
+/**
+    The content of the entries, byte pos of entry index.
+*/
+static uchar
+PatternByte(int index, int pos)
+{
+    uint x = uint(index) * 2654435761u + uint(pos >> 2) * 2246822519u;
+    x ^= x >> 15;
+    x *= 2654435761u;
+    return uchar(x >> ((pos & 3) * 8));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static uint
+Checksum(const uchar* data, int num)
+{
+    uint sum = 0;
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        sum += data[i];
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write a version 0 npk file with one root directory which contains
+    all entries, see nNpkFileServer for the format. Fills in the absolute
+    offsets and the checksums of the entries.
+*/
+static bool
+WriteNpk(const nString& filename, nArray<TestEntry>& entries, int maxLength)
+{
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (!file->Open(filename, "wb"))
+    {
+        file->Release();
+        return false;
+    }
+    file->PutInt('NPK0');
+    file->PutInt(4);
+    file->PutInt(0);
+
+    int rootNameLen = strlen(RootDirName);
+    file->PutInt('DIR_');
+    file->PutInt(sizeof(short) + rootNameLen);
+    file->PutShort(short(rootNameLen));
+    file->Write(RootDirName, rootNameLen);
+    int i;
+    int offset = 0;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        nString name = entries[i].filename.ExtractFileName();
+        file->PutInt('FILE');
+        file->PutInt(2 * sizeof(int) + sizeof(short) + name.Length());
+        file->PutInt(offset);
+        file->PutInt(entries[i].fileLength);
+        file->PutShort(short(name.Length()));
+        file->Write(name.Get(), name.Length());
+        entries[i].fileOffset = offset;
+        offset += entries[i].fileLength;
+    }
+    file->PutInt('DEND');
+    file->PutInt(0);
+
+    // the data block
+    int dataOffset = file->Tell();
+    file->PutInt('DATA');
+    file->PutInt(offset);
+    uchar* buffer = n_new_array(uchar, maxLength);
+    bool success = true;
+    for (i = 0; i < entries.Size(); i++)
+    {
+        int pos;
+        for (pos = 0; pos < entries[i].fileLength; pos++)
+        {
+            buffer[pos] = PatternByte(i, pos);
+        }
+        entries[i].checksum = Checksum(buffer, entries[i].fileLength);
+        entries[i].fileOffset += dataOffset + 2 * sizeof(int);
+        if (entries[i].fileLength != file->Write(buffer, entries[i].fileLength))
+        {
+            success = false;
+        }
+    }
+    n_delete_array(buffer);
+
+    // patch the data offset in the header
+    file->Seek(2 * sizeof(int), nFile::START);
+    file->PutInt(dataOffset);
+    file->Close();
+    file->Release();
+    return success;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read random ranges of an entry and compare them with the pattern.
+*/
+static bool
+ReadRandomSeeks(nFile* file, int index, int length, uchar* buffer, nRandom& random)
+{
+    int i;
+    for (i = 0; i < NumSeeksPerEntry; i++)
+    {
+        int pos = random.Next() % (length + 1);
+        int num = random.Next() % (length + 1);
+        file->Seek(pos, nFile::START);
+        int expected = n_min(num, length - pos);
+        if (expected != file->Read(buffer, num))
+        {
+            return false;
+        }
+        int j;
+        for (j = 0; j < expected; j++)
+        {
+            if (buffer[j] != PatternByte(index, pos + j))
+            {
+                return false;
+            }
+        }
+        if (file->Tell() != (pos + expected))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read one entry in the mode of the pass, returns false if the data
+    is wrong.
+*/
+static bool
+ReadEntry(ReadJob* job, int index, nFile* file, nRandom& random)
+{
+    ReadPass* pass = job->pass;
+    const TestEntry& entry = (*pass->entries)[index];
+    if (SharedFile == pass->mode)
+    {
+        pass->sharedFileMutex.Lock();
+        pass->sharedFile->Seek(entry.fileOffset, nFile::START);
+        int bytesRead = pass->sharedFile->Read(job->buffer, entry.fileLength);
+        pass->sharedFileMutex.Unlock();
+        return (bytesRead == entry.fileLength) && (entry.checksum == Checksum(job->buffer, entry.fileLength));
+    }
+
+    if (!file->Open(entry.filename, "rb"))
+    {
+        return false;
+    }
+    bool ok = false;
+    if (RandomSeeks == pass->mode)
+    {
+        ok = ReadRandomSeeks(file, index, entry.fileLength, job->buffer, random);
+    }
+    else if (NpkRead == pass->mode)
+    {
+        int bytesRead = file->Read(job->buffer, entry.fileLength);
+        ok = (bytesRead == entry.fileLength) && (entry.checksum == Checksum(job->buffer, entry.fileLength));
+    }
+    else
+    {
+        const uchar* data = (const uchar*) file->ReadMapped(entry.fileLength);
+        if (data)
+        {
+            n_interlocked_increment(&pass->numMapped);
+            ok = (entry.checksum == Checksum(data, entry.fileLength));
+        }
+    }
+    file->Close();
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Take the next unread entry until all entries have been read.
+*/
+static int
+N_THREADPROC
+ReadThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    ReadJob* job = (ReadJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    ReadPass* pass = job->pass;
+    nRandom random(job->seed);
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+
+    // start all threads at once
+    while (0 == n_interlocked_read(&pass->startFlag))
+    {
+        n_sleep(0.0);
+    }
+
+    int numEntries = pass->entries->Size();
+    int index;
+    while ((index = n_interlocked_increment(&pass->nextEntry) - 1) < numEntries)
+    {
+        if (!ReadEntry(job, index, file, random))
+        {
+            n_interlocked_increment(&pass->numWrong);
+        }
+    }
+    file->Release();
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Read all entries from numThreads threads, returns the wall time.
+*/
+static double
+RunPass(ReadPass& pass, int numThreads, int maxLength)
+{
+    pass.nextEntry = 0;
+    pass.numWrong = 0;
+    pass.numMapped = 0;
+    pass.startFlag = 0;
+    nArray<ReadJob> jobs;
+    nArray<nThread*> threads;
+    jobs.SetFixedSize(numThreads);
+    threads.SetFixedSize(numThreads);
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].pass = &pass;
+        jobs[i].buffer = n_new_array(uchar, maxLength + 1);
+        jobs[i].seed = 1234 + i;
+        threads[i] = n_new(nThread(ReadThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+    }
+    nTest::Timer timer;
+    n_interlocked_exchange(&pass.startFlag, 1);
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(threads[i]);
+    }
+    double time = timer.GetTime();
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete_array(jobs[i].buffer);
+    }
+    return time;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numFiles = n_max(1, args.GetIntArg("-files", 2000));
+    int megabytes = n_max(1, n_min(args.GetIntArg("-megabytes", 512), 2000));
+    int maxThreads = n_max(1, args.GetIntArg("-threads", 8));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.ReplaceFileServer("nnpkfileserver");
+    nNpkFileServer* fileServer = (nNpkFileServer*) nFileServer2::Instance();
+
+    // entries between 1 byte and twice the average size
+    nRandom random(1234);
+    int averageLength = int((double(megabytes) * 1024.0 * 1024.0) / numFiles);
+    int maxLength = n_max(1, 2 * averageLength);
+    nArray<TestEntry> entries;
+    entries.SetFixedSize(numFiles);
+    double totalMegabytes = 0.0;
+    int i;
+    for (i = 0; i < numFiles; i++)
+    {
+        entries[i].filename.Format("%s/%s/file%d.bin", dir.Get(), RootDirName, i);
+        entries[i].fileLength = 1 + random.Next() % maxLength;
+        totalMegabytes += entries[i].fileLength / (1024.0 * 1024.0);
+    }
+    nString npkFilename;
+    npkFilename.Format("%s/%s.npk", dir.Get(), RootDirName);
+    n_test(WriteNpk(npkFilename, entries, maxLength));
+    n_test(fileServer->ParseNpkFile(npkFilename));
+
+    // the old way, through one shared file handle
+    ReadPass pass;
+    pass.entries = &entries;
+    pass.sharedFile = fileServer->NewFileObject();
+    n_test(pass.sharedFile->Open(npkFilename, "rb"));
+
+    // random seeks from all threads
+    pass.mode = RandomSeeks;
+    RunPass(pass, maxThreads, maxLength);
+    n_test(0 == pass.numWrong);
+
+    // benchmark
+    printf("%d entries, %.1f MB\n", numFiles, totalMegabytes);
+    static const char* modeNames[] = { "shared", "read", "mapped" };
+    int numThreads = 1;
+    while (numThreads <= maxThreads)
+    {
+        double times[3];
+        int mode;
+        for (mode = SharedFile; mode <= NpkReadMapped; mode++)
+        {
+            pass.mode = (ReadMode) mode;
+            times[mode - SharedFile] = RunPass(pass, numThreads, maxLength);
+            if ((NpkReadMapped == mode) && (0 == pass.numMapped))
+            {
+                // the npk file couldn't be mapped, not an error
+                times[mode - SharedFile] = 0.0;
+                continue;
+            }
+            n_test(0 == pass.numWrong);
+        }
+        printf("threads %d:", numThreads);
+        for (mode = 0; mode < 3; mode++)
+        {
+            if (times[mode] > 0.0)
+            {
+                printf(" %s %.0f MB/s", modeNames[mode], totalMegabytes / times[mode]);
+            }
+            else
+            {
+                printf(" %s n/a", modeNames[mode]);
+            }
+        }
+        printf("\n");
+        numThreads = (numThreads == maxThreads) ? maxThreads + 1 : n_min(numThreads * 2, maxThreads);
+    }
+
+    pass.sharedFile->Close();
+    pass.sharedFile->Release();
+    fileServer->ReleaseNpkFiles("*");
+    fileServer->DeleteFile(npkFilename);
+    return nTest::Finish("nnpkreadtest");
+}
@@ -0,0 +1,427 @@
+//------------------------------------------------------------------------------
+//  nnpktoctest.cc
+//
+//  Tests and benchmarks npk toc lookups. A npk file with about -entries
+//  file entries is written to -dir and mounted, once with 20 directories
+//  of 50 subdirectories each and once with 20 flat directories. The
+//  mount time includes parsing the toc and building the toc index.
+//
+//  -lookups paths are resolved with nNpkToc::FindEntry(), which uses
+//  the toc index, and with a walk down the directory tree, like
+//  FindEntry() worked before the index. Some paths are missing, use
+//  upper case, backslashes, "." or "..". Both lookups must find the
+//  same entries. The tree walk only resolves every 10th path, because it
+//  gets slow with large directories. Directory listings through
+//  nNpkDirectory must return the contents of the directories.
+//
+//  Command line args:
+//  -entries    number of file entries (default: 200000)
+//  -lookups    number of resolved paths (default: 1000000)
+//  -dir        existing directory for the npk file (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/ndirectory.h"
+#include "file/nnpkfileserver.h"
+#include "file/nnpkfilewrapper.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const char* RootDirName = "nnpktoctest";
+static const int NumDirs = 20;
+static const int TreeWalkStep = 10;
+
+static nRandom Random(1234);
+
+//------------------------------------------------------------------------------
+/**
+    The directory layout of a test npk file, numSubDirs may be 0.
+*/
+struct Layout
+{
+    int numSubDirs;         // subdirectories per directory
+    int numFiles;           // files per directory or subdirectory
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+WriteDirBlock(nFile* file, const nString& name)
+{
+    file->PutInt('DIR_');
+    file->PutInt(sizeof(short) + name.Length());
+    file->PutShort(short(name.Length()));
+    file->Write(name.Get(), name.Length());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write the empty file entries of a directory, and the end of the
+    directory.
+*/
+static void
+WriteFileBlocks(nFile* file, int numFiles)
+{
+    int i;
+    for (i = 0; i < numFiles; i++)
+    {
+        nString name;
+        name.Format("file%d.nvx2", i);
+        file->PutInt('FILE');
+        file->PutInt(2 * sizeof(int) + sizeof(short) + name.Length());
+        file->PutInt(0);
+        file->PutInt(0);
+        file->PutShort(short(name.Length()));
+        file->Write(name.Get(), name.Length());
+    }
+    file->PutInt('DEND');
+    file->PutInt(0);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write a version 0 npk file with the layout, see nNpkFileServer for
+    the format. All files are empty.
+*/
+static bool
+WriteNpk(const nString& filename, const Layout& layout)
+{
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (!file->Open(filename, "wb"))
+    {
+        file->Release();
+        return false;
+    }
+    file->PutInt('NPK0');
+    file->PutInt(4);
+    file->PutInt(0);
+    WriteDirBlock(file, RootDirName);
+    int dirIndex;
+    for (dirIndex = 0; dirIndex < NumDirs; dirIndex++)
+    {
+        nString dirName;
+        dirName.Format("dir%d", dirIndex);
+        WriteDirBlock(file, dirName);
+        int subDirIndex;
+        for (subDirIndex = 0; subDirIndex < layout.numSubDirs; subDirIndex++)
+        {
+            nString subDirName;
+            subDirName.Format("sub%d", subDirIndex);
+            WriteDirBlock(file, subDirName);
+            WriteFileBlocks(file, layout.numFiles);
+        }
+        WriteFileBlocks(file, (0 == layout.numSubDirs) ? layout.numFiles : 0);
+    }
+    file->PutInt('DEND');
+    file->PutInt(0);
+
+    int dataOffset = file->Tell();
+    file->PutInt('DATA');
+    file->PutInt(0);
+    file->Seek(2 * sizeof(int), nFile::START);
+    file->PutInt(dataOffset);
+    file->Close();
+    file->Release();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Find an entry by walking down the directory tree component by
+    component, like nNpkToc::FindEntry() worked before the toc index.
+*/
+static nNpkTocEntry*
+FindEntryTreeWalk(nNpkToc& toc, const char* absPath)
+{
+    const char* rootPath = toc.GetRootPath();
+    int rootPathLen = strlen(rootPath);
+    if ((0 != strncmp(rootPath, absPath, rootPathLen)) || (int(strlen(absPath)) <= (rootPathLen + 1)))
+    {
+        return 0;
+    }
+    nString path(absPath + rootPathLen + 1);
+    path.ToLower();
+    char* component = strtok((char*) path.Get(), "/\\");
+    nNpkTocEntry* entry = toc.GetRootEntry();
+    if ((0 == component) || (0 != strcmp(entry->GetName(), component)))
+    {
+        return 0;
+    }
+    while (entry && (component = strtok(0, "/\\")))
+    {
+        if (0 == strcmp(component, "."))
+        {
+            // stay on current level
+        }
+        else if (0 == strcmp(component, ".."))
+        {
+            entry = entry->GetParent();
+        }
+        else if (nNpkTocEntry::DIR == entry->GetType())
+        {
+            entry = entry->FindEntry(component);
+        }
+        else
+        {
+            // a file has no children
+            entry = 0;
+        }
+    }
+    return entry;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create a random path of the layout below the npk root directory.
+    Some paths are missing or use upper case, backslashes, "." or "..".
+*/
+static nString
+RandomPath(const Layout& layout)
+{
+    nString dir;
+    if (layout.numSubDirs > 0)
+    {
+        dir.Format("%s/dir%d/sub%d", RootDirName, Random.Next() % NumDirs, Random.Next() % layout.numSubDirs);
+    }
+    else
+    {
+        dir.Format("%s/dir%d", RootDirName, Random.Next() % NumDirs);
+    }
+    int fileIndex = Random.Next() % layout.numFiles;
+    nString path;
+    switch (Random.Next() % 16)
+    {
+        case 0:
+            // missing file
+            path.Format("%s/file%d.nvx2", dir.Get(), layout.numFiles + fileIndex);
+            break;
+        case 1:
+            // missing directory in front of ".."
+            path.Format("%s/missing/../file%d.nvx2", dir.Get(), fileIndex);
+            break;
+        case 2:
+            path.Format("%s/./file%d.nvx2", dir.Get(), fileIndex);
+            break;
+        case 3:
+            path.Format("%s/file%d.nvx2/../file%d.nvx2", dir.Get(), fileIndex, fileIndex);
+            break;
+        case 4:
+            path.Format("%s/FILE%d.NVX2", dir.Get(), fileIndex);
+            break;
+        case 5:
+            path.Format("%s\\file%d.nvx2", dir.Get(), fileIndex);
+            break;
+        case 6:
+            // a directory
+            path = dir;
+            break;
+        default:
+            path.Format("%s/file%d.nvx2", dir.Get(), fileIndex);
+            break;
+    }
+    return path;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Special paths against a small toc, the index and the tree walk must
+    agree, and the results must be the expected ones.
+*/
+static void
+TestSpecialPaths()
+{
+    nNpkToc toc;
+    toc.SetRootPath("/base");
+    toc.BeginDirEntry("root");
+    toc.AddFileEntry("a.txt", 0, 1);
+    toc.BeginDirEntry("sub");
+    toc.AddFileEntry("b.txt", 1, 1);
+    toc.EndDirEntry();
+    toc.EndDirEntry();
+    toc.BuildIndex();
+
+    struct
+    {
+        const char* path;
+        const char* name;   // name of the entry which must be found, or 0
+    }
+    paths[] =
+    {
+        { "/base/root/a.txt", "a.txt" },
+        { "/base/root/sub/b.txt", "b.txt" },
+        { "/base/root/./sub/B.TXT", "b.txt" },
+        { "/base/root\\sub\\b.txt", "b.txt" },
+        { "/base/root/sub/../a.txt", "a.txt" },
+        { "/base/root/a.txt/../sub", "sub" },
+        { "/base/root/sub/b.txt/..", "sub" },
+        { "/base/root//a.txt", "a.txt" },
+        { "/base/root", "root" },
+        { "/base/root/missing/../a.txt", 0 },
+        { "/base/./root/a.txt", 0 },
+        { "/base/root/..", 0 },
+        { "/base/../root", 0 },
+        { "/base/root/a.txt/b.txt", 0 },
+        { "/base", 0 },
+        { "/other/root/a.txt", 0 },
+    };
+    int numWrong = 0;
+    int i;
+    for (i = 0; i < int(sizeof(paths) / sizeof(paths[0])); i++)
+    {
+        nNpkTocEntry* entry = toc.FindEntry(paths[i].path);
+        bool found = (0 != entry) && (0 != paths[i].name) && (0 == strcmp(entry->GetName(), paths[i].name));
+        if ((entry != FindEntryTreeWalk(toc, paths[i].path)) || (found != (0 != paths[i].name)))
+        {
+            n_printf("wrong result for '%s'\n", paths[i].path);
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Count the entries of a directory listing through the file server.
+*/
+static int
+CountDirEntries(const nString& dirName, nDirectory::EntryType type)
+{
+    nDirectory* dir = nFileServer2::Instance()->NewDirectoryObject();
+    int num = -1;
+    if (dir->Open(dirName))
+    {
+        num = 0;
+        if (!dir->IsEmpty()) do
+        {
+            if (type == dir->GetEntryType())
+            {
+                num++;
+            }
+        }
+        while (dir->SetToNextEntry());
+        dir->Close();
+    }
+    n_delete(dir);
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Mount a npk file with the layout and resolve numLookups random paths.
+*/
+static void
+TestLayout(const nString& dir, const Layout& layout, int numLookups)
+{
+    nNpkFileServer* fileServer = (nNpkFileServer*) nFileServer2::Instance();
+    nString npkFilename;
+    npkFilename.Format("%s/%s.npk", dir.Get(), RootDirName);
+    n_test(WriteNpk(npkFilename, layout));
+    nString rootPath = fileServer->ManglePath(npkFilename.ExtractDirName());
+
+    // mount, this parses the toc and builds the index
+    nNpkFileWrapper wrapper;
+    nTest::Timer timer;
+    n_test(wrapper.Open(fileServer, rootPath.Get(), fileServer->ManglePath(npkFilename).Get()));
+    double mountTime = timer.GetTime();
+    nNpkToc& toc = wrapper.GetTocObject();
+
+    nArray<nString> paths;
+    paths.SetFixedSize(numLookups);
+    int i;
+    for (i = 0; i < numLookups; i++)
+    {
+        paths[i].Format("%s/%s", rootPath.Get(), RandomPath(layout).Get());
+    }
+
+    // the index and the tree walk must agree
+    int numFound = 0;
+    int numWrong = 0;
+    for (i = 0; i < numLookups; i += TreeWalkStep)
+    {
+        nNpkTocEntry* entry = toc.FindEntry(paths[i].Get());
+        if (entry)
+        {
+            numFound++;
+        }
+        if (entry != FindEntryTreeWalk(toc, paths[i].Get()))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+    n_test(numFound > 0);
+
+    timer.Start();
+    for (i = 0; i < numLookups; i++)
+    {
+        toc.FindEntry(paths[i].Get());
+    }
+    double indexTime = timer.GetTime();
+    int numTreeWalks = 0;
+    timer.Start();
+    for (i = 0; i < numLookups; i += TreeWalkStep)
+    {
+        FindEntryTreeWalk(toc, paths[i].Get());
+        numTreeWalks++;
+    }
+    double treeWalkTime = timer.GetTime() * (double(numLookups) / double(numTreeWalks));
+    printf("%d dirs x %d subdirs x %d files: mount %.1f ms, %d lookups: index %.0f ms, tree walk %.0f ms, speedup %.1f\n",
+           NumDirs, layout.numSubDirs, layout.numFiles, mountTime * 1000.0, numLookups,
+           indexTime * 1000.0, treeWalkTime * 1000.0, (indexTime > 0.0) ? treeWalkTime / indexTime : 0.0);
+    wrapper.Close();
+
+    // directory listings and file lookups through the file server
+    n_test(fileServer->ParseNpkFile(npkFilename));
+    nString dirName;
+    dirName.Format("%s/%s/dir%d", dir.Get(), RootDirName, NumDirs - 1);
+    if (layout.numSubDirs > 0)
+    {
+        n_test(layout.numSubDirs == CountDirEntries(dirName, nDirectory::DIRECTORY));
+        n_test(0 == CountDirEntries(dirName, nDirectory::FILE));
+        dirName.Format("%s/%s/dir%d/sub%d", dir.Get(), RootDirName, NumDirs - 1, layout.numSubDirs - 1);
+    }
+    n_test(layout.numFiles == CountDirEntries(dirName, nDirectory::FILE));
+    n_test(0 == CountDirEntries(dirName, nDirectory::DIRECTORY));
+    nString filename;
+    filename.Format("%s/file%d.nvx2", dirName.Get(), layout.numFiles - 1);
+    n_test(fileServer->FileExists(filename));
+    filename.Format("%s/file%d.nvx2", dirName.Get(), layout.numFiles);
+    n_test(!fileServer->FileExists(filename));
+    fileServer->ReleaseNpkFiles(fileServer->ManglePath(npkFilename));
+    fileServer->DeleteFile(npkFilename);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numEntries = n_max(1000, args.GetIntArg("-entries", 200000));
+    int numLookups = n_max(TreeWalkStep, args.GetIntArg("-lookups", 1000000));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.ReplaceFileServer("nnpkfileserver");
+
+    TestSpecialPaths();
+
+    Layout nested;
+    nested.numSubDirs = 50;
+    nested.numFiles = numEntries / (NumDirs * nested.numSubDirs);
+    TestLayout(dir, nested, numLookups);
+    Layout flat;
+    flat.numSubDirs = 0;
+    flat.numFiles = numEntries / NumDirs;
+    TestLayout(dir, flat, numLookups);
+    return nTest::Finish("nnpktoctest");
+}
@@ -0,0 +1,652 @@
+//------------------------------------------------------------------------------
+//  nparticle2test.cc
+//
+//  Tests and benchmarks the particle update kernels of nParticle2Emitter.
+//  Two emitters get the same random particles and anim curves, one is
+//  updated with the SSE kernel, the other with the scalar kernel, and
+//  after every step the particle streams and bounding boxes must be bit
+//  identical. Particle counts which are not a multiple of 4 check the
+//  masking of the unused lanes, the lifetimes are chosen so that particles
+//  die during the test. Then both kernels are timed with -particles
+//  particles.
+//
+//  The parallel update of nParticleServer2 is checked by stepping a fixed
+//  set of emitters serially and on the worker pool with 0, 1 and -workers
+//  worker threads, the particle streams and bounding boxes must be bit
+//  identical to the serial update. Then nParticleServer2::Trigger() is
+//  timed with -emitters emitters for every worker count.
+//
+//  Command line args:
+//  -particles  number of particles of the benchmark (default: 100000)
+//  -steps      number of update steps (default: 200)
+//  -emitters   number of emitters of the server benchmark (default: 256)
+//  -workers    maximum number of worker threads (default: processors - 1)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/ntimeserver.h"
+#include "kernel/nworkerpool.h"
+#include "gfx2/ngfxserver2.h"
+#include "gfx2/nmesh2.h"
+#include "particle/nparticleserver2.h"
+#include "particle/nparticle2emitter.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static float Curves[nParticle2Emitter::ParticleTimeDetail * nParticle2Emitter::CurveTypeCount];
+static const float FrameTime = 0.05f;
+static const int NumTestEmitters = 32;
+static const int NumTestFrames = 100;
+static const int SnapshotInterval = 10;
+
+//------------------------------------------------------------------------------
+/**
+    Gives the test access to the particle pool and the update kernels.
+*/
+class nParticle2TestEmitter : public nParticle2Emitter
+{
+public:
+    /// fill the pool with num random particles
+    void Setup(int num, uint seed);
+    /// update the particles with the SSE or the scalar kernel
+    void Step(bool useSimd, float stepTime);
+    /// get number of live particles
+    int GetParticleCount() const;
+    /// get a particle stream
+    const float* GetStream(nParticle2Pool::Stream stream) const;
+    /// get the bounding box
+    const bbox3& GetBox() const;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2TestEmitter::Setup(int num, uint seed)
+{
+    this->SetStaticCurvePtr(Curves);
+    nFloat4 wind = { 1.0f, 0.0f, 0.5f, 2.0f };
+    this->SetWind(wind);
+    this->SetGravity(-9.81f);
+    this->particles.Allocate(num);
+    this->maxParticleCount = num;
+
+    nRandom random(seed);
+    nParticle2 particle = nParticle2();
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        float maxLifeTime = random.Rand(0.5f, 3.0f);
+        particle.position.set(random.Rand(-10.0f, 10.0f), random.Rand(0.0f, 5.0f), random.Rand(-10.0f, 10.0f));
+        particle.startPos = particle.position;
+        particle.velocity.set(random.Rand(-1.0f, 1.0f), random.Rand(0.0f, 4.0f), random.Rand(-1.0f, 1.0f));
+        particle.rotation = random.Rand(0.0f, N_PI);
+        particle.rotationVariation = random.Rand(-1.0f, 1.0f);
+        particle.sizeVariation = random.Rand(0.5f, 1.5f);
+        particle.lifeTime = random.Rand(-0.2f, 1.0f) * maxLifeTime;
+        particle.oneDivMaxLifeTime = 1.0f / maxLifeTime;
+        this->particles.Set(i, particle);
+    }
+    this->particleCount = num;
+    this->SampleParticleCurves(0, num);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2TestEmitter::Step(bool useSimd, float stepTime)
+{
+    if (0 == this->particleCount)
+    {
+        return;
+    }
+#ifdef __NEBULA_PARTICLE_SSE__
+    if (useSimd)
+    {
+        this->CalculateStepSSE(stepTime);
+        return;
+    }
+#endif
+    this->CalculateStepScalar(stepTime);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+nParticle2TestEmitter::GetParticleCount() const
+{
+    return this->particleCount;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const float*
+nParticle2TestEmitter::GetStream(nParticle2Pool::Stream stream) const
+{
+    return this->particles.GetStream(stream);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+const bbox3&
+nParticle2TestEmitter::GetBox() const
+{
+    return this->box;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Anim curves which change over the particle age, so that neighbouring
+    particles read different curve samples.
+*/
+static void
+SetupCurves()
+{
+    const int numSamples = nParticle2Emitter::ParticleTimeDetail;
+    int i;
+    for (i = 0; i < numSamples; i++)
+    {
+        float t = float(i) / float(numSamples - 1);
+        float* c = &Curves[i * nParticle2Emitter::CurveTypeCount];
+        int curve;
+        for (curve = 0; curve < nParticle2Emitter::CurveTypeCount; curve++)
+        {
+            c[curve] = 0.0f;
+        }
+        c[nParticle2Emitter::EmissionFrequency] = 100.0f;
+        c[nParticle2Emitter::ParticleLifeTime] = 3.0f;
+        c[nParticle2Emitter::ParticleRotationVelocity] = 2.0f - t;
+        c[nParticle2Emitter::ParticleScale] = 0.2f + t;
+        c[nParticle2Emitter::ParticleAlpha] = 1.0f - t;
+        c[nParticle2Emitter::ParticleAirResistance] = 0.5f + 0.5f * t;
+        c[nParticle2Emitter::StaticRGBCurve] = t * 255.0f;
+        c[nParticle2Emitter::ParticleVelocityFactor] = 1.0f - 0.5f * t;
+        c[nParticle2Emitter::ParticleMass] = 1.0f + t;
+        c[nParticle2Emitter::TimeManipulator] = 1.0f;
+        c[nParticle2Emitter::ParticleStartVelocity] = 2.0f + t;
+        c[nParticle2Emitter::ParticleSpreadMin] = 10.0f;
+        c[nParticle2Emitter::ParticleSpreadMax] = 30.0f + 30.0f * t;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The live particles of both emitters must be bit identical.
+*/
+static bool
+IsIdentical(const nParticle2TestEmitter& e0, const nParticle2TestEmitter& e1)
+{
+    if (e0.GetParticleCount() != e1.GetParticleCount())
+    {
+        return false;
+    }
+    int num = e0.GetParticleCount();
+    int stream;
+    for (stream = 0; stream < nParticle2Pool::NumStreams; stream++)
+    {
+        nParticle2Pool::Stream s = (nParticle2Pool::Stream) stream;
+        if (0 != memcmp(e0.GetStream(s), e1.GetStream(s), num * sizeof(float)))
+        {
+            return false;
+        }
+    }
+    if (num > 0)
+    {
+        const bbox3& b0 = e0.GetBox();
+        const bbox3& b1 = e1.GetBox();
+        if ((0 != memcmp(&b0.vmin, &b1.vmin, sizeof(vector3))) || (0 != memcmp(&b0.vmax, &b1.vmax, sizeof(vector3))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Update num particles with both kernels until all are dead.
+*/
+static void
+TestKernels(int num)
+{
+    nParticle2TestEmitter simdEmitter;
+    nParticle2TestEmitter scalarEmitter;
+    simdEmitter.Setup(num, 1234 + num);
+    scalarEmitter.Setup(num, 1234 + num);
+
+    int numWrongSteps = 0;
+    int step;
+    for (step = 0; (step < 1000) && (scalarEmitter.GetParticleCount() > 0); step++)
+    {
+        // vary the step time a bit, like a real frame rate
+        float stepTime = (step & 1) ? (1.0f / 60.0f) : (1.0f / 45.0f);
+        simdEmitter.Step(true, stepTime);
+        scalarEmitter.Step(false, stepTime);
+        if (!IsIdentical(simdEmitter, scalarEmitter))
+        {
+            numWrongSteps++;
+        }
+    }
+    n_test(0 == numWrongSteps);
+    n_test(0 == scalarEmitter.GetParticleCount());
+    n_test(0 == simdEmitter.GetParticleCount());
+}
+
+//------------------------------------------------------------------------------
+/**
+    Returns the number of updated particles per second.
+*/
+static double
+RunBenchmark(bool useSimd, int num, int numSteps)
+{
+    nParticle2TestEmitter emitter;
+    nTest::Timer timer;
+    double time = 0.0;
+    double numUpdated = 0.0;
+    int step;
+    for (step = 0; step < numSteps; step++)
+    {
+        // refill the pool when most of the particles have died
+        if (emitter.GetParticleCount() < num / 2)
+        {
+            emitter.Setup(num, step);
+        }
+        numUpdated += emitter.GetParticleCount();
+        timer.Start();
+        emitter.Step(useSimd, 1.0f / 60.0f);
+        time += timer.GetTime();
+    }
+    return (time > 0.0) ? numUpdated / time : 0.0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    An emitter mesh in system memory, a bumpy grid with position and
+    normal, the left and the right half of the grid are one group each.
+*/
+class nParticle2TestMesh : public nMesh2
+{
+public:
+    /// destructor
+    virtual ~nParticle2TestMesh();
+    /// lock vertices
+    virtual float* LockVertices();
+    /// unlock vertices
+    virtual void UnlockVertices();
+    /// lock indices
+    virtual ushort* LockIndices();
+    /// unlock indices
+    virtual void UnlockIndices();
+
+protected:
+    /// build the grid
+    virtual bool LoadResource();
+    /// release the grid
+    virtual void UnloadResource();
+
+private:
+    enum
+    {
+        GridSize = 9,
+    };
+    nArray<float> vertices;
+    nArray<ushort> indices;
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+nParticle2TestMesh::~nParticle2TestMesh()
+{
+    if (this->IsLoaded())
+    {
+        this->Unload();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+float*
+nParticle2TestMesh::LockVertices()
+{
+    return &this->vertices[0];
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2TestMesh::UnlockVertices()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+ushort*
+nParticle2TestMesh::LockIndices()
+{
+    return &this->indices[0];
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2TestMesh::UnlockIndices()
+{
+    // empty
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+bool
+nParticle2TestMesh::LoadResource()
+{
+    this->SetVertexComponents(Coord | Normal);
+    this->SetNumVertices(GridSize * GridSize);
+    int x, z;
+    for (z = 0; z < GridSize; z++)
+    {
+        for (x = 0; x < GridSize; x++)
+        {
+            float fx = float(x - GridSize / 2);
+            float fz = float(z - GridSize / 2);
+            vector3 normal(-0.25f * n_cos(fx), 1.0f, -0.25f * n_cos(fz));
+            normal.norm();
+            this->vertices.Append(fx);
+            this->vertices.Append(0.25f * (n_sin(fx) + n_sin(fz)));
+            this->vertices.Append(fz);
+            this->vertices.Append(normal.x);
+            this->vertices.Append(normal.y);
+            this->vertices.Append(normal.z);
+        }
+    }
+
+    // two triangles per quad
+    const int numQuads = GridSize - 1;
+    this->SetNumGroups(2);
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < 2; groupIndex++)
+    {
+        int firstIndex = this->indices.Size();
+        for (z = 0; z < numQuads; z++)
+        {
+            for (x = groupIndex * numQuads / 2; x < (groupIndex + 1) * numQuads / 2; x++)
+            {
+                ushort i0 = ushort(z * GridSize + x);
+                ushort i1 = ushort(i0 + 1);
+                ushort i2 = ushort(i0 + GridSize);
+                ushort i3 = ushort(i2 + 1);
+                this->indices.Append(i0);
+                this->indices.Append(i2);
+                this->indices.Append(i1);
+                this->indices.Append(i1);
+                this->indices.Append(i2);
+                this->indices.Append(i3);
+            }
+        }
+        nMeshGroup& group = this->Group(groupIndex);
+        group.SetFirstVertex(0);
+        group.SetNumVertices(this->GetNumVertices());
+        group.SetFirstIndex(firstIndex);
+        group.SetNumIndices(this->indices.Size() - firstIndex);
+    }
+    this->SetNumIndices(this->indices.Size());
+    this->SetState(Valid);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nParticle2TestMesh::UnloadResource()
+{
+    nMesh2::UnloadResource();
+    this->vertices.Clear();
+    this->indices.Clear();
+}
+
+//------------------------------------------------------------------------------
+/**
+    The particles of all emitters at some frames of a run.
+*/
+struct nParticle2TestRecording
+{
+    /// constructor
+    nParticle2TestRecording() : values(0, 1 << 16), numSleeping(0) {}
+
+    nArray<int> counts;
+    nArray<float> values;
+    int numSleeping;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Create num emitters with a mix of settings, so that all paths of
+    nParticle2Emitter::Update() are taken: emission from vertices and from
+    the surface, precalculation, start delays, one emitter in 8 is out of
+    the activity distance and every third emitter loops, falls asleep and
+    is updated on the calling thread from then on.
+*/
+static void
+CreateEmitters(nArray<nParticle2Emitter*>& emitters, int num, nMesh2* mesh)
+{
+    nParticleServer2* particleServer = nParticleServer2::Instance();
+    nFloat4 wind = { 1.0f, 0.0f, 0.5f, 2.0f };
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        nParticle2Emitter* emitter = particleServer->NewParticleEmitter();
+        emitter->SetRandomSeed(i + 1);
+        emitter->SetStaticCurvePtr(Curves);
+        emitter->SetEmitterMesh(mesh);
+        emitter->SetEmitterMeshGroupIndex(i & 1);
+
+        matrix44 transform;
+        transform.rotate_y(0.3f * float(i));
+        transform.translate(vector3(4.0f * float(i % 16), 0.0f, 4.0f * float(i / 16)));
+        if (7 == (i % 8))
+        {
+            transform.translate(vector3(500.0f, 0.0f, 0.0f));
+        }
+        emitter->SetTransform(transform);
+        emitter->SetLooping(0 == (i % 3));
+        emitter->SetEmissionDuration((0 == (i % 3)) ? 1.0f : 10.0f);
+        emitter->SetPrecalcTime((1 == (i % 4)) ? 1.0f : 0.0f);
+        emitter->SetStartDelay(0.1f * float(i % 5));
+        emitter->SetEmitOnSurface(0 != (i & 2));
+        emitter->SetTileTexture(1 + (i % 4));
+        emitter->SetStartRotationMin(0.0f);
+        emitter->SetStartRotationMax(N_PI);
+        emitter->SetRandomRotDir(0 == (i % 2));
+        emitter->SetParticleVelocityRandomize(0.5f);
+        emitter->SetParticleRotationRandomize(0.5f);
+        emitter->SetParticleSizeRandomize(0.3f);
+        emitter->SetGravity(-9.81f);
+        emitter->SetWind(wind);
+        emitter->SetIsSetup(true);
+        emitters.Append(emitter);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Append the live particles and the bounding boxes of all emitters.
+*/
+static void
+Record(const nArray<nParticle2Emitter*>& emitters, nParticle2TestRecording& recording)
+{
+    int i;
+    for (i = 0; i < emitters.Size(); i++)
+    {
+        const nParticle2Emitter* emitter = emitters[i];
+        int num = emitter->GetParticleCount();
+        recording.counts.Append(num);
+        int stream;
+        for (stream = 0; stream < nParticle2Pool::NumStreams; stream++)
+        {
+            const float* values = emitter->GetParticlePool().GetStream((nParticle2Pool::Stream) stream);
+            int particleIndex;
+            for (particleIndex = 0; particleIndex < num; particleIndex++)
+            {
+                recording.values.Append(values[particleIndex]);
+            }
+        }
+        if (num > 0)
+        {
+            const bbox3& box = emitter->GetBoundingBox();
+            recording.values.Append(box.vmin.x);
+            recording.values.Append(box.vmin.y);
+            recording.values.Append(box.vmin.z);
+            recording.values.Append(box.vmax.x);
+            recording.values.Append(box.vmax.y);
+            recording.values.Append(box.vmax.z);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create numEmitters emitters and update them for numFrames frames with
+    a fixed frame time. If recording is not 0, the particles are recorded
+    every SnapshotInterval frames. Returns the time spent in
+    nParticleServer2::Trigger().
+*/
+static double
+RunEmitters(int numEmitters, int numFrames, nMesh2* mesh, nParticle2TestRecording* recording)
+{
+    nParticleServer2* particleServer = nParticleServer2::Instance();
+    nTimeServer* timeServer = nTimeServer::Instance();
+    nArray<nParticle2Emitter*> emitters;
+    CreateEmitters(emitters, numEmitters, mesh);
+
+    nTest::Timer timer;
+    double time = 0.0;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        timeServer->SetTime(frame * FrameTime);
+        timer.Start();
+        particleServer->Trigger();
+        time += timer.GetTime();
+        if (recording && (0 == ((frame + 1) % SnapshotInterval)))
+        {
+            Record(emitters, *recording);
+        }
+    }
+
+    int i;
+    for (i = 0; i < emitters.Size(); i++)
+    {
+        if (recording && emitters[i]->IsSleeping())
+        {
+            recording->numSleeping++;
+        }
+        particleServer->DeleteParticleEmitter(emitters[i]);
+    }
+    return time;
+}
+
+//------------------------------------------------------------------------------
+/**
+    The update on the worker pool with 0, 1 and maxWorkers worker threads
+    must give the same particles as the serial update.
+*/
+static void
+TestParallelUpdate(nMesh2* mesh, int maxWorkers)
+{
+    nParticleServer2* particleServer = nParticleServer2::Instance();
+    nParticle2TestRecording serial;
+    particleServer->SetParallelUpdate(false);
+    RunEmitters(NumTestEmitters, NumTestFrames, mesh, &serial);
+    n_test(serial.values.Size() > 0);
+    n_test(serial.numSleeping > 0);
+
+    particleServer->SetParallelUpdate(true);
+    const int workerCounts[] = { 0, 1, maxWorkers };
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        nWorkerPool::Instance()->SetNumWorkers(workerCounts[i]);
+        nParticle2TestRecording parallel;
+        RunEmitters(NumTestEmitters, NumTestFrames, mesh, &parallel);
+        n_test(serial.counts == parallel.counts);
+        n_test(serial.numSleeping == parallel.numSleeping);
+        n_test((serial.values.Size() == parallel.values.Size()) &&
+               (0 == memcmp(&serial.values[0], &parallel.values[0], serial.values.Size() * sizeof(float))));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numParticles = n_max(1, args.GetIntArg("-particles", 100000));
+    int numSteps = n_max(1, args.GetIntArg("-steps", 200));
+    int numEmitters = n_max(1, args.GetIntArg("-emitters", 256));
+    int maxWorkers = args.GetIntArg("-workers", nWorkerPool::GetNumProcessors() - 1);
+    maxWorkers = n_max(0, n_min(maxWorkers, int(nJobServer::MaxWorkers)));
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.New("ngfxserver2", "/sys/servers/gfx");
+    kernelServer.New("nparticleserver2", "/sys/servers/particle2");
+    nTimeServer::Instance()->LockDeltaT(FrameTime);
+    nParticle2TestMesh* mesh = n_new(nParticle2TestMesh);
+    mesh->Load();
+
+    SetupCurves();
+
+    // particle counts with 0 to 3 unused lanes in the last group
+    static const int counts[] = { 1, 2, 3, 4, 5, 7, 64, 333, 1000, 4099 };
+    int i;
+    for (i = 0; i < int(sizeof(counts) / sizeof(counts[0])); i++)
+    {
+        TestKernels(counts[i]);
+    }
+
+    #ifndef __NEBULA_PARTICLE_SSE__
+    printf("SSE kernel not available, only the scalar kernel is measured\n");
+    #endif
+    double simdRate = RunBenchmark(true, numParticles, numSteps);
+    double scalarRate = RunBenchmark(false, numParticles, numSteps);
+    printf("%d particles: sse %.2f M/s, scalar %.2f M/s, speedup %.2f\n",
+           numParticles, simdRate / 1000000.0, scalarRate / 1000000.0,
+           (scalarRate > 0.0) ? simdRate / scalarRate : 0.0);
+
+    TestParallelUpdate(mesh, maxWorkers);
+
+    nParticleServer2::Instance()->SetParallelUpdate(false);
+    double serialTime = RunEmitters(numEmitters, numSteps, mesh, 0) * 1000.0 / numSteps;
+    printf("%d emitters: serial %.3f ms per frame\n", numEmitters, serialTime);
+    nParticleServer2::Instance()->SetParallelUpdate(true);
+    int numWorkers;
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        nWorkerPool::Instance()->SetNumWorkers(numWorkers);
+        double parallelTime = RunEmitters(numEmitters, numSteps, mesh, 0) * 1000.0 / numSteps;
+        printf("workers %d: %.3f ms per frame, speedup %.2f\n",
+               numWorkers, parallelTime, (parallelTime > 0.0) ? serialTime / parallelTime : 0.0);
+    }
+
+    n_delete(mesh);
+    nParticleServer2::Instance()->Release();
+    nGfxServer2::Instance()->Release();
+    return nTest::Finish("nparticle2test");
+}
@@ -0,0 +1,477 @@
+//------------------------------------------------------------------------------
+//  nprofileservertest.cc
+//
+//  Stress test and benchmark for nProfileServer. Nested zones must get the
+//  right parents, counts, inclusive and exclusive times, and the watcher
+//  variables under /sys/var/ must show the zone times. -threads threads
+//  record nested zones while the main thread finishes frames, no zone may
+//  be lost. 200 short-lived threads one after another must reuse the
+//  thread buffers, and a trace capture of 3 frames is written to -dir and
+//  checked.
+//
+//  The benchmark measures the cost of a zone (BeginZone() and EndZone())
+//  on one thread and on all threads at once, and of the old nProfiler
+//  Start()/Stop() pair, which read the time server and wrote a nEnv.
+//
+//  Command line args:
+//  -threads    number of recording threads (default: 4)
+//  -zones      number of zones per thread and frame (default: 1000)
+//  -frames     number of frames of the thread test (default: 50)
+//  -dir        existing directory for the trace file (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nprofileserver.h"
+#include "kernel/ntimeserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/nenv.h"
+#include "kernel/nthread.h"
+#include "kernel/ninterlocked.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static const int NumCostZones = 100000;
+
+//------------------------------------------------------------------------------
+/**
+    The shared state of the recording threads.
+*/
+struct RecordJob
+{
+    int numZones;               // zones per frame
+    int numFrames;
+    volatile long frame;        // the frame which may be recorded
+    volatile long numDone;      // frames finished by all threads
+    volatile long startFlag;
+    double zoneTime;            // time of the cost benchmark
+};
+
+//------------------------------------------------------------------------------
+/**
+    Busy wait for a number of microseconds.
+*/
+static void
+Spin(double us)
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    uint64 startTicks = nProfileServer::GetTicks();
+    uint64 numTicks = uint64(us * profileServer->GetTicksPerSecond() * 1.0e-6);
+    while ((nProfileServer::GetTicks() - startTicks) < numTicks)
+    {
+        // spin
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Nested zones on the main thread: a frame zone with 3 calls of zone a,
+    which contains zone b.
+*/
+static void
+TestNesting()
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int frameZone = profileServer->RegisterZone("testFrame");
+    int zoneA = profileServer->RegisterZone("testA");
+    int zoneB = profileServer->RegisterZone("testB");
+    n_test(zoneA == profileServer->RegisterZone("testA"));
+    n_test(0 == strcmp("testB", profileServer->GetZoneName(zoneB)));
+
+    int frame;
+    for (frame = 0; frame < 5; frame++)
+    {
+        profileServer->BeginZone(frameZone);
+        int i;
+        for (i = 0; i < 3; i++)
+        {
+            profileServer->BeginZone(zoneA);
+            Spin(200.0);
+            profileServer->BeginZone(zoneB);
+            Spin(300.0);
+            profileServer->EndZone(zoneB);
+            profileServer->EndZone(zoneA);
+        }
+        profileServer->EndZone(frameZone);
+        profileServer->NextFrame();
+    }
+
+    n_test(-1 == profileServer->GetZoneParent(frameZone));
+    n_test(frameZone == profileServer->GetZoneParent(zoneA));
+    n_test(zoneA == profileServer->GetZoneParent(zoneB));
+    n_test(1 == profileServer->GetZoneCount(frameZone));
+    n_test(3 == profileServer->GetZoneCount(zoneA));
+    n_test(3 == profileServer->GetZoneCount(zoneB));
+
+    // a spends 3 * 0.2 ms itself, and contains 3 * 0.3 ms of b
+    float timeA = profileServer->GetZoneTime(zoneA);
+    float selfTimeA = profileServer->GetZoneSelfTime(zoneA);
+    float timeB = profileServer->GetZoneTime(zoneB);
+    n_test((timeA >= 1.5f) && (selfTimeA >= 0.6f) && (timeB >= 0.9f));
+    n_test(n_abs(timeA - (selfTimeA + timeB)) < 0.01f);
+    n_test(profileServer->GetZoneTime(frameZone) >= timeA);
+    n_test(profileServer->GetZoneHistory(zoneA, 0) == timeA);
+    n_test(profileServer->GetZoneHistory(zoneA, 4) > 0.0f);
+
+    // the watcher variable
+    nEnv* env = (nEnv*) nKernelServer::Instance()->Lookup("/sys/var/testA");
+    n_test(env && (env->GetF() == timeA));
+
+    // an empty frame
+    profileServer->NextFrame();
+    n_test(0 == profileServer->GetZoneCount(zoneA));
+    n_test(0.0f == profileServer->GetZoneTime(zoneA));
+    printf("nesting: a %.3f ms (self %.3f ms), b %.3f ms\n", timeA, selfTimeA, timeB);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Record numZones nested zone pairs per frame, each frame as soon as the
+    main thread allows it.
+*/
+static int
+N_THREADPROC
+RecordThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    RecordJob* job = (RecordJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    nProfileServer* profileServer = nProfileServer::Instance();
+    profileServer->SetThreadName("Recorder");
+    int jobZone = profileServer->RegisterZone("recordJob");
+    int innerZone = profileServer->RegisterZone("recordInner");
+
+    int frame;
+    for (frame = 0; frame < job->numFrames; frame++)
+    {
+        while (n_interlocked_read(&job->frame) < frame)
+        {
+            n_sleep(0.0);
+        }
+        int i;
+        for (i = 0; i < job->numZones; i++)
+        {
+            profileServer->BeginZone(jobZone);
+            profileServer->BeginZone(innerZone);
+            profileServer->EndZone(innerZone);
+            profileServer->EndZone(jobZone);
+        }
+        n_interlocked_increment(&job->numDone);
+    }
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    The main thread finishes frames as fast as it can while the threads
+    record. The zone counts of all frames must add up.
+*/
+static void
+TestThreads(int numThreads, int numZones, int numFrames)
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int jobZone = profileServer->RegisterZone("recordJob");
+    int innerZone = profileServer->RegisterZone("recordInner");
+    int numDroppedBefore = profileServer->GetNumDroppedEvents();
+
+    RecordJob job;
+    job.numZones = numZones;
+    job.numFrames = numFrames;
+    job.frame = 0;
+    job.numDone = 0;
+    nArray<nThread*> threads;
+    threads.SetFixedSize(numThreads);
+    int i;
+    for (i = 0; i < numThreads; i++)
+    {
+        threads[i] = n_new(nThread(RecordThreadFunc, nThread::Normal, 0, 0, 0, &job));
+    }
+
+    // the threads record a frame when all threads have finished the
+    // previous one, so the buffers can't overflow
+    int numJobZones = 0;
+    int numInnerZones = 0;
+    int numFinished = 0;
+    int frame = 0;
+    while (frame < numFrames)
+    {
+        profileServer->NextFrame();
+        numFinished++;
+        numJobZones += profileServer->GetZoneCount(jobZone);
+        numInnerZones += profileServer->GetZoneCount(innerZone);
+        if (n_interlocked_read(&job.numDone) == ((frame + 1) * numThreads))
+        {
+            n_interlocked_exchange(&job.frame, ++frame);
+        }
+    }
+    for (i = 0; i < numThreads; i++)
+    {
+        n_delete(threads[i]);
+    }
+    profileServer->NextFrame();
+    numJobZones += profileServer->GetZoneCount(jobZone);
+    numInnerZones += profileServer->GetZoneCount(innerZone);
+
+    n_test(numDroppedBefore == profileServer->GetNumDroppedEvents());
+    n_test(numThreads * numZones * numFrames == numJobZones);
+    n_test(numJobZones == numInnerZones);
+    n_test(jobZone == profileServer->GetZoneParent(innerZone));
+    n_test(-1 == profileServer->GetZoneParent(jobZone));
+    printf("%d threads: %d zones in %d frames\n", numThreads, numJobZones, numFinished);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Record a complete zone, and leave another one open.
+*/
+static int
+N_THREADPROC
+ShortThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int zone = profileServer->RegisterZone("shortLived");
+    profileServer->BeginZone(zone);
+    profileServer->EndZone(zone);
+    profileServer->BeginZone(zone);
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    200 threads one after another, more than the profile server has
+    thread slots. Every thread's complete zone must be counted.
+*/
+static void
+TestShortThreads()
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int zone = profileServer->RegisterZone("shortLived");
+    int numWrong = 0;
+    int i;
+    for (i = 0; i < 200; i++)
+    {
+        nThread* thread = n_new(nThread(ShortThreadFunc, nThread::Normal, 0, 0, 0, 0));
+        n_delete(thread);
+        if (9 == (i % 10))
+        {
+            profileServer->NextFrame();
+            if (10 != profileServer->GetZoneCount(zone))
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Count the occurrences of a string in a text.
+*/
+static int
+CountString(const char* text, const char* str)
+{
+    int num = 0;
+    const char* ptr = text;
+    while (0 != (ptr = strstr(ptr, str)))
+    {
+        num++;
+        ptr += strlen(str);
+    }
+    return num;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Capture 3 frames with zones of the main thread and of a recording
+    thread. Every zone of the capture must have a begin and an end event.
+*/
+static void
+TestCapture(const nString& filename)
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int frameZone = profileServer->RegisterZone("testFrame");
+    int zoneA = profileServer->RegisterZone("testA");
+    n_test(profileServer->BeginCapture(filename.Get(), 3));
+    n_test(!profileServer->BeginCapture(filename.Get(), 3));
+
+    RecordJob job;
+    job.numZones = 10;
+    job.numFrames = 5;
+    job.frame = 0;
+    job.numDone = 0;
+    nThread* thread = n_new(nThread(RecordThreadFunc, nThread::Normal, 0, 0, 0, &job));
+    int frame;
+    for (frame = 0; frame < 5; frame++)
+    {
+        // a zone which is open across the end of the capture
+        profileServer->BeginZone(frameZone);
+        profileServer->BeginZone(zoneA);
+        Spin(100.0);
+        profileServer->EndZone(zoneA);
+        while (n_interlocked_read(&job.numDone) < (frame + 1))
+        {
+            n_sleep(0.0);
+        }
+        n_interlocked_exchange(&job.frame, frame + 1);
+        profileServer->NextFrame();
+        profileServer->EndZone(frameZone);
+    }
+    n_delete(thread);
+    profileServer->NextFrame();
+    n_test(!profileServer->IsCapturing());
+
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    n_test(file->Open(filename, "r"));
+    int size = file->GetSize();
+    char* text = n_new_array(char, size + 1);
+    n_test(size == file->Read(text, size));
+    text[size] = 0;
+    file->Close();
+    file->Release();
+
+    n_test(text == strstr(text, "{\"traceEvents\":["));
+    n_test(0 != strstr(text, "\"name\":\"Recorder\""));
+    n_test(0 != strstr(text, "\"name\":\"Main\""));
+    int numBegins = CountString(text, "\"ph\":\"B\"");
+    int numEnds = CountString(text, "\"ph\":\"E\"");
+    int numA = CountString(text, "\"name\":\"testA\"");
+    int numJobs = CountString(text, "\"name\":\"recordJob\"");
+    n_test((numBegins > 0) && (numBegins == numEnds));
+    n_test((numA >= 4) && (0 == (numA % 2)));
+    n_test((numJobs >= 20) && (0 == (numJobs % 2)));
+    n_test(3 == CountString(text, "\"ph\":\"i\""));
+    printf("capture: %d bytes, %d zones\n", size, numBegins);
+    n_delete_array(text);
+    nFileServer2::Instance()->DeleteFile(filename);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Record zones as fast as possible.
+*/
+static int
+N_THREADPROC
+CostThreadFunc(nThread* thread)
+{
+    thread->ThreadStarted();
+    RecordJob* job = (RecordJob*) thread->LockUserData();
+    thread->UnlockUserData();
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int zone = profileServer->RegisterZone("cost");
+    while (0 == n_interlocked_read(&job->startFlag))
+    {
+        n_sleep(0.0);
+    }
+    nTest::Timer timer;
+    int i;
+    for (i = 0; i < job->numZones; i++)
+    {
+        profileServer->BeginZone(zone);
+        profileServer->EndZone(zone);
+    }
+    job->zoneTime = timer.GetTime();
+    thread->ThreadHarakiri();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Get the time of a zone on numThreads threads at once in ns, the
+    zones fit into the thread buffers.
+*/
+static double
+TimeZones(int numThreads)
+{
+    nProfileServer* profileServer = nProfileServer::Instance();
+    int numZones = NumCostZones / numThreads;
+    double time = 0.0;
+    int numDone = 0;
+    while (numDone < NumCostZones)
+    {
+        nArray<RecordJob> jobs;
+        nArray<nThread*> threads;
+        jobs.SetFixedSize(numThreads);
+        threads.SetFixedSize(numThreads);
+        int i;
+        for (i = 0; i < numThreads; i++)
+        {
+            jobs[i].numZones = n_min(numZones, 4000);
+            jobs[i].startFlag = 0;
+            threads[i] = n_new(nThread(CostThreadFunc, nThread::Normal, 0, 0, 0, &jobs[i]));
+        }
+        for (i = 0; i < numThreads; i++)
+        {
+            n_interlocked_exchange(&jobs[i].startFlag, 1);
+        }
+        for (i = 0; i < numThreads; i++)
+        {
+            n_delete(threads[i]);
+            time += jobs[i].zoneTime;
+            numDone += jobs[i].numZones;
+        }
+        profileServer->NextFrame();
+    }
+    return (time * 1.0e9) / numDone;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numThreads = n_max(1, n_min(args.GetIntArg("-threads", 4), nProfileServer::MaxThreads - 1));
+    int numZones = n_max(1, n_min(args.GetIntArg("-zones", 1000), 2000));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 50));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    // the kernel server creates the profile server
+    nKernelServer kernelServer;
+    nProfileServer* profileServer = nProfileServer::Instance();
+    printf("time stamp counter: %.0f MHz\n", profileServer->GetTicksPerSecond() * 1.0e-6);
+
+    TestNesting();
+    TestThreads(numThreads, numZones, numFrames);
+    TestShortThreads();
+    nString filename;
+    filename.Format("%s/nprofileservertest.json", dir.Get());
+    TestCapture(filename);
+
+    // the cost of a zone on the main thread, in the thread buffer
+    int zone = profileServer->RegisterZone("cost");
+    nTest::Timer timer;
+    int i;
+    for (i = 0; i < 4000; i++)
+    {
+        profileServer->BeginZone(zone);
+        profileServer->EndZone(zone);
+    }
+    double mainTime = (timer.GetTime() * 1.0e9) / 4000;
+    profileServer->NextFrame();
+    n_test(4000 == profileServer->GetZoneCount(zone));
+
+    // what the old nProfiler did
+    nTimeServer* timeServer = nTimeServer::Instance();
+    nEnv* env = (nEnv*) kernelServer.New("nenv", "/sys/var/oldProfiler");
+    timer.Start();
+    for (i = 0; i < NumCostZones; i++)
+    {
+        nTime startTime = timeServer->GetTime();
+        nTime stopTime = timeServer->GetTime();
+        env->SetF(float(stopTime - startTime) * 1000.0f);
+    }
+    double oldTime = (timer.GetTime() * 1.0e9) / NumCostZones;
+    env->Release();
+
+    double threadTime = TimeZones(1);
+    double allThreadsTime = TimeZones(numThreads);
+    printf("zone cost: main thread %.1f ns, 1 thread %.1f ns, %d threads %.1f ns, old nProfiler %.1f ns\n",
+           mainTime, threadTime, numThreads, allThreadsTime, oldTime);
+    return nTest::Finish("nprofileservertest");
+}
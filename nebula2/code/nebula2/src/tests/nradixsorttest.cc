@@ -0,0 +1,268 @@
+//------------------------------------------------------------------------------
+//  nradixsorttest.cc
+//
+//  Tests nRadixSort and compares it with the qsort() based shape bucket
+//  sort the scene server used before. Synthetic shapes (a few render
+//  priorities, -nodes shape nodes, random positions) get the same 64 bit
+//  keys as nSceneServer::ComputeSortKey() builds, then buckets of
+//  several sizes are sorted both ways.
+//
+//  Command line args:
+//  -nodes      number of distinct shape nodes (default: 64)
+//  -repeat     number of sorts per bucket size (default: 20)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "util/nradixsort.h"
+#include "util/narray.h"
+#include "mathlib/vector.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+#include <stdlib.h>
+
+/// a shape as the scene server sees it
+struct Shape
+{
+    int renderPri;
+    uint nodeId;
+    vector3 pos;
+};
+
+static nArray<Shape> Shapes;
+static vector3 ViewerPos(0.0f, 1.0f, 0.0f);
+
+//------------------------------------------------------------------------------
+/**
+    The squared viewer distance of a shape.
+*/
+static float
+Depth(const Shape& shape)
+{
+    vector3 dist = ViewerPos - shape.pos;
+    return dist.lensquared();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Builds the key like nSceneServer::ComputeSortKey(): bits 56..63 render
+    priority, then node id and distance (front to back), or inverted
+    distance and node id (back to front).
+*/
+static uint64
+ComputeKey(const Shape& shape, bool backToFront)
+{
+    int pri = n_iclamp(shape.renderPri + 128, 0, 255);
+    uint64 key = uint64(pri) << 56;
+    union
+    {
+        float f;
+        uint u;
+    } depth;
+    depth.f = Depth(shape);
+    if (backToFront)
+    {
+        key |= (uint64(~depth.u) << 24) | uint64(shape.nodeId & 0x00ffffff);
+    }
+    else
+    {
+        key |= (uint64(shape.nodeId & 0x00ffffff) << 32) | uint64(depth.u);
+    }
+    return key;
+}
+
+//------------------------------------------------------------------------------
+/**
+    The comparison the scene server's qsort() used (front to back).
+*/
+static int
+CompareShapes(const void* p1, const void* p2)
+{
+    const Shape& s1 = Shapes[*(const ushort*)p1];
+    const Shape& s2 = Shapes[*(const ushort*)p2];
+    int cmp = s1.renderPri - s2.renderPri;
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    if (s1.nodeId != s2.nodeId)
+    {
+        return (s1.nodeId < s2.nodeId) ? -1 : 1;
+    }
+    float diff = Depth(s1) - Depth(s2);
+    if (diff < 0.0f) return -1;
+    if (diff > 0.0f) return 1;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check that a sorted bucket is a permutation of [0, num), that the
+    keys ascend and that equal keys kept their order.
+*/
+static void
+CheckSorted(const uint64* keys, const ushort* indices, int num)
+{
+    nArray<bool> seen;
+    seen.SetFixedSize(num);
+    seen.Fill(0, num, false);
+    int numWrong = 0;
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        if ((indices[i] >= num) || seen[indices[i]])
+        {
+            numWrong++;
+            continue;
+        }
+        seen[indices[i]] = true;
+        if (i > 0)
+        {
+            if (keys[i - 1] > keys[i])
+            {
+                numWrong++;
+            }
+            else if ((keys[i - 1] == keys[i]) && (indices[i - 1] > indices[i]))
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+    A front to back sorted bucket must have the same order of priority,
+    node and depth as the qsort() result.
+*/
+static void
+CheckSameOrder(const ushort* radixIndices, const ushort* qsortIndices, int num)
+{
+    int numWrong = 0;
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        const Shape& s1 = Shapes[radixIndices[i]];
+        const Shape& s2 = Shapes[qsortIndices[i]];
+        if ((s1.renderPri != s2.renderPri) || (s1.nodeId != s2.nodeId) || (Depth(s1) != Depth(s2)))
+        {
+            numWrong++;
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+RunBucket(int num, int numRepeats)
+{
+    nArray<uint64> keys;
+    nArray<ushort> radixIndices;
+    nArray<ushort> qsortIndices;
+    keys.SetFixedSize(num);
+    radixIndices.SetFixedSize(num);
+    qsortIndices.SetFixedSize(num);
+    nRadixSort<ushort> radixSort;
+    nTest::Timer timer;
+    double keyTime = 0.0;
+    double radixTime = 0.0;
+    double backRadixTime = 0.0;
+    double qsortTime = 0.0;
+
+    int repeat;
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        int i;
+
+        // front to back
+        timer.Start();
+        for (i = 0; i < num; i++)
+        {
+            keys[i] = ComputeKey(Shapes[i], false);
+            radixIndices[i] = ushort(i);
+        }
+        keyTime += timer.GetTime();
+        timer.Start();
+        radixSort.Sort(&keys[0], &radixIndices[0], num);
+        radixTime += timer.GetTime();
+        CheckSorted(&keys[0], &radixIndices[0], num);
+
+        for (i = 0; i < num; i++)
+        {
+            qsortIndices[i] = ushort(i);
+        }
+        timer.Start();
+        qsort(&qsortIndices[0], num, sizeof(ushort), CompareShapes);
+        qsortTime += timer.GetTime();
+        CheckSameOrder(&radixIndices[0], &qsortIndices[0], num);
+
+        // back to front
+        for (i = 0; i < num; i++)
+        {
+            keys[i] = ComputeKey(Shapes[i], true);
+            radixIndices[i] = ushort(i);
+        }
+        timer.Start();
+        radixSort.Sort(&keys[0], &radixIndices[0], num);
+        backRadixTime += timer.GetTime();
+        CheckSorted(&keys[0], &radixIndices[0], num);
+        int numWrong = 0;
+        for (i = 1; i < num; i++)
+        {
+            const Shape& s0 = Shapes[radixIndices[i - 1]];
+            const Shape& s1 = Shapes[radixIndices[i]];
+            if ((s0.renderPri == s1.renderPri) && (Depth(s0) < Depth(s1)))
+            {
+                numWrong++;
+            }
+        }
+        n_test(0 == numWrong);
+    }
+
+    double scale = 1000000.0 / numRepeats;
+    printf("%6d shapes: keys %9.2f us, radix sort %9.2f us (back to front %9.2f us), qsort %9.2f us, speedup %.2f\n",
+           num, keyTime * scale, radixTime * scale, backRadixTime * scale, qsortTime * scale,
+           (radixTime > 0.0) ? qsortTime / radixTime : 0.0);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numNodes = n_max(1, args.GetIntArg("-nodes", 64));
+    int numRepeats = n_max(1, args.GetIntArg("-repeat", 20));
+
+    // keys which only differ in the lowest byte, and equal keys
+    nRadixSort<int> intSort;
+    uint64 smallKeys[6] = { 5, 3, 5, 1, 3, 5 };
+    int values[6] = { 0, 1, 2, 3, 4, 5 };
+    intSort.Sort(smallKeys, values, 6);
+    n_test((1 == smallKeys[0]) && (3 == values[0]));
+    n_test((3 == smallKeys[1]) && (1 == values[1]) && (4 == values[2]));
+    n_test((5 == smallKeys[3]) && (0 == values[3]) && (2 == values[4]) && (5 == values[5]));
+
+    // the synthetic shapes, the largest bucket must fit ushort indices
+    const int maxShapes = 65535;
+    srand(1234);
+    Shapes.SetFixedSize(maxShapes);
+    int i;
+    for (i = 0; i < maxShapes; i++)
+    {
+        Shape& shape = Shapes[i];
+        shape.renderPri = (rand() % 3) - 1;
+        shape.nodeId = 0x1000 + (rand() % numNodes) * 16;
+        shape.pos.set(float(rand() % 2000) * 0.1f - 100.0f, float(rand() % 100) * 0.1f, float(rand() % 2000) * 0.1f - 100.0f);
+    }
+
+    RunBucket(100, numRepeats * 100);
+    RunBucket(1000, numRepeats * 10);
+    RunBucket(10000, numRepeats);
+    RunBucket(maxShapes, numRepeats);
+    return nTest::Finish("nradixsorttest");
+}
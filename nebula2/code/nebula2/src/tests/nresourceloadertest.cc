@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+//  nresourceloadertest.cc
+//
+//  Stress test for the async loader of nResourceServer. -files nax2
+//  animation files are written to -dir and loaded synchronously once, this
+//  is the reference and the serial time. Then all files are loaded async
+//  with random load priorities and 1 to -loaders loader jobs, every
+//  loaded animation must sample like the reference. The wall time of
+//  every pass is reported. Finally load requests are cancelled by
+//  unloading and releasing resources while their jobs are queued or
+//  running.
+//
+//  Command line args:
+//  -files      number of animation files (default: 2000)
+//  -loaders    highest number of loader jobs (default: number of processors)
+//  -dir        existing directory for the animation files (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "kernel/njobserver.h"
+#include "resource/nresourceserver.h"
+#include "anim2/nanimationserver.h"
+#include "anim2/nmemoryanimation.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const int NumCurves = 12;
+static const int NumKeys = 60;
+static const float KeyTime = 1.0f / 25.0f;
+static const int NumSampleTimes = 4;
+static const int NumSamples = NumSampleTimes * NumCurves;
+
+static nRandom Random(1234);
+
+//------------------------------------------------------------------------------
+/**
+    Write a nax2 file with one group of NumCurves linear and quaternion
+    curves and a collapsed curve.
+*/
+static bool
+WriteAnimation(const nString& filename)
+{
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (!file->Open(filename, "wb"))
+    {
+        file->Release();
+        return false;
+    }
+    file->PutInt('NAX2');
+    file->PutInt(1);
+    file->PutInt(NumCurves * NumKeys);
+
+    // the group
+    file->PutInt(NumCurves);
+    file->PutInt(0);
+    file->PutInt(NumKeys);
+    file->PutInt(NumCurves);
+    file->PutFloat(KeyTime);
+    file->PutFloat(0.0f);
+    file->PutInt(nAnimation::Group::Repeat);
+
+    // the curves
+    int curveIndex;
+    for (curveIndex = 0; curveIndex < NumCurves; curveIndex++)
+    {
+        bool collapsed = (curveIndex == NumCurves - 1);
+        file->PutInt((1 == (curveIndex % 3)) ? nAnimation::Curve::Quat : nAnimation::Curve::Linear);
+        file->PutInt(collapsed ? -1 : curveIndex);
+        file->PutInt(collapsed ? 0 : 1);
+        file->PutFloat(Random.Rand(-1.0f, 1.0f));
+        file->PutFloat(Random.Rand(-1.0f, 1.0f));
+        file->PutFloat(Random.Rand(-1.0f, 1.0f));
+        file->PutFloat(1.0f);
+    }
+
+    // the keys
+    int key;
+    for (key = 0; key < NumKeys; key++)
+    {
+        for (curveIndex = 0; curveIndex < NumCurves; curveIndex++)
+        {
+            if (1 == (curveIndex % 3))
+            {
+                quaternion q;
+                q.set_rotate_axis_angle(vector3(0.0f, 1.0f, 0.0f), Random.Rand(-N_PI, N_PI));
+                file->PutFloat(q.x);
+                file->PutFloat(q.y);
+                file->PutFloat(q.z);
+                file->PutFloat(q.w);
+            }
+            else
+            {
+                file->PutFloat(Random.Rand(-1.0f, 1.0f));
+                file->PutFloat(Random.Rand(-1.0f, 1.0f));
+                file->PutFloat(Random.Rand(-1.0f, 1.0f));
+                file->PutFloat(1.0f);
+            }
+        }
+    }
+    file->Close();
+    file->Release();
+    return true;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sample all curves of an animation at NumSampleTimes times.
+*/
+static void
+SampleAnimation(nMemoryAnimation* anim, vector4* dst)
+{
+    int i;
+    for (i = 0; i < NumSampleTimes; i++)
+    {
+        float time = (float(i) / float(NumSampleTimes)) * NumKeys * KeyTime + 0.01f;
+        anim->SampleCurves(time, 0, 0, NumCurves, dst + i * NumCurves);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create the animation resources of a pass, with random load priorities.
+*/
+static void
+CreateAnimations(const nArray<nString>& files, int pass, bool async, nArray<nMemoryAnimation*>& anims)
+{
+    nResourceServer* resourceServer = nResourceServer::Instance();
+    anims.SetFixedSize(files.Size());
+    int i;
+    for (i = 0; i < files.Size(); i++)
+    {
+        nString name;
+        name.Format("pass%d_%d", pass, i);
+        anims[i] = (nMemoryAnimation*) resourceServer->NewResource("nmemoryanimation", name, nResource::Animation);
+        anims[i]->SetFilename(files[i]);
+        anims[i]->SetAsyncEnabled(async);
+        anims[i]->SetLoadPriority(Random.Rand(0.0f, 100.0f));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Wait until no animation has a pending load request, call the per-frame
+    trigger of the resource server meanwhile.
+*/
+static void
+WaitForAnimations(const nArray<nMemoryAnimation*>& anims)
+{
+    int i = 0;
+    while (i < anims.Size())
+    {
+        if ((0 != anims[i]) && anims[i]->IsPending())
+        {
+            nResourceServer::Instance()->Trigger();
+            n_sleep(0.001);
+        }
+        else
+        {
+            i++;
+        }
+    }
+    nResourceServer::Instance()->Trigger();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Count the loaded animations which don't sample like the reference.
+*/
+static int
+CountWrongAnimations(const nArray<nMemoryAnimation*>& anims, const nArray<vector4>& reference)
+{
+    int numWrong = 0;
+    vector4 samples[NumSamples];
+    int i;
+    for (i = 0; i < anims.Size(); i++)
+    {
+        if (!anims[i]->IsValid())
+        {
+            numWrong++;
+            continue;
+        }
+        SampleAnimation(anims[i], samples);
+        if (0 != memcmp(samples, &reference[i * NumSamples], sizeof(samples)))
+        {
+            numWrong++;
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+ReleaseAnimations(nArray<nMemoryAnimation*>& anims)
+{
+    int i;
+    for (i = 0; i < anims.Size(); i++)
+    {
+        if (anims[i])
+        {
+            anims[i]->Release();
+            anims[i] = 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Unload every 3rd animation and release every 3rd animation right
+    after the load requests have been issued. Unloaded animations must
+    end up unloaded, released animations must be destroyed by the
+    resource server's Trigger(), all others must be valid.
+*/
+static void
+TestCancel(const nArray<nString>& files, const nArray<vector4>& reference, int pass)
+{
+    nResourceServer* resourceServer = nResourceServer::Instance();
+    int numBefore = resourceServer->GetNumResources(nResource::Animation);
+    nArray<nMemoryAnimation*> anims;
+    CreateAnimations(files, pass, true, anims);
+    int i;
+    for (i = 0; i < anims.Size(); i++)
+    {
+        anims[i]->Load();
+    }
+    int numReleased = 0;
+    for (i = 0; i < anims.Size(); i++)
+    {
+        if (1 == (i % 3))
+        {
+            anims[i]->Unload();
+        }
+        else if (2 == (i % 3))
+        {
+            anims[i]->Release();
+            anims[i] = 0;
+            numReleased++;
+        }
+    }
+    WaitForAnimations(anims);
+
+    // a running LoadResource() is not cancelled, those are unloaded again
+    int numWrong = 0;
+    vector4 samples[NumSamples];
+    for (i = 0; i < anims.Size(); i++)
+    {
+        if (1 == (i % 3))
+        {
+            if (anims[i]->IsValid())
+            {
+                anims[i]->Unload();
+            }
+            if (!anims[i]->IsUnloaded() || anims[i]->IsPending())
+            {
+                numWrong++;
+            }
+        }
+        else if (anims[i])
+        {
+            if (!anims[i]->IsValid())
+            {
+                numWrong++;
+                continue;
+            }
+            SampleAnimation(anims[i], samples);
+            if (0 != memcmp(samples, &reference[i * NumSamples], sizeof(samples)))
+            {
+                numWrong++;
+            }
+        }
+    }
+    n_test(0 == numWrong);
+    n_test(0 == resourceServer->GetNumLoaderJobs());
+    n_test(numBefore + anims.Size() - numReleased == resourceServer->GetNumResources(nResource::Animation));
+    ReleaseAnimations(anims);
+    resourceServer->Trigger();
+    n_test(numBefore == resourceServer->GetNumResources(nResource::Animation));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numFiles = n_max(1, args.GetIntArg("-files", 2000));
+    int maxLoaders = n_max(1, args.GetIntArg("-loaders", nJobServer::GetNumProcessors()));
+    maxLoaders = n_min(maxLoaders, int(nJobServer::MaxWorkers));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    nResourceServer* resourceServer = (nResourceServer*) kernelServer.New("nresourceserver", "/sys/servers/resource");
+    nAnimationServer* animServer = (nAnimationServer*) kernelServer.New("nanimationserver", "/sys/servers/anim");
+    nFileServer2* fileServer = nFileServer2::Instance();
+
+    // the loader jobs run on the job workers
+    nJobServer::Instance()->SetNumWorkers(maxLoaders);
+
+    // write the animation files
+    nArray<nString> files;
+    files.SetFixedSize(numFiles);
+    int i;
+    int numWritten = 0;
+    for (i = 0; i < numFiles; i++)
+    {
+        files[i].Format("%s/nresourceloadertest%d.nax2", dir.Get(), i);
+        if (WriteAnimation(files[i]))
+        {
+            numWritten++;
+        }
+    }
+    n_test(numFiles == numWritten);
+
+    // load synchronously, this is the reference
+    nArray<vector4> reference;
+    reference.SetFixedSize(numFiles * NumSamples);
+    nArray<nMemoryAnimation*> anims;
+    int pass = 0;
+    CreateAnimations(files, pass++, false, anims);
+    nTest::Timer timer;
+    for (i = 0; i < numFiles; i++)
+    {
+        anims[i]->Load();
+    }
+    double serialTime = timer.GetTime();
+    for (i = 0; i < numFiles; i++)
+    {
+        n_test(anims[i]->IsValid());
+        SampleAnimation(anims[i], &reference[i * NumSamples]);
+    }
+    ReleaseAnimations(anims);
+    printf("%d files: sync %.1f ms\n", numFiles, serialTime * 1000.0);
+
+    // async with increasing number of loader jobs
+    int numLoaders;
+    for (numLoaders = 1; numLoaders <= maxLoaders; numLoaders++)
+    {
+        resourceServer->SetNumLoaderThreads(numLoaders);
+        CreateAnimations(files, pass++, true, anims);
+        timer.Start();
+        for (i = 0; i < numFiles; i++)
+        {
+            anims[i]->Load();
+        }
+        WaitForAnimations(anims);
+        double asyncTime = timer.GetTime();
+        n_test(0 == CountWrongAnimations(anims, reference));
+        ReleaseAnimations(anims);
+        printf("loaders %d: async %.1f ms, speedup %.2f\n",
+               numLoaders, asyncTime * 1000.0, (asyncTime > 0.0) ? serialTime / asyncTime : 0.0);
+    }
+
+    // cancel load requests, with one and with all loaders
+    resourceServer->SetNumLoaderThreads(1);
+    TestCancel(files, reference, pass++);
+    resourceServer->SetNumLoaderThreads(maxLoaders);
+    TestCancel(files, reference, pass++);
+
+    for (i = 0; i < numFiles; i++)
+    {
+        fileServer->DeleteFile(files[i]);
+    }
+    animServer->Release();
+    resourceServer->Release();
+    return nTest::Finish("nresourceloadertest");
+}
@@ -0,0 +1,194 @@
+//------------------------------------------------------------------------------
+//  nscenebenchmark.cc
+//
+//  Headless benchmark of the nSceneServer scene build. Loads an object,
+//  attaches it with -contexts synthetic render contexts (on a grid) and
+//  measures Attach() and BuildScene() (split, resource validation,
+//  character update, light scissors, sorting) without rendering. The
+//  serial build is measured first, then the parallel build for every
+//  worker count from 0 to -workers.
+//
+//  Command line args:
+//  -view       the object to load (default: home:export/gfxlib/examples/tiger.n2)
+//  -stage      the light stage (default: home:export/gfxlib/stdlight.n2)
+//  -startup    the startup script (default: home:data/scripts/startup.tcl)
+//  -contexts   number of render contexts (default: 1000)
+//  -frames     number of measured frames per run (default: 100)
+//  -workers    highest worker count (default: number of processors - 1)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/ntimeserver.h"
+#include "kernel/nworkerpool.h"
+#include "scene/nsceneserver.h"
+#include "scene/nrendercontext.h"
+#include "scene/ntransformnode.h"
+#include "gfx2/ngfxserver2.h"
+#include "tools/nviewerapp.h"
+#include "tools/nnodelist.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+#ifdef __WIN32__
+nNebulaUsePackage(ndinput8);
+nNebulaUsePackage(ndirect3d9);
+nNebulaUsePackage(ndshow);
+nNebulaUsePackage(ndsound);
+#endif
+nNebulaUsePackage(ngui);
+nNebulaUsePackage(nnetwork);
+
+//------------------------------------------------------------------------------
+/**
+    Build numFrames frames and return the average Attach() and
+    BuildScene() times in milliseconds.
+*/
+static void
+RunFrames(nArray<nRenderContext>& contexts, const matrix44& viewMatrix, int numFrames, double& attachTime, double& buildTime)
+{
+    nSceneServer* sceneServer = nSceneServer::Instance();
+    nNodeList* nodeList = nNodeList::Instance();
+    nTest::Timer timer;
+    attachTime = 0.0;
+    buildTime = 0.0;
+    static uint frameId = 0;
+
+    // the first frame loads the resources and is not measured
+    int frame;
+    for (frame = -1; frame < numFrames; frame++)
+    {
+        nGfxServer2::Instance()->Trigger();
+        nTimeServer::Instance()->Trigger();
+        double time = nTimeServer::Instance()->GetTime();
+        frameId++;
+        nodeList->Trigger(time, frameId);
+        int i;
+        for (i = 0; i < contexts.Size(); i++)
+        {
+            nodeList->TransferGlobalVars(contexts[i], time, frameId);
+        }
+
+        timer.Start();
+        if (sceneServer->BeginScene(viewMatrix))
+        {
+            // the light stage and the other entries of the node list
+            uint entry;
+            for (entry = 0; entry < nodeList->GetCount() - 1; entry++)
+            {
+                sceneServer->Attach(nodeList->GetRenderContextAt(entry));
+            }
+            for (i = 0; i < contexts.Size(); i++)
+            {
+                sceneServer->Attach(&contexts[i]);
+            }
+            sceneServer->EndScene();
+            double attached = timer.GetTime();
+            sceneServer->BuildScene();
+            double built = timer.GetTime();
+            sceneServer->PresentScene();
+            if (frame >= 0)
+            {
+                attachTime += attached;
+                buildTime += built - attached;
+            }
+        }
+    }
+    attachTime = attachTime * 1000.0 / numFrames;
+    buildTime = buildTime * 1000.0 / numFrames;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    nString viewArg    = args.GetStringArg("-view", "home:export/gfxlib/examples/tiger.n2");
+    nString stageArg   = args.GetStringArg("-stage", "home:export/gfxlib/stdlight.n2");
+    nString startupArg = args.GetStringArg("-startup", "home:data/scripts/startup.tcl");
+    int numContexts    = n_max(1, args.GetIntArg("-contexts", 1000));
+    int numFrames      = n_max(1, args.GetIntArg("-frames", 100));
+    int maxWorkers     = n_max(0, args.GetIntArg("-workers", nWorkerPool::GetNumProcessors() - 1));
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    #ifdef __WIN32__
+    kernelServer.AddPackage(ndinput8);
+    kernelServer.AddPackage(ndirect3d9);
+    kernelServer.AddPackage(ndshow);
+    kernelServer.AddPackage(ndsound);
+    #endif
+    kernelServer.AddPackage(ngui);
+    kernelServer.AddPackage(nnetwork);
+
+    // a small window, nothing is rendered into it
+    nDisplayMode2 displayMode;
+    displayMode.SetWindowTitle("Nebula2 scene benchmark");
+    displayMode.SetWidth(320);
+    displayMode.SetHeight(240);
+    displayMode.SetVerticalSync(false);
+    displayMode.SetType(nDisplayMode2::Windowed);
+
+    nViewerApp viewerApp;
+    viewerApp.SetDisplayMode(displayMode);
+    viewerApp.SetOverlayEnabled(false);
+    viewerApp.SetSceneFile(viewArg);
+    viewerApp.SetStartupScript(startupArg);
+    viewerApp.SetStageScript(stageArg);
+    if (!viewerApp.Open())
+    {
+        printf("Error: failed to open the viewer app!\n");
+        return 10;
+    }
+
+    // the loaded object is the last node list entry, attach it
+    // with numContexts render contexts on a grid
+    nNodeList* nodeList = nNodeList::Instance();
+    n_test(nodeList->GetCount() > 0);
+    nTransformNode* object = nodeList->GetNodeAt(nodeList->GetCount() - 1);
+    nArray<nRenderContext> contexts;
+    contexts.SetFixedSize(numContexts);
+    int gridSize = int(ceilf(sqrtf(float(numContexts))));
+    int i;
+    for (i = 0; i < numContexts; i++)
+    {
+        matrix44 transform;
+        transform.translate(vector3(float(i % gridSize - gridSize / 2) * 3.0f, 0.0f, -float(i / gridSize) * 3.0f));
+        nodeList->AddDefaultVariables(contexts[i]);
+        contexts[i].SetRootNode(object);
+        contexts[i].SetTransform(transform);
+        object->RenderContextCreated(&contexts[i]);
+    }
+    const matrix44& viewMatrix = viewerApp.GetCamControl().GetViewMatrix();
+
+    nSceneServer* sceneServer = nSceneServer::Instance();
+    nWorkerPool* workerPool = nWorkerPool::Instance();
+    double attachTime;
+    double buildTime;
+    printf("%d render contexts, %d frames\n", numContexts, numFrames);
+
+    sceneServer->SetParallelBuild(false);
+    RunFrames(contexts, viewMatrix, numFrames, attachTime, buildTime);
+    printf("serial: attach %.3f ms, build %.3f ms\n", attachTime, buildTime);
+    double serialBuildTime = buildTime;
+
+    sceneServer->SetParallelBuild(true);
+    int numWorkers;
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        workerPool->SetNumWorkers(numWorkers);
+        RunFrames(contexts, viewMatrix, numFrames, attachTime, buildTime);
+        printf("workers %d: attach %.3f ms, build %.3f ms, speedup %.2f\n",
+               numWorkers, attachTime, buildTime, (buildTime > 0.0) ? serialBuildTime / buildTime : 0.0);
+    }
+
+    for (i = 0; i < numContexts; i++)
+    {
+        object->RenderContextDestroyed(&contexts[i]);
+    }
+    viewerApp.Close();
+    return nTest::Finish("nscenebenchmark");
+}
@@ -0,0 +1,271 @@
+//------------------------------------------------------------------------------
+//  nskeletontest.cc
+//
+//  Tests and benchmarks nCharSkeleton::Evaluate(). Random joint
+//  hierarchies (joints in random order, several roots) are animated and
+//  evaluated with the linear pass of nCharSkeleton and with the recursive
+//  nCharJoint::Evaluate() on a copy of the joints, all matrices must be
+//  bit identical. Then -characters skeletons with -joints joints each are
+//  evaluated per frame with both paths.
+//
+//  Command line args:
+//  -characters number of characters of the benchmark (default: 500)
+//  -joints     number of joints per character (default: 60)
+//  -frames     number of measured frames (default: 100)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "character/ncharskeleton.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+static nRandom Random(1234);
+
+//------------------------------------------------------------------------------
+/**
+*/
+static vector3
+RandVector(float min, float max)
+{
+    return vector3(Random.Rand(min, max), Random.Rand(min, max), Random.Rand(min, max));
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static quaternion
+RandRotation()
+{
+    quaternion q(Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f));
+    q.normalize();
+    return q;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create a skeleton with num joints. The joint indices are shuffled, so
+    that children may come before their parents, every 8th joint is a
+    root.
+*/
+static void
+SetupSkeleton(nCharSkeleton& skeleton, int num)
+{
+    nArray<int> perm;
+    perm.SetFixedSize(num);
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        perm[i] = i;
+    }
+    for (i = num - 1; i > 0; i--)
+    {
+        int j = Random.Next() % (i + 1);
+        int tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+    skeleton.BeginJoints(num);
+    for (i = 0; i < num; i++)
+    {
+        int parent = ((0 == i) || (0 == Random.Next() % 8)) ? -1 : perm[Random.Next() % i];
+        skeleton.SetJoint(perm[i], parent, RandVector(-2.0f, 2.0f), RandRotation(), RandVector(0.5f, 2.0f), "joint");
+    }
+    skeleton.EndJoints();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Copy the joints of a skeleton into a plain joint array for the
+    recursive evaluation.
+*/
+static void
+CopyJoints(const nCharSkeleton& skeleton, nFixedArray<nCharJoint>& joints)
+{
+    int num = skeleton.GetNumJoints();
+    joints.SetSize(num);
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        joints[i] = skeleton.GetJointAt(i);
+    }
+    for (i = 0; i < num; i++)
+    {
+        int parent = joints[i].GetParentJointIndex();
+        joints[i].SetParentJoint((-1 == parent) ? 0 : &joints[parent]);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    The recursive evaluation nCharSkeleton used before.
+*/
+static void
+EvaluateRecursive(nFixedArray<nCharJoint>& joints)
+{
+    int i;
+    for (i = 0; i < joints.Size(); i++)
+    {
+        joints[i].ClearUptodateFlag();
+    }
+    for (i = 0; i < joints.Size(); i++)
+    {
+        joints[i].Evaluate();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static bool
+IsIdentical(const nCharJoint& j0, const nCharJoint& j1)
+{
+    return (0 == memcmp(&j0.GetMatrix(), &j1.GetMatrix(), sizeof(matrix44))) &&
+           (0 == memcmp(&j0.GetLocalMatrix(), &j1.GetLocalMatrix(), sizeof(matrix44))) &&
+           (0 == memcmp(&j0.GetSkinMatrix44(), &j1.GetSkinMatrix44(), sizeof(matrix44))) &&
+           (0 == memcmp(&j0.GetSkinMatrix33(), &j1.GetSkinMatrix33(), sizeof(matrix33))) &&
+           j0.IsUptodate();
+}
+
+//------------------------------------------------------------------------------
+/**
+    Animate most joints of both joint sets the same way. Includes
+    zero quaternions, variation scales and joints which get their
+    matrix set directly (like ragdoll joints).
+*/
+static void
+AnimateJoints(nCharSkeleton& skeleton, nFixedArray<nCharJoint>* joints, bool setMatrices)
+{
+    int i;
+    for (i = 0; i < skeleton.GetNumJoints(); i++)
+    {
+        int r = Random.Next() % 10;
+        if (r < 7)
+        {
+            vector3 t = RandVector(-3.0f, 3.0f);
+            quaternion q(Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f), Random.Rand(-1.0f, 1.0f));
+            if (0 == r)
+            {
+                q.set(0.0f, 0.0f, 0.0f, 0.0f);
+            }
+            vector3 s = RandVector(0.5f, 2.0f);
+            skeleton.GetJointAt(i).SetTranslate(t);
+            skeleton.GetJointAt(i).SetRotate(q);
+            skeleton.GetJointAt(i).SetScale(s);
+            if (joints)
+            {
+                (*joints)[i].SetTranslate(t);
+                (*joints)[i].SetRotate(q);
+                (*joints)[i].SetScale(s);
+            }
+            if (1 == r)
+            {
+                vector3 v = RandVector(0.5f, 2.0f);
+                skeleton.GetJointAt(i).SetVariationScale(v);
+                if (joints)
+                {
+                    (*joints)[i].SetVariationScale(v);
+                }
+            }
+        }
+        else if ((7 == r) && setMatrices)
+        {
+            matrix44 m;
+            m.rotate_x(Random.Rand(0.0f, 3.0f));
+            m.translate(vector3(1.0f, 2.0f, 3.0f));
+            skeleton.GetJointAt(i).SetMatrix(m);
+            if (joints)
+            {
+                (*joints)[i].SetMatrix(m);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+static void
+TestEvaluate()
+{
+    int numWrong = 0;
+    int iter;
+    for (iter = 0; iter < 200; iter++)
+    {
+        int num = 1 + Random.Next() % 70;
+        nCharSkeleton skeleton;
+        SetupSkeleton(skeleton, num);
+        nFixedArray<nCharJoint> joints;
+        CopyJoints(skeleton, joints);
+        int frame;
+        for (frame = 0; frame < 5; frame++)
+        {
+            AnimateJoints(skeleton, &joints, (2 == frame));
+            skeleton.Evaluate();
+            EvaluateRecursive(joints);
+            int i;
+            for (i = 0; i < num; i++)
+            {
+                if (!IsIdentical(skeleton.GetJointAt(i), joints[i]))
+                {
+                    numWrong++;
+                }
+            }
+        }
+    }
+    n_test(0 == numWrong);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numCharacters = n_max(1, args.GetIntArg("-characters", 500));
+    int numJoints = n_max(1, args.GetIntArg("-joints", 60));
+    int numFrames = n_max(1, args.GetIntArg("-frames", 100));
+
+    TestEvaluate();
+
+    // the characters of the benchmark, both paths evaluate the same poses
+    nFixedArray<nCharSkeleton> skeletons(numCharacters);
+    nFixedArray<nFixedArray<nCharJoint> > joints(numCharacters);
+    int i;
+    for (i = 0; i < numCharacters; i++)
+    {
+        SetupSkeleton(skeletons[i], numJoints);
+        CopyJoints(skeletons[i], joints[i]);
+    }
+
+    nTest::Timer timer;
+    double linearTime = 0.0;
+    double recursiveTime = 0.0;
+    int frame;
+    for (frame = 0; frame < numFrames; frame++)
+    {
+        for (i = 0; i < numCharacters; i++)
+        {
+            AnimateJoints(skeletons[i], &joints[i], false);
+        }
+        timer.Start();
+        for (i = 0; i < numCharacters; i++)
+        {
+            skeletons[i].Evaluate();
+        }
+        linearTime += timer.GetTime();
+        timer.Start();
+        for (i = 0; i < numCharacters; i++)
+        {
+            EvaluateRecursive(joints[i]);
+        }
+        recursiveTime += timer.GetTime();
+    }
+    linearTime = linearTime * 1000.0 / numFrames;
+    recursiveTime = recursiveTime * 1000.0 / numFrames;
+    printf("%d characters x %d joints: linear %.3f ms/frame, recursive %.3f ms/frame, speedup %.2f\n",
+           numCharacters, numJoints, linearTime, recursiveTime,
+           (linearTime > 0.0) ? recursiveTime / linearTime : 0.0);
+    return nTest::Finish("nskeletontest");
+}
@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+//  nskinningtest.cc
+//
+//  Tests and benchmarks the CPU skinning kernels of nSkinMeshDeformer on
+//  a synthetic -vertices vertex mesh with position, normal, uv0, tangent
+//  and binormal, 1 to 4 weights per vertex and -joints joints. The SSE
+//  kernel, SkinPositions() and the worker pool path (for every worker
+//  count from 0 to -workers) must produce the same vertices as the
+//  scalar kernel. Then the scalar kernel, the SSE kernel and the worker
+//  pool path are timed.
+//
+//  Command line args:
+//  -vertices   number of vertices (default: 50000)
+//  -joints     number of joints (default: 60)
+//  -repeat     number of measured skinning passes (default: 50)
+//  -workers    highest worker count (default: number of processors - 1)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "deformers/nskinmeshdeformer.h"
+#include "kernel/njobserver.h"
+#include "kernel/nworkerpool.h"
+#include "kernel/nprofileserver.h"
+#include "util/nrandom.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+//------------------------------------------------------------------------------
+/**
+    Gives the test access to the skinning kernels.
+*/
+class nSkinningTestDeformer : public nSkinMeshDeformer
+{
+public:
+    using nSkinMeshDeformer::Layout;
+
+    /// setup the layout of the test mesh
+    static void SetupLayout(Layout& layout);
+    /// skin with the scalar kernel
+    static void SkinScalar(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+    /// skin with the SSE kernel (if available)
+    static void SkinSimd(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+    /// skin on the worker pool like Compute() does
+    static void SkinParallel(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices);
+
+    enum
+    {
+        // coord, normal, uv0, tangent, binormal, weights, jindices
+        SrcWidth = 3 + 3 + 2 + 3 + 3 + 4 + 4,
+        DstWidth = 3 + 3 + 2 + 3 + 3,
+        WeightOffset = 14,
+        JIndexOffset = 18,
+    };
+};
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSkinningTestDeformer::SetupLayout(Layout& layout)
+{
+    layout.srcWidth = SrcWidth;
+    layout.dstWidth = DstWidth;
+    layout.weights = WeightOffset;
+    layout.jindices = JIndexOffset;
+    layout.srcNormal = layout.dstNormal = 3;
+    layout.srcTangent = layout.dstTangent = 8;
+    layout.srcBinormal = layout.dstBinormal = 11;
+    layout.numCopyRanges = 1;
+    layout.copySrc[0] = layout.copyDst[0] = 6;
+    layout.copySize[0] = 2;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSkinningTestDeformer::SkinScalar(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+    SkinVerticesScalar(layout, skinMatrices, src, dst, numVertices);
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSkinningTestDeformer::SkinSimd(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+#ifdef __NEBULA_SKINNING_SSE__
+    SkinVerticesSSE(layout, skinMatrices, src, dst, numVertices);
+#else
+    SkinVerticesScalar(layout, skinMatrices, src, dst, numVertices);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+void
+nSkinningTestDeformer::SkinParallel(const Layout& layout, const matrix44* skinMatrices, const float* src, float* dst, int numVertices)
+{
+    Job job;
+    job.layout = &layout;
+    job.skinMatrices = skinMatrices;
+    job.src = src;
+    job.dst = dst;
+    job.numVertices = numVertices;
+    int numTasks = (numVertices + VerticesPerTask - 1) / VerticesPerTask;
+    nWorkerPool::Instance()->Run(numTasks, SkinVerticesTask, &job);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create random skin matrices (rotation, scale, translation).
+*/
+static void
+SetupMatrices(nArray<matrix44>& matrices, int numJoints, nRandom& random)
+{
+    matrices.SetFixedSize(numJoints);
+    int i;
+    for (i = 0; i < numJoints; i++)
+    {
+        matrix44& m = matrices[i];
+        m.ident();
+        m.scale(vector3(random.Rand(0.8f, 1.2f), random.Rand(0.8f, 1.2f), random.Rand(0.8f, 1.2f)));
+        m.rotate_x(random.Rand(-N_PI, N_PI));
+        m.rotate_y(random.Rand(-N_PI, N_PI));
+        m.translate(vector3(random.Rand(-1.0f, 1.0f), random.Rand(0.0f, 2.0f), random.Rand(-1.0f, 1.0f)));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Create random source vertices with 1 to 4 weights which sum up to 1.
+*/
+static void
+SetupVertices(float* src, int numVertices, int numJoints, nRandom& random)
+{
+    int v;
+    for (v = 0; v < numVertices; v++)
+    {
+        float* vertex = src + v * nSkinningTestDeformer::SrcWidth;
+        int i;
+        for (i = 0; i < nSkinningTestDeformer::WeightOffset; i++)
+        {
+            vertex[i] = random.Rand(-1.0f, 1.0f);
+        }
+        float* weights = vertex + nSkinningTestDeformer::WeightOffset;
+        float* indices = vertex + nSkinningTestDeformer::JIndexOffset;
+        int numWeights = 1 + random.Next() % 4;
+        float sum = 0.0f;
+        for (i = 0; i < 4; i++)
+        {
+            weights[i] = (i < numWeights) ? random.Rand(0.1f, 1.0f) : 0.0f;
+            indices[i] = float(random.Next() % numJoints);
+            sum += weights[i];
+        }
+        for (i = 0; i < 4; i++)
+        {
+            weights[i] /= sum;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Count the destination vertices which differ from the reference.
+*/
+static int
+CountWrongVertices(const float* ref, const float* dst, int numVertices, int numFloats)
+{
+    int numWrong = 0;
+    int v;
+    for (v = 0; v < numVertices; v++)
+    {
+        const float* r = ref + v * nSkinningTestDeformer::DstWidth;
+        const float* d = dst + v * nSkinningTestDeformer::DstWidth;
+        if (0 != memcmp(r, d, numFloats * sizeof(float)))
+        {
+            numWrong++;
+        }
+    }
+    return numWrong;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numVertices = n_max(1, args.GetIntArg("-vertices", 50000));
+    int numJoints = n_max(1, args.GetIntArg("-joints", 60));
+    int numRepeats = n_max(1, args.GetIntArg("-repeat", 50));
+    int maxWorkers = args.GetIntArg("-workers", nWorkerPool::GetNumProcessors() - 1);
+    maxWorkers = n_max(0, n_min(maxWorkers, int(nJobServer::MaxWorkers)));
+
+    nProfileServer* profileServer = n_new(nProfileServer);
+    nJobServer* jobServer = n_new(nJobServer);
+    nWorkerPool* workerPool = n_new(nWorkerPool);
+
+    nRandom random(1234);
+    nArray<matrix44> matrices;
+    SetupMatrices(matrices, numJoints, random);
+    float* src = n_new_array(float, numVertices * nSkinningTestDeformer::SrcWidth);
+    float* ref = n_new_array(float, numVertices * nSkinningTestDeformer::DstWidth);
+    float* dst = n_new_array(float, numVertices * nSkinningTestDeformer::DstWidth);
+    SetupVertices(src, numVertices, numJoints, random);
+    nSkinningTestDeformer::Layout layout;
+    nSkinningTestDeformer::SetupLayout(layout);
+
+    // the scalar kernel is the reference
+    int dstSize = numVertices * nSkinningTestDeformer::DstWidth * sizeof(float);
+    nSkinningTestDeformer::SkinScalar(layout, &matrices[0], src, ref, numVertices);
+    memset(dst, 0, dstSize);
+    nSkinningTestDeformer::SkinSimd(layout, &matrices[0], src, dst, numVertices);
+    n_test(0 == CountWrongVertices(ref, dst, numVertices, nSkinningTestDeformer::DstWidth));
+
+    // positions only
+    memset(dst, 0, dstSize);
+    nSkinMeshDeformer::SkinPositions(&matrices[0], src, nSkinningTestDeformer::SrcWidth,
+                                     nSkinningTestDeformer::WeightOffset, nSkinningTestDeformer::JIndexOffset,
+                                     dst, nSkinningTestDeformer::DstWidth, numVertices);
+    n_test(0 == CountWrongVertices(ref, dst, numVertices, 3));
+
+    // the worker pool path
+    int numWorkers;
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        workerPool->SetNumWorkers(numWorkers);
+        memset(dst, 0, dstSize);
+        nSkinningTestDeformer::SkinParallel(layout, &matrices[0], src, dst, numVertices);
+        n_test(0 == CountWrongVertices(ref, dst, numVertices, nSkinningTestDeformer::DstWidth));
+    }
+
+    // benchmark
+    nTest::Timer timer;
+    int repeat;
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        nSkinningTestDeformer::SkinScalar(layout, &matrices[0], src, dst, numVertices);
+    }
+    double scalarTime = timer.GetTime() * 1000.0 / numRepeats;
+    timer.Start();
+    for (repeat = 0; repeat < numRepeats; repeat++)
+    {
+        nSkinningTestDeformer::SkinSimd(layout, &matrices[0], src, dst, numVertices);
+    }
+    double simdTime = timer.GetTime() * 1000.0 / numRepeats;
+    #ifndef __NEBULA_SKINNING_SSE__
+    printf("SSE kernel not available, the scalar kernel is measured twice\n");
+    #endif
+    printf("%d vertices, %d joints: scalar %.3f ms, sse %.3f ms, speedup %.2f\n",
+           numVertices, numJoints, scalarTime, simdTime, (simdTime > 0.0) ? scalarTime / simdTime : 0.0);
+    for (numWorkers = 0; numWorkers <= maxWorkers; numWorkers++)
+    {
+        workerPool->SetNumWorkers(numWorkers);
+        timer.Start();
+        for (repeat = 0; repeat < numRepeats; repeat++)
+        {
+            nSkinningTestDeformer::SkinParallel(layout, &matrices[0], src, dst, numVertices);
+        }
+        double parallelTime = timer.GetTime() * 1000.0 / numRepeats;
+        printf("workers %d: %.3f ms, speedup %.2f\n",
+               numWorkers, parallelTime, (parallelTime > 0.0) ? scalarTime / parallelTime : 0.0);
+    }
+
+    n_delete_array(dst);
+    n_delete_array(ref);
+    n_delete_array(src);
+    n_delete(workerPool);
+    n_delete(jobServer);
+    n_delete(profileServer);
+    return nTest::Finish("nskinningtest");
+}
@@ -0,0 +1,426 @@
+//------------------------------------------------------------------------------
+//  nsqlstatementtest.cc
+//
+//  Tests and benchmarks the prepared SQL statements of nSQLite3Database.
+//  The statement test checks the parameter bindings, the column types and
+//  values of the result rows, reusing a statement after Reset() and the
+//  error handling.
+//
+//  The benchmark writes and reads back entity rows like Db::Writer and
+//  Db::Query do with the old and the new path:
+//  - old: every value is converted to text, each row is inserted with
+//    nSqlRow and InsertRow(), the rows are read with an nSqlQuery and
+//    the values are parsed from strings
+//  - new: one prepared INSERT statement, vectors and matrices are bound
+//    as BLOBs of floats, ints as ints, the rows are read with a prepared
+//    SELECT statement and typed column access
+//  Both write all rows in one transaction.
+//
+//  Command line args:
+//  -rows       number of entity rows (default: 50000)
+//  -dir        directory of the database files (default: temp:)
+//
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "kernel/nkernelserver.h"
+#include "kernel/nfileserver2.h"
+#include "kernel/nfile.h"
+#include "sql/nsqlserver.h"
+#include "sql/nsqldatabase.h"
+#include "sql/nsqlquery.h"
+#include "sql/nsqlrow.h"
+#include "sql/nsqlstatement.h"
+#include "mathlib/matrix.h"
+#include "tools/ncmdlineargs.h"
+#include "tests/ntest.h"
+
+nNebulaUsePackage(nnebula);
+
+static const int NumColumns = 11;
+static const char* Columns[NumColumns] =
+{
+    "GUID", "_Type", "_Level", "_Category", "Id", "Transform",
+    "Position", "Color", "Hitpoints", "Speed", "Visible",
+};
+
+//------------------------------------------------------------------------------
+/**
+    The transform of entity i.
+*/
+static matrix44
+EntityTransform(int i)
+{
+    matrix44 m;
+    m.rotate_y(i * 0.001f);
+    m.translate(vector3(i * 0.5f, 1.25f, -i * 0.3f));
+    return m;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check the values of a row read back, the transform is checked by the
+    caller.
+*/
+static bool
+IsEntityValid(const nString& guid, const nString& id, const vector3& pos, const vector4& color, int hitpoints, float speed, bool visible)
+{
+    nString refGuid;
+    refGuid.Format("guid-%08d", hitpoints);
+    nString refId;
+    refId.Format("prop%d", hitpoints % 100);
+    return (guid == refGuid) && (id == refId) &&
+           (pos.y == 2.0f) && (pos.z == 3.0f) && (n_abs(pos.x - hitpoints * 0.1f) <= (hitpoints * 1.0e-6f)) &&
+           (color.isequal(vector4(0.1f, 0.2f, 0.3f, 1.0f), 1.0e-6f)) &&
+           (n_abs(speed - hitpoints * 0.01f) <= 0.01f) && (visible == (0 != (hitpoints & 1)));
+}
+
+//------------------------------------------------------------------------------
+/**
+    Open a new, empty database.
+*/
+static nSqlDatabase*
+OpenDatabase(const nString& filename)
+{
+    nFileServer2::Instance()->DeleteFile(filename);
+    nSqlDatabase* db = nSqlServer::Instance()->NewDatabase(filename);
+    n_assert(db);
+    return db;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Close a database and return the size of its file.
+*/
+static int
+CloseDatabase(nSqlDatabase* db, const nString& filename)
+{
+    db->Release();
+    int size = 0;
+    nFile* file = nFileServer2::Instance()->NewFileObject();
+    if (file->Open(filename, "rb"))
+    {
+        size = file->GetSize();
+        file->Close();
+    }
+    file->Release();
+    nFileServer2::Instance()->DeleteFile(filename);
+    return size;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Check the bindings and column values of prepared statements.
+*/
+static void
+TestStatement(const nString& dir)
+{
+    nString filename = dir + "/nsqlstatementtest.db3";
+    nSqlDatabase* db = OpenDatabase(filename);
+    nArray<nString> columns;
+    columns.Append("Name");
+    columns.Append("Count");
+    columns.Append("Weight");
+    columns.Append("Data");
+    columns.Append("Note");
+    n_test(db->CreateTable("Test", columns, "Name"));
+
+    // insert 3 rows with one statement
+    nSqlStatement* insert = db->CreateStatement("INSERT INTO Test ('Name', 'Count', 'Weight', 'Data', 'Note') VALUES (?, ?, ?, ?, ?)");
+    n_test(insert);
+    n_test(5 == insert->GetNumParameters());
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        nString name;
+        name.Format("row%d", i);
+        float data[4] = { float(i), 0.5f, -1.0f / 3.0f, 1.0e-20f };
+        insert->BindString(0, name);
+        insert->BindInt(1, i * 1000000);
+        insert->BindFloat(2, i + 0.25f);
+        insert->BindBlob(3, data, sizeof(data));
+        if (i == 1)
+        {
+            insert->BindString(4, "it's");
+        }
+        else
+        {
+            insert->BindNull(4);
+        }
+        n_test(nSqlStatement::Done == insert->Step());
+        insert->Reset();
+    }
+    insert->Release();
+    n_test(db->HasRow("Test", "Name", "row2"));
+
+    // read them back, the bindings must have been cleared by Reset()
+    nSqlStatement* select = db->CreateStatement("SELECT Name, Count, Weight, Data, Note FROM Test WHERE Count >= ? ORDER BY Count");
+    n_test(select);
+    n_test(1 == select->GetNumParameters());
+    int pass;
+    for (pass = 0; pass < 2; pass++)
+    {
+        select->BindInt(0, 1);
+        n_test(nSqlStatement::Row == select->Step());
+        n_test(5 == select->GetColumns().Size());
+        n_test(select->GetColumns()[3] == "Data");
+        n_test(nSqlStatement::String == select->GetColumnType(0));
+        n_test(select->GetString(0) == "row1");
+        n_test(1000000 == select->GetInt(1));
+        n_test(1.25f == select->GetFloat(2));
+        n_test(nSqlStatement::Blob == select->GetColumnType(3));
+        int size = 0;
+        const float* data = (const float*) select->GetBlob(3, size);
+        n_test(4 * sizeof(float) == size);
+        n_test((1.0f == data[0]) && (0.5f == data[1]) && (-1.0f / 3.0f == data[2]) && (1.0e-20f == data[3]));
+        n_test(select->GetString(4) == "it's");
+        n_test(nSqlStatement::Row == select->Step());
+        n_test(select->GetString(0) == "row2");
+        n_test(nSqlStatement::Null == select->GetColumnType(4));
+        n_test(select->GetString(4).IsEmpty());
+        n_test(0 == select->GetBlob(4, size));
+        n_test(0 == size);
+        n_test(nSqlStatement::Done == select->Step());
+        select->Reset();
+    }
+    select->Release();
+
+    // errors
+    n_test(0 == db->CreateStatement("SELECT * FROM NoSuchTable", false));
+    nSqlStatement* update = db->CreateStatement("UPDATE Test SET Count = ? WHERE Name = ?");
+    n_test(update);
+    update->BindInt(0, 7);
+    update->BindString(1, "row0");
+    n_test(nSqlStatement::Done == update->Step());
+    update->Release();
+    nSqlStatement* query = db->CreateStatement("SELECT Count FROM Test WHERE Name = 'row0'");
+    n_test(nSqlStatement::Row == query->Step());
+    n_test(7 == query->GetInt(0));
+    query->Release();
+
+    CloseDatabase(db, filename);
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write and read the entity rows with the old text path. Returns the
+    largest difference of a transform element.
+*/
+static float
+RunOldPath(nSqlDatabase* db, int numRows, double& writeTime, double& readTime)
+{
+    nArray<nString> columns;
+    int col;
+    for (col = 0; col < NumColumns; col++)
+    {
+        columns.Append(Columns[col]);
+    }
+    db->CreateTable("_Entities", columns, "GUID");
+
+    nTest::Timer timer;
+    db->BeginTransaction();
+    int i;
+    for (i = 0; i < numRows; i++)
+    {
+        nSqlRow row;
+        nString str;
+        str.Format("guid-%08d", i);
+        row.Set("GUID", str);
+        row.Set("_Type", "INSTANCE");
+        row.Set("_Level", "level0");
+        row.Set("_Category", "Props");
+        str.Format("prop%d", i % 100);
+        row.Set("Id", str);
+        str.SetMatrix44(EntityTransform(i));
+        row.Set("Transform", str);
+        str.SetVector3(vector3(i * 0.1f, 2.0f, 3.0f));
+        row.Set("Position", str);
+        str.SetVector4(vector4(0.1f, 0.2f, 0.3f, 1.0f));
+        row.Set("Color", str);
+        str.SetInt(i);
+        row.Set("Hitpoints", str);
+        str.SetFloat(i * 0.01f);
+        row.Set("Speed", str);
+        str.SetBool(0 != (i & 1));
+        row.Set("Visible", str);
+        db->InsertRow("_Entities", row);
+    }
+    db->EndTransaction();
+    writeTime = timer.GetTime();
+
+    timer.Start();
+    nSqlQuery* query = db->CreateQuery("SELECT * FROM _Entities WHERE (_Type='INSTANCE') AND (_Level='level0')");
+    n_test(query->Execute());
+    int numRead = query->GetNumRows();
+    int numWrong = 0;
+    float maxError = 0.0f;
+    for (i = 0; i < numRead; i++)
+    {
+        nSqlRow row = query->GetRow(i);
+        nString guid = row.Get("GUID");
+        nString id = row.Get("Id");
+        matrix44 m = row.Get("Transform").AsMatrix44();
+        vector3 pos = row.Get("Position").AsVector3();
+        vector4 color = row.Get("Color").AsVector4();
+        int hitpoints = row.Get("Hitpoints").AsInt();
+        float speed = row.Get("Speed").AsFloat();
+        bool visible = row.Get("Visible").AsBool();
+        matrix44 ref = EntityTransform(hitpoints);
+        int k;
+        for (k = 0; k < 16; k++)
+        {
+            maxError = n_max(maxError, n_abs(ref.m[k / 4][k % 4] - m.m[k / 4][k % 4]));
+        }
+        if (!IsEntityValid(guid, id, pos, color, hitpoints, speed, visible))
+        {
+            numWrong++;
+        }
+    }
+    query->Release();
+    readTime = timer.GetTime();
+    n_test(numRows == numRead);
+    n_test(0 == numWrong);
+    return maxError;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Write and read the entity rows with prepared statements and the
+    binding scheme of Db::Writer and Db::Query. Returns the largest
+    difference of a transform element.
+*/
+static float
+RunNewPath(nSqlDatabase* db, int numRows, double& writeTime, double& readTime)
+{
+    nArray<nString> columns;
+    int col;
+    for (col = 0; col < NumColumns; col++)
+    {
+        columns.Append(Columns[col]);
+    }
+    db->CreateTable("_Entities", columns, "GUID");
+
+    nTest::Timer timer;
+    db->BeginTransaction();
+    nString sql("INSERT INTO _Entities ('");
+    sql.Append(nString::Concatenate(columns, "', '"));
+    sql.Append("') VALUES (?");
+    for (col = 1; col < NumColumns; col++)
+    {
+        sql.Append(", ?");
+    }
+    sql.Append(")");
+    nSqlStatement* insert = db->CreateStatement(sql);
+    int i;
+    for (i = 0; i < numRows; i++)
+    {
+        nString str;
+        str.Format("guid-%08d", i);
+        insert->BindString(0, str);
+        insert->BindString(1, "INSTANCE");
+        insert->BindString(2, "level0");
+        insert->BindString(3, "Props");
+        str.Format("prop%d", i % 100);
+        insert->BindString(4, str);
+        matrix44 m = EntityTransform(i);
+        float transform[16];
+        memcpy(transform, m.m, sizeof(transform));
+        insert->BindBlob(5, transform, sizeof(transform));
+        float pos[3] = { i * 0.1f, 2.0f, 3.0f };
+        insert->BindBlob(6, pos, sizeof(pos));
+        float color[4] = { 0.1f, 0.2f, 0.3f, 1.0f };
+        insert->BindBlob(7, color, sizeof(color));
+        insert->BindInt(8, i);
+        str.SetFloat(i * 0.01f);
+        insert->BindString(9, str);
+        str.SetBool(0 != (i & 1));
+        insert->BindString(10, str);
+        insert->Step();
+        insert->Reset();
+    }
+    insert->Release();
+    db->EndTransaction();
+    writeTime = timer.GetTime();
+
+    timer.Start();
+    nSqlStatement* select = db->CreateStatement("SELECT * FROM _Entities WHERE (_Type=?) AND (_Level=?)");
+    select->BindString(0, "INSTANCE");
+    select->BindString(1, "level0");
+    int numRead = 0;
+    int numWrong = 0;
+    float maxError = 0.0f;
+    while (nSqlStatement::Row == select->Step())
+    {
+        nString guid = select->GetString(0);
+        nString id = select->GetString(4);
+        int size = 0;
+        matrix44 m;
+        const float* transform = (const float*) select->GetBlob(5, size);
+        if (sizeof(m.m) == size)
+        {
+            memcpy(m.m, transform, sizeof(m.m));
+        }
+        const float* pos = (const float*) select->GetBlob(6, size);
+        vector3 position(pos[0], pos[1], pos[2]);
+        const float* color = (const float*) select->GetBlob(7, size);
+        vector4 col4(color[0], color[1], color[2], color[3]);
+        int hitpoints = select->GetInt(8);
+        float speed = select->GetFloat(9);
+        bool visible = select->GetString(10).AsBool();
+        matrix44 ref = EntityTransform(hitpoints);
+        int k;
+        for (k = 0; k < 16; k++)
+        {
+            maxError = n_max(maxError, n_abs(ref.m[k / 4][k % 4] - m.m[k / 4][k % 4]));
+        }
+        if (!IsEntityValid(guid, id, position, col4, hitpoints, speed, visible))
+        {
+            numWrong++;
+        }
+        numRead++;
+    }
+    select->Release();
+    readTime = timer.GetTime();
+    n_test(numRows == numRead);
+    n_test(0 == numWrong);
+    return maxError;
+}
+
+//------------------------------------------------------------------------------
+/**
+*/
+int
+main(int argc, const char** argv)
+{
+    nCmdLineArgs args(argc, argv);
+    int numRows = n_max(1, args.GetIntArg("-rows", 50000));
+    nString dir = args.GetStringArg("-dir", "temp:");
+
+    nKernelServer kernelServer;
+    kernelServer.AddPackage(nnebula);
+    kernelServer.New("nresourceserver", "/sys/servers/resource");
+    kernelServer.New("nsqlite3server", "/sys/servers/sql");
+
+    TestStatement(dir);
+
+    double oldWrite = 0.0;
+    double oldRead = 0.0;
+    nString oldFile = dir + "/nsqlstatementtest_old.db3";
+    nSqlDatabase* oldDb = OpenDatabase(oldFile);
+    float oldError = RunOldPath(oldDb, numRows, oldWrite, oldRead);
+    int oldSize = CloseDatabase(oldDb, oldFile);
+
+    double newWrite = 0.0;
+    double newRead = 0.0;
+    nString newFile = dir + "/nsqlstatementtest_new.db3";
+    nSqlDatabase* newDb = OpenDatabase(newFile);
+    float newError = RunNewPath(newDb, numRows, newWrite, newRead);
+    int newSize = CloseDatabase(newDb, newFile);
+
+    // the BLOBs store the exact floats
+    n_test(0.0f == newError);
+    printf("%d rows, old path: write %.0f ms, read %.0f ms, db %d KB, transform error %g\n",
+        numRows, oldWrite * 1000.0, oldRead * 1000.0, oldSize / 1024, oldError);
+    printf("%d rows, new path: write %.0f ms, read %.0f ms, db %d KB, transform error %g\n",
+        numRows, newWrite * 1000.0, newRead * 1000.0, newSize / 1024, newError);
+    return nTest::Finish("nsqlstatementtest");
+}
@@ -10,12 +10,131 @@
         input anim file (nanim2 or nax2 file)
     @par -out
         output anim file (nanim2 or nax2 file)
+    @par -report
+        print the size of each group before and after key packing (as
+        done by nMemoryAnimation at load time) and the maximum error
+        introduced by the packing
 
     (C) 2003 RadonLabs GmbH
 */
 #include "kernel/nkernelserver.h"
 #include "tools/ncmdlineargs.h"
 #include "tools/nanimbuilder.h"
+#include "anim2/npackedanimgroup.h"
+
+//------------------------------------------------------------------------------
+/**
+    Convert an nAnimBuilder interpolation type into the nAnimation one.
+*/
+static nAnimation::Curve::IpolType
+ConvertIpolType(nAnimBuilder::Curve::IpolType ipolType)
+{
+    switch (ipolType)
+    {
+        case nAnimBuilder::Curve::STEP:     return nAnimation::Curve::Step;
+        case nAnimBuilder::Curve::LINEAR:   return nAnimation::Curve::Linear;
+        case nAnimBuilder::Curve::QUAT:     return nAnimation::Curve::Quat;
+        default:                            return nAnimation::Curve::None;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Pack every group the same way nMemoryAnimation does at load time,
+    and print the key data size before and after packing, the maximum
+    angular error of quaternion curves in degrees and the maximum
+    absolute error of all other curves.
+*/
+static void
+PrintPackReport(nAnimBuilder& anim)
+{
+    n_printf("group  curves   keys   raw bytes  packed bytes  ratio  max angle  max error\n");
+    int totalRawBytes = 0;
+    int totalPackedBytes = 0;
+    float totalMaxAngle = 0.0f;
+    float totalMaxError = 0.0f;
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < anim.GetNumGroups(); groupIndex++)
+    {
+        nAnimBuilder::Group& group = anim.GetGroupAt(groupIndex);
+        int numCurves = group.GetNumCurves();
+        int numKeys = group.GetNumKeys();
+
+        // gather the keys of each curve and pack the group
+        nArray<vector4> keys;
+        keys.SetFixedSize(n_max(1, numCurves * numKeys));
+        nPackedAnimGroup packedGroup;
+        packedGroup.Begin(numCurves, numKeys);
+        int rawBytes = 0;
+        int curveIndex;
+        for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+        {
+            nAnimBuilder::Curve& curve = group.GetCurveAt(curveIndex);
+            if (curve.IsCollapsed() || (0 == numKeys))
+            {
+                packedGroup.SetConstCurve(curveIndex, curve.GetCollapsedKey());
+            }
+            else
+            {
+                n_assert(curve.GetNumKeys() == numKeys);
+                int keyIndex;
+                for (keyIndex = 0; keyIndex < numKeys; keyIndex++)
+                {
+                    keys[curveIndex * numKeys + keyIndex] = curve.GetKeyAt(keyIndex).Get();
+                }
+                packedGroup.SetCurve(curveIndex, ConvertIpolType(curve.GetIpolType()), &(keys[curveIndex * numKeys]), 1);
+                rawBytes += numKeys * sizeof(vector4);
+            }
+        }
+        packedGroup.End();
+
+        // measure the error of the decoded keys
+        float maxAngle = 0.0f;
+        float maxError = 0.0f;
+        for (curveIndex = 0; curveIndex < numCurves; curveIndex++)
+        {
+            nAnimBuilder::Curve& curve = group.GetCurveAt(curveIndex);
+            if (curve.IsCollapsed() || (0 == numKeys))
+            {
+                continue;
+            }
+            int keyIndex;
+            for (keyIndex = 0; keyIndex < numKeys; keyIndex++)
+            {
+                const vector4& src = keys[curveIndex * numKeys + keyIndex];
+                vector4 dst;
+                packedGroup.GetKey(curveIndex, keyIndex, dst);
+                if (nAnimBuilder::Curve::QUAT == curve.GetIpolType())
+                {
+                    float len = n_sqrt(src.x * src.x + src.y * src.y + src.z * src.z + src.w * src.w);
+                    if (len > 0.0f)
+                    {
+                        float dot = (src.x * dst.x + src.y * dst.y + src.z * dst.z + src.w * dst.w) / len;
+                        float angle = n_rad2deg(2.0f * n_acos(n_abs(dot)));
+                        maxAngle = n_max(maxAngle, angle);
+                    }
+                }
+                else
+                {
+                    vector4 diff = dst - src;
+                    maxError = n_max(maxError, n_max(n_max(n_abs(diff.x), n_abs(diff.y)), n_max(n_abs(diff.z), n_abs(diff.w))));
+                }
+            }
+        }
+
+        int packedBytes = packedGroup.GetByteSize();
+        float ratio = (packedBytes > 0) ? float(rawBytes) / float(packedBytes) : 0.0f;
+        n_printf("%5d  %6d  %5d  %10d  %12d  %5.2f  %9.5f  %9.6f\n",
+            groupIndex, numCurves, numKeys, rawBytes, packedBytes, ratio, maxAngle, maxError);
+        totalRawBytes += rawBytes;
+        totalPackedBytes += packedBytes;
+        totalMaxAngle = n_max(totalMaxAngle, maxAngle);
+        totalMaxError = n_max(totalMaxError, maxError);
+    }
+    float totalRatio = (totalPackedBytes > 0) ? float(totalRawBytes) / float(totalPackedBytes) : 0.0f;
+    n_printf("total                %10d  %12d  %5.2f  %9.5f  %9.6f\n",
+        totalRawBytes, totalPackedBytes, totalRatio, totalMaxAngle, totalMaxError);
+}
 
 //------------------------------------------------------------------------------
 int
@@ -29,6 +148,7 @@ main(int argc, const char** argv)
     bool helpArg               = args.GetBoolArg("-help");
     nString inFileArg          = args.GetStringArg("-in");
     nString outFileArg         = args.GetStringArg("-out");
+    bool reportArg             = args.GetBoolArg("-report");
 
     // show help?
     if (helpArg)
@@ -39,7 +159,8 @@ main(int argc, const char** argv)
             "------------------\n"
             "-help                 show this help\n"
             "-in [filename]        input anim file (.nanim2 or .nax2 extension)\n"
-            "-out [filename]       output anim file (.nanim2 or .nax2 extension)\n");
+            "-out [filename]       output anim file (.nanim2 or .nax2 extension)\n"
+            "-report               print key packing sizes and errors per group\n");
         return 5;
     }
 
@@ -62,6 +183,12 @@ main(int argc, const char** argv)
         return 5;
     }
 
+    // print key packing report
+    if (reportArg)
+    {
+        PrintPackReport(anim);
+    }
+
     // save output anim
     if (outFileArg.IsValid())
     {
@@ -680,54 +680,37 @@ nMeshBuilder::Cleanup(nArray< nArray<int> >* collapseMap)
 
 //------------------------------------------------------------------------------
 /**
-    qsort() hook for PackTrianglesByGroup().
+    qsort() hook for SortTriangles(), sorts triangle indices. Triangles
+    with identical group id, material id and usage flags keep their
+    relative order, so that the order computed by Optimize() survives.
 */
 int
 __cdecl
 nMeshBuilder::TriangleGroupSorter(const void* elm0, const void* elm1)
 {
-    Triangle* t0 = (Triangle*) elm0;
-    Triangle* t1 = (Triangle*) elm1;
-    int groupDiff = t0->GetGroupId() - t1->GetGroupId();
+    nMeshBuilder* meshBuilder = qsortData;
+    int i0 = *(int*)elm0;
+    int i1 = *(int*)elm1;
+    const Triangle& t0 = meshBuilder->GetTriangleAt(i0);
+    const Triangle& t1 = meshBuilder->GetTriangleAt(i1);
+    int groupDiff = t0.GetGroupId() - t1.GetGroupId();
     if (0 != groupDiff)
     {
         return groupDiff;
     }
-    int materialDiff = t0->GetMaterialId() - t1->GetMaterialId();
+    int materialDiff = t0.GetMaterialId() - t1.GetMaterialId();
     if (0 != materialDiff)
     {
         return materialDiff;
     }
-    int usageDiff = t0->GetUsageFlags() - t1->GetUsageFlags();
+    int usageDiff = t0.GetUsageFlags() - t1.GetUsageFlags();
     if (0 != usageDiff)
     {
         return usageDiff;
     }
 
     // make the sort order definitive
-    int t0i0, t0i1, t0i2, t1i0, t1i1, t1i2;
-    t0->GetVertexIndices(t0i0, t0i1, t0i2);
-    t1->GetVertexIndices(t1i0, t1i1, t1i2);
-
-    if (t0i0 < t1i0)        return -1;
-    else if (t0i0 > t1i0)   return +1;
-    else
-    {
-        if (t0i1 < t1i1)        return -1;
-        else if (t0i1 > t1i1)   return +1;
-        else
-        {
-            if (t0i2 < t1i2)        return -1;
-            else if (t0i2 > t1i2)   return +1;
-        }
-    }
-
-    // FIXME: For some reason it can happen that 2 triangles
-    // with identical indices are exported. Make sure we
-    // still get a definitive sorting order.
-    // (however, duplicate triangles should not be generated
-    // in the first place).
-    return (t1 - t0);
+    return i0 - i1;
 }
 
 //------------------------------------------------------------------------------
@@ -737,18 +720,29 @@ nMeshBuilder::TriangleGroupSorter(const void* elm0, const void* elm1)
 void
 nMeshBuilder::SortTriangles()
 {
-    // first, sort triangles by their group id
-    qsort(&(this->triangleArray[0]), this->triangleArray.Size(), sizeof(Triangle), nMeshBuilder::TriangleGroupSorter);
-}
+    int numTriangles = this->triangleArray.Size();
+    if (0 == numTriangles)
+    {
+        return;
+    }
 
-//------------------------------------------------------------------------------
-/**
-    Optimize mesh for better HT&L cache locality.
-*/
-void
-nMeshBuilder::Optimize()
-{
-    // TODO!
+    // sort an index array, and reorder the triangles from it
+    int* sortMap = n_new_array(int, numTriangles);
+    int i;
+    for (i = 0; i < numTriangles; i++)
+    {
+        sortMap[i] = i;
+    }
+    qsortData = this;
+    qsort(sortMap, numTriangles, sizeof(int), nMeshBuilder::TriangleGroupSorter);
+
+    nArray<Triangle> newArray(numTriangles, numTriangles);
+    for (i = 0; i < numTriangles; i++)
+    {
+        newArray.Append(this->triangleArray[sortMap[i]]);
+    }
+    this->triangleArray = newArray;
+    n_delete_array(sortMap);
 }
 
 //------------------------------------------------------------------------------
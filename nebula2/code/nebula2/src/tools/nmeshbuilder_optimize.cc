@@ -0,0 +1,572 @@
+//------------------------------------------------------------------------------
+//  nmeshbuilder_optimize.cc
+//  (C) 2006 Nebula2 Community
+//------------------------------------------------------------------------------
+#include "tools/nmeshbuilder.h"
+
+//------------------------------------------------------------------------------
+/**
+    A cluster of consecutive triangles, used by SortTriangleClusters().
+*/
+struct nMeshCluster
+{
+    int firstTriangle;
+    int numTriangles;
+    float sortKey;
+};
+
+//------------------------------------------------------------------------------
+/**
+    qsort() hook for SortTriangleClusters(), sorts by descending sort key,
+    clusters with identical keys keep their order.
+*/
+static
+int
+__cdecl
+n_meshclustersorter(const void* elm0, const void* elm1)
+{
+    const nMeshCluster* c0 = (const nMeshCluster*) elm0;
+    const nMeshCluster* c1 = (const nMeshCluster*) elm1;
+    if (c0->sortKey > c1->sortKey)      return -1;
+    else if (c0->sortKey < c1->sortKey) return +1;
+    return c0->firstTriangle - c1->firstTriangle;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the score of a vertex for the vertex cache optimizer from its
+    position in the simulated LRU cache and the number of triangles which
+    still use the vertex.
+*/
+static
+float
+n_vertexcachescore(int cachePos, int numActiveTris, int cacheSize)
+{
+    if (0 == numActiveTris)
+    {
+        // no triangle needs this vertex anymore
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePos >= 0)
+    {
+        if (cachePos < 3)
+        {
+            // the vertices of the last triangle get a fixed score, so
+            // that strips are not preferred over fans
+            score = 0.75f;
+        }
+        else
+        {
+            float s = 1.0f - float(cachePos - 3) / float(cacheSize - 3);
+            score = powf(s, 1.5f);
+        }
+    }
+
+    // boost vertices with few remaining triangles, to get rid of them
+    score += 2.0f / sqrtf(float(numActiveTris));
+    return score;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Optimize the mesh for the post-transform vertex cache. The triangles
+    of each group are reordered, then the vertices are reordered to the
+    order in which the triangles reference them, so that vertex fetches
+    are linear as well. If sortClusters is true, clusters of triangles are
+    sorted so that triangles which are likely to occlude others are
+    rendered first. A group keeps its original order if the new order
+    misses a simulated FIFO cache of ClusterCacheSize or OptimizeCacheSize
+    entries more often, so an already well ordered group never gets worse.
+    Group ranges don't change, edges are rebuilt if the mesh had edges.
+*/
+void
+nMeshBuilder::Optimize(bool sortClusters)
+{
+    if (0 == this->GetNumTriangles())
+    {
+        return;
+    }
+
+    // edges reference triangle and vertex indices, throw them away
+    bool hasEdges = (this->GetNumEdges() > 0);
+    this->edgeArray.Clear();
+
+    this->SortTriangles();
+    nArray<Group> groupMap;
+    this->BuildGroupMap(groupMap);
+
+    nArray<int> vertexMap(0, 0);
+    vertexMap.SetFixedSize(this->GetNumVertices());
+    vertexMap.Fill(0, vertexMap.Size(), -1);
+    int groupIndex;
+    for (groupIndex = 0; groupIndex < groupMap.Size(); groupIndex++)
+    {
+        const Group& group = groupMap[groupIndex];
+        int firstTriangle = group.GetFirstTriangle();
+        int numTriangles = group.GetNumTriangles();
+        float oldAcmr[2], newAcmr[2], atvr;
+        this->ComputeVertexCacheStats(firstTriangle, numTriangles, ClusterCacheSize, oldAcmr[0], atvr);
+        this->ComputeVertexCacheStats(firstTriangle, numTriangles, OptimizeCacheSize, oldAcmr[1], atvr);
+        nArray<Triangle> oldTriangles(numTriangles, 0);
+        int triIndex;
+        for (triIndex = 0; triIndex < numTriangles; triIndex++)
+        {
+            oldTriangles.Append(this->GetTriangleAt(firstTriangle + triIndex));
+        }
+
+        this->OptimizeTriangleOrder(firstTriangle, numTriangles, vertexMap);
+        if (sortClusters)
+        {
+            this->SortTriangleClusters(firstTriangle, numTriangles);
+        }
+
+        this->ComputeVertexCacheStats(firstTriangle, numTriangles, ClusterCacheSize, newAcmr[0], atvr);
+        this->ComputeVertexCacheStats(firstTriangle, numTriangles, OptimizeCacheSize, newAcmr[1], atvr);
+        if ((newAcmr[0] > oldAcmr[0]) || (newAcmr[1] > oldAcmr[1]))
+        {
+            for (triIndex = 0; triIndex < numTriangles; triIndex++)
+            {
+                this->triangleArray[firstTriangle + triIndex] = oldTriangles[triIndex];
+            }
+        }
+    }
+    this->OptimizeVertexOrder();
+
+    if (hasEdges)
+    {
+        this->CreateEdges();
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Reorder a range of triangles for the post-transform vertex cache, using
+    Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". A LRU cache is
+    simulated, the next triangle is always the one with the highest score
+    among the triangles of the cached vertices.
+
+    The vertexMap maps the mesh vertex indices to indices local to the
+    triangle range, it must be filled with -1 and will be left that way.
+*/
+void
+nMeshBuilder::OptimizeTriangleOrder(int firstTriangle, int numTriangles, nArray<int>& vertexMap)
+{
+    n_assert((firstTriangle + numTriangles) <= this->GetNumTriangles());
+    if (numTriangles < 2)
+    {
+        return;
+    }
+
+    // map the vertices to local indices
+    nArray<int> localVertices(numTriangles, numTriangles);
+    nArray<int> triVertices(0, 0);
+    triVertices.SetFixedSize(numTriangles * 3);
+    int triIndex;
+    int i;
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        const Triangle& tri = this->GetTriangleAt(firstTriangle + triIndex);
+        for (i = 0; i < 3; i++)
+        {
+            int vertexIndex = tri.vertexIndex[i];
+            if (-1 == vertexMap[vertexIndex])
+            {
+                vertexMap[vertexIndex] = localVertices.Size();
+                localVertices.Append(vertexIndex);
+            }
+            triVertices[triIndex * 3 + i] = vertexMap[vertexIndex];
+        }
+    }
+    int numVertices = localVertices.Size();
+    for (i = 0; i < numVertices; i++)
+    {
+        vertexMap[localVertices[i]] = -1;
+    }
+
+    // build the vertex-triangle adjacency, the first numActiveTris entries
+    // of a vertex's triangle list are the triangles not yet added
+    nArray<int> numActiveTris(0, 0);
+    nArray<int> triListOffset(0, 0);
+    nArray<int> triList(0, 0);
+    nArray<int> cachePos(0, 0);
+    nArray<float> vertexScore(0, 0);
+    numActiveTris.SetFixedSize(numVertices);
+    triListOffset.SetFixedSize(numVertices);
+    triList.SetFixedSize(numTriangles * 3);
+    cachePos.SetFixedSize(numVertices);
+    vertexScore.SetFixedSize(numVertices);
+    numActiveTris.Fill(0, numVertices, 0);
+    cachePos.Fill(0, numVertices, -1);
+    for (i = 0; i < numTriangles * 3; i++)
+    {
+        numActiveTris[triVertices[i]]++;
+    }
+    int offset = 0;
+    for (i = 0; i < numVertices; i++)
+    {
+        triListOffset[i] = offset;
+        offset += numActiveTris[i];
+        numActiveTris[i] = 0;
+    }
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            int v = triVertices[triIndex * 3 + i];
+            triList[triListOffset[v] + numActiveTris[v]++] = triIndex;
+        }
+    }
+    for (i = 0; i < numVertices; i++)
+    {
+        vertexScore[i] = n_vertexcachescore(-1, numActiveTris[i], OptimizeCacheSize);
+    }
+
+    // initial triangle scores
+    nArray<float> triScore(0, 0);
+    nArray<bool> triAdded(0, 0);
+    triScore.SetFixedSize(numTriangles);
+    triAdded.SetFixedSize(numTriangles);
+    triAdded.Fill(0, numTriangles, false);
+    int bestTri = 0;
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        const int* v = &(triVertices[triIndex * 3]);
+        triScore[triIndex] = vertexScore[v[0]] + vertexScore[v[1]] + vertexScore[v[2]];
+        if (triScore[triIndex] > triScore[bestTri])
+        {
+            bestTri = triIndex;
+        }
+    }
+
+    // add triangles one by one
+    int cache[OptimizeCacheSize + 3];
+    int newCache[OptimizeCacheSize + 3];
+    int cacheSize = 0;
+    int cursor = 0;
+    nArray<Triangle> newTriangles(numTriangles, 0);
+    while (newTriangles.Size() < numTriangles)
+    {
+        if (-1 == bestTri)
+        {
+            // no candidate in the cache, continue with the next triangle
+            // in the original order
+            while (triAdded[cursor])
+            {
+                cursor++;
+            }
+            bestTri = cursor;
+        }
+        newTriangles.Append(this->GetTriangleAt(firstTriangle + bestTri));
+        triAdded[bestTri] = true;
+
+        // remove the triangle from the active triangle lists of its vertices,
+        // and put its vertices to the front of the cache
+        const int* triVerts = &(triVertices[bestTri * 3]);
+        int newCacheSize = 0;
+        for (i = 0; i < 3; i++)
+        {
+            int v = triVerts[i];
+            int* tris = &(triList[triListOffset[v]]);
+            int j;
+            for (j = 0; j < numActiveTris[v]; j++)
+            {
+                if (tris[j] == bestTri)
+                {
+                    tris[j] = tris[--numActiveTris[v]];
+                    break;
+                }
+            }
+            newCache[newCacheSize++] = v;
+        }
+        for (i = 0; i < cacheSize; i++)
+        {
+            int v = cache[i];
+            if ((v != triVerts[0]) && (v != triVerts[1]) && (v != triVerts[2]))
+            {
+                newCache[newCacheSize++] = v;
+            }
+        }
+
+        // update the cache positions and scores, vertices pushed out of
+        // the cache are scored one last time
+        cacheSize = n_min(newCacheSize, int(OptimizeCacheSize));
+        for (i = 0; i < newCacheSize; i++)
+        {
+            int v = newCache[i];
+            cachePos[v] = (i < cacheSize) ? i : -1;
+            vertexScore[v] = n_vertexcachescore(cachePos[v], numActiveTris[v], OptimizeCacheSize);
+            if (i < cacheSize)
+            {
+                cache[i] = v;
+            }
+        }
+
+        // update the triangle scores, and find the best candidate
+        bestTri = -1;
+        float bestScore = -1.0f;
+        for (i = 0; i < newCacheSize; i++)
+        {
+            int v = newCache[i];
+            const int* tris = &(triList[triListOffset[v]]);
+            int j;
+            for (j = 0; j < numActiveTris[v]; j++)
+            {
+                int t = tris[j];
+                const int* tv = &(triVertices[t * 3]);
+                float score = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+                triScore[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTri = t;
+                }
+            }
+        }
+    }
+
+    // write back the new triangle order
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        this->triangleArray[firstTriangle + triIndex] = newTriangles[triIndex];
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Sort the clusters of a triangle range to reduce overdraw. The range is
+    split into clusters where the simulated FIFO cache misses all 3
+    vertices of a triangle, so that the cache efficiency is hardly affected
+    by reordering the clusters. Clusters which face away from the center
+    of the range are likely to occlude other clusters, they are sorted to
+    the front.
+*/
+void
+nMeshBuilder::SortTriangleClusters(int firstTriangle, int numTriangles)
+{
+    n_assert((firstTriangle + numTriangles) <= this->GetNumTriangles());
+    if (numTriangles < 2)
+    {
+        return;
+    }
+
+    // compute the area weighted center of the triangle range
+    vector3 center;
+    float area = 0.0f;
+    int triIndex;
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        const Triangle& tri = this->GetTriangleAt(firstTriangle + triIndex);
+        const vector3& v0 = this->GetVertexAt(tri.vertexIndex[0]).GetCoord();
+        const vector3& v1 = this->GetVertexAt(tri.vertexIndex[1]).GetCoord();
+        const vector3& v2 = this->GetVertexAt(tri.vertexIndex[2]).GetCoord();
+        float triArea = ((v1 - v0) * (v2 - v0)).len();
+        center += (v0 + v1 + v2) * triArea;
+        area += triArea * 3.0f;
+    }
+    if (area > 0.0f)
+    {
+        center *= 1.0f / area;
+    }
+
+    // split into clusters at hard cache boundaries
+    nArray<nMeshCluster> clusters(64, 64);
+    int cache[ClusterCacheSize];
+    int cacheHead = 0;
+    int i;
+    for (i = 0; i < ClusterCacheSize; i++)
+    {
+        cache[i] = -1;
+    }
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        const Triangle& tri = this->GetTriangleAt(firstTriangle + triIndex);
+        int numMisses = 0;
+        for (i = 0; i < 3; i++)
+        {
+            int j;
+            for (j = 0; j < ClusterCacheSize; j++)
+            {
+                if (cache[j] == tri.vertexIndex[i])
+                {
+                    break;
+                }
+            }
+            if (ClusterCacheSize == j)
+            {
+                cache[cacheHead] = tri.vertexIndex[i];
+                cacheHead = (cacheHead + 1) % ClusterCacheSize;
+                numMisses++;
+            }
+        }
+        if ((3 == numMisses) || (0 == triIndex))
+        {
+            nMeshCluster cluster;
+            cluster.firstTriangle = triIndex;
+            cluster.numTriangles = 0;
+            cluster.sortKey = 0.0f;
+            clusters.Append(cluster);
+        }
+        clusters.Back().numTriangles++;
+    }
+    if (clusters.Size() < 2)
+    {
+        return;
+    }
+
+    // the sort key of a cluster is the distance of its center from the
+    // center of the triangle range along the cluster's average normal
+    int clusterIndex;
+    for (clusterIndex = 0; clusterIndex < clusters.Size(); clusterIndex++)
+    {
+        nMeshCluster& cluster = clusters[clusterIndex];
+        vector3 clusterCenter;
+        vector3 clusterNormal;
+        float clusterArea = 0.0f;
+        for (triIndex = cluster.firstTriangle; triIndex < (cluster.firstTriangle + cluster.numTriangles); triIndex++)
+        {
+            const Triangle& tri = this->GetTriangleAt(firstTriangle + triIndex);
+            const vector3& v0 = this->GetVertexAt(tri.vertexIndex[0]).GetCoord();
+            const vector3& v1 = this->GetVertexAt(tri.vertexIndex[1]).GetCoord();
+            const vector3& v2 = this->GetVertexAt(tri.vertexIndex[2]).GetCoord();
+            vector3 n = (v1 - v0) * (v2 - v0);
+            float triArea = n.len();
+            clusterNormal += n;
+            clusterCenter += (v0 + v1 + v2) * triArea;
+            clusterArea += triArea * 3.0f;
+        }
+        if ((clusterArea > 0.0f) && (clusterNormal.len() > 0.0f))
+        {
+            clusterCenter *= 1.0f / clusterArea;
+            clusterNormal.norm();
+            cluster.sortKey = (clusterCenter - center) % clusterNormal;
+        }
+    }
+    qsort(&(clusters[0]), clusters.Size(), sizeof(nMeshCluster), n_meshclustersorter);
+
+    // write back the triangles in cluster order
+    nArray<Triangle> newTriangles(numTriangles, 0);
+    for (clusterIndex = 0; clusterIndex < clusters.Size(); clusterIndex++)
+    {
+        const nMeshCluster& cluster = clusters[clusterIndex];
+        for (triIndex = cluster.firstTriangle; triIndex < (cluster.firstTriangle + cluster.numTriangles); triIndex++)
+        {
+            newTriangles.Append(this->GetTriangleAt(firstTriangle + triIndex));
+        }
+    }
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        this->triangleArray[firstTriangle + triIndex] = newTriangles[triIndex];
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Reorder the vertices into the order in which they are first referenced
+    by the triangles. Unreferenced vertices are moved to the end.
+*/
+void
+nMeshBuilder::OptimizeVertexOrder()
+{
+    int numVertices = this->GetNumVertices();
+    nArray<int> indexMap(0, 0);
+    indexMap.SetFixedSize(numVertices);
+    indexMap.Fill(0, numVertices, -1);
+    int nextIndex = 0;
+    int numTriangles = this->GetNumTriangles();
+    int triIndex;
+    int i;
+    for (triIndex = 0; triIndex < numTriangles; triIndex++)
+    {
+        Triangle& tri = this->GetTriangleAt(triIndex);
+        for (i = 0; i < 3; i++)
+        {
+            int& newIndex = indexMap[tri.vertexIndex[i]];
+            if (-1 == newIndex)
+            {
+                newIndex = nextIndex++;
+            }
+            tri.vertexIndex[i] = newIndex;
+        }
+    }
+    for (i = 0; i < numVertices; i++)
+    {
+        if (-1 == indexMap[i])
+        {
+            indexMap[i] = nextIndex++;
+        }
+    }
+
+    nArray<Vertex> newArray(numVertices, numVertices);
+    newArray.SetFixedSize(numVertices);
+    for (i = 0; i < numVertices; i++)
+    {
+        newArray[indexMap[i]] = this->vertexArray[i];
+    }
+    this->vertexArray = newArray;
+}
+
+//------------------------------------------------------------------------------
+/**
+    Compute the efficiency of a range of triangles for a FIFO vertex cache
+    of the given size.
+
+    @param  firstTriangle   [in] first triangle of the range
+    @param  numTriangles    [in] number of triangles in the range
+    @param  cacheSize       [in] number of entries of the simulated cache
+    @param  acmr            [out] average cache miss ratio, transformed vertices per triangle
+    @param  atvr            [out] average transform to vertex ratio, 1.0 is optimal
+*/
+void
+nMeshBuilder::ComputeVertexCacheStats(int firstTriangle, int numTriangles, int cacheSize, float& acmr, float& atvr) const
+{
+    n_assert((firstTriangle + numTriangles) <= this->GetNumTriangles());
+    n_assert(cacheSize > 0);
+    acmr = 0.0f;
+    atvr = 0.0f;
+    if (0 == numTriangles)
+    {
+        return;
+    }
+
+    nArray<int> cache(0, 0);
+    cache.SetFixedSize(cacheSize);
+    cache.Fill(0, cacheSize, -1);
+    nArray<bool> used(0, 0);
+    used.SetFixedSize(this->GetNumVertices());
+    used.Fill(0, used.Size(), false);
+    int cacheHead = 0;
+    int numMisses = 0;
+    int numUsed = 0;
+    int triIndex;
+    for (triIndex = firstTriangle; triIndex < (firstTriangle + numTriangles); triIndex++)
+    {
+        const Triangle& tri = this->GetTriangleAt(triIndex);
+        int i;
+        for (i = 0; i < 3; i++)
+        {
+            int vertexIndex = tri.vertexIndex[i];
+            if (!used[vertexIndex])
+            {
+                used[vertexIndex] = true;
+                numUsed++;
+            }
+            int j;
+            for (j = 0; j < cacheSize; j++)
+            {
+                if (cache[j] == vertexIndex)
+                {
+                    break;
+                }
+            }
+            if (cacheSize == j)
+            {
+                cache[cacheHead] = vertexIndex;
+                cacheHead = (cacheHead + 1) % cacheSize;
+                numMisses++;
+            }
+        }
+    }
+    acmr = float(numMisses) / float(numTriangles);
+    atvr = float(numMisses) / float(numUsed);
+}
@@ -18,6 +18,12 @@
        generate tangents
      @par -tangentsplit
        generate tangents using an alternative technique that may split vertices
+     @par -optimize
+       optimize the triangle and vertex order for the vertex cache
+     @par -overdraw
+       like -optimize, additionally sort triangle clusters to reduce overdraw
+     @par -cachesize
+       vertex cache size used for the -optimize statistics (default 16)
      @par -edge
        generate edges
      @par -append
@@ -71,6 +77,9 @@ main(int argc, const char** argv)
     bool tangentNoSplitArg     = args.GetBoolArg("-tangent");
     bool tangentSplitArg       = args.GetBoolArg("-tangentsplit");
     bool edgeArg               = args.GetBoolArg("-edge");
+    bool optimizeArg           = args.GetBoolArg("-optimize");
+    bool overdrawArg           = args.GetBoolArg("-overdraw");
+    int cacheSizeArg           = args.GetIntArg("-cachesize", 16);
     nString groupArg           = args.GetStringArg("-group");
     nString groupRenameArg     = args.GetStringArg("-grename");
     float txArg                = args.GetFloatArg("-tx");
@@ -102,6 +111,9 @@ main(int argc, const char** argv)
                  "                      a technique that will not split vertices\n"
                  "-tangentsplit         generate vertex tangents for per pixel lighting using\n"
                  "                      a technique that may split vertices\n"
+                 "-optimize             optimize triangle and vertex order for the vertex cache\n"
+                 "-overdraw             like -optimize, also sort triangles to reduce overdraw\n"
+                 "-cachesize [int]      vertex cache size for the -optimize statistics\n"
                  "-edge                 generate edge data\n"
                  "-group [groupname]    select a group inside the mesh\n"
                  "-grename [newname]    rename the selected group\n"
@@ -220,6 +232,37 @@ main(int argc, const char** argv)
         mesh.BuildVertexTangents(tangentSplitArg);
     }
 
+    // optimize for the vertex cache?
+    if ((optimizeArg || overdrawArg) && (mesh.GetNumTriangles() > 0))
+    {
+        n_printf("-> optimizing...\n");
+        mesh.SortTriangles();
+        nArray<nMeshBuilder::Group> groupMap;
+        mesh.BuildGroupMap(groupMap);
+        nArray<float> acmrBefore;
+        nArray<float> atvrBefore;
+        int groupIndex;
+        for (groupIndex = 0; groupIndex < groupMap.Size(); groupIndex++)
+        {
+            const nMeshBuilder::Group& group = groupMap[groupIndex];
+            float acmr, atvr;
+            mesh.ComputeVertexCacheStats(group.GetFirstTriangle(), group.GetNumTriangles(), cacheSizeArg, acmr, atvr);
+            acmrBefore.Append(acmr);
+            atvrBefore.Append(atvr);
+        }
+
+        // optimizing doesn't move triangles between groups, the group map stays valid
+        mesh.Optimize(overdrawArg);
+        for (groupIndex = 0; groupIndex < groupMap.Size(); groupIndex++)
+        {
+            const nMeshBuilder::Group& group = groupMap[groupIndex];
+            float acmr, atvr;
+            mesh.ComputeVertexCacheStats(group.GetFirstTriangle(), group.GetNumTriangles(), cacheSizeArg, acmr, atvr);
+            n_printf("   group %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                     group.GetId(), acmrBefore[groupIndex], acmr, atvrBefore[groupIndex], atvr);
+        }
+    }
+
     // generate edges?
     if (edgeArg)
     {
@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "tools/nnpkbuilder.h"
 #include "kernel/nfileserver2.h"
+#include "file/nnpkcodec.h"
 
 //------------------------------------------------------------------------------
 /**
@@ -15,6 +16,10 @@ nNpkBuilder::nNpkBuilder() :
     dataBlockStart(0),
     dataBlockOffset(0),
     dataSize(0),
+    compressedDataSize(0),
+    compress(false),
+    tocPatches(256, 256),
+    curTocPatch(0),
     errorCode(NoError)
 {
     // empty
@@ -156,6 +161,27 @@ nNpkBuilder::WriteTocEntry(nNpkTocEntry* tocEntry, bool noTopLevelName)
         this->npkFile->PutInt('DEND');
         this->npkFile->PutInt(0);
     }
+    else if (this->compress)
+    {
+        // write a version 2 file entry, the file offset, compressed
+        // length and codec are patched after the data block is written
+        TocPatch patch;
+        patch.filePos = this->npkFile->Tell() + 2 * sizeof(int);
+        patch.fileOffset = 0;
+        patch.compressedLength = entryFileLength;
+        patch.codec = nNpkCodec::Stored;
+        this->tocPatches.Append(patch);
+
+        int blockLen = 4 * sizeof(int) + sizeof(short) + entryNameLen;
+        this->npkFile->PutInt('FIL2');
+        this->npkFile->PutInt(blockLen);
+        this->npkFile->PutInt(entryFileOffset);
+        this->npkFile->PutInt(entryFileLength);
+        this->npkFile->PutInt(entryFileLength);
+        this->npkFile->PutInt(nNpkCodec::Stored);
+        this->npkFile->PutShort(entryNameLen);
+        this->npkFile->Write(entryName.Get(), entryNameLen);
+    }
     else
     {
         // write a file entry
@@ -181,7 +207,7 @@ nNpkBuilder::WriteToc(bool noTopLevelName)
     n_assert(this->npkFile);
 
     // write header
-    this->npkFile->PutInt('NPK0');     // magic number
+    this->npkFile->PutInt(this->compress ? 'NPK2' : 'NPK0');     // magic number
     this->npkFile->PutInt(4);          // block len
     this->npkFile->PutInt(0);          // the data offset (fixed later)
 
@@ -222,7 +248,10 @@ nNpkBuilder::WriteEntryData(nNpkTocEntry* tocEntry)
     else if (nNpkTocEntry::FILE == entryType)
     {
         // make sure the file is still consistent with the toc data
-        n_assert(this->npkFile->Tell() == (this->dataBlockOffset + entryFileOffset));
+        if (!this->compress)
+        {
+            n_assert(this->npkFile->Tell() == (this->dataBlockOffset + entryFileOffset));
+        }
 
         // get the full source path name
         nString fileName = tocEntry->GetFullName();
@@ -235,25 +264,86 @@ nNpkBuilder::WriteEntryData(nNpkTocEntry* tocEntry)
             // allocate buffer for file and file contents
             char* buffer = n_new_array(char, entryFileLength);
             int bytesRead = srcFile->Read(buffer, entryFileLength);
-            n_assert(bytesRead == entryFileLength);
             srcFile->Close();
+            if (bytesRead != entryFileLength)
+            {
+                n_printf("nNpkBuilder: error reading file '%s'!\n", fileName.Get());
+                this->SetError(CannotReadSourceFile);
+                n_delete_array(buffer);
+                srcFile->Release();
+                return false;
+            }
+
+            // compress the file if enabled and if it pays off
+            const char* data = buffer;
+            int dataLength = entryFileLength;
+            char* compressedBuffer = 0;
+            if (this->compress)
+            {
+                TocPatch& patch = this->tocPatches[this->curTocPatch++];
+                patch.fileOffset = this->npkFile->Tell() - this->dataBlockOffset;
+                int compressedLength = 0;
+                if (nNpkCodec::CompressEntry(buffer, entryFileLength, compressedBuffer, compressedLength))
+                {
+                    data = compressedBuffer;
+                    dataLength = compressedLength;
+                    patch.compressedLength = compressedLength;
+                    patch.codec = nNpkCodec::Lz;
+                }
+            }
 
             // write buffer to target file
-            int bytesWritten = this->npkFile->Write(buffer, entryFileLength);
-            n_assert(bytesWritten == entryFileLength);
-            n_delete(buffer);
+            int bytesWritten = this->npkFile->Write(data, dataLength);
+            n_delete_array(buffer);
+            if (compressedBuffer)
+            {
+                n_delete_array(compressedBuffer);
+            }
+            if (bytesWritten != dataLength)
+            {
+                n_printf("nNpkBuilder: error writing to npk file!\n");
+                this->SetError(CannotWriteNpkFile);
+                srcFile->Release();
+                return false;
+            }
 
+            this->compressedDataSize += dataLength;
             this->dataSize += entryFileLength;
         }
         else
         {
-            n_error("nNpkBuilder::WriteEntryData(): failed to open src file '%s'!", fileName);
+            n_printf("nNpkBuilder: failed to open source file '%s'!\n", fileName.Get());
+            this->SetError(CannotReadSourceFile);
+            srcFile->Release();
+            return false;
         }
         srcFile->Release();
     }
     return true;
 }
 
+//------------------------------------------------------------------------------
+/**
+    Write the final file offsets, compressed lengths and codecs into the
+    version 2 file entries of the table of contents.
+*/
+void
+nNpkBuilder::PatchToc()
+{
+    n_assert(this->npkFile);
+    n_assert(this->curTocPatch == this->tocPatches.Size());
+    int i;
+    for (i = 0; i < this->tocPatches.Size(); i++)
+    {
+        const TocPatch& patch = this->tocPatches[i];
+        this->npkFile->Seek(patch.filePos, nFile::START);
+        this->npkFile->PutInt(patch.fileOffset);
+        this->npkFile->Seek(patch.filePos + 2 * sizeof(int), nFile::START);
+        this->npkFile->PutInt(patch.compressedLength);
+        this->npkFile->PutInt(patch.codec);
+    }
+}
+
 //------------------------------------------------------------------------------
 /**
     Write the data block to the file, and fix the data start offset in
@@ -272,17 +362,26 @@ nNpkBuilder::WriteData()
     this->npkFile->PutInt(0);    // fix later...
 
     this->dataSize = 0;
+    this->compressedDataSize = 0;
+    this->curTocPatch = 0;
     if (!this->WriteEntryData(this->tocObject->GetRootEntry()))
     {
         return false;
     }
+    if (this->compress)
+    {
+        this->PatchToc();
+        n_printf("nNpkBuilder: compressed %d bytes to %d bytes (%.1f%%)\n",
+                 this->dataSize, this->compressedDataSize,
+                 (this->dataSize > 0) ? (100.0f * this->compressedDataSize / this->dataSize) : 100.0f);
+    }
 
     // fix block lengths
     this->npkFile->Seek(8, nFile::START);
     this->npkFile->PutInt(this->dataBlockStart);
 
     this->npkFile->Seek(dataSizeOffset, nFile::START);
-    this->npkFile->PutInt(this->dataSize);
+    this->npkFile->PutInt(this->compressedDataSize);
     this->npkFile->Seek(0, nFile::END);
 
     return true;
@@ -338,6 +437,7 @@ nNpkBuilder::Pack(const nString& rootPath, const nString& dirName, const nString
     }
 
     // create table of contents
+    this->tocPatches.Clear();
     this->tocObject = n_new(nNpkToc);
     this->tocObject->SetRootPath(rootPath.Get());
 
@@ -367,3 +467,37 @@ nNpkBuilder::Pack(const nString& rootPath, const nString& dirName, const nString
     n_delete(dir);
     return success;
 }
+
+//------------------------------------------------------------------------------
+/**
+    Write an npk file from a table of contents which has been generated
+    by the caller (for instance with custom exclusion rules). The file
+    entries of the table of contents must have consecutive file offsets
+    starting at 0, their data is read from the entries' full names.
+
+    @param  toc     table of contents
+    @param  file    npk file opened for writing
+    @return         true, if all ok, false on error, call GetError() for details
+*/
+bool
+nNpkBuilder::Write(nNpkToc* toc, nFile* file)
+{
+    n_assert(toc);
+    n_assert(file);
+    n_assert(0 == this->npkFile);
+
+    this->SetError(NoError);
+    this->tocObject = toc;
+    this->npkFile = file;
+    this->tocPatches.Clear();
+
+    bool success = false;
+    if (this->WriteToc(false))
+    {
+        success = this->WriteData();
+    }
+
+    this->tocObject = 0;
+    this->npkFile = 0;
+    return success;
+}
@@ -29,6 +29,10 @@
        <dd>the 'newer' npk file to compare</dd>
      <dt>-unpack</dt>
        <dd>unpack given npk file</dd>
+     <dt>-compress</dt>
+       <dd>compress files when packing (writes a version 2 npk file)</dd>
+     <dt>-stats</dt>
+       <dd>show compression ratio and decode throughput per file type</dd>
     </dl>
 
     (C) 2002 RadonLabs GmbH
@@ -39,7 +43,10 @@
 #include "kernel/nfile.h"
 #include "file/nnpktoc.h"
 #include "file/nnpkfilewrapper.h"
+#include "file/nnpkcodec.h"
+#include "kernel/ntimeserver.h"
 #include "tools/ncmdlineargs.h"
+#include "tools/nnpkbuilder.h"
 
 #ifdef __WIN32__
 #   include <direct.h>
@@ -73,6 +80,9 @@ public:
     int             fileSize;
 };
 
+// compress files while packing
+static bool compressFiles = false;
+
 //------------------------------------------------------------------------------
 /**
     Cleanup the path name in place (replace any backslashes with slashes),
@@ -350,205 +360,6 @@ generateToc(nFileServer2* fs,
     return true;
 }
 
-//------------------------------------------------------------------------------
-/**
-    Write the header, leave the dataOffset field empty, this will be
-    written later by the fixDataOffset function.
-*/
-bool
-writeHeader(nFile* file)
-{
-    file->PutInt('NPK0');       // magic number
-    file->PutInt(4);            // block len
-    file->PutInt(0);            // dataOffset (fixed later)
-    return true;
-}
-
-//------------------------------------------------------------------------------
-/**
-    Fix the data offset in the file header
-*/
-bool
-writeDataOffset(nFile* file, int dataOffset)
-{
-    file->Seek(8, nFile::START);
-    file->PutInt(dataOffset);
-    return true;
-}
-
-//------------------------------------------------------------------------------
-/**
-    Write a single toc entry to the file, recurse if necessary.
-*/
-void
-writeTocEntry(nFile* file, nNpkTocEntry* tocEntry)
-{
-    n_assert(file);
-    n_assert(tocEntry);
-
-    nNpkTocEntry::Type entryType = tocEntry->GetType();
-    const char* entryName = tocEntry->GetName();
-    int entryNameLen = strlen(entryName);
-    int entryFileOffset = tocEntry->GetFileOffset();
-    int entryFileLength = tocEntry->GetFileLength();
-
-    if (nNpkTocEntry::DIR == entryType)
-    {
-//        n_printf("=> writing dir entry '%s'\n", entryName);
-
-        // write a directory entry, and recurse
-        int blockLen = sizeof(short) + entryNameLen;
-        file->PutInt('DIR_');
-        file->PutInt(blockLen);
-        file->PutShort(entryNameLen);
-        file->Write(entryName, entryNameLen);
-
-        nNpkTocEntry* curSubEntry = tocEntry->GetFirstEntry();
-        while (curSubEntry)
-        {
-            writeTocEntry(file, curSubEntry);
-            curSubEntry = tocEntry->GetNextEntry(curSubEntry);
-        }
-
-        // write a final directory end marker
-        file->PutInt('DEND');
-        file->PutInt(0);
-    }
-    else if (nNpkTocEntry::FILE == entryType)
-    {
-//        n_printf("=> writing file entry '%s', offset %d len %d\n", entryName, entryFileOffset, entryFileLength);
-
-        // write a file entry
-        int blockLen = 2 * sizeof(int) + sizeof(short) + entryNameLen;
-        file->PutInt('FILE');
-        file->PutInt(blockLen);
-        file->PutInt(entryFileOffset);
-        file->PutInt(entryFileLength);
-        file->PutShort(entryNameLen);
-        file->Write(entryName, entryNameLen);
-    }
-}
-
-//------------------------------------------------------------------------------
-/**
-    Recursively write the table of contents to the file.
-*/
-bool
-writeToc(nFile* file, nNpkToc& tocObject)
-{
-    if (writeHeader(file))
-    {
-        writeTocEntry(file, tocObject.GetRootEntry());
-        return true;
-    }
-    return false;
-}
-
-//------------------------------------------------------------------------------
-/**
-    Write data for a toc file into nFile, recurse on directory entries.
-*/
-bool
-writeEntryData(nFileServer2* fs, nFile* file, nNpkTocEntry* tocEntry, int dataBlockOffset, int& dataLen)
-{
-    n_assert(file);
-    n_assert(tocEntry);
-
-    nNpkTocEntry::Type entryType = tocEntry->GetType();
-    const char* entryName = tocEntry->GetName();
-    int entryFileOffset = tocEntry->GetFileOffset();
-    int entryFileLength = tocEntry->GetFileLength();
-
-    if (nNpkTocEntry::DIR == entryType)
-    {
-        n_printf("=> enter dir '%s'\n", entryName);
-
-        // a dir entry, just recurse
-        nNpkTocEntry* curSubEntry = tocEntry->GetFirstEntry();
-        while (curSubEntry)
-        {
-            if (!writeEntryData(fs, file, curSubEntry, dataBlockOffset, dataLen))
-            {
-                return false;
-            }
-            curSubEntry = tocEntry->GetNextEntry(curSubEntry);
-        }
-    }
-    else if (nNpkTocEntry::FILE == entryType)
-    {
-        // make sure the file is still consistent with the toc data
-        n_assert(file->Tell() == (dataBlockOffset + entryFileOffset));
-
-        // get the full source path name
-        nString fileName = tocEntry->GetFullName();
-
-        // read source file data
-        nFile* srcFile = fs->NewFileObject();
-        n_assert(srcFile);
-        if (srcFile->Open(fileName, "rb"))
-        {
-            // allocate buffer for file and file contents
-            char* buffer = n_new_array(char, entryFileLength);
-            int bytesRead = srcFile->Read(buffer, entryFileLength);
-            srcFile->Close();
-            if (bytesRead != entryFileLength)
-            {
-                srcFile->Release();
-                n_delete(buffer);
-                n_printf("Error reading file '%s'!\n", fileName.Get());
-                return false;
-            }
-
-            // write buffer to target file
-            int bytesWritten = file->Write(buffer, entryFileLength);
-            n_delete(buffer);
-            if (bytesWritten != entryFileLength)
-            {
-                srcFile->Release();
-                n_printf("Error writing to target file!\n");
-                return false;
-            }
-            dataLen += entryFileLength;
-        }
-        else
-        {
-            srcFile->Release();
-            n_printf("Failed to open source file '%s'!\n", fileName.Get());
-            return false;
-        }
-        srcFile->Release();
-    }
-    return true;
-}
-
-//------------------------------------------------------------------------------
-/**
-    Write the data block to the file, and fix the data start offset in the
-    file header...
-*/
-bool
-writeData(nFileServer2* fs, nFile* file, nNpkToc& tocObject)
-{
-    int dataBlockStart = file->Tell();
-    file->PutInt('DATA');
-    int dataLenOffset = file->Tell();
-    file->PutInt(0);    // fix later
-
-    int dataSize = 0;
-    if (!writeEntryData(fs, file, tocObject.GetRootEntry(), dataBlockStart + 8, dataSize))
-    {
-        return false;
-    }
-
-    // fix block lengths
-    writeDataOffset(file, dataBlockStart);
-
-    file->Seek(dataLenOffset, nFile::START);
-    file->PutInt(dataSize);
-    file->Seek(0, nFile::END);
-    return true;
-}
-
 //------------------------------------------------------------------------------
 /**
     The global pack function.
@@ -590,27 +401,17 @@ packIt(nFileServer2* fs, const char* dirName, const char* outName, bool includeC
     {
         n_printf("-> done\n");
 
-        // write header and toc to file
-        n_printf("-> writing toc...\n");
-        if (writeToc(file, tocObject))
+        // write header, toc and data block
+        n_printf("-> writing toc and data block...\n");
+        nNpkBuilder npkBuilder;
+        npkBuilder.SetCompression(compressFiles);
+        if (npkBuilder.Write(&tocObject, file))
         {
-            n_printf("-> done\n");
-
-            // write data block
-            n_printf("-> writing data block...\n");
-            if (writeData(fs, file, tocObject))
-            {
-                n_printf("-> all done\n");
-            }
-            else
-            {
-                n_printf("*** ERROR WRITING DATA BLOCK\n");
-                retval = false;
-            }
+            n_printf("-> all done\n");
         }
         else
         {
-            n_printf("*** ERROR WRITING TOC\n");
+            n_printf("*** ERROR WRITING NPK FILE\n");
             retval = false;
         }
     }
@@ -649,7 +450,14 @@ printTocEntry(nNpkTocEntry* entry, int& recursionDepth)
     }
 
     // show actual entry info
-    n_printf("%s\t%s\t%d\n", (nNpkTocEntry::DIR == type) ? "dir" : "file", name, length);
+    if (entry->IsCompressed())
+    {
+        n_printf("%s\t%s\t%d\t%d\n", "file", name, length, entry->GetCompressedLength());
+    }
+    else
+    {
+        n_printf("%s\t%s\t%d\n", (nNpkTocEntry::DIR == type) ? "dir" : "file", name, length);
+    }
 
     // if its a dir entry, recurse
     if (nNpkTocEntry::DIR == type)
@@ -845,19 +653,11 @@ AreFilesIdentical(FileEntry* oldEntry, FileEntry* newEntry,
     n_assert(0 != oldWrapper);
     n_assert(0 != newWrapper);
 
-    nFile* oldFile = oldWrapper->GetBinaryFile();
-    nFile* newFile = newWrapper->GetBinaryFile();
-    n_assert(0 != oldFile);
-    n_assert(0 != newFile);
-
     int size = oldNpkEntry->GetFileLength();
     char* oldArray = n_new_array(char, size);
     char* newArray = n_new_array(char, size);
-    oldFile->Seek(oldNpkEntry->GetFileOffset(), nFile::START);
-    newFile->Seek(newNpkEntry->GetFileOffset(), nFile::START);
-
-    oldFile->Read(oldArray, size);
-    newFile->Read(newArray, size);
+    oldWrapper->ReadEntry(oldNpkEntry, 0, oldArray, size, 0);
+    newWrapper->ReadEntry(newNpkEntry, 0, newArray, size, 0);
 
     int retValue = memcmp(oldArray, newArray, size);
 
@@ -1016,7 +816,7 @@ listIt(nFileServer2* fs, const char* listName)
 
         // print out file contents
         int recursionDepth = 0;
-        n_printf("TYPE\tNAME\tLENGTH\n");
+        n_printf("TYPE\tNAME\tLENGTH\tCOMPRESSED\n");
         printTocEntry(toc.GetRootEntry(), recursionDepth);
 
         wrapper.Close();
@@ -1029,6 +829,138 @@ listIt(nFileServer2* fs, const char* listName)
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+    Compression statistics of one file type.
+*/
+struct FileTypeStats
+{
+    nString extension;
+    int numFiles;
+    int numCompressed;
+    double length;
+    double compressedLength;
+    double decodedLength;       // decoded bytes of compressed files
+    double decodeTime;
+};
+
+//------------------------------------------------------------------------------
+/**
+    Gather compression statistics for a toc entry, and recurse. Compressed
+    files are decoded to measure the decode throughput.
+*/
+void
+gatherStats(nNpkTocEntry* entry, nArray<FileTypeStats>& stats)
+{
+    n_assert(entry);
+    if (nNpkTocEntry::DIR == entry->GetType())
+    {
+        nNpkTocEntry* childEntry;
+        for (childEntry = entry->GetFirstEntry(); childEntry; childEntry = entry->GetNextEntry(childEntry))
+        {
+            gatherStats(childEntry, stats);
+        }
+        return;
+    }
+
+    // find stats of file type
+    nString name = entry->GetName();
+    const char* ext = name.GetExtension();
+    nString extension = ext ? ext : "";
+    FileTypeStats* typeStats = 0;
+    int i;
+    for (i = 0; i < stats.Size(); i++)
+    {
+        if (stats[i].extension == extension)
+        {
+            typeStats = &(stats[i]);
+            break;
+        }
+    }
+    if (0 == typeStats)
+    {
+        FileTypeStats newStats;
+        newStats.extension = extension;
+        newStats.numFiles = 0;
+        newStats.numCompressed = 0;
+        newStats.length = 0.0;
+        newStats.compressedLength = 0.0;
+        newStats.decodedLength = 0.0;
+        newStats.decodeTime = 0.0;
+        stats.Append(newStats);
+        typeStats = &(stats.Back());
+    }
+
+    int length = entry->GetFileLength();
+    typeStats->numFiles++;
+    typeStats->length += length;
+    typeStats->compressedLength += entry->GetCompressedLength();
+    if (entry->IsCompressed())
+    {
+        typeStats->numCompressed++;
+        char* buf = n_new_array(char, length);
+        nTime startTime = nTimeServer::Instance()->GetTime();
+        entry->GetFileWrapper()->ReadEntry(entry, 0, buf, length, 0);
+        typeStats->decodeTime += nTimeServer::Instance()->GetTime() - startTime;
+        typeStats->decodedLength += length;
+        n_delete_array(buf);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+    Print compression ratio and decode throughput per file type.
+*/
+bool
+statsIt(nFileServer2* fs, const char* npkName)
+{
+    char absFileName[N_MAXPATH];
+    char rootPath[N_MAXPATH];
+    nMakeAbsolute(npkName, absFileName, sizeof(absFileName));
+    getDirectoryName(absFileName, rootPath, sizeof(rootPath));
+
+    nNpkFileWrapper wrapper;
+    if (!wrapper.Open(fs, rootPath, absFileName))
+    {
+        n_printf("Could not open '%s' as npk file!\n", absFileName);
+        return false;
+    }
+
+    nArray<FileTypeStats> stats;
+    gatherStats(wrapper.GetTocObject().GetRootEntry(), stats);
+
+    n_printf("npk version %d\n", wrapper.GetVersion());
+    n_printf("TYPE\tFILES\tCOMPRESSED\tSIZE\tPACKED\tRATIO\tDECODE MB/s\n");
+    FileTypeStats total;
+    total.numFiles = 0;
+    total.numCompressed = 0;
+    total.length = 0.0;
+    total.compressedLength = 0.0;
+    total.decodedLength = 0.0;
+    total.decodeTime = 0.0;
+    int i;
+    for (i = 0; i <= stats.Size(); i++)
+    {
+        const FileTypeStats& cur = (i < stats.Size()) ? stats[i] : total;
+        double ratio = (cur.length > 0.0) ? (cur.compressedLength / cur.length) : 1.0;
+        double throughput = (cur.decodeTime > 0.0) ? (cur.decodedLength / (cur.decodeTime * 1024.0 * 1024.0)) : 0.0;
+        n_printf("%s\t%d\t%d\t%.0f\t%.0f\t%.3f\t%.1f\n",
+                 (i < stats.Size()) ? cur.extension.Get() : "TOTAL",
+                 cur.numFiles, cur.numCompressed, cur.length, cur.compressedLength, ratio, throughput);
+        if (i < stats.Size())
+        {
+            total.numFiles += cur.numFiles;
+            total.numCompressed += cur.numCompressed;
+            total.length += cur.length;
+            total.compressedLength += cur.compressedLength;
+            total.decodedLength += cur.decodedLength;
+            total.decodeTime += cur.decodeTime;
+        }
+    }
+    wrapper.Close();
+    return true;
+}
+
 //------------------------------------------------------------------------------
 /**
 */
@@ -1101,7 +1033,6 @@ GenerateDifferenceList(nFileServer2* fs,
 */
 void
 unPackFile(nFileServer2* fs,
-           nFile* npkFile,
            nNpkTocEntry* entry,
            const char* outName,
            nList* dList)
@@ -1134,14 +1065,14 @@ unPackFile(nFileServer2* fs,
             nMakeAbsolute(intern, absName, sizeof(absName));
             if (file->Open(entry->GetName(), "w"))
             {
-                // copy bytes from npk into this file
-                int start  = entry->GetFileOffset();
+                // copy bytes from npk into this file, this decodes
+                // compressed files
                 int length = entry->GetFileLength();
-                npkFile->Seek(start, nFile::START);
                 char* buf = (char *) malloc(length);
                 n_assert(0 != buf);
-                npkFile->Read(buf, length);
+                entry->GetFileWrapper()->ReadEntry(entry, 0, buf, length, 0);
                 file->Write(buf, length);
+                free(buf);
 
                 file->Close();
             }
@@ -1192,7 +1123,7 @@ unPackFile(nFileServer2* fs,
             {
                 // outName is for the highest level only, below
                 // that we use correct name from npk file
-                unPackFile(fs, npkFile, childEntry, 0, dList);
+                unPackFile(fs, childEntry, 0, dList);
             }
 
             dir->Close();
@@ -1224,8 +1155,7 @@ unPack(nFileServer2* fs, const char* fileName, const char* outName, nList* dList
         // get table of contents object
         nNpkTocEntry* tocEntry = fileWrapper.GetTocObject().GetRootEntry();
 
-        nFile* npkFile = fileWrapper.GetBinaryFile();
-        unPackFile(fs, npkFile, tocEntry, outName, dList);
+        unPackFile(fs, tocEntry, outName, dList);
 
         fileWrapper.Close();
     }
@@ -1317,6 +1247,7 @@ main(int argc, const char** argv)
 {
     nCmdLineArgs args(argc, argv);
     bool help, showDiff, diff, includeCVS;
+    nString statsName;
     nString packName;
     nString listName;
     nString outName;
@@ -1337,6 +1268,8 @@ main(int argc, const char** argv)
     unPackName = args.GetStringArg("-unpack", 0);
     includeCVS = args.GetBoolArg("-includeCVS");
     excludePatternsArg = args.GetStringArg("-exclude", 0);
+    compressFiles = args.GetBoolArg("-compress");
+    statsName  = args.GetStringArg("-stats", 0);
 
     // show help
     if (help)
@@ -1353,7 +1286,9 @@ main(int argc, const char** argv)
                "-new        the 'newer' npk file to compare\n"
                "-unpack     unpack given npk file\n"
                "-includeCVS include CVS directories (ignored by default)\n"
-               "-exclude    one or more exclude patterns\n");
+               "-exclude    one or more exclude patterns\n"
+               "-compress   compress files when packing (npk version 2)\n"
+               "-stats      show compression ratio and decode speed per file type\n");
         return 0;
     }
 
@@ -1393,6 +1328,11 @@ main(int argc, const char** argv)
                 // call list function
                 listIt(fs, listName.Get());
             }
+            else if (statsName.IsValid())
+            {
+                // show compression statistics
+                statsIt(fs, statsName.Get());
+            }
             else
             {
                 // list difference of two npk files
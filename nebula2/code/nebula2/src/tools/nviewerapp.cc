@@ -238,6 +238,9 @@ nViewerApp::Run()
         // trigger remote server
         kernelServer->GetRemoteServer()->Trigger();
 
+        // trigger resource server
+        this->refResourceServer->Trigger();
+
         // trigger script server
         running = this->refScriptServer->Trigger();
 